@@ -7,33 +7,197 @@
 #endif
 
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include <vulkan/vulkan_core.h>
+#include "vkdevcache.h"
 #include "vkrenderer.h"
 
+/**
+ * Checks if device supports all descriptor indexing features renderer uses
+ * @param f Specifies features supported by device
+ * @returns non-zero if supported, or zero otherwise
+ */
+static int
+vkrenderer_has_descriptor_indexing(const VkPhysicalDeviceVulkan12Features *f)
+{
+	return f->descriptorIndexing && f->runtimeDescriptorArray &&
+	       f->descriptorBindingPartiallyBound &&
+	       f->descriptorBindingVariableDescriptorCount &&
+	       f->shaderSampledImageArrayNonUniformIndexing;
+}
+
+/**
+ * Enables Vulkan 1.2 features used by faster code paths
+ * @param rdr Specifies renderer to configure
+ * @param supported Specifies Vulkan 1.2 features supported by device
+ */
+static void
+vkrenderer_enable_features12(struct vkrenderer *rdr,
+			     const VkPhysicalDeviceVulkan12Features *supported)
+{
+	VkPhysicalDeviceVulkan12Features *enabled = &rdr->features12;
+	if (supported->timelineSemaphore) {
+		enabled->timelineSemaphore = VK_TRUE;
+		rdr->caps |= VKRENDERER_CAP_TIMELINE_SEMAPHORE;
+	}
+	if (vkrenderer_has_descriptor_indexing(supported)) {
+		enabled->descriptorIndexing = VK_TRUE;
+		enabled->runtimeDescriptorArray = VK_TRUE;
+		enabled->descriptorBindingPartiallyBound = VK_TRUE;
+		enabled->descriptorBindingVariableDescriptorCount = VK_TRUE;
+		enabled->shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+		rdr->caps |= VKRENDERER_CAP_DESCRIPTOR_INDEXING;
+	}
+}
+
+/**
+ * Enables Vulkan 1.3 features used by faster code paths
+ * @param rdr Specifies renderer to configure
+ * @param supported Specifies Vulkan 1.3 features supported by device
+ */
+static void
+vkrenderer_enable_features13(struct vkrenderer *rdr,
+			     const VkPhysicalDeviceVulkan13Features *supported)
+{
+	VkPhysicalDeviceVulkan13Features *enabled = &rdr->features13;
+	if (supported->dynamicRendering) {
+		enabled->dynamicRendering = VK_TRUE;
+		rdr->caps |= VKRENDERER_CAP_DYNAMIC_RENDERING;
+	}
+	if (supported->synchronization2) {
+		enabled->synchronization2 = VK_TRUE;
+		rdr->caps |= VKRENDERER_CAP_SYNCHRONIZATION2;
+	}
+	if (supported->pipelineCreationCacheControl) {
+		enabled->pipelineCreationCacheControl = VK_TRUE;
+		rdr->caps |= VKRENDERER_CAP_PIPELINE_CACHE_CONTROL;
+	}
+}
+
 /**
  * Configure device features
  * @param rdr Specifies renderer to configure
  */
 static void vkrenderer_configure_features(struct vkrenderer *rdr)
 {
-	/* We are not enabling any features, so no need to check for them */
+	VkPhysicalDeviceProperties props;
+	VkPhysicalDeviceVulkan13Features supported13 = {
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES,
+		.pNext = NULL,
+	};
+	VkPhysicalDeviceVulkan12Features supported12 = {
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+		.pNext = NULL,
+	};
+	VkPhysicalDeviceFeatures2 supported = {
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+		.pNext = &supported12,
+	};
+	/* Only optional features are enabled, so device is never rejected */
 	memset(&rdr->features, 0, sizeof(VkPhysicalDeviceFeatures));
+	memset(&rdr->features12, 0, sizeof(VkPhysicalDeviceVulkan12Features));
+	memset(&rdr->features13, 0, sizeof(VkPhysicalDeviceVulkan13Features));
+	rdr->features12.sType =
+		VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	rdr->features13.sType =
+		VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+	rdr->features_chain = NULL;
+	vkGetPhysicalDeviceProperties(rdr->phy, &props);
+	if (props.apiVersion < VK_API_VERSION_1_2)
+		return;
+	if (props.apiVersion >= VK_API_VERSION_1_3)
+		supported12.pNext = &supported13;
+	vkGetPhysicalDeviceFeatures2(rdr->phy, &supported);
+	const uint32_t caps = rdr->caps;
+	vkrenderer_enable_features12(rdr, &supported12);
+	vkrenderer_enable_features13(rdr, &supported13);
+	/* Imageless framebuffer is only a fallback for dynamic rendering */
+	if (!(rdr->caps & VKRENDERER_CAP_DYNAMIC_RENDERING) &&
+	    supported12.imagelessFramebuffer) {
+		rdr->features12.imagelessFramebuffer = VK_TRUE;
+		rdr->caps |= VKRENDERER_CAP_IMAGELESS_FRAMEBUFFER;
+	}
+	const uint32_t caps13 = VKRENDERER_CAP_DYNAMIC_RENDERING |
+				VKRENDERER_CAP_SYNCHRONIZATION2 |
+				VKRENDERER_CAP_PIPELINE_CACHE_CONTROL;
+	if (rdr->caps & caps13)
+		rdr->features12.pNext = &rdr->features13;
+	/* Feature structures are not chained if none of them is enabled */
+	if (rdr->caps != caps)
+		rdr->features_chain = &rdr->features12;
+}
+
+/** Optional device extension enabling faster code path */
+struct vkrenderer_extension {
+	/** Name of extension */
+	const char *name;
+	/** Capability enabled along with extension */
+	uint32_t cap;
+};
+
+/**
+ * Checks if extension is in list of extensions supported by device
+ * @param props Specifies extensions supported by device
+ * @param nprops Specifies number of elements in @a props
+ * @param name Specifies name of extension to find
+ * @returns non-zero if extension is supported, or zero otherwise
+ */
+static int vkrenderer_has_extension(const VkExtensionProperties *props,
+				    uint32_t nprops, const char *name)
+{
+	for (uint32_t i = 0; i < nprops; ++i) {
+		if (strcmp(props[i].extensionName, name) == 0)
+			return 1;
+	}
+	return 0;
 }
 
 /**
  * Configure device extensions
+ *
+ * Required extensions reject device, optional ones set capabilities.
  * @param rdr Specifies renderer to configure
+ * @returns zero on success, or non-zero otherwise
  */
-static void vkrenderer_configure_extensions(struct vkrenderer *rdr)
+static int vkrenderer_configure_extensions(struct vkrenderer *rdr)
 {
-	static const char *const req_dev_extensions[] = {
-		VK_KHR_SWAPCHAIN_EXTENSION_NAME
+	static const struct vkrenderer_extension optional[] = {
+		{ VK_EXT_MEMORY_BUDGET_EXTENSION_NAME,
+		  VKRENDERER_CAP_MEMORY_BUDGET },
+		{ VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME,
+		  VKRENDERER_CAP_CALIBRATED_TIMESTAMPS },
 	};
-	/* TODO: check that required extension is really supported */
-	rdr->extensions = req_dev_extensions;
-	rdr->nextensions = ARRAY_SIZE(req_dev_extensions);
+	uint32_t nprops = 0;
+	VkResult result;
+	result = vkEnumerateDeviceExtensionProperties(rdr->phy, NULL, &nprops,
+						      NULL);
+	if (result != VK_SUCCESS)
+		return -1;
+	VkExtensionProperties *props =
+		malloc(sizeof(VkExtensionProperties) * nprops);
+	if (props == NULL)
+		return -1;
+	result = vkEnumerateDeviceExtensionProperties(rdr->phy, NULL, &nprops,
+						      props);
+	if (result != VK_SUCCESS ||
+	    !vkrenderer_has_extension(props, nprops,
+				      VK_KHR_SWAPCHAIN_EXTENSION_NAME)) {
+		free(props);
+		return -1;
+	}
+	rdr->caps = 0;
+	rdr->extensions[0] = VK_KHR_SWAPCHAIN_EXTENSION_NAME;
+	rdr->nextensions = 1;
+	for (size_t i = 0; i < ARRAY_SIZE(optional); ++i) {
+		if (!vkrenderer_has_extension(props, nprops, optional[i].name))
+			continue;
+		rdr->extensions[rdr->nextensions++] = optional[i].name;
+		rdr->caps |= optional[i].cap;
+	}
+	free(props);
+	return 0;
 }
 
 /**
@@ -43,8 +207,9 @@ static void vkrenderer_configure_extensions(struct vkrenderer *rdr)
  */
 static int vkrenderer_configure_device(struct vkrenderer *rdr)
 {
+	if (vkrenderer_configure_extensions(rdr))
+		return -1;
 	vkrenderer_configure_features(rdr);
-	vkrenderer_configure_extensions(rdr);
 	if (vkrenderer_configure_families(rdr))
 		return -1;
 	if (vkrenderer_configure_swapchain(rdr))
@@ -52,17 +217,119 @@ static int vkrenderer_configure_device(struct vkrenderer *rdr)
 	return 0;
 }
 
+/**
+ * Configure renderer on device selected on previous launch
+ *
+ * Queue families are taken from cache instead of probing every family for
+ * surface support.
+ * @param rdr Specifies renderer to configure
+ * @param cache Specifies cached device
+ * @returns zero on success, or non-zero otherwise
+ */
+static int vkrenderer_configure_cached_device(struct vkrenderer *rdr,
+					      const struct vkdevcache *cache)
+{
+	VkBool32 supported = VK_FALSE;
+	if (vkrenderer_configure_extensions(rdr))
+		return -1;
+	vkrenderer_configure_features(rdr);
+	/* Surface may differ from the one device was selected for */
+	const VkResult result = vkGetPhysicalDeviceSurfaceSupportKHR(
+		rdr->phy, cache->present, rdr->srf, &supported);
+	if (result != VK_SUCCESS || !supported)
+		return -1;
+	rdr->graphic = cache->graphic;
+	rdr->present = cache->present;
+	rdr->graphic_nqueues = cache->graphic_nqueues;
+	rdr->compute = cache->compute;
+	rdr->transfer = cache->transfer;
+	return vkrenderer_configure_swapchain(rdr);
+}
+
+/**
+ * Configure renderer on cached device if it is still present
+ * @param rdr Specifies renderer to configure
+ * @param phy Specifies available devices
+ * @param nphy Specifies number of elements in @a phy
+ * @returns zero on success, or non-zero otherwise
+ */
+static int vkrenderer_configure_cached(struct vkrenderer *rdr,
+				       const VkPhysicalDevice *phy,
+				       uint32_t nphy)
+{
+	struct vkdevcache cache;
+	if (rdr->device_cache == NULL ||
+	    vkdevcache_load(&cache, rdr->device_cache))
+		return -1;
+	for (uint32_t i = 0; i < nphy; ++i) {
+		if (!vkdevcache_matches(&cache, phy[i]))
+			continue;
+		rdr->phy = phy[i];
+		return vkrenderer_configure_cached_device(rdr, &cache);
+	}
+	return -1;
+}
+
+/**
+ * Saves configured device, so next launch skips probing devices
+ * @param rdr Specifies configured renderer
+ */
+static void vkrenderer_save_device(const struct vkrenderer *rdr)
+{
+	struct vkdevcache cache;
+	if (rdr->device_cache == NULL || vkdevcache_identify(&cache, rdr->phy))
+		return;
+	cache.graphic = rdr->graphic;
+	cache.present = rdr->present;
+	cache.graphic_nqueues = rdr->graphic_nqueues;
+	cache.compute = rdr->compute;
+	cache.transfer = rdr->transfer;
+	/* Failure only costs probing devices on next launch */
+	vkdevcache_save(&cache, rdr->device_cache);
+}
+
+/**
+ * Sorts devices by descending score
+ * @param phy Specifies devices to sort
+ * @param nphy Specifies number of elements in @a phy
+ */
+static void vkrenderer_sort_devices(VkPhysicalDevice *phy, uint32_t nphy)
+{
+	uint32_t scores[VKRENDERER_MAX_DEVICES];
+	for (uint32_t i = 0; i < nphy; ++i) {
+		scores[i] = vkrenderer_score_device(phy[i]);
+	}
+	for (uint32_t i = 1; i < nphy; ++i) {
+		const VkPhysicalDevice dev = phy[i];
+		const uint32_t score = scores[i];
+		uint32_t j = i;
+		for (; j > 0 && scores[j - 1] < score; --j) {
+			phy[j] = phy[j - 1];
+			scores[j] = scores[j - 1];
+		}
+		phy[j] = dev;
+		scores[j] = score;
+	}
+}
+
 int vkrenderer_configure(struct vkrenderer *rdr, VkInstance instance)
 {
-	VkPhysicalDevice phy[4];
+	VkPhysicalDevice phy[VKRENDERER_MAX_DEVICES];
 	uint32_t nphy = ARRAY_SIZE(phy);
 	if (vkEnumeratePhysicalDevices(instance, &nphy, phy) != VK_SUCCESS) {
 		return -1;
 	}
+	if (!vkrenderer_configure_cached(rdr, phy, nphy))
+		return 0;
+	/* The best device that passes configuration is selected */
+	if (nphy > 1)
+		vkrenderer_sort_devices(phy, nphy);
 	for (size_t i = 0; i < nphy; ++i) {
 		rdr->phy = phy[i];
-		if (!vkrenderer_configure_device(rdr))
+		if (!vkrenderer_configure_device(rdr)) {
+			vkrenderer_save_device(rdr);
 			return 0;
+		}
 	}
 	return -1;
 }
@@ -0,0 +1,112 @@
+/**
+ * @file
+ * Vulkan physical device scoring implementation
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdint.h>
+
+#include <vulkan/vulkan_core.h>
+#include "vkrenderer.h"
+
+/** Points per GiB of the largest device-local heap */
+#define SCORE_PER_HEAP_GIB 10
+
+/** Device-local heap size above which memory adds no more points, in GiB */
+#define SCORE_MAX_HEAP_GIB 32
+
+/** Points for queue family running asynchronously to graphics */
+#define SCORE_DEDICATED_FAMILY 100
+
+/**
+ * Scores type of device
+ *
+ * Type points dominate the rest, so any discrete GPU wins over integrated
+ * one sharing system memory.
+ * @param type Specifies type of device
+ * @returns score of device type
+ */
+static uint32_t score_type(VkPhysicalDeviceType type)
+{
+	switch (type) {
+	case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+		return 2000;
+	case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+		return 1000;
+	case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+		return 500;
+	case VK_PHYSICAL_DEVICE_TYPE_CPU:
+		return 100;
+	default:
+		return 0;
+	}
+}
+
+/**
+ * Scores size of the largest device-local heap
+ * @param phy Specifies device to score
+ * @returns score of device memory
+ */
+static uint32_t score_memory(VkPhysicalDevice phy)
+{
+	VkPhysicalDeviceMemoryProperties props;
+	VkDeviceSize largest = 0;
+	vkGetPhysicalDeviceMemoryProperties(phy, &props);
+	for (uint32_t i = 0; i < props.memoryHeapCount; ++i) {
+		const VkMemoryHeap *heap = &props.memoryHeaps[i];
+		if ((heap->flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) &&
+		    heap->size > largest)
+			largest = heap->size;
+	}
+	VkDeviceSize gib = largest >> 30;
+	if (gib > SCORE_MAX_HEAP_GIB)
+		gib = SCORE_MAX_HEAP_GIB;
+	return (uint32_t)gib * SCORE_PER_HEAP_GIB;
+}
+
+/**
+ * Scores queue topology, dedicated compute and transfer families overlap
+ * their work with rendering
+ * @param phy Specifies device to score
+ * @returns score of queue families
+ */
+static uint32_t score_queues(VkPhysicalDevice phy)
+{
+	VkQueueFamilyProperties families[32];
+	uint32_t nfamilies = ARRAY_SIZE(families);
+	int compute = 0;
+	int transfer = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(phy, &nfamilies, families);
+	for (uint32_t i = 0; i < nfamilies; ++i) {
+		const VkQueueFlags flags = families[i].queueFlags;
+		if (flags & VK_QUEUE_GRAPHICS_BIT)
+			continue;
+		if (flags & VK_QUEUE_COMPUTE_BIT)
+			compute = 1;
+		else if (flags & VK_QUEUE_TRANSFER_BIT)
+			transfer = 1;
+	}
+	return (uint32_t)(compute + transfer) * SCORE_DEDICATED_FAMILY;
+}
+
+/**
+ * Scores device limits
+ * @param limits Specifies limits of device
+ * @returns score of device limits
+ */
+static uint32_t score_limits(const VkPhysicalDeviceLimits *limits)
+{
+	return limits->maxImageDimension2D / 1024 +
+	       limits->maxComputeSharedMemorySize / 4096 +
+	       limits->maxPushConstantsSize / 64;
+}
+
+uint32_t vkrenderer_score_device(VkPhysicalDevice phy)
+{
+	VkPhysicalDeviceProperties props;
+	vkGetPhysicalDeviceProperties(phy, &props);
+	return score_type(props.deviceType) + score_memory(phy) +
+	       score_queues(phy) + score_limits(&props.limits);
+}
@@ -0,0 +1,141 @@
+/**
+ * @file
+ * Test suite for vkrenderer device scoring
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdint.h>
+
+#include <cgreen/cgreen.h>
+#include <cgreen/mocks.h>
+
+#include <vulkan/vulkan_core.h>
+#include "vkrenderer.h"
+
+VKAPI_ATTR void VKAPI_CALL
+vkGetPhysicalDeviceProperties(VkPhysicalDevice physicalDevice,
+			      VkPhysicalDeviceProperties *pProperties)
+{
+	mock(physicalDevice, pProperties);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceMemoryProperties(
+	VkPhysicalDevice physicalDevice,
+	VkPhysicalDeviceMemoryProperties *pMemoryProperties)
+{
+	mock(physicalDevice, pMemoryProperties);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceQueueFamilyProperties(
+	VkPhysicalDevice physicalDevice, uint32_t *pQueueFamilyCount,
+	VkQueueFamilyProperties *pQueueFamily)
+{
+	mock(physicalDevice, pQueueFamilyCount, pQueueFamily);
+}
+
+/**
+ * Scores device with single universal queue family
+ * @param type Specifies type of device
+ * @param heap Specifies size of its device-local heap
+ * @returns score of device
+ */
+static uint32_t score_device(VkPhysicalDeviceType type, VkDeviceSize heap)
+{
+	VkPhysicalDeviceProperties props = {
+		.deviceType = type,
+	};
+	VkPhysicalDeviceMemoryProperties memory = {
+		.memoryHeapCount = 2,
+		.memoryHeaps = {
+			{ .size = 64ULL << 30, .flags = 0 },
+			{ .size = heap,
+			  .flags = VK_MEMORY_HEAP_DEVICE_LOCAL_BIT },
+		},
+	};
+	static VkQueueFamilyProperties fams[] = {
+		{ .queueFlags = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT },
+	};
+	static uint32_t nfams = ARRAY_SIZE(fams);
+	expect(vkGetPhysicalDeviceProperties,
+	       will_set_contents_of_parameter(pProperties, &props,
+					      sizeof(props)));
+	expect(vkGetPhysicalDeviceMemoryProperties,
+	       will_set_contents_of_parameter(pMemoryProperties, &memory,
+					      sizeof(memory)));
+	expect(vkGetPhysicalDeviceQueueFamilyProperties,
+	       will_set_contents_of_parameter(pQueueFamilyCount, &nfams,
+					      sizeof(nfams)),
+	       will_set_contents_of_parameter(pQueueFamily, fams,
+					      sizeof(fams)));
+	return vkrenderer_score_device(VK_NULL_HANDLE);
+}
+
+Ensure(score_prefers_discrete_over_integrated_device)
+{
+	const uint32_t discrete =
+		score_device(VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU, 4ULL << 30);
+	const uint32_t integrated = score_device(
+		VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU, 128ULL << 30);
+	assert_that(discrete, is_greater_than(integrated));
+}
+
+Ensure(score_prefers_larger_device_local_heap)
+{
+	const uint32_t small =
+		score_device(VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU, 4ULL << 30);
+	const uint32_t large =
+		score_device(VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU, 8ULL << 30);
+	assert_that(large, is_greater_than(small));
+}
+
+Ensure(score_prefers_dedicated_queue_families)
+{
+	const uint32_t universal =
+		score_device(VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU, 4ULL << 30);
+	VkPhysicalDeviceProperties props = {
+		.deviceType = VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU,
+	};
+	VkPhysicalDeviceMemoryProperties memory = {
+		.memoryHeapCount = 1,
+		.memoryHeaps = {
+			{ .size = 4ULL << 30,
+			  .flags = VK_MEMORY_HEAP_DEVICE_LOCAL_BIT },
+		},
+	};
+	VkQueueFamilyProperties fams[] = {
+		{ .queueFlags = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT },
+		{ .queueFlags = VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT },
+		{ .queueFlags = VK_QUEUE_TRANSFER_BIT },
+	};
+	uint32_t nfams = ARRAY_SIZE(fams);
+	expect(vkGetPhysicalDeviceProperties,
+	       will_set_contents_of_parameter(pProperties, &props,
+					      sizeof(props)));
+	expect(vkGetPhysicalDeviceMemoryProperties,
+	       will_set_contents_of_parameter(pMemoryProperties, &memory,
+					      sizeof(memory)));
+	expect(vkGetPhysicalDeviceQueueFamilyProperties,
+	       will_set_contents_of_parameter(pQueueFamilyCount, &nfams,
+					      sizeof(nfams)),
+	       will_set_contents_of_parameter(pQueueFamily, fams,
+					      sizeof(fams)));
+	const uint32_t dedicated = vkrenderer_score_device(VK_NULL_HANDLE);
+	assert_that(dedicated, is_greater_than(universal));
+}
+
+int main(int argc, char **argv)
+{
+	(void)(argc);
+	(void)(argv);
+	TestSuite *suite = create_named_test_suite("Device scoring");
+	add_test(suite, score_prefers_discrete_over_integrated_device);
+	add_test(suite, score_prefers_larger_device_local_heap);
+	add_test(suite, score_prefers_dedicated_queue_families);
+	TestReporter *reporter = create_text_reporter();
+	int exit_code = run_test_suite(suite, reporter);
+	destroy_reporter(reporter);
+	destroy_test_suite(suite);
+	return exit_code;
+}
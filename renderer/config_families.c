@@ -70,6 +70,57 @@ static int select_universal_families(const struct family_properties *props,
 	return -1;
 }
 
+/**
+ * Selects queue family for compute jobs, preferring one without graphics
+ *
+ * Compute-only family usually maps to async compute engine overlapping
+ * rasterization, otherwise any compute family is used.
+ * @param props Specifies available family queues
+ * @param compute Specifies pointer where store compute family index
+ * @returns zero if family is found, and non-zero otherwise
+ */
+static int select_compute_family(const struct family_properties *props,
+				 uint32_t *compute)
+{
+	*compute = props->count;
+	for (uint32_t i = 0; i < props->count; ++i) {
+		const VkQueueFamilyProperties *fam = &props->fams[i];
+		if (fam->queueCount == 0 ||
+		    !(fam->queueFlags & VK_QUEUE_COMPUTE_BIT))
+			continue;
+		if (!(fam->queueFlags & VK_QUEUE_GRAPHICS_BIT)) {
+			*compute = i;
+			return 0;
+		}
+		if (*compute == props->count)
+			*compute = i;
+	}
+	return *compute >= props->count;
+}
+
+/**
+ * Selects queue family for uploads, preferring one dedicated to transfers
+ *
+ * Dedicated transfer family usually maps to copy engine running alongside
+ * graphics, otherwise uploads share graphics family.
+ * @param props Specifies available family queues
+ * @param graph Specifies graphics family index
+ * @returns transfer family index
+ */
+static uint32_t select_transfer_family(const struct family_properties *props,
+				       uint32_t graph)
+{
+	const VkQueueFlags other = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT;
+	for (uint32_t i = 0; i < props->count; ++i) {
+		const VkQueueFamilyProperties *fam = &props->fams[i];
+		if (fam->queueCount > 0 &&
+		    (fam->queueFlags & VK_QUEUE_TRANSFER_BIT) &&
+		    !(fam->queueFlags & other))
+			return i;
+	}
+	return graph;
+}
+
 /**
  * Tests and fills family properties
  * @param phy Specifies physical device against of which to test properties
@@ -88,7 +139,7 @@ static void set_family_properties(VkPhysicalDevice phy, VkSurfaceKHR srf,
 }
 
 /**
- * Choose graphics and presentation families
+ * Choose graphics, presentation, compute and transfer families
  * @param rdr Specifies renderer to choose families for
  * @returns zero if indices are found, and non-zero otherwise
  */
@@ -108,8 +159,14 @@ int vkrenderer_configure_families(struct vkrenderer *rdr)
 	for (uint32_t i = 0; i < props.count; ++i) {
 		set_family_properties(rdr->phy, rdr->srf, &props, i);
 	}
-	if (!select_universal_families(&props, &rdr->graphic, &rdr->present)) {
-		return 0;
+	if (select_universal_families(&props, &rdr->graphic, &rdr->present) &&
+	    select_families(&props, &rdr->graphic, &rdr->present)) {
+		return -1;
+	}
+	if (select_compute_family(&props, &rdr->compute)) {
+		return -1;
 	}
-	return select_families(&props, &rdr->graphic, &rdr->present);
+	rdr->graphic_nqueues = props.fams[rdr->graphic].queueCount;
+	rdr->transfer = select_transfer_family(&props, rdr->graphic);
+	return 0;
 }
@@ -34,7 +34,8 @@ Ensure(configure_selects_universal_queue_family)
 	struct vkrenderer rdr;
 	VkQueueFamilyProperties fams[] = {
 		{
-			.queueFlags = VK_QUEUE_GRAPHICS_BIT,
+			.queueFlags = VK_QUEUE_GRAPHICS_BIT |
+				      VK_QUEUE_COMPUTE_BIT,
 			.queueCount = 1,
 		},
 	};
@@ -54,6 +55,8 @@ Ensure(configure_selects_universal_queue_family)
 	assert_that(result, is_equal_to(0));
 	assert_that(rdr.graphic, is_equal_to(0));
 	assert_that(rdr.present, is_equal_to(0));
+	assert_that(rdr.compute, is_equal_to(0));
+	assert_that(rdr.transfer, is_equal_to(0));
 }
 
 Ensure(configure_selects_separate_families_when_no_universal)
@@ -61,7 +64,8 @@ Ensure(configure_selects_separate_families_when_no_universal)
 	struct vkrenderer rdr;
 	VkQueueFamilyProperties fams[] = {
 		{
-			.queueFlags = VK_QUEUE_GRAPHICS_BIT,
+			.queueFlags = VK_QUEUE_GRAPHICS_BIT |
+				      VK_QUEUE_COMPUTE_BIT,
 			.queueCount = 1,
 		},
 		{
@@ -92,6 +96,72 @@ Ensure(configure_selects_separate_families_when_no_universal)
 	assert_that(rdr.present, is_equal_to(1));
 }
 
+Ensure(configure_selects_dedicated_transfer_family)
+{
+	struct vkrenderer rdr;
+	VkQueueFamilyProperties fams[] = {
+		{
+			.queueFlags = VK_QUEUE_GRAPHICS_BIT |
+				      VK_QUEUE_COMPUTE_BIT |
+				      VK_QUEUE_TRANSFER_BIT,
+			.queueCount = 4,
+		},
+		{
+			.queueFlags = VK_QUEUE_COMPUTE_BIT |
+				      VK_QUEUE_TRANSFER_BIT,
+			.queueCount = 1,
+		},
+		{
+			.queueFlags = VK_QUEUE_TRANSFER_BIT,
+			.queueCount = 1,
+		},
+	};
+	uint32_t nfams = ARRAY_SIZE(fams);
+	VkBool32 present[] = { VK_TRUE, VK_FALSE, VK_FALSE };
+	expect(vkGetPhysicalDeviceQueueFamilyProperties,
+	       will_set_contents_of_parameter(pQueueFamilyCount, &nfams,
+					      sizeof(nfams)),
+	       will_set_contents_of_parameter(pQueueFamily, fams,
+					      sizeof(*fams) * nfams));
+	for (uint32_t i = 0; i < nfams; ++i) {
+		expect(vkGetPhysicalDeviceSurfaceSupportKHR,
+		       when(queueFamilyIndex, is_equal_to(i)),
+		       will_set_contents_of_parameter(pSupported, &present[i],
+						      sizeof(*present)),
+		       will_return(VK_SUCCESS));
+	}
+	int result = vkrenderer_configure_families(&rdr);
+	assert_that(result, is_equal_to(0));
+	assert_that(rdr.graphic, is_equal_to(0));
+	assert_that(rdr.compute, is_equal_to(1));
+	assert_that(rdr.transfer, is_equal_to(2));
+	assert_that(rdr.graphic_nqueues, is_equal_to(4));
+}
+
+Ensure(configure_fails_without_compute_family)
+{
+	struct vkrenderer rdr;
+	VkQueueFamilyProperties fams[] = {
+		{
+			.queueFlags = VK_QUEUE_GRAPHICS_BIT,
+			.queueCount = 1,
+		},
+	};
+	uint32_t nfams = ARRAY_SIZE(fams);
+	VkBool32 present[] = { VK_TRUE };
+	expect(vkGetPhysicalDeviceQueueFamilyProperties,
+	       will_set_contents_of_parameter(pQueueFamilyCount, &nfams,
+					      sizeof(nfams)),
+	       will_set_contents_of_parameter(pQueueFamily, fams,
+					      sizeof(*fams) * nfams));
+	expect(vkGetPhysicalDeviceSurfaceSupportKHR,
+	       will_set_contents_of_parameter(pSupported, &present[0],
+					      sizeof(*present)),
+	       will_return(VK_SUCCESS));
+	int result = vkrenderer_configure_families(&rdr);
+	assert_that(result, is_not_equal_to(0));
+}
+
 Ensure(configure_fails_when_no_suitable_families)
 {
 	struct vkrenderer rdr;
@@ -133,6 +203,8 @@ int main(int argc, char **argv)
 	TestSuite *vkr = create_named_test_suite("Families configuration");
 	add_test(vkr, configure_selects_universal_queue_family);
 	add_test(vkr, configure_selects_separate_families_when_no_universal);
+	add_test(vkr, configure_selects_dedicated_transfer_family);
+	add_test(vkr, configure_fails_without_compute_family);
 	add_test(vkr, configure_fails_when_no_suitable_families);
 	TestReporter *reporter = create_text_reporter();
 	int exit_code = run_test_suite(vkr, reporter);
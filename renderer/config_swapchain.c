@@ -65,6 +65,49 @@ int vkrenderer_configure_surface_format(struct vkrenderer *rdr)
 	return 0;
 }
 
+/**
+ * Present modes ranked by preference for each present policy
+ *
+ * Each row ends with FIFO mode, which is supported by every device.
+ */
+static const VkPresentModeKHR present_mode_ranks[][4] = {
+	[VKRENDERER_PRESENT_POWER] = {
+		VK_PRESENT_MODE_FIFO_KHR,
+	},
+	[VKRENDERER_PRESENT_LATENCY] = {
+		VK_PRESENT_MODE_MAILBOX_KHR,
+		VK_PRESENT_MODE_IMMEDIATE_KHR,
+		VK_PRESENT_MODE_FIFO_RELAXED_KHR,
+		VK_PRESENT_MODE_FIFO_KHR,
+	},
+	[VKRENDERER_PRESENT_THROUGHPUT] = {
+		VK_PRESENT_MODE_IMMEDIATE_KHR,
+		VK_PRESENT_MODE_MAILBOX_KHR,
+		VK_PRESENT_MODE_FIFO_RELAXED_KHR,
+		VK_PRESENT_MODE_FIFO_KHR,
+	},
+};
+
+/**
+ * Select the best ranked present mode from available
+ * @param ranks Specifies present modes ranked by preference
+ * @param modes Specifies array of available present modes on device
+ * @param nmodes Specifies number of elements in @a modes array
+ * @returns selected present mode
+ */
+static VkPresentModeKHR select_present_mode(const VkPresentModeKHR *ranks,
+					    const VkPresentModeKHR *modes,
+					    uint32_t nmodes)
+{
+	for (; *ranks != VK_PRESENT_MODE_FIFO_KHR; ++ranks) {
+		for (uint32_t i = 0; i < nmodes; ++i) {
+			if (modes[i] == *ranks)
+				return *ranks;
+		}
+	}
+	return VK_PRESENT_MODE_FIFO_KHR;
+}
+
 int vkrenderer_configure_surface_present_mode(struct vkrenderer *rdr)
 {
 	VkPresentModeKHR modes[32];
@@ -74,10 +117,38 @@ int vkrenderer_configure_surface_present_mode(struct vkrenderer *rdr)
 							   &nmodes, modes);
 	if (result != VK_SUCCESS || nmodes == 0)
 		return -1;
-	rdr->srf_mode = VK_PRESENT_MODE_FIFO_KHR;
+	if (rdr->present_policy >= ARRAY_SIZE(present_mode_ranks))
+		return -1;
+	const VkPresentModeKHR *ranks = present_mode_ranks[rdr->present_policy];
+	rdr->srf_mode = select_present_mode(ranks, modes, nmodes);
 	return 0;
 }
 
+void vkrenderer_configure_image_count(struct vkrenderer *rdr)
+{
+	const VkSurfaceCapabilitiesKHR *caps = &rdr->srf_caps;
+	uint32_t budget = rdr->latency_budget;
+	uint32_t count = caps->minImageCount;
+	if (budget == 0)
+		budget = VKRENDERER_DEFAULT_LATENCY_BUDGET;
+	switch (rdr->srf_mode) {
+	case VK_PRESENT_MODE_MAILBOX_KHR:
+	case VK_PRESENT_MODE_IMMEDIATE_KHR:
+		/* Spare image lets acquire proceed while others are shown */
+		count += 1;
+		break;
+	default:
+		/* Every image queued in FIFO adds a frame of display latency */
+		if (count < budget + 1)
+			count = budget + 1;
+		break;
+	}
+	/* Zero maximum means there is no limit */
+	if (caps->maxImageCount != 0 && count > caps->maxImageCount)
+		count = caps->maxImageCount;
+	rdr->srf_image_count = count;
+}
+
 /**
  * Choose swapchain parameters
  * @param rdr Specifies renderer to choose swapchain parameters for
@@ -94,5 +165,6 @@ int vkrenderer_configure_swapchain(struct vkrenderer *rdr)
 		return -1;
 	if (vkrenderer_configure_surface_present_mode(rdr))
 		return -1;
+	vkrenderer_configure_image_count(rdr);
 	return 0;
 }
@@ -203,11 +203,94 @@ Ensure(configure_fails_when_no_surface_modes_available)
 	assert_that(result, is_not_equal_to(0));
 }
 
-Ensure(configure_selects_fifo_mode)
+/**
+ * Configures present mode for policy with specified available modes
+ * @param policy Specifies present policy to configure for
+ * @param modes Specifies array of available present modes
+ * @param nmodes Specifies number of elements in @a modes array
+ * @returns selected present mode
+ */
+static VkPresentModeKHR configure_present_mode(
+	enum vkrenderer_present_policy policy, VkPresentModeKHR *modes,
+	uint32_t nmodes)
+{
+	struct vkrenderer rdr = {
+		.present_policy = policy,
+	};
+	expect(vkGetPhysicalDeviceSurfacePresentModesKHR,
+	       will_set_contents_of_parameter(pPresentModeCount, &nmodes,
+					      sizeof(nmodes)),
+	       will_set_contents_of_parameter(pPresentModes, modes,
+					      sizeof(*modes) * nmodes),
+	       will_return(VK_SUCCESS));
+	int result = vkrenderer_configure_surface_present_mode(&rdr);
+	assert_that(result, is_equal_to(0));
+	return rdr.srf_mode;
+}
+
+Ensure(configure_selects_fifo_mode_for_power_policy)
+{
+	VkPresentModeKHR modes[] = {
+		VK_PRESENT_MODE_IMMEDIATE_KHR,
+		VK_PRESENT_MODE_MAILBOX_KHR,
+		VK_PRESENT_MODE_FIFO_KHR,
+	};
+	VkPresentModeKHR mode = configure_present_mode(
+		VKRENDERER_PRESENT_POWER, modes, ARRAY_SIZE(modes));
+	assert_that(mode, is_equal_to(VK_PRESENT_MODE_FIFO_KHR));
+}
+
+Ensure(configure_selects_mailbox_mode_for_latency_policy)
+{
+	VkPresentModeKHR modes[] = {
+		VK_PRESENT_MODE_IMMEDIATE_KHR,
+		VK_PRESENT_MODE_FIFO_KHR,
+		VK_PRESENT_MODE_MAILBOX_KHR,
+	};
+	VkPresentModeKHR mode = configure_present_mode(
+		VKRENDERER_PRESENT_LATENCY, modes, ARRAY_SIZE(modes));
+	assert_that(mode, is_equal_to(VK_PRESENT_MODE_MAILBOX_KHR));
+}
+
+Ensure(configure_selects_immediate_mode_for_throughput_policy)
 {
-	struct vkrenderer rdr;
 	VkPresentModeKHR modes[] = {
+		VK_PRESENT_MODE_MAILBOX_KHR,
+		VK_PRESENT_MODE_FIFO_KHR,
 		VK_PRESENT_MODE_IMMEDIATE_KHR,
+	};
+	VkPresentModeKHR mode = configure_present_mode(
+		VKRENDERER_PRESENT_THROUGHPUT, modes, ARRAY_SIZE(modes));
+	assert_that(mode, is_equal_to(VK_PRESENT_MODE_IMMEDIATE_KHR));
+}
+
+Ensure(configure_prefers_fifo_relaxed_mode_to_fifo)
+{
+	VkPresentModeKHR modes[] = {
+		VK_PRESENT_MODE_FIFO_KHR,
+		VK_PRESENT_MODE_FIFO_RELAXED_KHR,
+	};
+	VkPresentModeKHR mode = configure_present_mode(
+		VKRENDERER_PRESENT_THROUGHPUT, modes, ARRAY_SIZE(modes));
+	assert_that(mode, is_equal_to(VK_PRESENT_MODE_FIFO_RELAXED_KHR));
+}
+
+Ensure(configure_falls_back_to_fifo_mode)
+{
+	VkPresentModeKHR modes[] = {
+		VK_PRESENT_MODE_FIFO_KHR,
+	};
+	VkPresentModeKHR mode = configure_present_mode(
+		VKRENDERER_PRESENT_LATENCY, modes, ARRAY_SIZE(modes));
+	assert_that(mode, is_equal_to(VK_PRESENT_MODE_FIFO_KHR));
+}
+
+Ensure(configure_fails_on_unknown_present_policy)
+{
+	struct vkrenderer rdr = {
+		.present_policy = VKRENDERER_PRESENT_POLICIES,
+	};
+	VkPresentModeKHR modes[] = {
 		VK_PRESENT_MODE_FIFO_KHR,
 	};
 	uint32_t nmodes = ARRAY_SIZE(modes);
@@ -218,13 +301,12 @@ Ensure(configure_selects_fifo_mode)
 					      sizeof(*modes) * nmodes),
 	       will_return(VK_SUCCESS));
 	int result = vkrenderer_configure_surface_present_mode(&rdr);
-	assert_that(result, is_equal_to(0));
-	assert_that(rdr.srf_mode, is_equal_to(VK_PRESENT_MODE_FIFO_KHR));
+	assert_that(result, is_not_equal_to(0));
 }
 
 Ensure(configure_selects_suitable_swapchain)
 {
-	struct vkrenderer rdr;
+	struct vkrenderer rdr = { 0 };
 	VkSurfaceCapabilitiesKHR caps = {
 		.minImageCount = 1,
 		.maxImageCount = 1,
@@ -267,6 +349,79 @@ Ensure(configure_selects_suitable_swapchain)
 	assert_that(rdr.srf_format.colorSpace,
 		    is_equal_to(VK_COLOR_SPACE_SRGB_NONLINEAR_KHR));
 	assert_that(rdr.srf_mode, is_equal_to(VK_PRESENT_MODE_FIFO_KHR));
+	assert_that(rdr.srf_image_count, is_equal_to(1));
+}
+
+/**
+ * Configures number of images for present mode and surface limits
+ * @param mode Specifies selected present mode
+ * @param budget Specifies requested latency budget
+ * @param min Specifies minimum number of images supported by surface
+ * @param max Specifies maximum number of images supported by surface
+ * @returns selected number of images
+ */
+static uint32_t configure_image_count(VkPresentModeKHR mode, uint32_t budget,
+				      uint32_t min, uint32_t max)
+{
+	struct vkrenderer rdr = {
+		.srf_mode = mode,
+		.latency_budget = budget,
+		.srf_caps = {
+			.minImageCount = min,
+			.maxImageCount = max,
+		},
+	};
+	vkrenderer_configure_image_count(&rdr);
+	return rdr.srf_image_count;
+}
+
+Ensure(configure_image_count_adds_spare_image_for_mailbox)
+{
+	uint32_t count =
+		configure_image_count(VK_PRESENT_MODE_MAILBOX_KHR, 0, 3, 8);
+	assert_that(count, is_equal_to(4));
+}
+
+Ensure(configure_image_count_adds_spare_image_for_immediate)
+{
+	uint32_t count =
+		configure_image_count(VK_PRESENT_MODE_IMMEDIATE_KHR, 1, 2, 8);
+	assert_that(count, is_equal_to(3));
+}
+
+Ensure(configure_image_count_uses_default_budget_for_fifo)
+{
+	uint32_t count =
+		configure_image_count(VK_PRESENT_MODE_FIFO_KHR, 0, 2, 8);
+	assert_that(count, is_equal_to(VKRENDERER_DEFAULT_LATENCY_BUDGET + 1));
+}
+
+Ensure(configure_image_count_follows_latency_budget_for_fifo)
+{
+	uint32_t count =
+		configure_image_count(VK_PRESENT_MODE_FIFO_KHR, 4, 2, 8);
+	assert_that(count, is_equal_to(5));
+}
+
+Ensure(configure_image_count_keeps_minimum_for_small_budget)
+{
+	uint32_t count =
+		configure_image_count(VK_PRESENT_MODE_FIFO_KHR, 1, 3, 8);
+	assert_that(count, is_equal_to(3));
+}
+
+Ensure(configure_image_count_respects_maximum)
+{
+	uint32_t count =
+		configure_image_count(VK_PRESENT_MODE_FIFO_KHR, 6, 2, 4);
+	assert_that(count, is_equal_to(4));
+}
+
+Ensure(configure_image_count_ignores_zero_maximum)
+{
+	uint32_t count =
+		configure_image_count(VK_PRESENT_MODE_FIFO_KHR, 6, 2, 0);
+	assert_that(count, is_equal_to(7));
 }
 
 int main(int argc, char **argv)
@@ -285,7 +440,19 @@ int main(int argc, char **argv)
 	add_test(vkr, configure_finds_bgra_unorm_srgb_format_in_available);
 	add_test(vkr, configure_fails_when_no_memory_for_surface_modes);
 	add_test(vkr, configure_fails_when_no_surface_modes_available);
-	add_test(vkr, configure_selects_fifo_mode);
+	add_test(vkr, configure_selects_fifo_mode_for_power_policy);
+	add_test(vkr, configure_selects_mailbox_mode_for_latency_policy);
+	add_test(vkr, configure_selects_immediate_mode_for_throughput_policy);
+	add_test(vkr, configure_prefers_fifo_relaxed_mode_to_fifo);
+	add_test(vkr, configure_falls_back_to_fifo_mode);
+	add_test(vkr, configure_fails_on_unknown_present_policy);
+	add_test(vkr, configure_image_count_adds_spare_image_for_mailbox);
+	add_test(vkr, configure_image_count_adds_spare_image_for_immediate);
+	add_test(vkr, configure_image_count_uses_default_budget_for_fifo);
+	add_test(vkr, configure_image_count_follows_latency_budget_for_fifo);
+	add_test(vkr, configure_image_count_keeps_minimum_for_small_budget);
+	add_test(vkr, configure_image_count_respects_maximum);
+	add_test(vkr, configure_image_count_ignores_zero_maximum);
 	TestReporter *reporter = create_text_reporter();
 	int exit_code = run_test_suite(vkr, reporter);
 	destroy_reporter(reporter);
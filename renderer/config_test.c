@@ -7,11 +7,13 @@
 #endif
 
 #include <stdint.h>
+#include <string.h>
 
 #include <cgreen/cgreen.h>
 #include <cgreen/mocks.h>
 
 #include <vulkan/vulkan_core.h>
+#include "vkdevcache.h"
 #include "vkrenderer.h"
 
 VKAPI_ATTR VkResult VKAPI_CALL
@@ -21,6 +23,125 @@ vkEnumeratePhysicalDevices(VkInstance instance, uint32_t *pPhysicalDeviceCount,
 	return (VkResult)mock(instance, pPhysicalDeviceCount, pPhysicalDevices);
 }
 
+VKAPI_ATTR void VKAPI_CALL
+vkGetPhysicalDeviceProperties(VkPhysicalDevice physicalDevice,
+			      VkPhysicalDeviceProperties *pProperties)
+{
+	mock(physicalDevice, pProperties);
+}
+
+/** Extensions reported by vkEnumerateDeviceExtensionProperties */
+static const char *const *device_extensions;
+
+/** Number of elements in @a device_extensions */
+static uint32_t ndevice_extensions;
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkEnumerateDeviceExtensionProperties(VkPhysicalDevice physicalDevice,
+				     const char *pLayerName,
+				     uint32_t *pPropertyCount,
+				     VkExtensionProperties *pProperties)
+{
+	if (pProperties == NULL) {
+		*pPropertyCount = ndevice_extensions;
+	} else {
+		for (uint32_t i = 0; i < *pPropertyCount; ++i) {
+			strcpy(pProperties[i].extensionName,
+			       device_extensions[i]);
+		}
+	}
+	return (VkResult)mock(physicalDevice, pLayerName, pPropertyCount,
+			      pProperties);
+}
+
+/**
+ * Makes devices report specified extensions
+ * @param extensions Specifies extensions to report
+ * @param count Specifies number of elements in @a extensions
+ */
+static void set_device_extensions(const char *const *extensions,
+				  uint32_t count)
+{
+	device_extensions = extensions;
+	ndevice_extensions = count;
+	always_expect(vkEnumerateDeviceExtensionProperties,
+		      will_return(VK_SUCCESS));
+}
+
+/**
+ * Makes devices report only extensions required by renderer
+ */
+static void set_required_extensions(void)
+{
+	static const char *const required[] = {
+		VK_KHR_SWAPCHAIN_EXTENSION_NAME,
+	};
+	set_device_extensions(required, ARRAY_SIZE(required));
+}
+
+VKAPI_ATTR void VKAPI_CALL
+vkGetPhysicalDeviceFeatures2(VkPhysicalDevice physicalDevice,
+			     VkPhysicalDeviceFeatures2 *pFeatures)
+{
+	/* Mock returns supported features as mask of VKRENDERER_CAP_* bits */
+	const uint32_t supported = (uint32_t)mock(physicalDevice, pFeatures);
+	VkPhysicalDeviceVulkan12Features *features12 = pFeatures->pNext;
+	VkPhysicalDeviceVulkan13Features *features13 = features12->pNext;
+	features12->timelineSemaphore =
+		(supported & VKRENDERER_CAP_TIMELINE_SEMAPHORE) != 0;
+	features12->imagelessFramebuffer =
+		(supported & VKRENDERER_CAP_IMAGELESS_FRAMEBUFFER) != 0;
+	const VkBool32 indexing =
+		(supported & VKRENDERER_CAP_DESCRIPTOR_INDEXING) != 0;
+	features12->descriptorIndexing = indexing;
+	features12->runtimeDescriptorArray = indexing;
+	features12->descriptorBindingPartiallyBound = indexing;
+	features12->descriptorBindingVariableDescriptorCount = indexing;
+	features12->shaderSampledImageArrayNonUniformIndexing = indexing;
+	if (features13 != NULL) {
+		features13->dynamicRendering =
+			(supported & VKRENDERER_CAP_DYNAMIC_RENDERING) != 0;
+		features13->synchronization2 =
+			(supported & VKRENDERER_CAP_SYNCHRONIZATION2) != 0;
+		const uint32_t control = VKRENDERER_CAP_PIPELINE_CACHE_CONTROL;
+		features13->pipelineCreationCacheControl =
+			(supported & control) != 0;
+	}
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkGetPhysicalDeviceSurfaceSupportKHR(
+	VkPhysicalDevice physicalDevice, uint32_t queueFamilyIndex,
+	VkSurfaceKHR surface, VkBool32 *pSupported)
+{
+	return (VkResult)mock(physicalDevice, queueFamilyIndex, surface,
+			      pSupported);
+}
+
+int vkdevcache_identify(struct vkdevcache *cache, VkPhysicalDevice phy)
+{
+	return (int)mock(cache, phy);
+}
+
+int vkdevcache_matches(const struct vkdevcache *cache, VkPhysicalDevice phy)
+{
+	return (int)mock(cache, phy);
+}
+
+int vkdevcache_load(struct vkdevcache *cache, const char *path)
+{
+	return (int)mock(cache, path);
+}
+
+int vkdevcache_save(const struct vkdevcache *cache, const char *path)
+{
+	return (int)mock(cache, path);
+}
+
+uint32_t vkrenderer_score_device(VkPhysicalDevice phy)
+{
+	return (uint32_t)mock(phy);
+}
+
 int vkrenderer_configure_families(struct vkrenderer *rdr)
 {
 	return (int)mock(rdr);
@@ -60,12 +181,19 @@ Ensure(configure_selects_suitable_device)
 	VkInstance instance = VK_NULL_HANDLE;
 	VkPhysicalDevice phy[1] = { VK_NULL_HANDLE };
 	uint32_t nphy = ARRAY_SIZE(phy);
+	VkPhysicalDeviceProperties props = {
+		.apiVersion = VK_API_VERSION_1_1,
+	};
 	expect(vkEnumeratePhysicalDevices,
 	       will_set_contents_of_parameter(pPhysicalDevices, phy,
 					      sizeof(*phy) * nphy),
 	       will_set_contents_of_parameter(pPhysicalDeviceCount, &nphy,
 					      sizeof(nphy)),
 	       will_return(VK_SUCCESS), when(instance, is_equal_to(instance)));
+	set_required_extensions();
+	expect(vkGetPhysicalDeviceProperties,
+	       will_set_contents_of_parameter(pProperties, &props,
+					      sizeof(props)));
 	expect(vkrenderer_configure_families, will_return(0));
 	expect(vkrenderer_configure_swapchain, will_return(0));
 	int result = vkrenderer_configure(&rdr, instance);
@@ -79,12 +207,19 @@ Ensure(configure_fails_when_no_suitable_families_available)
 	VkInstance instance = VK_NULL_HANDLE;
 	VkPhysicalDevice phy[1] = { VK_NULL_HANDLE };
 	uint32_t nphy = ARRAY_SIZE(phy);
+	VkPhysicalDeviceProperties props = {
+		.apiVersion = VK_API_VERSION_1_1,
+	};
 	expect(vkEnumeratePhysicalDevices,
 	       will_set_contents_of_parameter(pPhysicalDevices, phy,
 					      sizeof(*phy) * nphy),
 	       will_set_contents_of_parameter(pPhysicalDeviceCount, &nphy,
 					      sizeof(nphy)),
 	       will_return(VK_SUCCESS), when(instance, is_equal_to(instance)));
+	set_required_extensions();
+	expect(vkGetPhysicalDeviceProperties,
+	       will_set_contents_of_parameter(pProperties, &props,
+					      sizeof(props)));
 	expect(vkrenderer_configure_families, will_return(-1));
 	never_expect(vkrenderer_configure_swapchain, will_return(0));
 	int result = vkrenderer_configure(&rdr, instance);
@@ -97,18 +232,334 @@ Ensure(configure_fails_when_no_suitable_swapchain_available)
 	VkInstance instance = VK_NULL_HANDLE;
 	VkPhysicalDevice phy[1] = { VK_NULL_HANDLE };
 	uint32_t nphy = ARRAY_SIZE(phy);
+	VkPhysicalDeviceProperties props = {
+		.apiVersion = VK_API_VERSION_1_1,
+	};
 	expect(vkEnumeratePhysicalDevices,
 	       will_set_contents_of_parameter(pPhysicalDevices, phy,
 					      sizeof(*phy) * nphy),
 	       will_set_contents_of_parameter(pPhysicalDeviceCount, &nphy,
 					      sizeof(nphy)),
 	       will_return(VK_SUCCESS), when(instance, is_equal_to(instance)));
+	set_required_extensions();
+	expect(vkGetPhysicalDeviceProperties,
+	       will_set_contents_of_parameter(pProperties, &props,
+					      sizeof(props)));
 	expect(vkrenderer_configure_families, will_return(0));
 	expect(vkrenderer_configure_swapchain, will_return(-1));
 	int result = vkrenderer_configure(&rdr, instance);
 	assert_that(result, is_not_equal_to(0));
 }
 
+/**
+ * Prepares expectations for single device with specified API version
+ * @param instance Specifies instance to enumerate devices of
+ * @param phy Specifies pointer to enumerated device
+ * @param props Specifies properties reported by device
+ */
+static void expect_single_device(VkInstance instance, VkPhysicalDevice *phy,
+				 VkPhysicalDeviceProperties *props)
+{
+	static uint32_t nphy = 1;
+	expect(vkEnumeratePhysicalDevices,
+	       will_set_contents_of_parameter(pPhysicalDevices, phy,
+					      sizeof(*phy)),
+	       will_set_contents_of_parameter(pPhysicalDeviceCount, &nphy,
+					      sizeof(nphy)),
+	       will_return(VK_SUCCESS), when(instance, is_equal_to(instance)));
+	set_required_extensions();
+	expect(vkGetPhysicalDeviceProperties,
+	       will_set_contents_of_parameter(pProperties, props,
+					      sizeof(*props)));
+	expect(vkrenderer_configure_families, will_return(0));
+	expect(vkrenderer_configure_swapchain, will_return(0));
+}
+
+Ensure(configure_enables_timeline_semaphore_when_supported)
+{
+	struct vkrenderer rdr = { 0 };
+	VkInstance instance = VK_NULL_HANDLE;
+	VkPhysicalDevice phy = VK_NULL_HANDLE;
+	VkPhysicalDeviceProperties props = {
+		.apiVersion = VK_API_VERSION_1_2,
+	};
+	expect_single_device(instance, &phy, &props);
+	expect(vkGetPhysicalDeviceFeatures2, will_return(VK_TRUE));
+	int result = vkrenderer_configure(&rdr, instance);
+	assert_that(result, is_equal_to(0));
+	assert_that(rdr.caps & VKRENDERER_CAP_TIMELINE_SEMAPHORE,
+		    is_not_equal_to(0));
+	assert_that(rdr.features12.timelineSemaphore, is_equal_to(VK_TRUE));
+}
+
+Ensure(configure_skips_timeline_semaphore_when_not_supported)
+{
+	struct vkrenderer rdr = { 0 };
+	VkInstance instance = VK_NULL_HANDLE;
+	VkPhysicalDevice phy = VK_NULL_HANDLE;
+	VkPhysicalDeviceProperties props = {
+		.apiVersion = VK_API_VERSION_1_2,
+	};
+	expect_single_device(instance, &phy, &props);
+	expect(vkGetPhysicalDeviceFeatures2, will_return(VK_FALSE));
+	int result = vkrenderer_configure(&rdr, instance);
+	assert_that(result, is_equal_to(0));
+	assert_that(rdr.caps & VKRENDERER_CAP_TIMELINE_SEMAPHORE,
+		    is_equal_to(0));
+	assert_that(rdr.features12.timelineSemaphore, is_equal_to(VK_FALSE));
+}
+
+Ensure(configure_skips_timeline_semaphore_on_vulkan_1_1_device)
+{
+	struct vkrenderer rdr = { 0 };
+	VkInstance instance = VK_NULL_HANDLE;
+	VkPhysicalDevice phy = VK_NULL_HANDLE;
+	VkPhysicalDeviceProperties props = {
+		.apiVersion = VK_API_VERSION_1_1,
+	};
+	expect_single_device(instance, &phy, &props);
+	never_expect(vkGetPhysicalDeviceFeatures2);
+	int result = vkrenderer_configure(&rdr, instance);
+	assert_that(result, is_equal_to(0));
+	assert_that(rdr.caps & VKRENDERER_CAP_TIMELINE_SEMAPHORE,
+		    is_equal_to(0));
+}
+
+Ensure(configure_prefers_dynamic_rendering)
+{
+	struct vkrenderer rdr = { 0 };
+	VkInstance instance = VK_NULL_HANDLE;
+	VkPhysicalDevice phy = VK_NULL_HANDLE;
+	VkPhysicalDeviceProperties props = {
+		.apiVersion = VK_API_VERSION_1_3,
+	};
+	expect_single_device(instance, &phy, &props);
+	expect(vkGetPhysicalDeviceFeatures2,
+	       will_return(VKRENDERER_CAP_DYNAMIC_RENDERING |
+			   VKRENDERER_CAP_IMAGELESS_FRAMEBUFFER));
+	int result = vkrenderer_configure(&rdr, instance);
+	assert_that(result, is_equal_to(0));
+	assert_that(rdr.caps, is_equal_to(VKRENDERER_CAP_DYNAMIC_RENDERING));
+	assert_that(rdr.features13.dynamicRendering, is_equal_to(VK_TRUE));
+	assert_that(rdr.features12.pNext, is_equal_to(&rdr.features13));
+	assert_that(rdr.features12.imagelessFramebuffer,
+		    is_equal_to(VK_FALSE));
+}
+
+Ensure(configure_falls_back_to_imageless_framebuffer)
+{
+	struct vkrenderer rdr = { 0 };
+	VkInstance instance = VK_NULL_HANDLE;
+	VkPhysicalDevice phy = VK_NULL_HANDLE;
+	VkPhysicalDeviceProperties props = {
+		.apiVersion = VK_API_VERSION_1_2,
+	};
+	expect_single_device(instance, &phy, &props);
+	expect(vkGetPhysicalDeviceFeatures2,
+	       will_return(VKRENDERER_CAP_DYNAMIC_RENDERING |
+			   VKRENDERER_CAP_IMAGELESS_FRAMEBUFFER));
+	int result = vkrenderer_configure(&rdr, instance);
+	assert_that(result, is_equal_to(0));
+	assert_that(rdr.caps,
+		    is_equal_to(VKRENDERER_CAP_IMAGELESS_FRAMEBUFFER));
+	assert_that(rdr.features12.imagelessFramebuffer, is_equal_to(VK_TRUE));
+	assert_that(rdr.features12.pNext, is_null);
+	assert_that(rdr.features_chain, is_equal_to(&rdr.features12));
+}
+
+Ensure(configure_skips_device_without_swapchain_extension)
+{
+	static const char *const extensions[] = {
+		VK_EXT_MEMORY_BUDGET_EXTENSION_NAME,
+	};
+	struct vkrenderer rdr = { 0 };
+	VkInstance instance = VK_NULL_HANDLE;
+	VkPhysicalDevice phy = VK_NULL_HANDLE;
+	static uint32_t nphy = 1;
+	expect(vkEnumeratePhysicalDevices,
+	       will_set_contents_of_parameter(pPhysicalDevices, &phy,
+					      sizeof(phy)),
+	       will_set_contents_of_parameter(pPhysicalDeviceCount, &nphy,
+					      sizeof(nphy)),
+	       will_return(VK_SUCCESS), when(instance, is_equal_to(instance)));
+	set_device_extensions(extensions, ARRAY_SIZE(extensions));
+	never_expect(vkGetPhysicalDeviceProperties);
+	never_expect(vkrenderer_configure_families);
+	int result = vkrenderer_configure(&rdr, instance);
+	assert_that(result, is_not_equal_to(0));
+}
+
+Ensure(configure_enables_supported_optional_extensions)
+{
+	static const char *const extensions[] = {
+		"VK_KHR_unrelated",
+		VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME,
+		VK_KHR_SWAPCHAIN_EXTENSION_NAME,
+		VK_EXT_MEMORY_BUDGET_EXTENSION_NAME,
+	};
+	struct vkrenderer rdr = { 0 };
+	VkInstance instance = VK_NULL_HANDLE;
+	VkPhysicalDevice phy = VK_NULL_HANDLE;
+	VkPhysicalDeviceProperties props = {
+		.apiVersion = VK_API_VERSION_1_1,
+	};
+	expect_single_device(instance, &phy, &props);
+	set_device_extensions(extensions, ARRAY_SIZE(extensions));
+	int result = vkrenderer_configure(&rdr, instance);
+	assert_that(result, is_equal_to(0));
+	const uint32_t caps = VKRENDERER_CAP_MEMORY_BUDGET |
+			      VKRENDERER_CAP_CALIBRATED_TIMESTAMPS;
+	assert_that(rdr.caps, is_equal_to(caps));
+	assert_that(rdr.nextensions, is_equal_to(3));
+	assert_that(rdr.extensions[0],
+		    is_equal_to_string(VK_KHR_SWAPCHAIN_EXTENSION_NAME));
+	/* Extension-only capabilities do not chain feature structures */
+	assert_that(rdr.features_chain, is_null);
+}
+
+Ensure(configure_enables_performance_features)
+{
+	struct vkrenderer rdr = { 0 };
+	VkInstance instance = VK_NULL_HANDLE;
+	VkPhysicalDevice phy = VK_NULL_HANDLE;
+	VkPhysicalDeviceProperties props = {
+		.apiVersion = VK_API_VERSION_1_3,
+	};
+	expect_single_device(instance, &phy, &props);
+	const uint32_t caps = VKRENDERER_CAP_SYNCHRONIZATION2 |
+			      VKRENDERER_CAP_DESCRIPTOR_INDEXING |
+			      VKRENDERER_CAP_PIPELINE_CACHE_CONTROL;
+	expect(vkGetPhysicalDeviceFeatures2, will_return(caps));
+	int result = vkrenderer_configure(&rdr, instance);
+	assert_that(result, is_equal_to(0));
+	assert_that(rdr.caps, is_equal_to(caps));
+	assert_that(rdr.features13.synchronization2, is_equal_to(VK_TRUE));
+	assert_that(rdr.features12.runtimeDescriptorArray,
+		    is_equal_to(VK_TRUE));
+	assert_that(rdr.features12.pNext, is_equal_to(&rdr.features13));
+	assert_that(rdr.features_chain, is_equal_to(&rdr.features12));
+}
+
+/**
+ * Prepares expectation enumerating two devices
+ * @param instance Specifies instance to enumerate devices of
+ * @param phy Specifies array of two enumerated devices
+ */
+static void expect_two_devices(VkInstance instance, VkPhysicalDevice *phy)
+{
+	static uint32_t nphy = 2;
+	expect(vkEnumeratePhysicalDevices,
+	       will_set_contents_of_parameter(pPhysicalDevices, phy,
+					      sizeof(*phy) * nphy),
+	       will_set_contents_of_parameter(pPhysicalDeviceCount, &nphy,
+					      sizeof(nphy)),
+	       will_return(VK_SUCCESS), when(instance, is_equal_to(instance)));
+	set_required_extensions();
+}
+
+Ensure(configure_selects_device_with_highest_score)
+{
+	struct vkrenderer rdr = { 0 };
+	VkInstance instance = VK_NULL_HANDLE;
+	VkPhysicalDevice phy[] = { (VkPhysicalDevice)1, (VkPhysicalDevice)2 };
+	VkPhysicalDeviceProperties props = {
+		.apiVersion = VK_API_VERSION_1_1,
+	};
+	expect_two_devices(instance, phy);
+	expect(vkrenderer_score_device, will_return(1000),
+	       when(phy, is_equal_to(phy[0])));
+	expect(vkrenderer_score_device, will_return(2000),
+	       when(phy, is_equal_to(phy[1])));
+	expect(vkGetPhysicalDeviceProperties,
+	       will_set_contents_of_parameter(pProperties, &props,
+					      sizeof(props)),
+	       when(physicalDevice, is_equal_to(phy[1])));
+	expect(vkrenderer_configure_families, will_return(0));
+	expect(vkrenderer_configure_swapchain, will_return(0));
+	int result = vkrenderer_configure(&rdr, instance);
+	assert_that(result, is_equal_to(0));
+	assert_that(rdr.phy, is_equal_to(phy[1]));
+}
+
+Ensure(configure_falls_back_to_lower_scored_device)
+{
+	struct vkrenderer rdr = { 0 };
+	VkInstance instance = VK_NULL_HANDLE;
+	VkPhysicalDevice phy[] = { (VkPhysicalDevice)1, (VkPhysicalDevice)2 };
+	VkPhysicalDeviceProperties props = {
+		.apiVersion = VK_API_VERSION_1_1,
+	};
+	expect_two_devices(instance, phy);
+	expect(vkrenderer_score_device, will_return(2000));
+	expect(vkrenderer_score_device, will_return(1000));
+	always_expect(vkGetPhysicalDeviceProperties,
+		      will_set_contents_of_parameter(pProperties, &props,
+						     sizeof(props)));
+	expect(vkrenderer_configure_families, will_return(-1));
+	expect(vkrenderer_configure_families, will_return(0));
+	expect(vkrenderer_configure_swapchain, will_return(0));
+	int result = vkrenderer_configure(&rdr, instance);
+	assert_that(result, is_equal_to(0));
+	assert_that(rdr.phy, is_equal_to(phy[1]));
+}
+
+Ensure(configure_uses_cached_device_without_probing)
+{
+	struct vkrenderer rdr = { .device_cache = "device.cache" };
+	VkInstance instance = VK_NULL_HANDLE;
+	VkPhysicalDevice phy[] = { (VkPhysicalDevice)1, (VkPhysicalDevice)2 };
+	VkPhysicalDeviceProperties props = {
+		.apiVersion = VK_API_VERSION_1_1,
+	};
+	struct vkdevcache cache = {
+		.graphic = 2, .graphic_nqueues = 6, .present = 3,
+		.compute = 5, .transfer = 4,
+	};
+	VkBool32 supported = VK_TRUE;
+	expect_two_devices(instance, phy);
+	expect(vkdevcache_load,
+	       will_set_contents_of_parameter(cache, &cache, sizeof(cache)),
+	       will_return(0), when(path, is_equal_to_string("device.cache")));
+	expect(vkdevcache_matches, will_return(0));
+	expect(vkdevcache_matches, will_return(1));
+	expect(vkGetPhysicalDeviceProperties,
+	       will_set_contents_of_parameter(pProperties, &props,
+					      sizeof(props)));
+	expect(vkGetPhysicalDeviceSurfaceSupportKHR,
+	       will_set_contents_of_parameter(pSupported, &supported,
+					      sizeof(supported)),
+	       will_return(VK_SUCCESS), when(queueFamilyIndex, is_equal_to(3)));
+	expect(vkrenderer_configure_swapchain, will_return(0));
+	never_expect(vkrenderer_score_device);
+	never_expect(vkrenderer_configure_families);
+	never_expect(vkdevcache_save);
+	int result = vkrenderer_configure(&rdr, instance);
+	assert_that(result, is_equal_to(0));
+	assert_that(rdr.phy, is_equal_to(phy[1]));
+	assert_that(rdr.graphic, is_equal_to(2));
+	assert_that(rdr.present, is_equal_to(3));
+	assert_that(rdr.graphic_nqueues, is_equal_to(6));
+	assert_that(rdr.compute, is_equal_to(5));
+	assert_that(rdr.transfer, is_equal_to(4));
+}
+
+Ensure(configure_probes_and_saves_device_when_cache_is_stale)
+{
+	struct vkrenderer rdr = { .device_cache = "device.cache" };
+	VkInstance instance = VK_NULL_HANDLE;
+	VkPhysicalDevice phy = VK_NULL_HANDLE;
+	VkPhysicalDeviceProperties props = {
+		.apiVersion = VK_API_VERSION_1_1,
+	};
+	expect_single_device(instance, &phy, &props);
+	expect(vkdevcache_load, will_return(0));
+	expect(vkdevcache_matches, will_return(0));
+	expect(vkdevcache_identify, will_return(0));
+	expect(vkdevcache_save, when(path, is_equal_to_string("device.cache")));
+	int result = vkrenderer_configure(&rdr, instance);
+	assert_that(result, is_equal_to(0));
+}
+
 int main(int argc, char **argv)
 {
 	(void)(argc);
@@ -119,6 +570,19 @@ int main(int argc, char **argv)
 	add_test(vkr, configure_selects_suitable_device);
 	add_test(vkr, configure_fails_when_no_suitable_families_available);
 	add_test(vkr, configure_fails_when_no_suitable_swapchain_available);
+	add_test(vkr, configure_enables_timeline_semaphore_when_supported);
+	add_test(vkr, configure_skips_timeline_semaphore_when_not_supported);
+	add_test(vkr, configure_skips_timeline_semaphore_on_vulkan_1_1_device);
+	add_test(vkr, configure_prefers_dynamic_rendering);
+	add_test(vkr, configure_falls_back_to_imageless_framebuffer);
+	add_test(vkr, configure_skips_device_without_swapchain_extension);
+	add_test(vkr, configure_enables_supported_optional_extensions);
+	add_test(vkr, configure_enables_performance_features);
+	add_test(vkr, configure_selects_device_with_highest_score);
+	add_test(vkr, configure_falls_back_to_lower_scored_device);
+	add_test(vkr, configure_uses_cached_device_without_probing);
+	add_test(vkr,
+		 configure_probes_and_saves_device_when_cache_is_stale);
 	TestReporter *reporter = create_text_reporter();
 	int exit_code = run_test_suite(vkr, reporter);
 	destroy_reporter(reporter);
@@ -0,0 +1,194 @@
+/**
+ * @file
+ * Memory budget of heaps and evictable resources implementation
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "vkbudget.h"
+#include "vkmemory.h"
+#include <vulkan/vulkan_core.h>
+
+void vkbudget_init(struct vkbudget *bdg, const struct vkmemory *mem,
+		   VkPhysicalDevice phy, int supported)
+{
+	bdg->phy = phy;
+	bdg->mem = mem;
+	bdg->supported = supported;
+	for (uint32_t i = 0; i < VK_MAX_MEMORY_HEAPS; ++i)
+		bdg->evictable[i] = 0;
+	bdg->lru = NULL;
+	bdg->mru = NULL;
+	bdg->nevictions = 0;
+	bdg->nevicted = 0;
+	vkbudget_update(bdg);
+}
+
+/**
+ * Queries budget and usage of heaps reported by device
+ * @param bdg Specifies budget to query
+ * @param budget Specifies pointer where budget must be stored
+ */
+static void vkbudget_query(const struct vkbudget *bdg,
+			   VkPhysicalDeviceMemoryBudgetPropertiesEXT *budget)
+{
+	VkPhysicalDeviceMemoryProperties2 props = {
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2,
+		.pNext = budget,
+	};
+	budget->sType =
+		VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+	budget->pNext = NULL;
+	vkGetPhysicalDeviceMemoryProperties2(bdg->phy, &props);
+}
+
+void vkbudget_update(struct vkbudget *bdg)
+{
+	const VkPhysicalDeviceMemoryProperties *props = &bdg->mem->props;
+	VkPhysicalDeviceMemoryBudgetPropertiesEXT budget;
+	if (bdg->supported)
+		vkbudget_query(bdg, &budget);
+	for (uint32_t i = 0; i < props->memoryHeapCount; ++i) {
+		struct vkbudget_heap *heap = &bdg->heaps[i];
+		heap->allocated = bdg->mem->heaps[i].allocated;
+		if (bdg->supported) {
+			heap->budget = budget.heapBudget[i];
+			heap->usage = budget.heapUsage[i];
+		} else {
+			/* Other processes are assumed to leave some memory */
+			heap->budget = props->memoryHeaps[i].size / 100 *
+				       VKBUDGET_DEFAULT_PERCENT;
+			heap->usage = heap->allocated;
+		}
+	}
+}
+
+/**
+ * Returns estimated usage of heap
+ * @param bdg Specifies budget of heap
+ * @param heap Specifies index of heap
+ * @returns number of bytes used by the process
+ */
+static VkDeviceSize vkbudget_usage(const struct vkbudget *bdg, uint32_t heap)
+{
+	const struct vkbudget_heap *info = &bdg->heaps[heap];
+	const VkDeviceSize allocated = bdg->mem->heaps[heap].allocated;
+	/* Memory allocated or released since query changes usage as much */
+	if (allocated >= info->allocated)
+		return info->usage + (allocated - info->allocated);
+	const VkDeviceSize released = info->allocated - allocated;
+	return (info->usage > released) ? info->usage - released : 0;
+}
+
+void vkbudget_stats(const struct vkbudget *bdg, uint32_t heap,
+		    struct vkbudget_stats *stats)
+{
+	stats->budget = bdg->heaps[heap].budget;
+	stats->usage = vkbudget_usage(bdg, heap);
+	stats->evictable = bdg->evictable[heap];
+}
+
+/**
+ * Removes resource from list of resources
+ * @param bdg Specifies budget tracking resource
+ * @param res Specifies resource to remove
+ */
+static void vkbudget_unlink(struct vkbudget *bdg,
+			    struct vkbudget_resource *res)
+{
+	if (res->prev != NULL)
+		res->prev->next = res->next;
+	else
+		bdg->lru = res->next;
+	if (res->next != NULL)
+		res->next->prev = res->prev;
+	else
+		bdg->mru = res->prev;
+	res->prev = NULL;
+	res->next = NULL;
+}
+
+/**
+ * Appends resource to list as the most recently used one
+ * @param bdg Specifies budget tracking resource
+ * @param res Specifies resource to append
+ */
+static void vkbudget_link(struct vkbudget *bdg, struct vkbudget_resource *res)
+{
+	res->prev = bdg->mru;
+	res->next = NULL;
+	if (bdg->mru != NULL)
+		bdg->mru->next = res;
+	else
+		bdg->lru = res;
+	bdg->mru = res;
+}
+
+void vkbudget_track(struct vkbudget *bdg, struct vkbudget_resource *res,
+		    const struct vkmemory_alloc *alloc,
+		    vkbudget_evict_fn evict)
+{
+	res->evict = evict;
+	res->frame = 0;
+	res->size = alloc->size;
+	res->heap = bdg->mem->props.memoryTypes[alloc->type].heapIndex;
+	bdg->evictable[res->heap] += res->size;
+	vkbudget_link(bdg, res);
+}
+
+void vkbudget_untrack(struct vkbudget *bdg, struct vkbudget_resource *res)
+{
+	bdg->evictable[res->heap] -= res->size;
+	vkbudget_unlink(bdg, res);
+}
+
+void vkbudget_touch(struct vkbudget *bdg, struct vkbudget_resource *res,
+		    uint64_t frame)
+{
+	res->frame = frame;
+	if (bdg->mru == res)
+		return;
+	vkbudget_unlink(bdg, res);
+	vkbudget_link(bdg, res);
+}
+
+uint32_t vkbudget_trim(struct vkbudget *bdg, uint64_t completed)
+{
+	VkDeviceSize excess[VK_MAX_MEMORY_HEAPS];
+	int over = 0;
+	for (uint32_t i = 0; i < bdg->mem->props.memoryHeapCount; ++i) {
+		const VkDeviceSize budget = bdg->heaps[i].budget;
+		const VkDeviceSize usage = vkbudget_usage(bdg, i);
+		excess[i] = 0;
+		if (bdg->evictable[i] == 0 ||
+		    usage <= budget / 100 * VKBUDGET_HIGH_PERCENT)
+			continue;
+		/* Evicting down to low mark keeps trims from every frame */
+		excess[i] = usage - budget / 100 * VKBUDGET_LOW_PERCENT;
+		over = 1;
+	}
+	if (!over)
+		return 0;
+	uint32_t nevicted = 0;
+	struct vkbudget_resource *res = bdg->lru;
+	while (res != NULL && res->frame <= completed) {
+		struct vkbudget_resource *next = res->next;
+		if (excess[res->heap] > 0) {
+			const VkDeviceSize size = res->size;
+			excess[res->heap] -= (size < excess[res->heap]) ?
+						     size :
+						     excess[res->heap];
+			vkbudget_untrack(bdg, res);
+			bdg->nevictions++;
+			bdg->nevicted += size;
+			nevicted++;
+			res->evict(res);
+		}
+		res = next;
+	}
+	return nevicted;
+}
@@ -0,0 +1,168 @@
+#ifndef RENDERER_VKBUDGET_H
+#define RENDERER_VKBUDGET_H
+
+#include <stdint.h>
+
+#include <renderer/vkmemory.h>
+#include <vulkan/vulkan_core.h>
+
+/** Percentage of budget in use at which resources are evicted */
+#define VKBUDGET_HIGH_PERCENT 90
+
+/** Percentage of budget eviction brings usage down to */
+#define VKBUDGET_LOW_PERCENT 80
+
+/** Percentage of heap size used as budget if device reports none */
+#define VKBUDGET_DEFAULT_PERCENT 80
+
+/** Budget and usage of memory heap */
+struct vkbudget_heap {
+	/** Number of bytes the process may use without risk of failures */
+	VkDeviceSize budget;
+	/** Number of bytes used by the process when budget was queried */
+	VkDeviceSize usage;
+	/** Number of bytes allocated by allocator when budget was queried */
+	VkDeviceSize allocated;
+};
+
+struct vkbudget_resource;
+
+/**
+ * Evicts resource
+ *
+ * Resource is already untracked. Callback moves it to host memory or drops
+ * it, and releases its device memory.
+ * @param res Specifies resource to evict
+ */
+typedef void (*vkbudget_evict_fn)(struct vkbudget_resource *res);
+
+/** Resource which may be evicted, embedded into its owner */
+struct vkbudget_resource {
+	/** Less recently used resource, or NULL */
+	struct vkbudget_resource *prev;
+	/** More recently used resource, or NULL */
+	struct vkbudget_resource *next;
+	/** Callback evicting resource */
+	vkbudget_evict_fn evict;
+	/** Number of the last frame using resource */
+	uint64_t frame;
+	/** Size of resource memory */
+	VkDeviceSize size;
+	/** Heap of resource memory */
+	uint32_t heap;
+};
+
+/** Statistics of memory heap budget */
+struct vkbudget_stats {
+	/** Number of bytes the process may use */
+	VkDeviceSize budget;
+	/** Estimated number of bytes used by the process */
+	VkDeviceSize usage;
+	/** Number of bytes of evictable resources */
+	VkDeviceSize evictable;
+};
+
+/**
+ * Memory budget of heaps and evictable resources
+ *
+ * Heap budgets come from VK_EXT_memory_budget if device supports it, or
+ * are estimated from heap sizes otherwise. Between queries usage follows
+ * device memory allocated by allocator. Resources are kept in order of use,
+ * so eviction starts from the least recently used ones. Budget is not
+ * thread-safe.
+ */
+struct vkbudget {
+	/** Physical device budget is queried from */
+	VkPhysicalDevice phy;
+	/** Allocator of tracked memory */
+	const struct vkmemory *mem;
+	/** Non-zero if device reports budget */
+	int supported;
+	/** Budget and usage of heaps */
+	struct vkbudget_heap heaps[VK_MAX_MEMORY_HEAPS];
+	/** Number of bytes of evictable resources per heap */
+	VkDeviceSize evictable[VK_MAX_MEMORY_HEAPS];
+	/** The least recently used resource, or NULL */
+	struct vkbudget_resource *lru;
+	/** The most recently used resource, or NULL */
+	struct vkbudget_resource *mru;
+	/** Number of resources evicted */
+	uint64_t nevictions;
+	/** Number of bytes of resources evicted */
+	uint64_t nevicted;
+};
+
+#ifdef __cplusplus
+/* *INDENT-OFF* */
+extern "C" {
+/* *INDENT-ON* */
+#endif
+
+/**
+ * Initializes budget and queries it
+ * @param bdg Specifies budget to initialize
+ * @param mem Specifies allocator of tracked memory
+ * @param phy Specifies physical device of allocator's device
+ * @param supported Specifies non-zero if VK_EXT_memory_budget is enabled
+ */
+void vkbudget_init(struct vkbudget *bdg, const struct vkmemory *mem,
+		   VkPhysicalDevice phy, int supported);
+
+/**
+ * Queries budget and usage of heaps
+ * @param bdg Specifies budget to update
+ */
+void vkbudget_update(struct vkbudget *bdg);
+
+/**
+ * Returns statistics of heap budget
+ * @param bdg Specifies budget to inspect
+ * @param heap Specifies index of heap
+ * @param stats Specifies pointer where statistics must be stored
+ */
+void vkbudget_stats(const struct vkbudget *bdg, uint32_t heap,
+		    struct vkbudget_stats *stats);
+
+/**
+ * Starts tracking resource as evictable
+ * @param bdg Specifies budget to track resource in
+ * @param res Specifies resource to track
+ * @param alloc Specifies memory of resource
+ * @param evict Specifies callback evicting resource
+ */
+void vkbudget_track(struct vkbudget *bdg, struct vkbudget_resource *res,
+		    const struct vkmemory_alloc *alloc,
+		    vkbudget_evict_fn evict);
+
+/**
+ * Stops tracking resource, before its owner destroys it
+ * @param bdg Specifies budget tracking resource
+ * @param res Specifies resource to untrack
+ */
+void vkbudget_untrack(struct vkbudget *bdg, struct vkbudget_resource *res);
+
+/**
+ * Marks resource as used by frame
+ * @param bdg Specifies budget tracking resource
+ * @param res Specifies resource used
+ * @param frame Specifies number of frame using resource
+ */
+void vkbudget_touch(struct vkbudget *bdg, struct vkbudget_resource *res,
+		    uint64_t frame);
+
+/**
+ * Evicts the least recently used resources of heaps nearing budget
+ *
+ * Resources used by incomplete frames are never evicted.
+ * @param bdg Specifies budget to trim
+ * @param completed Specifies number of the last completed frame
+ * @returns number of resources evicted
+ */
+uint32_t vkbudget_trim(struct vkbudget *bdg, uint64_t completed);
+
+#ifdef __cplusplus
+/* *INDENT-OFF* */
+}
+/* *INDENT-ON* */
+#endif
+#endif
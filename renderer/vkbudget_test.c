@@ -0,0 +1,246 @@
+/**
+ * @file
+ * Test suite for vkbudget
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <cgreen/cgreen.h>
+#include <cgreen/mocks.h>
+
+#include <vulkan/vulkan_core.h>
+#include "vkbudget.h"
+#include "vkmemory.h"
+
+/** Size of device local heap */
+#define HEAP_SIZE ((VkDeviceSize)1000 * 1000)
+
+/** Budget of device local heap reported by device */
+#define HEAP_BUDGET ((VkDeviceSize)10000)
+
+/** Usage of device local heap reported by device */
+static VkDeviceSize heap_usage;
+
+/** Resources evicted, in order of eviction */
+static struct vkbudget_resource *evicted[8];
+
+/** Number of resources evicted */
+static uint32_t nevicted;
+
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceMemoryProperties2(
+	VkPhysicalDevice physicalDevice,
+	VkPhysicalDeviceMemoryProperties2 *pMemoryProperties)
+{
+	VkPhysicalDeviceMemoryBudgetPropertiesEXT *budget =
+		pMemoryProperties->pNext;
+	budget->heapBudget[0] = HEAP_BUDGET;
+	budget->heapUsage[0] = heap_usage;
+	budget->heapBudget[1] = HEAP_BUDGET;
+	budget->heapUsage[1] = 0;
+	mock(physicalDevice, pMemoryProperties);
+}
+
+/**
+ * Records evicted resource
+ * @param res Specifies resource to evict
+ */
+static void evict(struct vkbudget_resource *res)
+{
+	evicted[nevicted++] = res;
+}
+
+/**
+ * Initializes allocator with device local and host heaps
+ * @param mem Specifies allocator to initialize
+ */
+static void init_memory(struct vkmemory *mem)
+{
+	mem->props.memoryHeapCount = 2;
+	mem->props.memoryHeaps[0].size = HEAP_SIZE;
+	mem->props.memoryHeaps[1].size = HEAP_SIZE;
+	mem->props.memoryTypeCount = 2;
+	mem->props.memoryTypes[0].heapIndex = 0;
+	mem->props.memoryTypes[1].heapIndex = 1;
+	mem->heaps[0].allocated = 0;
+	mem->heaps[1].allocated = 0;
+	nevicted = 0;
+}
+
+/**
+ * Initializes budget reporting usage of device local heap
+ * @param bdg Specifies budget to initialize
+ * @param mem Specifies allocator of tracked memory
+ * @param usage Specifies usage of device local heap
+ */
+static void init_budget(struct vkbudget *bdg, struct vkmemory *mem,
+			VkDeviceSize usage)
+{
+	init_memory(mem);
+	heap_usage = usage;
+	expect(vkGetPhysicalDeviceMemoryProperties2);
+	vkbudget_init(bdg, mem, VK_NULL_HANDLE, 1);
+}
+
+/**
+ * Tracks resource of device local heap
+ * @param bdg Specifies budget to track resource in
+ * @param res Specifies resource to track
+ * @param size Specifies size of resource memory
+ */
+static void track(struct vkbudget *bdg, struct vkbudget_resource *res,
+		  VkDeviceSize size)
+{
+	const struct vkmemory_alloc alloc = {
+		.size = size,
+		.type = 0,
+	};
+	vkbudget_track(bdg, res, &alloc, evict);
+}
+
+Ensure(init_queries_budget_reported_by_device)
+{
+	struct vkbudget bdg;
+	struct vkmemory mem;
+	struct vkbudget_stats stats;
+	init_budget(&bdg, &mem, 4000);
+	vkbudget_stats(&bdg, 0, &stats);
+	assert_that(stats.budget, is_equal_to(HEAP_BUDGET));
+	assert_that(stats.usage, is_equal_to(4000));
+	assert_that(stats.evictable, is_equal_to(0));
+}
+
+Ensure(init_estimates_budget_without_extension)
+{
+	struct vkbudget bdg;
+	struct vkmemory mem;
+	struct vkbudget_stats stats;
+	init_memory(&mem);
+	mem.heaps[0].allocated = 300;
+	never_expect(vkGetPhysicalDeviceMemoryProperties2);
+	vkbudget_init(&bdg, &mem, VK_NULL_HANDLE, 0);
+	vkbudget_stats(&bdg, 0, &stats);
+	assert_that(stats.budget,
+		    is_equal_to(HEAP_SIZE / 100 * VKBUDGET_DEFAULT_PERCENT));
+	assert_that(stats.usage, is_equal_to(300));
+}
+
+Ensure(stats_follow_allocations_since_query)
+{
+	struct vkbudget bdg;
+	struct vkmemory mem;
+	struct vkbudget_stats stats;
+	init_budget(&bdg, &mem, 4000);
+	mem.heaps[0].allocated = 1500;
+	vkbudget_stats(&bdg, 0, &stats);
+	assert_that(stats.usage, is_equal_to(5500));
+	expect(vkGetPhysicalDeviceMemoryProperties2);
+	vkbudget_update(&bdg);
+	mem.heaps[0].allocated = 500;
+	vkbudget_stats(&bdg, 0, &stats);
+	assert_that(stats.usage, is_equal_to(3000));
+}
+
+Ensure(track_counts_evictable_memory_of_heap)
+{
+	struct vkbudget bdg;
+	struct vkmemory mem;
+	struct vkbudget_resource res;
+	struct vkbudget_stats stats;
+	init_budget(&bdg, &mem, 4000);
+	track(&bdg, &res, 700);
+	vkbudget_stats(&bdg, 0, &stats);
+	assert_that(stats.evictable, is_equal_to(700));
+	vkbudget_untrack(&bdg, &res);
+	vkbudget_stats(&bdg, 0, &stats);
+	assert_that(stats.evictable, is_equal_to(0));
+	assert_that(bdg.lru, is_null);
+}
+
+Ensure(trim_keeps_resources_under_high_mark)
+{
+	struct vkbudget bdg;
+	struct vkmemory mem;
+	struct vkbudget_resource res;
+	init_budget(&bdg, &mem, HEAP_BUDGET / 100 * VKBUDGET_HIGH_PERCENT);
+	track(&bdg, &res, 1000);
+	uint32_t count = vkbudget_trim(&bdg, 10);
+	assert_that(count, is_equal_to(0));
+	assert_that(nevicted, is_equal_to(0));
+}
+
+Ensure(trim_evicts_least_recently_used_down_to_low_mark)
+{
+	struct vkbudget bdg;
+	struct vkmemory mem;
+	struct vkbudget_resource res[3];
+	init_budget(&bdg, &mem, 9500);
+	for (int i = 0; i < 3; ++i)
+		track(&bdg, &res[i], 1000);
+	vkbudget_touch(&bdg, &res[1], 1);
+	vkbudget_touch(&bdg, &res[2], 2);
+	vkbudget_touch(&bdg, &res[0], 3);
+	uint32_t count = vkbudget_trim(&bdg, 3);
+	assert_that(count, is_equal_to(2));
+	assert_that(evicted[0], is_equal_to(&res[1]));
+	assert_that(evicted[1], is_equal_to(&res[2]));
+	assert_that(bdg.lru, is_equal_to(&res[0]));
+	assert_that(bdg.nevicted, is_equal_to(2000));
+}
+
+Ensure(trim_never_evicts_resources_of_pending_frames)
+{
+	struct vkbudget bdg;
+	struct vkmemory mem;
+	struct vkbudget_resource res[2];
+	init_budget(&bdg, &mem, 9500);
+	track(&bdg, &res[0], 1000);
+	track(&bdg, &res[1], 1000);
+	vkbudget_touch(&bdg, &res[0], 4);
+	vkbudget_touch(&bdg, &res[1], 5);
+	uint32_t count = vkbudget_trim(&bdg, 4);
+	assert_that(count, is_equal_to(1));
+	assert_that(evicted[0], is_equal_to(&res[0]));
+}
+
+Ensure(trim_evicts_only_resources_of_heaps_over_budget)
+{
+	struct vkbudget bdg;
+	struct vkmemory mem;
+	struct vkbudget_resource host;
+	struct vkbudget_resource local;
+	const struct vkmemory_alloc alloc = {
+		.size = 1000,
+		.type = 1,
+	};
+	init_budget(&bdg, &mem, 9500);
+	vkbudget_track(&bdg, &host, &alloc, evict);
+	track(&bdg, &local, 1000);
+	vkbudget_trim(&bdg, 0);
+	assert_that(nevicted, is_equal_to(1));
+	assert_that(evicted[0], is_equal_to(&local));
+	assert_that(bdg.lru, is_equal_to(&host));
+}
+
+int main(int argc, char **argv)
+{
+	(void)(argc);
+	(void)(argv);
+	TestSuite *suite = create_named_test_suite("VKBudget");
+	add_test(suite, init_queries_budget_reported_by_device);
+	add_test(suite, init_estimates_budget_without_extension);
+	add_test(suite, stats_follow_allocations_since_query);
+	add_test(suite, track_counts_evictable_memory_of_heap);
+	add_test(suite, trim_keeps_resources_under_high_mark);
+	add_test(suite, trim_evicts_least_recently_used_down_to_low_mark);
+	add_test(suite, trim_never_evicts_resources_of_pending_frames);
+	add_test(suite, trim_evicts_only_resources_of_heaps_over_budget);
+	TestReporter *reporter = create_text_reporter();
+	int exit_code = run_test_suite(suite, reporter);
+	destroy_reporter(reporter);
+	destroy_test_suite(suite);
+	return exit_code;
+}
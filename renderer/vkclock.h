@@ -0,0 +1,18 @@
+#ifndef RENDERER_VKCLOCK_H
+#define RENDERER_VKCLOCK_H
+
+#include <stdint.h>
+#include <time.h>
+
+/**
+ * Returns current time of monotonic clock
+ * @returns time in nanoseconds
+ */
+static inline uint64_t vkclock_ns(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000U + (uint64_t)now.tv_nsec;
+}
+
+#endif
@@ -0,0 +1,87 @@
+/**
+ * @file
+ * Vulkan command buffer recycler implementation
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "vkcmdpool.h"
+#include <vulkan/vulkan_core.h>
+
+VkResult vkcmdpool_init(struct vkcmdpool *cp, VkDevice dev, uint32_t family,
+			const VkAllocationCallbacks *host)
+{
+	/* Buffers are reset one by one when reused */
+	const VkCommandPoolCreateInfo info = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+		.pNext = NULL,
+		.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+		.queueFamilyIndex = family,
+	};
+	cp->free = NULL;
+	cp->nfree = 0;
+	cp->capacity = 0;
+	cp->nlive = 0;
+	cp->host = host;
+	return vkCreateCommandPool(dev, &info, host, &cp->pool);
+}
+
+VkResult vkcmdpool_acquire(struct vkcmdpool *cp, VkDevice dev,
+			   const struct vkdispatch *vkd, VkCommandBuffer *cmds)
+{
+	VkResult result;
+	if (cp->nfree > 0) {
+		/* Reset keeps memory of buffer, so re-recording doesn't grow */
+		result = vkd->vkResetCommandBuffer(cp->free[cp->nfree - 1], 0);
+		if (result != VK_SUCCESS)
+			return result;
+		*cmds = cp->free[--cp->nfree];
+	} else {
+		const VkCommandBufferAllocateInfo info = {
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+			.pNext = NULL,
+			.commandPool = cp->pool,
+			.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+			.commandBufferCount = 1,
+		};
+		result = vkAllocateCommandBuffers(dev, &info, cmds);
+		if (result != VK_SUCCESS)
+			return result;
+	}
+	cp->nlive++;
+	return VK_SUCCESS;
+}
+
+void vkcmdpool_release(struct vkcmdpool *cp, VkDevice dev,
+		       VkCommandBuffer cmds)
+{
+	cp->nlive--;
+	if (cp->nfree == cp->capacity) {
+		size_t capacity = cp->capacity ? cp->capacity * 2 : 8;
+		VkCommandBuffer *free_cmds =
+			realloc(cp->free, sizeof(VkCommandBuffer) * capacity);
+		if (free_cmds == NULL) {
+			vkFreeCommandBuffers(dev, cp->pool, 1, &cmds);
+			return;
+		}
+		cp->free = free_cmds;
+		cp->capacity = capacity;
+	}
+	cp->free[cp->nfree++] = cmds;
+}
+
+void vkcmdpool_destroy(struct vkcmdpool *cp, VkDevice dev)
+{
+	/* Destroying pool frees all buffers allocated from it */
+	vkDestroyCommandPool(dev, cp->pool, cp->host);
+	free(cp->free);
+	cp->free = NULL;
+	cp->nfree = 0;
+	cp->capacity = 0;
+	cp->nlive = 0;
+}
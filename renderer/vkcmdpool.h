@@ -0,0 +1,78 @@
+#ifndef RENDERER_VKCMDPOOL_H
+#define RENDERER_VKCMDPOOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <renderer/vkdispatch.h>
+#include <vulkan/vulkan_core.h>
+
+/** Recycler of primary command buffers allocated from single pool */
+struct vkcmdpool {
+	/** Command pool buffers are allocated from */
+	VkCommandPool pool;
+	/** Released buffers ready for reuse */
+	VkCommandBuffer *free;
+	/** Number of released buffers */
+	size_t nfree;
+	/** Number of elements @a free array can hold */
+	size_t capacity;
+	/** Number of acquired buffers that are not released yet */
+	size_t nlive;
+	/** Host memory allocator of driver, or NULL */
+	const VkAllocationCallbacks *host;
+};
+
+#ifdef __cplusplus
+/* *INDENT-OFF* */
+extern "C" {
+/* *INDENT-ON* */
+#endif
+
+/**
+ * Initializes command buffer recycler
+ * @param cp Specifies recycler to initialize
+ * @param dev Specifies device to create command pool on
+ * @param family Specifies queue family index buffers will be submitted to
+ * @param host Specifies host memory allocator of driver, or NULL
+ * @returns VK_SUCCESS on success, or VkResult error otherwise
+ */
+VkResult vkcmdpool_init(struct vkcmdpool *cp, VkDevice dev, uint32_t family,
+			const VkAllocationCallbacks *host);
+
+/**
+ * Acquires reset primary command buffer, reusing released one if possible
+ * @param cp Specifies recycler to acquire buffer from
+ * @param dev Specifies device the recycler belongs to
+ * @param vkd Specifies dispatch table of @a dev
+ * @param cmds Specifies pointer to memory where buffer must be stored
+ * @returns VK_SUCCESS on success, or VkResult error otherwise
+ */
+VkResult vkcmdpool_acquire(struct vkcmdpool *cp, VkDevice dev,
+			   const struct vkdispatch *vkd, VkCommandBuffer *cmds);
+
+/**
+ * Releases command buffer for reuse
+ *
+ * Buffer must not be pending execution. If it can't be kept for reuse, it is
+ * freed back to command pool.
+ * @param cp Specifies recycler buffer was acquired from
+ * @param dev Specifies device the recycler belongs to
+ * @param cmds Specifies buffer to release
+ */
+void vkcmdpool_release(struct vkcmdpool *cp, VkDevice dev,
+		       VkCommandBuffer cmds);
+
+/**
+ * Destroys command pool with all of its buffers
+ * @param cp Specifies recycler to destroy
+ * @param dev Specifies device the recycler belongs to
+ */
+void vkcmdpool_destroy(struct vkcmdpool *cp, VkDevice dev);
+
+#ifdef __cplusplus
+/* *INDENT-OFF* */
+}
+/* *INDENT-ON* */
+#endif
+#endif
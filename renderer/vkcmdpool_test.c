@@ -0,0 +1,190 @@
+/**
+ * @file
+ * Test suite for vkcmdpool
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <cgreen/cgreen.h>
+#include <cgreen/mocks.h>
+
+#include <vulkan/vulkan_core.h>
+#include "vkcmdpool.h"
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateCommandPool(
+	VkDevice device, const VkCommandPoolCreateInfo *pCreateInfo,
+	const VkAllocationCallbacks *pAllocator, VkCommandPool *pCommandPool)
+{
+	return (VkResult)mock(device, pCreateInfo, pAllocator, pCommandPool);
+}
+
+VKAPI_ATTR void VKAPI_CALL
+vkDestroyCommandPool(VkDevice device, VkCommandPool commandPool,
+		     const VkAllocationCallbacks *pAllocator)
+{
+	mock(device, commandPool, pAllocator);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkAllocateCommandBuffers(VkDevice device,
+			 const VkCommandBufferAllocateInfo *pAllocateInfo,
+			 VkCommandBuffer *pCommandBuffers)
+{
+	return (VkResult)mock(device, pAllocateInfo, pCommandBuffers);
+}
+
+VKAPI_ATTR void VKAPI_CALL
+vkFreeCommandBuffers(VkDevice device, VkCommandPool commandPool,
+		     uint32_t commandBufferCount,
+		     const VkCommandBuffer *pCommandBuffers)
+{
+	mock(device, commandPool, commandBufferCount, pCommandBuffers);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkResetCommandBuffer(VkCommandBuffer commandBuffer,
+		     VkCommandBufferResetFlags flags)
+{
+	return (VkResult)mock(commandBuffer, flags);
+}
+
+/** Dispatch table calling fake device functions */
+static const struct vkdispatch mocked_dispatch = {
+	.vkResetCommandBuffer = vkResetCommandBuffer,
+};
+
+Ensure(init_creates_resettable_command_pool)
+{
+	struct vkcmdpool cp;
+	const VkAllocationCallbacks host = { 0 };
+	expect(vkCreateCommandPool, will_return(VK_SUCCESS),
+	       when(pAllocator, is_equal_to(&host)),
+	       when(pCommandPool, is_equal_to(&cp.pool)));
+	VkResult result = vkcmdpool_init(&cp, VK_NULL_HANDLE, 0, &host);
+	assert_that(result, is_equal_to(VK_SUCCESS));
+	assert_that(cp.nlive, is_equal_to(0));
+	assert_that(cp.nfree, is_equal_to(0));
+}
+
+Ensure(init_returns_error_on_command_pool_fail)
+{
+	struct vkcmdpool cp;
+	expect(vkCreateCommandPool, will_return(VK_ERROR_OUT_OF_HOST_MEMORY));
+	VkResult result = vkcmdpool_init(&cp, VK_NULL_HANDLE, 0, NULL);
+	assert_that(result, is_equal_to(VK_ERROR_OUT_OF_HOST_MEMORY));
+}
+
+Ensure(acquire_allocates_buffer_when_none_released)
+{
+	struct vkcmdpool cp = { 0 };
+	VkCommandBuffer allocated = (VkCommandBuffer)1;
+	VkCommandBuffer cmds = VK_NULL_HANDLE;
+	expect(vkAllocateCommandBuffers, will_return(VK_SUCCESS),
+	       will_set_contents_of_parameter(pCommandBuffers, &allocated,
+					      sizeof(allocated)));
+	never_expect(vkResetCommandBuffer);
+	VkResult result = vkcmdpool_acquire(&cp, VK_NULL_HANDLE,
+					    &mocked_dispatch, &cmds);
+	assert_that(result, is_equal_to(VK_SUCCESS));
+	assert_that(cmds, is_equal_to(allocated));
+	assert_that(cp.nlive, is_equal_to(1));
+}
+
+Ensure(acquire_returns_error_on_allocation_fail)
+{
+	struct vkcmdpool cp = { 0 };
+	VkCommandBuffer cmds = VK_NULL_HANDLE;
+	expect(vkAllocateCommandBuffers,
+	       will_return(VK_ERROR_OUT_OF_DEVICE_MEMORY));
+	VkResult result = vkcmdpool_acquire(&cp, VK_NULL_HANDLE,
+					    &mocked_dispatch, &cmds);
+	assert_that(result, is_equal_to(VK_ERROR_OUT_OF_DEVICE_MEMORY));
+	assert_that(cp.nlive, is_equal_to(0));
+}
+
+Ensure(acquire_resets_and_reuses_released_buffer)
+{
+	struct vkcmdpool cp = { 0 };
+	VkCommandBuffer released = (VkCommandBuffer)2;
+	VkCommandBuffer cmds = VK_NULL_HANDLE;
+	cp.nlive = 1;
+	vkcmdpool_release(&cp, VK_NULL_HANDLE, released);
+	never_expect(vkAllocateCommandBuffers);
+	expect(vkResetCommandBuffer, will_return(VK_SUCCESS),
+	       when(commandBuffer, is_equal_to(released)));
+	VkResult result = vkcmdpool_acquire(&cp, VK_NULL_HANDLE,
+					    &mocked_dispatch, &cmds);
+	assert_that(result, is_equal_to(VK_SUCCESS));
+	assert_that(cmds, is_equal_to(released));
+	assert_that(cp.nlive, is_equal_to(1));
+	assert_that(cp.nfree, is_equal_to(0));
+	free(cp.free);
+}
+
+Ensure(acquire_keeps_released_buffer_on_reset_fail)
+{
+	struct vkcmdpool cp = { 0 };
+	VkCommandBuffer cmds = VK_NULL_HANDLE;
+	cp.nlive = 1;
+	vkcmdpool_release(&cp, VK_NULL_HANDLE, (VkCommandBuffer)2);
+	expect(vkResetCommandBuffer, will_return(VK_ERROR_DEVICE_LOST));
+	VkResult result = vkcmdpool_acquire(&cp, VK_NULL_HANDLE,
+					    &mocked_dispatch, &cmds);
+	assert_that(result, is_equal_to(VK_ERROR_DEVICE_LOST));
+	assert_that(cp.nfree, is_equal_to(1));
+	assert_that(cp.nlive, is_equal_to(0));
+	free(cp.free);
+}
+
+Ensure(release_grows_free_list)
+{
+	struct vkcmdpool cp = { 0 };
+	cp.nlive = 20;
+	for (uintptr_t i = 1; i <= 20; ++i) {
+		vkcmdpool_release(&cp, VK_NULL_HANDLE, (VkCommandBuffer)i);
+	}
+	assert_that(cp.nfree, is_equal_to(20));
+	assert_that(cp.nlive, is_equal_to(0));
+	assert_that(cp.free[19], is_equal_to((VkCommandBuffer)20));
+	free(cp.free);
+}
+
+Ensure(destroy_destroys_command_pool)
+{
+	const VkAllocationCallbacks host = { 0 };
+	struct vkcmdpool cp = {
+		.pool = (VkCommandPool)3,
+		.host = &host,
+	};
+	cp.nlive = 1;
+	vkcmdpool_release(&cp, VK_NULL_HANDLE, (VkCommandBuffer)1);
+	expect(vkDestroyCommandPool, when(commandPool, is_equal_to(cp.pool)),
+	       when(pAllocator, is_equal_to(&host)));
+	vkcmdpool_destroy(&cp, VK_NULL_HANDLE);
+	assert_that(cp.free, is_equal_to(NULL));
+	assert_that(cp.nfree, is_equal_to(0));
+}
+
+int main(int argc, char **argv)
+{
+	(void)(argc);
+	(void)(argv);
+	TestSuite *suite = create_named_test_suite("VKCmdPool");
+	add_test(suite, init_creates_resettable_command_pool);
+	add_test(suite, init_returns_error_on_command_pool_fail);
+	add_test(suite, acquire_allocates_buffer_when_none_released);
+	add_test(suite, acquire_returns_error_on_allocation_fail);
+	add_test(suite, acquire_resets_and_reuses_released_buffer);
+	add_test(suite, acquire_keeps_released_buffer_on_reset_fail);
+	add_test(suite, release_grows_free_list);
+	add_test(suite, destroy_destroys_command_pool);
+	TestReporter *reporter = create_text_reporter();
+	int exit_code = run_test_suite(suite, reporter);
+	destroy_reporter(reporter);
+	destroy_test_suite(suite);
+	return exit_code;
+}
@@ -0,0 +1,260 @@
+/**
+ * @file
+ * Background compiler of graphics pipelines
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "vkclock.h"
+#include "vkcompiler.h"
+#include <vulkan/vulkan_core.h>
+
+/** Creation flags failing instead of compiling pipeline missing in cache */
+#define VKCOMPILER_LOOKUP \
+	VK_PIPELINE_CREATE_FAIL_ON_PIPELINE_COMPILE_REQUIRED_BIT
+
+/**
+ * Creates pipeline
+ * @param comp Specifies compiler
+ * @param cache Specifies pipeline cache, or VK_NULL_HANDLE
+ * @param pipe Specifies pipeline to create
+ * @param flags Specifies creation flags added to description of pipeline
+ * @returns result of vkCreateGraphicsPipelines
+ */
+static VkResult vkcompiler_create(const struct vkcompiler *comp,
+				  VkPipelineCache cache,
+				  struct vkcompiler_pipeline *pipe,
+				  VkPipelineCreateFlags flags)
+{
+	VkGraphicsPipelineCreateInfo info = *pipe->info;
+	info.flags |= flags;
+	return vkCreateGraphicsPipelines(comp->dev, cache, 1, &info,
+					 comp->host, &pipe->pipeline);
+}
+
+/**
+ * Creates empty cache used by one thread only
+ *
+ * Only cache misses are queued to threads when driver detects them, so
+ * pipelines compiled by thread are never in shared cache, and thread
+ * compiles them into own cache instead of locking shared one.
+ * @param comp Specifies compiler
+ * @returns created cache, or VK_NULL_HANDLE if thread uses shared cache
+ */
+static VkPipelineCache vkcompiler_create_cache(const struct vkcompiler *comp)
+{
+	if (comp->cache == VK_NULL_HANDLE || !comp->cache_control)
+		return VK_NULL_HANDLE;
+	const VkPipelineCacheCreateInfo info = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+		.flags = VK_PIPELINE_CACHE_CREATE_EXTERNALLY_SYNCHRONIZED_BIT,
+	};
+	VkPipelineCache cache = VK_NULL_HANDLE;
+	if (vkCreatePipelineCache(comp->dev, &info, comp->host, &cache))
+		return VK_NULL_HANDLE;
+	return cache;
+}
+
+/**
+ * Runs thread compiling queued pipelines until compiler quits
+ * @param arg Specifies worker of thread
+ * @returns NULL
+ */
+static void *vkcompiler_run(void *arg)
+{
+	const struct vkcompiler_worker *worker = arg;
+	struct vkcompiler *comp = worker->comp;
+	const VkPipelineCache cache = (worker->cache != VK_NULL_HANDLE) ?
+					      worker->cache :
+					      comp->cache;
+	pthread_mutex_lock(&comp->lock);
+	for (;;) {
+		while (!comp->quit && comp->head == NULL)
+			pthread_cond_wait(&comp->posted, &comp->lock);
+		if (comp->quit)
+			break;
+		struct vkcompiler_pipeline *pipe = comp->head;
+		comp->head = pipe->next;
+		if (comp->head == NULL)
+			comp->tail = NULL;
+		comp->nbusy++;
+		pthread_mutex_unlock(&comp->lock);
+		const uint64_t start = vkclock_ns();
+		pipe->result = vkcompiler_create(comp, cache, pipe, 0);
+		const uint64_t elapsed = vkclock_ns() - start;
+		pthread_mutex_lock(&comp->lock);
+		comp->nbusy--;
+		comp->compile_ns += elapsed;
+		if (pipe->result == VK_SUCCESS) {
+			comp->ncompiled++;
+			atomic_store(&pipe->state, VKCOMPILER_READY);
+		} else {
+			comp->nfailed++;
+			atomic_store(&pipe->state, VKCOMPILER_FAILED);
+		}
+		if (comp->head == NULL && comp->nbusy == 0)
+			pthread_cond_broadcast(&comp->drained);
+	}
+	pthread_mutex_unlock(&comp->lock);
+	return NULL;
+}
+
+int vkcompiler_init(struct vkcompiler *comp, VkDevice dev,
+		    VkPipelineCache cache, int cache_control, size_t nworkers,
+		    const VkAllocationCallbacks *host)
+{
+	comp->dev = dev;
+	comp->host = host;
+	comp->cache = cache;
+	comp->cache_control = cache_control;
+	comp->nworkers = 0;
+	comp->head = NULL;
+	comp->tail = NULL;
+	comp->nbusy = 0;
+	comp->quit = 0;
+	comp->ncompiled = 0;
+	comp->ncached = 0;
+	comp->nfailed = 0;
+	comp->compile_ns = 0;
+	atomic_init(&comp->nfallbacks, 0);
+	atomic_init(&comp->nskipped, 0);
+	if (pthread_mutex_init(&comp->lock, NULL))
+		return -1;
+	if (pthread_cond_init(&comp->posted, NULL))
+		goto destroy_lock;
+	if (pthread_cond_init(&comp->drained, NULL))
+		goto destroy_posted;
+	for (size_t i = 0; i < nworkers; ++i) {
+		struct vkcompiler_worker *worker = &comp->workers[i];
+		worker->comp = comp;
+		worker->cache = vkcompiler_create_cache(comp);
+		if (pthread_create(&worker->thread, NULL, vkcompiler_run,
+				   worker)) {
+			if (worker->cache != VK_NULL_HANDLE)
+				vkDestroyPipelineCache(dev, worker->cache,
+						       host);
+			vkcompiler_destroy(comp);
+			return -1;
+		}
+		comp->nworkers++;
+	}
+	return 0;
+destroy_posted:
+	pthread_cond_destroy(&comp->posted);
+destroy_lock:
+	pthread_mutex_destroy(&comp->lock);
+	return -1;
+}
+
+VkResult vkcompiler_request(struct vkcompiler *comp,
+			    struct vkcompiler_pipeline *pipe)
+{
+	int state = VKCOMPILER_IDLE;
+	if (!atomic_compare_exchange_strong(&pipe->state, &state,
+					    VKCOMPILER_PENDING)) {
+		if (state == VKCOMPILER_READY)
+			return VK_SUCCESS;
+		return (state == VKCOMPILER_FAILED) ? pipe->result :
+						      VK_NOT_READY;
+	}
+	if (comp->cache_control) {
+		/* Driver reports cache miss instead of compiling here */
+		pipe->result = vkcompiler_create(comp, comp->cache, pipe,
+						 VKCOMPILER_LOOKUP);
+		if (pipe->result == VK_SUCCESS) {
+			pthread_mutex_lock(&comp->lock);
+			comp->ncached++;
+			pthread_mutex_unlock(&comp->lock);
+			atomic_store(&pipe->state, VKCOMPILER_READY);
+			return VK_SUCCESS;
+		}
+		if (pipe->result != VK_PIPELINE_COMPILE_REQUIRED) {
+			atomic_store(&pipe->state, VKCOMPILER_FAILED);
+			return pipe->result;
+		}
+	}
+	pipe->next = NULL;
+	pthread_mutex_lock(&comp->lock);
+	if (comp->tail != NULL)
+		comp->tail->next = pipe;
+	else
+		comp->head = pipe;
+	comp->tail = pipe;
+	pthread_cond_signal(&comp->posted);
+	pthread_mutex_unlock(&comp->lock);
+	return VK_NOT_READY;
+}
+
+VkPipeline vkcompiler_select(struct vkcompiler *comp,
+			     const struct vkcompiler_pipeline *pipe)
+{
+	for (const struct vkcompiler_pipeline *p = pipe; p != NULL;
+	     p = p->fallback) {
+		if (atomic_load(&p->state) != VKCOMPILER_READY)
+			continue;
+		if (p != pipe)
+			atomic_fetch_add(&comp->nfallbacks, 1);
+		return p->pipeline;
+	}
+	atomic_fetch_add(&comp->nskipped, 1);
+	return VK_NULL_HANDLE;
+}
+
+void vkcompiler_wait(struct vkcompiler *comp)
+{
+	pthread_mutex_lock(&comp->lock);
+	while (comp->head != NULL || comp->nbusy > 0)
+		pthread_cond_wait(&comp->drained, &comp->lock);
+	pthread_mutex_unlock(&comp->lock);
+}
+
+void vkcompiler_release(struct vkcompiler *comp,
+			struct vkcompiler_pipeline *pipe)
+{
+	if (atomic_load(&pipe->state) == VKCOMPILER_READY)
+		vkDestroyPipeline(comp->dev, pipe->pipeline, comp->host);
+	pipe->pipeline = VK_NULL_HANDLE;
+	atomic_store(&pipe->state, VKCOMPILER_IDLE);
+}
+
+uint32_t vkcompiler_caches(const struct vkcompiler *comp,
+			   VkPipelineCache *caches)
+{
+	uint32_t count = 0;
+	for (size_t i = 0; i < comp->nworkers; ++i) {
+		if (comp->workers[i].cache != VK_NULL_HANDLE)
+			caches[count++] = comp->workers[i].cache;
+	}
+	return count;
+}
+
+void vkcompiler_destroy(struct vkcompiler *comp)
+{
+	pthread_mutex_lock(&comp->lock);
+	comp->quit = 1;
+	pthread_cond_broadcast(&comp->posted);
+	pthread_mutex_unlock(&comp->lock);
+	for (size_t i = 0; i < comp->nworkers; ++i) {
+		struct vkcompiler_worker *worker = &comp->workers[i];
+		pthread_join(worker->thread, NULL);
+		if (worker->cache != VK_NULL_HANDLE)
+			vkDestroyPipelineCache(comp->dev, worker->cache,
+					       comp->host);
+	}
+	comp->nworkers = 0;
+	for (struct vkcompiler_pipeline *pipe = comp->head; pipe != NULL;
+	     pipe = pipe->next) {
+		atomic_store(&pipe->state, VKCOMPILER_IDLE);
+	}
+	comp->head = NULL;
+	comp->tail = NULL;
+	pthread_cond_destroy(&comp->drained);
+	pthread_cond_destroy(&comp->posted);
+	pthread_mutex_destroy(&comp->lock);
+}
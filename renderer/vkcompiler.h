@@ -0,0 +1,190 @@
+#ifndef RENDERER_VKCOMPILER_H
+#define RENDERER_VKCOMPILER_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vulkan/vulkan_core.h>
+
+/** Maximum number of compiling threads */
+#define VKCOMPILER_MAX_WORKERS 8
+
+/** State of requested pipeline */
+enum vkcompiler_state {
+	/** Pipeline is not requested yet */
+	VKCOMPILER_IDLE = 0,
+	/** Pipeline is waiting for or being compiled by thread */
+	VKCOMPILER_PENDING,
+	/** Pipeline is compiled and can be bound */
+	VKCOMPILER_READY,
+	/** Driver failed to compile pipeline */
+	VKCOMPILER_FAILED,
+};
+
+/** Graphics pipeline compiled by compiler */
+struct vkcompiler_pipeline {
+	/** Description of pipeline, must outlive compilation */
+	const VkGraphicsPipelineCreateInfo *info;
+	/** Pipeline bound while this one compiles, or NULL to skip draws */
+	const struct vkcompiler_pipeline *fallback;
+	/** Compiled pipeline, valid once @a state is VKCOMPILER_READY */
+	VkPipeline pipeline;
+	/** State of pipeline, see enum vkcompiler_state */
+	atomic_int state;
+	/** Result of the last compilation */
+	VkResult result;
+	/** Next pipeline in queue of compiler */
+	struct vkcompiler_pipeline *next;
+};
+
+struct vkcompiler;
+
+/** Thread of compiler */
+struct vkcompiler_worker {
+	/** Compiler the thread belongs to */
+	struct vkcompiler *comp;
+	/** Running thread */
+	pthread_t thread;
+	/** Cache of pipelines compiled by thread, or VK_NULL_HANDLE */
+	VkPipelineCache cache;
+};
+
+/**
+ * Threads compiling graphics pipelines in background
+ *
+ * Draw needing pipeline that is not compiled yet binds its fallback, or is
+ * skipped, instead of stalling frame on driver compiler. With pipeline
+ * creation cache control, pipeline found in cache is created right away on
+ * requesting thread, and only cache misses are queued to threads. Threads
+ * then compile into caches of their own, not shared with other threads,
+ * which are merged into shared cache with vkcompiler_caches.
+ */
+struct vkcompiler {
+	/** Device pipelines are created on */
+	VkDevice dev;
+	/** Host memory allocator of driver, or NULL */
+	const VkAllocationCallbacks *host;
+	/** Cache shared by every pipeline creation, or VK_NULL_HANDLE */
+	VkPipelineCache cache;
+	/** Non-zero if cache misses are detected by driver */
+	int cache_control;
+	/** Compiling threads */
+	struct vkcompiler_worker workers[VKCOMPILER_MAX_WORKERS];
+	/** Number of running threads */
+	size_t nworkers;
+	/** Guards queue and statistics below */
+	pthread_mutex_t lock;
+	/** Signaled when pipeline is queued or threads must quit */
+	pthread_cond_t posted;
+	/** Signaled when queue is drained and threads are idle */
+	pthread_cond_t drained;
+	/** The first queued pipeline, or NULL */
+	struct vkcompiler_pipeline *head;
+	/** The last queued pipeline, or NULL */
+	struct vkcompiler_pipeline *tail;
+	/** Number of pipelines being compiled by threads */
+	size_t nbusy;
+	/** Threads must quit */
+	int quit;
+	/** Number of pipelines compiled by threads */
+	uint64_t ncompiled;
+	/** Number of pipelines created from cache on requesting thread */
+	uint64_t ncached;
+	/** Number of pipelines driver failed to compile */
+	uint64_t nfailed;
+	/** Total time threads spent compiling, in nanoseconds */
+	uint64_t compile_ns;
+	/** Number of draws bound to fallback pipeline */
+	atomic_uint_fast64_t nfallbacks;
+	/** Number of draws skipped because nothing was compiled */
+	atomic_uint_fast64_t nskipped;
+};
+
+#ifdef __cplusplus
+/* *INDENT-OFF* */
+extern "C" {
+/* *INDENT-ON* */
+#endif
+
+/**
+ * Initializes compiler and starts its threads
+ * @param comp Specifies compiler to initialize
+ * @param dev Specifies device to create pipelines on
+ * @param cache Specifies pipeline cache, or VK_NULL_HANDLE
+ * @param cache_control Specifies if pipeline creation cache control is
+ *                      enabled on @a dev
+ * @param nworkers Specifies number of threads, at most
+ *                 VKCOMPILER_MAX_WORKERS
+ * @param host Specifies host memory allocator of driver, or NULL
+ * @returns zero on success, or non-zero otherwise
+ */
+int vkcompiler_init(struct vkcompiler *comp, VkDevice dev,
+		    VkPipelineCache cache, int cache_control, size_t nworkers,
+		    const VkAllocationCallbacks *host);
+
+/**
+ * Requests pipeline to be compiled
+ *
+ * Pipeline already requested is left as is.
+ * @param comp Specifies compiler
+ * @param pipe Specifies pipeline to compile
+ * @returns VK_SUCCESS if pipeline is ready, VK_NOT_READY if it is queued,
+ *          or VkResult error otherwise
+ */
+VkResult vkcompiler_request(struct vkcompiler *comp,
+			    struct vkcompiler_pipeline *pipe);
+
+/**
+ * Returns pipeline draw must bind
+ *
+ * Never blocks. Fallbacks are followed until compiled one is found.
+ * @param comp Specifies compiler
+ * @param pipe Specifies pipeline draw needs
+ * @returns compiled pipeline or its fallback, or VK_NULL_HANDLE if draw
+ *          must be skipped
+ */
+VkPipeline vkcompiler_select(struct vkcompiler *comp,
+			     const struct vkcompiler_pipeline *pipe);
+
+/**
+ * Waits until every requested pipeline is compiled
+ * @param comp Specifies compiler
+ */
+void vkcompiler_wait(struct vkcompiler *comp);
+
+/**
+ * Destroys compiled pipeline, so it can be requested again
+ *
+ * Pipeline must not be pending or in use by GPU.
+ * @param comp Specifies compiler the pipeline is compiled by
+ * @param pipe Specifies pipeline to destroy
+ */
+void vkcompiler_release(struct vkcompiler *comp,
+			struct vkcompiler_pipeline *pipe);
+
+/**
+ * Returns caches threads compiled pipelines into
+ *
+ * Caches stay owned by compiler and must be merged before it is destroyed.
+ * Compiler must be idle, see vkcompiler_wait.
+ * @param comp Specifies compiler
+ * @param caches Specifies array of VKCOMPILER_MAX_WORKERS caches to fill
+ * @returns number of caches written to @a caches
+ */
+uint32_t vkcompiler_caches(const struct vkcompiler *comp,
+			   VkPipelineCache *caches);
+
+/**
+ * Stops threads and destroys their caches, pipelines still queued stay idle
+ * @param comp Specifies compiler to destroy
+ */
+void vkcompiler_destroy(struct vkcompiler *comp);
+
+#ifdef __cplusplus
+/* *INDENT-OFF* */
+}
+/* *INDENT-ON* */
+#endif
+#endif
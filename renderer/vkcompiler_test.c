@@ -0,0 +1,353 @@
+/**
+ * @file
+ * Test suite for vkcompiler
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include <cgreen/cgreen.h>
+#include <cgreen/mocks.h>
+
+#include <vulkan/vulkan_core.h>
+#include "vkcompiler.h"
+
+/** Pipeline returned when created from cache */
+#define CACHED_PIPELINE ((VkPipeline)0x100)
+
+/** Guards @a gate_open */
+static pthread_mutex_t gate_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/** Signaled when @a gate_open is set */
+static pthread_cond_t gate_opened = PTHREAD_COND_INITIALIZER;
+
+/** Compilation is blocked until gate is open */
+static int gate_open;
+
+/** Result of creation that must not compile */
+static VkResult cached_result;
+
+/** Result of compilation */
+static VkResult compile_result;
+
+/** Number of creations that must not compile */
+static atomic_int ncache_lookups;
+
+/** Number of compilations */
+static atomic_int ncompilations;
+
+/** Number of destroyed pipelines */
+static int ndestroyed;
+
+/** Cache the last compilation is done with */
+static _Atomic(VkPipelineCache) compile_cache;
+
+/** Number of created pipeline caches */
+static int ncaches;
+
+/** Number of destroyed pipeline caches */
+static int ndestroyed_caches;
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkCreatePipelineCache(VkDevice device,
+		      const VkPipelineCacheCreateInfo *pCreateInfo,
+		      const VkAllocationCallbacks *pAllocator,
+		      VkPipelineCache *pPipelineCache)
+{
+	const VkFlags flags =
+		VK_PIPELINE_CACHE_CREATE_EXTERNALLY_SYNCHRONIZED_BIT;
+	assert_that(pCreateInfo->flags, is_equal_to(flags));
+	*pPipelineCache = (VkPipelineCache)(uintptr_t)(0x20 + ncaches++);
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL
+vkDestroyPipelineCache(VkDevice device, VkPipelineCache pipelineCache,
+		       const VkAllocationCallbacks *pAllocator)
+{
+	ndestroyed_caches++;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkCreateGraphicsPipelines(VkDevice device, VkPipelineCache pipelineCache,
+			  uint32_t createInfoCount,
+			  const VkGraphicsPipelineCreateInfo *pCreateInfos,
+			  const VkAllocationCallbacks *pAllocator,
+			  VkPipeline *pPipelines)
+{
+	if (pCreateInfos->flags &
+	    VK_PIPELINE_CREATE_FAIL_ON_PIPELINE_COMPILE_REQUIRED_BIT) {
+		atomic_fetch_add(&ncache_lookups, 1);
+		*pPipelines = (cached_result == VK_SUCCESS) ? CACHED_PIPELINE :
+							      VK_NULL_HANDLE;
+		return cached_result;
+	}
+	pthread_mutex_lock(&gate_lock);
+	while (!gate_open)
+		pthread_cond_wait(&gate_opened, &gate_lock);
+	pthread_mutex_unlock(&gate_lock);
+	atomic_store(&compile_cache, pipelineCache);
+	const int index = atomic_fetch_add(&ncompilations, 1);
+	*pPipelines = (compile_result == VK_SUCCESS) ?
+			      (VkPipeline)(uintptr_t)(0x200 + index) :
+			      VK_NULL_HANDLE;
+	return compile_result;
+}
+
+VKAPI_ATTR void VKAPI_CALL
+vkDestroyPipeline(VkDevice device, VkPipeline pipeline,
+		  const VkAllocationCallbacks *pAllocator)
+{
+	ndestroyed++;
+}
+
+/**
+ * Opens or closes gate compilations wait for
+ * @param open Specifies if gate must be open
+ */
+static void set_gate(int open)
+{
+	pthread_mutex_lock(&gate_lock);
+	gate_open = open;
+	pthread_cond_broadcast(&gate_opened);
+	pthread_mutex_unlock(&gate_lock);
+}
+
+/** Resets state shared by tests */
+static void reset_fakes(void)
+{
+	set_gate(1);
+	cached_result = VK_PIPELINE_COMPILE_REQUIRED;
+	compile_result = VK_SUCCESS;
+	atomic_store(&ncache_lookups, 0);
+	atomic_store(&ncompilations, 0);
+	ndestroyed = 0;
+	atomic_store(&compile_cache, VK_NULL_HANDLE);
+	ncaches = 0;
+	ndestroyed_caches = 0;
+}
+
+/**
+ * Resets state shared by tests and initializes compiler without cache
+ * @param comp Specifies compiler to initialize
+ * @param cache_control Specifies if cache misses are detected by driver
+ * @param nworkers Specifies number of threads
+ */
+static void init_compiler(struct vkcompiler *comp, int cache_control,
+			  size_t nworkers)
+{
+	reset_fakes();
+	vkcompiler_init(comp, VK_NULL_HANDLE, VK_NULL_HANDLE, cache_control,
+			nworkers, NULL);
+}
+
+/** Description shared by pipelines of tests */
+static const VkGraphicsPipelineCreateInfo pipeline_info = {
+	.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+};
+
+Ensure(request_queues_pipeline_to_threads)
+{
+	struct vkcompiler comp;
+	struct vkcompiler_pipeline pipe = { .info = &pipeline_info };
+	init_compiler(&comp, 0, 2);
+	VkResult result = vkcompiler_request(&comp, &pipe);
+	assert_that(result, is_equal_to(VK_NOT_READY));
+	vkcompiler_wait(&comp);
+	assert_that(atomic_load(&pipe.state), is_equal_to(VKCOMPILER_READY));
+	assert_that(vkcompiler_select(&comp, &pipe), is_equal_to(0x200));
+	assert_that(comp.ncompiled, is_equal_to(1));
+	assert_that(atomic_load(&ncache_lookups), is_equal_to(0));
+	vkcompiler_destroy(&comp);
+}
+
+Ensure(request_creates_cached_pipeline_right_away)
+{
+	struct vkcompiler comp;
+	struct vkcompiler_pipeline pipe = { .info = &pipeline_info };
+	init_compiler(&comp, 1, 2);
+	cached_result = VK_SUCCESS;
+	VkResult result = vkcompiler_request(&comp, &pipe);
+	assert_that(result, is_equal_to(VK_SUCCESS));
+	assert_that(vkcompiler_select(&comp, &pipe),
+		    is_equal_to(CACHED_PIPELINE));
+	assert_that(comp.ncached, is_equal_to(1));
+	assert_that(atomic_load(&ncompilations), is_equal_to(0));
+	vkcompiler_destroy(&comp);
+}
+
+Ensure(request_queues_cache_miss_to_threads)
+{
+	struct vkcompiler comp;
+	struct vkcompiler_pipeline pipe = { .info = &pipeline_info };
+	init_compiler(&comp, 1, 2);
+	VkResult result = vkcompiler_request(&comp, &pipe);
+	assert_that(result, is_equal_to(VK_NOT_READY));
+	vkcompiler_wait(&comp);
+	assert_that(atomic_load(&ncache_lookups), is_equal_to(1));
+	assert_that(atomic_load(&ncompilations), is_equal_to(1));
+	assert_that(comp.ncached, is_equal_to(0));
+	assert_that(comp.ncompiled, is_equal_to(1));
+	vkcompiler_destroy(&comp);
+}
+
+Ensure(threads_compile_cache_misses_into_own_caches)
+{
+	struct vkcompiler comp;
+	struct vkcompiler_pipeline pipe = { .info = &pipeline_info };
+	reset_fakes();
+	vkcompiler_init(&comp, VK_NULL_HANDLE, (VkPipelineCache)0x10, 1, 2,
+			NULL);
+	vkcompiler_request(&comp, &pipe);
+	vkcompiler_wait(&comp);
+	VkPipelineCache caches[VKCOMPILER_MAX_WORKERS];
+	assert_that(vkcompiler_caches(&comp, caches), is_equal_to(2));
+	assert_that(caches[0], is_equal_to(0x20));
+	assert_that(caches[1], is_equal_to(0x21));
+	assert_that(atomic_load(&compile_cache),
+		    is_not_equal_to((VkPipelineCache)0x10));
+	vkcompiler_destroy(&comp);
+	assert_that(ndestroyed_caches, is_equal_to(2));
+}
+
+Ensure(threads_share_cache_without_cache_control)
+{
+	struct vkcompiler comp;
+	struct vkcompiler_pipeline pipe = { .info = &pipeline_info };
+	reset_fakes();
+	vkcompiler_init(&comp, VK_NULL_HANDLE, (VkPipelineCache)0x10, 0, 2,
+			NULL);
+	vkcompiler_request(&comp, &pipe);
+	vkcompiler_wait(&comp);
+	VkPipelineCache caches[VKCOMPILER_MAX_WORKERS];
+	assert_that(vkcompiler_caches(&comp, caches), is_equal_to(0));
+	assert_that(atomic_load(&compile_cache),
+		    is_equal_to((VkPipelineCache)0x10));
+	assert_that(ncaches, is_equal_to(0));
+	vkcompiler_destroy(&comp);
+}
+
+Ensure(request_compiles_pipeline_once)
+{
+	struct vkcompiler comp;
+	struct vkcompiler_pipeline pipe = { .info = &pipeline_info };
+	init_compiler(&comp, 0, 2);
+	set_gate(0);
+	vkcompiler_request(&comp, &pipe);
+	VkResult result = vkcompiler_request(&comp, &pipe);
+	assert_that(result, is_equal_to(VK_NOT_READY));
+	set_gate(1);
+	vkcompiler_wait(&comp);
+	result = vkcompiler_request(&comp, &pipe);
+	assert_that(result, is_equal_to(VK_SUCCESS));
+	assert_that(atomic_load(&ncompilations), is_equal_to(1));
+	vkcompiler_destroy(&comp);
+}
+
+Ensure(select_binds_fallback_while_compiling)
+{
+	struct vkcompiler comp;
+	struct vkcompiler_pipeline fallback = { .info = &pipeline_info };
+	struct vkcompiler_pipeline pipe = {
+		.info = &pipeline_info,
+		.fallback = &fallback,
+	};
+	init_compiler(&comp, 0, 1);
+	vkcompiler_request(&comp, &fallback);
+	vkcompiler_wait(&comp);
+	set_gate(0);
+	vkcompiler_request(&comp, &pipe);
+	assert_that(vkcompiler_select(&comp, &pipe),
+		    is_equal_to(fallback.pipeline));
+	assert_that(atomic_load(&comp.nfallbacks), is_equal_to(1));
+	set_gate(1);
+	vkcompiler_wait(&comp);
+	assert_that(vkcompiler_select(&comp, &pipe),
+		    is_equal_to(pipe.pipeline));
+	assert_that(atomic_load(&comp.nfallbacks), is_equal_to(1));
+	vkcompiler_destroy(&comp);
+}
+
+Ensure(select_skips_draw_without_compiled_pipeline)
+{
+	struct vkcompiler comp;
+	struct vkcompiler_pipeline fallback = { .info = &pipeline_info };
+	struct vkcompiler_pipeline pipe = {
+		.info = &pipeline_info,
+		.fallback = &fallback,
+	};
+	init_compiler(&comp, 0, 0);
+	vkcompiler_request(&comp, &pipe);
+	assert_that(vkcompiler_select(&comp, &pipe), is_equal_to(0));
+	assert_that(atomic_load(&comp.nskipped), is_equal_to(1));
+	vkcompiler_destroy(&comp);
+}
+
+Ensure(request_reports_failed_compilation)
+{
+	struct vkcompiler comp;
+	struct vkcompiler_pipeline pipe = { .info = &pipeline_info };
+	init_compiler(&comp, 0, 1);
+	compile_result = VK_ERROR_OUT_OF_DEVICE_MEMORY;
+	vkcompiler_request(&comp, &pipe);
+	vkcompiler_wait(&comp);
+	VkResult result = vkcompiler_request(&comp, &pipe);
+	assert_that(result, is_equal_to(VK_ERROR_OUT_OF_DEVICE_MEMORY));
+	assert_that(comp.nfailed, is_equal_to(1));
+	assert_that(vkcompiler_select(&comp, &pipe), is_equal_to(0));
+	vkcompiler_destroy(&comp);
+}
+
+Ensure(release_destroys_compiled_pipeline)
+{
+	struct vkcompiler comp;
+	struct vkcompiler_pipeline pipe = { .info = &pipeline_info };
+	init_compiler(&comp, 1, 1);
+	cached_result = VK_SUCCESS;
+	vkcompiler_request(&comp, &pipe);
+	vkcompiler_release(&comp, &pipe);
+	assert_that(ndestroyed, is_equal_to(1));
+	assert_that(atomic_load(&pipe.state), is_equal_to(VKCOMPILER_IDLE));
+	vkcompiler_destroy(&comp);
+}
+
+Ensure(destroy_leaves_queued_pipelines_idle)
+{
+	struct vkcompiler comp;
+	struct vkcompiler_pipeline first = { .info = &pipeline_info };
+	struct vkcompiler_pipeline second = { .info = &pipeline_info };
+	init_compiler(&comp, 0, 0);
+	vkcompiler_request(&comp, &first);
+	vkcompiler_request(&comp, &second);
+	vkcompiler_destroy(&comp);
+	assert_that(atomic_load(&first.state), is_equal_to(VKCOMPILER_IDLE));
+	assert_that(atomic_load(&second.state), is_equal_to(VKCOMPILER_IDLE));
+	assert_that(atomic_load(&ncompilations), is_equal_to(0));
+}
+
+int main(int argc, char **argv)
+{
+	(void)(argc);
+	(void)(argv);
+	TestSuite *suite = create_named_test_suite("VKCompiler");
+	add_test(suite, request_queues_pipeline_to_threads);
+	add_test(suite, request_creates_cached_pipeline_right_away);
+	add_test(suite, request_queues_cache_miss_to_threads);
+	add_test(suite, threads_compile_cache_misses_into_own_caches);
+	add_test(suite, threads_share_cache_without_cache_control);
+	add_test(suite, request_compiles_pipeline_once);
+	add_test(suite, select_binds_fallback_while_compiling);
+	add_test(suite, select_skips_draw_without_compiled_pipeline);
+	add_test(suite, request_reports_failed_compilation);
+	add_test(suite, release_destroys_compiled_pipeline);
+	add_test(suite, destroy_leaves_queued_pipelines_idle);
+	TestReporter *reporter = create_text_reporter();
+	int exit_code = run_test_suite(suite, reporter);
+	destroy_reporter(reporter);
+	destroy_test_suite(suite);
+	return exit_code;
+}
@@ -0,0 +1,184 @@
+/**
+ * @file
+ * Vulkan compute jobs on async compute queue implementation
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "vkcompute.h"
+#include <vulkan/vulkan_core.h>
+
+/**
+ * Returns job at position in ring of jobs
+ * @param cmp Specifies compute jobs to get job of
+ * @param age Specifies position of job, zero is the oldest
+ * @returns pointer to job
+ */
+static struct vkcompute_job *vkcompute_job(struct vkcompute *cmp, size_t age)
+{
+	return &cmp->jobs[(cmp->head + age) % VKCOMPUTE_MAX_JOBS];
+}
+
+/**
+ * Initializes compute job
+ * @param cmp Specifies compute jobs the job belongs to
+ * @param job Specifies job to initialize
+ * @returns VK_SUCCESS on success, or VkResult error otherwise
+ */
+static VkResult vkcompute_init_job(const struct vkcompute *cmp,
+				   struct vkcompute_job *job)
+{
+	const VkCommandBufferAllocateInfo cmds_info = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+		.pNext = NULL,
+		.commandPool = cmp->pool,
+		.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+		.commandBufferCount = 1,
+	};
+	const VkSemaphoreCreateInfo sem_info = {
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+		.pNext = NULL,
+		.flags = 0,
+	};
+	job->done = VK_NULL_HANDLE;
+	job->stage = 0;
+	job->frame = 0;
+	VkResult result = vkAllocateCommandBuffers(cmp->dev, &cmds_info,
+						   &job->cmds);
+	if (result != VK_SUCCESS)
+		return result;
+	return vkCreateSemaphore(cmp->dev, &sem_info, cmp->host, &job->done);
+}
+
+VkResult vkcompute_init(struct vkcompute *cmp, VkDevice dev,
+			const struct vkdispatch *vkd, uint32_t family,
+			VkQueue queue, const VkAllocationCallbacks *host)
+{
+	const VkCommandPoolCreateInfo pool_info = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+		.pNext = NULL,
+		.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT |
+			 VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+		.queueFamilyIndex = family,
+	};
+	cmp->dev = dev;
+	cmp->vkd = vkd;
+	cmp->host = host;
+	cmp->queue = queue;
+	cmp->family = family;
+	cmp->head = 0;
+	cmp->count = 0;
+	cmp->nwaiting = 0;
+	cmp->recording = 0;
+	cmp->nsubmits = 0;
+	for (size_t i = 0; i < VKCOMPUTE_MAX_JOBS; ++i) {
+		cmp->jobs[i].done = VK_NULL_HANDLE;
+	}
+	VkResult result = vkCreateCommandPool(dev, &pool_info, host,
+					      &cmp->pool);
+	if (result != VK_SUCCESS)
+		return result;
+	for (size_t i = 0; i < VKCOMPUTE_MAX_JOBS; ++i) {
+		result = vkcompute_init_job(cmp, &cmp->jobs[i]);
+		if (result != VK_SUCCESS)
+			return result;
+	}
+	return VK_SUCCESS;
+}
+
+VkResult vkcompute_begin(struct vkcompute *cmp, VkCommandBuffer *cmds)
+{
+	const VkCommandBufferBeginInfo info = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.pNext = NULL,
+		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+		.pInheritanceInfo = NULL,
+	};
+	if (cmp->recording || cmp->count == VKCOMPUTE_MAX_JOBS)
+		return VK_NOT_READY;
+	struct vkcompute_job *job = vkcompute_job(cmp, cmp->count);
+	VkResult result = cmp->vkd->vkBeginCommandBuffer(job->cmds, &info);
+	if (result != VK_SUCCESS)
+		return result;
+	job->frame = 0;
+	cmp->count++;
+	cmp->recording = 1;
+	*cmds = job->cmds;
+	return VK_SUCCESS;
+}
+
+VkResult vkcompute_submit(struct vkcompute *cmp, VkPipelineStageFlags stage)
+{
+	if (!cmp->recording)
+		return VK_NOT_READY;
+	struct vkcompute_job *job = vkcompute_job(cmp, cmp->count - 1);
+	VkResult result = cmp->vkd->vkEndCommandBuffer(job->cmds);
+	if (result != VK_SUCCESS)
+		return result;
+	const VkSubmitInfo info = {
+		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+		.pNext = NULL,
+		.waitSemaphoreCount = 0,
+		.pWaitSemaphores = NULL,
+		.pWaitDstStageMask = NULL,
+		.commandBufferCount = 1,
+		.pCommandBuffers = &job->cmds,
+		.signalSemaphoreCount = 1,
+		.pSignalSemaphores = &job->done,
+	};
+	/* Graphics frame waiting for job tells when job completes */
+	result = cmp->vkd->vkQueueSubmit(cmp->queue, 1, &info, VK_NULL_HANDLE);
+	if (result != VK_SUCCESS)
+		return result;
+	job->stage = stage;
+	cmp->recording = 0;
+	cmp->nwaiting++;
+	cmp->nsubmits++;
+	return VK_SUCCESS;
+}
+
+uint32_t vkcompute_waits(const struct vkcompute *cmp, VkSemaphore *sems,
+			 VkPipelineStageFlags *stages)
+{
+	const size_t first = cmp->count - cmp->recording - cmp->nwaiting;
+	for (size_t i = 0; i < cmp->nwaiting; ++i) {
+		const size_t index = (cmp->head + first + i) %
+				     VKCOMPUTE_MAX_JOBS;
+		sems[i] = cmp->jobs[index].done;
+		stages[i] = cmp->jobs[index].stage;
+	}
+	return (uint32_t)cmp->nwaiting;
+}
+
+void vkcompute_consume(struct vkcompute *cmp, uint64_t frame)
+{
+	const size_t first = cmp->count - cmp->recording - cmp->nwaiting;
+	for (size_t i = 0; i < cmp->nwaiting; ++i) {
+		vkcompute_job(cmp, first + i)->frame = frame;
+	}
+	cmp->nwaiting = 0;
+}
+
+void vkcompute_collect(struct vkcompute *cmp, uint64_t completed)
+{
+	/* Binary semaphore is signaled again only after its wait completes */
+	while (cmp->count - cmp->recording - cmp->nwaiting > 0) {
+		const struct vkcompute_job *oldest = vkcompute_job(cmp, 0);
+		if (oldest->frame > completed)
+			break;
+		cmp->head = (cmp->head + 1) % VKCOMPUTE_MAX_JOBS;
+		cmp->count--;
+	}
+}
+
+void vkcompute_destroy(const struct vkcompute *cmp)
+{
+	for (size_t i = 0; i < VKCOMPUTE_MAX_JOBS; ++i) {
+		vkDestroySemaphore(cmp->dev, cmp->jobs[i].done, cmp->host);
+	}
+	vkDestroyCommandPool(cmp->dev, cmp->pool, cmp->host);
+}
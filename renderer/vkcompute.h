@@ -0,0 +1,132 @@
+#ifndef RENDERER_VKCOMPUTE_H
+#define RENDERER_VKCOMPUTE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <renderer/vkdispatch.h>
+#include <vulkan/vulkan_core.h>
+
+/** Maximum number of compute jobs in use at once */
+#define VKCOMPUTE_MAX_JOBS 8
+
+/** Work submitted to compute queue at once */
+struct vkcompute_job {
+	/** Command buffer recording compute work */
+	VkCommandBuffer cmds;
+	/** Semaphore signaled when work completes, waited by graphics */
+	VkSemaphore done;
+	/** Graphics stages consuming results of work */
+	VkPipelineStageFlags stage;
+	/** Graphics frame waiting for work, or zero if not waited yet */
+	uint64_t frame;
+};
+
+/**
+ * Compute work running on compute queue alongside graphics
+ *
+ * Every submitted job is waited by the next graphics frame, and job is
+ * reused once that frame completes. Resources written by compute and read
+ * by graphics must be shared concurrently between both queue families.
+ * Compute jobs are not thread-safe.
+ */
+struct vkcompute {
+	/** Device the jobs run on */
+	VkDevice dev;
+	/** Dispatch table of @a dev */
+	const struct vkdispatch *vkd;
+	/** Host memory allocator of driver, or NULL */
+	const VkAllocationCallbacks *host;
+	/** Queue running jobs */
+	VkQueue queue;
+	/** Queue family of @a queue */
+	uint32_t family;
+	/** Pool of job command buffers */
+	VkCommandPool pool;
+	/** Ring of jobs, the oldest one is at @a head */
+	struct vkcompute_job jobs[VKCOMPUTE_MAX_JOBS];
+	/** Index of the oldest job in use */
+	size_t head;
+	/** Number of jobs in use */
+	size_t count;
+	/** Number of the newest jobs not waited by graphics yet */
+	size_t nwaiting;
+	/** Non-zero if the newest job is being recorded */
+	int recording;
+	/** Number of submitted jobs */
+	uint64_t nsubmits;
+};
+
+#ifdef __cplusplus
+/* *INDENT-OFF* */
+extern "C" {
+/* *INDENT-ON* */
+#endif
+
+/**
+ * Initializes compute jobs
+ * @param cmp Specifies compute jobs to initialize
+ * @param dev Specifies device to run jobs on
+ * @param vkd Specifies dispatch table of @a dev
+ * @param family Specifies queue family running jobs
+ * @param queue Specifies queue running jobs
+ * @param host Specifies host memory allocator of driver, or NULL
+ * @returns VK_SUCCESS on success, or VkResult error otherwise
+ */
+VkResult vkcompute_init(struct vkcompute *cmp, VkDevice dev,
+			const struct vkdispatch *vkd, uint32_t family,
+			VkQueue queue, const VkAllocationCallbacks *host);
+
+/**
+ * Begins recording of new job
+ * @param cmp Specifies compute jobs to begin job of
+ * @param cmds Specifies pointer where command buffer of job must be stored
+ * @returns VK_SUCCESS on success, VK_NOT_READY if all jobs are in use, or
+ *          VkResult error otherwise
+ */
+VkResult vkcompute_begin(struct vkcompute *cmp, VkCommandBuffer *cmds);
+
+/**
+ * Submits recorded job to compute queue
+ * @param cmp Specifies compute jobs to submit job of
+ * @param stage Specifies graphics stages waiting for results of job
+ * @returns VK_SUCCESS on success, or VkResult error otherwise
+ */
+VkResult vkcompute_submit(struct vkcompute *cmp, VkPipelineStageFlags stage);
+
+/**
+ * Returns semaphores of jobs that graphics frame must wait for
+ * @param cmp Specifies compute jobs to get semaphores of
+ * @param sems Specifies array of VKCOMPUTE_MAX_JOBS semaphores to fill
+ * @param stages Specifies array of VKCOMPUTE_MAX_JOBS stages to fill
+ * @returns number of semaphores filled
+ */
+uint32_t vkcompute_waits(const struct vkcompute *cmp, VkSemaphore *sems,
+			 VkPipelineStageFlags *stages);
+
+/**
+ * Marks jobs returned by vkcompute_waits as waited by graphics frame
+ * @param cmp Specifies compute jobs to mark
+ * @param frame Specifies submitted graphics frame waiting for jobs
+ */
+void vkcompute_consume(struct vkcompute *cmp, uint64_t frame);
+
+/**
+ * Releases jobs waited by completed graphics frames
+ * @param cmp Specifies compute jobs to release
+ * @param completed Specifies the last completed graphics frame
+ */
+void vkcompute_collect(struct vkcompute *cmp, uint64_t completed);
+
+/**
+ * Destroys compute jobs, device must be idle
+ * @param cmp Specifies compute jobs to destroy
+ */
+void vkcompute_destroy(const struct vkcompute *cmp);
+
+#ifdef __cplusplus
+/* *INDENT-OFF* */
+}
+/* *INDENT-ON* */
+#endif
+#endif
@@ -0,0 +1,271 @@
+/**
+ * @file
+ * Test suite for vkcompute
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdint.h>
+
+#include <cgreen/cgreen.h>
+#include <cgreen/mocks.h>
+
+#include <vulkan/vulkan_core.h>
+#include "vkcompute.h"
+
+/** Queue family running compute jobs */
+#define COMPUTE_FAMILY 1
+
+/** Queue running compute jobs */
+#define COMPUTE_QUEUE ((VkQueue)1)
+
+/** The last submission made to compute queue */
+static VkSubmitInfo last_submit;
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateCommandPool(
+	VkDevice device, const VkCommandPoolCreateInfo *pCreateInfo,
+	const VkAllocationCallbacks *pAllocator, VkCommandPool *pCommandPool)
+{
+	return (VkResult)mock(device, pCreateInfo, pAllocator, pCommandPool);
+}
+
+VKAPI_ATTR void VKAPI_CALL
+vkDestroyCommandPool(VkDevice device, VkCommandPool commandPool,
+		     const VkAllocationCallbacks *pAllocator)
+{
+	mock(device, commandPool, pAllocator);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkAllocateCommandBuffers(VkDevice device,
+			 const VkCommandBufferAllocateInfo *pAllocateInfo,
+			 VkCommandBuffer *pCommandBuffers)
+{
+	return (VkResult)mock(device, pAllocateInfo, pCommandBuffers);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateSemaphore(
+	VkDevice device, const VkSemaphoreCreateInfo *pCreateInfo,
+	const VkAllocationCallbacks *pAllocator, VkSemaphore *pSemaphore)
+{
+	return (VkResult)mock(device, pCreateInfo, pAllocator, pSemaphore);
+}
+
+VKAPI_ATTR void VKAPI_CALL
+vkDestroySemaphore(VkDevice device, VkSemaphore semaphore,
+		   const VkAllocationCallbacks *pAllocator)
+{
+	mock(device, semaphore, pAllocator);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkBeginCommandBuffer(VkCommandBuffer commandBuffer,
+		     const VkCommandBufferBeginInfo *pBeginInfo)
+{
+	return (VkResult)mock(commandBuffer, pBeginInfo);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkEndCommandBuffer(VkCommandBuffer commandBuffer)
+{
+	return (VkResult)mock(commandBuffer);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkQueueSubmit(VkQueue queue,
+					     uint32_t submitCount,
+					     const VkSubmitInfo *pSubmits,
+					     VkFence fence)
+{
+	last_submit = *pSubmits;
+	return (VkResult)mock(queue, submitCount, pSubmits, fence);
+}
+
+/** Dispatch table calling mocked functions */
+static const struct vkdispatch mocked_dispatch = {
+	.vkBeginCommandBuffer = vkBeginCommandBuffer,
+	.vkEndCommandBuffer = vkEndCommandBuffer,
+	.vkQueueSubmit = vkQueueSubmit,
+};
+
+/**
+ * Initializes compute jobs with all creations succeeding
+ * @param cmp Specifies compute jobs to initialize
+ */
+static void init_jobs(struct vkcompute *cmp)
+{
+	always_expect(vkCreateCommandPool, will_return(VK_SUCCESS));
+	always_expect(vkAllocateCommandBuffers, will_return(VK_SUCCESS));
+	always_expect(vkCreateSemaphore, will_return(VK_SUCCESS));
+	vkcompute_init(cmp, VK_NULL_HANDLE, &mocked_dispatch, COMPUTE_FAMILY,
+		       COMPUTE_QUEUE, NULL);
+	for (uintptr_t i = 0; i < VKCOMPUTE_MAX_JOBS; ++i) {
+		cmp->jobs[i].done = (VkSemaphore)(i + 1);
+	}
+	always_expect(vkBeginCommandBuffer, will_return(VK_SUCCESS));
+	always_expect(vkEndCommandBuffer, will_return(VK_SUCCESS));
+	always_expect(vkQueueSubmit, will_return(VK_SUCCESS));
+}
+
+/**
+ * Records empty job and submits it
+ * @param cmp Specifies compute jobs to submit job to
+ * @param stage Specifies graphics stages waiting for job
+ * @returns result of submission
+ */
+static VkResult submit_job(struct vkcompute *cmp, VkPipelineStageFlags stage)
+{
+	VkCommandBuffer cmds;
+	const VkResult result = vkcompute_begin(cmp, &cmds);
+	if (result != VK_SUCCESS)
+		return result;
+	return vkcompute_submit(cmp, stage);
+}
+
+Ensure(init_creates_semaphore_for_every_job)
+{
+	struct vkcompute cmp;
+	const VkAllocationCallbacks host = { 0 };
+	expect(vkCreateCommandPool, will_return(VK_SUCCESS),
+	       when(pAllocator, is_equal_to(&host)));
+	always_expect(vkAllocateCommandBuffers, will_return(VK_SUCCESS));
+	for (int i = 0; i < VKCOMPUTE_MAX_JOBS; ++i) {
+		expect(vkCreateSemaphore, will_return(VK_SUCCESS),
+		       when(pAllocator, is_equal_to(&host)));
+	}
+	VkResult result = vkcompute_init(&cmp, VK_NULL_HANDLE,
+					 &mocked_dispatch, COMPUTE_FAMILY,
+					 COMPUTE_QUEUE, &host);
+	assert_that(result, is_equal_to(VK_SUCCESS));
+}
+
+Ensure(init_returns_error_on_pool_fail)
+{
+	struct vkcompute cmp;
+	expect(vkCreateCommandPool, will_return(VK_ERROR_OUT_OF_HOST_MEMORY));
+	never_expect(vkAllocateCommandBuffers);
+	VkResult result = vkcompute_init(&cmp, VK_NULL_HANDLE,
+					 &mocked_dispatch, COMPUTE_FAMILY,
+					 COMPUTE_QUEUE, NULL);
+	assert_that(result, is_equal_to(VK_ERROR_OUT_OF_HOST_MEMORY));
+}
+
+Ensure(submit_signals_semaphore_on_compute_queue)
+{
+	struct vkcompute cmp;
+	init_jobs(&cmp);
+	VkResult result = submit_job(&cmp, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+	assert_that(result, is_equal_to(VK_SUCCESS));
+	assert_that(last_submit.signalSemaphoreCount, is_equal_to(1));
+	assert_that(last_submit.pSignalSemaphores[0],
+		    is_equal_to(cmp.jobs[0].done));
+	assert_that(cmp.nsubmits, is_equal_to(1));
+}
+
+Ensure(submit_without_recording_returns_not_ready)
+{
+	struct vkcompute cmp;
+	init_jobs(&cmp);
+	VkResult result =
+		vkcompute_submit(&cmp, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+	assert_that(result, is_equal_to(VK_NOT_READY));
+}
+
+Ensure(waits_returns_submitted_jobs_only)
+{
+	struct vkcompute cmp;
+	VkSemaphore sems[VKCOMPUTE_MAX_JOBS];
+	VkPipelineStageFlags stages[VKCOMPUTE_MAX_JOBS];
+	VkCommandBuffer cmds;
+	init_jobs(&cmp);
+	submit_job(&cmp, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+	submit_job(&cmp, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+	vkcompute_begin(&cmp, &cmds);
+	uint32_t nwaits = vkcompute_waits(&cmp, sems, stages);
+	assert_that(nwaits, is_equal_to(2));
+	assert_that(sems[0], is_equal_to(cmp.jobs[0].done));
+	assert_that(sems[1], is_equal_to(cmp.jobs[1].done));
+	assert_that(stages[1],
+		    is_equal_to(VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT));
+}
+
+Ensure(consumed_jobs_are_not_waited_again)
+{
+	struct vkcompute cmp;
+	VkSemaphore sems[VKCOMPUTE_MAX_JOBS];
+	VkPipelineStageFlags stages[VKCOMPUTE_MAX_JOBS];
+	init_jobs(&cmp);
+	submit_job(&cmp, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+	vkcompute_consume(&cmp, 3);
+	submit_job(&cmp, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+	uint32_t nwaits = vkcompute_waits(&cmp, sems, stages);
+	assert_that(nwaits, is_equal_to(1));
+	assert_that(sems[0], is_equal_to(cmp.jobs[1].done));
+	assert_that(cmp.jobs[0].frame, is_equal_to(3));
+}
+
+Ensure(collect_releases_jobs_of_completed_frames)
+{
+	struct vkcompute cmp;
+	init_jobs(&cmp);
+	submit_job(&cmp, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+	vkcompute_consume(&cmp, 3);
+	submit_job(&cmp, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+	vkcompute_consume(&cmp, 4);
+	vkcompute_collect(&cmp, 3);
+	assert_that(cmp.count, is_equal_to(1));
+	assert_that(cmp.head, is_equal_to(1));
+}
+
+Ensure(collect_keeps_jobs_not_waited_by_graphics)
+{
+	struct vkcompute cmp;
+	init_jobs(&cmp);
+	submit_job(&cmp, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+	vkcompute_collect(&cmp, 10);
+	assert_that(cmp.count, is_equal_to(1));
+}
+
+Ensure(begin_returns_not_ready_when_all_jobs_are_used)
+{
+	struct vkcompute cmp;
+	init_jobs(&cmp);
+	for (int i = 0; i < VKCOMPUTE_MAX_JOBS; ++i) {
+		submit_job(&cmp, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+	}
+	VkResult result = submit_job(&cmp, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+	assert_that(result, is_equal_to(VK_NOT_READY));
+}
+
+Ensure(destroy_destroys_all_resources)
+{
+	struct vkcompute cmp;
+	init_jobs(&cmp);
+	for (int i = 0; i < VKCOMPUTE_MAX_JOBS; ++i) {
+		expect(vkDestroySemaphore);
+	}
+	expect(vkDestroyCommandPool);
+	vkcompute_destroy(&cmp);
+}
+
+int main(int argc, char **argv)
+{
+	(void)(argc);
+	(void)(argv);
+	TestSuite *suite = create_named_test_suite("VKCompute");
+	add_test(suite, init_creates_semaphore_for_every_job);
+	add_test(suite, init_returns_error_on_pool_fail);
+	add_test(suite, submit_signals_semaphore_on_compute_queue);
+	add_test(suite, submit_without_recording_returns_not_ready);
+	add_test(suite, waits_returns_submitted_jobs_only);
+	add_test(suite, consumed_jobs_are_not_waited_again);
+	add_test(suite, collect_releases_jobs_of_completed_frames);
+	add_test(suite, collect_keeps_jobs_not_waited_by_graphics);
+	add_test(suite, begin_returns_not_ready_when_all_jobs_are_used);
+	add_test(suite, destroy_destroys_all_resources);
+	TestReporter *reporter = create_text_reporter();
+	int exit_code = run_test_suite(suite, reporter);
+	destroy_reporter(reporter);
+	destroy_test_suite(suite);
+	return exit_code;
+}
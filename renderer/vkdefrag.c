@@ -0,0 +1,450 @@
+/**
+ * @file
+ * Incremental defragmenter of device memory implementation
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "vkclock.h"
+#include "vkdefrag.h"
+#include "vkmemory.h"
+#include <vulkan/vulkan_core.h>
+
+VkResult vkdefrag_init(struct vkdefrag *defrag, struct vkmemory *mem,
+		       const struct vkdispatch *vkd, uint32_t family,
+		       VkQueue queue, uint64_t budget_ns)
+{
+	const VkCommandPoolCreateInfo pool_info = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+		.pNext = NULL,
+		.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT |
+			 VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+		.queueFamilyIndex = family,
+	};
+	const VkFenceCreateInfo fence_info = {
+		.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+		.pNext = NULL,
+		.flags = 0,
+	};
+	defrag->mem = mem;
+	defrag->vkd = vkd;
+	defrag->queue = queue;
+	defrag->pool = VK_NULL_HANDLE;
+	defrag->cmd = VK_NULL_HANDLE;
+	defrag->fence = VK_NULL_HANDLE;
+	defrag->budget_ns = budget_ns;
+	defrag->first = NULL;
+	defrag->last = NULL;
+	defrag->type = 0;
+	defrag->block = VKMEMORY_NONE;
+	defrag->next_search = 0;
+	defrag->state = VKDEFRAG_IDLE;
+	defrag->frame = 0;
+	defrag->nmoves = 0;
+	defrag->npasses = 0;
+	defrag->nmoved = 0;
+	defrag->nbytes = 0;
+	defrag->nblocks = 0;
+	defrag->nsteps = 0;
+	defrag->elapsed_ns = 0;
+	VkResult result = vkCreateCommandPool(mem->dev, &pool_info, mem->host,
+					      &defrag->pool);
+	if (result != VK_SUCCESS)
+		return result;
+	const VkCommandBufferAllocateInfo cmd_info = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+		.pNext = NULL,
+		.commandPool = defrag->pool,
+		.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+		.commandBufferCount = 1,
+	};
+	result = vkAllocateCommandBuffers(mem->dev, &cmd_info, &defrag->cmd);
+	if (result != VK_SUCCESS)
+		return result;
+	return vkCreateFence(mem->dev, &fence_info, mem->host, &defrag->fence);
+}
+
+void vkdefrag_track(struct vkdefrag *defrag, struct vkdefrag_resource *res,
+		    const struct vkmemory_request *req,
+		    const struct vkmemory_alloc *alloc,
+		    const struct vkdefrag_ops *ops)
+{
+	res->ops = ops;
+	res->req = *req;
+	res->alloc = *alloc;
+	res->state = VKDEFRAG_IDLE;
+	res->prev = defrag->last;
+	res->next = NULL;
+	if (defrag->last != NULL)
+		defrag->last->next = res;
+	else
+		defrag->first = res;
+	defrag->last = res;
+}
+
+/**
+ * Removes resource from moves of pass
+ * @param defrag Specifies defragmenter running pass
+ * @param res Specifies resource to remove
+ */
+static void vkdefrag_drop(struct vkdefrag *defrag,
+			  struct vkdefrag_resource *res)
+{
+	for (uint32_t i = 0; i < defrag->nmoves; ++i) {
+		if (defrag->moves[i] == res) {
+			defrag->moves[i] = defrag->moves[--defrag->nmoves];
+			break;
+		}
+	}
+	if (defrag->nmoves == 0)
+		defrag->state = VKDEFRAG_IDLE;
+}
+
+VkResult vkdefrag_untrack(struct vkdefrag *defrag,
+			  struct vkdefrag_resource *res)
+{
+	if (res->state == VKDEFRAG_COPYING) {
+		/* Copy is being written, so it is destroyed once GPU is done */
+		const VkResult result = defrag->vkd->vkWaitForFences(
+			defrag->mem->dev, 1, &defrag->fence, VK_TRUE,
+			UINT64_MAX);
+		if (result != VK_SUCCESS)
+			return result;
+	}
+	if (res->state != VKDEFRAG_IDLE) {
+		res->ops->release(res);
+		vkmemory_free(defrag->mem, &res->moved);
+		res->state = VKDEFRAG_IDLE;
+		vkdefrag_drop(defrag, res);
+	}
+	if (res->prev != NULL)
+		res->prev->next = res->next;
+	else
+		defrag->first = res->next;
+	if (res->next != NULL)
+		res->next->prev = res->prev;
+	else
+		defrag->last = res->prev;
+	res->prev = NULL;
+	res->next = NULL;
+	return VK_SUCCESS;
+}
+
+/**
+ * Returns number of bytes of block used by idle tracked resources
+ * @param defrag Specifies defragmenter tracking resources
+ * @param type Specifies memory type of block
+ * @param memory Specifies device memory of block
+ * @returns number of movable bytes of block
+ */
+static VkDeviceSize vkdefrag_movable(const struct vkdefrag *defrag,
+				     uint32_t type, VkDeviceMemory memory)
+{
+	VkDeviceSize movable = 0;
+	for (const struct vkdefrag_resource *res = defrag->first; res != NULL;
+	     res = res->next) {
+		if (res->state == VKDEFRAG_IDLE && res->alloc.type == type &&
+		    res->alloc.memory == memory &&
+		    res->alloc.range != VKMEMORY_NONE) {
+			movable += res->alloc.size;
+		}
+	}
+	return movable;
+}
+
+/**
+ * Selects block to evacuate
+ *
+ * Block must be used sparsely, hold movable resources only and fit free
+ * ranges of other blocks of its type.
+ * @param defrag Specifies defragmenter to select block of
+ * @returns non-zero if block is selected, or zero otherwise
+ */
+static int vkdefrag_select(struct vkdefrag *defrag)
+{
+	const struct vkmemory *mem = defrag->mem;
+	VkDeviceSize best = VKDEFRAG_SPARSE_PERCENT;
+	for (uint32_t type = 0; type < mem->props.memoryTypeCount; ++type) {
+		const struct vkmemory_pool *pool = mem->pools[type];
+		if (pool == NULL)
+			continue;
+		VkDeviceSize free = 0;
+		uint32_t nlive = 0;
+		for (uint32_t i = 0; i < pool->nblocks; ++i) {
+			const struct vkmemory_block *block = &pool->blocks[i];
+			if (block->memory == VK_NULL_HANDLE)
+				continue;
+			free += block->size - block->used;
+			nlive++;
+		}
+		if (nlive < 2)
+			continue;
+		for (uint32_t i = 0; i < pool->nblocks; ++i) {
+			const struct vkmemory_block *block = &pool->blocks[i];
+			if (block->memory == VK_NULL_HANDLE || block->used == 0)
+				continue;
+			const VkDeviceSize percent =
+				block->used * 100 / block->size;
+			if (percent >= best ||
+			    free - (block->size - block->used) < block->used)
+				continue;
+			if (vkdefrag_movable(defrag, type, block->memory) !=
+			    block->used)
+				continue;
+			best = percent;
+			defrag->type = type;
+			defrag->block = i;
+		}
+	}
+	return defrag->block != VKMEMORY_NONE;
+}
+
+/**
+ * Finishes pass in flight as far as GPU allows
+ * @param defrag Specifies defragmenter running pass
+ * @param frame Specifies number of the last submitted frame
+ * @param completed Specifies number of the last completed frame
+ * @returns VK_SUCCESS on success, or VkResult error otherwise
+ */
+static VkResult vkdefrag_finish(struct vkdefrag *defrag, uint64_t frame,
+				uint64_t completed)
+{
+	if (defrag->state == VKDEFRAG_COPYING) {
+		const VkResult status = defrag->vkd->vkGetFenceStatus(
+			defrag->mem->dev, defrag->fence);
+		if (status == VK_NOT_READY)
+			return VK_SUCCESS;
+		if (status != VK_SUCCESS)
+			return status;
+		for (uint32_t i = 0; i < defrag->nmoves; ++i) {
+			struct vkdefrag_resource *res = defrag->moves[i];
+			const struct vkmemory_alloc replaced = res->alloc;
+			res->ops->commit(res);
+			res->alloc = res->moved;
+			res->moved = replaced;
+			res->state = VKDEFRAG_RETIRING;
+		}
+		/* Frames submitted so far still use replaced memory */
+		defrag->frame = frame;
+		defrag->state = VKDEFRAG_RETIRING;
+	}
+	if (defrag->state != VKDEFRAG_RETIRING || defrag->frame > completed)
+		return VK_SUCCESS;
+	for (uint32_t i = 0; i < defrag->nmoves; ++i) {
+		struct vkdefrag_resource *res = defrag->moves[i];
+		res->ops->release(res);
+		vkmemory_free(defrag->mem, &res->moved);
+		res->state = VKDEFRAG_IDLE;
+	}
+	defrag->nmoves = 0;
+	defrag->state = VKDEFRAG_IDLE;
+	return VK_SUCCESS;
+}
+
+/**
+ * Begins recording copies, waiting for all prior work
+ * @param defrag Specifies defragmenter recording copies
+ * @returns VK_SUCCESS on success, or VkResult error otherwise
+ */
+static VkResult vkdefrag_begin(struct vkdefrag *defrag)
+{
+	const VkCommandBufferBeginInfo info = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.pNext = NULL,
+		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+		.pInheritanceInfo = NULL,
+	};
+	const VkMemoryBarrier barrier = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+		.pNext = NULL,
+		.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+	};
+	const struct vkdispatch *vkd = defrag->vkd;
+	const VkResult result =
+		vkd->vkBeginCommandBuffer(defrag->cmd, &info);
+	if (result != VK_SUCCESS)
+		return result;
+	vkd->vkCmdPipelineBarrier(defrag->cmd,
+				  VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+				  VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1,
+				  &barrier, 0, NULL, 0, NULL);
+	return VK_SUCCESS;
+}
+
+/**
+ * Submits recorded copies, making them visible to all later work
+ * @param defrag Specifies defragmenter recording copies
+ * @returns VK_SUCCESS on success, or VkResult error otherwise
+ */
+static VkResult vkdefrag_submit(struct vkdefrag *defrag)
+{
+	const VkMemoryBarrier barrier = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+		.pNext = NULL,
+		.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT |
+				 VK_ACCESS_MEMORY_WRITE_BIT,
+	};
+	const struct vkdispatch *vkd = defrag->vkd;
+	vkd->vkCmdPipelineBarrier(defrag->cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+				  VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1,
+				  &barrier, 0, NULL, 0, NULL);
+	VkResult result = vkd->vkEndCommandBuffer(defrag->cmd);
+	if (result != VK_SUCCESS)
+		return result;
+	result = vkd->vkResetFences(defrag->mem->dev, 1, &defrag->fence);
+	if (result != VK_SUCCESS)
+		return result;
+	const VkSubmitInfo info = {
+		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+		.pNext = NULL,
+		.waitSemaphoreCount = 0,
+		.pWaitSemaphores = NULL,
+		.pWaitDstStageMask = NULL,
+		.commandBufferCount = 1,
+		.pCommandBuffers = &defrag->cmd,
+		.signalSemaphoreCount = 0,
+		.pSignalSemaphores = NULL,
+	};
+	return vkd->vkQueueSubmit(defrag->queue, 1, &info, defrag->fence);
+}
+
+/**
+ * Starts moving resource into free range of another block
+ * @param defrag Specifies defragmenter moving resource
+ * @param res Specifies resource to move
+ * @returns VK_SUCCESS on success, or VkResult error otherwise
+ */
+static VkResult vkdefrag_move(struct vkdefrag *defrag,
+			      struct vkdefrag_resource *res)
+{
+	struct vkmemory_request req = res->req;
+	req.reqs.memoryTypeBits = UINT32_C(1) << defrag->type;
+	req.dedicated = 0;
+	req.compact = 1;
+	VkResult result = vkmemory_alloc(defrag->mem, &req, &res->moved);
+	if (result != VK_SUCCESS)
+		return result;
+	result = res->ops->create(res, &res->moved);
+	if (result != VK_SUCCESS) {
+		vkmemory_free(defrag->mem, &res->moved);
+		return result;
+	}
+	if (defrag->nmoves == 0) {
+		result = vkdefrag_begin(defrag);
+		if (result != VK_SUCCESS) {
+			res->ops->release(res);
+			vkmemory_free(defrag->mem, &res->moved);
+			return result;
+		}
+	}
+	res->ops->copy(res, defrag->cmd);
+	res->state = VKDEFRAG_COPYING;
+	defrag->moves[defrag->nmoves++] = res;
+	return VK_SUCCESS;
+}
+
+/**
+ * Ends evacuation of block
+ * @param defrag Specifies defragmenter evacuating block
+ */
+static void vkdefrag_settle(struct vkdefrag *defrag)
+{
+	vkmemory_settle(defrag->mem, defrag->type);
+	defrag->block = VKMEMORY_NONE;
+}
+
+/**
+ * Records and submits pass moving resources out of evacuated block
+ * @param defrag Specifies defragmenter running pass
+ * @param frame Specifies number of the last submitted frame
+ * @param start Specifies time the step started at, in nanoseconds
+ * @returns VK_SUCCESS on success, or VkResult error otherwise
+ */
+static VkResult vkdefrag_pass(struct vkdefrag *defrag, uint64_t frame,
+			      uint64_t start)
+{
+	if (defrag->block == VKMEMORY_NONE) {
+		if (frame < defrag->next_search)
+			return VK_SUCCESS;
+		defrag->next_search = frame + VKDEFRAG_SEARCH_PERIOD;
+		if (!vkdefrag_select(defrag))
+			return VK_SUCCESS;
+		vkmemory_evacuate(defrag->mem, defrag->type, defrag->block);
+	}
+	const struct vkmemory_pool *pool = defrag->mem->pools[defrag->type];
+	/* Allocator ends evacuation itself once block is empty */
+	if (pool->evacuating != defrag->block) {
+		defrag->block = VKMEMORY_NONE;
+		defrag->nblocks++;
+		return VK_SUCCESS;
+	}
+	const VkDeviceMemory memory = pool->blocks[defrag->block].memory;
+	VkDeviceSize bytes = 0;
+	VkResult result = VK_SUCCESS;
+	for (struct vkdefrag_resource *res = defrag->first; res != NULL;
+	     res = res->next) {
+		if (res->state != VKDEFRAG_IDLE ||
+		    res->alloc.type != defrag->type ||
+		    res->alloc.memory != memory)
+			continue;
+		/* The first move ignores budget, so passes always progress */
+		if (defrag->nmoves > 0 &&
+		    (defrag->nmoves == VKDEFRAG_MAX_MOVES ||
+		     bytes >= VKDEFRAG_MAX_PASS_BYTES ||
+		     vkclock_ns() - start >= defrag->budget_ns))
+			break;
+		result = vkdefrag_move(defrag, res);
+		if (result != VK_SUCCESS)
+			break;
+		bytes += res->alloc.size;
+	}
+	/* Other blocks running out of room is not an error */
+	if (result == VK_ERROR_OUT_OF_DEVICE_MEMORY)
+		result = VK_SUCCESS;
+	if (defrag->nmoves == 0) {
+		/* Block keeps allocations which are not movable */
+		vkdefrag_settle(defrag);
+		return result;
+	}
+	const VkResult submitted = vkdefrag_submit(defrag);
+	if (submitted != VK_SUCCESS)
+		return submitted;
+	defrag->state = VKDEFRAG_COPYING;
+	defrag->npasses++;
+	defrag->nmoved += defrag->nmoves;
+	defrag->nbytes += bytes;
+	return result;
+}
+
+VkResult vkdefrag_step(struct vkdefrag *defrag, uint64_t frame,
+		       uint64_t completed)
+{
+	const uint64_t start = vkclock_ns();
+	VkResult result = vkdefrag_finish(defrag, frame, completed);
+	if (result == VK_SUCCESS && defrag->state == VKDEFRAG_IDLE)
+		result = vkdefrag_pass(defrag, frame, start);
+	defrag->nsteps++;
+	defrag->elapsed_ns += vkclock_ns() - start;
+	return result;
+}
+
+void vkdefrag_destroy(struct vkdefrag *defrag)
+{
+	for (uint32_t i = 0; i < defrag->nmoves; ++i) {
+		struct vkdefrag_resource *res = defrag->moves[i];
+		res->ops->release(res);
+		vkmemory_free(defrag->mem, &res->moved);
+		res->state = VKDEFRAG_IDLE;
+	}
+	defrag->nmoves = 0;
+	if (defrag->block != VKMEMORY_NONE)
+		vkdefrag_settle(defrag);
+	vkDestroyFence(defrag->mem->dev, defrag->fence, defrag->mem->host);
+	vkDestroyCommandPool(defrag->mem->dev, defrag->pool, defrag->mem->host);
+}
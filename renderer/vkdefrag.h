@@ -0,0 +1,214 @@
+#ifndef RENDERER_VKDEFRAG_H
+#define RENDERER_VKDEFRAG_H
+
+#include <stdint.h>
+
+#include <renderer/vkdispatch.h>
+#include <renderer/vkmemory.h>
+#include <vulkan/vulkan_core.h>
+
+/** Maximum number of resources moved by one pass */
+#define VKDEFRAG_MAX_MOVES 32
+
+/** Maximum number of bytes copied by one pass */
+#define VKDEFRAG_MAX_PASS_BYTES ((VkDeviceSize)8 * 1024 * 1024)
+
+/** Percentage of block in use below which block is evacuated */
+#define VKDEFRAG_SPARSE_PERCENT 50
+
+/** Number of frames between searches for sparse blocks */
+#define VKDEFRAG_SEARCH_PERIOD 64
+
+/** Stage of resource move or of defragmentation pass */
+enum vkdefrag_state {
+	/** Nothing is moving */
+	VKDEFRAG_IDLE = 0,
+	/** Copies are running on GPU */
+	VKDEFRAG_COPYING,
+	/** Old memory waits for frames using it to complete */
+	VKDEFRAG_RETIRING,
+};
+
+struct vkdefrag_resource;
+
+/**
+ * Callbacks of resource owner moving resource to new memory
+ *
+ * Owner keeps contents of resource unchanged while it is moving.
+ */
+struct vkdefrag_ops {
+	/**
+	 * Creates copy of resource bound to new memory
+	 * @param res Specifies resource to copy
+	 * @param alloc Specifies memory to bind copy to
+	 * @returns VK_SUCCESS on success, or VkResult error otherwise
+	 */
+	VkResult (*create)(struct vkdefrag_resource *res,
+			   const struct vkmemory_alloc *alloc);
+	/**
+	 * Records copy of contents from resource to its copy
+	 *
+	 * Command buffer waits for all prior work before copies and makes
+	 * them visible to all later work after, so owner records layout
+	 * transitions of images only.
+	 * @param res Specifies resource to copy
+	 * @param cmd Specifies command buffer to record copy into
+	 */
+	void (*copy)(struct vkdefrag_resource *res, VkCommandBuffer cmd);
+	/**
+	 * Replaces resource by its copy and updates bindings referring to it
+	 * @param res Specifies resource moved
+	 */
+	void (*commit)(struct vkdefrag_resource *res);
+	/**
+	 * Destroys the replaced resource, or the copy if move is canceled
+	 * @param res Specifies resource moved
+	 */
+	void (*release)(struct vkdefrag_resource *res);
+};
+
+/** Resource which may be moved, embedded into its owner */
+struct vkdefrag_resource {
+	/** Previous tracked resource, or NULL */
+	struct vkdefrag_resource *prev;
+	/** Next tracked resource, or NULL */
+	struct vkdefrag_resource *next;
+	/** Callbacks of owner */
+	const struct vkdefrag_ops *ops;
+	/** Request memory of resource was allocated with */
+	struct vkmemory_request req;
+	/** Memory resource is bound to, updated when resource moves */
+	struct vkmemory_alloc alloc;
+	/** Memory of copy while copying, or replaced memory while retiring */
+	struct vkmemory_alloc moved;
+	/** Stage of move */
+	enum vkdefrag_state state;
+};
+
+/**
+ * Incremental defragmenter of device memory
+ *
+ * Every few frames defragmenter looks for the sparsest block whose
+ * allocations are all movable and fit free ranges of other blocks of its
+ * memory type. Block is evacuated by passes, each one copying a few
+ * resources on graphics queue within time budget of frame. Once copies
+ * complete resources switch to the copies, and replaced memory is freed
+ * when frames using it complete, so empty block is released. Only one pass
+ * runs at a time. Defragmenter is not thread-safe.
+ */
+struct vkdefrag {
+	/** Allocator of memory being defragmented */
+	struct vkmemory *mem;
+	/** Dispatch table of device of @a mem */
+	const struct vkdispatch *vkd;
+	/** Queue running copies */
+	VkQueue queue;
+	/** Pool of @a cmd */
+	VkCommandPool pool;
+	/** Command buffer recording copies of pass */
+	VkCommandBuffer cmd;
+	/** Fence signaled when copies of pass complete */
+	VkFence fence;
+	/** Number of nanoseconds a step may spend recording copies */
+	uint64_t budget_ns;
+	/** The first tracked resource, or NULL */
+	struct vkdefrag_resource *first;
+	/** The last tracked resource, or NULL */
+	struct vkdefrag_resource *last;
+	/** Memory type of block being evacuated */
+	uint32_t type;
+	/** Index of block being evacuated, or VKMEMORY_NONE */
+	uint32_t block;
+	/** Number of the frame the next search may run at */
+	uint64_t next_search;
+	/** Stage of pass */
+	enum vkdefrag_state state;
+	/** Number of the last frame using memory replaced by pass */
+	uint64_t frame;
+	/** Resources moved by pass */
+	struct vkdefrag_resource *moves[VKDEFRAG_MAX_MOVES];
+	/** Number of resources moved by pass */
+	uint32_t nmoves;
+	/** Number of passes submitted */
+	uint64_t npasses;
+	/** Number of resources moved */
+	uint64_t nmoved;
+	/** Number of bytes moved */
+	uint64_t nbytes;
+	/** Number of blocks evacuated */
+	uint64_t nblocks;
+	/** Number of steps made */
+	uint64_t nsteps;
+	/** Number of nanoseconds spent by steps */
+	uint64_t elapsed_ns;
+};
+
+#ifdef __cplusplus
+/* *INDENT-OFF* */
+extern "C" {
+/* *INDENT-ON* */
+#endif
+
+/**
+ * Initializes defragmenter
+ * @param defrag Specifies defragmenter to initialize
+ * @param mem Specifies allocator of memory to defragment
+ * @param vkd Specifies dispatch table of device of @a mem
+ * @param family Specifies queue family of @a queue
+ * @param queue Specifies queue to run copies on
+ * @param budget_ns Specifies number of nanoseconds a step may spend
+ * @returns VK_SUCCESS on success, or VkResult error otherwise
+ */
+VkResult vkdefrag_init(struct vkdefrag *defrag, struct vkmemory *mem,
+		       const struct vkdispatch *vkd, uint32_t family,
+		       VkQueue queue, uint64_t budget_ns);
+
+/**
+ * Starts tracking resource as movable
+ *
+ * Dedicated allocations never move.
+ * @param defrag Specifies defragmenter to track resource in
+ * @param res Specifies resource to track
+ * @param req Specifies request memory of resource was allocated with
+ * @param alloc Specifies memory of resource
+ * @param ops Specifies callbacks moving resource
+ */
+void vkdefrag_track(struct vkdefrag *defrag, struct vkdefrag_resource *res,
+		    const struct vkmemory_request *req,
+		    const struct vkmemory_alloc *alloc,
+		    const struct vkdefrag_ops *ops);
+
+/**
+ * Stops tracking resource, before its owner destroys it
+ *
+ * Move of resource is finished or canceled, so owner frees memory in
+ * @a res->alloc afterwards.
+ * @param defrag Specifies defragmenter tracking resource
+ * @param res Specifies resource to untrack
+ * @returns VK_SUCCESS on success, or VkResult error otherwise
+ */
+VkResult vkdefrag_untrack(struct vkdefrag *defrag,
+			  struct vkdefrag_resource *res);
+
+/**
+ * Advances defragmentation, called once per frame
+ * @param defrag Specifies defragmenter to advance
+ * @param frame Specifies number of the last submitted frame
+ * @param completed Specifies number of the last completed frame
+ * @returns VK_SUCCESS on success, or VkResult error otherwise
+ */
+VkResult vkdefrag_step(struct vkdefrag *defrag, uint64_t frame,
+		       uint64_t completed);
+
+/**
+ * Destroys defragmenter, once device is idle
+ * @param defrag Specifies defragmenter to destroy
+ */
+void vkdefrag_destroy(struct vkdefrag *defrag);
+
+#ifdef __cplusplus
+/* *INDENT-OFF* */
+}
+/* *INDENT-ON* */
+#endif
+#endif
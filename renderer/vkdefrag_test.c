@@ -0,0 +1,521 @@
+/**
+ * @file
+ * Test suite for vkdefrag
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdint.h>
+#include <string.h>
+
+#include <cgreen/cgreen.h>
+#include <cgreen/mocks.h>
+
+#include <vulkan/vulkan_core.h>
+#include "vkdefrag.h"
+#include "vkmemory.h"
+
+/** Size of memory blocks */
+#define BLOCK_SIZE 1000
+
+/** Size of tracked resources */
+#define RESOURCE_SIZE 100
+
+/** Number of tracked resources */
+#define NRESOURCES 3
+
+/** Device memory of sparse block */
+#define SPARSE_MEMORY ((VkDeviceMemory)(uintptr_t)0x10)
+
+/** Device memory of dense block */
+#define DENSE_MEMORY ((VkDeviceMemory)(uintptr_t)0x20)
+
+/** Command buffer recording copies */
+#define COPY_CMD ((VkCommandBuffer)(uintptr_t)0x30)
+
+/** Pool of memory type defragmented */
+static struct vkmemory_pool pool;
+
+/** Blocks of @a pool */
+static struct vkmemory_block blocks[2];
+
+/** Status of fence reported by device */
+static VkResult fence_status;
+
+/** Number of allocations made before fake allocation fails */
+static uint32_t failing_alloc;
+
+/** Number of allocations made */
+static uint32_t nallocs;
+
+/** The last request of allocation */
+static struct vkmemory_request last_request;
+
+/** Number of allocations freed */
+static uint32_t nfrees;
+
+/** Device memory of the last allocation freed */
+static VkDeviceMemory freed_memory;
+
+/** Number of settled evacuations */
+static uint32_t nsettles;
+
+/** Number of submissions */
+static uint32_t nsubmits;
+
+/** Number of copies created by owner */
+static uint32_t ncreates;
+
+/** Number of copies recorded by owner */
+static uint32_t ncopies;
+
+/** Number of moves committed by owner */
+static uint32_t ncommits;
+
+/** Number of resources released by owner */
+static uint32_t nreleases;
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateCommandPool(
+	VkDevice device, const VkCommandPoolCreateInfo *pCreateInfo,
+	const VkAllocationCallbacks *pAllocator, VkCommandPool *pCommandPool)
+{
+	(void)(device);
+	(void)(pCreateInfo);
+	(void)(pAllocator);
+	*pCommandPool = (VkCommandPool)(uintptr_t)0x1;
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkAllocateCommandBuffers(
+	VkDevice device, const VkCommandBufferAllocateInfo *pAllocateInfo,
+	VkCommandBuffer *pCommandBuffers)
+{
+	(void)(device);
+	(void)(pAllocateInfo);
+	*pCommandBuffers = COPY_CMD;
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateFence(
+	VkDevice device, const VkFenceCreateInfo *pCreateInfo,
+	const VkAllocationCallbacks *pAllocator, VkFence *pFence)
+{
+	(void)(device);
+	(void)(pCreateInfo);
+	(void)(pAllocator);
+	*pFence = (VkFence)(uintptr_t)0x2;
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkGetFenceStatus(VkDevice device,
+						VkFence fence)
+{
+	(void)(device);
+	(void)(fence);
+	return fence_status;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkWaitForFences(VkDevice device,
+					       uint32_t fenceCount,
+					       const VkFence *pFences,
+					       VkBool32 waitAll,
+					       uint64_t timeout)
+{
+	return (VkResult)mock(device, fenceCount, pFences, waitAll, timeout);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkResetFences(VkDevice device,
+					     uint32_t fenceCount,
+					     const VkFence *pFences)
+{
+	(void)(device);
+	(void)(fenceCount);
+	(void)(pFences);
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkBeginCommandBuffer(VkCommandBuffer commandBuffer,
+		     const VkCommandBufferBeginInfo *pBeginInfo)
+{
+	(void)(commandBuffer);
+	(void)(pBeginInfo);
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkEndCommandBuffer(VkCommandBuffer commandBuffer)
+{
+	(void)(commandBuffer);
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdPipelineBarrier(
+	VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStageMask,
+	VkPipelineStageFlags dstStageMask, VkDependencyFlags dependencyFlags,
+	uint32_t memoryBarrierCount, const VkMemoryBarrier *pMemoryBarriers,
+	uint32_t bufferMemoryBarrierCount,
+	const VkBufferMemoryBarrier *pBufferMemoryBarriers,
+	uint32_t imageMemoryBarrierCount,
+	const VkImageMemoryBarrier *pImageMemoryBarriers)
+{
+	(void)(commandBuffer);
+	(void)(srcStageMask);
+	(void)(dstStageMask);
+	(void)(dependencyFlags);
+	(void)(memoryBarrierCount);
+	(void)(pMemoryBarriers);
+	(void)(bufferMemoryBarrierCount);
+	(void)(pBufferMemoryBarriers);
+	(void)(imageMemoryBarrierCount);
+	(void)(pImageMemoryBarriers);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkQueueSubmit(VkQueue queue,
+					     uint32_t submitCount,
+					     const VkSubmitInfo *pSubmits,
+					     VkFence fence)
+{
+	(void)(queue);
+	(void)(submitCount);
+	(void)(pSubmits);
+	(void)(fence);
+	nsubmits++;
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL
+vkDestroyFence(VkDevice device, VkFence fence,
+	       const VkAllocationCallbacks *pAllocator)
+{
+	(void)(device);
+	(void)(fence);
+	(void)(pAllocator);
+}
+
+VKAPI_ATTR void VKAPI_CALL
+vkDestroyCommandPool(VkDevice device, VkCommandPool commandPool,
+		     const VkAllocationCallbacks *pAllocator)
+{
+	(void)(device);
+	(void)(commandPool);
+	(void)(pAllocator);
+}
+
+/** Dispatch table calling mocked functions */
+static const struct vkdispatch mocked_dispatch = {
+	.vkBeginCommandBuffer = vkBeginCommandBuffer,
+	.vkEndCommandBuffer = vkEndCommandBuffer,
+	.vkCmdPipelineBarrier = vkCmdPipelineBarrier,
+	.vkResetFences = vkResetFences,
+	.vkGetFenceStatus = vkGetFenceStatus,
+	.vkWaitForFences = vkWaitForFences,
+	.vkQueueSubmit = vkQueueSubmit,
+};
+
+VkResult vkmemory_alloc(struct vkmemory *mem,
+			const struct vkmemory_request *req,
+			struct vkmemory_alloc *alloc)
+{
+	(void)(mem);
+	if (nallocs == failing_alloc)
+		return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+	last_request = *req;
+	alloc->memory = DENSE_MEMORY;
+	alloc->offset = 600 + RESOURCE_SIZE * nallocs++;
+	alloc->size = req->reqs.size;
+	alloc->mapped = NULL;
+	alloc->type = 0;
+	alloc->range = 1;
+	return VK_SUCCESS;
+}
+
+void vkmemory_free(struct vkmemory *mem, const struct vkmemory_alloc *alloc)
+{
+	(void)(mem);
+	freed_memory = alloc->memory;
+	nfrees++;
+}
+
+void vkmemory_evacuate(struct vkmemory *mem, uint32_t type, uint32_t block)
+{
+	(void)(type);
+	mem->pools[0]->evacuating = block;
+}
+
+void vkmemory_settle(struct vkmemory *mem, uint32_t type)
+{
+	(void)(type);
+	mem->pools[0]->evacuating = VKMEMORY_NONE;
+	nsettles++;
+}
+
+/**
+ * Creates copy of resource
+ * @param res Specifies resource to copy
+ * @param alloc Specifies memory of copy
+ * @returns VK_SUCCESS
+ */
+static VkResult create_copy(struct vkdefrag_resource *res,
+			    const struct vkmemory_alloc *alloc)
+{
+	(void)(res);
+	(void)(alloc);
+	ncreates++;
+	return VK_SUCCESS;
+}
+
+/**
+ * Records copy of resource
+ * @param res Specifies resource to copy
+ * @param cmd Specifies command buffer to record copy into
+ */
+static void record_copy(struct vkdefrag_resource *res, VkCommandBuffer cmd)
+{
+	(void)(res);
+	if (cmd == COPY_CMD)
+		ncopies++;
+}
+
+/**
+ * Switches resource to its copy
+ * @param res Specifies resource moved
+ */
+static void commit_copy(struct vkdefrag_resource *res)
+{
+	(void)(res);
+	ncommits++;
+}
+
+/**
+ * Destroys resource no longer used
+ * @param res Specifies resource moved
+ */
+static void release_copy(struct vkdefrag_resource *res)
+{
+	(void)(res);
+	nreleases++;
+}
+
+/** Callbacks of tracked resources */
+static const struct vkdefrag_ops ops = {
+	.create = create_copy,
+	.copy = record_copy,
+	.commit = commit_copy,
+	.release = release_copy,
+};
+
+/**
+ * Initializes allocator with sparse and dense blocks of one memory type
+ * @param mem Specifies allocator to initialize
+ * @param sparse_used Specifies number of bytes used in sparse block
+ */
+static void init_memory(struct vkmemory *mem, VkDeviceSize sparse_used)
+{
+	memset(mem, 0, sizeof(*mem));
+	memset(&pool, 0, sizeof(pool));
+	mem->props.memoryTypeCount = 1;
+	mem->pools[0] = &pool;
+	pool.blocks = blocks;
+	pool.nblocks = 2;
+	pool.evacuating = VKMEMORY_NONE;
+	blocks[0].memory = SPARSE_MEMORY;
+	blocks[0].size = BLOCK_SIZE;
+	blocks[0].used = sparse_used;
+	blocks[1].memory = DENSE_MEMORY;
+	blocks[1].size = BLOCK_SIZE;
+	blocks[1].used = 600;
+	fence_status = VK_NOT_READY;
+	failing_alloc = UINT32_MAX;
+	nallocs = 0;
+	nfrees = 0;
+	freed_memory = VK_NULL_HANDLE;
+	nsettles = 0;
+	nsubmits = 0;
+	ncreates = 0;
+	ncopies = 0;
+	ncommits = 0;
+	nreleases = 0;
+}
+
+/**
+ * Initializes defragmenter tracking resources of sparse block
+ * @param defrag Specifies defragmenter to initialize
+ * @param mem Specifies allocator of sparse block
+ * @param res Specifies resources to track
+ * @param budget_ns Specifies time budget of step
+ */
+static void init_defrag(struct vkdefrag *defrag, struct vkmemory *mem,
+			struct vkdefrag_resource *res, uint64_t budget_ns)
+{
+	struct vkmemory_request req;
+	memset(&req, 0, sizeof(req));
+	req.reqs.size = RESOURCE_SIZE;
+	req.reqs.alignment = 16;
+	req.reqs.memoryTypeBits = 0x3;
+	req.kind = VKMEMORY_LINEAR;
+	vkdefrag_init(defrag, mem, &mocked_dispatch, 0, VK_NULL_HANDLE,
+		      budget_ns);
+	for (uint32_t i = 0; i < NRESOURCES; ++i) {
+		const struct vkmemory_alloc alloc = {
+			.memory = SPARSE_MEMORY,
+			.offset = RESOURCE_SIZE * i,
+			.size = RESOURCE_SIZE,
+			.mapped = NULL,
+			.type = 0,
+			.range = i,
+		};
+		vkdefrag_track(defrag, &res[i], &req, &alloc, &ops);
+	}
+}
+
+Ensure(step_moves_resources_of_sparse_block)
+{
+	struct vkmemory mem;
+	struct vkdefrag defrag;
+	struct vkdefrag_resource res[NRESOURCES];
+	init_memory(&mem, RESOURCE_SIZE * NRESOURCES);
+	init_defrag(&defrag, &mem, res, UINT64_MAX);
+	VkResult result = vkdefrag_step(&defrag, 0, 0);
+	assert_that(result, is_equal_to(VK_SUCCESS));
+	assert_that(pool.evacuating, is_equal_to(0));
+	assert_that(ncreates, is_equal_to(NRESOURCES));
+	assert_that(ncopies, is_equal_to(NRESOURCES));
+	assert_that(nsubmits, is_equal_to(1));
+	assert_that(last_request.compact, is_true);
+	assert_that(last_request.reqs.memoryTypeBits, is_equal_to(0x1));
+	assert_that(defrag.state, is_equal_to(VKDEFRAG_COPYING));
+	assert_that(defrag.nbytes, is_equal_to(RESOURCE_SIZE * NRESOURCES));
+}
+
+Ensure(step_leaves_blocks_with_unmovable_memory)
+{
+	struct vkmemory mem;
+	struct vkdefrag defrag;
+	struct vkdefrag_resource res[NRESOURCES];
+	init_memory(&mem, RESOURCE_SIZE * (NRESOURCES + 1));
+	init_defrag(&defrag, &mem, res, UINT64_MAX);
+	vkdefrag_step(&defrag, 0, 0);
+	assert_that(pool.evacuating, is_equal_to(VKMEMORY_NONE));
+	assert_that(nsubmits, is_equal_to(0));
+}
+
+Ensure(step_leaves_densely_used_blocks)
+{
+	struct vkmemory mem;
+	struct vkdefrag defrag;
+	struct vkdefrag_resource res[NRESOURCES];
+	init_memory(&mem, RESOURCE_SIZE * NRESOURCES);
+	blocks[0].size = RESOURCE_SIZE * NRESOURCES;
+	init_defrag(&defrag, &mem, res, UINT64_MAX);
+	vkdefrag_step(&defrag, 0, 0);
+	assert_that(pool.evacuating, is_equal_to(VKMEMORY_NONE));
+	assert_that(nsubmits, is_equal_to(0));
+}
+
+Ensure(step_moves_one_resource_when_budget_is_spent)
+{
+	struct vkmemory mem;
+	struct vkdefrag defrag;
+	struct vkdefrag_resource res[NRESOURCES];
+	init_memory(&mem, RESOURCE_SIZE * NRESOURCES);
+	init_defrag(&defrag, &mem, res, 0);
+	vkdefrag_step(&defrag, 0, 0);
+	assert_that(ncreates, is_equal_to(1));
+	assert_that(defrag.nmoves, is_equal_to(1));
+}
+
+Ensure(step_commits_moves_once_copies_complete)
+{
+	struct vkmemory mem;
+	struct vkdefrag defrag;
+	struct vkdefrag_resource res[NRESOURCES];
+	init_memory(&mem, RESOURCE_SIZE * NRESOURCES);
+	init_defrag(&defrag, &mem, res, UINT64_MAX);
+	vkdefrag_step(&defrag, 0, 0);
+	vkdefrag_step(&defrag, 1, 0);
+	assert_that(ncommits, is_equal_to(0));
+	fence_status = VK_SUCCESS;
+	vkdefrag_step(&defrag, 5, 3);
+	assert_that(ncommits, is_equal_to(NRESOURCES));
+	assert_that(res[0].alloc.memory, is_equal_to(DENSE_MEMORY));
+	assert_that(res[0].state, is_equal_to(VKDEFRAG_RETIRING));
+	assert_that(nreleases, is_equal_to(0));
+	assert_that(nsubmits, is_equal_to(1));
+}
+
+Ensure(step_frees_replaced_memory_once_frames_complete)
+{
+	struct vkmemory mem;
+	struct vkdefrag defrag;
+	struct vkdefrag_resource res[NRESOURCES];
+	init_memory(&mem, RESOURCE_SIZE * NRESOURCES);
+	init_defrag(&defrag, &mem, res, UINT64_MAX);
+	vkdefrag_step(&defrag, 0, 0);
+	fence_status = VK_SUCCESS;
+	vkdefrag_step(&defrag, 5, 3);
+	vkdefrag_step(&defrag, 6, 4);
+	assert_that(nreleases, is_equal_to(0));
+	pool.evacuating = VKMEMORY_NONE;
+	vkdefrag_step(&defrag, 7, 5);
+	assert_that(nreleases, is_equal_to(NRESOURCES));
+	assert_that(nfrees, is_equal_to(NRESOURCES));
+	assert_that(freed_memory, is_equal_to(SPARSE_MEMORY));
+	assert_that(res[2].state, is_equal_to(VKDEFRAG_IDLE));
+	assert_that(defrag.nblocks, is_equal_to(1));
+	assert_that(defrag.block, is_equal_to(VKMEMORY_NONE));
+}
+
+Ensure(step_settles_block_when_other_blocks_are_full)
+{
+	struct vkmemory mem;
+	struct vkdefrag defrag;
+	struct vkdefrag_resource res[NRESOURCES];
+	init_memory(&mem, RESOURCE_SIZE * NRESOURCES);
+	init_defrag(&defrag, &mem, res, UINT64_MAX);
+	failing_alloc = 0;
+	VkResult result = vkdefrag_step(&defrag, 0, 0);
+	assert_that(result, is_equal_to(VK_SUCCESS));
+	assert_that(nsettles, is_equal_to(1));
+	assert_that(nsubmits, is_equal_to(0));
+	assert_that(defrag.block, is_equal_to(VKMEMORY_NONE));
+	assert_that(defrag.nblocks, is_equal_to(0));
+}
+
+Ensure(untrack_cancels_move_in_flight)
+{
+	struct vkmemory mem;
+	struct vkdefrag defrag;
+	struct vkdefrag_resource res[NRESOURCES];
+	init_memory(&mem, RESOURCE_SIZE * NRESOURCES);
+	init_defrag(&defrag, &mem, res, UINT64_MAX);
+	vkdefrag_step(&defrag, 0, 0);
+	expect(vkWaitForFences, will_return(VK_SUCCESS));
+	VkResult result = vkdefrag_untrack(&defrag, &res[1]);
+	assert_that(result, is_equal_to(VK_SUCCESS));
+	assert_that(nreleases, is_equal_to(1));
+	assert_that(freed_memory, is_equal_to(DENSE_MEMORY));
+	assert_that(res[1].alloc.memory, is_equal_to(SPARSE_MEMORY));
+	assert_that(defrag.nmoves, is_equal_to(NRESOURCES - 1));
+	assert_that(res[0].next, is_equal_to(&res[2]));
+}
+
+int main(int argc, char **argv)
+{
+	(void)(argc);
+	(void)(argv);
+	TestSuite *suite = create_named_test_suite("VKDefrag");
+	add_test(suite, step_moves_resources_of_sparse_block);
+	add_test(suite, step_leaves_blocks_with_unmovable_memory);
+	add_test(suite, step_leaves_densely_used_blocks);
+	add_test(suite, step_moves_one_resource_when_budget_is_spent);
+	add_test(suite, step_commits_moves_once_copies_complete);
+	add_test(suite, step_frees_replaced_memory_once_frames_complete);
+	add_test(suite, step_settles_block_when_other_blocks_are_full);
+	add_test(suite, untrack_cancels_move_in_flight);
+	TestReporter *reporter = create_text_reporter();
+	int exit_code = run_test_suite(suite, reporter);
+	destroy_reporter(reporter);
+	destroy_test_suite(suite);
+	return exit_code;
+}
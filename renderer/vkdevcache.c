@@ -0,0 +1,114 @@
+/**
+ * @file
+ * Cache of selected Vulkan device implementation
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "vkdevcache.h"
+#include <vulkan/vulkan_core.h>
+
+/** Magic number identifying cache file, "TDXD" */
+#define VKDEVCACHE_MAGIC 0x44584454U
+
+/** Version of cache file layout */
+#define VKDEVCACHE_VERSION 4U
+
+/** Header of cache file */
+struct vkdevcache_header {
+	/** Magic number, VKDEVCACHE_MAGIC */
+	uint32_t magic;
+	/** Version of file layout, VKDEVCACHE_VERSION */
+	uint32_t version;
+	/** Size of cached device following header */
+	uint32_t size;
+};
+
+int vkdevcache_identify(struct vkdevcache *cache, VkPhysicalDevice phy)
+{
+	VkPhysicalDeviceIDProperties id = {
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES,
+		.pNext = NULL,
+	};
+	VkPhysicalDeviceProperties2 props = {
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+		.pNext = &id,
+	};
+	vkGetPhysicalDeviceProperties2(phy, &props);
+	/* Device identifiers are reported since Vulkan 1.1 */
+	if (props.properties.apiVersion < VK_API_VERSION_1_1)
+		return -1;
+	memcpy(cache->device_uuid, id.deviceUUID, VK_UUID_SIZE);
+	memcpy(cache->driver_uuid, id.driverUUID, VK_UUID_SIZE);
+	cache->vendor_id = props.properties.vendorID;
+	cache->device_id = props.properties.deviceID;
+	cache->driver_version = props.properties.driverVersion;
+	return 0;
+}
+
+int vkdevcache_matches(const struct vkdevcache *cache, VkPhysicalDevice phy)
+{
+	struct vkdevcache id;
+	if (vkdevcache_identify(&id, phy))
+		return 0;
+	return !memcmp(cache->device_uuid, id.device_uuid, VK_UUID_SIZE) &&
+	       !memcmp(cache->driver_uuid, id.driver_uuid, VK_UUID_SIZE) &&
+	       cache->vendor_id == id.vendor_id &&
+	       cache->device_id == id.device_id &&
+	       cache->driver_version == id.driver_version;
+}
+
+int vkdevcache_load(struct vkdevcache *cache, const char *path)
+{
+	struct vkdevcache_header header;
+	FILE *file = fopen(path, "rb");
+	if (file == NULL)
+		return -1;
+	int result = -1;
+	if (fread(&header, sizeof(header), 1, file) != 1)
+		goto close_file;
+	if (header.magic != VKDEVCACHE_MAGIC ||
+	    header.version != VKDEVCACHE_VERSION ||
+	    header.size != sizeof(struct vkdevcache))
+		goto close_file;
+	if (fread(cache, sizeof(struct vkdevcache), 1, file) == 1)
+		result = 0;
+close_file:
+	fclose(file);
+	return result;
+}
+
+int vkdevcache_save(const struct vkdevcache *cache, const char *path)
+{
+	const struct vkdevcache_header header = {
+		.magic = VKDEVCACHE_MAGIC,
+		.version = VKDEVCACHE_VERSION,
+		.size = sizeof(struct vkdevcache),
+	};
+	static const char suffix[] = ".tmp";
+	char *tmp = malloc(strlen(path) + sizeof(suffix));
+	if (tmp == NULL)
+		return -1;
+	strcpy(tmp, path);
+	strcat(tmp, suffix);
+	FILE *file = fopen(tmp, "wb");
+	if (file == NULL) {
+		free(tmp);
+		return -1;
+	}
+	int written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+		      fwrite(cache, sizeof(*cache), 1, file) == 1;
+	if (fclose(file) || !written || rename(tmp, path)) {
+		remove(tmp);
+		free(tmp);
+		return -1;
+	}
+	free(tmp);
+	return 0;
+}
@@ -0,0 +1,83 @@
+#ifndef RENDERER_VKDEVCACHE_H
+#define RENDERER_VKDEVCACHE_H
+
+#include <stdint.h>
+
+#include <vulkan/vulkan_core.h>
+
+/**
+ * Device selected on previous launch
+ *
+ * Selection is valid only while device reports the same identity, so it is
+ * invalidated when driver is updated.
+ */
+struct vkdevcache {
+	/** Universally unique identifier of device */
+	uint8_t device_uuid[VK_UUID_SIZE];
+	/** Universally unique identifier of driver */
+	uint8_t driver_uuid[VK_UUID_SIZE];
+	/** Vendor of device */
+	uint32_t vendor_id;
+	/** Device identifier within vendor */
+	uint32_t device_id;
+	/** Version of driver */
+	uint32_t driver_version;
+	/** Queue family index that supports graphics operations */
+	uint32_t graphic;
+	/** Number of queues in graphics family */
+	uint32_t graphic_nqueues;
+	/** Queue family index that supports presentation */
+	uint32_t present;
+	/** Queue family index running compute jobs */
+	uint32_t compute;
+	/** Queue family index running uploads */
+	uint32_t transfer;
+};
+
+#ifdef __cplusplus
+/* *INDENT-OFF* */
+extern "C" {
+/* *INDENT-ON* */
+#endif
+
+/**
+ * Fills identity of device and its driver
+ * @param cache Specifies cache to fill identity of
+ * @param phy Specifies device to identify
+ * @returns zero on success, or non-zero if device can't be identified
+ */
+int vkdevcache_identify(struct vkdevcache *cache, VkPhysicalDevice phy);
+
+/**
+ * Checks if device and its driver are the ones cached
+ * @param cache Specifies cached device
+ * @param phy Specifies device to check
+ * @returns non-zero if device matches cache, or zero otherwise
+ */
+int vkdevcache_matches(const struct vkdevcache *cache, VkPhysicalDevice phy);
+
+/**
+ * Loads cached device from file
+ * @param cache Specifies cache to load
+ * @param path Specifies path to cache file
+ * @returns zero on success, or non-zero if file is missing or invalid
+ */
+int vkdevcache_load(struct vkdevcache *cache, const char *path);
+
+/**
+ * Saves cached device to file
+ *
+ * File is replaced atomically, so concurrent launches never read partially
+ * written cache.
+ * @param cache Specifies cache to save
+ * @param path Specifies path to cache file
+ * @returns zero on success, or non-zero otherwise
+ */
+int vkdevcache_save(const struct vkdevcache *cache, const char *path);
+
+#ifdef __cplusplus
+/* *INDENT-OFF* */
+}
+/* *INDENT-ON* */
+#endif
+#endif
@@ -0,0 +1,122 @@
+/**
+ * @file
+ * Test suite for vkdevcache
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cgreen/cgreen.h>
+#include <cgreen/mocks.h>
+
+#include <vulkan/vulkan_core.h>
+#include "vkdevcache.h"
+
+/** Path of cache file used by tests */
+#define CACHE_PATH "vkdevcache_test.cache"
+
+/** Driver version reported by vkGetPhysicalDeviceProperties2 */
+static uint32_t reported_driver_version;
+
+VKAPI_ATTR void VKAPI_CALL
+vkGetPhysicalDeviceProperties2(VkPhysicalDevice physicalDevice,
+			       VkPhysicalDeviceProperties2 *pProperties)
+{
+	VkPhysicalDeviceIDProperties *id = pProperties->pNext;
+	memset(id->deviceUUID, 0xAB, VK_UUID_SIZE);
+	memset(id->driverUUID, 0xCD, VK_UUID_SIZE);
+	pProperties->properties.vendorID = 0x10DE;
+	pProperties->properties.deviceID = 0x2204;
+	pProperties->properties.driverVersion = reported_driver_version;
+	pProperties->properties.apiVersion =
+		(uint32_t)mock(physicalDevice, pProperties);
+}
+
+Ensure(matches_identified_device)
+{
+	struct vkdevcache cache;
+	reported_driver_version = 1;
+	always_expect(vkGetPhysicalDeviceProperties2,
+		      will_return(VK_API_VERSION_1_3));
+	int result = vkdevcache_identify(&cache, VK_NULL_HANDLE);
+	assert_that(result, is_equal_to(0));
+	assert_that(cache.device_uuid[0], is_equal_to(0xAB));
+	assert_that(vkdevcache_matches(&cache, VK_NULL_HANDLE),
+		    is_not_equal_to(0));
+}
+
+Ensure(does_not_match_after_driver_update)
+{
+	struct vkdevcache cache;
+	reported_driver_version = 1;
+	always_expect(vkGetPhysicalDeviceProperties2,
+		      will_return(VK_API_VERSION_1_3));
+	vkdevcache_identify(&cache, VK_NULL_HANDLE);
+	reported_driver_version = 2;
+	assert_that(vkdevcache_matches(&cache, VK_NULL_HANDLE),
+		    is_equal_to(0));
+}
+
+Ensure(identify_fails_on_vulkan_1_0_device)
+{
+	struct vkdevcache cache;
+	expect(vkGetPhysicalDeviceProperties2,
+	       will_return(VK_API_VERSION_1_0));
+	int result = vkdevcache_identify(&cache, VK_NULL_HANDLE);
+	assert_that(result, is_not_equal_to(0));
+}
+
+Ensure(load_returns_saved_device)
+{
+	struct vkdevcache saved, loaded;
+	memset(&saved, 0x5A, sizeof(saved));
+	saved.graphic = 1;
+	saved.present = 2;
+	assert_that(vkdevcache_save(&saved, CACHE_PATH), is_equal_to(0));
+	int result = vkdevcache_load(&loaded, CACHE_PATH);
+	remove(CACHE_PATH);
+	assert_that(result, is_equal_to(0));
+	assert_that(&loaded, is_equal_to_contents_of(&saved, sizeof(saved)));
+}
+
+Ensure(load_fails_on_missing_file)
+{
+	struct vkdevcache cache;
+	remove(CACHE_PATH);
+	int result = vkdevcache_load(&cache, CACHE_PATH);
+	assert_that(result, is_not_equal_to(0));
+}
+
+Ensure(load_fails_on_foreign_file)
+{
+	struct vkdevcache cache;
+	FILE *file = fopen(CACHE_PATH, "wb");
+	fputs("not a device cache, just some text long enough", file);
+	fclose(file);
+	int result = vkdevcache_load(&cache, CACHE_PATH);
+	remove(CACHE_PATH);
+	assert_that(result, is_not_equal_to(0));
+}
+
+int main(int argc, char **argv)
+{
+	(void)(argc);
+	(void)(argv);
+	TestSuite *suite = create_named_test_suite("VKDevCache");
+	add_test(suite, matches_identified_device);
+	add_test(suite, does_not_match_after_driver_update);
+	add_test(suite, identify_fails_on_vulkan_1_0_device);
+	add_test(suite, load_returns_saved_device);
+	add_test(suite, load_fails_on_missing_file);
+	add_test(suite, load_fails_on_foreign_file);
+	TestReporter *reporter = create_text_reporter();
+	int exit_code = run_test_suite(suite, reporter);
+	destroy_reporter(reporter);
+	destroy_test_suite(suite);
+	return exit_code;
+}
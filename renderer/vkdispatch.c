@@ -0,0 +1,92 @@
+/**
+ * @file
+ * Vulkan device dispatch table implementation
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "vkclock.h"
+#include "vkdispatch.h"
+#include <vulkan/vulkan_core.h>
+
+/** Loads dispatch table entry from device */
+#define VKDISPATCH_LOAD(name, params, args)                                   \
+	vkd->name = (PFN_##name)vkGetDeviceProcAddr(dev, #name);
+
+#ifdef VKDISPATCH_ACCOUNTING
+/** Dispatch table whose calls are accounted */
+static struct vkdispatch *vkdispatch_accounted;
+
+/**
+ * Accounts call made through dispatch table entry
+ * @param calls Specifies calls of the entry
+ * @param start Specifies time the call started at, in nanoseconds
+ */
+static void vkdispatch_account(struct vkdispatch_calls *calls, uint64_t start)
+{
+	const uint64_t elapsed = vkclock_ns() - start;
+	atomic_fetch_add_explicit(&calls->ns, elapsed, memory_order_relaxed);
+	atomic_fetch_add_explicit(&calls->count, 1, memory_order_relaxed);
+}
+
+/** Defines wrapper accounting calls of function returning VkResult */
+#define VKDISPATCH_RESULT_WRAPPER(name, params, args)                         \
+	static VKAPI_ATTR VkResult VKAPI_CALL vkdispatch_##name params        \
+	{                                                                     \
+		struct vkdispatch *vkd = vkdispatch_accounted;                \
+		const uint64_t start = vkclock_ns();                          \
+		const VkResult result = vkd->driver.name args;                \
+		vkdispatch_account(&vkd->calls.name, start);                  \
+		return result;                                                \
+	}
+
+/** Defines wrapper accounting calls of function returning nothing */
+#define VKDISPATCH_VOID_WRAPPER(name, params, args)                           \
+	static VKAPI_ATTR void VKAPI_CALL vkdispatch_##name params            \
+	{                                                                     \
+		struct vkdispatch *vkd = vkdispatch_accounted;                \
+		const uint64_t start = vkclock_ns();                          \
+		vkd->driver.name args;                                        \
+		vkdispatch_account(&vkd->calls.name, start);                  \
+	}
+
+VKDISPATCH_RESULT_FUNCTIONS(VKDISPATCH_RESULT_WRAPPER)
+VKDISPATCH_VOID_FUNCTIONS(VKDISPATCH_VOID_WRAPPER)
+
+/** Moves loaded table entry to driver part, replacing it with wrapper */
+#define VKDISPATCH_WRAP(name, params, args)                                   \
+	vkd->driver.name = vkd->name;                                         \
+	if (vkd->name != NULL)                                                \
+		vkd->name = vkdispatch_##name;
+
+/** Resets call accounting of dispatch table entry */
+#define VKDISPATCH_RESET(name, params, args)                                  \
+	atomic_store(&vkd->calls.name.count, 0);                              \
+	atomic_store(&vkd->calls.name.ns, 0);
+#endif
+
+void vkdispatch_init(struct vkdispatch *vkd, VkDevice dev)
+{
+	VKDISPATCH_RESULT_FUNCTIONS(VKDISPATCH_LOAD)
+	VKDISPATCH_VOID_FUNCTIONS(VKDISPATCH_LOAD)
+#ifdef VKDISPATCH_ACCOUNTING
+	VKDISPATCH_RESULT_FUNCTIONS(VKDISPATCH_WRAP)
+	VKDISPATCH_VOID_FUNCTIONS(VKDISPATCH_WRAP)
+	vkdispatch_reset_calls(vkd);
+	vkdispatch_accounted = vkd;
+#endif
+}
+
+void vkdispatch_reset_calls(struct vkdispatch *vkd)
+{
+#ifdef VKDISPATCH_ACCOUNTING
+	VKDISPATCH_RESULT_FUNCTIONS(VKDISPATCH_RESET)
+	VKDISPATCH_VOID_FUNCTIONS(VKDISPATCH_RESET)
+#else
+	(void)(vkd);
+#endif
+}
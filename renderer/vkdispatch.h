@@ -0,0 +1,161 @@
+#ifndef RENDERER_VKDISPATCH_H
+#define RENDERER_VKDISPATCH_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include <vulkan/vulkan_core.h>
+
+/**
+ * Device-level functions on rendering hot path returning VkResult
+ *
+ * Each entry is X(name, parameters, arguments).
+ */
+#define VKDISPATCH_RESULT_FUNCTIONS(X)                                        \
+	X(vkAcquireNextImageKHR,                                              \
+	  (VkDevice device, VkSwapchainKHR swapchain, uint64_t timeout,       \
+	   VkSemaphore semaphore, VkFence fence, uint32_t *pImageIndex),      \
+	  (device, swapchain, timeout, semaphore, fence, pImageIndex))        \
+	X(vkResetFences,                                                      \
+	  (VkDevice device, uint32_t fenceCount, const VkFence *pFences),     \
+	  (device, fenceCount, pFences))                                      \
+	X(vkQueueSubmit,                                                      \
+	  (VkQueue queue, uint32_t submitCount, const VkSubmitInfo *pSubmits, \
+	   VkFence fence),                                                    \
+	  (queue, submitCount, pSubmits, fence))                              \
+	X(vkQueuePresentKHR,                                                  \
+	  (VkQueue queue, const VkPresentInfoKHR *pPresentInfo),              \
+	  (queue, pPresentInfo))                                              \
+	X(vkBeginCommandBuffer,                                               \
+	  (VkCommandBuffer commandBuffer,                                     \
+	   const VkCommandBufferBeginInfo *pBeginInfo),                       \
+	  (commandBuffer, pBeginInfo))                                        \
+	X(vkEndCommandBuffer, (VkCommandBuffer commandBuffer),                \
+	  (commandBuffer))                                                    \
+	X(vkResetCommandPool,                                                 \
+	  (VkDevice device, VkCommandPool commandPool,                        \
+	   VkCommandPoolResetFlags flags),                                    \
+	  (device, commandPool, flags))                                       \
+	X(vkResetCommandBuffer,                                               \
+	  (VkCommandBuffer commandBuffer, VkCommandBufferResetFlags flags),   \
+	  (commandBuffer, flags))                                             \
+	X(vkGetFenceStatus, (VkDevice device, VkFence fence),                 \
+	  (device, fence))                                                    \
+	X(vkWaitForFences,                                                    \
+	  (VkDevice device, uint32_t fenceCount, const VkFence *pFences,      \
+	   VkBool32 waitAll, uint64_t timeout),                               \
+	  (device, fenceCount, pFences, waitAll, timeout))                    \
+	X(vkWaitSemaphores,                                                   \
+	  (VkDevice device, const VkSemaphoreWaitInfo *pWaitInfo,             \
+	   uint64_t timeout),                                                 \
+	  (device, pWaitInfo, timeout))                                       \
+	X(vkGetSemaphoreCounterValue,                                         \
+	  (VkDevice device, VkSemaphore semaphore, uint64_t *pValue),         \
+	  (device, semaphore, pValue))
+
+/**
+ * Device-level functions on rendering hot path returning nothing
+ *
+ * Each entry is X(name, parameters, arguments).
+ */
+#define VKDISPATCH_VOID_FUNCTIONS(X)                                          \
+	X(vkCmdBeginRenderPass,                                               \
+	  (VkCommandBuffer commandBuffer,                                     \
+	   const VkRenderPassBeginInfo *pRenderPassBegin,                     \
+	   VkSubpassContents contents),                                       \
+	  (commandBuffer, pRenderPassBegin, contents))                        \
+	X(vkCmdEndRenderPass, (VkCommandBuffer commandBuffer),                \
+	  (commandBuffer))                                                    \
+	X(vkCmdBeginRendering,                                                \
+	  (VkCommandBuffer commandBuffer,                                     \
+	   const VkRenderingInfo *pRenderingInfo),                            \
+	  (commandBuffer, pRenderingInfo))                                    \
+	X(vkCmdEndRendering, (VkCommandBuffer commandBuffer),                 \
+	  (commandBuffer))                                                    \
+	X(vkCmdCopyBuffer,                                                    \
+	  (VkCommandBuffer commandBuffer, VkBuffer srcBuffer,                 \
+	   VkBuffer dstBuffer, uint32_t regionCount,                          \
+	   const VkBufferCopy *pRegions),                                     \
+	  (commandBuffer, srcBuffer, dstBuffer, regionCount, pRegions))       \
+	X(vkCmdExecuteCommands,                                               \
+	  (VkCommandBuffer commandBuffer, uint32_t commandBufferCount,        \
+	   const VkCommandBuffer *pCommandBuffers),                           \
+	  (commandBuffer, commandBufferCount, pCommandBuffers))               \
+	X(vkCmdPipelineBarrier,                                               \
+	  (VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStageMask,  \
+	   VkPipelineStageFlags dstStageMask,                                 \
+	   VkDependencyFlags dependencyFlags, uint32_t memoryBarrierCount,    \
+	   const VkMemoryBarrier *pMemoryBarriers,                            \
+	   uint32_t bufferMemoryBarrierCount,                                 \
+	   const VkBufferMemoryBarrier *pBufferMemoryBarriers,                \
+	   uint32_t imageMemoryBarrierCount,                                  \
+	   const VkImageMemoryBarrier *pImageMemoryBarriers),                 \
+	  (commandBuffer, srcStageMask, dstStageMask, dependencyFlags,        \
+	   memoryBarrierCount, pMemoryBarriers, bufferMemoryBarrierCount,     \
+	   pBufferMemoryBarriers, imageMemoryBarrierCount,                    \
+	   pImageMemoryBarriers))
+
+/** Declares dispatch table entry of function */
+#define VKDISPATCH_ENTRY(name, params, args) PFN_##name name;
+
+/** Calls made through dispatch table entry, from any thread */
+struct vkdispatch_calls {
+	/** Number of calls */
+	atomic_uint_fast64_t count;
+	/** Total time spent in calls, in nanoseconds */
+	atomic_uint_fast64_t ns;
+};
+
+/** Declares call accounting of dispatch table entry */
+#define VKDISPATCH_CALLS(name, params, args) struct vkdispatch_calls name;
+
+/**
+ * Device-level functions loaded from driver, bypassing loader trampolines
+ *
+ * Functions not supported by device are NULL.
+ */
+struct vkdispatch {
+	VKDISPATCH_RESULT_FUNCTIONS(VKDISPATCH_ENTRY)
+	VKDISPATCH_VOID_FUNCTIONS(VKDISPATCH_ENTRY)
+#ifdef VKDISPATCH_ACCOUNTING
+	/** Functions loaded from driver, called by accounting wrappers */
+	struct {
+		VKDISPATCH_RESULT_FUNCTIONS(VKDISPATCH_ENTRY)
+		VKDISPATCH_VOID_FUNCTIONS(VKDISPATCH_ENTRY)
+	} driver;
+	/** Calls made through each entry since the last reset */
+	struct {
+		VKDISPATCH_RESULT_FUNCTIONS(VKDISPATCH_CALLS)
+		VKDISPATCH_VOID_FUNCTIONS(VKDISPATCH_CALLS)
+	} calls;
+#endif
+};
+
+#ifdef __cplusplus
+/* *INDENT-OFF* */
+extern "C" {
+/* *INDENT-ON* */
+#endif
+
+/**
+ * Loads dispatch table of device
+ *
+ * With VKDISPATCH_ACCOUNTING defined, entries are wrappers counting and
+ * timing calls of the last device whose table is loaded.
+ * @param vkd Specifies dispatch table to load
+ * @param dev Specifies device to load functions of
+ */
+void vkdispatch_init(struct vkdispatch *vkd, VkDevice dev);
+
+/**
+ * Resets call accounting of dispatch table
+ * @param vkd Specifies dispatch table to reset accounting of
+ */
+void vkdispatch_reset_calls(struct vkdispatch *vkd);
+
+#ifdef __cplusplus
+/* *INDENT-OFF* */
+}
+/* *INDENT-ON* */
+#endif
+#endif
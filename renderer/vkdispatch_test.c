@@ -0,0 +1,91 @@
+/**
+ * @file
+ * Test suite for vkdispatch
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdint.h>
+#include <string.h>
+
+#include <cgreen/cgreen.h>
+#include <cgreen/mocks.h>
+
+#include <vulkan/vulkan_core.h>
+#include "vkdispatch.h"
+
+/**
+ * Driver implementation of vkQueueSubmit returned by vkGetDeviceProcAddr
+ * @param queue Specifies queue to submit to
+ * @param submitCount Specifies number of elements in @a pSubmits
+ * @param pSubmits Specifies submissions
+ * @param fence Specifies fence to signal
+ * @returns result passed to expectation
+ */
+static VKAPI_ATTR VkResult VKAPI_CALL
+driver_queue_submit(VkQueue queue, uint32_t submitCount,
+		    const VkSubmitInfo *pSubmits, VkFence fence)
+{
+	return (VkResult)mock(queue, submitCount, pSubmits, fence);
+}
+
+VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL vkGetDeviceProcAddr(VkDevice device,
+							     const char *pName)
+{
+	(void)(device);
+	if (strcmp(pName, "vkQueueSubmit") == 0)
+		return (PFN_vkVoidFunction)driver_queue_submit;
+	return NULL;
+}
+
+Ensure(init_loads_functions_supported_by_device)
+{
+	struct vkdispatch vkd;
+	vkdispatch_init(&vkd, VK_NULL_HANDLE);
+	assert_that(vkd.vkQueueSubmit, is_non_null);
+	assert_that(vkd.vkCmdBeginRendering, is_null);
+}
+
+Ensure(table_calls_driver_function)
+{
+	struct vkdispatch vkd;
+	vkdispatch_init(&vkd, VK_NULL_HANDLE);
+	expect(driver_queue_submit, will_return(VK_ERROR_DEVICE_LOST),
+	       when(submitCount, is_equal_to(3)));
+	VkResult result = vkd.vkQueueSubmit(VK_NULL_HANDLE, 3, NULL,
+					    VK_NULL_HANDLE);
+	assert_that(result, is_equal_to(VK_ERROR_DEVICE_LOST));
+}
+
+#ifdef VKDISPATCH_ACCOUNTING
+Ensure(table_counts_calls_until_reset)
+{
+	struct vkdispatch vkd;
+	vkdispatch_init(&vkd, VK_NULL_HANDLE);
+	always_expect(driver_queue_submit, will_return(VK_SUCCESS));
+	vkd.vkQueueSubmit(VK_NULL_HANDLE, 1, NULL, VK_NULL_HANDLE);
+	vkd.vkQueueSubmit(VK_NULL_HANDLE, 1, NULL, VK_NULL_HANDLE);
+	assert_that(vkd.calls.vkQueueSubmit.count, is_equal_to(2));
+	assert_that(vkd.calls.vkQueuePresentKHR.count, is_equal_to(0));
+	vkdispatch_reset_calls(&vkd);
+	assert_that(vkd.calls.vkQueueSubmit.count, is_equal_to(0));
+}
+#endif
+
+int main(int argc, char **argv)
+{
+	(void)(argc);
+	(void)(argv);
+	TestSuite *suite = create_named_test_suite("VKDispatch");
+	add_test(suite, init_loads_functions_supported_by_device);
+	add_test(suite, table_calls_driver_function);
+#ifdef VKDISPATCH_ACCOUNTING
+	add_test(suite, table_counts_calls_until_reset);
+#endif
+	TestReporter *reporter = create_text_reporter();
+	int exit_code = run_test_suite(suite, reporter);
+	destroy_reporter(reporter);
+	destroy_test_suite(suite);
+	return exit_code;
+}
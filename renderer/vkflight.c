@@ -0,0 +1,86 @@
+/**
+ * @file
+ * Vulkan frame in flight implementation
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "vkflight.h"
+#include <vulkan/vulkan_core.h>
+
+VkResult vkflight_init(struct vkflight *flight, VkDevice dev,
+		       const VkAllocationCallbacks *host)
+{
+	VkResult result;
+	const VkSemaphoreCreateInfo sem_info = {
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+		.pNext = NULL,
+		.flags = 0,
+	};
+	/* Fence is created signaled, so the first wait on slot returns */
+	const VkFenceCreateInfo fence_info = {
+		.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+		.pNext = NULL,
+		.flags = VK_FENCE_CREATE_SIGNALED_BIT,
+	};
+	flight->frame = 0;
+	flight->pool = VK_NULL_HANDLE;
+	flight->cmds = VK_NULL_HANDLE;
+	flight->host = host;
+	result = vkCreateSemaphore(dev, &sem_info, host, &flight->acquire_sem);
+	if (result != VK_SUCCESS)
+		return result;
+	result = vkCreateSemaphore(dev, &sem_info, host, &flight->render_sem);
+	if (result != VK_SUCCESS)
+		return result;
+	return vkCreateFence(dev, &fence_info, host, &flight->fence);
+}
+
+VkResult vkflight_init_commands(struct vkflight *flight, VkDevice dev,
+				uint32_t family)
+{
+	const VkCommandPoolCreateInfo pool_info = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+		.pNext = NULL,
+		.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+		.queueFamilyIndex = family,
+	};
+	VkResult result = vkCreateCommandPool(dev, &pool_info, flight->host,
+					      &flight->pool);
+	if (result != VK_SUCCESS)
+		return result;
+	const VkCommandBufferAllocateInfo alloc_info = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+		.pNext = NULL,
+		.commandPool = flight->pool,
+		.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+		.commandBufferCount = 1,
+	};
+	return vkAllocateCommandBuffers(dev, &alloc_info, &flight->cmds);
+}
+
+VkResult vkflight_reset_commands(const struct vkflight *flight, VkDevice dev,
+				 const struct vkdispatch *vkd)
+{
+	return vkd->vkResetCommandPool(dev, flight->pool, 0);
+}
+
+VkResult vkflight_wait(const struct vkflight *flight, VkDevice dev,
+		       const struct vkdispatch *vkd)
+{
+	return vkd->vkWaitForFences(dev, 1, &flight->fence, VK_TRUE,
+				    UINT64_MAX);
+}
+
+void vkflight_destroy(const struct vkflight *flight, VkDevice dev)
+{
+	/* Command buffers are freed along with their pool */
+	vkDestroyCommandPool(dev, flight->pool, flight->host);
+	vkDestroyFence(dev, flight->fence, flight->host);
+	vkDestroySemaphore(dev, flight->render_sem, flight->host);
+	vkDestroySemaphore(dev, flight->acquire_sem, flight->host);
+}
@@ -0,0 +1,87 @@
+#ifndef RENDERER_VKFLIGHT_H
+#define RENDERER_VKFLIGHT_H
+
+#include <stdint.h>
+
+#include <renderer/vkdispatch.h>
+#include <vulkan/vulkan_core.h>
+
+/** Frame in flight synchronization slot */
+struct vkflight {
+	/** Semaphore signaled when image is acquired from swapchain */
+	VkSemaphore acquire_sem;
+	/** Semaphore signaled when image is rendered */
+	VkSemaphore render_sem;
+	/** Fence signaled when commands submitted from this slot complete */
+	VkFence fence;
+	/** Number of the frame last submitted from this slot */
+	uint64_t frame;
+	/** Transient pool reset in bulk every time the slot is reused */
+	VkCommandPool pool;
+	/** Primary command buffer recorded anew for every frame */
+	VkCommandBuffer cmds;
+	/** Host memory allocator of driver, or NULL */
+	const VkAllocationCallbacks *host;
+};
+
+#ifdef __cplusplus
+/* *INDENT-OFF* */
+extern "C" {
+/* *INDENT-ON* */
+#endif
+
+/**
+ * Initializes frame in flight slot
+ * @param flight Specifies slot to initialize
+ * @param dev Specifies device to create synchronization objects on
+ * @param host Specifies host memory allocator of driver, or NULL
+ * @returns VK_SUCCESS on success, or VkResult error otherwise
+ */
+VkResult vkflight_init(struct vkflight *flight, VkDevice dev,
+		       const VkAllocationCallbacks *host);
+
+/**
+ * Creates transient command pool and buffer for per-frame recording
+ * @param flight Specifies slot to create command buffer for
+ * @param dev Specifies device the slot belongs to
+ * @param family Specifies queue family the command buffer is submitted to
+ * @returns VK_SUCCESS on success, or VkResult error otherwise
+ */
+VkResult vkflight_init_commands(struct vkflight *flight, VkDevice dev,
+				uint32_t family);
+
+/**
+ * Resets command buffer of slot, so it can be recorded for new frame
+ *
+ * Commands previously submitted from the slot must be complete.
+ * @param flight Specifies slot to reset command buffer of
+ * @param dev Specifies device the slot belongs to
+ * @param vkd Specifies dispatch table of @a dev
+ * @returns VK_SUCCESS on success, or VkResult error otherwise
+ */
+VkResult vkflight_reset_commands(const struct vkflight *flight, VkDevice dev,
+				 const struct vkdispatch *vkd);
+
+/**
+ * Waits until commands previously submitted from slot are complete
+ * @param flight Specifies slot to wait for
+ * @param dev Specifies device the slot belongs to
+ * @param vkd Specifies dispatch table of @a dev
+ * @returns VK_SUCCESS on success, or VkResult error otherwise
+ */
+VkResult vkflight_wait(const struct vkflight *flight, VkDevice dev,
+		       const struct vkdispatch *vkd);
+
+/**
+ * Destroys frame in flight slot
+ * @param flight Specifies slot to destroy
+ * @param dev Specifies device the slot belongs to
+ */
+void vkflight_destroy(const struct vkflight *flight, VkDevice dev);
+
+#ifdef __cplusplus
+/* *INDENT-OFF* */
+}
+/* *INDENT-ON* */
+#endif
+#endif
@@ -0,0 +1,220 @@
+/**
+ * @file
+ * Test suite for vkflight
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdint.h>
+
+#include <cgreen/cgreen.h>
+#include <cgreen/mocks.h>
+
+#include <vulkan/vulkan_core.h>
+#include "vkflight.h"
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateSemaphore(
+	VkDevice device, const VkSemaphoreCreateInfo *pCreateInfo,
+	const VkAllocationCallbacks *pAllocator, VkSemaphore *pSemaphore)
+{
+	return (VkResult)mock(device, pCreateInfo, pAllocator, pSemaphore);
+}
+
+VKAPI_ATTR void VKAPI_CALL
+vkDestroySemaphore(VkDevice device, VkSemaphore semaphore,
+		   const VkAllocationCallbacks *pAllocator)
+{
+	mock(device, semaphore, pAllocator);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkCreateFence(VkDevice device, const VkFenceCreateInfo *pCreateInfo,
+	      const VkAllocationCallbacks *pAllocator, VkFence *pFence)
+{
+	return (VkResult)mock(device, pCreateInfo, pAllocator, pFence);
+}
+
+VKAPI_ATTR void VKAPI_CALL
+vkDestroyFence(VkDevice device, VkFence fence,
+	       const VkAllocationCallbacks *pAllocator)
+{
+	mock(device, fence, pAllocator);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkWaitForFences(VkDevice device,
+					       uint32_t fenceCount,
+					       const VkFence *pFences,
+					       VkBool32 waitAll,
+					       uint64_t timeout)
+{
+	return (VkResult)mock(device, fenceCount, pFences, waitAll, timeout);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateCommandPool(
+	VkDevice device, const VkCommandPoolCreateInfo *pCreateInfo,
+	const VkAllocationCallbacks *pAllocator, VkCommandPool *pCommandPool)
+{
+	return (VkResult)mock(device, pCreateInfo, pAllocator, pCommandPool);
+}
+
+VKAPI_ATTR void VKAPI_CALL
+vkDestroyCommandPool(VkDevice device, VkCommandPool commandPool,
+		     const VkAllocationCallbacks *pAllocator)
+{
+	mock(device, commandPool, pAllocator);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkResetCommandPool(VkDevice device,
+						  VkCommandPool commandPool,
+						  VkCommandPoolResetFlags flags)
+{
+	return (VkResult)mock(device, commandPool, flags);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkAllocateCommandBuffers(
+	VkDevice device, const VkCommandBufferAllocateInfo *pAllocateInfo,
+	VkCommandBuffer *pCommandBuffers)
+{
+	return (VkResult)mock(device, pAllocateInfo, pCommandBuffers);
+}
+
+Ensure(init_returns_success_on_success)
+{
+	struct vkflight flight;
+	const VkAllocationCallbacks host = { 0 };
+	expect(vkCreateSemaphore, will_return(VK_SUCCESS),
+	       when(pAllocator, is_equal_to(&host)),
+	       when(pSemaphore, is_equal_to(&flight.acquire_sem)));
+	expect(vkCreateSemaphore, will_return(VK_SUCCESS),
+	       when(pAllocator, is_equal_to(&host)),
+	       when(pSemaphore, is_equal_to(&flight.render_sem)));
+	expect(vkCreateFence, will_return(VK_SUCCESS),
+	       when(pAllocator, is_equal_to(&host)),
+	       when(pFence, is_equal_to(&flight.fence)));
+	VkResult result = vkflight_init(&flight, VK_NULL_HANDLE, &host);
+	assert_that(result, is_equal_to(VK_SUCCESS));
+	assert_that(flight.host, is_equal_to(&host));
+}
+
+Ensure(init_returns_error_on_acquire_semaphore_fail)
+{
+	struct vkflight flight;
+	expect(vkCreateSemaphore, will_return(VK_ERROR_OUT_OF_HOST_MEMORY));
+	never_expect(vkCreateFence);
+	VkResult result = vkflight_init(&flight, VK_NULL_HANDLE, NULL);
+	assert_that(result, is_equal_to(VK_ERROR_OUT_OF_HOST_MEMORY));
+}
+
+Ensure(init_returns_error_on_render_semaphore_fail)
+{
+	struct vkflight flight;
+	expect(vkCreateSemaphore, will_return(VK_SUCCESS));
+	expect(vkCreateSemaphore, will_return(VK_ERROR_OUT_OF_HOST_MEMORY));
+	never_expect(vkCreateFence);
+	VkResult result = vkflight_init(&flight, VK_NULL_HANDLE, NULL);
+	assert_that(result, is_equal_to(VK_ERROR_OUT_OF_HOST_MEMORY));
+}
+
+Ensure(init_returns_error_on_fence_fail)
+{
+	struct vkflight flight;
+	expect(vkCreateSemaphore, will_return(VK_SUCCESS));
+	expect(vkCreateSemaphore, will_return(VK_SUCCESS));
+	expect(vkCreateFence, will_return(VK_ERROR_OUT_OF_DEVICE_MEMORY));
+	VkResult result = vkflight_init(&flight, VK_NULL_HANDLE, NULL);
+	assert_that(result, is_equal_to(VK_ERROR_OUT_OF_DEVICE_MEMORY));
+}
+
+Ensure(wait_waits_for_slot_fence)
+{
+	struct vkflight flight = {
+		.fence = (VkFence)1,
+	};
+	expect(vkWaitForFences, will_return(VK_SUCCESS),
+	       when(fenceCount, is_equal_to(1)),
+	       when(timeout, is_equal_to(UINT64_MAX)));
+	const struct vkdispatch vkd = {
+		.vkWaitForFences = vkWaitForFences,
+	};
+	VkResult result = vkflight_wait(&flight, VK_NULL_HANDLE, &vkd);
+	assert_that(result, is_equal_to(VK_SUCCESS));
+}
+
+Ensure(init_commands_allocates_buffer_from_slot_pool)
+{
+	const VkAllocationCallbacks host = { 0 };
+	struct vkflight flight = {
+		.host = &host,
+	};
+	expect(vkCreateCommandPool, will_return(VK_SUCCESS),
+	       when(pAllocator, is_equal_to(&host)),
+	       when(pCommandPool, is_equal_to(&flight.pool)));
+	expect(vkAllocateCommandBuffers, will_return(VK_SUCCESS),
+	       when(pCommandBuffers, is_equal_to(&flight.cmds)));
+	VkResult result = vkflight_init_commands(&flight, VK_NULL_HANDLE, 0);
+	assert_that(result, is_equal_to(VK_SUCCESS));
+}
+
+Ensure(init_commands_returns_error_on_pool_fail)
+{
+	struct vkflight flight = { 0 };
+	expect(vkCreateCommandPool, will_return(VK_ERROR_OUT_OF_HOST_MEMORY));
+	never_expect(vkAllocateCommandBuffers);
+	VkResult result = vkflight_init_commands(&flight, VK_NULL_HANDLE, 0);
+	assert_that(result, is_equal_to(VK_ERROR_OUT_OF_HOST_MEMORY));
+}
+
+Ensure(reset_commands_resets_slot_pool)
+{
+	struct vkflight flight = {
+		.pool = (VkCommandPool)1,
+	};
+	expect(vkResetCommandPool, will_return(VK_SUCCESS),
+	       when(commandPool, is_equal_to(flight.pool)));
+	const struct vkdispatch vkd = {
+		.vkResetCommandPool = vkResetCommandPool,
+	};
+	VkResult result = vkflight_reset_commands(&flight, VK_NULL_HANDLE,
+						  &vkd);
+	assert_that(result, is_equal_to(VK_SUCCESS));
+}
+
+Ensure(destroy_destroys_all_resources)
+{
+	struct vkflight flight = {
+		.acquire_sem = (VkSemaphore)1,
+		.render_sem = (VkSemaphore)2,
+		.fence = (VkFence)3,
+		.pool = (VkCommandPool)4,
+	};
+	expect(vkDestroyCommandPool,
+	       when(commandPool, is_equal_to(flight.pool)));
+	expect(vkDestroyFence, when(fence, is_equal_to(flight.fence)));
+	expect(vkDestroySemaphore,
+	       when(semaphore, is_equal_to(flight.render_sem)));
+	expect(vkDestroySemaphore,
+	       when(semaphore, is_equal_to(flight.acquire_sem)));
+	vkflight_destroy(&flight, VK_NULL_HANDLE);
+}
+
+int main(int argc, char **argv)
+{
+	(void)(argc);
+	(void)(argv);
+	TestSuite *vkf = create_named_test_suite("VKFlight");
+	add_test(vkf, init_returns_success_on_success);
+	add_test(vkf, init_returns_error_on_acquire_semaphore_fail);
+	add_test(vkf, init_returns_error_on_render_semaphore_fail);
+	add_test(vkf, init_returns_error_on_fence_fail);
+	add_test(vkf, init_commands_allocates_buffer_from_slot_pool);
+	add_test(vkf, init_commands_returns_error_on_pool_fail);
+	add_test(vkf, reset_commands_resets_slot_pool);
+	add_test(vkf, wait_waits_for_slot_fence);
+	add_test(vkf, destroy_destroys_all_resources);
+	TestReporter *reporter = create_text_reporter();
+	int exit_code = run_test_suite(vkf, reporter);
+	destroy_reporter(reporter);
+	destroy_test_suite(vkf);
+	return exit_code;
+}
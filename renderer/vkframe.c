@@ -7,54 +7,72 @@
 #endif
 
 #include <stddef.h>
+#include <stdint.h>
 
+#include "vkcmdpool.h"
 #include "vkframe.h"
 #include "vkrenderer.h"
 #include <vulkan/vulkan_core.h>
 
+/** Color aspect of the only mip level and layer of swapchain image */
+static const VkImageSubresourceRange vkframe_color_range = {
+	.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+	.baseMipLevel = 0,
+	.levelCount = 1,
+	.baseArrayLayer = 0,
+	.layerCount = 1,
+};
+
 /**
  * Initializes framebuffer on frame's image
+ *
+ * Dynamic rendering needs no framebuffer, and imageless framebuffer is
+ * shared by all frames of swapchain.
  * @param frame Specifies frame to initialize framebuffer for
- * @param rpass Specifies render pass the framebuffer will be compatible with
  * @param rdr Specifies renderer of this frame
+ * @param shared Specifies imageless framebuffer shared by swapchain frames
  * @returns VK_SUCCESS on success, or VkResult error otherwise
  */
 static VkResult vkframe_init_framebuffer(struct vkframe *frame,
-					 const VkRenderPass rpass,
-					 const VkDevice device)
+					 const struct vkrenderer *rdr,
+					 const VkFramebuffer shared)
 {
+	if (rdr->caps & VKRENDERER_CAP_DYNAMIC_RENDERING) {
+		frame->buffer = VK_NULL_HANDLE;
+		return VK_SUCCESS;
+	}
+	if (rdr->caps & VKRENDERER_CAP_IMAGELESS_FRAMEBUFFER) {
+		frame->buffer = shared;
+		return VK_SUCCESS;
+	}
 	const VkImageView attachments[] = { frame->view };
 	const VkFramebufferCreateInfo info = {
 		.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
 		.pNext = NULL,
 		.flags = 0,
-		.renderPass = rpass,
+		.renderPass = rdr->rpass,
 		.attachmentCount = ARRAY_SIZE(attachments),
 		.pAttachments = attachments,
 		.width = frame->size.width,
 		.height = frame->size.height,
 		.layers = 1,
 	};
-	return vkCreateFramebuffer(device, &info, NULL, &frame->buffer);
+	return vkCreateFramebuffer(rdr->device, &info, &rdr->host.callbacks,
+				   &frame->buffer);
 }
 
 /**
  * Initializes image view on frame's image
  * @param frame Specifies frame to initialize view for
  * @param format Specifies format of underlying image
+ * @param device Specifies device to create view on
+ * @param host Specifies host memory allocator of driver
  * @returns VK_SUCCESS on success, or VkResult error otherwise
  */
 static VkResult vkframe_init_view(struct vkframe *frame, const VkFormat format,
-				  const VkDevice device)
+				  const VkDevice device,
+				  const VkAllocationCallbacks *host)
 {
-	const VkImageSubresourceRange base_range = {
-		.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-		.baseMipLevel = 0,
-		.levelCount = 1,
-		.baseArrayLayer = 0,
-		.layerCount = 1,
-	};
-
 	const VkComponentMapping identity_mapping = {
 		.r = VK_COMPONENT_SWIZZLE_IDENTITY,
 		.g = VK_COMPONENT_SWIZZLE_IDENTITY,
@@ -70,92 +88,207 @@ static VkResult vkframe_init_view(struct vkframe *frame, const VkFormat format,
 		.viewType = VK_IMAGE_VIEW_TYPE_2D,
 		.format = format,
 		.components = identity_mapping,
-		.subresourceRange = base_range,
+		.subresourceRange = vkframe_color_range,
 	};
-	return vkCreateImageView(device, &info, NULL, &frame->view);
+	return vkCreateImageView(device, &info, host, &frame->view);
 }
 
 /**
- * Allocates primary command bufffer for frame
- * @param frame Specifies frame to allocate primary command buffer for
- * @param cmd_pool Specifies commandbuffer pool to allocate buffer from
- * @param device Specifies device to use
- * @returns VK_SUCCESS on success, or VkResult error otherwise
+ * Transitions layout of frame's image around dynamic rendering
+ *
+ * Attachment writes wait for acquire semaphore at color attachment output
+ * stage, and presentation waits for render semaphore signaled at the end.
+ * @param frame Specifies frame to transition image of
+ * @param vkd Specifies device functions to record with
+ * @param cmds Specifies command buffer to record barrier into
+ * @param old_layout Specifies current layout of image
+ * @param new_layout Specifies layout to transition image to
  */
-static VkResult vkframe_alloc_cmds(struct vkframe *frame,
-				   const VkCommandPool cmd_pool,
-				   const VkDevice device)
+static void vkframe_transition(const struct vkframe *frame,
+			       const struct vkdispatch *vkd,
+			       VkCommandBuffer cmds, VkImageLayout old_layout,
+			       VkImageLayout new_layout)
 {
-	const VkCommandBufferAllocateInfo info = {
-		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+	const int to_attachment =
+		new_layout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	const VkAccessFlags write = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	const VkImageMemoryBarrier barrier = {
+		.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
 		.pNext = NULL,
-		.commandPool = cmd_pool,
-		.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-		.commandBufferCount = 1,
+		.srcAccessMask = to_attachment ? 0 : write,
+		.dstAccessMask = to_attachment ? write : 0,
+		.oldLayout = old_layout,
+		.newLayout = new_layout,
+		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.image = frame->image,
+		.subresourceRange = vkframe_color_range,
 	};
-	return vkAllocateCommandBuffers(device, &info, &frame->cmds);
+	const VkPipelineStageFlags output =
+		VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	const VkPipelineStageFlags dst_stage =
+		to_attachment ? output : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+	vkd->vkCmdPipelineBarrier(cmds, output, dst_stage, 0, 0, NULL, 0, NULL,
+				  1, &barrier);
 }
 
 /**
- * Records commands to frame
+ * Records rendering to frame with dynamic rendering
  * @param frame Specifies the frame to record commands for
- * @param rpass Specifies the renderpass to record
- * @returns VK_SUCCESS on success, or error otherwise
+ * @param vkd Specifies device functions to record with
+ * @param cmds Specifies command buffer to record commands into
+ * @param clear Specifies color to clear image with
+ * @param secondaries Specifies secondary buffers continuing rendering
+ * @param nsecondaries Specifies number of elements in @a secondaries
  */
-static VkResult vkframe_record(const struct vkframe *frame,
-			       const VkRenderPass rpass)
+static void vkframe_record_dynamic(const struct vkframe *frame,
+				   const struct vkdispatch *vkd,
+				   VkCommandBuffer cmds,
+				   const VkClearValue *clear,
+				   const VkCommandBuffer *secondaries,
+				   uint32_t nsecondaries)
 {
-	const VkCommandBufferBeginInfo begin_info = {
-		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+	const VkRenderingAttachmentInfo color = {
+		.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
 		.pNext = NULL,
-		.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT,
-		.pInheritanceInfo = NULL,
-	};
-	VkResult result = vkBeginCommandBuffer(frame->cmds, &begin_info);
-	if (result != VK_SUCCESS)
-		return result;
-	const VkClearValue clear_colors[] = {
-		{ { { 1.0F, 1.0F, 1.0F, 1.0F } } }
+		.imageView = frame->view,
+		.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+		.resolveMode = VK_RESOLVE_MODE_NONE,
+		.resolveImageView = VK_NULL_HANDLE,
+		.resolveImageLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+		.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+		.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+		.clearValue = *clear,
 	};
-	const VkRect2D render_rect = {
-		.offset = { 0, 0 },
-		.extent = frame->size,
+	const VkRenderingFlags contents =
+		VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT;
+	const VkRenderingInfo info = {
+		.sType = VK_STRUCTURE_TYPE_RENDERING_INFO,
+		.pNext = NULL,
+		.flags = nsecondaries ? contents : 0,
+		.renderArea = { .offset = { 0, 0 }, .extent = frame->size },
+		.layerCount = 1,
+		.viewMask = 0,
+		.colorAttachmentCount = 1,
+		.pColorAttachments = &color,
+		.pDepthAttachment = NULL,
+		.pStencilAttachment = NULL,
 	};
+	const VkImageLayout attachment =
+		VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	vkframe_transition(frame, vkd, cmds, VK_IMAGE_LAYOUT_UNDEFINED,
+			   attachment);
+	vkd->vkCmdBeginRendering(cmds, &info);
+	if (nsecondaries > 0)
+		vkd->vkCmdExecuteCommands(cmds, nsecondaries, secondaries);
+	vkd->vkCmdEndRendering(cmds);
+	vkframe_transition(frame, vkd, cmds, attachment,
+			   VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+}
 
+/**
+ * Records render pass rendering to frame
+ * @param frame Specifies the frame to record commands for
+ * @param rdr Specifies renderer of the frame
+ * @param cmds Specifies command buffer to record commands into
+ * @param clear Specifies color to clear image with
+ * @param secondaries Specifies secondary buffers continuing render pass
+ * @param nsecondaries Specifies number of elements in @a secondaries
+ */
+static void vkframe_record_render_pass(const struct vkframe *frame,
+				       const struct vkrenderer *rdr,
+				       VkCommandBuffer cmds,
+				       const VkClearValue *clear,
+				       const VkCommandBuffer *secondaries,
+				       uint32_t nsecondaries)
+{
+	/* Imageless framebuffer gets its attachment when render pass begins */
+	const VkRenderPassAttachmentBeginInfo attachments = {
+		.sType = VK_STRUCTURE_TYPE_RENDER_PASS_ATTACHMENT_BEGIN_INFO,
+		.pNext = NULL,
+		.attachmentCount = 1,
+		.pAttachments = &frame->view,
+	};
+	const int imageless = rdr->caps & VKRENDERER_CAP_IMAGELESS_FRAMEBUFFER;
 	const VkRenderPassBeginInfo rbf = {
 		.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-		.pNext = NULL,
-		.renderPass = rpass,
+		.pNext = imageless ? &attachments : NULL,
+		.renderPass = rdr->rpass,
 		.framebuffer = frame->buffer,
-		.renderArea = render_rect,
-		.clearValueCount = ARRAY_SIZE(clear_colors),
-		.pClearValues = clear_colors,
+		.renderArea = { .offset = { 0, 0 }, .extent = frame->size },
+		.clearValueCount = 1,
+		.pClearValues = clear,
+	};
+	const VkSubpassContents contents =
+		nsecondaries ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS :
+			       VK_SUBPASS_CONTENTS_INLINE;
+	const struct vkdispatch *vkd = &rdr->vkd;
+	vkd->vkCmdBeginRenderPass(cmds, &rbf, contents);
+	if (nsecondaries > 0)
+		vkd->vkCmdExecuteCommands(cmds, nsecondaries, secondaries);
+	vkd->vkCmdEndRenderPass(cmds);
+}
+
+VkResult vkframe_record(const struct vkframe *frame,
+			const struct vkrenderer *rdr, VkCommandBuffer cmds,
+			VkCommandBufferUsageFlags usage,
+			const VkCommandBuffer *secondaries,
+			uint32_t nsecondaries)
+{
+	const VkCommandBufferBeginInfo begin_info = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.pNext = NULL,
+		.flags = usage,
+		.pInheritanceInfo = NULL,
 	};
-	vkCmdBeginRenderPass(frame->cmds, &rbf, VK_SUBPASS_CONTENTS_INLINE);
-	vkCmdEndRenderPass(frame->cmds);
-	return vkEndCommandBuffer(frame->cmds);
+	const struct vkdispatch *vkd = &rdr->vkd;
+	VkResult result = vkd->vkBeginCommandBuffer(cmds, &begin_info);
+	if (result != VK_SUCCESS)
+		return result;
+	const VkClearValue clear = { { { 1.0F, 1.0F, 1.0F, 1.0F } } };
+	if (rdr->caps & VKRENDERER_CAP_DYNAMIC_RENDERING) {
+		vkframe_record_dynamic(frame, vkd, cmds, &clear, secondaries,
+				       nsecondaries);
+	} else {
+		vkframe_record_render_pass(frame, rdr, cmds, &clear,
+					   secondaries, nsecondaries);
+	}
+	return vkd->vkEndCommandBuffer(cmds);
 }
 
-VkResult vkframe_init(struct vkframe *frame, const VkRenderPass rpass,
-		      const struct vkrenderer *rdr, const VkImage image)
+VkResult vkframe_init(struct vkframe *frame, const VkFramebuffer shared,
+		      struct vkrenderer *rdr, const VkImage image)
 {
 	frame->image = image;
+	frame->cmds = VK_NULL_HANDLE;
 	frame->size = rdr->srf_caps.currentExtent;
 	const VkFormat format = rdr->srf_format.format;
 	const VkDevice dev = rdr->device;
 	VkResult err;
-	if ((err = vkframe_init_view(frame, format, dev)) != VK_SUCCESS)
+	err = vkframe_init_view(frame, format, dev, &rdr->host.callbacks);
+	if (err != VK_SUCCESS)
 		return err;
-	if ((err = vkframe_init_framebuffer(frame, rpass, dev)) != VK_SUCCESS)
+	if ((err = vkframe_init_framebuffer(frame, rdr, shared)) != VK_SUCCESS)
 		return err;
-	if ((err = vkframe_alloc_cmds(frame, rdr->cmd_pool, dev)) != VK_SUCCESS)
+	/* Per-frame commands are recorded into frame in flight instead */
+	if (rdr->record_mode != VKRENDERER_RECORD_ONCE)
+		return VK_SUCCESS;
+	err = vkcmdpool_acquire(&rdr->cmd_pool, dev, &rdr->vkd, &frame->cmds);
+	if (err != VK_SUCCESS)
 		return err;
-	return vkframe_record(frame, rpass);
+	/* The buffer may still be pending when its image is acquired again */
+	const VkCommandBufferUsageFlags usage =
+		VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+	return vkframe_record(frame, rdr, frame->cmds, usage, NULL, 0);
 }
 
-void vkframe_destroy(const struct vkframe *frame, const VkDevice device)
+void vkframe_destroy(const struct vkframe *frame, struct vkrenderer *rdr)
 {
-	vkDestroyFramebuffer(device, frame->buffer, NULL);
-	vkDestroyImageView(device, frame->view, NULL);
-	/* TODO: Free command buffer */
+	/* Shared imageless framebuffer is destroyed with its swapchain */
+	if (!(rdr->caps & VKRENDERER_CAP_IMAGELESS_FRAMEBUFFER))
+		vkDestroyFramebuffer(rdr->device, frame->buffer,
+				     &rdr->host.callbacks);
+	vkDestroyImageView(rdr->device, frame->view, &rdr->host.callbacks);
+	if (frame->cmds != VK_NULL_HANDLE)
+		vkcmdpool_release(&rdr->cmd_pool, rdr->device, frame->cmds);
 }
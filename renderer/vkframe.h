@@ -1,13 +1,15 @@
 #ifndef RENDERER_VKFRAME_H
 #define RENDERER_VKFRAME_H
 
+#include <stdint.h>
+
 #include <vulkan/vulkan_core.h>
 
 struct vkrenderer;
 
 /** Presentable frame in swapchain */
 struct vkframe {
-	/** Attached buffer*/
+	/** Attached buffer, or VK_NULL_HANDLE with dynamic rendering */
 	VkFramebuffer buffer;
 	/** View to image in swapchain */
 	VkImageView view;
@@ -15,7 +17,7 @@ struct vkframe {
 	VkImage image;
 	/** Frame dimensions */
 	VkExtent2D size;
-	/** Primary command buffer */
+	/** Primary command buffer recorded once, or VK_NULL_HANDLE */
 	VkCommandBuffer cmds;
 };
 #ifdef __cplusplus
@@ -26,21 +28,45 @@ extern "C" {
 
 /**
  * Initializes swapchain frame
+ *
+ * In VKRENDERER_RECORD_ONCE mode the frame's command buffer is recorded here.
  * @param frame Specifies frame to initialize
- * @param rpass Specifies render pass the frame will be compatible with
+ * @param shared Specifies imageless framebuffer shared by swapchain frames,
+ *               used only if renderer has VKRENDERER_CAP_IMAGELESS_FRAMEBUFFER
  * @param rdr Specifies renderer this frame belongs to
  * @param image Specifies swapchain image to init frame on
  * @returns VK_SUCCESS on success, or VkResult error otherwise
  */
-VkResult vkframe_init(struct vkframe *frame, const VkRenderPass rpass,
-		      const struct vkrenderer *rdr, const VkImage image);
+VkResult vkframe_init(struct vkframe *frame, const VkFramebuffer shared,
+		      struct vkrenderer *rdr, const VkImage image);
+
+/**
+ * Records commands rendering frame into command buffer
+ *
+ * Frame is rendered with dynamic rendering if renderer supports it, and
+ * with renderer's render pass otherwise. Rendering contents are recorded
+ * inline when @a nsecondaries is zero, and are executed from secondary
+ * command buffers otherwise.
+ * @param frame Specifies the frame to record commands for
+ * @param rdr Specifies renderer of the frame
+ * @param cmds Specifies command buffer to record commands into
+ * @param usage Specifies how command buffer will be submitted
+ * @param secondaries Specifies secondary buffers continuing rendering
+ * @param nsecondaries Specifies number of elements in @a secondaries
+ * @returns VK_SUCCESS on success, or VkResult error otherwise
+ */
+VkResult vkframe_record(const struct vkframe *frame,
+			const struct vkrenderer *rdr, VkCommandBuffer cmds,
+			VkCommandBufferUsageFlags usage,
+			const VkCommandBuffer *secondaries,
+			uint32_t nsecondaries);
 
 /**
- * Destroys frame resources
+ * Destroys frame resources, command buffer is released for reuse
  * @param frame Specifies frame to destroy
- * @param device Specifies device instance this frame belongs to
+ * @param rdr Specifies renderer this frame belongs to
  */
-void vkframe_destroy(const struct vkframe *frame, const VkDevice device);
+void vkframe_destroy(const struct vkframe *frame, struct vkrenderer *rdr);
 
 #ifdef __cplusplus
 /* *INDENT-OFF* */
@@ -41,11 +41,16 @@ vkDestroyFramebuffer(VkDevice device, VkFramebuffer framebuffer,
 	mock(device, framebuffer, pAllocator);
 }
 
-VKAPI_ATTR VkResult VKAPI_CALL vkAllocateCommandBuffers(
-	VkDevice device, const VkCommandBufferAllocateInfo *pAllocateInfo,
-	VkCommandBuffer *pCommandBuffers)
+VkResult vkcmdpool_acquire(struct vkcmdpool *cp, VkDevice dev,
+			   const struct vkdispatch *vkd, VkCommandBuffer *cmds)
 {
-	return (VkResult)mock(device, pAllocateInfo, pCommandBuffers);
+	return (VkResult)mock(cp, dev, vkd, cmds);
+}
+
+void vkcmdpool_release(struct vkcmdpool *cp, VkDevice dev,
+		       VkCommandBuffer cmds)
+{
+	mock(cp, dev, cmds);
 }
 
 VKAPI_ATTR VkResult VKAPI_CALL
@@ -63,25 +68,75 @@ vkCmdBeginRenderPass(VkCommandBuffer commandBuffer,
 	mock(commandBuffer, pRenderPassBegin, contents);
 }
 
+VKAPI_ATTR void VKAPI_CALL
+vkCmdExecuteCommands(VkCommandBuffer commandBuffer, uint32_t commandBufferCount,
+		     const VkCommandBuffer *pCommandBuffers)
+{
+	mock(commandBuffer, commandBufferCount, pCommandBuffers);
+}
+
 VKAPI_ATTR void VKAPI_CALL vkCmdEndRenderPass(VkCommandBuffer commandBuffer)
 {
 	mock(commandBuffer);
 }
 
+VKAPI_ATTR void VKAPI_CALL vkCmdPipelineBarrier(
+	VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStageMask,
+	VkPipelineStageFlags dstStageMask, VkDependencyFlags dependencyFlags,
+	uint32_t memoryBarrierCount, const VkMemoryBarrier *pMemoryBarriers,
+	uint32_t bufferMemoryBarrierCount,
+	const VkBufferMemoryBarrier *pBufferMemoryBarriers,
+	uint32_t imageMemoryBarrierCount,
+	const VkImageMemoryBarrier *pImageMemoryBarriers)
+{
+	(void)(memoryBarrierCount);
+	(void)(pMemoryBarriers);
+	(void)(bufferMemoryBarrierCount);
+	(void)(pBufferMemoryBarriers);
+	(void)(imageMemoryBarrierCount);
+	mock(commandBuffer, srcStageMask, dstStageMask, dependencyFlags,
+	     pImageMemoryBarriers);
+}
+
+VKAPI_ATTR void VKAPI_CALL
+vkCmdBeginRendering(VkCommandBuffer commandBuffer,
+		    const VkRenderingInfo *pRenderingInfo)
+{
+	mock(commandBuffer, pRenderingInfo);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdEndRendering(VkCommandBuffer commandBuffer)
+{
+	mock(commandBuffer);
+}
+
 VKAPI_ATTR VkResult VKAPI_CALL vkEndCommandBuffer(VkCommandBuffer commandBuffer)
 {
 	return (VkResult)mock(commandBuffer);
 }
 
+/** Dispatch table calling mocked functions */
+static const struct vkdispatch mocked_dispatch = {
+	.vkBeginCommandBuffer = vkBeginCommandBuffer,
+	.vkEndCommandBuffer = vkEndCommandBuffer,
+	.vkCmdBeginRenderPass = vkCmdBeginRenderPass,
+	.vkCmdEndRenderPass = vkCmdEndRenderPass,
+	.vkCmdBeginRendering = vkCmdBeginRendering,
+	.vkCmdEndRendering = vkCmdEndRendering,
+	.vkCmdExecuteCommands = vkCmdExecuteCommands,
+	.vkCmdPipelineBarrier = vkCmdPipelineBarrier,
+};
+
 Ensure(vkframe_init_returns_error_on_framebuffer_fail)
 {
 	struct vkframe frame;
 	struct vkrenderer rdr = { 0 };
+	rdr.vkd = mocked_dispatch;
 	VkImage image = VK_NULL_HANDLE;
-	VkRenderPass rpass = VK_NULL_HANDLE;
+	VkFramebuffer shared = VK_NULL_HANDLE;
 	expect(vkCreateImageView, will_return(VK_SUCCESS));
 	expect(vkCreateFramebuffer, will_return(VK_NOT_READY));
-	int error = vkframe_init(&frame, rpass, &rdr, image);
+	int error = vkframe_init(&frame, shared, &rdr, image);
 	assert_that(error, is_equal_to(VK_NOT_READY));
 }
 
@@ -89,10 +144,11 @@ Ensure(vkframe_init_returns_error_on_getting_view_fail)
 {
 	struct vkframe frame;
 	struct vkrenderer rdr = { 0 };
+	rdr.vkd = mocked_dispatch;
 	VkImage image = VK_NULL_HANDLE;
-	VkRenderPass rpass = VK_NULL_HANDLE;
+	VkFramebuffer shared = VK_NULL_HANDLE;
 	expect(vkCreateImageView, will_return(VK_NOT_READY));
-	int error = vkframe_init(&frame, rpass, &rdr, image);
+	int error = vkframe_init(&frame, shared, &rdr, image);
 	assert_that(error, is_equal_to(VK_NOT_READY));
 }
 
@@ -100,12 +156,13 @@ Ensure(vkframe_init_returns_error_on_command_buffer_fail)
 {
 	struct vkframe frame;
 	struct vkrenderer rdr = { 0 };
+	rdr.vkd = mocked_dispatch;
 	VkImage image = VK_NULL_HANDLE;
-	VkRenderPass rpass = VK_NULL_HANDLE;
+	VkFramebuffer shared = VK_NULL_HANDLE;
 	expect(vkCreateImageView, will_return(VK_SUCCESS));
 	expect(vkCreateFramebuffer, will_return(VK_SUCCESS));
-	expect(vkAllocateCommandBuffers, will_return(VK_NOT_READY));
-	int error = vkframe_init(&frame, rpass, &rdr, image);
+	expect(vkcmdpool_acquire, will_return(VK_NOT_READY));
+	int error = vkframe_init(&frame, shared, &rdr, image);
 	assert_that(error, is_equal_to(VK_NOT_READY));
 }
 
@@ -113,16 +170,17 @@ Ensure(vkframe_init_returns_vk_success_on_success)
 {
 	struct vkframe frame;
 	struct vkrenderer rdr = { 0 };
+	rdr.vkd = mocked_dispatch;
 	VkImage image = VK_NULL_HANDLE;
-	VkRenderPass rpass = VK_NULL_HANDLE;
+	VkFramebuffer shared = VK_NULL_HANDLE;
 	expect(vkCreateImageView, will_return(VK_SUCCESS));
 	expect(vkCreateFramebuffer, will_return(VK_SUCCESS));
-	expect(vkAllocateCommandBuffers, will_return(VK_SUCCESS));
+	expect(vkcmdpool_acquire, will_return(VK_SUCCESS));
 	expect(vkBeginCommandBuffer, will_return(VK_SUCCESS));
 	expect(vkCmdBeginRenderPass, will_return(VK_SUCCESS));
 	expect(vkCmdEndRenderPass, will_return(VK_SUCCESS));
 	expect(vkEndCommandBuffer, will_return(VK_SUCCESS));
-	int error = vkframe_init(&frame, rpass, &rdr, image);
+	int error = vkframe_init(&frame, shared, &rdr, image);
 	assert_that(error, is_equal_to(VK_SUCCESS));
 }
 
@@ -130,16 +188,17 @@ Ensure(vkframe_init_returns_error_on_end_cmd_buffer)
 {
 	struct vkframe frame;
 	struct vkrenderer rdr = { 0 };
+	rdr.vkd = mocked_dispatch;
 	VkImage image = VK_NULL_HANDLE;
-	VkRenderPass rpass = VK_NULL_HANDLE;
+	VkFramebuffer shared = VK_NULL_HANDLE;
 	expect(vkCreateImageView, will_return(VK_SUCCESS));
 	expect(vkCreateFramebuffer, will_return(VK_SUCCESS));
-	expect(vkAllocateCommandBuffers, will_return(VK_SUCCESS));
+	expect(vkcmdpool_acquire, will_return(VK_SUCCESS));
 	expect(vkBeginCommandBuffer, will_return(VK_SUCCESS));
 	expect(vkCmdBeginRenderPass, will_return(VK_SUCCESS));
 	expect(vkCmdEndRenderPass, will_return(VK_SUCCESS));
 	expect(vkEndCommandBuffer, will_return(VK_NOT_READY));
-	int error = vkframe_init(&frame, rpass, &rdr, image);
+	int error = vkframe_init(&frame, shared, &rdr, image);
 	assert_that(error, is_equal_to(VK_NOT_READY));
 }
 
@@ -147,23 +206,129 @@ Ensure(vkframe_init_returns_error_on_begin_cmd_buffer)
 {
 	struct vkframe frame;
 	struct vkrenderer rdr = { 0 };
+	rdr.vkd = mocked_dispatch;
 	VkImage image = VK_NULL_HANDLE;
-	VkRenderPass rpass = VK_NULL_HANDLE;
+	VkFramebuffer shared = VK_NULL_HANDLE;
 	expect(vkCreateImageView, will_return(VK_SUCCESS));
 	expect(vkCreateFramebuffer, will_return(VK_SUCCESS));
-	expect(vkAllocateCommandBuffers, will_return(VK_SUCCESS));
+	expect(vkcmdpool_acquire, will_return(VK_SUCCESS));
 	expect(vkBeginCommandBuffer, will_return(VK_NOT_READY));
-	int error = vkframe_init(&frame, rpass, &rdr, image);
+	int error = vkframe_init(&frame, shared, &rdr, image);
 	assert_that(error, is_equal_to(VK_NOT_READY));
 }
 
-Ensure(vkframe_destroy_destroys_all_resources)
+Ensure(vkframe_init_skips_commands_recorded_per_frame)
+{
+	struct vkframe frame;
+	struct vkrenderer rdr = { 0 };
+	rdr.vkd = mocked_dispatch;
+	rdr.record_mode = VKRENDERER_RECORD_PER_FRAME;
+	expect(vkCreateImageView, will_return(VK_SUCCESS));
+	expect(vkCreateFramebuffer, will_return(VK_SUCCESS));
+	never_expect(vkcmdpool_acquire);
+	never_expect(vkBeginCommandBuffer);
+	int error = vkframe_init(&frame, VK_NULL_HANDLE, &rdr, VK_NULL_HANDLE);
+	assert_that(error, is_equal_to(VK_SUCCESS));
+	assert_that(frame.cmds, is_equal_to(VK_NULL_HANDLE));
+}
+
+Ensure(vkframe_record_executes_secondary_buffers)
+{
+	struct vkframe frame = { 0 };
+	struct vkrenderer rdr = { 0 };
+	rdr.vkd = mocked_dispatch;
+	const VkCommandBuffer secondaries[] = {
+		(VkCommandBuffer)1,
+		(VkCommandBuffer)2,
+	};
+	expect(vkBeginCommandBuffer, will_return(VK_SUCCESS));
+	const VkSubpassContents contents =
+		VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS;
+	expect(vkCmdBeginRenderPass, when(contents, is_equal_to(contents)));
+	expect(vkCmdExecuteCommands, when(commandBufferCount, is_equal_to(2)),
+	       when(pCommandBuffers, is_equal_to(secondaries)));
+	expect(vkCmdEndRenderPass);
+	expect(vkEndCommandBuffer, will_return(VK_SUCCESS));
+	VkResult result = vkframe_record(&frame, &rdr, VK_NULL_HANDLE, 0,
+					 secondaries, 2);
+	assert_that(result, is_equal_to(VK_SUCCESS));
+}
+
+Ensure(vkframe_record_renders_dynamically_without_render_pass)
 {
 	struct vkframe frame = { 0 };
-	VkDevice device = VK_NULL_HANDLE;
+	struct vkrenderer rdr = { .caps = VKRENDERER_CAP_DYNAMIC_RENDERING };
+	rdr.vkd = mocked_dispatch;
+	expect(vkBeginCommandBuffer, will_return(VK_SUCCESS));
+	expect(vkCmdPipelineBarrier);
+	expect(vkCmdBeginRendering);
+	expect(vkCmdEndRendering);
+	expect(vkCmdPipelineBarrier);
+	never_expect(vkCmdBeginRenderPass);
+	expect(vkEndCommandBuffer, will_return(VK_SUCCESS));
+	VkResult result = vkframe_record(&frame, &rdr, VK_NULL_HANDLE, 0,
+					 NULL, 0);
+	assert_that(result, is_equal_to(VK_SUCCESS));
+}
+
+Ensure(vkframe_init_skips_framebuffer_with_dynamic_rendering)
+{
+	struct vkframe frame;
+	struct vkrenderer rdr = { .caps = VKRENDERER_CAP_DYNAMIC_RENDERING };
+	rdr.vkd = mocked_dispatch;
+	rdr.record_mode = VKRENDERER_RECORD_PER_FRAME;
+	expect(vkCreateImageView, will_return(VK_SUCCESS));
+	never_expect(vkCreateFramebuffer);
+	int error = vkframe_init(&frame, VK_NULL_HANDLE, &rdr, VK_NULL_HANDLE);
+	assert_that(error, is_equal_to(VK_SUCCESS));
+	assert_that(frame.buffer, is_equal_to(VK_NULL_HANDLE));
+}
+
+Ensure(vkframe_init_uses_shared_imageless_framebuffer)
+{
+	struct vkframe frame;
+	struct vkrenderer rdr = {
+		.caps = VKRENDERER_CAP_IMAGELESS_FRAMEBUFFER,
+	};
+	rdr.vkd = mocked_dispatch;
+	rdr.record_mode = VKRENDERER_RECORD_PER_FRAME;
+	const VkFramebuffer shared = (VkFramebuffer)0xFB;
+	expect(vkCreateImageView, will_return(VK_SUCCESS));
+	never_expect(vkCreateFramebuffer);
+	int error = vkframe_init(&frame, shared, &rdr, VK_NULL_HANDLE);
+	assert_that(error, is_equal_to(VK_SUCCESS));
+	assert_that(frame.buffer, is_equal_to(shared));
+}
+
+Ensure(vkframe_destroy_keeps_shared_imageless_framebuffer)
+{
+	struct vkframe frame = { 0 };
+	struct vkrenderer rdr = {
+		.caps = VKRENDERER_CAP_IMAGELESS_FRAMEBUFFER,
+	};
+	never_expect(vkDestroyFramebuffer);
+	expect(vkDestroyImageView);
+	vkframe_destroy(&frame, &rdr);
+}
+
+Ensure(vkframe_destroy_skips_release_without_commands)
+{
+	struct vkframe frame = { 0 };
+	struct vkrenderer rdr = { 0 };
+	expect(vkDestroyFramebuffer);
+	expect(vkDestroyImageView);
+	never_expect(vkcmdpool_release);
+	vkframe_destroy(&frame, &rdr);
+}
+
+Ensure(vkframe_destroy_destroys_all_resources)
+{
+	struct vkframe frame = { .cmds = (VkCommandBuffer)1 };
+	struct vkrenderer rdr = { 0 };
 	expect(vkDestroyFramebuffer);
 	expect(vkDestroyImageView);
-	vkframe_destroy(&frame, device);
+	expect(vkcmdpool_release, when(cp, is_equal_to(&rdr.cmd_pool)));
+	vkframe_destroy(&frame, &rdr);
 }
 
 int main(int argc, char **argv)
@@ -177,6 +342,13 @@ int main(int argc, char **argv)
 	add_test(vkf, vkframe_init_returns_error_on_command_buffer_fail);
 	add_test(vkf, vkframe_init_returns_error_on_begin_cmd_buffer);
 	add_test(vkf, vkframe_init_returns_error_on_end_cmd_buffer);
+	add_test(vkf, vkframe_init_skips_commands_recorded_per_frame);
+	add_test(vkf, vkframe_init_skips_framebuffer_with_dynamic_rendering);
+	add_test(vkf, vkframe_init_uses_shared_imageless_framebuffer);
+	add_test(vkf, vkframe_record_executes_secondary_buffers);
+	add_test(vkf, vkframe_record_renders_dynamically_without_render_pass);
+	add_test(vkf, vkframe_destroy_keeps_shared_imageless_framebuffer);
+	add_test(vkf, vkframe_destroy_skips_release_without_commands);
 	add_test(vkf, vkframe_destroy_destroys_all_resources);
 	TestReporter *reporter = create_text_reporter();
 	int exit_code = run_test_suite(vkf, reporter);
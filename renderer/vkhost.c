@@ -0,0 +1,319 @@
+/**
+ * @file
+ * Host memory allocator of driver implementation
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "vkhost.h"
+#include <vulkan/vulkan_core.h>
+
+/** Size class of allocations coming from malloc */
+#define VKHOST_LARGE 0xFF
+
+/** Header stored in front of every allocation */
+struct vkhost_header {
+	/** Requested size */
+	size_t size;
+	/** Number of bytes from start of underlying memory to allocation */
+	uint32_t offset;
+	/** Allocation scope */
+	uint8_t scope;
+	/** Size class, or VKHOST_LARGE */
+	uint8_t cls;
+};
+
+/**
+ * Returns arena serving allocation scope
+ * @param scope Specifies allocation scope
+ * @returns kind of arena
+ */
+static enum vkhost_arena_kind vkhost_arena_of(uint32_t scope)
+{
+	switch (scope) {
+	case VK_SYSTEM_ALLOCATION_SCOPE_OBJECT:
+		return VKHOST_ARENA_OBJECT;
+	case VK_SYSTEM_ALLOCATION_SCOPE_CACHE:
+		return VKHOST_ARENA_CACHE;
+	case VK_SYSTEM_ALLOCATION_SCOPE_COMMAND:
+		return VKHOST_ARENA_COMMAND;
+	default:
+		return VKHOST_ARENA_GENERAL;
+	}
+}
+
+/**
+ * Returns header of allocation
+ * @param memory Specifies allocation
+ * @returns pointer to header
+ */
+static struct vkhost_header *vkhost_header(void *memory)
+{
+	return (struct vkhost_header *)((char *)memory - VKHOST_ALIGNMENT);
+}
+
+/**
+ * Returns the smallest size class fitting block
+ * @param size Specifies size of block, including header
+ * @returns size class, or VKHOST_LARGE if none fits
+ */
+static uint32_t vkhost_class(size_t size)
+{
+	for (uint32_t cls = 0; cls < VKHOST_NCLASSES; ++cls) {
+		if (size <= (size_t)VKHOST_MIN_CLASS << cls)
+			return cls;
+	}
+	return VKHOST_LARGE;
+}
+
+/**
+ * Carves chunk into free blocks of size class
+ * @param arena Specifies arena to add chunk to
+ * @param cls Specifies size class of blocks
+ * @returns zero on success, or non-zero otherwise
+ */
+static int vkhost_carve(struct vkhost_arena *arena, uint32_t cls)
+{
+	void *memory;
+	if (posix_memalign(&memory, VKHOST_ALIGNMENT, VKHOST_CHUNK_SIZE))
+		return -1;
+	struct vkhost_chunk *chunk = memory;
+	chunk->next = arena->chunks;
+	arena->chunks = chunk;
+	arena->nchunks++;
+	const size_t size = (size_t)VKHOST_MIN_CLASS << cls;
+	for (size_t offset = VKHOST_ALIGNMENT;
+	     offset + size <= VKHOST_CHUNK_SIZE; offset += size) {
+		void **block = (void **)((char *)memory + offset);
+		*block = arena->free[cls];
+		arena->free[cls] = block;
+	}
+	return 0;
+}
+
+/**
+ * Takes block of size class from arena
+ * @param arena Specifies arena to take block from
+ * @param cls Specifies size class of block
+ * @returns pointer to block, or NULL if out of memory
+ */
+static void *vkhost_take(struct vkhost_arena *arena, uint32_t cls)
+{
+	if (arena->free[cls] == NULL && vkhost_carve(arena, cls))
+		return NULL;
+	void **block = arena->free[cls];
+	arena->free[cls] = *block;
+	return block;
+}
+
+/**
+ * Allocates memory from malloc
+ * @param size Specifies size of allocation
+ * @param alignment Specifies alignment of allocation
+ * @param header Specifies pointer where header address must be stored
+ * @returns pointer to allocation, or NULL if out of memory
+ */
+static void *vkhost_malloc(size_t size, size_t alignment,
+			   struct vkhost_header **header)
+{
+	/* Padding of strictly aligned allocation leaves room for header */
+	const size_t pad =
+		(alignment > VKHOST_ALIGNMENT) ? alignment : VKHOST_ALIGNMENT;
+	void *base;
+	if (posix_memalign(&base, pad, pad + size))
+		return NULL;
+	void *memory = (char *)base + pad;
+	*header = vkhost_header(memory);
+	(*header)->offset = (uint32_t)pad;
+	(*header)->cls = VKHOST_LARGE;
+	return memory;
+}
+
+/**
+ * Allocates memory
+ * @param data Specifies allocator
+ * @param size Specifies size of allocation
+ * @param alignment Specifies alignment of allocation
+ * @param scope Specifies allocation scope
+ * @returns pointer to allocation, or NULL if out of memory
+ */
+static VKAPI_ATTR void *VKAPI_CALL
+vkhost_allocate(void *data, size_t size, size_t alignment,
+		VkSystemAllocationScope scope)
+{
+	struct vkhost *host = data;
+	struct vkhost_arena *arena = &host->arenas[vkhost_arena_of(scope)];
+	const uint32_t cls = (host->mode == VKHOST_MODE_ARENA &&
+			      alignment <= VKHOST_ALIGNMENT) ?
+				     vkhost_class(size + VKHOST_ALIGNMENT) :
+				     VKHOST_LARGE;
+	struct vkhost_header *header = NULL;
+	void *memory = NULL;
+	if (cls == VKHOST_LARGE) {
+		memory = vkhost_malloc(size, alignment, &header);
+		if (memory == NULL)
+			return NULL;
+	}
+	pthread_mutex_lock(&arena->lock);
+	if (cls != VKHOST_LARGE) {
+		void *block = vkhost_take(arena, cls);
+		if (block == NULL) {
+			pthread_mutex_unlock(&arena->lock);
+			return NULL;
+		}
+		memory = (char *)block + VKHOST_ALIGNMENT;
+		header = block;
+		header->offset = VKHOST_ALIGNMENT;
+		header->cls = (uint8_t)cls;
+	}
+	struct vkhost_stats *stats = &host->scopes[scope];
+	stats->nallocs++;
+	stats->bytes += size;
+	if (stats->bytes > stats->peak)
+		stats->peak = stats->bytes;
+	pthread_mutex_unlock(&arena->lock);
+	header->size = size;
+	header->scope = (uint8_t)scope;
+	return memory;
+}
+
+/**
+ * Frees memory
+ * @param data Specifies allocator
+ * @param memory Specifies allocation to free, or NULL
+ */
+static VKAPI_ATTR void VKAPI_CALL vkhost_free(void *data, void *memory)
+{
+	if (memory == NULL)
+		return;
+	struct vkhost *host = data;
+	const struct vkhost_header *header = vkhost_header(memory);
+	const uint32_t scope = header->scope;
+	const uint32_t cls = header->cls;
+	struct vkhost_arena *arena = &host->arenas[vkhost_arena_of(scope)];
+	pthread_mutex_lock(&arena->lock);
+	struct vkhost_stats *stats = &host->scopes[scope];
+	stats->nfrees++;
+	stats->bytes -= header->size;
+	if (cls != VKHOST_LARGE) {
+		void **block = (void **)((char *)memory - VKHOST_ALIGNMENT);
+		*block = arena->free[cls];
+		arena->free[cls] = block;
+	}
+	pthread_mutex_unlock(&arena->lock);
+	if (cls == VKHOST_LARGE)
+		free((char *)memory - header->offset);
+}
+
+/**
+ * Resizes allocation, keeping its contents
+ * @param data Specifies allocator
+ * @param original Specifies allocation to resize, or NULL
+ * @param size Specifies new size, zero frees allocation
+ * @param alignment Specifies alignment of allocation
+ * @param scope Specifies allocation scope
+ * @returns pointer to allocation, or NULL if freed or out of memory
+ */
+static VKAPI_ATTR void *VKAPI_CALL
+vkhost_reallocate(void *data, void *original, size_t size, size_t alignment,
+		  VkSystemAllocationScope scope)
+{
+	if (original == NULL)
+		return vkhost_allocate(data, size, alignment, scope);
+	if (size == 0) {
+		vkhost_free(data, original);
+		return NULL;
+	}
+	void *memory = vkhost_allocate(data, size, alignment, scope);
+	if (memory == NULL)
+		return NULL;
+	const size_t old_size = vkhost_header(original)->size;
+	memcpy(memory, original, (old_size < size) ? old_size : size);
+	vkhost_free(data, original);
+	struct vkhost *host = data;
+	struct vkhost_arena *arena = &host->arenas[vkhost_arena_of(scope)];
+	pthread_mutex_lock(&arena->lock);
+	host->scopes[scope].nreallocs++;
+	pthread_mutex_unlock(&arena->lock);
+	return memory;
+}
+
+/**
+ * Accounts memory driver allocated itself
+ * @param data Specifies allocator
+ * @param size Specifies size of allocation
+ * @param type Specifies type of allocation
+ * @param scope Specifies allocation scope
+ */
+static VKAPI_ATTR void VKAPI_CALL
+vkhost_internal_allocate(void *data, size_t size, VkInternalAllocationType type,
+			 VkSystemAllocationScope scope)
+{
+	(void)(type);
+	struct vkhost *host = data;
+	struct vkhost_arena *arena = &host->arenas[vkhost_arena_of(scope)];
+	pthread_mutex_lock(&arena->lock);
+	host->scopes[scope].internal += size;
+	pthread_mutex_unlock(&arena->lock);
+}
+
+/**
+ * Accounts memory driver freed itself
+ * @param data Specifies allocator
+ * @param size Specifies size of allocation
+ * @param type Specifies type of allocation
+ * @param scope Specifies allocation scope
+ */
+static VKAPI_ATTR void VKAPI_CALL
+vkhost_internal_free(void *data, size_t size, VkInternalAllocationType type,
+		     VkSystemAllocationScope scope)
+{
+	(void)(type);
+	struct vkhost *host = data;
+	struct vkhost_arena *arena = &host->arenas[vkhost_arena_of(scope)];
+	pthread_mutex_lock(&arena->lock);
+	host->scopes[scope].internal -= size;
+	pthread_mutex_unlock(&arena->lock);
+}
+
+int vkhost_init(struct vkhost *host, enum vkhost_mode mode)
+{
+	host->callbacks.pUserData = host;
+	host->callbacks.pfnAllocation = vkhost_allocate;
+	host->callbacks.pfnReallocation = vkhost_reallocate;
+	host->callbacks.pfnFree = vkhost_free;
+	host->callbacks.pfnInternalAllocation = vkhost_internal_allocate;
+	host->callbacks.pfnInternalFree = vkhost_internal_free;
+	host->mode = mode;
+	memset(host->scopes, 0, sizeof(host->scopes));
+	for (uint32_t i = 0; i < VKHOST_NARENAS; ++i) {
+		struct vkhost_arena *arena = &host->arenas[i];
+		memset(arena->free, 0, sizeof(arena->free));
+		arena->chunks = NULL;
+		arena->nchunks = 0;
+		if (pthread_mutex_init(&arena->lock, NULL))
+			return -1;
+	}
+	return 0;
+}
+
+void vkhost_destroy(struct vkhost *host)
+{
+	for (uint32_t i = 0; i < VKHOST_NARENAS; ++i) {
+		struct vkhost_arena *arena = &host->arenas[i];
+		while (arena->chunks != NULL) {
+			struct vkhost_chunk *chunk = arena->chunks;
+			arena->chunks = chunk->next;
+			free(chunk);
+		}
+		memset(arena->free, 0, sizeof(arena->free));
+		pthread_mutex_destroy(&arena->lock);
+	}
+}
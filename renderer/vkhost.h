@@ -0,0 +1,130 @@
+#ifndef RENDERER_VKHOST_H
+#define RENDERER_VKHOST_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vulkan/vulkan_core.h>
+
+/** Alignment of allocations served by arenas, also room for header */
+#define VKHOST_ALIGNMENT 16
+
+/** Size of the smallest size class of arenas */
+#define VKHOST_MIN_CLASS 32
+
+/** Number of size classes of arenas, each twice as large as previous */
+#define VKHOST_NCLASSES 10
+
+/** Size of chunks arenas carve blocks of one size class from */
+#define VKHOST_CHUNK_SIZE ((size_t)64 * 1024)
+
+/** Number of allocation scopes */
+#define VKHOST_NSCOPES (VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE + 1)
+
+/** Allocator serving host allocations of driver */
+enum vkhost_mode {
+	/** Small allocations come from per-scope arenas */
+	VKHOST_MODE_ARENA = 0,
+	/** Every allocation comes from malloc, for comparison */
+	VKHOST_MODE_MALLOC,
+};
+
+/** Arena serving allocations of some scopes */
+enum vkhost_arena_kind {
+	/** Objects living as long as Vulkan object */
+	VKHOST_ARENA_OBJECT = 0,
+	/** Pipeline caches and alike */
+	VKHOST_ARENA_CACHE,
+	/** Data of command buffers being recorded */
+	VKHOST_ARENA_COMMAND,
+	/** Device and instance lifetime data */
+	VKHOST_ARENA_GENERAL,
+	/** Number of arenas */
+	VKHOST_NARENAS,
+};
+
+/** Chunk of arena, blocks follow its header */
+struct vkhost_chunk {
+	/** Chunk allocated before this one, or NULL */
+	struct vkhost_chunk *next;
+};
+
+/** Free lists of size classes carved from chunks */
+struct vkhost_arena {
+	/** Guards arena and statistics of its scopes */
+	pthread_mutex_t lock;
+	/** Free blocks of every size class */
+	void *free[VKHOST_NCLASSES];
+	/** The last allocated chunk, or NULL */
+	struct vkhost_chunk *chunks;
+	/** Number of chunks allocated */
+	size_t nchunks;
+};
+
+/** Statistics of allocation scope */
+struct vkhost_stats {
+	/** Number of allocations made */
+	uint64_t nallocs;
+	/** Number of allocations freed */
+	uint64_t nfrees;
+	/** Number of allocations resized */
+	uint64_t nreallocs;
+	/** Number of bytes allocated at the moment */
+	size_t bytes;
+	/** The largest number of bytes allocated at once */
+	size_t peak;
+	/** Number of bytes driver allocated without callbacks */
+	size_t internal;
+};
+
+/**
+ * Host memory allocator of driver
+ *
+ * Allocations of object, cache and command scopes come from their own
+ * arenas, device and instance scopes share general one. Arenas keep freed
+ * blocks for reuse until allocator is destroyed, so objects created and
+ * destroyed every frame stop going to the heap. Allocations larger than
+ * the largest size class or aligned stricter than VKHOST_ALIGNMENT come
+ * from malloc. Bytes and counts are tracked per scope in both modes.
+ * Allocator is thread-safe.
+ */
+struct vkhost {
+	/** Callbacks passed to create and destroy calls */
+	VkAllocationCallbacks callbacks;
+	/** Allocator serving allocations */
+	enum vkhost_mode mode;
+	/** Arenas of allocation scopes */
+	struct vkhost_arena arenas[VKHOST_NARENAS];
+	/** Statistics of allocation scopes */
+	struct vkhost_stats scopes[VKHOST_NSCOPES];
+};
+
+#ifdef __cplusplus
+/* *INDENT-OFF* */
+extern "C" {
+/* *INDENT-ON* */
+#endif
+
+/**
+ * Initializes allocator
+ * @param host Specifies allocator to initialize
+ * @param mode Specifies allocator serving allocations
+ * @returns zero on success, or non-zero otherwise
+ */
+int vkhost_init(struct vkhost *host, enum vkhost_mode mode);
+
+/**
+ * Releases memory of arenas, once everything allocated is freed
+ *
+ * Statistics are kept.
+ * @param host Specifies allocator to destroy
+ */
+void vkhost_destroy(struct vkhost *host);
+
+#ifdef __cplusplus
+/* *INDENT-OFF* */
+}
+/* *INDENT-ON* */
+#endif
+#endif
@@ -0,0 +1,197 @@
+/**
+ * @file
+ * Test suite for vkhost
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <cgreen/cgreen.h>
+#include <cgreen/mocks.h>
+
+#include <vulkan/vulkan_core.h>
+#include "vkhost.h"
+
+/**
+ * Allocates memory through callbacks of allocator
+ * @param host Specifies allocator
+ * @param size Specifies size of allocation
+ * @param alignment Specifies alignment of allocation
+ * @param scope Specifies allocation scope
+ * @returns pointer to allocation
+ */
+static void *allocate(struct vkhost *host, size_t size, size_t alignment,
+		      VkSystemAllocationScope scope)
+{
+	const VkAllocationCallbacks *cb = &host->callbacks;
+	return cb->pfnAllocation(cb->pUserData, size, alignment, scope);
+}
+
+/**
+ * Frees memory through callbacks of allocator
+ * @param host Specifies allocator
+ * @param memory Specifies allocation to free
+ */
+static void release(struct vkhost *host, void *memory)
+{
+	const VkAllocationCallbacks *cb = &host->callbacks;
+	cb->pfnFree(cb->pUserData, memory);
+}
+
+Ensure(allocation_counts_bytes_of_scope)
+{
+	struct vkhost host;
+	vkhost_init(&host, VKHOST_MODE_ARENA);
+	void *memory =
+		allocate(&host, 100, 8, VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+	assert_that(memory, is_non_null);
+	assert_that((uintptr_t)memory % VKHOST_ALIGNMENT, is_equal_to(0));
+	const struct vkhost_stats *stats =
+		&host.scopes[VK_SYSTEM_ALLOCATION_SCOPE_OBJECT];
+	assert_that(stats->nallocs, is_equal_to(1));
+	assert_that(stats->bytes, is_equal_to(100));
+	release(&host, memory);
+	assert_that(stats->nfrees, is_equal_to(1));
+	assert_that(stats->bytes, is_equal_to(0));
+	assert_that(stats->peak, is_equal_to(100));
+	assert_that(host.scopes[VK_SYSTEM_ALLOCATION_SCOPE_COMMAND].nallocs,
+		    is_equal_to(0));
+	vkhost_destroy(&host);
+}
+
+Ensure(freed_block_is_reused_by_arena)
+{
+	struct vkhost host;
+	vkhost_init(&host, VKHOST_MODE_ARENA);
+	void *first =
+		allocate(&host, 64, 16, VK_SYSTEM_ALLOCATION_SCOPE_COMMAND);
+	release(&host, first);
+	void *second =
+		allocate(&host, 60, 16, VK_SYSTEM_ALLOCATION_SCOPE_COMMAND);
+	assert_that(second, is_equal_to(first));
+	assert_that(host.arenas[VKHOST_ARENA_COMMAND].nchunks, is_equal_to(1));
+	release(&host, second);
+	vkhost_destroy(&host);
+}
+
+Ensure(scopes_allocate_from_their_own_arenas)
+{
+	struct vkhost host;
+	vkhost_init(&host, VKHOST_MODE_ARENA);
+	void *object =
+		allocate(&host, 32, 8, VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+	void *cache = allocate(&host, 32, 8, VK_SYSTEM_ALLOCATION_SCOPE_CACHE);
+	void *device =
+		allocate(&host, 32, 8, VK_SYSTEM_ALLOCATION_SCOPE_DEVICE);
+	assert_that(host.arenas[VKHOST_ARENA_OBJECT].nchunks, is_equal_to(1));
+	assert_that(host.arenas[VKHOST_ARENA_CACHE].nchunks, is_equal_to(1));
+	assert_that(host.arenas[VKHOST_ARENA_GENERAL].nchunks, is_equal_to(1));
+	assert_that(host.arenas[VKHOST_ARENA_COMMAND].nchunks, is_equal_to(0));
+	release(&host, object);
+	release(&host, cache);
+	release(&host, device);
+	vkhost_destroy(&host);
+}
+
+Ensure(strictly_aligned_allocation_bypasses_arena)
+{
+	struct vkhost host;
+	vkhost_init(&host, VKHOST_MODE_ARENA);
+	void *memory =
+		allocate(&host, 100, 256, VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+	assert_that((uintptr_t)memory % 256, is_equal_to(0));
+	assert_that(host.arenas[VKHOST_ARENA_OBJECT].nchunks, is_equal_to(0));
+	release(&host, memory);
+	assert_that(host.scopes[VK_SYSTEM_ALLOCATION_SCOPE_OBJECT].bytes,
+		    is_equal_to(0));
+	vkhost_destroy(&host);
+}
+
+Ensure(large_allocation_bypasses_arena)
+{
+	struct vkhost host;
+	vkhost_init(&host, VKHOST_MODE_ARENA);
+	void *memory = allocate(&host, VKHOST_CHUNK_SIZE, 16,
+				VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+	assert_that(memory, is_non_null);
+	assert_that(host.arenas[VKHOST_ARENA_OBJECT].nchunks, is_equal_to(0));
+	release(&host, memory);
+	vkhost_destroy(&host);
+}
+
+Ensure(malloc_mode_never_carves_chunks)
+{
+	struct vkhost host;
+	vkhost_init(&host, VKHOST_MODE_MALLOC);
+	void *memory =
+		allocate(&host, 32, 8, VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+	assert_that(memory, is_non_null);
+	assert_that(host.arenas[VKHOST_ARENA_OBJECT].nchunks, is_equal_to(0));
+	assert_that(host.scopes[VK_SYSTEM_ALLOCATION_SCOPE_OBJECT].bytes,
+		    is_equal_to(32));
+	release(&host, memory);
+	vkhost_destroy(&host);
+}
+
+Ensure(reallocation_keeps_contents)
+{
+	struct vkhost host;
+	vkhost_init(&host, VKHOST_MODE_ARENA);
+	const VkAllocationCallbacks *cb = &host.callbacks;
+	char *memory = allocate(&host, 8, 8, VK_SYSTEM_ALLOCATION_SCOPE_CACHE);
+	memcpy(memory, "pipeline", 8);
+	memory = cb->pfnReallocation(cb->pUserData, memory, 4096, 8,
+				     VK_SYSTEM_ALLOCATION_SCOPE_CACHE);
+	assert_that(memcmp(memory, "pipeline", 8), is_equal_to(0));
+	const struct vkhost_stats *stats =
+		&host.scopes[VK_SYSTEM_ALLOCATION_SCOPE_CACHE];
+	assert_that(stats->bytes, is_equal_to(4096));
+	assert_that(stats->nreallocs, is_equal_to(1));
+	void *freed = cb->pfnReallocation(cb->pUserData, memory, 0, 8,
+					  VK_SYSTEM_ALLOCATION_SCOPE_CACHE);
+	assert_that(freed, is_null);
+	assert_that(stats->bytes, is_equal_to(0));
+	vkhost_destroy(&host);
+}
+
+Ensure(internal_allocations_are_counted)
+{
+	struct vkhost host;
+	vkhost_init(&host, VKHOST_MODE_ARENA);
+	const VkAllocationCallbacks *cb = &host.callbacks;
+	cb->pfnInternalAllocation(cb->pUserData, 4096,
+				  VK_INTERNAL_ALLOCATION_TYPE_EXECUTABLE,
+				  VK_SYSTEM_ALLOCATION_SCOPE_DEVICE);
+	assert_that(host.scopes[VK_SYSTEM_ALLOCATION_SCOPE_DEVICE].internal,
+		    is_equal_to(4096));
+	cb->pfnInternalFree(cb->pUserData, 4096,
+			    VK_INTERNAL_ALLOCATION_TYPE_EXECUTABLE,
+			    VK_SYSTEM_ALLOCATION_SCOPE_DEVICE);
+	assert_that(host.scopes[VK_SYSTEM_ALLOCATION_SCOPE_DEVICE].internal,
+		    is_equal_to(0));
+	vkhost_destroy(&host);
+}
+
+int main(int argc, char **argv)
+{
+	(void)(argc);
+	(void)(argv);
+	TestSuite *suite = create_named_test_suite("VKHost");
+	add_test(suite, allocation_counts_bytes_of_scope);
+	add_test(suite, freed_block_is_reused_by_arena);
+	add_test(suite, scopes_allocate_from_their_own_arenas);
+	add_test(suite, strictly_aligned_allocation_bypasses_arena);
+	add_test(suite, large_allocation_bypasses_arena);
+	add_test(suite, malloc_mode_never_carves_chunks);
+	add_test(suite, reallocation_keeps_contents);
+	add_test(suite, internal_allocations_are_counted);
+	TestReporter *reporter = create_text_reporter();
+	int exit_code = run_test_suite(suite, reporter);
+	destroy_reporter(reporter);
+	destroy_test_suite(suite);
+	return exit_code;
+}
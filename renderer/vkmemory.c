@@ -0,0 +1,840 @@
+/**
+ * @file
+ * Vulkan device memory sub-allocator implementation
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "vkmemory.h"
+#include <vulkan/vulkan_core.h>
+
+/** Smallest block sub-allocated in small heaps */
+#define VKMEMORY_MIN_BLOCK_SIZE ((VkDeviceSize)1024 * 1024)
+
+/**
+ * Returns binary logarithm of value rounded down
+ * @param value Specifies non-zero value
+ * @returns index of the highest set bit
+ */
+static uint32_t vkmemory_log2(VkDeviceSize value)
+{
+	uint32_t log = 0;
+	for (uint32_t shift = 32; shift > 0; shift /= 2) {
+		if (value >> shift) {
+			value >>= shift;
+			log += shift;
+		}
+	}
+	return log;
+}
+
+/**
+ * Returns index of the lowest set bit
+ * @param bits Specifies non-zero bit mask
+ * @returns index of the lowest set bit
+ */
+static uint32_t vkmemory_lowest(uint32_t bits)
+{
+	uint32_t index = 0;
+	for (uint32_t shift = 16; shift > 0; shift /= 2) {
+		if (!(bits & ((UINT32_C(1) << shift) - 1))) {
+			bits >>= shift;
+			index += shift;
+		}
+	}
+	return index;
+}
+
+/**
+ * Returns number of set bits
+ * @param bits Specifies bit mask
+ * @returns number of set bits
+ */
+static uint32_t vkmemory_popcount(uint32_t bits)
+{
+	uint32_t count = 0;
+	for (; bits; bits &= bits - 1) {
+		count++;
+	}
+	return count;
+}
+
+/**
+ * Rounds value up to multiple of alignment
+ * @param value Specifies value to round
+ * @param alignment Specifies power of two alignment
+ * @returns aligned value
+ */
+static VkDeviceSize vkmemory_align(VkDeviceSize value, VkDeviceSize alignment)
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+/**
+ * Maps size to free list holding ranges of that size
+ * @param size Specifies size of range
+ * @param fl Specifies pointer where first level index must be stored
+ * @param sl Specifies pointer where second level index must be stored
+ */
+static void vkmemory_mapping(VkDeviceSize size, uint32_t *fl, uint32_t *sl)
+{
+	if (size < VKMEMORY_SL_COUNT) {
+		*fl = 0;
+		*sl = (uint32_t)size;
+		return;
+	}
+	const uint32_t log = vkmemory_log2(size);
+	*sl = (uint32_t)(size >> (log - VKMEMORY_SL_LOG2)) - VKMEMORY_SL_COUNT;
+	*fl = log - VKMEMORY_SL_LOG2 + 1;
+}
+
+/**
+ * Finds free range not smaller than size
+ *
+ * Size is rounded up to the next size class, so every range in found list
+ * fits.
+ * @param pool Specifies pool to search
+ * @param size Specifies minimum size of range
+ * @returns index of range, or VKMEMORY_NONE if none fits
+ */
+static uint32_t vkmemory_find(const struct vkmemory_pool *pool,
+			      VkDeviceSize size)
+{
+	if (size >= VKMEMORY_SL_COUNT) {
+		const uint32_t log = vkmemory_log2(size);
+		size += ((VkDeviceSize)1 << (log - VKMEMORY_SL_LOG2)) - 1;
+	}
+	uint32_t fl;
+	uint32_t sl;
+	vkmemory_mapping(size, &fl, &sl);
+	if (fl >= VKMEMORY_FL_COUNT)
+		return VKMEMORY_NONE;
+	uint32_t sl_map = pool->sl_bitmap[fl] & (~UINT32_C(0) << sl);
+	if (sl_map == 0) {
+		const uint32_t fl_map = (fl + 1 < VKMEMORY_FL_COUNT) ?
+			pool->fl_bitmap & (~UINT32_C(0) << (fl + 1)) : 0;
+		if (fl_map == 0)
+			return VKMEMORY_NONE;
+		fl = vkmemory_lowest(fl_map);
+		sl_map = pool->sl_bitmap[fl];
+	}
+	return pool->heads[fl][vkmemory_lowest(sl_map)];
+}
+
+/**
+ * Inserts range into free list of its size
+ * @param pool Specifies pool the range belongs to
+ * @param index Specifies range to insert
+ */
+static void vkmemory_insert(struct vkmemory_pool *pool, uint32_t index)
+{
+	struct vkmemory_range *range = &pool->ranges[index];
+	uint32_t fl;
+	uint32_t sl;
+	vkmemory_mapping(range->size, &fl, &sl);
+	range->free = 1;
+	range->prev_free = VKMEMORY_NONE;
+	/* Free ranges of evacuated block are merged but never allocated */
+	if (range->block == pool->evacuating) {
+		range->next_free = VKMEMORY_NONE;
+		return;
+	}
+	range->next_free = pool->heads[fl][sl];
+	if (range->next_free != VKMEMORY_NONE)
+		pool->ranges[range->next_free].prev_free = index;
+	pool->heads[fl][sl] = index;
+	pool->fl_bitmap |= UINT32_C(1) << fl;
+	pool->sl_bitmap[fl] |= UINT32_C(1) << sl;
+}
+
+/**
+ * Removes range from free list of its size
+ * @param pool Specifies pool the range belongs to
+ * @param index Specifies range to remove
+ */
+static void vkmemory_remove(struct vkmemory_pool *pool, uint32_t index)
+{
+	struct vkmemory_range *range = &pool->ranges[index];
+	uint32_t fl;
+	uint32_t sl;
+	if (range->block == pool->evacuating) {
+		range->free = 0;
+		return;
+	}
+	vkmemory_mapping(range->size, &fl, &sl);
+	if (range->prev_free != VKMEMORY_NONE)
+		pool->ranges[range->prev_free].next_free = range->next_free;
+	else
+		pool->heads[fl][sl] = range->next_free;
+	if (range->next_free != VKMEMORY_NONE)
+		pool->ranges[range->next_free].prev_free = range->prev_free;
+	if (pool->heads[fl][sl] == VKMEMORY_NONE) {
+		pool->sl_bitmap[fl] &= ~(UINT32_C(1) << sl);
+		if (pool->sl_bitmap[fl] == 0)
+			pool->fl_bitmap &= ~(UINT32_C(1) << fl);
+	}
+	range->free = 0;
+}
+
+/**
+ * Makes sure storage has unused ranges
+ * @param pool Specifies pool to grow storage of
+ * @param count Specifies number of unused ranges required
+ * @returns zero on success, or non-zero if out of memory
+ */
+static int vkmemory_reserve(struct vkmemory_pool *pool, uint32_t count)
+{
+	uint32_t nunused = 0;
+	for (uint32_t i = pool->unused; i != VKMEMORY_NONE && nunused < count;
+	     i = pool->ranges[i].next_free) {
+		nunused++;
+	}
+	if (nunused == count)
+		return 0;
+	const uint32_t nranges = pool->nranges ? pool->nranges * 2 : 64;
+	struct vkmemory_range *ranges =
+		realloc(pool->ranges, nranges * sizeof(*ranges));
+	if (ranges == NULL)
+		return -1;
+	for (uint32_t i = nranges; i > pool->nranges; --i) {
+		ranges[i - 1].next_free = pool->unused;
+		pool->unused = i - 1;
+	}
+	pool->ranges = ranges;
+	pool->nranges = nranges;
+	return 0;
+}
+
+/**
+ * Takes unused range from storage, it must be reserved
+ * @param pool Specifies pool to take range from
+ * @returns index of range
+ */
+static uint32_t vkmemory_take(struct vkmemory_pool *pool)
+{
+	const uint32_t index = pool->unused;
+	pool->unused = pool->ranges[index].next_free;
+	return index;
+}
+
+/**
+ * Returns range to storage
+ * @param pool Specifies pool the range belongs to
+ * @param index Specifies range to return
+ */
+static void vkmemory_put(struct vkmemory_pool *pool, uint32_t index)
+{
+	pool->ranges[index].next_free = pool->unused;
+	pool->unused = index;
+}
+
+/**
+ * Splits range, the new range follows it
+ * @param pool Specifies pool the range belongs to
+ * @param index Specifies range to split
+ * @param size Specifies size the range keeps
+ * @returns index of new range following @a index
+ */
+static uint32_t vkmemory_split(struct vkmemory_pool *pool, uint32_t index,
+			       VkDeviceSize size)
+{
+	const uint32_t tail = vkmemory_take(pool);
+	struct vkmemory_range *range = &pool->ranges[index];
+	struct vkmemory_range *rest = &pool->ranges[tail];
+	rest->offset = range->offset + size;
+	rest->size = range->size - size;
+	rest->block = range->block;
+	rest->prev = index;
+	rest->next = range->next;
+	if (range->next != VKMEMORY_NONE)
+		pool->ranges[range->next].prev = tail;
+	range->next = tail;
+	range->size = size;
+	return tail;
+}
+
+/**
+ * Merges range with the following one, which is returned to storage
+ * @param pool Specifies pool the range belongs to
+ * @param index Specifies range to merge
+ */
+static void vkmemory_merge(struct vkmemory_pool *pool, uint32_t index)
+{
+	struct vkmemory_range *range = &pool->ranges[index];
+	const uint32_t next = range->next;
+	const struct vkmemory_range *rest = &pool->ranges[next];
+	range->size += rest->size;
+	range->next = rest->next;
+	if (rest->next != VKMEMORY_NONE)
+		pool->ranges[rest->next].prev = index;
+	vkmemory_put(pool, next);
+}
+
+/**
+ * Returns pool of memory type, creating it on first use
+ * @param mem Specifies allocator the pool belongs to
+ * @param type Specifies memory type
+ * @returns pointer to pool, or NULL if out of memory
+ */
+static struct vkmemory_pool *vkmemory_pool(struct vkmemory *mem, uint32_t type)
+{
+	struct vkmemory_pool *pool = mem->pools[type];
+	if (pool != NULL)
+		return pool;
+	pool = calloc(1, sizeof(*pool));
+	if (pool == NULL)
+		return NULL;
+	memset(pool->heads, 0xFF, sizeof(pool->heads));
+	pool->unused = VKMEMORY_NONE;
+	pool->evacuating = VKMEMORY_NONE;
+	mem->pools[type] = pool;
+	return pool;
+}
+
+/**
+ * Allocates device memory, mapping it if memory type is host visible
+ * @param mem Specifies allocator to allocate for
+ * @param info Specifies allocation parameters
+ * @param memory Specifies pointer where device memory must be stored
+ * @param mapped Specifies pointer where host address must be stored
+ * @returns VK_SUCCESS on success, or VkResult error otherwise
+ */
+static VkResult vkmemory_allocate(struct vkmemory *mem,
+				  const VkMemoryAllocateInfo *info,
+				  VkDeviceMemory *memory, void **mapped)
+{
+	const uint32_t index = info->memoryTypeIndex;
+	const VkMemoryType *type = &mem->props.memoryTypes[index];
+	VkResult result = vkAllocateMemory(mem->dev, info, mem->host, memory);
+	*mapped = NULL;
+	if (result != VK_SUCCESS)
+		return result;
+	/* Host visible memory stays mapped, so it is written without calls */
+	if (type->propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+		result = vkMapMemory(mem->dev, *memory, 0, VK_WHOLE_SIZE, 0,
+				     mapped);
+		if (result != VK_SUCCESS) {
+			vkFreeMemory(mem->dev, *memory, mem->host);
+			return result;
+		}
+	}
+	struct vkmemory_heap *heap = &mem->heaps[type->heapIndex];
+	heap->allocated += info->allocationSize;
+	heap->nblocks++;
+	return VK_SUCCESS;
+}
+
+/**
+ * Adds block to pool of memory type
+ *
+ * Smaller blocks are tried if device is out of memory.
+ * @param mem Specifies allocator to add block to
+ * @param type Specifies memory type of block
+ * @param size Specifies minimum size of free range in block
+ * @param index Specifies pointer where free range of block must be stored
+ * @returns VK_SUCCESS on success, or VkResult error otherwise
+ */
+static VkResult vkmemory_add_block(struct vkmemory *mem, uint32_t type,
+				   VkDeviceSize size, uint32_t *index)
+{
+	struct vkmemory_pool *pool = mem->pools[type];
+	const uint32_t heap = mem->props.memoryTypes[type].heapIndex;
+	uint32_t slot = 0;
+	while (slot < pool->nblocks &&
+	       pool->blocks[slot].memory != VK_NULL_HANDLE) {
+		slot++;
+	}
+	if (slot == pool->nblocks) {
+		struct vkmemory_block *blocks = realloc(
+			pool->blocks, (slot + 1) * sizeof(*blocks));
+		if (blocks == NULL)
+			return VK_ERROR_OUT_OF_HOST_MEMORY;
+		pool->blocks = blocks;
+		pool->blocks[slot].memory = VK_NULL_HANDLE;
+		pool->nblocks++;
+	}
+	if (vkmemory_reserve(pool, 1))
+		return VK_ERROR_OUT_OF_HOST_MEMORY;
+	struct vkmemory_block *block = &pool->blocks[slot];
+	VkMemoryAllocateInfo info = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+		.pNext = NULL,
+		.allocationSize = mem->heaps[heap].block_size,
+		.memoryTypeIndex = type,
+	};
+	VkResult result;
+	do {
+		result = vkmemory_allocate(mem, &info, &block->memory,
+					   &block->mapped);
+		info.allocationSize /= 2;
+	} while (result == VK_ERROR_OUT_OF_DEVICE_MEMORY &&
+		 info.allocationSize >= size);
+	if (result != VK_SUCCESS) {
+		block->memory = VK_NULL_HANDLE;
+		return result;
+	}
+	block->size = info.allocationSize * 2;
+	block->used = 0;
+	pool->nempty++;
+	*index = vkmemory_take(pool);
+	block->first = *index;
+	struct vkmemory_range *range = &pool->ranges[*index];
+	range->offset = 0;
+	range->size = block->size;
+	range->block = slot;
+	range->prev = VKMEMORY_NONE;
+	range->next = VKMEMORY_NONE;
+	vkmemory_insert(pool, *index);
+	return VK_SUCCESS;
+}
+
+/**
+ * Sub-allocates range from blocks of memory type
+ * @param mem Specifies allocator to allocate from
+ * @param type Specifies memory type to allocate
+ * @param size Specifies size of allocation
+ * @param alignment Specifies alignment of allocation
+ * @param compact Specifies non-zero if no block may be added
+ * @param alloc Specifies pointer where allocation must be stored
+ * @returns VK_SUCCESS on success, or VkResult error otherwise
+ */
+static VkResult vkmemory_suballocate(struct vkmemory *mem, uint32_t type,
+				     VkDeviceSize size, VkDeviceSize alignment,
+				     int compact, struct vkmemory_alloc *alloc)
+{
+	struct vkmemory_pool *pool = vkmemory_pool(mem, type);
+	if (pool == NULL)
+		return VK_ERROR_OUT_OF_HOST_MEMORY;
+	/* Any range of this size fits aligned allocation */
+	const VkDeviceSize padded = size + alignment - 1;
+	uint32_t index = vkmemory_find(pool, padded);
+	if (index == VKMEMORY_NONE && compact)
+		return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+	if (index == VKMEMORY_NONE) {
+		const VkResult result =
+			vkmemory_add_block(mem, type, padded, &index);
+		if (result != VK_SUCCESS)
+			return result;
+	}
+	if (vkmemory_reserve(pool, 2))
+		return VK_ERROR_OUT_OF_HOST_MEMORY;
+	vkmemory_remove(pool, index);
+	const struct vkmemory_range *range = &pool->ranges[index];
+	const VkDeviceSize pad =
+		vkmemory_align(range->offset, alignment) - range->offset;
+	if (pad > 0) {
+		/* Padding stays free in front of allocation */
+		const uint32_t aligned = vkmemory_split(pool, index, pad);
+		vkmemory_insert(pool, index);
+		index = aligned;
+		range = &pool->ranges[index];
+	}
+	if (range->size > size)
+		vkmemory_insert(pool, vkmemory_split(pool, index, size));
+	range = &pool->ranges[index];
+	struct vkmemory_block *block = &pool->blocks[range->block];
+	if (block->used == 0)
+		pool->nempty--;
+	block->used += size;
+	struct vkmemory_heap *heap =
+		&mem->heaps[mem->props.memoryTypes[type].heapIndex];
+	heap->used += size;
+	heap->nallocs++;
+	alloc->memory = block->memory;
+	alloc->offset = range->offset;
+	alloc->size = size;
+	alloc->mapped = block->mapped ?
+		(char *)block->mapped + range->offset : NULL;
+	alloc->type = type;
+	alloc->range = index;
+	return VK_SUCCESS;
+}
+
+/**
+ * Allocates own device memory for resource
+ * @param mem Specifies allocator to allocate from
+ * @param type Specifies memory type to allocate
+ * @param req Specifies requested memory
+ * @param alloc Specifies pointer where allocation must be stored
+ * @returns VK_SUCCESS on success, or VkResult error otherwise
+ */
+static VkResult vkmemory_allocate_dedicated(struct vkmemory *mem,
+					    uint32_t type,
+					    const struct vkmemory_request *req,
+					    struct vkmemory_alloc *alloc)
+{
+	const VkMemoryDedicatedAllocateInfo dedicated_info = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO,
+		.pNext = NULL,
+		.image = req->image,
+		.buffer = req->buffer,
+	};
+	const int dedicated = mem->dedicated && (req->image != VK_NULL_HANDLE ||
+						 req->buffer != VK_NULL_HANDLE);
+	const VkMemoryAllocateInfo info = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+		.pNext = dedicated ? &dedicated_info : NULL,
+		.allocationSize = req->reqs.size,
+		.memoryTypeIndex = type,
+	};
+	const VkResult result =
+		vkmemory_allocate(mem, &info, &alloc->memory, &alloc->mapped);
+	if (result != VK_SUCCESS)
+		return result;
+	struct vkmemory_heap *heap =
+		&mem->heaps[mem->props.memoryTypes[type].heapIndex];
+	heap->used += req->reqs.size;
+	heap->nallocs++;
+	alloc->offset = 0;
+	alloc->size = req->reqs.size;
+	alloc->type = type;
+	alloc->range = VKMEMORY_NONE;
+	return VK_SUCCESS;
+}
+
+/**
+ * Selects memory type having the most of preferred properties
+ * @param mem Specifies allocator to select memory type of
+ * @param types Specifies bit mask of memory types to select from
+ * @param req Specifies requested memory
+ * @returns index of memory type, or VKMEMORY_NONE if none fits
+ */
+static uint32_t vkmemory_select(const struct vkmemory *mem, uint32_t types,
+				const struct vkmemory_request *req)
+{
+	uint32_t best = VKMEMORY_NONE;
+	uint32_t best_score = 0;
+	for (uint32_t i = 0; i < mem->props.memoryTypeCount; ++i) {
+		const VkMemoryPropertyFlags flags =
+			mem->props.memoryTypes[i].propertyFlags;
+		if (!(types & (UINT32_C(1) << i)) ||
+		    (flags & req->required) != req->required)
+			continue;
+		const uint32_t score =
+			vkmemory_popcount(flags & req->preferred);
+		if (best == VKMEMORY_NONE || score > best_score) {
+			best = i;
+			best_score = score;
+		}
+	}
+	return best;
+}
+
+void vkmemory_init(struct vkmemory *mem, VkPhysicalDevice phy, VkDevice dev,
+		   const VkAllocationCallbacks *host)
+{
+	VkPhysicalDeviceProperties props;
+	vkGetPhysicalDeviceProperties(phy, &props);
+	vkGetPhysicalDeviceMemoryProperties(phy, &mem->props);
+	mem->dev = dev;
+	mem->host = host;
+	mem->granularity = props.limits.bufferImageGranularity;
+	/* Dedicated allocation hints are reported since Vulkan 1.1 */
+	mem->dedicated = props.apiVersion >= VK_API_VERSION_1_1;
+	memset(mem->pools, 0, sizeof(mem->pools));
+	memset(mem->heaps, 0, sizeof(mem->heaps));
+	for (uint32_t i = 0; i < mem->props.memoryHeapCount; ++i) {
+		/* Small heaps are split into blocks of eighth of heap */
+		VkDeviceSize size = mem->props.memoryHeaps[i].size / 8;
+		if (size > VKMEMORY_BLOCK_SIZE)
+			size = VKMEMORY_BLOCK_SIZE;
+		if (size < VKMEMORY_MIN_BLOCK_SIZE)
+			size = VKMEMORY_MIN_BLOCK_SIZE;
+		mem->heaps[i].block_size =
+			(VkDeviceSize)1 << vkmemory_log2(size);
+	}
+}
+
+VkResult vkmemory_alloc(struct vkmemory *mem,
+			const struct vkmemory_request *req,
+			struct vkmemory_alloc *alloc)
+{
+	VkDeviceSize size = req->reqs.size;
+	VkDeviceSize alignment = req->reqs.alignment ? req->reqs.alignment : 1;
+	/* Optimal image owns whole granularity pages it touches */
+	if (req->kind == VKMEMORY_OPTIMAL && mem->granularity > alignment) {
+		alignment = mem->granularity;
+		size = vkmemory_align(size, mem->granularity);
+	}
+	VkResult result = VK_ERROR_FEATURE_NOT_PRESENT;
+	uint32_t types = req->reqs.memoryTypeBits;
+	uint32_t type;
+	while ((type = vkmemory_select(mem, types, req)) != VKMEMORY_NONE) {
+		const uint32_t heap = mem->props.memoryTypes[type].heapIndex;
+		if (req->dedicated || size > mem->heaps[heap].block_size / 2) {
+			result = vkmemory_allocate_dedicated(mem, type, req,
+							     alloc);
+		} else {
+			result = vkmemory_suballocate(mem, type, size,
+						      alignment, req->compact,
+						      alloc);
+		}
+		if (result != VK_ERROR_OUT_OF_DEVICE_MEMORY)
+			return result;
+		types &= ~(UINT32_C(1) << type);
+	}
+	return result;
+}
+
+VkResult vkmemory_alloc_buffer(struct vkmemory *mem, VkBuffer buffer,
+			       VkMemoryPropertyFlags required,
+			       VkMemoryPropertyFlags preferred,
+			       struct vkmemory_alloc *alloc)
+{
+	struct vkmemory_request req = {
+		.required = required,
+		.preferred = preferred,
+		.kind = VKMEMORY_LINEAR,
+		.dedicated = 0,
+		.buffer = buffer,
+		.image = VK_NULL_HANDLE,
+	};
+	if (mem->dedicated) {
+		VkMemoryDedicatedRequirements dedicated = {
+			.sType =
+			VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS,
+			.pNext = NULL,
+		};
+		VkMemoryRequirements2 reqs = {
+			.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2,
+			.pNext = &dedicated,
+		};
+		const VkBufferMemoryRequirementsInfo2 info = {
+			.sType =
+			VK_STRUCTURE_TYPE_BUFFER_MEMORY_REQUIREMENTS_INFO_2,
+			.pNext = NULL,
+			.buffer = buffer,
+		};
+		vkGetBufferMemoryRequirements2(mem->dev, &info, &reqs);
+		req.reqs = reqs.memoryRequirements;
+		req.dedicated = dedicated.prefersDedicatedAllocation ||
+				dedicated.requiresDedicatedAllocation;
+	} else {
+		vkGetBufferMemoryRequirements(mem->dev, buffer, &req.reqs);
+	}
+	VkResult result = vkmemory_alloc(mem, &req, alloc);
+	if (result != VK_SUCCESS)
+		return result;
+	result = vkBindBufferMemory(mem->dev, buffer, alloc->memory,
+				    alloc->offset);
+	if (result != VK_SUCCESS)
+		vkmemory_free(mem, alloc);
+	return result;
+}
+
+VkResult vkmemory_alloc_image(struct vkmemory *mem, VkImage image,
+			      VkImageTiling tiling,
+			      VkMemoryPropertyFlags required,
+			      VkMemoryPropertyFlags preferred,
+			      struct vkmemory_alloc *alloc)
+{
+	struct vkmemory_request req = {
+		.required = required,
+		.preferred = preferred,
+		.kind = (tiling == VK_IMAGE_TILING_LINEAR) ? VKMEMORY_LINEAR :
+							     VKMEMORY_OPTIMAL,
+		.dedicated = 0,
+		.buffer = VK_NULL_HANDLE,
+		.image = image,
+	};
+	if (mem->dedicated) {
+		VkMemoryDedicatedRequirements dedicated = {
+			.sType =
+			VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS,
+			.pNext = NULL,
+		};
+		VkMemoryRequirements2 reqs = {
+			.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2,
+			.pNext = &dedicated,
+		};
+		const VkImageMemoryRequirementsInfo2 info = {
+			.sType =
+			VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2,
+			.pNext = NULL,
+			.image = image,
+		};
+		vkGetImageMemoryRequirements2(mem->dev, &info, &reqs);
+		req.reqs = reqs.memoryRequirements;
+		req.dedicated = dedicated.prefersDedicatedAllocation ||
+				dedicated.requiresDedicatedAllocation;
+	} else {
+		vkGetImageMemoryRequirements(mem->dev, image, &req.reqs);
+	}
+	VkResult result = vkmemory_alloc(mem, &req, alloc);
+	if (result != VK_SUCCESS)
+		return result;
+	result = vkBindImageMemory(mem->dev, image, alloc->memory,
+				   alloc->offset);
+	if (result != VK_SUCCESS)
+		vkmemory_free(mem, alloc);
+	return result;
+}
+
+/**
+ * Releases block without allocations
+ * @param mem Specifies allocator the block belongs to
+ * @param type Specifies memory type of block
+ * @param index Specifies the only range of block
+ */
+static void vkmemory_release_block(struct vkmemory *mem, uint32_t type,
+				   uint32_t index)
+{
+	struct vkmemory_pool *pool = mem->pools[type];
+	const uint32_t slot = pool->ranges[index].block;
+	struct vkmemory_block *block = &pool->blocks[slot];
+	struct vkmemory_heap *heap =
+		&mem->heaps[mem->props.memoryTypes[type].heapIndex];
+	vkFreeMemory(mem->dev, block->memory, mem->host);
+	heap->allocated -= block->size;
+	heap->nblocks--;
+	block->memory = VK_NULL_HANDLE;
+	vkmemory_put(pool, index);
+}
+
+void vkmemory_free(struct vkmemory *mem, const struct vkmemory_alloc *alloc)
+{
+	struct vkmemory_heap *heap =
+		&mem->heaps[mem->props.memoryTypes[alloc->type].heapIndex];
+	heap->used -= alloc->size;
+	heap->nallocs--;
+	if (alloc->range == VKMEMORY_NONE) {
+		vkFreeMemory(mem->dev, alloc->memory, mem->host);
+		heap->allocated -= alloc->size;
+		heap->nblocks--;
+		return;
+	}
+	struct vkmemory_pool *pool = mem->pools[alloc->type];
+	uint32_t index = alloc->range;
+	const struct vkmemory_range *range = &pool->ranges[index];
+	struct vkmemory_block *block = &pool->blocks[range->block];
+	block->used -= alloc->size;
+	if (range->next != VKMEMORY_NONE && pool->ranges[range->next].free) {
+		vkmemory_remove(pool, range->next);
+		vkmemory_merge(pool, index);
+	}
+	const uint32_t prev = pool->ranges[index].prev;
+	if (prev != VKMEMORY_NONE && pool->ranges[prev].free) {
+		vkmemory_remove(pool, prev);
+		vkmemory_merge(pool, prev);
+		index = prev;
+	}
+	if (block->used > 0) {
+		vkmemory_insert(pool, index);
+		return;
+	}
+	/* Evacuation ends once block is empty */
+	if (pool->evacuating == pool->ranges[index].block)
+		pool->evacuating = VKMEMORY_NONE;
+	/* One empty block is kept, so allocations don't thrash device */
+	if (pool->nempty > 0) {
+		vkmemory_release_block(mem, alloc->type, index);
+		return;
+	}
+	pool->nempty++;
+	vkmemory_insert(pool, index);
+}
+
+void vkmemory_evacuate(struct vkmemory *mem, uint32_t type, uint32_t block)
+{
+	struct vkmemory_pool *pool = mem->pools[type];
+	for (uint32_t i = pool->blocks[block].first; i != VKMEMORY_NONE;
+	     i = pool->ranges[i].next) {
+		if (!pool->ranges[i].free)
+			continue;
+		vkmemory_remove(pool, i);
+		pool->ranges[i].free = 1;
+	}
+	pool->evacuating = block;
+}
+
+void vkmemory_settle(struct vkmemory *mem, uint32_t type)
+{
+	struct vkmemory_pool *pool = mem->pools[type];
+	const uint32_t block = pool->evacuating;
+	if (block == VKMEMORY_NONE)
+		return;
+	pool->evacuating = VKMEMORY_NONE;
+	for (uint32_t i = pool->blocks[block].first; i != VKMEMORY_NONE;
+	     i = pool->ranges[i].next) {
+		if (pool->ranges[i].free)
+			vkmemory_insert(pool, i);
+	}
+}
+
+/**
+ * Counts free range in statistics
+ * @param stats Specifies statistics to count range in
+ * @param size Specifies size of free range
+ */
+static void vkmemory_count_free(struct vkmemory_stats *stats,
+				VkDeviceSize size)
+{
+	stats->free += size;
+	stats->nfree++;
+	if (size > stats->largest_free)
+		stats->largest_free = size;
+}
+
+void vkmemory_stats(const struct vkmemory *mem, uint32_t heap,
+		    struct vkmemory_stats *stats)
+{
+	const struct vkmemory_heap *usage = &mem->heaps[heap];
+	stats->allocated = usage->allocated;
+	stats->used = usage->used;
+	stats->nblocks = usage->nblocks;
+	stats->nallocs = usage->nallocs;
+	stats->free = 0;
+	stats->largest_free = 0;
+	stats->nfree = 0;
+	for (uint32_t type = 0; type < mem->props.memoryTypeCount; ++type) {
+		const struct vkmemory_pool *pool = mem->pools[type];
+		if (pool == NULL ||
+		    mem->props.memoryTypes[type].heapIndex != heap)
+			continue;
+		for (uint32_t fl = 0; fl < VKMEMORY_FL_COUNT; ++fl) {
+			for (uint32_t sl = 0; sl < VKMEMORY_SL_COUNT; ++sl) {
+				for (uint32_t i = pool->heads[fl][sl];
+				     i != VKMEMORY_NONE;
+				     i = pool->ranges[i].next_free) {
+					vkmemory_count_free(
+						stats, pool->ranges[i].size);
+				}
+			}
+		}
+		/* Evacuated block is still allocated, but not in free lists */
+		if (pool->evacuating == VKMEMORY_NONE)
+			continue;
+		const struct vkmemory_block *block =
+			&pool->blocks[pool->evacuating];
+		for (uint32_t i = block->first; i != VKMEMORY_NONE;
+		     i = pool->ranges[i].next) {
+			if (pool->ranges[i].free)
+				vkmemory_count_free(stats,
+						    pool->ranges[i].size);
+		}
+	}
+}
+
+void vkmemory_destroy(struct vkmemory *mem)
+{
+	for (uint32_t type = 0; type < VK_MAX_MEMORY_TYPES; ++type) {
+		struct vkmemory_pool *pool = mem->pools[type];
+		if (pool == NULL)
+			continue;
+		for (uint32_t i = 0; i < pool->nblocks; ++i) {
+			if (pool->blocks[i].memory != VK_NULL_HANDLE)
+				vkFreeMemory(mem->dev, pool->blocks[i].memory,
+					     mem->host);
+		}
+		free(pool->blocks);
+		free(pool->ranges);
+		free(pool);
+		mem->pools[type] = NULL;
+	}
+}
@@ -0,0 +1,301 @@
+#ifndef RENDERER_VKMEMORY_H
+#define RENDERER_VKMEMORY_H
+
+#include <stdint.h>
+
+#include <vulkan/vulkan_core.h>
+
+/** Size of device memory blocks sub-allocated in large heaps */
+#define VKMEMORY_BLOCK_SIZE ((VkDeviceSize)256 * 1024 * 1024)
+
+/** Binary logarithm of number of second level free lists */
+#define VKMEMORY_SL_LOG2 4
+
+/** Number of second level free lists per first level */
+#define VKMEMORY_SL_COUNT (1U << VKMEMORY_SL_LOG2)
+
+/** Number of first level free lists, enough for VKMEMORY_BLOCK_SIZE */
+#define VKMEMORY_FL_COUNT 32
+
+/** Index meaning no range or block */
+#define VKMEMORY_NONE UINT32_MAX
+
+/**
+ * Kind of resource bound to memory
+ *
+ * Optimal images never share bufferImageGranularity page with linear
+ * resources.
+ */
+enum vkmemory_kind {
+	/** Buffers and linear images */
+	VKMEMORY_LINEAR = 0,
+	/** Images with optimal tiling */
+	VKMEMORY_OPTIMAL,
+};
+
+/** Range of device memory block, either allocated or free */
+struct vkmemory_range {
+	/** Offset of range in block */
+	VkDeviceSize offset;
+	/** Size of range */
+	VkDeviceSize size;
+	/** Index of block the range belongs to */
+	uint32_t block;
+	/** Preceding range in block, or VKMEMORY_NONE */
+	uint32_t prev;
+	/** Following range in block, or VKMEMORY_NONE */
+	uint32_t next;
+	/** Preceding range in free list, or VKMEMORY_NONE */
+	uint32_t prev_free;
+	/** Following range in free list or in list of unused ranges */
+	uint32_t next_free;
+	/** Non-zero if range is free */
+	uint32_t free;
+};
+
+/** Device memory allocation sub-allocated into ranges */
+struct vkmemory_block {
+	/** Device memory, or VK_NULL_HANDLE if block is released */
+	VkDeviceMemory memory;
+	/** Size of block */
+	VkDeviceSize size;
+	/** Number of bytes allocated from block */
+	VkDeviceSize used;
+	/** Host address of block if it is host visible, or NULL */
+	void *mapped;
+	/** Range at offset zero of block */
+	uint32_t first;
+};
+
+/**
+ * Two-level segregated fit allocator of one memory type
+ *
+ * Free ranges are kept in lists by size class, so allocation and release
+ * take constant time regardless of number of ranges.
+ */
+struct vkmemory_pool {
+	/** Bit mask of first levels having free ranges */
+	uint32_t fl_bitmap;
+	/** Bit masks of second level lists having free ranges */
+	uint32_t sl_bitmap[VKMEMORY_FL_COUNT];
+	/** Heads of free lists */
+	uint32_t heads[VKMEMORY_FL_COUNT][VKMEMORY_SL_COUNT];
+	/** Storage of ranges */
+	struct vkmemory_range *ranges;
+	/** Number of ranges in @a ranges storage */
+	uint32_t nranges;
+	/** Head of list of unused ranges in storage */
+	uint32_t unused;
+	/** Blocks of memory type */
+	struct vkmemory_block *blocks;
+	/** Number of blocks in @a blocks */
+	uint32_t nblocks;
+	/** Number of blocks without allocations */
+	uint32_t nempty;
+	/** Block nothing is allocated from, or VKMEMORY_NONE */
+	uint32_t evacuating;
+};
+
+/** Usage of memory heap */
+struct vkmemory_heap {
+	/** Size of blocks sub-allocated in heap */
+	VkDeviceSize block_size;
+	/** Number of bytes allocated from device, blocks and dedicated */
+	VkDeviceSize allocated;
+	/** Number of bytes used by allocations */
+	VkDeviceSize used;
+	/** Number of device allocations, blocks and dedicated */
+	uint32_t nblocks;
+	/** Number of allocations made in heap */
+	uint32_t nallocs;
+};
+
+/** Statistics of memory heap */
+struct vkmemory_stats {
+	/** Number of bytes allocated from device */
+	VkDeviceSize allocated;
+	/** Number of bytes used by allocations */
+	VkDeviceSize used;
+	/** Number of free bytes in blocks */
+	VkDeviceSize free;
+	/** Size of the largest free range */
+	VkDeviceSize largest_free;
+	/** Number of device allocations */
+	uint32_t nblocks;
+	/** Number of allocations */
+	uint32_t nallocs;
+	/** Number of free ranges */
+	uint32_t nfree;
+};
+
+/**
+ * Device memory sub-allocator
+ *
+ * Resources share large blocks per memory type, so number of device
+ * allocations stays far below maxMemoryAllocationCount. Resources
+ * preferring dedicated allocation and resources larger than half of block
+ * get their own device memory. Allocator is not thread-safe.
+ */
+struct vkmemory {
+	/** Device memory is allocated from */
+	VkDevice dev;
+	/** Host memory allocator of driver, or NULL */
+	const VkAllocationCallbacks *host;
+	/** Memory types and heaps of device */
+	VkPhysicalDeviceMemoryProperties props;
+	/** Granularity separating linear and optimal resources */
+	VkDeviceSize granularity;
+	/** Non-zero if dedicated allocation hints are queried */
+	int dedicated;
+	/** Allocators of memory types, created on first allocation */
+	struct vkmemory_pool *pools[VK_MAX_MEMORY_TYPES];
+	/** Usage of memory heaps */
+	struct vkmemory_heap heaps[VK_MAX_MEMORY_HEAPS];
+};
+
+/** Memory requested for resource */
+struct vkmemory_request {
+	/** Memory requirements of resource */
+	VkMemoryRequirements reqs;
+	/** Memory properties the memory must have */
+	VkMemoryPropertyFlags required;
+	/** Memory properties the memory should have */
+	VkMemoryPropertyFlags preferred;
+	/** Kind of resource */
+	enum vkmemory_kind kind;
+	/** Non-zero if resource prefers its own device memory */
+	int dedicated;
+	/** Non-zero if memory must come from free ranges of existing blocks */
+	int compact;
+	/** Buffer of dedicated allocation, or VK_NULL_HANDLE */
+	VkBuffer buffer;
+	/** Image of dedicated allocation, or VK_NULL_HANDLE */
+	VkImage image;
+};
+
+/** Memory allocated for resource */
+struct vkmemory_alloc {
+	/** Device memory the resource is bound to */
+	VkDeviceMemory memory;
+	/** Offset of allocation in @a memory */
+	VkDeviceSize offset;
+	/** Size of allocation */
+	VkDeviceSize size;
+	/** Host address of allocation if it is host visible, or NULL */
+	void *mapped;
+	/** Memory type of allocation */
+	uint32_t type;
+	/** Range of allocation, or VKMEMORY_NONE if memory is dedicated */
+	uint32_t range;
+};
+
+#ifdef __cplusplus
+/* *INDENT-OFF* */
+extern "C" {
+/* *INDENT-ON* */
+#endif
+
+/**
+ * Initializes allocator
+ * @param mem Specifies allocator to initialize
+ * @param phy Specifies physical device of @a dev
+ * @param dev Specifies device to allocate memory from
+ * @param host Specifies host memory allocator of driver, or NULL
+ */
+void vkmemory_init(struct vkmemory *mem, VkPhysicalDevice phy, VkDevice dev,
+		   const VkAllocationCallbacks *host);
+
+/**
+ * Allocates memory for resource
+ *
+ * Memory type having @a required properties and the most of @a preferred
+ * ones is tried first, then others.
+ * @param mem Specifies allocator to allocate from
+ * @param req Specifies requested memory
+ * @param alloc Specifies pointer where allocation must be stored
+ * @returns VK_SUCCESS on success, VK_ERROR_FEATURE_NOT_PRESENT if no
+ *          memory type fits request, or VkResult error otherwise
+ */
+VkResult vkmemory_alloc(struct vkmemory *mem,
+			const struct vkmemory_request *req,
+			struct vkmemory_alloc *alloc);
+
+/**
+ * Stops allocating from block until it is empty or settled
+ *
+ * Free ranges of block are hidden from allocations, so moving resources
+ * out of block empties it.
+ * @param mem Specifies allocator the block belongs to
+ * @param type Specifies memory type of block
+ * @param block Specifies index of block in pool of @a type
+ */
+void vkmemory_evacuate(struct vkmemory *mem, uint32_t type, uint32_t block);
+
+/**
+ * Allows allocating from block being evacuated again
+ * @param mem Specifies allocator the block belongs to
+ * @param type Specifies memory type of block
+ */
+void vkmemory_settle(struct vkmemory *mem, uint32_t type);
+
+/**
+ * Allocates memory for buffer and binds it
+ * @param mem Specifies allocator to allocate from
+ * @param buffer Specifies buffer to allocate memory for
+ * @param required Specifies memory properties the memory must have
+ * @param preferred Specifies memory properties the memory should have
+ * @param alloc Specifies pointer where allocation must be stored
+ * @returns VK_SUCCESS on success, or VkResult error otherwise
+ */
+VkResult vkmemory_alloc_buffer(struct vkmemory *mem, VkBuffer buffer,
+			       VkMemoryPropertyFlags required,
+			       VkMemoryPropertyFlags preferred,
+			       struct vkmemory_alloc *alloc);
+
+/**
+ * Allocates memory for image and binds it
+ * @param mem Specifies allocator to allocate from
+ * @param image Specifies image to allocate memory for
+ * @param tiling Specifies tiling the image is created with
+ * @param required Specifies memory properties the memory must have
+ * @param preferred Specifies memory properties the memory should have
+ * @param alloc Specifies pointer where allocation must be stored
+ * @returns VK_SUCCESS on success, or VkResult error otherwise
+ */
+VkResult vkmemory_alloc_image(struct vkmemory *mem, VkImage image,
+			      VkImageTiling tiling,
+			      VkMemoryPropertyFlags required,
+			      VkMemoryPropertyFlags preferred,
+			      struct vkmemory_alloc *alloc);
+
+/**
+ * Releases allocation
+ *
+ * Empty block is kept for next allocations unless memory type already has
+ * another empty block.
+ * @param mem Specifies allocator the memory is allocated from
+ * @param alloc Specifies allocation to release
+ */
+void vkmemory_free(struct vkmemory *mem, const struct vkmemory_alloc *alloc);
+
+/**
+ * Collects statistics of memory heap
+ * @param mem Specifies allocator to collect statistics of
+ * @param heap Specifies index of memory heap
+ * @param stats Specifies pointer where statistics must be stored
+ */
+void vkmemory_stats(const struct vkmemory *mem, uint32_t heap,
+		    struct vkmemory_stats *stats);
+
+/**
+ * Releases all device memory, resources must be destroyed before
+ * @param mem Specifies allocator to destroy
+ */
+void vkmemory_destroy(struct vkmemory *mem);
+
+#ifdef __cplusplus
+/* *INDENT-OFF* */
+}
+/* *INDENT-ON* */
+#endif
+#endif
@@ -0,0 +1,238 @@
+/**
+ * @file
+ * Stress benchmark of vkmemory
+ *
+ * Device calls are replaced with fakes, so benchmark measures allocator
+ * alone and runs without GPU.
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vulkan/vulkan_core.h>
+#include "vkclock.h"
+#include "vkmemory.h"
+
+/** Number of allocations alive at once */
+#define NSLOTS 4096
+
+/** Default number of alloc and free operations */
+#define NOPS 4000000UL
+
+/** Host address of every mapped block */
+static char mapped_memory[1];
+
+/** Number of device memory allocations made */
+static unsigned long nallocations;
+
+VKAPI_ATTR void VKAPI_CALL
+vkGetPhysicalDeviceProperties(VkPhysicalDevice physicalDevice,
+			      VkPhysicalDeviceProperties *pProperties)
+{
+	(void)(physicalDevice);
+	pProperties->apiVersion = VK_API_VERSION_1_0;
+	pProperties->limits.bufferImageGranularity = 1024;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceMemoryProperties(
+	VkPhysicalDevice physicalDevice,
+	VkPhysicalDeviceMemoryProperties *pMemoryProperties)
+{
+	(void)(physicalDevice);
+	pMemoryProperties->memoryHeapCount = 1;
+	pMemoryProperties->memoryHeaps[0].size = (VkDeviceSize)8 << 30;
+	pMemoryProperties->memoryHeaps[0].flags =
+		VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+	pMemoryProperties->memoryTypeCount = 1;
+	pMemoryProperties->memoryTypes[0].propertyFlags =
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+	pMemoryProperties->memoryTypes[0].heapIndex = 0;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkAllocateMemory(VkDevice device, const VkMemoryAllocateInfo *pAllocateInfo,
+		 const VkAllocationCallbacks *pAllocator,
+		 VkDeviceMemory *pMemory)
+{
+	(void)(device);
+	(void)(pAllocateInfo);
+	(void)(pAllocator);
+	*pMemory = (VkDeviceMemory)(uintptr_t)(++nallocations);
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkFreeMemory(VkDevice device, VkDeviceMemory memory,
+					const VkAllocationCallbacks *pAllocator)
+{
+	(void)(device);
+	(void)(memory);
+	(void)(pAllocator);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkMapMemory(VkDevice device,
+					   VkDeviceMemory memory,
+					   VkDeviceSize offset,
+					   VkDeviceSize size,
+					   VkMemoryMapFlags flags,
+					   void **ppData)
+{
+	(void)(device);
+	(void)(memory);
+	(void)(offset);
+	(void)(size);
+	(void)(flags);
+	*ppData = mapped_memory;
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetBufferMemoryRequirements(
+	VkDevice device, VkBuffer buffer,
+	VkMemoryRequirements *pMemoryRequirements)
+{
+	(void)(device);
+	(void)(buffer);
+	(void)(pMemoryRequirements);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetBufferMemoryRequirements2(
+	VkDevice device, const VkBufferMemoryRequirementsInfo2 *pInfo,
+	VkMemoryRequirements2 *pMemoryRequirements)
+{
+	(void)(device);
+	(void)(pInfo);
+	(void)(pMemoryRequirements);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetImageMemoryRequirements(
+	VkDevice device, VkImage image,
+	VkMemoryRequirements *pMemoryRequirements)
+{
+	(void)(device);
+	(void)(image);
+	(void)(pMemoryRequirements);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetImageMemoryRequirements2(
+	VkDevice device, const VkImageMemoryRequirementsInfo2 *pInfo,
+	VkMemoryRequirements2 *pMemoryRequirements)
+{
+	(void)(device);
+	(void)(pInfo);
+	(void)(pMemoryRequirements);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkBindBufferMemory(VkDevice device,
+						  VkBuffer buffer,
+						  VkDeviceMemory memory,
+						  VkDeviceSize memoryOffset)
+{
+	(void)(device);
+	(void)(buffer);
+	(void)(memory);
+	(void)(memoryOffset);
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkBindImageMemory(VkDevice device,
+						 VkImage image,
+						 VkDeviceMemory memory,
+						 VkDeviceSize memoryOffset)
+{
+	(void)(device);
+	(void)(image);
+	(void)(memory);
+	(void)(memoryOffset);
+	return VK_SUCCESS;
+}
+
+/**
+ * Returns next pseudo-random number
+ * @param state Specifies state of xorshift generator
+ * @returns pseudo-random number
+ */
+static uint64_t next_random(uint64_t *state)
+{
+	uint64_t x = *state;
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+	*state = x;
+	return x;
+}
+
+int main(int argc, char **argv)
+{
+	const unsigned long nops = (argc > 1) ? strtoul(argv[1], NULL, 10) :
+						 NOPS;
+	static struct vkmemory_alloc allocs[NSLOTS];
+	static int alive[NSLOTS];
+	struct vkmemory mem;
+	struct vkmemory_stats stats;
+	uint64_t state = 0x9E3779B97F4A7C15ULL;
+	unsigned long nallocs = 0;
+	unsigned long nfrees = 0;
+	VkDeviceSize peak = 0;
+	vkmemory_init(&mem, VK_NULL_HANDLE, VK_NULL_HANDLE, NULL);
+	const uint64_t start = vkclock_ns();
+	for (unsigned long i = 0; i < nops; ++i) {
+		const uint64_t random = next_random(&state);
+		const uint32_t slot = (uint32_t)(random % NSLOTS);
+		if (alive[slot]) {
+			vkmemory_free(&mem, &allocs[slot]);
+			alive[slot] = 0;
+			nfrees++;
+			continue;
+		}
+		/* Sizes are log-uniform from 256 bytes to just under 4 MiB */
+		const uint32_t log = 8 + (uint32_t)((random >> 16) % 14);
+		struct vkmemory_request req = {
+			.reqs = {
+				.size = ((VkDeviceSize)1 << log) +
+					((random >> 24) & ((1U << log) - 1)),
+				.alignment = (VkDeviceSize)1
+					     << (4 + (random >> 48) % 5),
+				.memoryTypeBits = 1,
+			},
+			.required = 0,
+			.preferred = 0,
+			.kind = (random >> 56) & 1 ? VKMEMORY_OPTIMAL :
+						     VKMEMORY_LINEAR,
+			.dedicated = 0,
+			.buffer = VK_NULL_HANDLE,
+			.image = VK_NULL_HANDLE,
+		};
+		if (vkmemory_alloc(&mem, &req, &allocs[slot]) != VK_SUCCESS) {
+			fprintf(stderr, "allocation %lu failed\n", i);
+			return EXIT_FAILURE;
+		}
+		alive[slot] = 1;
+		nallocs++;
+		if (mem.heaps[0].allocated > peak)
+			peak = mem.heaps[0].allocated;
+	}
+	const uint64_t elapsed = vkclock_ns() - start;
+	vkmemory_stats(&mem, 0, &stats);
+	const double fragmentation = stats.free ?
+		1.0 - (double)stats.largest_free / (double)stats.free : 0.0;
+	printf("%lu allocs, %lu frees in %.3f s, %.1f ns/op\n", nallocs,
+	       nfrees, (double)elapsed / 1e9,
+	       nops ? (double)elapsed / (double)nops : 0.0);
+	printf("%u allocations in %u device allocations (%lu made)\n",
+	       stats.nallocs, stats.nblocks, nallocations);
+	printf("used %llu of %llu bytes, peak %llu bytes\n",
+	       (unsigned long long)stats.used,
+	       (unsigned long long)stats.allocated,
+	       (unsigned long long)peak);
+	printf("%u free ranges, fragmentation %.1f%%\n", stats.nfree,
+	       fragmentation * 100.0);
+	for (uint32_t i = 0; i < NSLOTS; ++i) {
+		if (alive[i])
+			vkmemory_free(&mem, &allocs[i]);
+	}
+	vkmemory_destroy(&mem);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,619 @@
+/**
+ * @file
+ * Test suite for vkmemory
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdint.h>
+#include <string.h>
+
+#include <cgreen/cgreen.h>
+#include <cgreen/mocks.h>
+
+#include <vulkan/vulkan_core.h>
+#include "vkmemory.h"
+
+/** One mebibyte */
+#define MiB ((VkDeviceSize)1024 * 1024)
+
+/** Memory type in device local heap */
+#define DEVICE_TYPE 0
+
+/** Host visible memory type in host heap */
+#define HOST_TYPE 1
+
+/** Host visible and cached memory type in host heap */
+#define CACHED_TYPE 2
+
+/** Host address device memory is mapped to */
+static char mapped_memory[64];
+
+/** Properties reported by physical device */
+static VkPhysicalDeviceProperties device_props;
+
+/** Memory properties reported by physical device */
+static VkPhysicalDeviceMemoryProperties memory_props;
+
+/** Memory requirements reported for resources */
+static VkMemoryRequirements resource_reqs;
+
+/** Non-zero if resources prefer dedicated allocation */
+static VkBool32 prefers_dedicated;
+
+/** Bit mask of memory types the device is out of */
+static uint32_t exhausted_types;
+
+/** Number of device memory allocations made */
+static uint32_t nallocations;
+
+/** Size of the last device memory allocation */
+static VkDeviceSize allocation_size;
+
+/** Buffer of the last dedicated allocation */
+static VkBuffer dedicated_buffer;
+
+/** Host memory allocator passed to the last device memory allocation */
+static const VkAllocationCallbacks *allocator;
+
+VKAPI_ATTR void VKAPI_CALL
+vkGetPhysicalDeviceProperties(VkPhysicalDevice physicalDevice,
+			      VkPhysicalDeviceProperties *pProperties)
+{
+	(void)(physicalDevice);
+	*pProperties = device_props;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceMemoryProperties(
+	VkPhysicalDevice physicalDevice,
+	VkPhysicalDeviceMemoryProperties *pMemoryProperties)
+{
+	(void)(physicalDevice);
+	*pMemoryProperties = memory_props;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkAllocateMemory(VkDevice device, const VkMemoryAllocateInfo *pAllocateInfo,
+		 const VkAllocationCallbacks *pAllocator,
+		 VkDeviceMemory *pMemory)
+{
+	(void)(device);
+	allocator = pAllocator;
+	if (exhausted_types & (UINT32_C(1) << pAllocateInfo->memoryTypeIndex))
+		return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+	const VkMemoryDedicatedAllocateInfo *dedicated = pAllocateInfo->pNext;
+	dedicated_buffer = dedicated ? dedicated->buffer : VK_NULL_HANDLE;
+	allocation_size = pAllocateInfo->allocationSize;
+	*pMemory = (VkDeviceMemory)(uintptr_t)(++nallocations);
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkFreeMemory(VkDevice device, VkDeviceMemory memory,
+					const VkAllocationCallbacks *pAllocator)
+{
+	mock(device, memory, pAllocator);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkMapMemory(VkDevice device,
+					   VkDeviceMemory memory,
+					   VkDeviceSize offset,
+					   VkDeviceSize size,
+					   VkMemoryMapFlags flags,
+					   void **ppData)
+{
+	*ppData = mapped_memory;
+	return (VkResult)mock(device, memory, offset, size, flags, ppData);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetBufferMemoryRequirements(
+	VkDevice device, VkBuffer buffer,
+	VkMemoryRequirements *pMemoryRequirements)
+{
+	(void)(device);
+	(void)(buffer);
+	*pMemoryRequirements = resource_reqs;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetBufferMemoryRequirements2(
+	VkDevice device, const VkBufferMemoryRequirementsInfo2 *pInfo,
+	VkMemoryRequirements2 *pMemoryRequirements)
+{
+	(void)(device);
+	(void)(pInfo);
+	VkMemoryDedicatedRequirements *dedicated = pMemoryRequirements->pNext;
+	pMemoryRequirements->memoryRequirements = resource_reqs;
+	dedicated->prefersDedicatedAllocation = prefers_dedicated;
+	dedicated->requiresDedicatedAllocation = VK_FALSE;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetImageMemoryRequirements(
+	VkDevice device, VkImage image,
+	VkMemoryRequirements *pMemoryRequirements)
+{
+	(void)(device);
+	(void)(image);
+	*pMemoryRequirements = resource_reqs;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetImageMemoryRequirements2(
+	VkDevice device, const VkImageMemoryRequirementsInfo2 *pInfo,
+	VkMemoryRequirements2 *pMemoryRequirements)
+{
+	(void)(device);
+	(void)(pInfo);
+	VkMemoryDedicatedRequirements *dedicated = pMemoryRequirements->pNext;
+	pMemoryRequirements->memoryRequirements = resource_reqs;
+	dedicated->prefersDedicatedAllocation = prefers_dedicated;
+	dedicated->requiresDedicatedAllocation = VK_FALSE;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkBindBufferMemory(VkDevice device,
+						  VkBuffer buffer,
+						  VkDeviceMemory memory,
+						  VkDeviceSize memoryOffset)
+{
+	return (VkResult)mock(device, buffer, memory, memoryOffset);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkBindImageMemory(VkDevice device,
+						 VkImage image,
+						 VkDeviceMemory memory,
+						 VkDeviceSize memoryOffset)
+{
+	return (VkResult)mock(device, image, memory, memoryOffset);
+}
+
+/**
+ * Initializes allocator for device with 8 GiB local heap and 256 MiB host
+ * heap
+ * @param mem Specifies allocator to initialize
+ * @param version Specifies Vulkan version supported by device
+ * @param granularity Specifies bufferImageGranularity of device
+ */
+static void init_memory(struct vkmemory *mem, uint32_t version,
+			VkDeviceSize granularity)
+{
+	memset(&device_props, 0, sizeof(device_props));
+	memset(&memory_props, 0, sizeof(memory_props));
+	memset(&resource_reqs, 0, sizeof(resource_reqs));
+	prefers_dedicated = VK_FALSE;
+	exhausted_types = 0;
+	nallocations = 0;
+	allocation_size = 0;
+	dedicated_buffer = VK_NULL_HANDLE;
+	allocator = NULL;
+	device_props.apiVersion = version;
+	device_props.limits.bufferImageGranularity = granularity;
+	memory_props.memoryHeapCount = 2;
+	memory_props.memoryHeaps[0].size = 8192 * MiB;
+	memory_props.memoryHeaps[0].flags = VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+	memory_props.memoryHeaps[1].size = 256 * MiB;
+	memory_props.memoryHeaps[1].flags = 0;
+	memory_props.memoryTypeCount = 3;
+	memory_props.memoryTypes[DEVICE_TYPE].propertyFlags =
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+	memory_props.memoryTypes[DEVICE_TYPE].heapIndex = 0;
+	memory_props.memoryTypes[HOST_TYPE].propertyFlags =
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+		VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	memory_props.memoryTypes[HOST_TYPE].heapIndex = 1;
+	memory_props.memoryTypes[CACHED_TYPE].propertyFlags =
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+		VK_MEMORY_PROPERTY_HOST_COHERENT_BIT |
+		VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+	memory_props.memoryTypes[CACHED_TYPE].heapIndex = 1;
+	vkmemory_init(mem, VK_NULL_HANDLE, VK_NULL_HANDLE, NULL);
+}
+
+/**
+ * Makes request of memory
+ * @param req Specifies request to make
+ * @param types Specifies bit mask of memory types allowed
+ * @param size Specifies size of memory
+ * @param alignment Specifies alignment of memory
+ */
+static void make_request(struct vkmemory_request *req, uint32_t types,
+			 VkDeviceSize size, VkDeviceSize alignment)
+{
+	memset(req, 0, sizeof(*req));
+	req->reqs.size = size;
+	req->reqs.alignment = alignment;
+	req->reqs.memoryTypeBits = types;
+	req->kind = VKMEMORY_LINEAR;
+}
+
+Ensure(init_sizes_blocks_by_heap)
+{
+	struct vkmemory mem;
+	init_memory(&mem, VK_API_VERSION_1_0, 1);
+	assert_that(mem.heaps[0].block_size, is_equal_to(VKMEMORY_BLOCK_SIZE));
+	assert_that(mem.heaps[1].block_size, is_equal_to(32 * MiB));
+	vkmemory_destroy(&mem);
+}
+
+Ensure(alloc_prefers_type_with_most_preferred_properties)
+{
+	struct vkmemory mem;
+	struct vkmemory_request req;
+	struct vkmemory_alloc alloc;
+	always_expect(vkMapMemory, will_return(VK_SUCCESS));
+	init_memory(&mem, VK_API_VERSION_1_0, 1);
+	make_request(&req, 0x7, 1024, 16);
+	req.required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+	req.preferred = VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+	VkResult result = vkmemory_alloc(&mem, &req, &alloc);
+	assert_that(result, is_equal_to(VK_SUCCESS));
+	assert_that(alloc.type, is_equal_to(CACHED_TYPE));
+	always_expect(vkFreeMemory);
+	vkmemory_destroy(&mem);
+}
+
+Ensure(alloc_fails_without_required_properties)
+{
+	struct vkmemory mem;
+	struct vkmemory_request req;
+	struct vkmemory_alloc alloc;
+	init_memory(&mem, VK_API_VERSION_1_0, 1);
+	make_request(&req, 1U << DEVICE_TYPE, 1024, 16);
+	req.required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+	VkResult result = vkmemory_alloc(&mem, &req, &alloc);
+	assert_that(result, is_equal_to(VK_ERROR_FEATURE_NOT_PRESENT));
+	assert_that(nallocations, is_equal_to(0));
+	vkmemory_destroy(&mem);
+}
+
+Ensure(allocations_share_block)
+{
+	struct vkmemory mem;
+	struct vkmemory_request req;
+	struct vkmemory_alloc first;
+	struct vkmemory_alloc second;
+	init_memory(&mem, VK_API_VERSION_1_0, 1);
+	make_request(&req, 1U << DEVICE_TYPE, 1024, 16);
+	vkmemory_alloc(&mem, &req, &first);
+	vkmemory_alloc(&mem, &req, &second);
+	assert_that(nallocations, is_equal_to(1));
+	assert_that(allocation_size, is_equal_to(VKMEMORY_BLOCK_SIZE));
+	assert_that(second.memory, is_equal_to(first.memory));
+	assert_that(first.offset, is_equal_to(0));
+	assert_that(second.offset, is_equal_to(1024));
+	always_expect(vkFreeMemory);
+	vkmemory_destroy(&mem);
+}
+
+Ensure(blocks_use_host_allocator_of_driver)
+{
+	struct vkmemory mem;
+	struct vkmemory_request req;
+	struct vkmemory_alloc alloc;
+	const VkAllocationCallbacks host = { 0 };
+	init_memory(&mem, VK_API_VERSION_1_0, 1);
+	mem.host = &host;
+	make_request(&req, 1U << DEVICE_TYPE, 1024, 16);
+	vkmemory_alloc(&mem, &req, &alloc);
+	assert_that(allocator, is_equal_to(&host));
+	expect(vkFreeMemory, when(pAllocator, is_equal_to(&host)));
+	vkmemory_destroy(&mem);
+}
+
+Ensure(alloc_aligns_offset)
+{
+	struct vkmemory mem;
+	struct vkmemory_request req;
+	struct vkmemory_alloc first;
+	struct vkmemory_alloc second;
+	init_memory(&mem, VK_API_VERSION_1_0, 1);
+	make_request(&req, 1U << DEVICE_TYPE, 100, 1);
+	vkmemory_alloc(&mem, &req, &first);
+	make_request(&req, 1U << DEVICE_TYPE, 512, 256);
+	vkmemory_alloc(&mem, &req, &second);
+	assert_that(second.offset, is_equal_to(256));
+	assert_that(second.size, is_equal_to(512));
+	always_expect(vkFreeMemory);
+	vkmemory_destroy(&mem);
+}
+
+Ensure(optimal_image_owns_granularity_pages)
+{
+	struct vkmemory mem;
+	struct vkmemory_request req;
+	struct vkmemory_alloc linear;
+	struct vkmemory_alloc optimal;
+	struct vkmemory_alloc next;
+	init_memory(&mem, VK_API_VERSION_1_0, 4096);
+	make_request(&req, 1U << DEVICE_TYPE, 100, 16);
+	vkmemory_alloc(&mem, &req, &linear);
+	req.kind = VKMEMORY_OPTIMAL;
+	vkmemory_alloc(&mem, &req, &optimal);
+	req.kind = VKMEMORY_LINEAR;
+	vkmemory_alloc(&mem, &req, &next);
+	assert_that(optimal.offset, is_equal_to(4096));
+	assert_that(optimal.size, is_equal_to(4096));
+	assert_that(next.offset + next.size <= optimal.offset ||
+		    next.offset >= optimal.offset + optimal.size, is_true);
+	always_expect(vkFreeMemory);
+	vkmemory_destroy(&mem);
+}
+
+Ensure(large_resource_gets_dedicated_memory)
+{
+	struct vkmemory mem;
+	struct vkmemory_request req;
+	struct vkmemory_alloc alloc;
+	init_memory(&mem, VK_API_VERSION_1_0, 1);
+	make_request(&req, 1U << DEVICE_TYPE, 200 * MiB, 256);
+	VkResult result = vkmemory_alloc(&mem, &req, &alloc);
+	assert_that(result, is_equal_to(VK_SUCCESS));
+	assert_that(alloc.range, is_equal_to(VKMEMORY_NONE));
+	assert_that(alloc.offset, is_equal_to(0));
+	assert_that(allocation_size, is_equal_to(200 * MiB));
+	expect(vkFreeMemory, when(memory, is_equal_to(alloc.memory)));
+	vkmemory_free(&mem, &alloc);
+	assert_that(mem.heaps[0].allocated, is_equal_to(0));
+	vkmemory_destroy(&mem);
+}
+
+Ensure(buffer_preferring_dedicated_memory_gets_it)
+{
+	struct vkmemory mem;
+	struct vkmemory_alloc alloc;
+	const VkBuffer buffer = (VkBuffer)42;
+	init_memory(&mem, VK_API_VERSION_1_1, 1);
+	resource_reqs.size = 1024;
+	resource_reqs.alignment = 16;
+	resource_reqs.memoryTypeBits = 1U << DEVICE_TYPE;
+	prefers_dedicated = VK_TRUE;
+	expect(vkBindBufferMemory, when(buffer, is_equal_to(buffer)),
+	       when(memoryOffset, is_equal_to(0)), will_return(VK_SUCCESS));
+	VkResult result = vkmemory_alloc_buffer(&mem, buffer, 0, 0, &alloc);
+	assert_that(result, is_equal_to(VK_SUCCESS));
+	assert_that(alloc.range, is_equal_to(VKMEMORY_NONE));
+	assert_that(allocation_size, is_equal_to(1024));
+	assert_that(dedicated_buffer, is_equal_to(buffer));
+	vkmemory_destroy(&mem);
+}
+
+Ensure(alloc_buffer_frees_memory_if_bind_fails)
+{
+	struct vkmemory mem;
+	struct vkmemory_alloc alloc;
+	init_memory(&mem, VK_API_VERSION_1_0, 1);
+	resource_reqs.size = 1024;
+	resource_reqs.alignment = 16;
+	resource_reqs.memoryTypeBits = 1U << DEVICE_TYPE;
+	expect(vkBindBufferMemory,
+	       will_return(VK_ERROR_OUT_OF_DEVICE_MEMORY));
+	VkResult result = vkmemory_alloc_buffer(&mem, (VkBuffer)42, 0, 0,
+						&alloc);
+	assert_that(result, is_equal_to(VK_ERROR_OUT_OF_DEVICE_MEMORY));
+	assert_that(mem.heaps[0].used, is_equal_to(0));
+	assert_that(mem.heaps[0].nallocs, is_equal_to(0));
+	always_expect(vkFreeMemory);
+	vkmemory_destroy(&mem);
+}
+
+Ensure(alloc_image_pads_optimal_tiling)
+{
+	struct vkmemory mem;
+	struct vkmemory_alloc alloc;
+	init_memory(&mem, VK_API_VERSION_1_0, 1024);
+	resource_reqs.size = 100;
+	resource_reqs.alignment = 256;
+	resource_reqs.memoryTypeBits = 1U << DEVICE_TYPE;
+	expect(vkBindImageMemory, will_return(VK_SUCCESS));
+	vkmemory_alloc_image(&mem, (VkImage)42, VK_IMAGE_TILING_OPTIMAL, 0, 0,
+			     &alloc);
+	assert_that(alloc.size, is_equal_to(1024));
+	always_expect(vkFreeMemory);
+	vkmemory_destroy(&mem);
+}
+
+Ensure(free_merges_neighbours)
+{
+	struct vkmemory mem;
+	struct vkmemory_request req;
+	struct vkmemory_alloc allocs[3];
+	struct vkmemory_alloc merged;
+	init_memory(&mem, VK_API_VERSION_1_0, 1);
+	make_request(&req, 1U << DEVICE_TYPE, 1024, 16);
+	for (int i = 0; i < 3; ++i) {
+		vkmemory_alloc(&mem, &req, &allocs[i]);
+	}
+	vkmemory_free(&mem, &allocs[0]);
+	vkmemory_free(&mem, &allocs[1]);
+	make_request(&req, 1U << DEVICE_TYPE, 2048, 1);
+	vkmemory_alloc(&mem, &req, &merged);
+	assert_that(merged.offset, is_equal_to(0));
+	always_expect(vkFreeMemory);
+	vkmemory_destroy(&mem);
+}
+
+Ensure(free_keeps_one_empty_block)
+{
+	struct vkmemory mem;
+	struct vkmemory_request req;
+	struct vkmemory_alloc allocs[3];
+	always_expect(vkMapMemory, will_return(VK_SUCCESS));
+	init_memory(&mem, VK_API_VERSION_1_0, 1);
+	make_request(&req, 1U << HOST_TYPE, 12 * MiB, 16);
+	for (int i = 0; i < 3; ++i) {
+		vkmemory_alloc(&mem, &req, &allocs[i]);
+	}
+	assert_that(nallocations, is_equal_to(2));
+	vkmemory_free(&mem, &allocs[2]);
+	assert_that(mem.heaps[1].nblocks, is_equal_to(2));
+	expect(vkFreeMemory, when(memory, is_equal_to(allocs[0].memory)));
+	vkmemory_free(&mem, &allocs[0]);
+	vkmemory_free(&mem, &allocs[1]);
+	assert_that(mem.heaps[1].nblocks, is_equal_to(1));
+	assert_that(mem.heaps[1].allocated, is_equal_to(32 * MiB));
+	expect(vkFreeMemory, when(memory, is_equal_to(allocs[2].memory)));
+	vkmemory_destroy(&mem);
+}
+
+Ensure(host_visible_block_is_mapped)
+{
+	struct vkmemory mem;
+	struct vkmemory_request req;
+	struct vkmemory_alloc first;
+	struct vkmemory_alloc second;
+	expect(vkMapMemory, when(offset, is_equal_to(0)),
+	       when(size, is_equal_to(VK_WHOLE_SIZE)), will_return(VK_SUCCESS));
+	init_memory(&mem, VK_API_VERSION_1_0, 1);
+	make_request(&req, 1U << HOST_TYPE, 16, 16);
+	vkmemory_alloc(&mem, &req, &first);
+	vkmemory_alloc(&mem, &req, &second);
+	assert_that(first.mapped, is_equal_to(mapped_memory));
+	assert_that(second.mapped, is_equal_to(mapped_memory + 16));
+	always_expect(vkFreeMemory);
+	vkmemory_destroy(&mem);
+}
+
+Ensure(alloc_falls_back_to_next_type_when_out_of_memory)
+{
+	struct vkmemory mem;
+	struct vkmemory_request req;
+	struct vkmemory_alloc alloc;
+	always_expect(vkMapMemory, will_return(VK_SUCCESS));
+	init_memory(&mem, VK_API_VERSION_1_0, 1);
+	exhausted_types = 1U << CACHED_TYPE;
+	make_request(&req, 0x7, 1024, 16);
+	req.required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+	req.preferred = VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+	VkResult result = vkmemory_alloc(&mem, &req, &alloc);
+	assert_that(result, is_equal_to(VK_SUCCESS));
+	assert_that(alloc.type, is_equal_to(HOST_TYPE));
+	always_expect(vkFreeMemory);
+	vkmemory_destroy(&mem);
+}
+
+Ensure(stats_report_free_ranges)
+{
+	struct vkmemory mem;
+	struct vkmemory_request req;
+	struct vkmemory_alloc allocs[3];
+	struct vkmemory_stats stats;
+	init_memory(&mem, VK_API_VERSION_1_0, 1);
+	make_request(&req, 1U << DEVICE_TYPE, 1024, 16);
+	for (int i = 0; i < 3; ++i) {
+		vkmemory_alloc(&mem, &req, &allocs[i]);
+	}
+	vkmemory_free(&mem, &allocs[1]);
+	vkmemory_stats(&mem, 0, &stats);
+	assert_that(stats.allocated, is_equal_to(VKMEMORY_BLOCK_SIZE));
+	assert_that(stats.used, is_equal_to(2048));
+	assert_that(stats.free, is_equal_to(VKMEMORY_BLOCK_SIZE - 2048));
+	assert_that(stats.largest_free,
+		    is_equal_to(VKMEMORY_BLOCK_SIZE - 3072));
+	assert_that(stats.nblocks, is_equal_to(1));
+	assert_that(stats.nallocs, is_equal_to(2));
+	assert_that(stats.nfree, is_equal_to(2));
+	always_expect(vkFreeMemory);
+	vkmemory_destroy(&mem);
+}
+
+Ensure(compact_alloc_never_adds_block)
+{
+	struct vkmemory mem;
+	struct vkmemory_request req;
+	struct vkmemory_alloc alloc;
+	init_memory(&mem, VK_API_VERSION_1_0, 1);
+	make_request(&req, 1U << DEVICE_TYPE, 1024, 16);
+	req.compact = 1;
+	VkResult result = vkmemory_alloc(&mem, &req, &alloc);
+	assert_that(result, is_equal_to(VK_ERROR_OUT_OF_DEVICE_MEMORY));
+	assert_that(nallocations, is_equal_to(0));
+	vkmemory_destroy(&mem);
+}
+
+Ensure(evacuated_block_is_not_allocated_from)
+{
+	struct vkmemory mem;
+	struct vkmemory_request req;
+	struct vkmemory_alloc allocs[3];
+	struct vkmemory_alloc alloc;
+	always_expect(vkMapMemory, will_return(VK_SUCCESS));
+	init_memory(&mem, VK_API_VERSION_1_0, 1);
+	make_request(&req, 1U << HOST_TYPE, 12 * MiB, 16);
+	for (int i = 0; i < 3; ++i) {
+		vkmemory_alloc(&mem, &req, &allocs[i]);
+	}
+	const struct vkmemory_pool *pool = mem.pools[HOST_TYPE];
+	const uint32_t block = pool->ranges[allocs[0].range].block;
+	vkmemory_evacuate(&mem, HOST_TYPE, block);
+	make_request(&req, 1U << HOST_TYPE, 16 * MiB, 16);
+	req.compact = 1;
+	vkmemory_alloc(&mem, &req, &alloc);
+	assert_that(alloc.memory, is_equal_to(allocs[2].memory));
+	make_request(&req, 1U << HOST_TYPE, 6 * MiB, 16);
+	req.compact = 1;
+	VkResult result = vkmemory_alloc(&mem, &req, &alloc);
+	assert_that(result, is_equal_to(VK_ERROR_OUT_OF_DEVICE_MEMORY));
+	vkmemory_settle(&mem, HOST_TYPE);
+	result = vkmemory_alloc(&mem, &req, &alloc);
+	assert_that(result, is_equal_to(VK_SUCCESS));
+	assert_that(alloc.memory, is_equal_to(allocs[0].memory));
+	always_expect(vkFreeMemory);
+	vkmemory_destroy(&mem);
+}
+
+Ensure(evacuation_ends_when_block_is_empty)
+{
+	struct vkmemory mem;
+	struct vkmemory_request req;
+	struct vkmemory_alloc allocs[3];
+	struct vkmemory_stats stats;
+	always_expect(vkMapMemory, will_return(VK_SUCCESS));
+	init_memory(&mem, VK_API_VERSION_1_0, 1);
+	make_request(&req, 1U << HOST_TYPE, 12 * MiB, 16);
+	for (int i = 0; i < 3; ++i) {
+		vkmemory_alloc(&mem, &req, &allocs[i]);
+	}
+	const struct vkmemory_pool *pool = mem.pools[HOST_TYPE];
+	vkmemory_evacuate(&mem, HOST_TYPE, pool->ranges[allocs[0].range].block);
+	vkmemory_stats(&mem, 1, &stats);
+	assert_that(stats.free, is_equal_to(28 * MiB));
+	assert_that(stats.nfree, is_equal_to(2));
+	vkmemory_free(&mem, &allocs[0]);
+	vkmemory_stats(&mem, 1, &stats);
+	assert_that(stats.free, is_equal_to(40 * MiB));
+	assert_that(stats.largest_free, is_equal_to(20 * MiB));
+	vkmemory_free(&mem, &allocs[1]);
+	assert_that(pool->evacuating, is_equal_to(VKMEMORY_NONE));
+	vkmemory_stats(&mem, 1, &stats);
+	assert_that(stats.free, is_equal_to(52 * MiB));
+	always_expect(vkFreeMemory);
+	vkmemory_destroy(&mem);
+}
+
+int main(int argc, char **argv)
+{
+	(void)(argc);
+	(void)(argv);
+	TestSuite *suite = create_named_test_suite("VKMemory");
+	add_test(suite, init_sizes_blocks_by_heap);
+	add_test(suite, alloc_prefers_type_with_most_preferred_properties);
+	add_test(suite, alloc_fails_without_required_properties);
+	add_test(suite, allocations_share_block);
+	add_test(suite, blocks_use_host_allocator_of_driver);
+	add_test(suite, alloc_aligns_offset);
+	add_test(suite, optimal_image_owns_granularity_pages);
+	add_test(suite, large_resource_gets_dedicated_memory);
+	add_test(suite, buffer_preferring_dedicated_memory_gets_it);
+	add_test(suite, alloc_buffer_frees_memory_if_bind_fails);
+	add_test(suite, alloc_image_pads_optimal_tiling);
+	add_test(suite, free_merges_neighbours);
+	add_test(suite, free_keeps_one_empty_block);
+	add_test(suite, host_visible_block_is_mapped);
+	add_test(suite, alloc_falls_back_to_next_type_when_out_of_memory);
+	add_test(suite, stats_report_free_ranges);
+	add_test(suite, compact_alloc_never_adds_block);
+	add_test(suite, evacuated_block_is_not_allocated_from);
+	add_test(suite, evacuation_ends_when_block_is_empty);
+	TestReporter *reporter = create_text_reporter();
+	int exit_code = run_test_suite(suite, reporter);
+	destroy_reporter(reporter);
+	destroy_test_suite(suite);
+	return exit_code;
+}
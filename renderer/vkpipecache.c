@@ -0,0 +1,214 @@
+/**
+ * @file
+ * Persistent pipeline cache implementation
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "vkclock.h"
+#include "vkpipecache.h"
+#include <vulkan/vulkan_core.h>
+
+/**
+ * Maps cache file into memory
+ * @param cache Specifies cache to store mapping in
+ * @param path Specifies path to cache file
+ * @returns zero on success, or non-zero otherwise
+ */
+static int vkpipecache_map(struct vkpipecache *cache, const char *path)
+{
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -1;
+	struct stat st;
+	void *mapped = MAP_FAILED;
+	if (fstat(fd, &st) == 0 && st.st_size > 0)
+		mapped = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE,
+			      fd, 0);
+	/* Mapping stays valid after descriptor is closed */
+	close(fd);
+	if (mapped == MAP_FAILED)
+		return -1;
+	cache->mapped = mapped;
+	cache->mapped_size = (size_t)st.st_size;
+	return 0;
+}
+
+/**
+ * Unmaps cache file
+ * @param cache Specifies cache to unmap file of
+ */
+static void vkpipecache_unmap(struct vkpipecache *cache)
+{
+	if (cache->mapped != NULL)
+		munmap(cache->mapped, cache->mapped_size);
+	cache->mapped = NULL;
+	cache->mapped_size = 0;
+}
+
+/**
+ * Checks if mapped data was written by the same device and driver
+ * @param cache Specifies cache with mapped data
+ * @returns non-zero if data is usable, or zero otherwise
+ */
+static int vkpipecache_valid(const struct vkpipecache *cache)
+{
+	VkPipelineCacheHeaderVersionOne header;
+	if (cache->mapped_size < sizeof(header))
+		return 0;
+	memcpy(&header, cache->mapped, sizeof(header));
+	return header.headerSize >= sizeof(header) &&
+	       header.headerSize <= cache->mapped_size &&
+	       header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+	       header.vendorID == cache->vendor_id &&
+	       header.deviceID == cache->device_id &&
+	       !memcmp(header.pipelineCacheUUID, cache->uuid, VK_UUID_SIZE);
+}
+
+/**
+ * Creates pipeline cache
+ * @param cache Specifies cache to create
+ * @param data Specifies initial data, or NULL
+ * @param size Specifies size of @a data
+ * @returns VK_SUCCESS on success, or VkResult error otherwise
+ */
+static VkResult vkpipecache_create(struct vkpipecache *cache,
+				   const void *data, size_t size)
+{
+	const VkPipelineCacheCreateInfo info = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+		.pNext = NULL,
+		.flags = 0,
+		.initialDataSize = size,
+		.pInitialData = data,
+	};
+	return vkCreatePipelineCache(cache->dev, &info, cache->host,
+				     &cache->cache);
+}
+
+VkResult vkpipecache_init(struct vkpipecache *cache, VkPhysicalDevice phy,
+			  VkDevice dev, const char *path,
+			  const VkAllocationCallbacks *host)
+{
+	const uint64_t start = vkclock_ns();
+	VkPhysicalDeviceProperties props;
+	vkGetPhysicalDeviceProperties(phy, &props);
+	cache->dev = dev;
+	cache->host = host;
+	cache->cache = VK_NULL_HANDLE;
+	cache->vendor_id = props.vendorID;
+	cache->device_id = props.deviceID;
+	memcpy(cache->uuid, props.pipelineCacheUUID, VK_UUID_SIZE);
+	cache->mapped = NULL;
+	cache->mapped_size = 0;
+	cache->source = VKPIPECACHE_COLD;
+	cache->nsaved = 0;
+	cache->nmerged = 0;
+	if (path != NULL && vkpipecache_map(cache, path) == 0) {
+		cache->source = VKPIPECACHE_WARM;
+		if (!vkpipecache_valid(cache)) {
+			cache->source = VKPIPECACHE_REJECTED;
+			vkpipecache_unmap(cache);
+		}
+	}
+	VkResult result =
+		vkpipecache_create(cache, cache->mapped, cache->mapped_size);
+	if (result != VK_SUCCESS && cache->mapped != NULL) {
+		/* Driver may still refuse data passing header check */
+		cache->source = VKPIPECACHE_REJECTED;
+		vkpipecache_unmap(cache);
+		result = vkpipecache_create(cache, NULL, 0);
+	}
+	if (result != VK_SUCCESS)
+		vkpipecache_unmap(cache);
+	cache->load_ns = vkclock_ns() - start;
+	return result;
+}
+
+VkResult vkpipecache_merge(struct vkpipecache *cache,
+			   const VkPipelineCache *srcs, uint32_t count)
+{
+	if (count == 0)
+		return VK_SUCCESS;
+	VkResult result =
+		vkMergePipelineCaches(cache->dev, cache->cache, count, srcs);
+	if (result == VK_SUCCESS)
+		cache->nmerged += count;
+	return result;
+}
+
+/**
+ * Writes data to file atomically
+ * @param path Specifies path to file
+ * @param data Specifies data to write
+ * @param size Specifies size of @a data
+ * @returns zero on success, or non-zero otherwise
+ */
+static int vkpipecache_write(const char *path, const void *data, size_t size)
+{
+	static const char suffix[] = ".tmp";
+	char *tmp = malloc(strlen(path) + sizeof(suffix));
+	if (tmp == NULL)
+		return -1;
+	strcpy(tmp, path);
+	strcat(tmp, suffix);
+	FILE *file = fopen(tmp, "wb");
+	if (file == NULL) {
+		free(tmp);
+		return -1;
+	}
+	int written = fwrite(data, size, 1, file) == 1;
+	if (fclose(file) || !written || rename(tmp, path)) {
+		remove(tmp);
+		free(tmp);
+		return -1;
+	}
+	free(tmp);
+	return 0;
+}
+
+int vkpipecache_save(struct vkpipecache *cache, const char *path)
+{
+	size_t size = 0;
+	cache->nsaved = 0;
+	if (vkGetPipelineCacheData(cache->dev, cache->cache, &size, NULL) !=
+		    VK_SUCCESS ||
+	    size == 0)
+		return -1;
+	void *data = malloc(size);
+	if (data == NULL)
+		return -1;
+	int result = -1;
+	if (vkGetPipelineCacheData(cache->dev, cache->cache, &size, data) !=
+	    VK_SUCCESS)
+		goto free_data;
+	/* Nothing was compiled since load, file is up to date */
+	if (size == cache->mapped_size && !memcmp(data, cache->mapped, size)) {
+		result = 0;
+		goto free_data;
+	}
+	result = vkpipecache_write(path, data, size);
+	if (result == 0)
+		cache->nsaved = size;
+free_data:
+	free(data);
+	return result;
+}
+
+void vkpipecache_destroy(struct vkpipecache *cache)
+{
+	vkDestroyPipelineCache(cache->dev, cache->cache, cache->host);
+	cache->cache = VK_NULL_HANDLE;
+	vkpipecache_unmap(cache);
+}
@@ -0,0 +1,108 @@
+#ifndef RENDERER_VKPIPECACHE_H
+#define RENDERER_VKPIPECACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vulkan/vulkan_core.h>
+
+/** Where pipeline cache got its initial data from */
+enum vkpipecache_source {
+	/** No cache file, pipelines are compiled cold */
+	VKPIPECACHE_COLD = 0,
+	/** Cache file of the same device and driver was loaded */
+	VKPIPECACHE_WARM,
+	/** Cache file was written by other device or driver, or is damaged */
+	VKPIPECACHE_REJECTED,
+};
+
+/**
+ * Pipeline cache persisted in file between launches
+ *
+ * Cache file is mapped into memory at init, so its data is handed to driver
+ * without copying. File is used only if its header names the same vendor,
+ * device and pipeline cache UUID as device reports, since drivers may
+ * crash on foreign data. Mapping is kept until cache is destroyed, so
+ * unchanged data is not written back.
+ */
+struct vkpipecache {
+	/** Device the cache is created on */
+	VkDevice dev;
+	/** Host memory allocator of driver, or NULL */
+	const VkAllocationCallbacks *host;
+	/** Cache passed to every pipeline creation */
+	VkPipelineCache cache;
+	/** Vendor of device */
+	uint32_t vendor_id;
+	/** Device identifier within vendor */
+	uint32_t device_id;
+	/** Identifier of pipeline cache data layout of driver */
+	uint8_t uuid[VK_UUID_SIZE];
+	/** Mapped cache file, or NULL if none is mapped */
+	void *mapped;
+	/** Size of @a mapped */
+	size_t mapped_size;
+	/** Where initial data came from */
+	enum vkpipecache_source source;
+	/** Nanoseconds spent loading cache file and creating cache */
+	uint64_t load_ns;
+	/** Number of bytes written by the last save, zero if unchanged */
+	size_t nsaved;
+	/** Number of caches merged into this one */
+	uint64_t nmerged;
+};
+
+#ifdef __cplusplus
+/* *INDENT-OFF* */
+extern "C" {
+/* *INDENT-ON* */
+#endif
+
+/**
+ * Initializes pipeline cache, loading it from file if it is valid
+ *
+ * Missing or rejected file leaves the cache empty, it is not an error.
+ * @param cache Specifies cache to initialize
+ * @param phy Specifies physical device of @a dev
+ * @param dev Specifies device to create cache on
+ * @param path Specifies path to cache file, or NULL to start empty
+ * @param host Specifies host memory allocator of driver, or NULL
+ * @returns VK_SUCCESS on success, or VkResult error otherwise
+ */
+VkResult vkpipecache_init(struct vkpipecache *cache, VkPhysicalDevice phy,
+			  VkDevice dev, const char *path,
+			  const VkAllocationCallbacks *host);
+
+/**
+ * Merges caches, such as ones used by compiling threads, into cache
+ * @param cache Specifies cache to merge into
+ * @param srcs Specifies caches to merge
+ * @param count Specifies number of elements in @a srcs
+ * @returns VK_SUCCESS on success, or VkResult error otherwise
+ */
+VkResult vkpipecache_merge(struct vkpipecache *cache,
+			   const VkPipelineCache *srcs, uint32_t count);
+
+/**
+ * Saves cache data to file
+ *
+ * File is replaced atomically, so concurrent launches never read partially
+ * written cache. Data equal to the loaded one is not written.
+ * @param cache Specifies cache to save
+ * @param path Specifies path to cache file
+ * @returns zero on success, or non-zero otherwise
+ */
+int vkpipecache_save(struct vkpipecache *cache, const char *path);
+
+/**
+ * Destroys pipeline cache and unmaps cache file
+ * @param cache Specifies cache to destroy
+ */
+void vkpipecache_destroy(struct vkpipecache *cache);
+
+#ifdef __cplusplus
+/* *INDENT-OFF* */
+}
+/* *INDENT-ON* */
+#endif
+#endif
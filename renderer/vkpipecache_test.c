@@ -0,0 +1,349 @@
+/**
+ * @file
+ * Test suite for vkpipecache
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cgreen/cgreen.h>
+#include <cgreen/mocks.h>
+
+#include <vulkan/vulkan_core.h>
+#include "vkpipecache.h"
+
+/** Path of cache file used by tests */
+#define CACHE_PATH "vkpipecache_test.cache"
+
+/** Size of data after header in cache files of tests */
+#define PAYLOAD_SIZE 64
+
+/** Cache file contents, header followed by payload */
+struct cache_file {
+	/** Header identifying device */
+	VkPipelineCacheHeaderVersionOne header;
+	/** Compiled pipelines */
+	uint8_t payload[PAYLOAD_SIZE];
+};
+
+/** Initial data passed to the last vkCreatePipelineCache */
+static struct cache_file initial;
+
+/** Size of initial data passed to the last vkCreatePipelineCache */
+static size_t initial_size;
+
+/** Data returned by vkGetPipelineCacheData */
+static struct cache_file current;
+
+VKAPI_ATTR void VKAPI_CALL
+vkGetPhysicalDeviceProperties(VkPhysicalDevice physicalDevice,
+			      VkPhysicalDeviceProperties *pProperties)
+{
+	pProperties->vendorID = 0x10DE;
+	pProperties->deviceID = 0x2204;
+	memset(pProperties->pipelineCacheUUID, 0xAB, VK_UUID_SIZE);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkCreatePipelineCache(VkDevice device,
+		      const VkPipelineCacheCreateInfo *pCreateInfo,
+		      const VkAllocationCallbacks *pAllocator,
+		      VkPipelineCache *pPipelineCache)
+{
+	initial_size = pCreateInfo->initialDataSize;
+	if (initial_size > 0)
+		memcpy(&initial, pCreateInfo->pInitialData,
+		       (initial_size < sizeof(initial)) ? initial_size :
+							  sizeof(initial));
+	*pPipelineCache = (VkPipelineCache)1;
+	return (VkResult)mock(device, pCreateInfo, pAllocator,
+			      pPipelineCache);
+}
+
+VKAPI_ATTR void VKAPI_CALL
+vkDestroyPipelineCache(VkDevice device, VkPipelineCache pipelineCache,
+		       const VkAllocationCallbacks *pAllocator)
+{
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkGetPipelineCacheData(VkDevice device, VkPipelineCache pipelineCache,
+		       size_t *pDataSize, void *pData)
+{
+	if (pData != NULL)
+		memcpy(pData, &current, sizeof(current));
+	*pDataSize = sizeof(current);
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkMergePipelineCaches(VkDevice device, VkPipelineCache dstCache,
+		      uint32_t srcCacheCount, const VkPipelineCache *pSrcCaches)
+{
+	return (VkResult)mock(device, dstCache, srcCacheCount, pSrcCaches);
+}
+
+/**
+ * Fills cache file contents of device reported by tests
+ * @param file Specifies contents to fill
+ * @param fill Specifies byte payload is filled with
+ */
+static void make_file(struct cache_file *file, uint8_t fill)
+{
+	memset(file, 0, sizeof(*file));
+	file->header.headerSize = sizeof(file->header);
+	file->header.headerVersion = VK_PIPELINE_CACHE_HEADER_VERSION_ONE;
+	file->header.vendorID = 0x10DE;
+	file->header.deviceID = 0x2204;
+	memset(file->header.pipelineCacheUUID, 0xAB, VK_UUID_SIZE);
+	memset(file->payload, fill, PAYLOAD_SIZE);
+}
+
+/**
+ * Writes cache file contents to CACHE_PATH
+ * @param file Specifies contents to write
+ */
+static void write_file(const struct cache_file *file)
+{
+	FILE *out = fopen(CACHE_PATH, "wb");
+	fwrite(file, sizeof(*file), 1, out);
+	fclose(out);
+}
+
+/**
+ * Reads cache file contents from CACHE_PATH
+ * @param file Specifies where to store contents
+ * @returns zero on success, or non-zero otherwise
+ */
+static int read_file(struct cache_file *file)
+{
+	FILE *in = fopen(CACHE_PATH, "rb");
+	if (in == NULL)
+		return -1;
+	int result = fread(file, sizeof(*file), 1, in) == 1 ? 0 : -1;
+	fclose(in);
+	return result;
+}
+
+/**
+ * Resets state shared by tests
+ */
+static void reset(void)
+{
+	remove(CACHE_PATH);
+	memset(&initial, 0, sizeof(initial));
+	initial_size = 0;
+	make_file(&current, 0x11);
+}
+
+Ensure(init_starts_cold_without_file)
+{
+	struct vkpipecache cache;
+	reset();
+	expect(vkCreatePipelineCache, will_return(VK_SUCCESS));
+	VkResult result = vkpipecache_init(&cache, VK_NULL_HANDLE,
+					   VK_NULL_HANDLE, CACHE_PATH, NULL);
+	assert_that(result, is_equal_to(VK_SUCCESS));
+	assert_that(cache.source, is_equal_to(VKPIPECACHE_COLD));
+	assert_that(initial_size, is_equal_to(0));
+	vkpipecache_destroy(&cache);
+}
+
+Ensure(init_loads_file_of_same_device)
+{
+	struct vkpipecache cache;
+	struct cache_file file;
+	reset();
+	make_file(&file, 0x22);
+	write_file(&file);
+	expect(vkCreatePipelineCache, will_return(VK_SUCCESS));
+	vkpipecache_init(&cache, VK_NULL_HANDLE, VK_NULL_HANDLE, CACHE_PATH,
+			 NULL);
+	assert_that(cache.source, is_equal_to(VKPIPECACHE_WARM));
+	assert_that(initial_size, is_equal_to(sizeof(file)));
+	assert_that(initial.payload[0], is_equal_to(0x22));
+	vkpipecache_destroy(&cache);
+	assert_that(cache.mapped, is_null);
+}
+
+Ensure(init_rejects_file_of_other_device)
+{
+	struct vkpipecache cache;
+	struct cache_file file;
+	reset();
+	make_file(&file, 0x22);
+	file.header.deviceID = 0x2684;
+	write_file(&file);
+	expect(vkCreatePipelineCache, will_return(VK_SUCCESS));
+	vkpipecache_init(&cache, VK_NULL_HANDLE, VK_NULL_HANDLE, CACHE_PATH,
+			 NULL);
+	assert_that(cache.source, is_equal_to(VKPIPECACHE_REJECTED));
+	assert_that(initial_size, is_equal_to(0));
+	vkpipecache_destroy(&cache);
+}
+
+Ensure(init_rejects_file_of_other_driver)
+{
+	struct vkpipecache cache;
+	struct cache_file file;
+	reset();
+	make_file(&file, 0x22);
+	file.header.pipelineCacheUUID[VK_UUID_SIZE - 1] = 0;
+	write_file(&file);
+	expect(vkCreatePipelineCache, will_return(VK_SUCCESS));
+	vkpipecache_init(&cache, VK_NULL_HANDLE, VK_NULL_HANDLE, CACHE_PATH,
+			 NULL);
+	assert_that(cache.source, is_equal_to(VKPIPECACHE_REJECTED));
+	assert_that(initial_size, is_equal_to(0));
+	vkpipecache_destroy(&cache);
+}
+
+Ensure(init_rejects_truncated_file)
+{
+	struct vkpipecache cache;
+	reset();
+	FILE *out = fopen(CACHE_PATH, "wb");
+	fwrite("TDX", 3, 1, out);
+	fclose(out);
+	expect(vkCreatePipelineCache, will_return(VK_SUCCESS));
+	vkpipecache_init(&cache, VK_NULL_HANDLE, VK_NULL_HANDLE, CACHE_PATH,
+			 NULL);
+	assert_that(cache.source, is_equal_to(VKPIPECACHE_REJECTED));
+	assert_that(initial_size, is_equal_to(0));
+	vkpipecache_destroy(&cache);
+}
+
+Ensure(init_retries_empty_when_driver_refuses_data)
+{
+	struct vkpipecache cache;
+	struct cache_file file;
+	reset();
+	make_file(&file, 0x22);
+	write_file(&file);
+	expect(vkCreatePipelineCache,
+	       will_return(VK_ERROR_INITIALIZATION_FAILED));
+	expect(vkCreatePipelineCache, will_return(VK_SUCCESS));
+	VkResult result = vkpipecache_init(&cache, VK_NULL_HANDLE,
+					   VK_NULL_HANDLE, CACHE_PATH, NULL);
+	assert_that(result, is_equal_to(VK_SUCCESS));
+	assert_that(cache.source, is_equal_to(VKPIPECACHE_REJECTED));
+	assert_that(initial_size, is_equal_to(0));
+	assert_that(cache.mapped, is_null);
+	vkpipecache_destroy(&cache);
+}
+
+Ensure(init_returns_error_on_create_fail)
+{
+	struct vkpipecache cache;
+	reset();
+	expect(vkCreatePipelineCache, will_return(VK_ERROR_OUT_OF_HOST_MEMORY));
+	VkResult result = vkpipecache_init(&cache, VK_NULL_HANDLE,
+					   VK_NULL_HANDLE, NULL, NULL);
+	assert_that(result, is_equal_to(VK_ERROR_OUT_OF_HOST_MEMORY));
+}
+
+Ensure(save_writes_cache_data)
+{
+	struct vkpipecache cache;
+	struct cache_file file;
+	reset();
+	expect(vkCreatePipelineCache, will_return(VK_SUCCESS));
+	vkpipecache_init(&cache, VK_NULL_HANDLE, VK_NULL_HANDLE, CACHE_PATH,
+			 NULL);
+	assert_that(vkpipecache_save(&cache, CACHE_PATH), is_equal_to(0));
+	assert_that(cache.nsaved, is_equal_to(sizeof(current)));
+	assert_that(read_file(&file), is_equal_to(0));
+	assert_that(file.payload[0], is_equal_to(0x11));
+	vkpipecache_destroy(&cache);
+	remove(CACHE_PATH);
+}
+
+Ensure(save_skips_unchanged_data)
+{
+	struct vkpipecache cache;
+	reset();
+	write_file(&current);
+	expect(vkCreatePipelineCache, will_return(VK_SUCCESS));
+	vkpipecache_init(&cache, VK_NULL_HANDLE, VK_NULL_HANDLE, CACHE_PATH,
+			 NULL);
+	assert_that(vkpipecache_save(&cache, CACHE_PATH), is_equal_to(0));
+	assert_that(cache.nsaved, is_equal_to(0));
+	vkpipecache_destroy(&cache);
+	remove(CACHE_PATH);
+}
+
+Ensure(save_replaces_loaded_file)
+{
+	struct vkpipecache cache;
+	struct cache_file file;
+	reset();
+	make_file(&file, 0x22);
+	write_file(&file);
+	expect(vkCreatePipelineCache, will_return(VK_SUCCESS));
+	vkpipecache_init(&cache, VK_NULL_HANDLE, VK_NULL_HANDLE, CACHE_PATH,
+			 NULL);
+	assert_that(vkpipecache_save(&cache, CACHE_PATH), is_equal_to(0));
+	assert_that(read_file(&file), is_equal_to(0));
+	assert_that(file.payload[0], is_equal_to(0x11));
+	/* Loaded data stays mapped while file is replaced */
+	const struct cache_file *mapped = cache.mapped;
+	assert_that(mapped->payload[0], is_equal_to(0x22));
+	vkpipecache_destroy(&cache);
+	remove(CACHE_PATH);
+}
+
+Ensure(save_fails_on_unwritable_path)
+{
+	struct vkpipecache cache;
+	reset();
+	expect(vkCreatePipelineCache, will_return(VK_SUCCESS));
+	vkpipecache_init(&cache, VK_NULL_HANDLE, VK_NULL_HANDLE, NULL, NULL);
+	int result = vkpipecache_save(&cache, "no-such-dir/" CACHE_PATH);
+	assert_that(result, is_not_equal_to(0));
+	vkpipecache_destroy(&cache);
+}
+
+Ensure(merge_counts_merged_caches)
+{
+	struct vkpipecache cache;
+	const VkPipelineCache srcs[2] = { (VkPipelineCache)2,
+					  (VkPipelineCache)3 };
+	reset();
+	expect(vkCreatePipelineCache, will_return(VK_SUCCESS));
+	vkpipecache_init(&cache, VK_NULL_HANDLE, VK_NULL_HANDLE, NULL, NULL);
+	expect(vkMergePipelineCaches, when(srcCacheCount, is_equal_to(2)),
+	       will_return(VK_SUCCESS));
+	VkResult result = vkpipecache_merge(&cache, srcs, 2);
+	assert_that(result, is_equal_to(VK_SUCCESS));
+	assert_that(cache.nmerged, is_equal_to(2));
+	vkpipecache_destroy(&cache);
+}
+
+int main(int argc, char **argv)
+{
+	(void)(argc);
+	(void)(argv);
+	TestSuite *suite = create_named_test_suite("VKPipeCache");
+	add_test(suite, init_starts_cold_without_file);
+	add_test(suite, init_loads_file_of_same_device);
+	add_test(suite, init_rejects_file_of_other_device);
+	add_test(suite, init_rejects_file_of_other_driver);
+	add_test(suite, init_rejects_truncated_file);
+	add_test(suite, init_retries_empty_when_driver_refuses_data);
+	add_test(suite, init_returns_error_on_create_fail);
+	add_test(suite, save_writes_cache_data);
+	add_test(suite, save_skips_unchanged_data);
+	add_test(suite, save_replaces_loaded_file);
+	add_test(suite, save_fails_on_unwritable_path);
+	add_test(suite, merge_counts_merged_caches);
+	TestReporter *reporter = create_text_reporter();
+	int exit_code = run_test_suite(suite, reporter);
+	destroy_reporter(reporter);
+	destroy_test_suite(suite);
+	return exit_code;
+}
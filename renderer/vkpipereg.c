@@ -0,0 +1,919 @@
+/**
+ * @file
+ * Registry of pipelines deduplicated by description
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "vkcompiler.h"
+#include "vkpipereg.h"
+#include "vkrpcache.h"
+#include <vulkan/vulkan_core.h>
+
+/** Offset basis of FNV-1a hash */
+#define VKPIPEREG_BASIS 0xCBF29CE484222325ULL
+
+/** First word of key of description serialized field by field */
+#define VKPIPEREG_CANONICAL 0
+
+/** First word of key of description extended by unknown structures */
+#define VKPIPEREG_OPAQUE 1
+
+/** Number of bytes of key built without allocating memory */
+#define VKPIPEREG_LOCAL_KEY 512
+
+/** Canonical description of pipeline being built */
+struct vkpipereg_key {
+	/** Bytes of key, @a local or allocated memory */
+	unsigned char *data;
+	/** Number of bytes written */
+	size_t size;
+	/** Number of bytes @a data can hold */
+	size_t capacity;
+	/** Non-zero if memory ran out while writing */
+	int failed;
+	/** Non-zero if description has structures key can't describe */
+	int opaque;
+	/** Memory of keys short enough */
+	unsigned char local[VKPIPEREG_LOCAL_KEY];
+};
+
+/**
+ * Initializes empty key
+ * @param key Specifies key to initialize
+ */
+static void vkpipereg_key_init(struct vkpipereg_key *key)
+{
+	key->data = key->local;
+	key->size = 0;
+	key->capacity = sizeof(key->local);
+	key->failed = 0;
+	key->opaque = 0;
+}
+
+/**
+ * Frees memory allocated by key
+ * @param key Specifies key to release
+ */
+static void vkpipereg_key_release(struct vkpipereg_key *key)
+{
+	if (key->data != key->local)
+		free(key->data);
+}
+
+/**
+ * Enlarges key to hold more bytes
+ * @param key Specifies key to enlarge
+ * @param size Specifies number of bytes to append
+ * @returns zero on success, or non-zero otherwise
+ */
+static int vkpipereg_reserve(struct vkpipereg_key *key, size_t size)
+{
+	if (key->failed)
+		return -1;
+	size_t capacity = key->capacity * 2;
+	while (capacity < key->size + size)
+		capacity *= 2;
+	unsigned char *data = key->data == key->local ?
+		malloc(capacity) : realloc(key->data, capacity);
+	if (data == NULL) {
+		key->failed = 1;
+		return -1;
+	}
+	if (key->data == key->local)
+		memcpy(data, key->local, key->size);
+	key->data = data;
+	key->capacity = capacity;
+	return 0;
+}
+
+/**
+ * Appends bytes to key
+ * @param key Specifies key to append bytes to
+ * @param data Specifies bytes to append, or NULL if @a size is zero
+ * @param size Specifies number of bytes
+ */
+static void vkpipereg_write(struct vkpipereg_key *key, const void *data,
+			    size_t size)
+{
+	if (size == 0)
+		return;
+	if (key->size + size > key->capacity && vkpipereg_reserve(key, size))
+		return;
+	memcpy(key->data + key->size, data, size);
+	key->size += size;
+}
+
+/**
+ * Appends 32-bit value to key
+ * @param key Specifies key to append value to
+ * @param value Specifies value to append
+ */
+static void vkpipereg_write32(struct vkpipereg_key *key, uint32_t value)
+{
+	vkpipereg_write(key, &value, sizeof(value));
+}
+
+/**
+ * Appends 64-bit value to key
+ * @param key Specifies key to append value to
+ * @param value Specifies value to append
+ */
+static void vkpipereg_write64(struct vkpipereg_key *key, uint64_t value)
+{
+	vkpipereg_write(key, &value, sizeof(value));
+}
+
+/**
+ * Appends float to key by its bits
+ * @param key Specifies key to append value to
+ * @param value Specifies value to append
+ */
+static void vkpipereg_write_float(struct vkpipereg_key *key, float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	vkpipereg_write32(key, bits);
+}
+
+/**
+ * Marks key opaque if state is extended by any structure
+ *
+ * Extension structures change pipeline in ways key does not describe.
+ * @param key Specifies key of description
+ * @param next Specifies chain of structures extending state, or NULL
+ */
+static void vkpipereg_check_chain(struct vkpipereg_key *key, const void *next)
+{
+	if (next != NULL)
+		key->opaque = 1;
+}
+
+/**
+ * Computes FNV-1a hash of bytes
+ * @param data Specifies bytes to hash
+ * @param size Specifies number of bytes
+ * @returns hash of bytes
+ */
+static uint64_t vkpipereg_hash(const unsigned char *data, size_t size)
+{
+	uint64_t hash = VKPIPEREG_BASIS;
+	for (size_t i = 0; i < size; ++i) {
+		hash ^= data[i];
+		hash *= 0x100000001B3ULL;
+	}
+	return hash;
+}
+
+/**
+ * Checks if state of pipeline is set by command instead of description
+ * @param info Specifies description of pipeline
+ * @param state Specifies state to check
+ * @returns non-zero if state is dynamic, or zero otherwise
+ */
+static int vkpipereg_dynamic(const VkGraphicsPipelineCreateInfo *info,
+			     VkDynamicState state)
+{
+	const VkPipelineDynamicStateCreateInfo *dyn = info->pDynamicState;
+	for (uint32_t i = 0; dyn != NULL && i < dyn->dynamicStateCount; ++i) {
+		if (dyn->pDynamicStates[i] == state)
+			return 1;
+	}
+	return 0;
+}
+
+/**
+ * Checks if pipeline has tessellation shaders
+ * @param info Specifies description of pipeline
+ * @returns non-zero if primitives are tessellated, or zero otherwise
+ */
+static int vkpipereg_tessellated(const VkGraphicsPipelineCreateInfo *info)
+{
+	const VkShaderStageFlags tessellation =
+		VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT |
+		VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+	for (uint32_t i = 0; i < info->stageCount; ++i) {
+		if (info->pStages[i].stage & tessellation)
+			return 1;
+	}
+	return 0;
+}
+
+/**
+ * Checks if pipeline discards primitives before rasterization
+ *
+ * Viewport, multisample, depth stencil and color blend states of such
+ * pipeline are ignored, and may point to anything.
+ * @param info Specifies description of pipeline
+ * @returns non-zero if rasterization is discarded, or zero otherwise
+ */
+static int vkpipereg_discards(const VkGraphicsPipelineCreateInfo *info)
+{
+	const VkPipelineRasterizationStateCreateInfo *rs =
+		info->pRasterizationState;
+	return rs != NULL && rs->rasterizerDiscardEnable &&
+	       !vkpipereg_dynamic(info,
+				  VK_DYNAMIC_STATE_RASTERIZER_DISCARD_ENABLE);
+}
+
+/**
+ * Appends shader stage with its entry point and specialization data
+ * @param key Specifies key to append stage to
+ * @param stage Specifies stage to append
+ */
+static void vkpipereg_write_stage(struct vkpipereg_key *key,
+				  const VkPipelineShaderStageCreateInfo *stage)
+{
+	vkpipereg_write32(key, (uint32_t)stage->flags);
+	vkpipereg_write32(key, (uint32_t)stage->stage);
+	/* Module code is not visible, callers share modules of equal code */
+	/* Handles are pointers or integers depending on platform */
+	vkpipereg_write(key, &stage->module, sizeof(stage->module));
+	/* Code may be chained instead of module, which is then null */
+	const VkBaseInStructure *next = stage->pNext;
+	for (; next != NULL; next = next->pNext) {
+		const VkStructureType type = next->sType;
+		if (type != VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO) {
+			key->opaque = 1;
+			continue;
+		}
+		const VkShaderModuleCreateInfo *code =
+			(const VkShaderModuleCreateInfo *)next;
+		vkpipereg_write32(key, 1);
+		vkpipereg_check_chain(key, code->pNext);
+		vkpipereg_write32(key, (uint32_t)code->flags);
+		vkpipereg_write64(key, (uint64_t)code->codeSize);
+		vkpipereg_write(key, code->pCode, code->codeSize);
+	}
+	vkpipereg_write32(key, 0);
+	const size_t length = strlen(stage->pName);
+	vkpipereg_write64(key, (uint64_t)length);
+	vkpipereg_write(key, stage->pName, length);
+	const VkSpecializationInfo *spec = stage->pSpecializationInfo;
+	vkpipereg_write32(key, spec != NULL);
+	if (spec == NULL)
+		return;
+	vkpipereg_write32(key, spec->mapEntryCount);
+	for (uint32_t i = 0; i < spec->mapEntryCount; ++i) {
+		const VkSpecializationMapEntry *entry = &spec->pMapEntries[i];
+		vkpipereg_write32(key, entry->constantID);
+		vkpipereg_write32(key, entry->offset);
+		vkpipereg_write64(key, (uint64_t)entry->size);
+	}
+	vkpipereg_write64(key, (uint64_t)spec->dataSize);
+	vkpipereg_write(key, spec->pData, spec->dataSize);
+}
+
+/**
+ * Checks if stage goes before other one in key
+ * @param stages Specifies stages of pipeline
+ * @param a Specifies index of stage
+ * @param b Specifies index of other stage
+ * @returns non-zero if stage @a a goes first, or zero otherwise
+ */
+static int vkpipereg_stage_before(const VkPipelineShaderStageCreateInfo *stages,
+				  uint32_t a, uint32_t b)
+{
+	if (stages[a].stage != stages[b].stage)
+		return stages[a].stage < stages[b].stage;
+	return a < b;
+}
+
+/**
+ * Appends shader stages ordered by stage they implement
+ * @param key Specifies key to append stages to
+ * @param info Specifies description of pipeline
+ */
+static void vkpipereg_write_stages(struct vkpipereg_key *key,
+				   const VkGraphicsPipelineCreateInfo *info)
+{
+	const VkPipelineShaderStageCreateInfo *stages = info->pStages;
+	vkpipereg_write32(key, info->stageCount);
+	/* Pipelines have a few stages, so selecting the next one is cheap */
+	uint32_t prev = UINT32_MAX;
+	for (uint32_t n = 0; n < info->stageCount; ++n) {
+		uint32_t next = UINT32_MAX;
+		for (uint32_t i = 0; i < info->stageCount; ++i) {
+			if (prev != UINT32_MAX &&
+			    !vkpipereg_stage_before(stages, prev, i))
+				continue;
+			if (next == UINT32_MAX ||
+			    vkpipereg_stage_before(stages, i, next))
+				next = i;
+		}
+		vkpipereg_write_stage(key, &stages[next]);
+		prev = next;
+	}
+}
+
+/**
+ * Appends vertex layout to key
+ * @param key Specifies key to append layout to
+ * @param input Specifies vertex input state, or NULL
+ */
+static void
+vkpipereg_write_vertex(struct vkpipereg_key *key,
+		       const VkPipelineVertexInputStateCreateInfo *input)
+{
+	vkpipereg_write32(key, input != NULL);
+	if (input == NULL)
+		return;
+	vkpipereg_check_chain(key, input->pNext);
+	vkpipereg_write32(key, input->vertexBindingDescriptionCount);
+	for (uint32_t i = 0; i < input->vertexBindingDescriptionCount; ++i) {
+		const VkVertexInputBindingDescription *binding =
+			&input->pVertexBindingDescriptions[i];
+		vkpipereg_write32(key, binding->binding);
+		vkpipereg_write32(key, binding->stride);
+		vkpipereg_write32(key, (uint32_t)binding->inputRate);
+	}
+	vkpipereg_write32(key, input->vertexAttributeDescriptionCount);
+	for (uint32_t i = 0; i < input->vertexAttributeDescriptionCount; ++i) {
+		const VkVertexInputAttributeDescription *attr =
+			&input->pVertexAttributeDescriptions[i];
+		vkpipereg_write32(key, attr->location);
+		vkpipereg_write32(key, attr->binding);
+		vkpipereg_write32(key, (uint32_t)attr->format);
+		vkpipereg_write32(key, attr->offset);
+	}
+}
+
+/**
+ * Appends viewports and scissors set by description to key
+ * @param key Specifies key to append state to
+ * @param info Specifies description of pipeline
+ * @param vp Specifies viewport state, or NULL if it is ignored
+ */
+static void
+vkpipereg_write_viewport(struct vkpipereg_key *key,
+			 const VkGraphicsPipelineCreateInfo *info,
+			 const VkPipelineViewportStateCreateInfo *vp)
+{
+	vkpipereg_write32(key, vp != NULL);
+	if (vp == NULL)
+		return;
+	vkpipereg_check_chain(key, vp->pNext);
+	/* Pointers of dynamic viewports and scissors may be invalid */
+	const int viewports = !vkpipereg_dynamic(
+		info, VK_DYNAMIC_STATE_VIEWPORT_WITH_COUNT);
+	const int scissors = !vkpipereg_dynamic(
+		info, VK_DYNAMIC_STATE_SCISSOR_WITH_COUNT);
+	if (viewports)
+		vkpipereg_write32(key, vp->viewportCount);
+	if (scissors)
+		vkpipereg_write32(key, vp->scissorCount);
+	for (uint32_t i = 0;
+	     viewports && !vkpipereg_dynamic(info, VK_DYNAMIC_STATE_VIEWPORT) &&
+	     i < vp->viewportCount;
+	     ++i) {
+		const VkViewport *v = &vp->pViewports[i];
+		vkpipereg_write_float(key, v->x);
+		vkpipereg_write_float(key, v->y);
+		vkpipereg_write_float(key, v->width);
+		vkpipereg_write_float(key, v->height);
+		vkpipereg_write_float(key, v->minDepth);
+		vkpipereg_write_float(key, v->maxDepth);
+	}
+	for (uint32_t i = 0;
+	     scissors && !vkpipereg_dynamic(info, VK_DYNAMIC_STATE_SCISSOR) &&
+	     i < vp->scissorCount;
+	     ++i) {
+		const VkRect2D *s = &vp->pScissors[i];
+		vkpipereg_write32(key, (uint32_t)s->offset.x);
+		vkpipereg_write32(key, (uint32_t)s->offset.y);
+		vkpipereg_write32(key, s->extent.width);
+		vkpipereg_write32(key, s->extent.height);
+	}
+}
+
+/**
+ * Appends primitive assembly, tessellation and viewport state to key
+ * @param key Specifies key to append state to
+ * @param info Specifies description of pipeline
+ * @param discard Specifies if rasterization is discarded
+ */
+static void vkpipereg_write_geometry(struct vkpipereg_key *key,
+				     const VkGraphicsPipelineCreateInfo *info,
+				     int discard)
+{
+	const VkPipelineInputAssemblyStateCreateInfo *ia =
+		info->pInputAssemblyState;
+	vkpipereg_write32(key, ia != NULL);
+	if (ia != NULL) {
+		vkpipereg_check_chain(key, ia->pNext);
+		vkpipereg_write32(key, (uint32_t)ia->topology);
+		vkpipereg_write32(key, ia->primitiveRestartEnable);
+	}
+	/* Tessellation state is ignored without tessellation shaders */
+	const VkPipelineTessellationStateCreateInfo *ts =
+		vkpipereg_tessellated(info) ? info->pTessellationState : NULL;
+	vkpipereg_write32(key, ts != NULL ? ts->patchControlPoints : 0);
+	if (ts != NULL)
+		vkpipereg_check_chain(key, ts->pNext);
+	vkpipereg_write_viewport(key, info,
+				 discard ? NULL : info->pViewportState);
+}
+
+/**
+ * Appends rasterization and multisample state to key
+ * @param key Specifies key to append state to
+ * @param info Specifies description of pipeline
+ * @param discard Specifies if rasterization is discarded
+ */
+static void vkpipereg_write_raster(struct vkpipereg_key *key,
+				   const VkGraphicsPipelineCreateInfo *info,
+				   int discard)
+{
+	const VkPipelineRasterizationStateCreateInfo *rs =
+		info->pRasterizationState;
+	vkpipereg_write32(key, rs != NULL);
+	if (rs != NULL) {
+		vkpipereg_check_chain(key, rs->pNext);
+		vkpipereg_write32(key, rs->depthClampEnable);
+		vkpipereg_write32(key, rs->rasterizerDiscardEnable);
+		vkpipereg_write32(key, (uint32_t)rs->polygonMode);
+		vkpipereg_write32(key, (uint32_t)rs->cullMode);
+		vkpipereg_write32(key, (uint32_t)rs->frontFace);
+		vkpipereg_write32(key, rs->depthBiasEnable);
+		if (!vkpipereg_dynamic(info, VK_DYNAMIC_STATE_DEPTH_BIAS)) {
+			vkpipereg_write_float(key, rs->depthBiasConstantFactor);
+			vkpipereg_write_float(key, rs->depthBiasClamp);
+			vkpipereg_write_float(key, rs->depthBiasSlopeFactor);
+		}
+		if (!vkpipereg_dynamic(info, VK_DYNAMIC_STATE_LINE_WIDTH))
+			vkpipereg_write_float(key, rs->lineWidth);
+	}
+	const VkPipelineMultisampleStateCreateInfo *ms =
+		discard ? NULL : info->pMultisampleState;
+	vkpipereg_write32(key, ms != NULL);
+	if (ms == NULL)
+		return;
+	vkpipereg_check_chain(key, ms->pNext);
+	vkpipereg_write32(key, (uint32_t)ms->rasterizationSamples);
+	vkpipereg_write32(key, ms->sampleShadingEnable);
+	vkpipereg_write_float(key, ms->minSampleShading);
+	vkpipereg_write32(key, ms->alphaToCoverageEnable);
+	vkpipereg_write32(key, ms->alphaToOneEnable);
+	vkpipereg_write32(key, ms->pSampleMask != NULL);
+	if (ms->pSampleMask == NULL)
+		return;
+	/* Sample mask has one bit per sample, in 32-bit words */
+	const uint32_t nwords = ((uint32_t)ms->rasterizationSamples + 31) / 32;
+	for (uint32_t i = 0; i < nwords; ++i) {
+		vkpipereg_write32(key, ms->pSampleMask[i]);
+	}
+}
+
+/**
+ * Appends stencil operations to key
+ * @param key Specifies key to append operations to
+ * @param info Specifies description of pipeline
+ * @param op Specifies stencil operations of one face
+ */
+static void vkpipereg_write_stencil(struct vkpipereg_key *key,
+				    const VkGraphicsPipelineCreateInfo *info,
+				    const VkStencilOpState *op)
+{
+	vkpipereg_write32(key, (uint32_t)op->failOp);
+	vkpipereg_write32(key, (uint32_t)op->passOp);
+	vkpipereg_write32(key, (uint32_t)op->depthFailOp);
+	vkpipereg_write32(key, (uint32_t)op->compareOp);
+	if (!vkpipereg_dynamic(info, VK_DYNAMIC_STATE_STENCIL_COMPARE_MASK))
+		vkpipereg_write32(key, op->compareMask);
+	if (!vkpipereg_dynamic(info, VK_DYNAMIC_STATE_STENCIL_WRITE_MASK))
+		vkpipereg_write32(key, op->writeMask);
+	if (!vkpipereg_dynamic(info, VK_DYNAMIC_STATE_STENCIL_REFERENCE))
+		vkpipereg_write32(key, op->reference);
+}
+
+/**
+ * Appends depth and stencil state to key
+ * @param key Specifies key to append state to
+ * @param info Specifies description of pipeline
+ * @param ds Specifies depth stencil state, or NULL if it is ignored
+ */
+static void
+vkpipereg_write_depth(struct vkpipereg_key *key,
+		      const VkGraphicsPipelineCreateInfo *info,
+		      const VkPipelineDepthStencilStateCreateInfo *ds)
+{
+	vkpipereg_write32(key, ds != NULL);
+	if (ds == NULL)
+		return;
+	vkpipereg_check_chain(key, ds->pNext);
+	vkpipereg_write32(key, ds->depthTestEnable);
+	vkpipereg_write32(key, ds->depthWriteEnable);
+	vkpipereg_write32(key, (uint32_t)ds->depthCompareOp);
+	vkpipereg_write32(key, ds->depthBoundsTestEnable);
+	vkpipereg_write32(key, ds->stencilTestEnable);
+	vkpipereg_write_stencil(key, info, &ds->front);
+	vkpipereg_write_stencil(key, info, &ds->back);
+	if (vkpipereg_dynamic(info, VK_DYNAMIC_STATE_DEPTH_BOUNDS))
+		return;
+	vkpipereg_write_float(key, ds->minDepthBounds);
+	vkpipereg_write_float(key, ds->maxDepthBounds);
+}
+
+/**
+ * Appends color blend state to key
+ * @param key Specifies key to append state to
+ * @param info Specifies description of pipeline
+ * @param cb Specifies color blend state, or NULL if it is ignored
+ */
+static void
+vkpipereg_write_blend(struct vkpipereg_key *key,
+		      const VkGraphicsPipelineCreateInfo *info,
+		      const VkPipelineColorBlendStateCreateInfo *cb)
+{
+	vkpipereg_write32(key, cb != NULL);
+	if (cb == NULL)
+		return;
+	vkpipereg_check_chain(key, cb->pNext);
+	vkpipereg_write32(key, cb->logicOpEnable);
+	vkpipereg_write32(key, (uint32_t)cb->logicOp);
+	vkpipereg_write32(key, cb->attachmentCount);
+	for (uint32_t i = 0; i < cb->attachmentCount; ++i) {
+		const VkPipelineColorBlendAttachmentState *att =
+			&cb->pAttachments[i];
+		vkpipereg_write32(key, att->blendEnable);
+		vkpipereg_write32(key, (uint32_t)att->srcColorBlendFactor);
+		vkpipereg_write32(key, (uint32_t)att->dstColorBlendFactor);
+		vkpipereg_write32(key, (uint32_t)att->colorBlendOp);
+		vkpipereg_write32(key, (uint32_t)att->srcAlphaBlendFactor);
+		vkpipereg_write32(key, (uint32_t)att->dstAlphaBlendFactor);
+		vkpipereg_write32(key, (uint32_t)att->alphaBlendOp);
+		vkpipereg_write32(key, (uint32_t)att->colorWriteMask);
+	}
+	if (vkpipereg_dynamic(info, VK_DYNAMIC_STATE_BLEND_CONSTANTS))
+		return;
+	for (size_t i = 0; i < 4; ++i) {
+		vkpipereg_write_float(key, cb->blendConstants[i]);
+	}
+}
+
+/**
+ * Appends dynamic states to key in ascending order
+ * @param key Specifies key to append states to
+ * @param dyn Specifies dynamic state, or NULL
+ */
+static void vkpipereg_write_dynamic(struct vkpipereg_key *key,
+				    const VkPipelineDynamicStateCreateInfo *dyn)
+{
+	const uint32_t count = dyn != NULL ? dyn->dynamicStateCount : 0;
+	if (dyn != NULL)
+		vkpipereg_check_chain(key, dyn->pNext);
+	vkpipereg_write32(key, count);
+	const size_t start = key->size;
+	for (uint32_t i = 0; i < count; ++i) {
+		vkpipereg_write32(key, (uint32_t)dyn->pDynamicStates[i]);
+	}
+	if (key->failed)
+		return;
+	/* Sorted in place by insertion, lists of states are short */
+	unsigned char *states = key->data + start;
+	for (uint32_t i = 1; i < count; ++i) {
+		uint32_t state;
+		memcpy(&state, states + i * sizeof(state), sizeof(state));
+		uint32_t j = i;
+		for (; j > 0; --j) {
+			uint32_t prev;
+			memcpy(&prev, states + (j - 1) * sizeof(prev),
+			       sizeof(prev));
+			if (prev <= state)
+				break;
+			memcpy(states + j * sizeof(prev), &prev, sizeof(prev));
+		}
+		memcpy(states + j * sizeof(state), &state, sizeof(state));
+	}
+}
+
+/**
+ * Appends formats and sample counts of attachments to key
+ *
+ * Pipeline can be used with any render pass compatible with the one it
+ * is created with, and passes differing only in load and store
+ * operations or layouts are compatible.
+ * @param key Specifies key to append attachments to
+ * @param targets Specifies attachments of render pass
+ */
+static void vkpipereg_write_pass(struct vkpipereg_key *key,
+				 const struct vkrpcache_key *targets)
+{
+	vkpipereg_write32(key, targets->ncolors);
+	for (uint32_t i = 0; i < targets->ncolors; ++i) {
+		vkpipereg_write32(key, (uint32_t)targets->colors[i].format);
+		vkpipereg_write32(key, (uint32_t)targets->colors[i].samples);
+	}
+	vkpipereg_write32(key, (uint32_t)targets->depth.format);
+	vkpipereg_write32(key, (uint32_t)targets->depth.samples);
+}
+
+/**
+ * Appends attachments pipeline renders to into key
+ * @param key Specifies key to append attachments to
+ * @param info Specifies description of pipeline
+ * @param targets Specifies attachments of render pass, or NULL
+ */
+static void vkpipereg_write_targets(struct vkpipereg_key *key,
+				    const VkGraphicsPipelineCreateInfo *info,
+				    const struct vkrpcache_key *targets)
+{
+	const VkPipelineRenderingCreateInfo *rendering = NULL;
+	const VkBaseInStructure *next = info->pNext;
+	for (; next != NULL; next = next->pNext) {
+		if (next->sType ==
+		    VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO)
+			rendering = (const VkPipelineRenderingCreateInfo *)next;
+		else
+			key->opaque = 1;
+	}
+	vkpipereg_write32(key, info->renderPass != VK_NULL_HANDLE);
+	if (info->renderPass != VK_NULL_HANDLE) {
+		vkpipereg_write32(key, info->subpass);
+		/* Without attachments only the same pass is compatible */
+		vkpipereg_write32(key, targets != NULL);
+		if (targets != NULL)
+			vkpipereg_write_pass(key, targets);
+		else
+			vkpipereg_write(key, &info->renderPass,
+					sizeof(info->renderPass));
+		return;
+	}
+	vkpipereg_write32(key, rendering != NULL);
+	if (rendering == NULL)
+		return;
+	vkpipereg_write32(key, rendering->viewMask);
+	vkpipereg_write32(key, rendering->colorAttachmentCount);
+	for (uint32_t i = 0; i < rendering->colorAttachmentCount; ++i) {
+		vkpipereg_write32(
+			key, (uint32_t)rendering->pColorAttachmentFormats[i]);
+	}
+	vkpipereg_write32(key, (uint32_t)rendering->depthAttachmentFormat);
+	vkpipereg_write32(key, (uint32_t)rendering->stencilAttachmentFormat);
+}
+
+/**
+ * Builds canonical key of pipeline description
+ *
+ * Every variable length part is preceded by its length, so different
+ * descriptions never produce the same bytes. State the description
+ * ignores is left out: it may point to anything and must not make
+ * otherwise equal descriptions differ. State left out because it is
+ * dynamic is told apart by dynamic states, which are part of key.
+ * Key is marked opaque if description is extended by structure it can't
+ * describe.
+ * @param key Specifies key to build, initialized by vkpipereg_key_init
+ * @param info Specifies description of pipeline
+ * @param targets Specifies attachments of render pass, or NULL
+ */
+static void vkpipereg_describe(struct vkpipereg_key *key,
+			       const VkGraphicsPipelineCreateInfo *info,
+			       const struct vkrpcache_key *targets)
+{
+	vkpipereg_write32(key, VKPIPEREG_CANONICAL);
+	vkpipereg_write32(key, (uint32_t)info->flags);
+	vkpipereg_write_stages(key, info);
+	vkpipereg_write_vertex(key, info->pVertexInputState);
+	const int discard = vkpipereg_discards(info);
+	vkpipereg_write_geometry(key, info, discard);
+	vkpipereg_write_raster(key, info, discard);
+	vkpipereg_write_depth(key, info,
+			      discard ? NULL : info->pDepthStencilState);
+	vkpipereg_write_blend(key, info,
+			      discard ? NULL : info->pColorBlendState);
+	vkpipereg_write_dynamic(key, info->pDynamicState);
+	vkpipereg_write(key, &info->layout, sizeof(info->layout));
+	vkpipereg_write_targets(key, info, targets);
+}
+
+/**
+ * Allocates empty table
+ * @param capacity Specifies number of slots, a power of two
+ * @returns pointer to table, or NULL if out of memory
+ */
+static struct vkpipereg_table *vkpipereg_alloc_table(size_t capacity)
+{
+	struct vkpipereg_table *table = malloc(
+		sizeof(*table) + capacity * sizeof(table->slots[0]));
+	if (table == NULL)
+		return NULL;
+	table->retired = NULL;
+	table->capacity = capacity;
+	for (size_t i = 0; i < capacity; ++i) {
+		atomic_init(&table->slots[i], NULL);
+	}
+	return table;
+}
+
+/**
+ * Finds entry of description in table
+ * @param table Specifies table to search
+ * @param hash Specifies hash of key
+ * @param key Specifies canonical key of description
+ * @returns pointer to entry, or NULL if description is not registered
+ */
+static struct vkpipereg_entry *
+vkpipereg_find(const struct vkpipereg_table *table, uint64_t hash,
+	       const struct vkpipereg_key *key)
+{
+	const size_t mask = table->capacity - 1;
+	for (size_t i = hash & mask;; i = (i + 1) & mask) {
+		struct vkpipereg_entry *entry = atomic_load_explicit(
+			&table->slots[i], memory_order_acquire);
+		if (entry == NULL)
+			return NULL;
+		/* Equal hashes of different descriptions are told by key */
+		if (entry->hash == hash && entry->size == key->size &&
+		    memcmp(entry->key, key->data, key->size) == 0)
+			return entry;
+	}
+}
+
+/**
+ * Publishes entry in free slot of table
+ * @param table Specifies table to insert entry into
+ * @param entry Specifies entry to insert
+ */
+static void vkpipereg_publish(struct vkpipereg_table *table,
+			  struct vkpipereg_entry *entry)
+{
+	const size_t mask = table->capacity - 1;
+	size_t i = entry->hash & mask;
+	while (atomic_load_explicit(&table->slots[i], memory_order_relaxed) !=
+	       NULL)
+		i = (i + 1) & mask;
+	atomic_store_explicit(&table->slots[i], entry, memory_order_release);
+}
+
+/**
+ * Replaces table with twice as large one, keeping old one for readers
+ * @param reg Specifies registry to grow table of
+ * @returns zero on success, or non-zero otherwise
+ */
+static int vkpipereg_grow(struct vkpipereg *reg)
+{
+	struct vkpipereg_table *old =
+		atomic_load_explicit(&reg->table, memory_order_relaxed);
+	struct vkpipereg_table *table =
+		vkpipereg_alloc_table(old->capacity * 2);
+	if (table == NULL)
+		return -1;
+	for (size_t i = 0; i < old->capacity; ++i) {
+		struct vkpipereg_entry *entry = atomic_load_explicit(
+			&old->slots[i], memory_order_relaxed);
+		if (entry != NULL)
+			vkpipereg_publish(table, entry);
+	}
+	table->retired = old;
+	atomic_store_explicit(&reg->table, table, memory_order_release);
+	return 0;
+}
+
+/**
+ * Registers new pipeline of description
+ * @param reg Specifies registry, its lock must be held
+ * @param hash Specifies hash of key
+ * @param key Specifies canonical key of description
+ * @param info Specifies description of pipeline
+ * @param fallback Specifies pipeline bound while new one compiles, or NULL
+ * @returns pointer to entry, or NULL if out of memory
+ */
+static struct vkpipereg_entry *
+vkpipereg_insert(struct vkpipereg *reg, uint64_t hash,
+		 const struct vkpipereg_key *key,
+		 const VkGraphicsPipelineCreateInfo *info,
+		 const struct vkcompiler_pipeline *fallback)
+{
+	const struct vkpipereg_table *table =
+		atomic_load_explicit(&reg->table, memory_order_relaxed);
+	/* Load factor is kept at most 3/4, so probes stay short */
+	if ((reg->count + 1) * 4 > table->capacity * 3 && vkpipereg_grow(reg))
+		return NULL;
+	struct vkpipereg_entry *entry = malloc(sizeof(*entry) + key->size);
+	if (entry == NULL)
+		return NULL;
+	entry->hash = hash;
+	entry->size = key->size;
+	memcpy(entry->key, key->data, key->size);
+	entry->pipe.info = info;
+	entry->pipe.fallback = fallback;
+	entry->pipe.pipeline = VK_NULL_HANDLE;
+	atomic_init(&entry->pipe.state, VKCOMPILER_IDLE);
+	entry->pipe.result = VK_SUCCESS;
+	entry->pipe.next = NULL;
+	vkpipereg_publish(
+		atomic_load_explicit(&reg->table, memory_order_relaxed), entry);
+	reg->count++;
+	return entry;
+}
+
+int vkpipereg_init(struct vkpipereg *reg, struct vkcompiler *comp)
+{
+	struct vkpipereg_table *table =
+		vkpipereg_alloc_table(VKPIPEREG_MIN_CAPACITY);
+	if (table == NULL)
+		return -1;
+	if (pthread_mutex_init(&reg->lock, NULL)) {
+		free(table);
+		return -1;
+	}
+	reg->comp = comp;
+	atomic_init(&reg->table, table);
+	reg->count = 0;
+	atomic_init(&reg->nduplicates, 0);
+	atomic_init(&reg->nopaque, 0);
+	return 0;
+}
+
+/**
+ * Returns entry of description, registering new one
+ * @param reg Specifies registry
+ * @param key Specifies canonical key of description
+ * @param info Specifies description of pipeline
+ * @param fallback Specifies pipeline bound while new one compiles, or NULL
+ * @returns pointer to pipeline, or NULL if out of memory
+ */
+static struct vkcompiler_pipeline *
+vkpipereg_lookup(struct vkpipereg *reg, const struct vkpipereg_key *key,
+		 const VkGraphicsPipelineCreateInfo *info,
+		 const struct vkcompiler_pipeline *fallback)
+{
+	const uint64_t hash = vkpipereg_hash(key->data, key->size);
+	struct vkpipereg_entry *entry = vkpipereg_find(
+		atomic_load_explicit(&reg->table, memory_order_acquire), hash,
+		key);
+	if (entry != NULL) {
+		atomic_fetch_add(&reg->nduplicates, 1);
+		return &entry->pipe;
+	}
+	pthread_mutex_lock(&reg->lock);
+	/* Other thread may have registered it since lookup */
+	entry = vkpipereg_find(
+		atomic_load_explicit(&reg->table, memory_order_relaxed), hash,
+		key);
+	if (entry != NULL) {
+		pthread_mutex_unlock(&reg->lock);
+		atomic_fetch_add(&reg->nduplicates, 1);
+		return &entry->pipe;
+	}
+	entry = vkpipereg_insert(reg, hash, key, info, fallback);
+	pthread_mutex_unlock(&reg->lock);
+	if (entry == NULL)
+		return NULL;
+	/* Failure is kept in state of pipeline, draws bind fallback */
+	vkcompiler_request(reg->comp, &entry->pipe);
+	return &entry->pipe;
+}
+
+struct vkcompiler_pipeline *
+vkpipereg_get(struct vkpipereg *reg, const VkGraphicsPipelineCreateInfo *info,
+	      const struct vkrpcache_key *targets,
+	      const struct vkcompiler_pipeline *fallback)
+{
+	struct vkpipereg_key key;
+	vkpipereg_key_init(&key);
+	vkpipereg_describe(&key, info, targets);
+	if (key.opaque) {
+		/* Serial number makes key unique, so pipeline isn't shared */
+		vkpipereg_key_release(&key);
+		vkpipereg_key_init(&key);
+		vkpipereg_write32(&key, VKPIPEREG_OPAQUE);
+		vkpipereg_write64(&key, atomic_fetch_add(&reg->nopaque, 1));
+	}
+	struct vkcompiler_pipeline *pipe = NULL;
+	if (!key.failed)
+		pipe = vkpipereg_lookup(reg, &key, info, fallback);
+	vkpipereg_key_release(&key);
+	return pipe;
+}
+
+void vkpipereg_destroy(struct vkpipereg *reg)
+{
+	vkcompiler_wait(reg->comp);
+	struct vkpipereg_table *table =
+		atomic_load_explicit(&reg->table, memory_order_relaxed);
+	for (size_t i = 0; i < table->capacity; ++i) {
+		struct vkpipereg_entry *entry = atomic_load_explicit(
+			&table->slots[i], memory_order_relaxed);
+		if (entry == NULL)
+			continue;
+		vkcompiler_release(reg->comp, &entry->pipe);
+		free(entry);
+	}
+	while (table != NULL) {
+		struct vkpipereg_table *retired = table->retired;
+		free(table);
+		table = retired;
+	}
+	atomic_store_explicit(&reg->table, NULL, memory_order_relaxed);
+	reg->count = 0;
+	pthread_mutex_destroy(&reg->lock);
+}
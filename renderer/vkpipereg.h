@@ -0,0 +1,115 @@
+#ifndef RENDERER_VKPIPEREG_H
+#define RENDERER_VKPIPEREG_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <renderer/vkcompiler.h>
+#include <renderer/vkrpcache.h>
+#include <vulkan/vulkan_core.h>
+
+/** Number of slots of the first table of registry */
+#define VKPIPEREG_MIN_CAPACITY 64
+
+/** Pipeline registered under canonical key of its description */
+struct vkpipereg_entry {
+	/** Hash of key */
+	uint64_t hash;
+	/** Pipeline compiled by compiler of registry */
+	struct vkcompiler_pipeline pipe;
+	/** Number of bytes of key */
+	size_t size;
+	/** Canonical key of pipeline description */
+	unsigned char key[];
+};
+
+/** Open addressing hash table of registered pipelines */
+struct vkpipereg_table {
+	/** Table replaced by this one, freed along with registry */
+	struct vkpipereg_table *retired;
+	/** Number of slots, a power of two */
+	size_t capacity;
+	/** Slots pointing to entries, NULL if empty */
+	_Atomic(struct vkpipereg_entry *) slots[];
+};
+
+/**
+ * Registry returning the same pipeline for identical descriptions
+ *
+ * Description is serialized to canonical key of shaders, specialization
+ * data, vertex layout, fixed function state, layout and render pass,
+ * following pointers instead of copying them, so subsystems describing
+ * the same state in their own memory share one pipeline. State Vulkan
+ * ignores, like dynamic viewports, is left out of key, and render pass
+ * is described by formats and sample counts of its attachments, so
+ * pipelines are shared by compatible passes. Descriptions extended by
+ * structures registry does not know are registered under unique key and
+ * never shared. Shader stages are keyed by module handle, not by code, so
+ * callers must create module of each shader once and share its handle;
+ * separately created modules of the same code give separate pipelines.
+ * Stages chaining VkShaderModuleCreateInfo instead of module are keyed by
+ * their code. Entries keep their key, and lookups compare it when hashes
+ * are equal. Lookups never lock: entries are never moved or removed, and
+ * table outgrown by insertions is replaced, not freed, until registry is
+ * destroyed. Insertions are serialized by lock.
+ */
+struct vkpipereg {
+	/** Compiler new pipelines are requested from */
+	struct vkcompiler *comp;
+	/** Current table */
+	_Atomic(struct vkpipereg_table *) table;
+	/** Serializes insertions */
+	pthread_mutex_t lock;
+	/** Number of registered pipelines */
+	size_t count;
+	/** Number of lookups returning already registered pipeline */
+	atomic_uint_fast64_t nduplicates;
+	/** Number of descriptions registered under unique key */
+	atomic_uint_fast64_t nopaque;
+};
+
+#ifdef __cplusplus
+/* *INDENT-OFF* */
+extern "C" {
+/* *INDENT-ON* */
+#endif
+
+/**
+ * Initializes empty registry
+ * @param reg Specifies registry to initialize
+ * @param comp Specifies compiler of registered pipelines
+ * @returns zero on success, or non-zero otherwise
+ */
+int vkpipereg_init(struct vkpipereg *reg, struct vkcompiler *comp);
+
+/**
+ * Returns pipeline of description, requesting compilation of new one
+ *
+ * Bind pipeline with vkcompiler_select. Descriptions using the same shader
+ * must share its module, see struct vkpipereg.
+ * @param reg Specifies registry
+ * @param info Specifies description, must outlive compilation if new
+ * @param targets Specifies attachments render pass of @a info is got
+ *                from vkrpcache with, or NULL to tell passes by handle
+ * @param fallback Specifies pipeline bound while new one compiles, or NULL
+ * @returns registered pipeline, or NULL if out of memory
+ */
+struct vkcompiler_pipeline *
+vkpipereg_get(struct vkpipereg *reg, const VkGraphicsPipelineCreateInfo *info,
+	      const struct vkrpcache_key *targets,
+	      const struct vkcompiler_pipeline *fallback);
+
+/**
+ * Waits for pending compilations and destroys registered pipelines
+ * @param reg Specifies registry to destroy
+ */
+void vkpipereg_destroy(struct vkpipereg *reg);
+
+#ifdef __cplusplus
+/* *INDENT-OFF* */
+}
+/* *INDENT-ON* */
+#endif
+#endif
@@ -0,0 +1,517 @@
+/**
+ * @file
+ * Test suite for vkpipereg
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <cgreen/cgreen.h>
+#include <cgreen/mocks.h>
+
+#include <vulkan/vulkan_core.h>
+#include "vkcompiler.h"
+#include "vkpipereg.h"
+#include "vkrpcache.h"
+
+/** Number of threads looking up the same description */
+#define NTHREADS 4
+
+/** Number of lookups made by every thread */
+#define NLOOKUPS 1000
+
+/** Number of pipelines requested from compiler */
+static atomic_int nrequests;
+
+/** Number of pipelines released to compiler */
+static int nreleased;
+
+VkResult vkcompiler_request(struct vkcompiler *comp,
+			    struct vkcompiler_pipeline *pipe)
+{
+	(void)(comp);
+	const int index = atomic_fetch_add(&nrequests, 1);
+	pipe->pipeline = (VkPipeline)(uintptr_t)(0x100 + index);
+	atomic_store(&pipe->state, VKCOMPILER_READY);
+	return VK_SUCCESS;
+}
+
+void vkcompiler_wait(struct vkcompiler *comp)
+{
+	(void)(comp);
+}
+
+void vkcompiler_release(struct vkcompiler *comp,
+			struct vkcompiler_pipeline *pipe)
+{
+	(void)(comp);
+	(void)(pipe);
+	nreleased++;
+}
+
+/** Pipeline description with every state it points to */
+struct desc {
+	/** Vertex and fragment stages */
+	VkPipelineShaderStageCreateInfo stages[2];
+	/** Specialization of fragment stage */
+	VkSpecializationInfo spec;
+	/** Specialization constant of fragment stage */
+	VkSpecializationMapEntry spec_entry;
+	/** Value of specialization constant */
+	uint32_t spec_data;
+	/** Vertex binding */
+	VkVertexInputBindingDescription binding;
+	/** Vertex layout */
+	VkPipelineVertexInputStateCreateInfo vertex;
+	/** Primitive assembly */
+	VkPipelineInputAssemblyStateCreateInfo assembly;
+	/** Rasterization */
+	VkPipelineRasterizationStateCreateInfo raster;
+	/** Depth test */
+	VkPipelineDepthStencilStateCreateInfo depth;
+	/** Blending of color attachment */
+	VkPipelineColorBlendAttachmentState blend_attachment;
+	/** Blending */
+	VkPipelineColorBlendStateCreateInfo blend;
+	/** Dynamic states */
+	VkDynamicState dynamic_states[2];
+	/** Dynamic state */
+	VkPipelineDynamicStateCreateInfo dynamic;
+	/** Pipeline description */
+	VkGraphicsPipelineCreateInfo info;
+};
+
+/**
+ * Fills description of pipeline
+ * @param d Specifies description to fill
+ * @param stride Specifies stride of vertex binding
+ */
+static void make_desc(struct desc *d, uint32_t stride)
+{
+	memset(d, 0, sizeof(*d));
+	d->stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+	d->stages[0].module = (VkShaderModule)1;
+	d->stages[0].pName = "main";
+	d->stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+	d->stages[1].module = (VkShaderModule)2;
+	d->stages[1].pName = "main";
+	d->stages[1].pSpecializationInfo = &d->spec;
+	d->spec_entry.size = sizeof(d->spec_data);
+	d->spec_data = 4;
+	d->spec.mapEntryCount = 1;
+	d->spec.pMapEntries = &d->spec_entry;
+	d->spec.dataSize = sizeof(d->spec_data);
+	d->spec.pData = &d->spec_data;
+	d->binding.stride = stride;
+	d->vertex.vertexBindingDescriptionCount = 1;
+	d->vertex.pVertexBindingDescriptions = &d->binding;
+	d->assembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	d->raster.cullMode = VK_CULL_MODE_BACK_BIT;
+	d->raster.lineWidth = 1.0f;
+	d->depth.depthTestEnable = VK_TRUE;
+	d->depth.depthCompareOp = VK_COMPARE_OP_LESS;
+	d->blend_attachment.colorWriteMask = 0xF;
+	d->blend.attachmentCount = 1;
+	d->blend.pAttachments = &d->blend_attachment;
+	d->dynamic_states[0] = VK_DYNAMIC_STATE_VIEWPORT;
+	d->dynamic_states[1] = VK_DYNAMIC_STATE_SCISSOR;
+	d->dynamic.dynamicStateCount = 2;
+	d->dynamic.pDynamicStates = d->dynamic_states;
+	d->info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	d->info.stageCount = 2;
+	d->info.pStages = d->stages;
+	d->info.pVertexInputState = &d->vertex;
+	d->info.pInputAssemblyState = &d->assembly;
+	d->info.pRasterizationState = &d->raster;
+	d->info.pDepthStencilState = &d->depth;
+	d->info.pColorBlendState = &d->blend;
+	d->info.pDynamicState = &d->dynamic;
+	d->info.layout = (VkPipelineLayout)3;
+	d->info.renderPass = (VkRenderPass)4;
+}
+
+/**
+ * Resets state shared by tests and initializes registry
+ * @param reg Specifies registry to initialize
+ */
+static void init_registry(struct vkpipereg *reg)
+{
+	atomic_store(&nrequests, 0);
+	nreleased = 0;
+	vkpipereg_init(reg, NULL);
+}
+
+/**
+ * Checks if registry returns the same pipeline for both descriptions
+ * @param a Specifies description registered first
+ * @param b Specifies description looked up second
+ * @returns non-zero if pipeline is shared, or zero otherwise
+ */
+static int same_pipeline(const VkGraphicsPipelineCreateInfo *a,
+			 const VkGraphicsPipelineCreateInfo *b)
+{
+	struct vkpipereg reg;
+	init_registry(&reg);
+	const struct vkcompiler_pipeline *first =
+		vkpipereg_get(&reg, a, NULL, NULL);
+	const struct vkcompiler_pipeline *second =
+		vkpipereg_get(&reg, b, NULL, NULL);
+	vkpipereg_destroy(&reg);
+	return first != NULL && first == second;
+}
+
+/**
+ * Returns entry of registered pipeline
+ * @param pipe Specifies pipeline returned by registry
+ * @returns pointer to entry holding pipeline
+ */
+static struct vkpipereg_entry *entry_of(struct vkcompiler_pipeline *pipe)
+{
+	return (struct vkpipereg_entry *)((char *)pipe -
+					  offsetof(struct vkpipereg_entry,
+						   pipe));
+}
+
+Ensure(identical_descriptions_return_same_pipeline)
+{
+	struct vkpipereg reg;
+	struct desc a, b;
+	make_desc(&a, 16);
+	make_desc(&b, 16);
+	init_registry(&reg);
+	struct vkcompiler_pipeline *first =
+		vkpipereg_get(&reg, &a.info, NULL, NULL);
+	struct vkcompiler_pipeline *second =
+		vkpipereg_get(&reg, &b.info, NULL, NULL);
+	assert_that(first, is_non_null);
+	assert_that(second, is_equal_to(first));
+	assert_that(second->pipeline, is_equal_to(0x100));
+	assert_that(reg.count, is_equal_to(1));
+	assert_that(atomic_load(&reg.nduplicates), is_equal_to(1));
+	assert_that(atomic_load(&nrequests), is_equal_to(1));
+	vkpipereg_destroy(&reg);
+}
+
+Ensure(different_states_return_different_pipelines)
+{
+	struct vkpipereg reg;
+	struct desc a, b;
+	make_desc(&a, 16);
+	make_desc(&b, 16);
+	b.blend_attachment.blendEnable = VK_TRUE;
+	init_registry(&reg);
+	struct vkcompiler_pipeline *first =
+		vkpipereg_get(&reg, &a.info, NULL, NULL);
+	struct vkcompiler_pipeline *second =
+		vkpipereg_get(&reg, &b.info, NULL, NULL);
+	assert_that(second, is_not_equal_to(first));
+	assert_that(reg.count, is_equal_to(2));
+	assert_that(atomic_load(&reg.nduplicates), is_equal_to(0));
+	vkpipereg_destroy(&reg);
+}
+
+Ensure(equal_hashes_of_different_descriptions_are_told_apart)
+{
+	struct vkpipereg reg;
+	struct desc a, b;
+	make_desc(&a, 16);
+	make_desc(&b, 32);
+	init_registry(&reg);
+	struct vkcompiler_pipeline *pipe =
+		vkpipereg_get(&reg, &b.info, NULL, NULL);
+	const uint64_t hash = entry_of(pipe)->hash;
+	vkpipereg_destroy(&reg);
+	init_registry(&reg);
+	struct vkcompiler_pipeline *first =
+		vkpipereg_get(&reg, &a.info, NULL, NULL);
+	/* Entry of first description is moved as if its hash collided */
+	struct vkpipereg_entry *entry = entry_of(first);
+	const size_t mask = reg.table->capacity - 1;
+	atomic_store(&reg.table->slots[entry->hash & mask], NULL);
+	entry->hash = hash;
+	atomic_store(&reg.table->slots[hash & mask], entry);
+	struct vkcompiler_pipeline *second =
+		vkpipereg_get(&reg, &b.info, NULL, NULL);
+	assert_that(second, is_non_null);
+	assert_that(second, is_not_equal_to(first));
+	assert_that(reg.count, is_equal_to(2));
+	assert_that(atomic_load(&reg.nduplicates), is_equal_to(0));
+	vkpipereg_destroy(&reg);
+}
+
+Ensure(key_ignores_order_of_stages_and_dynamic_states)
+{
+	struct desc a, b;
+	make_desc(&a, 16);
+	make_desc(&b, 16);
+	b.stages[0] = a.stages[1];
+	b.stages[1] = a.stages[0];
+	b.stages[0].pSpecializationInfo = &b.spec;
+	b.dynamic_states[0] = VK_DYNAMIC_STATE_SCISSOR;
+	b.dynamic_states[1] = VK_DYNAMIC_STATE_VIEWPORT;
+	assert_that(same_pipeline(&a.info, &b.info), is_true);
+}
+
+Ensure(key_covers_specialization_data)
+{
+	struct desc a, b;
+	make_desc(&a, 16);
+	make_desc(&b, 16);
+	b.spec_data = 8;
+	assert_that(same_pipeline(&a.info, &b.info), is_false);
+}
+
+Ensure(key_covers_vertex_layout_and_depth)
+{
+	struct desc a, b, c;
+	make_desc(&a, 16);
+	make_desc(&b, 32);
+	make_desc(&c, 16);
+	c.depth.depthCompareOp = VK_COMPARE_OP_GREATER;
+	assert_that(same_pipeline(&a.info, &b.info), is_false);
+	assert_that(same_pipeline(&a.info, &c.info), is_false);
+}
+
+Ensure(key_covers_formats_of_dynamic_rendering)
+{
+	struct desc a, b;
+	const VkFormat bgra = VK_FORMAT_B8G8R8A8_SRGB;
+	const VkFormat rgba = VK_FORMAT_R8G8B8A8_SRGB;
+	VkPipelineRenderingCreateInfo rendering_a = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO,
+		.colorAttachmentCount = 1,
+		.pColorAttachmentFormats = &bgra,
+	};
+	VkPipelineRenderingCreateInfo rendering_b = rendering_a;
+	rendering_b.pColorAttachmentFormats = &rgba;
+	make_desc(&a, 16);
+	make_desc(&b, 16);
+	a.info.renderPass = VK_NULL_HANDLE;
+	a.info.pNext = &rendering_a;
+	b.info.renderPass = VK_NULL_HANDLE;
+	b.info.pNext = &rendering_b;
+	assert_that(same_pipeline(&a.info, &b.info), is_false);
+}
+
+Ensure(key_ignores_tessellation_and_dynamic_viewports)
+{
+	struct desc a, b;
+	VkPipelineViewportStateCreateInfo viewport = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+		.viewportCount = 1,
+		.scissorCount = 1,
+	};
+	VkPipelineViewportStateCreateInfo garbage = viewport;
+	/* Ignored pointers may point to anything, so they are not read */
+	garbage.pViewports = (const VkViewport *)1;
+	garbage.pScissors = (const VkRect2D *)1;
+	make_desc(&a, 16);
+	make_desc(&b, 16);
+	a.info.pViewportState = &viewport;
+	b.info.pViewportState = &garbage;
+	b.info.pTessellationState =
+		(const VkPipelineTessellationStateCreateInfo *)1;
+	assert_that(same_pipeline(&a.info, &b.info), is_true);
+}
+
+Ensure(key_ignores_fragment_state_of_discarded_rasterization)
+{
+	struct desc a, b;
+	make_desc(&a, 16);
+	make_desc(&b, 16);
+	a.raster.rasterizerDiscardEnable = VK_TRUE;
+	b.raster.rasterizerDiscardEnable = VK_TRUE;
+	b.depth.depthCompareOp = VK_COMPARE_OP_GREATER;
+	b.blend_attachment.blendEnable = VK_TRUE;
+	b.info.pMultisampleState =
+		(const VkPipelineMultisampleStateCreateInfo *)1;
+	assert_that(same_pipeline(&a.info, &b.info), is_true);
+}
+
+Ensure(compatible_render_passes_share_pipeline)
+{
+	struct vkpipereg reg;
+	struct desc a, b, c;
+	struct vkrpcache_key targets_a = {
+		.ncolors = 1,
+		.colors[0] = {
+			.format = VK_FORMAT_B8G8R8A8_SRGB,
+			.samples = VK_SAMPLE_COUNT_1_BIT,
+			.load = VK_ATTACHMENT_LOAD_OP_CLEAR,
+		},
+	};
+	struct vkrpcache_key targets_b = targets_a;
+	struct vkrpcache_key targets_c = targets_a;
+	targets_b.colors[0].load = VK_ATTACHMENT_LOAD_OP_LOAD;
+	targets_c.colors[0].samples = VK_SAMPLE_COUNT_4_BIT;
+	make_desc(&a, 16);
+	make_desc(&b, 16);
+	make_desc(&c, 16);
+	b.info.renderPass = (VkRenderPass)5;
+	c.info.renderPass = (VkRenderPass)6;
+	init_registry(&reg);
+	struct vkcompiler_pipeline *first =
+		vkpipereg_get(&reg, &a.info, &targets_a, NULL);
+	struct vkcompiler_pipeline *second =
+		vkpipereg_get(&reg, &b.info, &targets_b, NULL);
+	struct vkcompiler_pipeline *third =
+		vkpipereg_get(&reg, &c.info, &targets_c, NULL);
+	assert_that(second, is_equal_to(first));
+	assert_that(third, is_not_equal_to(first));
+	assert_that(reg.count, is_equal_to(2));
+	vkpipereg_destroy(&reg);
+}
+
+Ensure(key_covers_code_chained_to_stage)
+{
+	struct desc a, b, c;
+	const uint32_t code_a[] = {0x07230203, 1};
+	const uint32_t code_b[] = {0x07230203, 1};
+	const uint32_t code_c[] = {0x07230203, 2};
+	VkShaderModuleCreateInfo module_a = {
+		.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+		.codeSize = sizeof(code_a),
+		.pCode = code_a,
+	};
+	VkShaderModuleCreateInfo module_b = module_a;
+	VkShaderModuleCreateInfo module_c = module_a;
+	module_b.pCode = code_b;
+	module_c.pCode = code_c;
+	make_desc(&a, 16);
+	make_desc(&b, 16);
+	make_desc(&c, 16);
+	a.stages[0].module = VK_NULL_HANDLE;
+	a.stages[0].pNext = &module_a;
+	b.stages[0].module = VK_NULL_HANDLE;
+	b.stages[0].pNext = &module_b;
+	c.stages[0].module = VK_NULL_HANDLE;
+	c.stages[0].pNext = &module_c;
+	assert_that(same_pipeline(&a.info, &b.info), is_true);
+	assert_that(same_pipeline(&a.info, &c.info), is_false);
+}
+
+Ensure(descriptions_with_unknown_extensions_are_not_shared)
+{
+	struct vkpipereg reg;
+	struct desc a;
+	const VkBaseInStructure extension = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO,
+	};
+	make_desc(&a, 16);
+	a.raster.pNext = &extension;
+	init_registry(&reg);
+	struct vkcompiler_pipeline *first =
+		vkpipereg_get(&reg, &a.info, NULL, NULL);
+	struct vkcompiler_pipeline *second =
+		vkpipereg_get(&reg, &a.info, NULL, NULL);
+	assert_that(first, is_non_null);
+	assert_that(second, is_non_null);
+	assert_that(second, is_not_equal_to(first));
+	assert_that(reg.count, is_equal_to(2));
+	assert_that(atomic_load(&reg.nduplicates), is_equal_to(0));
+	vkpipereg_destroy(&reg);
+}
+
+Ensure(registry_keeps_pipelines_when_growing)
+{
+	struct vkpipereg reg;
+	static struct desc descs[VKPIPEREG_MIN_CAPACITY * 4];
+	struct vkcompiler_pipeline *pipes[VKPIPEREG_MIN_CAPACITY * 4];
+	const size_t count = VKPIPEREG_MIN_CAPACITY * 4;
+	init_registry(&reg);
+	for (size_t i = 0; i < count; ++i) {
+		make_desc(&descs[i], (uint32_t)i);
+		pipes[i] = vkpipereg_get(&reg, &descs[i].info, NULL, NULL);
+	}
+	for (size_t i = 0; i < count; ++i) {
+		assert_that(vkpipereg_get(&reg, &descs[i].info, NULL, NULL),
+			    is_equal_to(pipes[i]));
+	}
+	assert_that(reg.count, is_equal_to(count));
+	assert_that(atomic_load(&reg.nduplicates), is_equal_to(count));
+	assert_that(reg.table->capacity, is_greater_than(count));
+	vkpipereg_destroy(&reg);
+	assert_that(nreleased, is_equal_to(count));
+}
+
+/** Registry shared by looking up threads */
+static struct vkpipereg shared_reg;
+
+/** Pipeline found by every looking up thread */
+static struct vkcompiler_pipeline *found[NTHREADS];
+
+/**
+ * Looks up the same description many times
+ * @param arg Specifies pointer to index of thread
+ * @returns NULL
+ */
+static void *lookup(void *arg)
+{
+	const size_t index = *(const size_t *)arg;
+	struct desc d;
+	make_desc(&d, 16);
+	for (size_t i = 0; i < NLOOKUPS; ++i) {
+		struct vkcompiler_pipeline *pipe =
+			vkpipereg_get(&shared_reg, &d.info, NULL, NULL);
+		if (i == 0)
+			found[index] = pipe;
+		else if (pipe != found[index])
+			found[index] = NULL;
+	}
+	return NULL;
+}
+
+Ensure(concurrent_lookups_share_one_pipeline)
+{
+	pthread_t threads[NTHREADS];
+	size_t indices[NTHREADS];
+	init_registry(&shared_reg);
+	for (size_t i = 0; i < NTHREADS; ++i) {
+		indices[i] = i;
+		pthread_create(&threads[i], NULL, lookup, &indices[i]);
+	}
+	for (size_t i = 0; i < NTHREADS; ++i) {
+		pthread_join(threads[i], NULL);
+	}
+	for (size_t i = 0; i < NTHREADS; ++i) {
+		assert_that(found[i], is_non_null);
+		assert_that(found[i], is_equal_to(found[0]));
+	}
+	assert_that(shared_reg.count, is_equal_to(1));
+	assert_that(atomic_load(&nrequests), is_equal_to(1));
+	assert_that(atomic_load(&shared_reg.nduplicates),
+		    is_equal_to(NTHREADS * NLOOKUPS - 1));
+	vkpipereg_destroy(&shared_reg);
+}
+
+int main(int argc, char **argv)
+{
+	(void)(argc);
+	(void)(argv);
+	TestSuite *suite = create_named_test_suite("VKPipeReg");
+	add_test(suite, identical_descriptions_return_same_pipeline);
+	add_test(suite, different_states_return_different_pipelines);
+	add_test(suite, equal_hashes_of_different_descriptions_are_told_apart);
+	add_test(suite, key_ignores_order_of_stages_and_dynamic_states);
+	add_test(suite, key_covers_specialization_data);
+	add_test(suite, key_covers_vertex_layout_and_depth);
+	add_test(suite, key_covers_formats_of_dynamic_rendering);
+	add_test(suite, key_ignores_tessellation_and_dynamic_viewports);
+	add_test(suite, key_ignores_fragment_state_of_discarded_rasterization);
+	add_test(suite, compatible_render_passes_share_pipeline);
+	add_test(suite, key_covers_code_chained_to_stage);
+	add_test(suite, descriptions_with_unknown_extensions_are_not_shared);
+	add_test(suite, registry_keeps_pipelines_when_growing);
+	add_test(suite, concurrent_lookups_share_one_pipeline);
+	TestReporter *reporter = create_text_reporter();
+	int exit_code = run_test_suite(suite, reporter);
+	destroy_reporter(reporter);
+	destroy_test_suite(suite);
+	return exit_code;
+}
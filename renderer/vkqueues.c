@@ -0,0 +1,56 @@
+/**
+ * @file
+ * Leases of Vulkan queues implementation
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "vkqueues.h"
+#include <vulkan/vulkan_core.h>
+
+void vkqueues_init(struct vkqueues *qs, VkDevice dev, uint32_t family,
+		   uint32_t first, uint32_t count)
+{
+	if (count > VKQUEUES_MAX)
+		count = VKQUEUES_MAX;
+	for (uint32_t i = 0; i < count; ++i) {
+		vkGetDeviceQueue(dev, family, first + i, &qs->queues[i]);
+	}
+	qs->count = count;
+	atomic_init(&qs->free, (UINT32_C(1) << count) - 1);
+	atomic_init(&qs->nleases, 0);
+	atomic_init(&qs->nmisses, 0);
+}
+
+int vkqueues_lease(struct vkqueues *qs, VkQueue *queue)
+{
+	uint_fast32_t free = atomic_load_explicit(&qs->free,
+						  memory_order_relaxed);
+	int lease;
+	do {
+		if (free == 0) {
+			atomic_fetch_add_explicit(&qs->nmisses, 1,
+						  memory_order_relaxed);
+			return -1;
+		}
+		lease = 0;
+		while (!(free & (UINT32_C(1) << lease)))
+			++lease;
+		/* Acquire pairs with release, so queue use never overlaps */
+	} while (!atomic_compare_exchange_weak_explicit(
+		&qs->free, &free, free & ~(UINT32_C(1) << lease),
+		memory_order_acquire, memory_order_relaxed));
+	atomic_fetch_add_explicit(&qs->nleases, 1, memory_order_relaxed);
+	*queue = qs->queues[lease];
+	return lease;
+}
+
+void vkqueues_release(struct vkqueues *qs, int lease)
+{
+	atomic_fetch_or_explicit(&qs->free, UINT32_C(1) << lease,
+				 memory_order_release);
+}
@@ -0,0 +1,68 @@
+#ifndef RENDERER_VKQUEUES_H
+#define RENDERER_VKQUEUES_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include <vulkan/vulkan_core.h>
+
+/** Maximum number of queues leased to submitting threads */
+#define VKQUEUES_MAX 15
+
+/**
+ * Queues of one family leased to submitting threads
+ *
+ * Lease gives thread exclusive use of queue until it is released, so
+ * threads submit in parallel without locking. Leasing never blocks.
+ */
+struct vkqueues {
+	/** Queues available for lease */
+	VkQueue queues[VKQUEUES_MAX];
+	/** Number of queues in @a queues */
+	uint32_t count;
+	/** Bit mask of queues not leased at the moment */
+	atomic_uint_fast32_t free;
+	/** Number of successful leases */
+	atomic_uint_fast64_t nleases;
+	/** Number of leases failed because all queues were leased */
+	atomic_uint_fast64_t nmisses;
+};
+
+#ifdef __cplusplus
+/* *INDENT-OFF* */
+extern "C" {
+/* *INDENT-ON* */
+#endif
+
+/**
+ * Initializes leases of device queues
+ * @param qs Specifies leases to initialize
+ * @param dev Specifies device the queues are created on
+ * @param family Specifies queue family of queues
+ * @param first Specifies index of the first queue within family
+ * @param count Specifies number of queues, at most VKQUEUES_MAX
+ */
+void vkqueues_init(struct vkqueues *qs, VkDevice dev, uint32_t family,
+		   uint32_t first, uint32_t count);
+
+/**
+ * Leases queue not used by any other thread
+ * @param qs Specifies leases to lease queue from
+ * @param queue Specifies pointer where leased queue must be stored
+ * @returns index of lease, or negative value if all queues are leased
+ */
+int vkqueues_lease(struct vkqueues *qs, VkQueue *queue);
+
+/**
+ * Returns leased queue, so other threads can lease it
+ * @param qs Specifies leases the queue is leased from
+ * @param lease Specifies index of lease returned by vkqueues_lease
+ */
+void vkqueues_release(struct vkqueues *qs, int lease);
+
+#ifdef __cplusplus
+/* *INDENT-OFF* */
+}
+/* *INDENT-ON* */
+#endif
+#endif
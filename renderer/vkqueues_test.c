@@ -0,0 +1,173 @@
+/**
+ * @file
+ * Test suite for vkqueues
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include <cgreen/cgreen.h>
+#include <cgreen/mocks.h>
+
+#include <vulkan/vulkan_core.h>
+#include "vkqueues.h"
+
+/** Queue family of leased queues */
+#define GRAPHICS_FAMILY 2
+
+/** Number of threads leasing queues concurrently */
+#define NTHREADS 8
+
+/** Number of leases made by every thread */
+#define NLEASES 10000
+
+VKAPI_ATTR void VKAPI_CALL vkGetDeviceQueue(VkDevice device,
+					    uint32_t queueFamilyIndex,
+					    uint32_t queueIndex,
+					    VkQueue *pQueue)
+{
+	*pQueue = (VkQueue)(uintptr_t)(queueIndex + 1);
+	mock(device, queueFamilyIndex, queueIndex, pQueue);
+}
+
+/** Queues leased in concurrent test */
+static struct vkqueues shared_queues;
+
+/** Number of threads using every queue in concurrent test */
+static atomic_int users[VKQUEUES_MAX];
+
+/** Number of times two threads used the same queue at once */
+static atomic_int nconflicts;
+
+/**
+ * Leases queues in loop, counting overlapping uses of the same queue
+ * @param arg Unused
+ * @returns NULL
+ */
+static void *lease_queues(void *arg)
+{
+	(void)(arg);
+	for (int i = 0; i < NLEASES; ++i) {
+		VkQueue queue;
+		const int lease = vkqueues_lease(&shared_queues, &queue);
+		if (lease < 0)
+			continue;
+		if (atomic_fetch_add(&users[lease], 1) != 0)
+			atomic_fetch_add(&nconflicts, 1);
+		atomic_fetch_sub(&users[lease], 1);
+		vkqueues_release(&shared_queues, lease);
+	}
+	return NULL;
+}
+
+Ensure(init_gets_queues_starting_from_first)
+{
+	struct vkqueues qs;
+	expect(vkGetDeviceQueue, when(queueFamilyIndex, is_equal_to(2)),
+	       when(queueIndex, is_equal_to(1)));
+	expect(vkGetDeviceQueue, when(queueFamilyIndex, is_equal_to(2)),
+	       when(queueIndex, is_equal_to(2)));
+	vkqueues_init(&qs, VK_NULL_HANDLE, GRAPHICS_FAMILY, 1, 2);
+	assert_that(qs.count, is_equal_to(2));
+}
+
+Ensure(init_limits_number_of_queues)
+{
+	struct vkqueues qs;
+	always_expect(vkGetDeviceQueue);
+	vkqueues_init(&qs, VK_NULL_HANDLE, GRAPHICS_FAMILY, 0,
+		      VKQUEUES_MAX + 1);
+	assert_that(qs.count, is_equal_to(VKQUEUES_MAX));
+}
+
+Ensure(lease_returns_different_queues)
+{
+	struct vkqueues qs;
+	VkQueue first;
+	VkQueue second;
+	always_expect(vkGetDeviceQueue);
+	vkqueues_init(&qs, VK_NULL_HANDLE, GRAPHICS_FAMILY, 1, 2);
+	const int first_lease = vkqueues_lease(&qs, &first);
+	const int second_lease = vkqueues_lease(&qs, &second);
+	assert_that(first_lease, is_equal_to(0));
+	assert_that(second_lease, is_equal_to(1));
+	assert_that(first, is_equal_to((VkQueue)2));
+	assert_that(second, is_equal_to((VkQueue)3));
+	assert_that(atomic_load(&qs.nleases), is_equal_to(2));
+}
+
+Ensure(lease_fails_when_all_queues_are_leased)
+{
+	struct vkqueues qs;
+	VkQueue queue;
+	always_expect(vkGetDeviceQueue);
+	vkqueues_init(&qs, VK_NULL_HANDLE, GRAPHICS_FAMILY, 1, 1);
+	vkqueues_lease(&qs, &queue);
+	const int lease = vkqueues_lease(&qs, &queue);
+	assert_that(lease, is_less_than(0));
+	assert_that(atomic_load(&qs.nmisses), is_equal_to(1));
+}
+
+Ensure(lease_fails_without_queues)
+{
+	struct vkqueues qs;
+	VkQueue queue;
+	vkqueues_init(&qs, VK_NULL_HANDLE, GRAPHICS_FAMILY, 1, 0);
+	const int lease = vkqueues_lease(&qs, &queue);
+	assert_that(lease, is_less_than(0));
+}
+
+Ensure(released_queue_is_leased_again)
+{
+	struct vkqueues qs;
+	VkQueue queue;
+	always_expect(vkGetDeviceQueue);
+	vkqueues_init(&qs, VK_NULL_HANDLE, GRAPHICS_FAMILY, 1, 2);
+	vkqueues_lease(&qs, &queue);
+	const int second = vkqueues_lease(&qs, &queue);
+	vkqueues_release(&qs, second);
+	const int lease = vkqueues_lease(&qs, &queue);
+	assert_that(lease, is_equal_to(second));
+	assert_that(queue, is_equal_to((VkQueue)3));
+}
+
+Ensure(concurrent_leases_never_share_queue)
+{
+	pthread_t threads[NTHREADS];
+	always_expect(vkGetDeviceQueue);
+	vkqueues_init(&shared_queues, VK_NULL_HANDLE, GRAPHICS_FAMILY, 1, 3);
+	for (int i = 0; i < NTHREADS; ++i) {
+		pthread_create(&threads[i], NULL, lease_queues, NULL);
+	}
+	for (int i = 0; i < NTHREADS; ++i) {
+		pthread_join(threads[i], NULL);
+	}
+	const uint64_t nleases = atomic_load(&shared_queues.nleases);
+	const uint64_t nmisses = atomic_load(&shared_queues.nmisses);
+	assert_that(atomic_load(&nconflicts), is_equal_to(0));
+	assert_that(nleases + nmisses, is_equal_to(NTHREADS * NLEASES));
+	assert_that(atomic_load(&shared_queues.free), is_equal_to(7));
+}
+
+int main(int argc, char **argv)
+{
+	(void)(argc);
+	(void)(argv);
+	TestSuite *suite = create_named_test_suite("VKQueues");
+	add_test(suite, init_gets_queues_starting_from_first);
+	add_test(suite, init_limits_number_of_queues);
+	add_test(suite, lease_returns_different_queues);
+	add_test(suite, lease_fails_when_all_queues_are_leased);
+	add_test(suite, lease_fails_without_queues);
+	add_test(suite, released_queue_is_leased_again);
+	add_test(suite, concurrent_leases_never_share_queue);
+	TestReporter *reporter = create_text_reporter();
+	int exit_code = run_test_suite(suite, reporter);
+	destroy_reporter(reporter);
+	destroy_test_suite(suite);
+	return exit_code;
+}
@@ -0,0 +1,206 @@
+/**
+ * @file
+ * Parallel recorder of secondary command buffers
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "vkrecorder.h"
+#include <vulkan/vulkan_core.h>
+
+/**
+ * Records worker's slice of current job
+ * @param worker Specifies worker to record slice of
+ * @returns VK_SUCCESS on success, or VkResult error otherwise
+ */
+static VkResult vkrecorder_record_slice(const struct vkrecorder_worker *worker)
+{
+	const struct vkrecorder *rec = worker->rec;
+	const size_t index = (size_t)(worker - rec->workers);
+	const size_t first = rec->ndraws * index / rec->nworkers;
+	const size_t last = rec->ndraws * (index + 1) / rec->nworkers;
+	const VkCommandBuffer cmds = worker->cmds[rec->slot];
+	const struct vkdispatch *vkd = rec->vkd;
+	VkResult result =
+		vkd->vkResetCommandPool(rec->dev, worker->pools[rec->slot], 0);
+	if (result != VK_SUCCESS)
+		return result;
+	const VkCommandBufferBeginInfo begin_info = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.pNext = NULL,
+		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT |
+			 VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT,
+		.pInheritanceInfo = &rec->inheritance,
+	};
+	result = vkd->vkBeginCommandBuffer(cmds, &begin_info);
+	if (result != VK_SUCCESS)
+		return result;
+	if (rec->draw != NULL && last > first)
+		rec->draw(cmds, first, last - first, rec->data);
+	return vkd->vkEndCommandBuffer(cmds);
+}
+
+/**
+ * Runs worker thread recording slices of posted jobs until recorder quits
+ * @param arg Specifies worker of the thread
+ * @returns NULL
+ */
+static void *vkrecorder_run(void *arg)
+{
+	struct vkrecorder_worker *worker = arg;
+	struct vkrecorder *rec = worker->rec;
+	pthread_mutex_lock(&rec->lock);
+	for (;;) {
+		while (!rec->quit && worker->job == rec->job)
+			pthread_cond_wait(&rec->job_posted, &rec->lock);
+		if (rec->quit)
+			break;
+		worker->job = rec->job;
+		pthread_mutex_unlock(&rec->lock);
+		const VkResult result = vkrecorder_record_slice(worker);
+		pthread_mutex_lock(&rec->lock);
+		if (rec->result == VK_SUCCESS)
+			rec->result = result;
+		if (--rec->npending == 0)
+			pthread_cond_signal(&rec->job_done);
+	}
+	pthread_mutex_unlock(&rec->lock);
+	return NULL;
+}
+
+/**
+ * Destroys command pools of worker, buffers are freed along with them
+ * @param worker Specifies worker to destroy pools of
+ * @param dev Specifies device pools are created on
+ */
+static void vkrecorder_destroy_pools(const struct vkrecorder_worker *worker,
+				     VkDevice dev)
+{
+	for (size_t i = 0; i < VKRECORDER_MAX_SLOTS; ++i) {
+		vkDestroyCommandPool(dev, worker->pools[i], worker->rec->host);
+	}
+}
+
+/**
+ * Creates command pools and buffers of worker and starts its thread
+ * @param worker Specifies worker to initialize
+ * @param rec Specifies recorder the worker belongs to
+ * @param family Specifies queue family index buffers will be submitted to
+ * @returns zero on success, or non-zero otherwise
+ */
+static int vkrecorder_init_worker(struct vkrecorder_worker *worker,
+				  struct vkrecorder *rec, uint32_t family)
+{
+	const VkCommandPoolCreateInfo pool_info = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+		.pNext = NULL,
+		.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+		.queueFamilyIndex = family,
+	};
+	worker->rec = rec;
+	worker->job = rec->job;
+	for (size_t i = 0; i < VKRECORDER_MAX_SLOTS; ++i) {
+		worker->pools[i] = VK_NULL_HANDLE;
+	}
+	for (size_t i = 0; i < rec->nslots; ++i) {
+		if (vkCreateCommandPool(rec->dev, &pool_info, rec->host,
+					&worker->pools[i]) != VK_SUCCESS)
+			goto destroy_pools;
+		const VkCommandBufferAllocateInfo alloc_info = {
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+			.pNext = NULL,
+			.commandPool = worker->pools[i],
+			.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+			.commandBufferCount = 1,
+		};
+		if (vkAllocateCommandBuffers(rec->dev, &alloc_info,
+					     &worker->cmds[i]) != VK_SUCCESS)
+			goto destroy_pools;
+	}
+	if (pthread_create(&worker->thread, NULL, vkrecorder_run, worker))
+		goto destroy_pools;
+	return 0;
+destroy_pools:
+	vkrecorder_destroy_pools(worker, rec->dev);
+	return -1;
+}
+
+int vkrecorder_init(struct vkrecorder *rec, VkDevice dev,
+		    const struct vkdispatch *vkd, uint32_t family,
+		    size_t nworkers, size_t nslots,
+		    const VkAllocationCallbacks *host)
+{
+	rec->dev = dev;
+	rec->vkd = vkd;
+	rec->host = host;
+	rec->nworkers = 0;
+	rec->nslots = nslots;
+	rec->job = 0;
+	rec->npending = 0;
+	rec->quit = 0;
+	rec->result = VK_SUCCESS;
+	rec->draw = NULL;
+	rec->data = NULL;
+	rec->ndraws = 0;
+	if (pthread_mutex_init(&rec->lock, NULL))
+		return -1;
+	if (pthread_cond_init(&rec->job_posted, NULL))
+		goto destroy_lock;
+	if (pthread_cond_init(&rec->job_done, NULL))
+		goto destroy_job_posted;
+	for (size_t i = 0; i < nworkers; ++i) {
+		if (vkrecorder_init_worker(&rec->workers[i], rec, family)) {
+			vkrecorder_destroy(rec);
+			return -1;
+		}
+		rec->nworkers++;
+	}
+	return 0;
+destroy_job_posted:
+	pthread_cond_destroy(&rec->job_posted);
+destroy_lock:
+	pthread_mutex_destroy(&rec->lock);
+	return -1;
+}
+
+VkResult vkrecorder_record(struct vkrecorder *rec, size_t slot,
+			   const VkCommandBufferInheritanceInfo *inheritance,
+			   VkCommandBuffer *cmds)
+{
+	pthread_mutex_lock(&rec->lock);
+	rec->slot = slot;
+	rec->inheritance = *inheritance;
+	rec->result = VK_SUCCESS;
+	rec->npending = rec->nworkers;
+	rec->job++;
+	pthread_cond_broadcast(&rec->job_posted);
+	while (rec->npending > 0)
+		pthread_cond_wait(&rec->job_done, &rec->lock);
+	const VkResult result = rec->result;
+	pthread_mutex_unlock(&rec->lock);
+	for (size_t i = 0; i < rec->nworkers; ++i) {
+		cmds[i] = rec->workers[i].cmds[slot];
+	}
+	return result;
+}
+
+void vkrecorder_destroy(struct vkrecorder *rec)
+{
+	pthread_mutex_lock(&rec->lock);
+	rec->quit = 1;
+	pthread_cond_broadcast(&rec->job_posted);
+	pthread_mutex_unlock(&rec->lock);
+	for (size_t i = 0; i < rec->nworkers; ++i) {
+		pthread_join(rec->workers[i].thread, NULL);
+		vkrecorder_destroy_pools(&rec->workers[i], rec->dev);
+	}
+	rec->nworkers = 0;
+	pthread_cond_destroy(&rec->job_done);
+	pthread_cond_destroy(&rec->job_posted);
+	pthread_mutex_destroy(&rec->lock);
+}
@@ -0,0 +1,139 @@
+#ifndef RENDERER_VKRECORDER_H
+#define RENDERER_VKRECORDER_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <renderer/vkdispatch.h>
+#include <vulkan/vulkan_core.h>
+
+/** Maximum number of recording threads */
+#define VKRECORDER_MAX_WORKERS 8
+
+/** Maximum number of frames recorded concurrently, one per frame in flight */
+#define VKRECORDER_MAX_SLOTS 4
+
+struct vkrecorder;
+
+/**
+ * Records slice of frame's draw list into secondary command buffer
+ * @param cmds Specifies secondary command buffer continuing render pass
+ * @param first Specifies index of the first draw to record
+ * @param count Specifies number of draws to record
+ * @param data Specifies user data of the draw list
+ */
+typedef void (*vkrecorder_draw_fn)(VkCommandBuffer cmds, size_t first,
+				   size_t count, void *data);
+
+/** Thread recording secondary command buffers */
+struct vkrecorder_worker {
+	/** Recorder this worker belongs to */
+	struct vkrecorder *rec;
+	/** Recording thread */
+	pthread_t thread;
+	/** Command pool per slot, used by this worker's thread only */
+	VkCommandPool pools[VKRECORDER_MAX_SLOTS];
+	/** Secondary command buffer per slot */
+	VkCommandBuffer cmds[VKRECORDER_MAX_SLOTS];
+	/** Number of the last job taken by this worker */
+	uint64_t job;
+};
+
+/**
+ * Pool of threads recording slices of frame into secondary buffers
+ *
+ * Renderer only clears the frame and attaches no draw list yet, so @a draw
+ * stays NULL and every thread records empty buffer. Until draws exist,
+ * VKRENDERER_RECORD_PARALLEL mode only measures overhead of waking threads
+ * and executing their buffers.
+ */
+struct vkrecorder {
+	/** Device command buffers are recorded on */
+	VkDevice dev;
+	/** Dispatch table of @a dev, called by recording threads */
+	const struct vkdispatch *vkd;
+	/** Host memory allocator of driver, or NULL */
+	const VkAllocationCallbacks *host;
+	/** Recording threads */
+	struct vkrecorder_worker workers[VKRECORDER_MAX_WORKERS];
+	/** Number of running threads */
+	size_t nworkers;
+	/** Number of slots each thread has command buffer for */
+	size_t nslots;
+	/** Guards job state below */
+	pthread_mutex_t lock;
+	/** Signaled when new job is posted or threads must quit */
+	pthread_cond_t job_posted;
+	/** Signaled when the last thread completes its slice of job */
+	pthread_cond_t job_done;
+	/** Number of the last posted job */
+	uint64_t job;
+	/** Number of threads still recording current job */
+	size_t npending;
+	/** Threads must quit */
+	int quit;
+	/** Slot recorded by current job */
+	size_t slot;
+	/** Rendering continued by current job */
+	VkCommandBufferInheritanceInfo inheritance;
+	/** The first error reported by threads for current job */
+	VkResult result;
+	/** Draw list callback, or NULL if frame has nothing to draw */
+	vkrecorder_draw_fn draw;
+	/** User data passed to @a draw */
+	void *data;
+	/** Number of draws in frame's draw list */
+	size_t ndraws;
+};
+
+#ifdef __cplusplus
+/* *INDENT-OFF* */
+extern "C" {
+/* *INDENT-ON* */
+#endif
+
+/**
+ * Initializes recorder and starts its threads
+ * @param rec Specifies recorder to initialize
+ * @param dev Specifies device to create command pools on
+ * @param vkd Specifies dispatch table of @a dev
+ * @param family Specifies queue family index buffers will be submitted to
+ * @param nworkers Specifies number of threads, at most VKRECORDER_MAX_WORKERS
+ * @param nslots Specifies number of slots, at most VKRECORDER_MAX_SLOTS
+ * @param host Specifies host memory allocator of driver, or NULL
+ * @returns zero on success, or non-zero otherwise
+ */
+int vkrecorder_init(struct vkrecorder *rec, VkDevice dev,
+		    const struct vkdispatch *vkd, uint32_t family,
+		    size_t nworkers, size_t nslots,
+		    const VkAllocationCallbacks *host);
+
+/**
+ * Records draw list into one secondary buffer per thread in parallel
+ *
+ * Draws are split into contiguous slices, one per thread. Commands
+ * previously recorded into @a slot must be complete.
+ * @param rec Specifies recorder
+ * @param slot Specifies slot to record command buffers of
+ * @param inheritance Specifies render pass or dynamic rendering the buffers
+ *                    continue, chained structures must outlive the call
+ * @param cmds Specifies array of @a nworkers recorded buffers, in draw order
+ * @returns VK_SUCCESS on success, or VkResult error otherwise
+ */
+VkResult vkrecorder_record(struct vkrecorder *rec, size_t slot,
+			   const VkCommandBufferInheritanceInfo *inheritance,
+			   VkCommandBuffer *cmds);
+
+/**
+ * Stops threads and destroys recorder resources
+ * @param rec Specifies recorder to destroy
+ */
+void vkrecorder_destroy(struct vkrecorder *rec);
+
+#ifdef __cplusplus
+/* *INDENT-OFF* */
+}
+/* *INDENT-ON* */
+#endif
+#endif
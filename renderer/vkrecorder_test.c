@@ -0,0 +1,198 @@
+/**
+ * @file
+ * Test suite for vkrecorder
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <cgreen/cgreen.h>
+#include <cgreen/mocks.h>
+
+#include <vulkan/vulkan_core.h>
+#include "vkrecorder.h"
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateCommandPool(
+	VkDevice device, const VkCommandPoolCreateInfo *pCreateInfo,
+	const VkAllocationCallbacks *pAllocator, VkCommandPool *pCommandPool)
+{
+	return (VkResult)mock(device, pCreateInfo, pAllocator, pCommandPool);
+}
+
+VKAPI_ATTR void VKAPI_CALL
+vkDestroyCommandPool(VkDevice device, VkCommandPool commandPool,
+		     const VkAllocationCallbacks *pAllocator)
+{
+	mock(device, commandPool, pAllocator);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkResetCommandPool(VkDevice device,
+						  VkCommandPool commandPool,
+						  VkCommandPoolResetFlags flags)
+{
+	return (VkResult)mock(device, commandPool, flags);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkAllocateCommandBuffers(
+	VkDevice device, const VkCommandBufferAllocateInfo *pAllocateInfo,
+	VkCommandBuffer *pCommandBuffers)
+{
+	return (VkResult)mock(device, pAllocateInfo, pCommandBuffers);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkBeginCommandBuffer(VkCommandBuffer commandBuffer,
+		     const VkCommandBufferBeginInfo *pBeginInfo)
+{
+	return (VkResult)mock(commandBuffer, pBeginInfo);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkEndCommandBuffer(VkCommandBuffer commandBuffer)
+{
+	return (VkResult)mock(commandBuffer);
+}
+
+/** Dispatch table calling mocked functions */
+static const struct vkdispatch mocked_dispatch = {
+	.vkResetCommandPool = vkResetCommandPool,
+	.vkBeginCommandBuffer = vkBeginCommandBuffer,
+	.vkEndCommandBuffer = vkEndCommandBuffer,
+};
+
+/** Rendering continued by recorded buffers */
+static const VkCommandBufferInheritanceInfo inheritance = {
+	.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+};
+
+/** Slice of draw list recorded by the last draw callback */
+static size_t drawn_first, drawn_count;
+
+/**
+ * Captures slice of draw list passed to callback
+ * @param cmds Specifies secondary command buffer
+ * @param first Specifies index of the first draw to record
+ * @param count Specifies number of draws to record
+ * @param data Specifies user data of draw list
+ */
+static void draw_slice(VkCommandBuffer cmds, size_t first, size_t count,
+		       void *data)
+{
+	(void)(cmds);
+	(void)(data);
+	drawn_first = first;
+	drawn_count = count;
+}
+
+/**
+ * Starts recorder with one thread and one slot
+ * @param rec Specifies recorder to start
+ * @param buffer Specifies secondary buffer allocated for the slot
+ */
+static void start_recorder(struct vkrecorder *rec, VkCommandBuffer buffer)
+{
+	expect(vkCreateCommandPool, will_return(VK_SUCCESS));
+	expect(vkAllocateCommandBuffers,
+	       will_set_contents_of_parameter(pCommandBuffers, &buffer,
+					      sizeof(buffer)),
+	       will_return(VK_SUCCESS));
+	vkrecorder_init(rec, VK_NULL_HANDLE, &mocked_dispatch, 0, 1, 1, NULL);
+}
+
+Ensure(init_allocates_buffer_per_slot_for_each_thread)
+{
+	struct vkrecorder rec;
+	const VkAllocationCallbacks host = { 0 };
+	for (size_t i = 0; i < 4; ++i) {
+		expect(vkCreateCommandPool, will_return(VK_SUCCESS),
+		       when(pAllocator, is_equal_to(&host)));
+		expect(vkAllocateCommandBuffers, will_return(VK_SUCCESS));
+	}
+	int error = vkrecorder_init(&rec, VK_NULL_HANDLE, &mocked_dispatch, 0,
+				    2, 2, &host);
+	assert_that(error, is_equal_to(0));
+	assert_that(rec.nworkers, is_equal_to(2));
+	always_expect(vkDestroyCommandPool);
+	vkrecorder_destroy(&rec);
+}
+
+Ensure(init_returns_non_zero_on_pool_fail)
+{
+	struct vkrecorder rec;
+	expect(vkCreateCommandPool, will_return(VK_SUCCESS));
+	expect(vkAllocateCommandBuffers, will_return(VK_SUCCESS));
+	expect(vkCreateCommandPool, will_return(VK_ERROR_OUT_OF_HOST_MEMORY));
+	always_expect(vkDestroyCommandPool);
+	int error = vkrecorder_init(&rec, VK_NULL_HANDLE, &mocked_dispatch, 0,
+				    1, 2, NULL);
+	assert_that(error, is_not_equal_to(0));
+	assert_that(rec.nworkers, is_equal_to(0));
+}
+
+Ensure(record_records_draw_list_into_secondary_buffer)
+{
+	struct vkrecorder rec;
+	VkCommandBuffer buffer = (VkCommandBuffer)0xCAFE;
+	start_recorder(&rec, buffer);
+	rec.draw = draw_slice;
+	rec.ndraws = 5;
+	expect(vkResetCommandPool, will_return(VK_SUCCESS));
+	expect(vkBeginCommandBuffer, will_return(VK_SUCCESS),
+	       when(commandBuffer, is_equal_to(buffer)));
+	expect(vkEndCommandBuffer, will_return(VK_SUCCESS));
+	VkCommandBuffer cmds[1] = { VK_NULL_HANDLE };
+	VkResult result = vkrecorder_record(&rec, 0, &inheritance, cmds);
+	assert_that(result, is_equal_to(VK_SUCCESS));
+	assert_that(cmds[0], is_equal_to(buffer));
+	assert_that(drawn_first, is_equal_to(0));
+	assert_that(drawn_count, is_equal_to(5));
+	always_expect(vkDestroyCommandPool);
+	vkrecorder_destroy(&rec);
+}
+
+Ensure(record_returns_error_reported_by_thread)
+{
+	struct vkrecorder rec;
+	start_recorder(&rec, VK_NULL_HANDLE);
+	expect(vkResetCommandPool, will_return(VK_SUCCESS));
+	expect(vkBeginCommandBuffer, will_return(VK_ERROR_OUT_OF_HOST_MEMORY));
+	never_expect(vkEndCommandBuffer);
+	VkCommandBuffer cmds[1];
+	VkResult result = vkrecorder_record(&rec, 0, &inheritance, cmds);
+	assert_that(result, is_equal_to(VK_ERROR_OUT_OF_HOST_MEMORY));
+	always_expect(vkDestroyCommandPool);
+	vkrecorder_destroy(&rec);
+}
+
+Ensure(record_records_empty_buffer_without_draw_list)
+{
+	struct vkrecorder rec;
+	start_recorder(&rec, VK_NULL_HANDLE);
+	expect(vkResetCommandPool, will_return(VK_SUCCESS));
+	expect(vkBeginCommandBuffer, will_return(VK_SUCCESS));
+	expect(vkEndCommandBuffer, will_return(VK_SUCCESS));
+	VkCommandBuffer cmds[1];
+	VkResult result = vkrecorder_record(&rec, 0, &inheritance, cmds);
+	assert_that(result, is_equal_to(VK_SUCCESS));
+	always_expect(vkDestroyCommandPool);
+	vkrecorder_destroy(&rec);
+}
+
+int main(int argc, char **argv)
+{
+	(void)(argc);
+	(void)(argv);
+	TestSuite *suite = create_named_test_suite("VKRecorder");
+	add_test(suite, init_allocates_buffer_per_slot_for_each_thread);
+	add_test(suite, init_returns_non_zero_on_pool_fail);
+	add_test(suite, record_records_draw_list_into_secondary_buffer);
+	add_test(suite, record_returns_error_reported_by_thread);
+	add_test(suite, record_records_empty_buffer_without_draw_list);
+	TestReporter *reporter = create_text_reporter();
+	int exit_code = run_test_suite(suite, reporter);
+	destroy_reporter(reporter);
+	destroy_test_suite(suite);
+	return exit_code;
+}
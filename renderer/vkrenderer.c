@@ -7,9 +7,41 @@
 #endif
 
 #include <stddef.h>
+#include <stdint.h>
+#include <unistd.h>
 
+#include "vkbudget.h"
+#include "vkcmdpool.h"
+#include "vkcompiler.h"
+#include "vkcompute.h"
+#include "vkdefrag.h"
+#include "vkflight.h"
+#include "vkhost.h"
+#include "vkmemory.h"
+#include "vkpipecache.h"
+#include "vkpipereg.h"
+#include "vkqueues.h"
+#include "vkrecorder.h"
 #include "vkrenderer.h"
+#include "vkstaging.h"
 #include "vkswapchain.h"
+#include "vktransfer.h"
+#include "vkuniform.h"
+
+/**
+ * Returns number of graphics queues to request from device
+ * @param rdr Specifies renderer to get number of queues of
+ * @returns number of graphics queues, at least one
+ */
+static uint32_t vkrenderer_graphics_queues(const struct vkrenderer *rdr)
+{
+	uint32_t count = rdr->max_queues ? rdr->max_queues : 1;
+	if (count > rdr->graphic_nqueues)
+		count = rdr->graphic_nqueues;
+	if (count > VKRENDERER_MAX_QUEUES)
+		count = VKRENDERER_MAX_QUEUES;
+	return count ? count : 1;
+}
 
 /**
  * Create Vulkan device for renderer
@@ -18,23 +50,29 @@
  */
 static VkResult vkrenderer_create_device(struct vkrenderer *rdr)
 {
-	float queue_priorities = 1.0F;
-	VkDeviceQueueCreateInfo qinfos[2] = {
-		{
-			.queueFamilyIndex = rdr->graphic,
-		},
-		{
-			.queueFamilyIndex = rdr->present,
-		},
-	};
-	uint32_t nqinfos = (rdr->graphic == rdr->present) ? 1 : 2;
-	for (size_t i = 0; i < nqinfos; ++i) {
-		VkDeviceQueueCreateInfo *info = &qinfos[i];
+	/* Queues are equal, so no submitting thread is starved */
+	float queue_priorities[VKRENDERER_MAX_QUEUES];
+	for (size_t i = 0; i < ARRAY_SIZE(queue_priorities); ++i) {
+		queue_priorities[i] = 1.0F;
+	}
+	const uint32_t families[] = { rdr->graphic, rdr->present,
+				      rdr->compute, rdr->transfer };
+	VkDeviceQueueCreateInfo qinfos[ARRAY_SIZE(families)];
+	uint32_t nqinfos = 0;
+	for (size_t i = 0; i < ARRAY_SIZE(families); ++i) {
+		size_t j = 0;
+		while (j < nqinfos && qinfos[j].queueFamilyIndex != families[i])
+			++j;
+		if (j < nqinfos)
+			continue;
+		VkDeviceQueueCreateInfo *info = &qinfos[nqinfos++];
+		info->queueFamilyIndex = families[i];
 		info->sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
 		info->pNext = NULL;
 		info->flags = 0;
-		info->queueCount = 1;
-		info->pQueuePriorities = &queue_priorities;
+		/* Graphics family is the first one */
+		info->queueCount = i ? 1 : vkrenderer_graphics_queues(rdr);
+		info->pQueuePriorities = queue_priorities;
 	}
 	VkDeviceCreateInfo dev_info = {
 		.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
@@ -48,95 +86,128 @@ static VkResult vkrenderer_create_device(struct vkrenderer *rdr)
 		.ppEnabledExtensionNames = rdr->extensions,
 		.pEnabledFeatures = &rdr->features,
 	};
-	return vkCreateDevice(rdr->phy, &dev_info, NULL, &rdr->device);
+	dev_info.pNext = rdr->features_chain;
+	VkResult result =
+		vkCreateDevice(rdr->phy, &dev_info, &rdr->host.callbacks,
+			       &rdr->device);
+	if (result != VK_SUCCESS)
+		return result;
+	vkdispatch_init(&rdr->vkd, rdr->device);
+	return VK_SUCCESS;
 }
 
 /**
- * Initialize command pool for renderer
- * @param rdr Specifies renderer to initialize command pool for
+ * Initializes render pass clearing surface image and presenting it
+ * @param rdr Specifies renderer to get render pass from cache of
  * @returns VK_SUCCESS on success, or VkResult error otherwise
  */
-static VkResult vkrenderer_init_command_pool(struct vkrenderer *rdr)
+static VkResult vkrenderer_init_render_pass(struct vkrenderer *rdr)
 {
-	VkCommandPoolCreateInfo info = {
-		.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
-		.pNext = NULL,
-		.flags = 0,
-		.queueFamilyIndex = rdr->graphic,
+	const struct vkrpcache_key key = {
+		.ncolors = 1,
+		.colors = { {
+			.format = rdr->srf_format.format,
+			.samples = VK_SAMPLE_COUNT_1_BIT,
+			.load = VK_ATTACHMENT_LOAD_OP_CLEAR,
+			.store = VK_ATTACHMENT_STORE_OP_STORE,
+			.initial = VK_IMAGE_LAYOUT_UNDEFINED,
+			.final = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+		} },
+		.depth = { .format = VK_FORMAT_UNDEFINED },
 	};
-	return vkCreateCommandPool(rdr->device, &info, NULL, &rdr->cmd_pool);
+	return vkrpcache_get(&rdr->rp_cache, rdr->device, &key, &rdr->rpass);
+}
+
+/**
+ * Initializes ring of frames in flight
+ * @param rdr Specifies renderer to initialize frames in flight for
+ * @returns zero on success, or non-zero otherwise
+ */
+static int vkrenderer_init_flights(struct vkrenderer *rdr)
+{
+	if (rdr->nflights == 0) {
+		rdr->nflights = VKRENDERER_DEFAULT_FLIGHTS;
+	} else if (rdr->nflights > ARRAY_SIZE(rdr->flights)) {
+		rdr->nflights = ARRAY_SIZE(rdr->flights);
+	}
+	for (size_t i = 0; i < rdr->nflights; ++i) {
+		struct vkflight *flight = &rdr->flights[i];
+		if (vkflight_init(flight, rdr->device, &rdr->host.callbacks) !=
+		    VK_SUCCESS)
+			return -1;
+		if (rdr->record_mode != VKRENDERER_RECORD_ONCE &&
+		    vkflight_init_commands(flight, rdr->device, rdr->graphic) !=
+			    VK_SUCCESS)
+			return -1;
+	}
+	rdr->flight_index = 0;
+	return 0;
 }
 
 /**
- * Initializes renderpass for renderer
- * @param rpass Specifies renderpass to initialize
- * @param format Specifies format of render targets
- * @param dev Specifies device to use
+ * Starts threads recording frames in parallel
+ * @param rdr Specifies renderer to start recording threads for
+ * @returns zero on success, or non-zero otherwise
+ */
+static int vkrenderer_init_recorder(struct vkrenderer *rdr)
+{
+	if (rdr->nworkers == 0) {
+		const long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+		rdr->nworkers = (ncpus > 0) ? (size_t)ncpus : 1;
+	}
+	if (rdr->nworkers > VKRECORDER_MAX_WORKERS) {
+		rdr->nworkers = VKRECORDER_MAX_WORKERS;
+	}
+	return vkrecorder_init(&rdr->recorder, rdr->device, &rdr->vkd,
+			       rdr->graphic, rdr->nworkers, rdr->nflights,
+			       &rdr->host.callbacks);
+}
+
+/**
+ * Starts threads compiling pipelines
+ * @param rdr Specifies renderer to start compiling threads for
+ * @returns zero on success, or non-zero otherwise
+ */
+static int vkrenderer_init_compiler(struct vkrenderer *rdr)
+{
+	if (rdr->compile_workers == 0) {
+		rdr->compile_workers = VKRENDERER_DEFAULT_COMPILE_WORKERS;
+	}
+	if (rdr->compile_workers > VKCOMPILER_MAX_WORKERS) {
+		rdr->compile_workers = VKCOMPILER_MAX_WORKERS;
+	}
+	const int cache_control =
+		(rdr->caps & VKRENDERER_CAP_PIPELINE_CACHE_CONTROL) != 0;
+	return vkcompiler_init(&rdr->compiler, rdr->device,
+			       rdr->pipeline_cache.cache, cache_control,
+			       rdr->compile_workers, &rdr->host.callbacks);
+}
+
+/**
+ * Initializes timeline semaphore counting completed frames
+ * @param rdr Specifies renderer to initialize timeline semaphore for
  * @returns VK_SUCCESS on success, or VkResult error otherwise
  */
-static VkResult vkrenderer_init_render_pass(VkRenderPass *rpass,
-					    const VkFormat format,
-					    const VkDevice dev)
+static VkResult vkrenderer_init_timeline(struct vkrenderer *rdr)
 {
-	VkAttachmentDescription attachments[] = {
-		{
-			.flags = 0,
-			.format = format,
-			.samples = VK_SAMPLE_COUNT_1_BIT,
-			.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-			.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
-			.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
-			.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-			.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-			.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
-		},
-	};
-	VkAttachmentReference attachment_refs[] = {
-		{
-			.attachment = 0,
-			.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-		},
-	};
-	VkSubpassDescription subpasses[] = {
-		{
-			.flags = 0,
-			.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
-			.inputAttachmentCount = 0,
-			.pInputAttachments = NULL,
-			.colorAttachmentCount = ARRAY_SIZE(attachment_refs),
-			.pColorAttachments = attachment_refs,
-			.pResolveAttachments = NULL,
-			.pDepthStencilAttachment = NULL,
-			.preserveAttachmentCount = 0,
-			.pPreserveAttachments = NULL,
-		},
-	};
-	VkSubpassDependency dependencies[] = {
-		{
-			.srcSubpass = VK_SUBPASS_EXTERNAL,
-			.dstSubpass = 0,
-			.srcStageMask =
-				VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-			.dstStageMask =
-				VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-			.srcAccessMask = 0,
-			.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT |
-					 VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-			.dependencyFlags = 0,
-		},
-	};
-	VkRenderPassCreateInfo info = {
-		.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+	rdr->frame = 0;
+	rdr->completed = 0;
+	rdr->timeline = VK_NULL_HANDLE;
+	if (!(rdr->caps & VKRENDERER_CAP_TIMELINE_SEMAPHORE))
+		return VK_SUCCESS;
+	VkSemaphoreTypeCreateInfo type_info = {
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
 		.pNext = NULL,
+		.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+		.initialValue = 0,
+	};
+	VkSemaphoreCreateInfo info = {
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+		.pNext = &type_info,
 		.flags = 0,
-		.attachmentCount = ARRAY_SIZE(attachments),
-		.pAttachments = attachments,
-		.subpassCount = ARRAY_SIZE(subpasses),
-		.pSubpasses = subpasses,
-		.dependencyCount = ARRAY_SIZE(dependencies),
-		.pDependencies = dependencies,
 	};
-	return vkCreateRenderPass(dev, &info, NULL, rpass);
+	return vkCreateSemaphore(rdr->device, &info, &rdr->host.callbacks,
+				 &rdr->timeline);
 }
 
 int vkrenderer_init(struct vkrenderer *rdr, VkInstance instance,
@@ -146,52 +217,360 @@ int vkrenderer_init(struct vkrenderer *rdr, VkInstance instance,
 	if (vkrenderer_configure(rdr, instance)) {
 		return -1;
 	}
+	if (vkhost_init(&rdr->host, rdr->host_mode)) {
+		return -1;
+	}
+	const VkAllocationCallbacks *host = &rdr->host.callbacks;
 	if (vkrenderer_create_device(rdr) != VK_SUCCESS) {
 		return -1;
 	}
 	vkGetDeviceQueue(rdr->device, rdr->graphic, 0, &rdr->graphics_queue);
 	vkGetDeviceQueue(rdr->device, rdr->present, 0, &rdr->present_queue);
-	if (vkrenderer_init_command_pool(rdr) != VK_SUCCESS) {
+	vkGetDeviceQueue(rdr->device, rdr->compute, 0, &rdr->compute_queue);
+	vkGetDeviceQueue(rdr->device, rdr->transfer, 0, &rdr->transfer_queue);
+	vkqueues_init(&rdr->queues, rdr->device, rdr->graphic, 1,
+		      vkrenderer_graphics_queues(rdr) - 1);
+	vkmemory_init(&rdr->memory, rdr->phy, rdr->device, host);
+	vkbudget_init(&rdr->budget, &rdr->memory, rdr->phy,
+		      (rdr->caps & VKRENDERER_CAP_MEMORY_BUDGET) != 0);
+	if (vkcmdpool_init(&rdr->cmd_pool, rdr->device, rdr->graphic, host) !=
+	    VK_SUCCESS) {
+		return -1;
+	}
+	if (vkcompute_init(&rdr->compute_jobs, rdr->device, &rdr->vkd,
+			   rdr->compute, rdr->compute_queue,
+			   host) != VK_SUCCESS) {
+		return -1;
+	}
+	if (vktransfer_init(&rdr->uploads, rdr->device, &rdr->vkd,
+			    rdr->transfer, rdr->transfer_queue, rdr->graphic,
+			    rdr->graphics_queue, host) != VK_SUCCESS) {
+		return -1;
+	}
+	if (vkuniform_init(&rdr->uniforms, &rdr->memory, rdr->phy,
+			   VKRENDERER_UNIFORM_SIZE) != VK_SUCCESS) {
+		return -1;
+	}
+	const VkDeviceSize budget = rdr->upload_budget ?
+					    rdr->upload_budget :
+					    VKRENDERER_DEFAULT_UPLOAD_BUDGET;
+	if (vkstaging_init(&rdr->staging, &rdr->uploads, &rdr->memory,
+			   VKRENDERER_STAGING_SIZE, budget) != VK_SUCCESS) {
+		return -1;
+	}
+	const uint64_t defrag_budget =
+		rdr->defrag_budget_ns ? rdr->defrag_budget_ns :
+					VKRENDERER_DEFAULT_DEFRAG_BUDGET_NS;
+	if (vkdefrag_init(&rdr->defrag, &rdr->memory, &rdr->vkd, rdr->graphic,
+			  rdr->graphics_queue, defrag_budget) != VK_SUCCESS) {
+		return -1;
+	}
+	vkrpcache_init(&rdr->rp_cache, host);
+	if (vkpipecache_init(&rdr->pipeline_cache, rdr->phy, rdr->device,
+			     rdr->pipeline_cache_path, host) != VK_SUCCESS) {
 		return -1;
 	}
-	const VkFormat fmt = rdr->srf_format.format;
-	const VkDevice dev = rdr->device;
-	if (vkrenderer_init_render_pass(&rdr->rpass, fmt, dev) != VK_SUCCESS) {
+	if (vkrenderer_init_compiler(rdr)) {
+		return -1;
+	}
+	if (vkpipereg_init(&rdr->pipelines, &rdr->compiler)) {
+		return -1;
+	}
+	rdr->rpass = VK_NULL_HANDLE;
+	/* Dynamic rendering begins rendering without render pass object */
+	if (!(rdr->caps & VKRENDERER_CAP_DYNAMIC_RENDERING) &&
+	    vkrenderer_init_render_pass(rdr) != VK_SUCCESS) {
+		return -1;
+	}
+	if (vkrenderer_init_flights(rdr)) {
+		return -1;
+	}
+	if (rdr->record_mode == VKRENDERER_RECORD_PARALLEL &&
+	    vkrenderer_init_recorder(rdr)) {
+		return -1;
+	}
+	if (vkrenderer_init_timeline(rdr) != VK_SUCCESS) {
 		return -1;
 	}
 
 	rdr->swc_index = 0;
+	rdr->nretired = 0;
+	rdr->swc_outdated = 0;
 	return vkswapchain_init(&rdr->swcs[rdr->swc_index], rdr,
 				VK_NULL_HANDLE);
 }
 
-int vkrenderer_render(struct vkrenderer *rdr)
+/**
+ * Returns retired swapchain in ring of swapchains
+ * @param rdr Specifies renderer to get swapchain of
+ * @param age Specifies index of retired swapchain, zero is the oldest
+ * @returns pointer to retired swapchain
+ */
+static const struct vkswapchain *
+vkrenderer_retired(const struct vkrenderer *rdr, size_t age)
+{
+	const size_t nswcs = ARRAY_SIZE(rdr->swcs);
+	const size_t index = rdr->swc_index + nswcs - rdr->nretired + age;
+	return &rdr->swcs[index % nswcs];
+}
+
+/**
+ * Destroys retired swapchains whose frames are completed by GPU
+ * @param rdr Specifies renderer to destroy retired swapchains of
+ */
+static void vkrenderer_collect_swapchains(struct vkrenderer *rdr)
 {
+	while (rdr->nretired > 0) {
+		const struct vkswapchain *oldest = vkrenderer_retired(rdr, 0);
+		if (oldest->retired_frame > rdr->completed) {
+			break;
+		}
+		vkswapchain_terminate(oldest, rdr);
+		rdr->nretired--;
+	}
+}
+
+/**
+ * Recreates swapchain of renderer with current surface parameters
+ *
+ * Old swapchain is retired and destroyed once GPU completes its frames. If
+ * surface has zero size, swapchain stays outdated and nothing is recreated.
+ * @param rdr Specifies renderer to recreate swapchain for
+ * @returns zero on success, or non-zero otherwise
+ */
+static int vkrenderer_recreate_swapchain(struct vkrenderer *rdr)
+{
+	if (vkrenderer_configure_swapchain(rdr)) {
+		return -1;
+	}
+	const VkExtent2D extent = rdr->srf_caps.currentExtent;
+	if (extent.width == 0 || extent.height == 0) {
+		rdr->swc_outdated = 1;
+		return 0;
+	}
+	if (rdr->nretired == ARRAY_SIZE(rdr->swcs) - 1) {
+		const struct vkswapchain *oldest = vkrenderer_retired(rdr, 0);
+		if (vkrenderer_wait_frame(rdr, oldest->retired_frame)) {
+			return -1;
+		}
+		vkrenderer_collect_swapchains(rdr);
+	}
 	struct vkswapchain *swc = &rdr->swcs[rdr->swc_index];
-	VkResult result = vkswapchain_render(swc, rdr);
+	size_t swc_index = (rdr->swc_index + 1) % ARRAY_SIZE(rdr->swcs);
+	struct vkswapchain *new_swc = &rdr->swcs[swc_index];
+	if (vkswapchain_init(new_swc, rdr, swc->swapchain)) {
+		return -1;
+	}
+	swc->retired_frame = rdr->frame;
+	rdr->nretired++;
+	rdr->swc_index = swc_index;
+	rdr->swc_outdated = 0;
+	return 0;
+}
+
+int vkrenderer_render(struct vkrenderer *rdr)
+{
+	vkrenderer_collect_swapchains(rdr);
+	/* Completed uploads are acquired before frame uses them */
+	if (rdr->uploads.count > 0 &&
+	    vktransfer_collect(&rdr->uploads) != VK_SUCCESS) {
+		return -1;
+	}
+	/* Large uploads are spread over frames instead of stalling one */
+	uint64_t ticket;
+	if (vkstaging_flush(&rdr->staging, &ticket) != VK_SUCCESS) {
+		return -1;
+	}
+	if (rdr->swc_outdated && vkrenderer_recreate_swapchain(rdr)) {
+		return -1;
+	}
+	if (rdr->swc_outdated) {
+		return 0;
+	}
+	struct vkflight *flight = &rdr->flights[rdr->flight_index];
+	/* Slot is reused once its previous frame, N-k or older, completes */
+	if (vkrenderer_wait_frame(rdr, flight->frame)) {
+		return -1;
+	}
+	vkuniform_collect(&rdr->uniforms, rdr->completed);
+	/* Budget changes slowly, querying it every frame costs for nothing */
+	if (rdr->frame % VKRENDERER_BUDGET_PERIOD == 0) {
+		vkbudget_update(&rdr->budget);
+		vkbudget_trim(&rdr->budget, rdr->completed);
+	}
+	/* Moves start before frame is recorded, so it uses moved resources */
+	if (vkdefrag_step(&rdr->defrag, rdr->frame, rdr->completed) !=
+	    VK_SUCCESS) {
+		return -1;
+	}
+	rdr->flight_index = (rdr->flight_index + 1) % rdr->nflights;
+	VkResult result =
+		vkswapchain_render(&rdr->swcs[rdr->swc_index], rdr, flight);
+	/* Only failed acquire is retried, nothing of frame is submitted */
 	if (result == VK_ERROR_OUT_OF_DATE_KHR) {
-		vkDeviceWaitIdle(rdr->device);
-		size_t swc_index = (rdr->swc_index + 1) % ARRAY_SIZE(rdr->swcs);
-		struct vkswapchain *new_swc = &rdr->swcs[swc_index];
-		if (vkrenderer_configure_swapchain(rdr)) {
+		if (vkrenderer_recreate_swapchain(rdr)) {
 			return -1;
 		}
-		if (vkswapchain_init(new_swc, rdr, swc->swapchain)) {
-			return -1;
+		if (rdr->swc_outdated) {
+			return 0;
 		}
-		vkswapchain_terminate(swc, rdr->device);
-		rdr->swc_index = swc_index;
-		swc = new_swc;
-		result = vkswapchain_render(swc, rdr);
+		result = vkswapchain_render(&rdr->swcs[rdr->swc_index], rdr,
+					    flight);
+	}
+	/* Suboptimal swapchain still presents, so recreate it next frame */
+	if (result == VK_SUBOPTIMAL_KHR) {
+		rdr->swc_outdated = 1;
+		return 0;
 	}
 	return result != VK_SUCCESS;
 }
 
-void vkrenderer_terminate(const struct vkrenderer *rdr)
+void vkrenderer_resize(struct vkrenderer *rdr)
+{
+	rdr->swc_outdated = 1;
+}
+
+void vkrenderer_set_present_policy(struct vkrenderer *rdr,
+				   enum vkrenderer_present_policy policy)
+{
+	if (rdr->present_policy != policy) {
+		rdr->present_policy = policy;
+		rdr->swc_outdated = 1;
+	}
+}
+
+int vkrenderer_wait_frame(struct vkrenderer *rdr, uint64_t frame)
+{
+	if (frame <= rdr->completed) {
+		return 0;
+	}
+	if (frame > rdr->frame) {
+		return -1;
+	}
+	if (rdr->caps & VKRENDERER_CAP_TIMELINE_SEMAPHORE) {
+		VkSemaphoreWaitInfo info = {
+			.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+			.pNext = NULL,
+			.flags = 0,
+			.semaphoreCount = 1,
+			.pSemaphores = &rdr->timeline,
+			.pValues = &frame,
+		};
+		if (rdr->vkd.vkWaitSemaphores(rdr->device, &info,
+					      UINT64_MAX) != VK_SUCCESS) {
+			return -1;
+		}
+	} else {
+		/* Older frames were waited for when their slots were reused */
+		for (size_t i = 0; i < rdr->nflights; ++i) {
+			const struct vkflight *flight = &rdr->flights[i];
+			if (flight->frame <= rdr->completed ||
+			    flight->frame > frame) {
+				continue;
+			}
+			if (vkflight_wait(flight, rdr->device, &rdr->vkd) !=
+			    VK_SUCCESS) {
+				return -1;
+			}
+		}
+	}
+	rdr->completed = frame;
+	return 0;
+}
+
+uint64_t vkrenderer_completed_frame(struct vkrenderer *rdr)
+{
+	if (rdr->caps & VKRENDERER_CAP_TIMELINE_SEMAPHORE) {
+		uint64_t value;
+		if (rdr->vkd.vkGetSemaphoreCounterValue(
+			    rdr->device, rdr->timeline, &value) == VK_SUCCESS &&
+		    value > rdr->completed) {
+			rdr->completed = value;
+		}
+		return rdr->completed;
+	}
+	/* Frame counts as completed only when all older frames are too */
+	uint64_t pending = UINT64_MAX;
+	uint64_t signaled[ARRAY_SIZE(rdr->flights)];
+	size_t nsignaled = 0;
+	for (size_t i = 0; i < rdr->nflights; ++i) {
+		const struct vkflight *flight = &rdr->flights[i];
+		if (flight->frame <= rdr->completed) {
+			continue;
+		}
+		VkResult status =
+			rdr->vkd.vkGetFenceStatus(rdr->device, flight->fence);
+		if (status == VK_SUCCESS) {
+			signaled[nsignaled++] = flight->frame;
+		} else if (flight->frame < pending) {
+			pending = flight->frame;
+		}
+	}
+	for (size_t i = 0; i < nsignaled; ++i) {
+		if (signaled[i] < pending && signaled[i] > rdr->completed) {
+			rdr->completed = signaled[i];
+		}
+	}
+	return rdr->completed;
+}
+
+void vkrenderer_terminate(struct vkrenderer *rdr)
 {
 	vkDeviceWaitIdle(rdr->device);
-	vkswapchain_terminate(&rdr->swcs[rdr->swc_index], rdr->device);
-	vkDestroyRenderPass(rdr->device, rdr->rpass, NULL);
-	vkDestroyCommandPool(rdr->device, rdr->cmd_pool, NULL);
-	vkDestroyDevice(rdr->device, NULL);
+	for (size_t i = 0; i < rdr->nretired; ++i) {
+		vkswapchain_terminate(vkrenderer_retired(rdr, i), rdr);
+	}
+	vkswapchain_terminate(&rdr->swcs[rdr->swc_index], rdr);
+	if (rdr->record_mode == VKRENDERER_RECORD_PARALLEL) {
+		vkrecorder_destroy(&rdr->recorder);
+	}
+	for (size_t i = 0; i < rdr->nflights; ++i) {
+		vkflight_destroy(&rdr->flights[i], rdr->device);
+	}
+	vkDestroySemaphore(rdr->device, rdr->timeline, &rdr->host.callbacks);
+	vkrpcache_destroy(&rdr->rp_cache, rdr->device);
+	vkpipereg_destroy(&rdr->pipelines);
+	/* Failing to save only makes the next launch compile again */
+	if (rdr->pipeline_cache_path != NULL) {
+		VkPipelineCache caches[VKCOMPILER_MAX_WORKERS];
+		const uint32_t ncaches =
+			vkcompiler_caches(&rdr->compiler, caches);
+		vkpipecache_merge(&rdr->pipeline_cache, caches, ncaches);
+		vkpipecache_save(&rdr->pipeline_cache,
+				 rdr->pipeline_cache_path);
+	}
+	vkcompiler_destroy(&rdr->compiler);
+	vkpipecache_destroy(&rdr->pipeline_cache);
+	vkdefrag_destroy(&rdr->defrag);
+	vkstaging_destroy(&rdr->staging, &rdr->memory);
+	vktransfer_destroy(&rdr->uploads);
+	vkcompute_destroy(&rdr->compute_jobs);
+	vkcmdpool_destroy(&rdr->cmd_pool, rdr->device);
+	vkuniform_destroy(&rdr->uniforms, &rdr->memory);
+	vkmemory_destroy(&rdr->memory);
+	vkDestroyDevice(rdr->device, &rdr->host.callbacks);
+	vkhost_destroy(&rdr->host);
+}
+
+VkResult vkrenderer_begin_compute(struct vkrenderer *rdr,
+				  VkCommandBuffer *cmds)
+{
+	struct vkcompute *cmp = &rdr->compute_jobs;
+	vkcompute_collect(cmp, vkrenderer_completed_frame(rdr));
+	if (cmp->count == VKCOMPUTE_MAX_JOBS) {
+		/* Frame waiting for job completes only after job itself */
+		const uint64_t frame = cmp->jobs[cmp->head].frame;
+		if (frame == 0)
+			return VK_NOT_READY;
+		if (vkrenderer_wait_frame(rdr, frame))
+			return VK_ERROR_DEVICE_LOST;
+		vkcompute_collect(cmp, rdr->completed);
+	}
+	return vkcompute_begin(cmp, cmds);
+}
+
+VkResult vkrenderer_submit_compute(struct vkrenderer *rdr,
+				   VkPipelineStageFlags stage)
+{
+	return vkcompute_submit(&rdr->compute_jobs, stage);
 }
@@ -3,48 +3,257 @@
 
 #include <stdint.h>
 
+#include <renderer/vkbudget.h>
+#include <renderer/vkcmdpool.h>
+#include <renderer/vkcompiler.h>
+#include <renderer/vkcompute.h>
+#include <renderer/vkdefrag.h>
+#include <renderer/vkdispatch.h>
+#include <renderer/vkflight.h>
+#include <renderer/vkhost.h>
+#include <renderer/vkmemory.h>
+#include <renderer/vkpipecache.h>
+#include <renderer/vkpipereg.h>
+#include <renderer/vkqueues.h>
+#include <renderer/vkrecorder.h>
+#include <renderer/vkrpcache.h>
+#include <renderer/vkstaging.h>
 #include <renderer/vkswapchain.h>
+#include <renderer/vktransfer.h>
+#include <renderer/vkuniform.h>
 #include <vulkan/vulkan_core.h>
 
 /** Returns array size */
 #define ARRAY_SIZE(x) (sizeof(x) / sizeof((x)[0]))
 
+/** Maximum number of frames in flight */
+#define VKRENDERER_MAX_FLIGHTS 4
+
+/** Maximum number of graphics queues, one of them is used by renderer */
+#define VKRENDERER_MAX_QUEUES (VKQUEUES_MAX + 1)
+
+/** Maximum number of current and retired swapchains */
+#define VKRENDERER_MAX_SWAPCHAINS 4
+
+/** Size of ring of uniform data written by frames in flight */
+#define VKRENDERER_UNIFORM_SIZE ((VkDeviceSize)4 * 1024 * 1024)
+
+/** Size of ring staging uploads of frames */
+#define VKRENDERER_STAGING_SIZE ((VkDeviceSize)16 * 1024 * 1024)
+
+/** Number of bytes uploaded per frame when no budget is requested */
+#define VKRENDERER_DEFAULT_UPLOAD_BUDGET ((VkDeviceSize)4 * 1024 * 1024)
+
+/** Number of frames between queries of memory budget */
+#define VKRENDERER_BUDGET_PERIOD 16
+
+/** Nanoseconds per frame defragmentation may take when none is requested */
+#define VKRENDERER_DEFAULT_DEFRAG_BUDGET_NS 250000
+
+/** Number of threads compiling pipelines when none is requested */
+#define VKRENDERER_DEFAULT_COMPILE_WORKERS 2
+
+/** Number of frames in flight used when none is requested */
+#define VKRENDERER_DEFAULT_FLIGHTS 2
+
+/** Number of images queued for display in FIFO modes when none is requested */
+#define VKRENDERER_DEFAULT_LATENCY_BUDGET 2
+
+/** Device supports timeline semaphores */
+#define VKRENDERER_CAP_TIMELINE_SEMAPHORE (1U << 0)
+
+/** Device renders without render pass and framebuffer objects */
+#define VKRENDERER_CAP_DYNAMIC_RENDERING (1U << 1)
+
+/** Device creates framebuffers without attachments bound, used if dynamic
+ * rendering is not supported */
+#define VKRENDERER_CAP_IMAGELESS_FRAMEBUFFER (1U << 2)
+
+/** Device records barriers and submits with synchronization2 commands */
+#define VKRENDERER_CAP_SYNCHRONIZATION2 (1U << 3)
+
+/** Device reports memory heap budgets and usage */
+#define VKRENDERER_CAP_MEMORY_BUDGET (1U << 4)
+
+/** Device indexes partially bound runtime sized descriptor arrays */
+#define VKRENDERER_CAP_DESCRIPTOR_INDEXING (1U << 5)
+
+/** Device creates pipelines failing instead of compiling on cache miss */
+#define VKRENDERER_CAP_PIPELINE_CACHE_CONTROL (1U << 6)
+
+/** Device correlates its timestamps with host clock */
+#define VKRENDERER_CAP_CALIBRATED_TIMESTAMPS (1U << 7)
+
+/** Maximum number of physical devices considered by configuration */
+#define VKRENDERER_MAX_DEVICES 16
+
+/** Maximum number of enabled device extensions */
+#define VKRENDERER_MAX_EXTENSIONS 8
+
+/** Goal of present mode selection */
+enum vkrenderer_present_policy {
+	/** Wait for vertical blank, the only mode supported everywhere */
+	VKRENDERER_PRESENT_POWER = 0,
+	/** Show the newest image as soon as possible */
+	VKRENDERER_PRESENT_LATENCY,
+	/** Render as many frames as possible without waiting for display */
+	VKRENDERER_PRESENT_THROUGHPUT,
+	/** Number of present policies */
+	VKRENDERER_PRESENT_POLICIES,
+};
+
+/** How command buffers of frames are recorded */
+enum vkrenderer_record_mode {
+	/** Record once per swapchain image and resubmit it every frame */
+	VKRENDERER_RECORD_ONCE = 0,
+	/** Record anew every frame into transient pool of frame in flight */
+	VKRENDERER_RECORD_PER_FRAME,
+	/** Record every frame on worker threads into secondary buffers */
+	VKRENDERER_RECORD_PARALLEL,
+	/** Number of record modes */
+	VKRENDERER_RECORD_MODES,
+};
+
+/** Renderer statistics */
+struct vkrenderer_stats {
+	/** Number of acquired swapchain images */
+	uint64_t nacquires;
+	/** Total time spent acquiring swapchain images, in nanoseconds */
+	uint64_t acquire_stall_ns;
+	/** Longest time spent acquiring swapchain image, in nanoseconds */
+	uint64_t max_acquire_stall_ns;
+	/** Number of submitted frames */
+	uint64_t nsubmits;
+	/** Total time spent recording and submitting frames, in nanoseconds */
+	uint64_t submit_ns;
+};
+
 /** Vulkan Renderer Instance */
 struct vkrenderer {
 	/** Target surface presenting rendered image */
 	VkSurfaceKHR srf;
 	/** Physical device */
 	VkPhysicalDevice phy;
+	/** File remembering selected device, NULL disables, set before init */
+	const char *device_cache;
+	/** File keeping compiled pipelines, NULL disables, set before init */
+	const char *pipeline_cache_path;
 	/** Enabled device features */
 	VkPhysicalDeviceFeatures features;
+	/** Enabled Vulkan 1.2 device features */
+	VkPhysicalDeviceVulkan12Features features12;
+	/** Enabled Vulkan 1.3 device features, chained to @a features12 */
+	VkPhysicalDeviceVulkan13Features features13;
+	/** Feature structures chained to device creation, or NULL */
+	const void *features_chain;
+	/** Capabilities of configured device, see VKRENDERER_CAP_* */
+	uint32_t caps;
 	/** Enabled logical device extensions */
-	const char *const *extensions;
+	const char *extensions[VKRENDERER_MAX_EXTENSIONS];
 	/** Number of enabled logical device extensions */
 	uint32_t nextensions;
 	/** Queue family index that supports graphics operations */
 	uint32_t graphic;
+	/** Number of queues in graphics family */
+	uint32_t graphic_nqueues;
 	/** Queue family index that supports presentation */
 	uint32_t present;
+	/** Queue family index running compute jobs */
+	uint32_t compute;
+	/** Queue family index running uploads, graphics one if no dedicated */
+	uint32_t transfer;
+	/** Host memory allocator passed to every create and destroy call */
+	struct vkhost host;
+	/** Allocator serving host allocations of driver, set before init */
+	enum vkhost_mode host_mode;
 	/** Vulkan device */
 	VkDevice device;
+	/** Device functions called on hot paths, loaded from driver */
+	struct vkdispatch vkd;
+	/** Allocator of device memory for buffers and images */
+	struct vkmemory memory;
+	/** Memory budget of heaps and evictable resources */
+	struct vkbudget budget;
+	/** Defragmenter of device memory running on @a graphics_queue */
+	struct vkdefrag defrag;
+	/** Nanoseconds per frame spent defragmenting, zero selects default */
+	uint64_t defrag_budget_ns;
+	/** Uniform data written by frames in flight */
+	struct vkuniform uniforms;
 	/** Graphics Queue */
 	VkQueue graphics_queue;
+	/** Maximum number of graphics queues to request, zero selects one */
+	uint32_t max_queues;
+	/** Graphics queues besides @a graphics_queue leased by other threads */
+	struct vkqueues queues;
 	/** Presenting Queue */
 	VkQueue present_queue;
+	/** Queue running compute jobs */
+	VkQueue compute_queue;
+	/** Compute jobs running on @a compute_queue */
+	struct vkcompute compute_jobs;
+	/** Queue running uploads */
+	VkQueue transfer_queue;
+	/** Uploads running on @a transfer_queue */
+	struct vktransfer uploads;
+	/** Uploads staged through ring within per-frame budget */
+	struct vkstaging staging;
+	/** Maximum number of bytes uploaded per frame, zero selects default */
+	VkDeviceSize upload_budget;
 	/** Surface capabilities */
 	VkSurfaceCapabilitiesKHR srf_caps;
 	/** Surface format */
 	VkSurfaceFormatKHR srf_format;
 	/** Present Mode */
 	VkPresentModeKHR srf_mode;
-	/** Command pool */
-	VkCommandPool cmd_pool;
-	/** Render pass */
+	/** Goal of present mode selection */
+	enum vkrenderer_present_policy present_policy;
+	/** Images queued for display in FIFO modes, zero selects default */
+	uint32_t latency_budget;
+	/** Number of swapchain images to request */
+	uint32_t srf_image_count;
+	/** How command buffers are recorded, must be set before init */
+	enum vkrenderer_record_mode record_mode;
+	/** Number of recording threads, zero selects number of online CPUs */
+	size_t nworkers;
+	/** Threads recording frames in VKRENDERER_RECORD_PARALLEL mode */
+	struct vkrecorder recorder;
+	/** Recycler of primary command buffers */
+	struct vkcmdpool cmd_pool;
+	/** Render passes keyed by attachment configuration */
+	struct vkrpcache rp_cache;
+	/** Pipelines compiled by earlier launches, saved at terminate */
+	struct vkpipecache pipeline_cache;
+	/** Threads compiling pipelines into @a pipeline_cache */
+	struct vkcompiler compiler;
+	/** Number of compiling threads, zero selects default */
+	size_t compile_workers;
+	/** Pipelines shared by identical descriptions */
+	struct vkpipereg pipelines;
+	/** Render pass presenting to surface, owned by @a rp_cache */
 	VkRenderPass rpass;
-	/** An array of swapchains */
-	struct vkswapchain swcs[2];
+	/** Ring of current swapchain and preceding retired ones */
+	struct vkswapchain swcs[VKRENDERER_MAX_SWAPCHAINS];
 	/** Current swapchain */
 	size_t swc_index;
+	/** Number of retired swapchains waiting for their frames to complete */
+	size_t nretired;
+	/** Current swapchain must be recreated before next frame */
+	int swc_outdated;
+	/** Ring of frames in flight */
+	struct vkflight flights[VKRENDERER_MAX_FLIGHTS];
+	/** Number of frames in flight, zero selects default */
+	size_t nflights;
+	/** Slot of the next frame in flight */
+	size_t flight_index;
+	/** Timeline semaphore signaled with number of each completed frame */
+	VkSemaphore timeline;
+	/** Number of the last submitted frame */
+	uint64_t frame;
+	/** Number of the last frame known to be completed */
+	uint64_t completed;
+	/** Statistics collected while rendering */
+	struct vkrenderer_stats stats;
 };
 
 #ifdef __cplusplus
@@ -55,6 +264,9 @@ extern "C" {
 
 /**
  * Initializes Vulkan renderer instance
+ *
+ * Fields of @a rdr specifying requested settings, like @a nflights, must be
+ * set before call.
  * @param rdr Specifies pointer to renderer to initialize
  * @param instance Specifies Vulkan instance
  * @param surface Specifies Window surface which will present result
@@ -70,11 +282,67 @@ int vkrenderer_init(struct vkrenderer *rdr, VkInstance instance,
  */
 int vkrenderer_render(struct vkrenderer *rdr);
 
+/**
+ * Notifies renderer that surface is resized
+ *
+ * Swapchain is recreated once before next frame, however many times the
+ * surface is resized until then.
+ * @param rdr Specifies pointer to renderer
+ */
+void vkrenderer_resize(struct vkrenderer *rdr);
+
+/**
+ * Changes present policy, swapchain is recreated before next frame
+ * @param rdr Specifies pointer to renderer
+ * @param policy Specifies new present policy
+ */
+void vkrenderer_set_present_policy(struct vkrenderer *rdr,
+				   enum vkrenderer_present_policy policy);
+
+/**
+ * Waits until GPU completes frame and all frames submitted before it
+ * @param rdr Specifies pointer to renderer
+ * @param frame Specifies number of frame to wait for
+ * @returns zero on success, and non-zero otherwise
+ */
+int vkrenderer_wait_frame(struct vkrenderer *rdr, uint64_t frame);
+
+/**
+ * Returns number of the last frame completed by GPU without blocking
+ * @param rdr Specifies pointer to renderer
+ * @returns number of completed frame, or zero if none is completed yet
+ */
+uint64_t vkrenderer_completed_frame(struct vkrenderer *rdr);
+
+/**
+ * Begins recording of compute job overlapping graphics work
+ *
+ * If all jobs are in use, waits for the frame the oldest job is waited by.
+ * @param rdr Specifies pointer to renderer
+ * @param cmds Specifies pointer where command buffer of job must be stored
+ * @returns VK_SUCCESS on success, VK_NOT_READY if jobs of all slots are
+ *          still not waited by any frame, or VkResult error otherwise
+ */
+VkResult vkrenderer_begin_compute(struct vkrenderer *rdr,
+				  VkCommandBuffer *cmds);
+
+/**
+ * Submits recorded compute job to compute queue
+ *
+ * The next rendered frame waits for job at @a stage, so work before that
+ * stage overlaps job.
+ * @param rdr Specifies pointer to renderer
+ * @param stage Specifies graphics stages consuming results of job
+ * @returns VK_SUCCESS on success, or VkResult error otherwise
+ */
+VkResult vkrenderer_submit_compute(struct vkrenderer *rdr,
+				   VkPipelineStageFlags stage);
+
 /**
  * Terminates Vulkan renderer instance
  * @param rdr Specifies pointer to renderer to terminate
  */
-void vkrenderer_terminate(const struct vkrenderer *rdr);
+void vkrenderer_terminate(struct vkrenderer *rdr);
 
 /**
  * Configures renderer on Vulkan instance
@@ -84,6 +352,16 @@ void vkrenderer_terminate(const struct vkrenderer *rdr);
  */
 int vkrenderer_configure(struct vkrenderer *rdr, VkInstance instance);
 
+/**
+ * Scores how well device suits rendering
+ *
+ * Score weighs device type, device-local heap size, queue topology and
+ * limits.
+ * @param phy Specifies device to score
+ * @returns score of device, higher is better
+ */
+uint32_t vkrenderer_score_device(VkPhysicalDevice phy);
+
 /**
  * Choose graphics and presentation families
  * @param rdr Specifies renderer to choose families for
@@ -105,6 +383,12 @@ int vkrenderer_configure_swapchain(struct vkrenderer *rdr);
  */
 int vkrenderer_configure_surface_format(struct vkrenderer *rdr);
 
+/**
+ * Choose number of swapchain images for selected present mode
+ * @param rdr Specifies renderer to choose number of images for
+ */
+void vkrenderer_configure_image_count(struct vkrenderer *rdr);
+
 /**
  * Choose surface presentation parameters
  * @param rdr Specifies renderer to choose surface presentation parameters for
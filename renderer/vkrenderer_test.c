@@ -14,16 +14,66 @@
 #include "vkrenderer.h"
 
 struct vkswapchain;
+struct vkflight;
 
 int vkrenderer_configure(struct vkrenderer *rdr, VkInstance instance)
 {
 	return (int)mock(rdr, instance);
 }
 
+/** Number of graphics queues requested by the last created device */
+static uint32_t ngraphics_queues;
+
+/** The last completed frame uniform data is reclaimed up to */
+static uint64_t collected_frame;
+
+/** Non-zero if budget is initialized as reported by device */
+static int budget_supported;
+
+/** Number of the last completed frame budget is trimmed with */
+static uint64_t trimmed_frame;
+
+/** Staging flushed by the last rendered frame */
+static struct vkstaging *flushed_staging;
+
+/** Result of flushing staged uploads */
+static VkResult flush_result = VK_SUCCESS;
+
+/** Time budget defragmenter is initialized with */
+static uint64_t defrag_budget;
+
+/** Result of initializing defragmenter */
+static VkResult defrag_result = VK_SUCCESS;
+
+/** Number of the last submitted frame defragmenter is advanced with */
+static uint64_t defrag_frame;
+
+/** Number of the last completed frame defragmenter is advanced with */
+static uint64_t defrag_completed;
+
+/** Mode host memory allocator is initialized with */
+static enum vkhost_mode host_mode;
+
+/** Result of initializing host memory allocator */
+static int host_result;
+
+int vkhost_init(struct vkhost *host, enum vkhost_mode mode)
+{
+	(void)(host);
+	host_mode = mode;
+	return host_result;
+}
+
+void vkhost_destroy(struct vkhost *host)
+{
+	mock(host);
+}
+
 VKAPI_ATTR VkResult VKAPI_CALL vkCreateDevice(
 	VkPhysicalDevice physicalDevice, const VkDeviceCreateInfo *pCreateInfo,
 	const VkAllocationCallbacks *pAllocator, VkDevice *pDevice)
 {
+	ngraphics_queues = pCreateInfo->pQueueCreateInfos[0].queueCount;
 	return (VkResult)mock(physicalDevice, pCreateInfo, pAllocator, pDevice);
 }
 
@@ -41,62 +91,924 @@ vkDestroyDevice(VkDevice device, const VkAllocationCallbacks *pAllocator)
 	mock(device, pAllocator);
 }
 
-VKAPI_ATTR VkResult VKAPI_CALL vkCreateCommandPool(
-	VkDevice device, const VkCommandPoolCreateInfo *pCreateInfo,
-	const VkAllocationCallbacks *pAllocator, VkCommandPool *pCommandPool)
+VkResult vkcmdpool_init(struct vkcmdpool *cp, VkDevice dev, uint32_t family,
+			const VkAllocationCallbacks *host)
 {
-	return (VkResult)mock(device, pCreateInfo, pAllocator, pCommandPool);
+	return (VkResult)mock(cp, dev, family, host);
 }
 
-VKAPI_ATTR void VKAPI_CALL
-vkDestroyCommandPool(VkDevice device, VkCommandPool commandPool,
-		     const VkAllocationCallbacks *pAllocator)
+void vkcmdpool_destroy(struct vkcmdpool *cp, VkDevice dev)
+{
+	mock(cp, dev);
+}
+
+void vkqueues_init(struct vkqueues *qs, VkDevice dev, uint32_t family,
+		   uint32_t first, uint32_t count)
+{
+	mock(qs, dev, family, first, count);
+}
+
+void vkmemory_init(struct vkmemory *mem, VkPhysicalDevice phy, VkDevice dev,
+		   const VkAllocationCallbacks *host)
+{
+	mock(mem, phy, dev, host);
+}
+
+void vkmemory_destroy(struct vkmemory *mem)
+{
+	mock(mem);
+}
+
+VkResult vkcompute_init(struct vkcompute *cmp, VkDevice dev,
+			const struct vkdispatch *vkd, uint32_t family,
+			VkQueue queue, const VkAllocationCallbacks *host)
+{
+	return (VkResult)mock(cmp, dev, vkd, family, queue, host);
+}
+
+VkResult vkcompute_begin(struct vkcompute *cmp, VkCommandBuffer *cmds)
+{
+	return (VkResult)mock(cmp, cmds);
+}
+
+VkResult vkcompute_submit(struct vkcompute *cmp, VkPipelineStageFlags stage)
+{
+	return (VkResult)mock(cmp, stage);
+}
+
+void vkcompute_collect(struct vkcompute *cmp, uint64_t completed)
+{
+	mock(cmp, completed);
+}
+
+void vkcompute_destroy(const struct vkcompute *cmp)
+{
+	mock(cmp);
+}
+
+VkResult vktransfer_init(struct vktransfer *xfer, VkDevice dev,
+			 const struct vkdispatch *vkd, uint32_t family,
+			 VkQueue queue, uint32_t graphic,
+			 VkQueue graphics_queue,
+			 const VkAllocationCallbacks *host)
+{
+	return (VkResult)mock(xfer, dev, vkd, family, queue, graphic,
+			      graphics_queue, host);
+}
+
+VkResult vktransfer_collect(struct vktransfer *xfer)
+{
+	return (VkResult)mock(xfer);
+}
+
+void vktransfer_destroy(const struct vktransfer *xfer)
+{
+	mock(xfer);
+}
+
+VkResult vkuniform_init(struct vkuniform *ring, struct vkmemory *mem,
+			VkPhysicalDevice phy, VkDeviceSize size)
+{
+	return (VkResult)mock(ring, mem, phy, size);
+}
+
+void vkuniform_collect(struct vkuniform *ring, uint64_t completed)
+{
+	collected_frame = completed;
+	(void)(ring);
+}
+
+void vkuniform_destroy(struct vkuniform *ring, struct vkmemory *mem)
+{
+	mock(ring, mem);
+}
+
+void vkbudget_init(struct vkbudget *bdg, const struct vkmemory *mem,
+		   VkPhysicalDevice phy, int supported)
 {
-	mock(device, commandPool, pAllocator);
+	(void)(bdg);
+	(void)(mem);
+	(void)(phy);
+	budget_supported = supported;
 }
 
-VKAPI_ATTR VkResult VKAPI_CALL vkCreateRenderPass(
-	VkDevice device, const VkRenderPassCreateInfo *pCreateInfo,
-	const VkAllocationCallbacks *pAllocator, VkRenderPass *pRenderPass)
+void vkbudget_update(struct vkbudget *bdg)
+{
+	(void)(bdg);
+}
+
+uint32_t vkbudget_trim(struct vkbudget *bdg, uint64_t completed)
+{
+	(void)(bdg);
+	trimmed_frame = completed;
+	return 0;
+}
+
+VkResult vkstaging_init(struct vkstaging *stage, struct vktransfer *xfer,
+			struct vkmemory *mem, VkDeviceSize size,
+			VkDeviceSize budget)
+{
+	return (VkResult)mock(stage, xfer, mem, size, budget);
+}
+
+VkResult vkstaging_flush(struct vkstaging *stage, uint64_t *ticket)
+{
+	flushed_staging = stage;
+	*ticket = 0;
+	return flush_result;
+}
+
+void vkstaging_destroy(struct vkstaging *stage, struct vkmemory *mem)
+{
+	mock(stage, mem);
+}
+
+VkResult vkdefrag_init(struct vkdefrag *defrag, struct vkmemory *mem,
+		       const struct vkdispatch *vkd, uint32_t family,
+		       VkQueue queue, uint64_t budget_ns)
+{
+	(void)(defrag);
+	(void)(mem);
+	(void)(vkd);
+	(void)(family);
+	(void)(queue);
+	defrag_budget = budget_ns;
+	return defrag_result;
+}
+
+VkResult vkdefrag_step(struct vkdefrag *defrag, uint64_t frame,
+		       uint64_t completed)
+{
+	(void)(defrag);
+	defrag_frame = frame;
+	defrag_completed = completed;
+	return VK_SUCCESS;
+}
+
+void vkdefrag_destroy(struct vkdefrag *defrag)
+{
+	(void)(defrag);
+}
+
+void vkdispatch_init(struct vkdispatch *vkd, VkDevice dev)
+{
+	(void)(vkd);
+	(void)(dev);
+}
+
+void vkrpcache_init(struct vkrpcache *cache,
+		    const VkAllocationCallbacks *host)
+{
+	(void)(cache);
+	(void)(host);
+}
+
+VkResult vkrpcache_get(struct vkrpcache *cache, VkDevice dev,
+		       const struct vkrpcache_key *key, VkRenderPass *rpass)
+{
+	return (VkResult)mock(cache, dev, key, rpass);
+}
+
+void vkrpcache_destroy(struct vkrpcache *cache, VkDevice dev)
+{
+	mock(cache, dev);
+}
+
+/** Path pipeline cache is loaded from */
+static const char *pipecache_path;
+
+/** Result of initializing pipeline cache */
+static VkResult pipecache_result = VK_SUCCESS;
+
+VkResult vkpipecache_init(struct vkpipecache *cache, VkPhysicalDevice phy,
+			  VkDevice dev, const char *path,
+			  const VkAllocationCallbacks *host)
 {
-	return (VkResult)mock(device, pCreateInfo, pAllocator, pRenderPass);
+	(void)(cache);
+	(void)(phy);
+	(void)(dev);
+	(void)(host);
+	pipecache_path = path;
+	return pipecache_result;
+}
+
+VkResult vkpipecache_merge(struct vkpipecache *cache,
+			   const VkPipelineCache *srcs, uint32_t count)
+{
+	return (VkResult)mock(cache, srcs, count);
+}
+
+int vkpipecache_save(struct vkpipecache *cache, const char *path)
+{
+	return (int)mock(cache, path);
+}
+
+void vkpipecache_destroy(struct vkpipecache *cache)
+{
+	mock(cache);
+}
+
+/** Number of threads compiler is initialized with */
+static size_t compile_workers;
+
+/** Non-zero if compiler is initialized with pipeline cache control */
+static int compile_cache_control;
+
+/** Result of initializing compiler */
+static int compiler_result;
+
+int vkcompiler_init(struct vkcompiler *comp, VkDevice dev,
+		    VkPipelineCache cache, int cache_control, size_t nworkers,
+		    const VkAllocationCallbacks *host)
+{
+	(void)(comp);
+	(void)(dev);
+	(void)(cache);
+	(void)(host);
+	compile_cache_control = cache_control;
+	compile_workers = nworkers;
+	return compiler_result;
+}
+
+uint32_t vkcompiler_caches(const struct vkcompiler *comp,
+			   VkPipelineCache *caches)
+{
+	return (uint32_t)mock(comp, caches);
+}
+
+void vkcompiler_destroy(struct vkcompiler *comp)
+{
+	mock(comp);
+}
+
+/** Compiler pipeline registry is initialized with */
+static struct vkcompiler *registry_compiler;
+
+/** Result of initializing pipeline registry */
+static int registry_result;
+
+int vkpipereg_init(struct vkpipereg *reg, struct vkcompiler *comp)
+{
+	(void)(reg);
+	registry_compiler = comp;
+	return registry_result;
+}
+
+void vkpipereg_destroy(struct vkpipereg *reg)
+{
+	mock(reg);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkDeviceWaitIdle(VkDevice device)
+{
+	return (VkResult)mock(device);
+}
+
+int vkswapchain_init(struct vkswapchain *swc, struct vkrenderer *rdr,
+		     const VkSwapchainKHR old_swc)
+{
+	return (int)mock(swc, rdr, old_swc);
+}
+
+void vkswapchain_terminate(const struct vkswapchain *swc,
+			   struct vkrenderer *rdr)
+{
+	mock(swc, rdr);
+}
+
+int vkrenderer_configure_swapchain(struct vkrenderer *rdr)
+{
+	return (int)mock(rdr);
+}
+
+VkResult vkswapchain_render(const struct vkswapchain *swc,
+			    struct vkrenderer *rdr, struct vkflight *flight)
+{
+	return (VkResult)mock(swc, rdr, flight);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateSemaphore(
+	VkDevice device, const VkSemaphoreCreateInfo *pCreateInfo,
+	const VkAllocationCallbacks *pAllocator, VkSemaphore *pSemaphore)
+{
+	return (VkResult)mock(device, pCreateInfo, pAllocator, pSemaphore);
 }
 
 VKAPI_ATTR void VKAPI_CALL
-vkDestroyRenderPass(VkDevice device, VkRenderPass renderPass,
-		    const VkAllocationCallbacks *pAllocator)
+vkDestroySemaphore(VkDevice device, VkSemaphore semaphore,
+		   const VkAllocationCallbacks *pAllocator)
+{
+	mock(device, semaphore, pAllocator);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkWaitSemaphores(
+	VkDevice device, const VkSemaphoreWaitInfo *pWaitInfo, uint64_t timeout)
+{
+	return (VkResult)mock(device, pWaitInfo, timeout);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkGetSemaphoreCounterValue(VkDevice device,
+							  VkSemaphore semaphore,
+							  uint64_t *pValue)
+{
+	return (VkResult)mock(device, semaphore, pValue);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkGetFenceStatus(VkDevice device, VkFence fence)
+{
+	return (VkResult)mock(device, fence);
+}
+
+/** Dispatch table calling fake device functions */
+static const struct vkdispatch mocked_dispatch = {
+	.vkWaitSemaphores = vkWaitSemaphores,
+	.vkGetSemaphoreCounterValue = vkGetSemaphoreCounterValue,
+	.vkGetFenceStatus = vkGetFenceStatus,
+};
+
+VkResult vkflight_init(struct vkflight *flight, VkDevice dev,
+		       const VkAllocationCallbacks *host)
+{
+	return (VkResult)mock(flight, dev, host);
+}
+
+VkResult vkflight_init_commands(struct vkflight *flight, VkDevice dev,
+				uint32_t family)
+{
+	return (VkResult)mock(flight, dev, family);
+}
+
+int vkrecorder_init(struct vkrecorder *rec, VkDevice dev,
+		    const struct vkdispatch *vkd, uint32_t family,
+		    size_t nworkers, size_t nslots,
+		    const VkAllocationCallbacks *host)
+{
+	return (int)mock(rec, dev, vkd, family, nworkers, nslots, host);
+}
+
+void vkrecorder_destroy(struct vkrecorder *rec)
+{
+	mock(rec);
+}
+
+VkResult vkflight_wait(const struct vkflight *flight, VkDevice dev,
+		       const struct vkdispatch *vkd)
+{
+	return (VkResult)mock(flight, dev, vkd);
+}
+
+void vkflight_destroy(const struct vkflight *flight, VkDevice dev)
+{
+	mock(flight, dev);
+}
+
+Ensure(init_returns_zero_on_success)
+{
+	VkInstance instance = (VkInstance)1;
+	VkSurfaceKHR surface = (VkSurfaceKHR)2;
+	struct vkrenderer vkr = { 0 };
+	expect(vkrenderer_configure, will_return(0));
+	expect(vkCreateDevice, will_return(VK_SUCCESS));
+	expect(vkGetDeviceQueue);
+	expect(vkGetDeviceQueue);
+	expect(vkGetDeviceQueue);
+	expect(vkGetDeviceQueue);
+	expect(vkqueues_init);
+	expect(vkmemory_init);
+	expect(vkcmdpool_init, will_return(VK_SUCCESS));
+	expect(vkcompute_init, will_return(VK_SUCCESS));
+	expect(vktransfer_init, will_return(VK_SUCCESS));
+	expect(vkuniform_init, will_return(VK_SUCCESS));
+	expect(vkstaging_init, will_return(VK_SUCCESS));
+	expect(vkrpcache_get, will_return(VK_SUCCESS));
+	expect(vkflight_init, will_return(VK_SUCCESS),
+	       when(flight, is_equal_to(&vkr.flights[0])));
+	expect(vkflight_init, will_return(VK_SUCCESS),
+	       when(flight, is_equal_to(&vkr.flights[1])));
+	never_expect(vkflight_init_commands);
+	expect(vkswapchain_init, will_return(0));
+	int error = vkrenderer_init(&vkr, instance, surface);
+	assert_that(error, is_equal_to(0));
+	assert_that(vkr.nflights, is_equal_to(VKRENDERER_DEFAULT_FLIGHTS));
+}
+
+Ensure(init_creates_flight_commands_when_recording_per_frame)
 {
-	mock(device, renderPass, pAllocator);
+	VkInstance instance = (VkInstance)1;
+	VkSurfaceKHR surface = (VkSurfaceKHR)2;
+	struct vkrenderer vkr = {
+		.nflights = 1,
+		.record_mode = VKRENDERER_RECORD_PER_FRAME,
+	};
+	expect(vkrenderer_configure, will_return(0));
+	expect(vkCreateDevice, will_return(VK_SUCCESS));
+	expect(vkGetDeviceQueue);
+	expect(vkGetDeviceQueue);
+	expect(vkGetDeviceQueue);
+	expect(vkGetDeviceQueue);
+	expect(vkqueues_init);
+	expect(vkmemory_init);
+	expect(vkcmdpool_init, will_return(VK_SUCCESS));
+	expect(vkcompute_init, will_return(VK_SUCCESS));
+	expect(vktransfer_init, will_return(VK_SUCCESS));
+	expect(vkuniform_init, will_return(VK_SUCCESS));
+	expect(vkstaging_init, will_return(VK_SUCCESS));
+	expect(vkrpcache_get, will_return(VK_SUCCESS));
+	expect(vkflight_init, will_return(VK_SUCCESS));
+	expect(vkflight_init_commands, will_return(VK_SUCCESS),
+	       when(flight, is_equal_to(&vkr.flights[0])));
+	expect(vkswapchain_init, will_return(0));
+	int error = vkrenderer_init(&vkr, instance, surface);
+	assert_that(error, is_equal_to(0));
+}
+
+Ensure(init_starts_recorder_when_recording_in_parallel)
+{
+	VkInstance instance = (VkInstance)1;
+	VkSurfaceKHR surface = (VkSurfaceKHR)2;
+	struct vkrenderer vkr = {
+		.nflights = 2,
+		.nworkers = VKRECORDER_MAX_WORKERS + 1,
+		.record_mode = VKRENDERER_RECORD_PARALLEL,
+	};
+	expect(vkrenderer_configure, will_return(0));
+	expect(vkCreateDevice, will_return(VK_SUCCESS));
+	expect(vkGetDeviceQueue);
+	expect(vkGetDeviceQueue);
+	expect(vkGetDeviceQueue);
+	expect(vkGetDeviceQueue);
+	expect(vkqueues_init);
+	expect(vkmemory_init);
+	expect(vkcmdpool_init, will_return(VK_SUCCESS));
+	expect(vkcompute_init, will_return(VK_SUCCESS));
+	expect(vktransfer_init, will_return(VK_SUCCESS));
+	expect(vkuniform_init, will_return(VK_SUCCESS));
+	expect(vkstaging_init, will_return(VK_SUCCESS));
+	expect(vkrpcache_get, will_return(VK_SUCCESS));
+	expect(vkflight_init, will_return(VK_SUCCESS));
+	expect(vkflight_init_commands, will_return(VK_SUCCESS));
+	expect(vkflight_init, will_return(VK_SUCCESS));
+	expect(vkflight_init_commands, will_return(VK_SUCCESS));
+	expect(vkrecorder_init, will_return(0),
+	       when(vkd, is_equal_to(&vkr.vkd)),
+	       when(nworkers, is_equal_to(VKRECORDER_MAX_WORKERS)),
+	       when(nslots, is_equal_to(2)));
+	expect(vkswapchain_init, will_return(0));
+	int error = vkrenderer_init(&vkr, instance, surface);
+	assert_that(error, is_equal_to(0));
+}
+
+Ensure(init_returns_non_zero_on_recorder_fail)
+{
+	VkInstance instance = (VkInstance)1;
+	VkSurfaceKHR surface = (VkSurfaceKHR)2;
+	struct vkrenderer vkr = {
+		.nflights = 1,
+		.record_mode = VKRENDERER_RECORD_PARALLEL,
+	};
+	expect(vkrenderer_configure, will_return(0));
+	expect(vkCreateDevice, will_return(VK_SUCCESS));
+	expect(vkGetDeviceQueue);
+	expect(vkGetDeviceQueue);
+	expect(vkGetDeviceQueue);
+	expect(vkGetDeviceQueue);
+	expect(vkqueues_init);
+	expect(vkmemory_init);
+	expect(vkcmdpool_init, will_return(VK_SUCCESS));
+	expect(vkcompute_init, will_return(VK_SUCCESS));
+	expect(vktransfer_init, will_return(VK_SUCCESS));
+	expect(vkuniform_init, will_return(VK_SUCCESS));
+	expect(vkstaging_init, will_return(VK_SUCCESS));
+	expect(vkrpcache_get, will_return(VK_SUCCESS));
+	expect(vkflight_init, will_return(VK_SUCCESS));
+	expect(vkflight_init_commands, will_return(VK_SUCCESS));
+	expect(vkrecorder_init, will_return(-1));
+	never_expect(vkswapchain_init);
+	int error = vkrenderer_init(&vkr, instance, surface);
+	assert_that(error, is_not_equal_to(0));
+	assert_that(vkr.nworkers, is_greater_than(0));
+}
+
+Ensure(init_returns_non_zero_on_flight_commands_fail)
+{
+	VkInstance instance = (VkInstance)1;
+	VkSurfaceKHR surface = (VkSurfaceKHR)2;
+	struct vkrenderer vkr = {
+		.record_mode = VKRENDERER_RECORD_PER_FRAME,
+	};
+	expect(vkrenderer_configure, will_return(0));
+	expect(vkCreateDevice, will_return(VK_SUCCESS));
+	expect(vkGetDeviceQueue);
+	expect(vkGetDeviceQueue);
+	expect(vkGetDeviceQueue);
+	expect(vkGetDeviceQueue);
+	expect(vkqueues_init);
+	expect(vkmemory_init);
+	expect(vkcmdpool_init, will_return(VK_SUCCESS));
+	expect(vkcompute_init, will_return(VK_SUCCESS));
+	expect(vktransfer_init, will_return(VK_SUCCESS));
+	expect(vkuniform_init, will_return(VK_SUCCESS));
+	expect(vkstaging_init, will_return(VK_SUCCESS));
+	expect(vkrpcache_get, will_return(VK_SUCCESS));
+	expect(vkflight_init, will_return(VK_SUCCESS));
+	expect(vkflight_init_commands,
+	       will_return(VK_ERROR_OUT_OF_DEVICE_MEMORY));
+	never_expect(vkswapchain_init);
+	int error = vkrenderer_init(&vkr, instance, surface);
+	assert_that(error, is_not_equal_to(0));
+}
+
+Ensure(init_limits_number_of_frames_in_flight)
+{
+	VkInstance instance = (VkInstance)1;
+	VkSurfaceKHR surface = (VkSurfaceKHR)2;
+	struct vkrenderer vkr = {
+		.nflights = VKRENDERER_MAX_FLIGHTS + 1,
+	};
+	expect(vkrenderer_configure, will_return(0));
+	expect(vkCreateDevice, will_return(VK_SUCCESS));
+	expect(vkGetDeviceQueue);
+	expect(vkGetDeviceQueue);
+	expect(vkGetDeviceQueue);
+	expect(vkGetDeviceQueue);
+	expect(vkqueues_init);
+	expect(vkmemory_init);
+	expect(vkcmdpool_init, will_return(VK_SUCCESS));
+	expect(vkcompute_init, will_return(VK_SUCCESS));
+	expect(vktransfer_init, will_return(VK_SUCCESS));
+	expect(vkuniform_init, will_return(VK_SUCCESS));
+	expect(vkstaging_init, will_return(VK_SUCCESS));
+	expect(vkrpcache_get, will_return(VK_SUCCESS));
+	for (size_t i = 0; i < VKRENDERER_MAX_FLIGHTS; ++i) {
+		expect(vkflight_init, will_return(VK_SUCCESS));
+	}
+	expect(vkswapchain_init, will_return(0));
+	int error = vkrenderer_init(&vkr, instance, surface);
+	assert_that(error, is_equal_to(0));
+	assert_that(vkr.nflights, is_equal_to(VKRENDERER_MAX_FLIGHTS));
+}
+
+Ensure(init_returns_non_zero_on_flight_fail)
+{
+	VkInstance instance = (VkInstance)1;
+	VkSurfaceKHR surface = (VkSurfaceKHR)2;
+	struct vkrenderer vkr = { 0 };
+	expect(vkrenderer_configure, will_return(0));
+	expect(vkCreateDevice, will_return(VK_SUCCESS));
+	expect(vkGetDeviceQueue);
+	expect(vkGetDeviceQueue);
+	expect(vkGetDeviceQueue);
+	expect(vkGetDeviceQueue);
+	expect(vkqueues_init);
+	expect(vkmemory_init);
+	expect(vkcmdpool_init, will_return(VK_SUCCESS));
+	expect(vkcompute_init, will_return(VK_SUCCESS));
+	expect(vktransfer_init, will_return(VK_SUCCESS));
+	expect(vkuniform_init, will_return(VK_SUCCESS));
+	expect(vkstaging_init, will_return(VK_SUCCESS));
+	expect(vkrpcache_get, will_return(VK_SUCCESS));
+	expect(vkflight_init, will_return(VK_ERROR_OUT_OF_DEVICE_MEMORY));
+	never_expect(vkswapchain_init);
+	int error = vkrenderer_init(&vkr, instance, surface);
+	assert_that(error, is_not_equal_to(0));
+}
+
+Ensure(init_skips_render_pass_with_dynamic_rendering)
+{
+	VkInstance instance = (VkInstance)1;
+	VkSurfaceKHR surface = (VkSurfaceKHR)2;
+	struct vkrenderer vkr = {
+		.caps = VKRENDERER_CAP_DYNAMIC_RENDERING,
+	};
+	expect(vkrenderer_configure, will_return(0));
+	expect(vkCreateDevice, will_return(VK_SUCCESS));
+	expect(vkGetDeviceQueue);
+	expect(vkGetDeviceQueue);
+	expect(vkGetDeviceQueue);
+	expect(vkGetDeviceQueue);
+	expect(vkqueues_init);
+	expect(vkmemory_init);
+	expect(vkcmdpool_init, will_return(VK_SUCCESS));
+	expect(vkcompute_init, will_return(VK_SUCCESS));
+	expect(vktransfer_init, will_return(VK_SUCCESS));
+	expect(vkuniform_init, will_return(VK_SUCCESS));
+	expect(vkstaging_init, will_return(VK_SUCCESS));
+	never_expect(vkrpcache_get);
+	expect(vkflight_init, will_return(VK_SUCCESS));
+	expect(vkflight_init, will_return(VK_SUCCESS));
+	expect(vkswapchain_init, will_return(0));
+	int error = vkrenderer_init(&vkr, instance, surface);
+	assert_that(error, is_equal_to(0));
+	assert_that(vkr.rpass, is_equal_to(VK_NULL_HANDLE));
+}
+
+Ensure(init_creates_timeline_semaphore_when_supported)
+{
+	VkInstance instance = (VkInstance)1;
+	VkSurfaceKHR surface = (VkSurfaceKHR)2;
+	VkSemaphore timeline = (VkSemaphore)3;
+	/* Capabilities are set by configuration, which is mocked */
+	struct vkrenderer vkr = {
+		.caps = VKRENDERER_CAP_TIMELINE_SEMAPHORE,
+	};
+	expect(vkrenderer_configure, will_return(0));
+	expect(vkCreateDevice, will_return(VK_SUCCESS));
+	expect(vkGetDeviceQueue);
+	expect(vkGetDeviceQueue);
+	expect(vkGetDeviceQueue);
+	expect(vkGetDeviceQueue);
+	expect(vkqueues_init);
+	expect(vkmemory_init);
+	expect(vkcmdpool_init, will_return(VK_SUCCESS));
+	expect(vkcompute_init, will_return(VK_SUCCESS));
+	expect(vktransfer_init, will_return(VK_SUCCESS));
+	expect(vkuniform_init, will_return(VK_SUCCESS));
+	expect(vkstaging_init, will_return(VK_SUCCESS));
+	expect(vkrpcache_get, will_return(VK_SUCCESS));
+	expect(vkflight_init, will_return(VK_SUCCESS));
+	expect(vkflight_init, will_return(VK_SUCCESS));
+	expect(vkCreateSemaphore, will_return(VK_SUCCESS),
+	       will_set_contents_of_parameter(pSemaphore, &timeline,
+					      sizeof(timeline)));
+	expect(vkswapchain_init, will_return(0));
+	int error = vkrenderer_init(&vkr, instance, surface);
+	assert_that(error, is_equal_to(0));
+	assert_that(vkr.timeline, is_equal_to(timeline));
+}
+
+Ensure(init_returns_non_zero_on_timeline_semaphore_fail)
+{
+	VkInstance instance = (VkInstance)1;
+	VkSurfaceKHR surface = (VkSurfaceKHR)2;
+	struct vkrenderer vkr = {
+		.caps = VKRENDERER_CAP_TIMELINE_SEMAPHORE,
+	};
+	expect(vkrenderer_configure, will_return(0));
+	expect(vkCreateDevice, will_return(VK_SUCCESS));
+	expect(vkGetDeviceQueue);
+	expect(vkGetDeviceQueue);
+	expect(vkGetDeviceQueue);
+	expect(vkGetDeviceQueue);
+	expect(vkqueues_init);
+	expect(vkmemory_init);
+	expect(vkcmdpool_init, will_return(VK_SUCCESS));
+	expect(vkcompute_init, will_return(VK_SUCCESS));
+	expect(vktransfer_init, will_return(VK_SUCCESS));
+	expect(vkuniform_init, will_return(VK_SUCCESS));
+	expect(vkstaging_init, will_return(VK_SUCCESS));
+	expect(vkrpcache_get, will_return(VK_SUCCESS));
+	expect(vkflight_init, will_return(VK_SUCCESS));
+	expect(vkflight_init, will_return(VK_SUCCESS));
+	expect(vkCreateSemaphore, will_return(VK_ERROR_OUT_OF_HOST_MEMORY));
+	never_expect(vkswapchain_init);
+	int error = vkrenderer_init(&vkr, instance, surface);
+	assert_that(error, is_not_equal_to(0));
+}
+
+Ensure(init_returns_non_zero_when_no_configs)
+{
+	VkInstance instance = (VkInstance)1;
+	VkSurfaceKHR surface = (VkSurfaceKHR)2;
+	struct vkrenderer vkr = { 0 };
+	expect(vkrenderer_configure, will_return(1));
+	int error = vkrenderer_init(&vkr, instance, surface);
+	assert_that(error, is_not_equal_to(0));
+}
+
+Ensure(init_creates_device_with_host_allocator)
+{
+	VkInstance instance = (VkInstance)1;
+	VkSurfaceKHR surface = (VkSurfaceKHR)2;
+	struct vkrenderer vkr = { .host_mode = VKHOST_MODE_MALLOC };
+	host_mode = VKHOST_MODE_ARENA;
+	expect(vkrenderer_configure, will_return(0));
+	expect(vkCreateDevice, will_return(VK_ERROR_INITIALIZATION_FAILED),
+	       when(pAllocator, is_equal_to(&vkr.host.callbacks)));
+	vkrenderer_init(&vkr, instance, surface);
+	assert_that(host_mode, is_equal_to(VKHOST_MODE_MALLOC));
+}
+
+Ensure(init_returns_non_zero_on_host_allocator_fail)
+{
+	VkInstance instance = (VkInstance)1;
+	VkSurfaceKHR surface = (VkSurfaceKHR)2;
+	struct vkrenderer vkr = { 0 };
+	host_result = -1;
+	expect(vkrenderer_configure, will_return(0));
+	never_expect(vkCreateDevice);
+	int error = vkrenderer_init(&vkr, instance, surface);
+	host_result = 0;
+	assert_that(error, is_not_equal_to(0));
+}
+
+Ensure(init_returns_non_zero_on_device_fail)
+{
+	VkInstance instance = (VkInstance)1;
+	VkSurfaceKHR surface = (VkSurfaceKHR)2;
+	struct vkrenderer vkr = { 0 };
+	expect(vkrenderer_configure, will_return(0));
+	expect(vkCreateDevice, will_return(VK_ERROR_INITIALIZATION_FAILED));
+	int error = vkrenderer_init(&vkr, instance, surface);
+	assert_that(error, is_not_equal_to(0));
+}
+
+Ensure(init_returns_non_zero_on_command_pool_fail)
+{
+	VkInstance instance = (VkInstance)1;
+	VkSurfaceKHR surface = (VkSurfaceKHR)2;
+	struct vkrenderer vkr = { 0 };
+	expect(vkrenderer_configure, will_return(0));
+	expect(vkCreateDevice, will_return(VK_SUCCESS));
+	expect(vkGetDeviceQueue);
+	expect(vkGetDeviceQueue);
+	expect(vkGetDeviceQueue);
+	expect(vkGetDeviceQueue);
+	expect(vkqueues_init);
+	expect(vkmemory_init);
+	expect(vkcmdpool_init, will_return(VK_NOT_READY));
+	int error = vkrenderer_init(&vkr, instance, surface);
+	assert_that(error, is_not_equal_to(0));
+}
+
+Ensure(init_leases_extra_graphics_queues)
+{
+	VkInstance instance = (VkInstance)1;
+	VkSurfaceKHR surface = (VkSurfaceKHR)2;
+	struct vkrenderer vkr = { .max_queues = 4, .graphic_nqueues = 3 };
+	expect(vkrenderer_configure, will_return(0));
+	expect(vkCreateDevice, will_return(VK_SUCCESS));
+	expect(vkGetDeviceQueue);
+	expect(vkGetDeviceQueue);
+	expect(vkGetDeviceQueue);
+	expect(vkGetDeviceQueue);
+	expect(vkqueues_init, when(qs, is_equal_to(&vkr.queues)),
+	       when(first, is_equal_to(1)), when(count, is_equal_to(2)));
+	expect(vkmemory_init);
+	expect(vkcmdpool_init, will_return(VK_ERROR_OUT_OF_HOST_MEMORY));
+	int error = vkrenderer_init(&vkr, instance, surface);
+	assert_that(error, is_not_equal_to(0));
+	assert_that(ngraphics_queues, is_equal_to(3));
+}
+
+Ensure(init_creates_memory_allocator_for_device)
+{
+	VkInstance instance = (VkInstance)1;
+	VkSurfaceKHR surface = (VkSurfaceKHR)2;
+	VkDevice device = (VkDevice)3;
+	struct vkrenderer vkr = { .phy = (VkPhysicalDevice)4 };
+	expect(vkrenderer_configure, will_return(0));
+	expect(vkCreateDevice,
+	       will_set_contents_of_parameter(pDevice, &device, sizeof(device)),
+	       will_return(VK_SUCCESS));
+	expect(vkGetDeviceQueue);
+	expect(vkGetDeviceQueue);
+	expect(vkGetDeviceQueue);
+	expect(vkGetDeviceQueue);
+	expect(vkqueues_init);
+	expect(vkmemory_init, when(mem, is_equal_to(&vkr.memory)),
+	       when(phy, is_equal_to(vkr.phy)), when(dev, is_equal_to(device)),
+	       when(host, is_equal_to(&vkr.host.callbacks)));
+	expect(vkcmdpool_init, will_return(VK_ERROR_OUT_OF_HOST_MEMORY));
+	int error = vkrenderer_init(&vkr, instance, surface);
+	assert_that(error, is_not_equal_to(0));
+}
+
+Ensure(init_tracks_memory_budget_reported_by_device)
+{
+	VkInstance instance = (VkInstance)1;
+	VkSurfaceKHR surface = (VkSurfaceKHR)2;
+	struct vkrenderer vkr = { .caps = VKRENDERER_CAP_MEMORY_BUDGET };
+	budget_supported = 0;
+	expect(vkrenderer_configure, will_return(0));
+	expect(vkCreateDevice, will_return(VK_SUCCESS));
+	expect(vkGetDeviceQueue);
+	expect(vkGetDeviceQueue);
+	expect(vkGetDeviceQueue);
+	expect(vkGetDeviceQueue);
+	expect(vkqueues_init);
+	expect(vkmemory_init);
+	expect(vkcmdpool_init, will_return(VK_ERROR_OUT_OF_HOST_MEMORY));
+	vkrenderer_init(&vkr, instance, surface);
+	assert_that(budget_supported, is_true);
 }
 
-VKAPI_ATTR VkResult VKAPI_CALL vkDeviceWaitIdle(VkDevice device)
+Ensure(init_returns_non_zero_on_compute_fail)
 {
-	return (VkResult)mock(device);
+	VkInstance instance = (VkInstance)1;
+	VkSurfaceKHR surface = (VkSurfaceKHR)2;
+	struct vkrenderer vkr = { 0 };
+	expect(vkrenderer_configure, will_return(0));
+	expect(vkCreateDevice, will_return(VK_SUCCESS));
+	expect(vkGetDeviceQueue);
+	expect(vkGetDeviceQueue);
+	expect(vkGetDeviceQueue);
+	expect(vkGetDeviceQueue);
+	expect(vkqueues_init);
+	expect(vkmemory_init);
+	expect(vkcmdpool_init, will_return(VK_SUCCESS));
+	expect(vkcompute_init, will_return(VK_ERROR_OUT_OF_DEVICE_MEMORY));
+	never_expect(vktransfer_init);
+	int error = vkrenderer_init(&vkr, instance, surface);
+	assert_that(error, is_not_equal_to(0));
 }
 
-int vkswapchain_init(struct vkswapchain *swc, const struct vkrenderer *rdr,
-		     const VkSwapchainKHR old_swc)
+Ensure(init_returns_non_zero_on_uploads_fail)
 {
-	return (int)mock(swc, rdr, old_swc);
+	VkInstance instance = (VkInstance)1;
+	VkSurfaceKHR surface = (VkSurfaceKHR)2;
+	struct vkrenderer vkr = { 0 };
+	expect(vkrenderer_configure, will_return(0));
+	expect(vkCreateDevice, will_return(VK_SUCCESS));
+	expect(vkGetDeviceQueue);
+	expect(vkGetDeviceQueue);
+	expect(vkGetDeviceQueue);
+	expect(vkGetDeviceQueue);
+	expect(vkqueues_init);
+	expect(vkmemory_init);
+	expect(vkcmdpool_init, will_return(VK_SUCCESS));
+	expect(vkcompute_init, will_return(VK_SUCCESS));
+	expect(vktransfer_init, will_return(VK_ERROR_OUT_OF_DEVICE_MEMORY));
+	int error = vkrenderer_init(&vkr, instance, surface);
+	assert_that(error, is_not_equal_to(0));
 }
 
-void vkswapchain_terminate(const struct vkswapchain *swc, VkDevice dev)
+Ensure(init_returns_non_zero_on_uniforms_fail)
 {
-	mock(swc, dev);
+	VkInstance instance = (VkInstance)1;
+	VkSurfaceKHR surface = (VkSurfaceKHR)2;
+	struct vkrenderer vkr = { 0 };
+	expect(vkrenderer_configure, will_return(0));
+	expect(vkCreateDevice, will_return(VK_SUCCESS));
+	expect(vkGetDeviceQueue);
+	expect(vkGetDeviceQueue);
+	expect(vkGetDeviceQueue);
+	expect(vkGetDeviceQueue);
+	expect(vkqueues_init);
+	expect(vkmemory_init);
+	expect(vkcmdpool_init, will_return(VK_SUCCESS));
+	expect(vkcompute_init, will_return(VK_SUCCESS));
+	expect(vktransfer_init, will_return(VK_SUCCESS));
+	expect(vkuniform_init, when(ring, is_equal_to(&vkr.uniforms)),
+	       when(mem, is_equal_to(&vkr.memory)),
+	       will_return(VK_ERROR_FEATURE_NOT_PRESENT));
+	never_expect(vkrpcache_get);
+	int error = vkrenderer_init(&vkr, instance, surface);
+	assert_that(error, is_not_equal_to(0));
 }
 
-int vkrenderer_configure_swapchain(struct vkrenderer *rdr)
+Ensure(init_returns_non_zero_on_staging_fail)
 {
-	return (int)mock(rdr);
+	VkInstance instance = (VkInstance)1;
+	VkSurfaceKHR surface = (VkSurfaceKHR)2;
+	struct vkrenderer vkr = { 0 };
+	expect(vkrenderer_configure, will_return(0));
+	expect(vkCreateDevice, will_return(VK_SUCCESS));
+	expect(vkGetDeviceQueue);
+	expect(vkGetDeviceQueue);
+	expect(vkGetDeviceQueue);
+	expect(vkGetDeviceQueue);
+	expect(vkqueues_init);
+	expect(vkmemory_init);
+	expect(vkcmdpool_init, will_return(VK_SUCCESS));
+	expect(vkcompute_init, will_return(VK_SUCCESS));
+	expect(vktransfer_init, will_return(VK_SUCCESS));
+	expect(vkuniform_init, will_return(VK_SUCCESS));
+	expect(vkstaging_init, when(stage, is_equal_to(&vkr.staging)),
+	       when(xfer, is_equal_to(&vkr.uploads)),
+	       when(budget, is_equal_to(VKRENDERER_DEFAULT_UPLOAD_BUDGET)),
+	       will_return(VK_ERROR_OUT_OF_DEVICE_MEMORY));
+	never_expect(vkrpcache_get);
+	int error = vkrenderer_init(&vkr, instance, surface);
+	assert_that(error, is_not_equal_to(0));
 }
 
-VkResult vkswapchain_render(const struct vkswapchain *swc,
-			    const struct vkrenderer *rdr)
+Ensure(init_passes_requested_upload_budget)
 {
-	return (VkResult)mock(swc, rdr);
+	VkInstance instance = (VkInstance)1;
+	VkSurfaceKHR surface = (VkSurfaceKHR)2;
+	struct vkrenderer vkr = { .upload_budget = 1024 };
+	expect(vkrenderer_configure, will_return(0));
+	expect(vkCreateDevice, will_return(VK_SUCCESS));
+	expect(vkGetDeviceQueue);
+	expect(vkGetDeviceQueue);
+	expect(vkGetDeviceQueue);
+	expect(vkGetDeviceQueue);
+	expect(vkqueues_init);
+	expect(vkmemory_init);
+	expect(vkcmdpool_init, will_return(VK_SUCCESS));
+	expect(vkcompute_init, will_return(VK_SUCCESS));
+	expect(vktransfer_init, will_return(VK_SUCCESS));
+	expect(vkuniform_init, will_return(VK_SUCCESS));
+	expect(vkstaging_init, when(stage, is_equal_to(&vkr.staging)),
+	       when(xfer, is_equal_to(&vkr.uploads)),
+	       when(budget, is_equal_to(1024)),
+	       will_return(VK_ERROR_OUT_OF_DEVICE_MEMORY));
+	never_expect(vkrpcache_get);
+	int error = vkrenderer_init(&vkr, instance, surface);
+	assert_that(error, is_not_equal_to(0));
 }
 
-Ensure(init_returns_zero_on_success)
+Ensure(init_returns_non_zero_on_defrag_fail)
 {
 	VkInstance instance = (VkInstance)1;
 	VkSurfaceKHR surface = (VkSurfaceKHR)2;
@@ -105,35 +1017,82 @@ Ensure(init_returns_zero_on_success)
 	expect(vkCreateDevice, will_return(VK_SUCCESS));
 	expect(vkGetDeviceQueue);
 	expect(vkGetDeviceQueue);
-	expect(vkCreateCommandPool, will_return(VK_SUCCESS));
-	expect(vkCreateRenderPass, will_return(VK_SUCCESS));
-	expect(vkswapchain_init, will_return(0));
+	expect(vkGetDeviceQueue);
+	expect(vkGetDeviceQueue);
+	expect(vkqueues_init);
+	expect(vkmemory_init);
+	expect(vkcmdpool_init, will_return(VK_SUCCESS));
+	expect(vkcompute_init, will_return(VK_SUCCESS));
+	expect(vktransfer_init, will_return(VK_SUCCESS));
+	expect(vkuniform_init, will_return(VK_SUCCESS));
+	expect(vkstaging_init, will_return(VK_SUCCESS));
+	never_expect(vkrpcache_get);
+	defrag_result = VK_ERROR_OUT_OF_HOST_MEMORY;
 	int error = vkrenderer_init(&vkr, instance, surface);
-	assert_that(error, is_equal_to(0));
+	defrag_result = VK_SUCCESS;
+	assert_that(error, is_not_equal_to(0));
+	assert_that(defrag_budget,
+		    is_equal_to(VKRENDERER_DEFAULT_DEFRAG_BUDGET_NS));
 }
 
-Ensure(init_returns_non_zero_when_no_configs)
+Ensure(init_returns_non_zero_on_pipeline_cache_fail)
 {
 	VkInstance instance = (VkInstance)1;
 	VkSurfaceKHR surface = (VkSurfaceKHR)2;
-	struct vkrenderer vkr = { 0 };
-	expect(vkrenderer_configure, will_return(1));
+	struct vkrenderer vkr = { .pipeline_cache_path = "pipelines" };
+	expect(vkrenderer_configure, will_return(0));
+	expect(vkCreateDevice, will_return(VK_SUCCESS));
+	expect(vkGetDeviceQueue);
+	expect(vkGetDeviceQueue);
+	expect(vkGetDeviceQueue);
+	expect(vkGetDeviceQueue);
+	expect(vkqueues_init);
+	expect(vkmemory_init);
+	expect(vkcmdpool_init, will_return(VK_SUCCESS));
+	expect(vkcompute_init, will_return(VK_SUCCESS));
+	expect(vktransfer_init, will_return(VK_SUCCESS));
+	expect(vkuniform_init, will_return(VK_SUCCESS));
+	expect(vkstaging_init, will_return(VK_SUCCESS));
+	never_expect(vkrpcache_get);
+	pipecache_path = NULL;
+	pipecache_result = VK_ERROR_OUT_OF_HOST_MEMORY;
 	int error = vkrenderer_init(&vkr, instance, surface);
+	pipecache_result = VK_SUCCESS;
 	assert_that(error, is_not_equal_to(0));
+	assert_that(pipecache_path, is_equal_to_string("pipelines"));
 }
 
-Ensure(init_returns_non_zero_on_device_fail)
+Ensure(init_returns_non_zero_on_compiler_fail)
 {
 	VkInstance instance = (VkInstance)1;
 	VkSurfaceKHR surface = (VkSurfaceKHR)2;
-	struct vkrenderer vkr = { 0 };
+	struct vkrenderer vkr = {
+		.caps = VKRENDERER_CAP_PIPELINE_CACHE_CONTROL,
+		.compile_workers = 64,
+	};
 	expect(vkrenderer_configure, will_return(0));
-	expect(vkCreateDevice, will_return(VK_ERROR_INITIALIZATION_FAILED));
+	expect(vkCreateDevice, will_return(VK_SUCCESS));
+	expect(vkGetDeviceQueue);
+	expect(vkGetDeviceQueue);
+	expect(vkGetDeviceQueue);
+	expect(vkGetDeviceQueue);
+	expect(vkqueues_init);
+	expect(vkmemory_init);
+	expect(vkcmdpool_init, will_return(VK_SUCCESS));
+	expect(vkcompute_init, will_return(VK_SUCCESS));
+	expect(vktransfer_init, will_return(VK_SUCCESS));
+	expect(vkuniform_init, will_return(VK_SUCCESS));
+	expect(vkstaging_init, will_return(VK_SUCCESS));
+	never_expect(vkrpcache_get);
+	compiler_result = -1;
 	int error = vkrenderer_init(&vkr, instance, surface);
+	compiler_result = 0;
 	assert_that(error, is_not_equal_to(0));
+	assert_that(compile_workers, is_equal_to(VKCOMPILER_MAX_WORKERS));
+	assert_that(compile_cache_control, is_not_equal_to(0));
 }
 
-Ensure(init_returns_non_zero_on_command_pool_fail)
+Ensure(init_returns_non_zero_on_pipeline_registry_fail)
 {
 	VkInstance instance = (VkInstance)1;
 	VkSurfaceKHR surface = (VkSurfaceKHR)2;
@@ -142,9 +1101,21 @@ Ensure(init_returns_non_zero_on_command_pool_fail)
 	expect(vkCreateDevice, will_return(VK_SUCCESS));
 	expect(vkGetDeviceQueue);
 	expect(vkGetDeviceQueue);
-	expect(vkCreateCommandPool, will_return(VK_NOT_READY));
+	expect(vkGetDeviceQueue);
+	expect(vkGetDeviceQueue);
+	expect(vkqueues_init);
+	expect(vkmemory_init);
+	expect(vkcmdpool_init, will_return(VK_SUCCESS));
+	expect(vkcompute_init, will_return(VK_SUCCESS));
+	expect(vktransfer_init, will_return(VK_SUCCESS));
+	expect(vkuniform_init, will_return(VK_SUCCESS));
+	expect(vkstaging_init, will_return(VK_SUCCESS));
+	never_expect(vkrpcache_get);
+	registry_result = -1;
 	int error = vkrenderer_init(&vkr, instance, surface);
+	registry_result = 0;
 	assert_that(error, is_not_equal_to(0));
+	assert_that(registry_compiler, is_equal_to(&vkr.compiler));
 }
 
 Ensure(init_returns_non_zero_on_renderpass_fail)
@@ -156,8 +1127,16 @@ Ensure(init_returns_non_zero_on_renderpass_fail)
 	expect(vkCreateDevice, will_return(VK_SUCCESS));
 	expect(vkGetDeviceQueue);
 	expect(vkGetDeviceQueue);
-	expect(vkCreateCommandPool, will_return(VK_SUCCESS));
-	expect(vkCreateRenderPass, will_return(VK_NOT_READY));
+	expect(vkGetDeviceQueue);
+	expect(vkGetDeviceQueue);
+	expect(vkqueues_init);
+	expect(vkmemory_init);
+	expect(vkcmdpool_init, will_return(VK_SUCCESS));
+	expect(vkcompute_init, will_return(VK_SUCCESS));
+	expect(vktransfer_init, will_return(VK_SUCCESS));
+	expect(vkuniform_init, will_return(VK_SUCCESS));
+	expect(vkstaging_init, will_return(VK_SUCCESS));
+	expect(vkrpcache_get, will_return(VK_NOT_READY));
 	int error = vkrenderer_init(&vkr, instance, surface);
 	assert_that(error, is_not_equal_to(0));
 }
@@ -171,8 +1150,18 @@ Ensure(init_returns_non_zero_on_swapchain_fail)
 	expect(vkCreateDevice, will_return(VK_SUCCESS));
 	expect(vkGetDeviceQueue);
 	expect(vkGetDeviceQueue);
-	expect(vkCreateCommandPool, will_return(VK_SUCCESS));
-	expect(vkCreateRenderPass, will_return(VK_SUCCESS));
+	expect(vkGetDeviceQueue);
+	expect(vkGetDeviceQueue);
+	expect(vkqueues_init);
+	expect(vkmemory_init);
+	expect(vkcmdpool_init, will_return(VK_SUCCESS));
+	expect(vkcompute_init, will_return(VK_SUCCESS));
+	expect(vktransfer_init, will_return(VK_SUCCESS));
+	expect(vkuniform_init, will_return(VK_SUCCESS));
+	expect(vkstaging_init, will_return(VK_SUCCESS));
+	expect(vkrpcache_get, will_return(VK_SUCCESS));
+	expect(vkflight_init, will_return(VK_SUCCESS));
+	expect(vkflight_init, will_return(VK_SUCCESS));
 	expect(vkswapchain_init, will_return(-1));
 	int error = vkrenderer_init(&vkr, instance, surface);
 	assert_that(error, is_not_equal_to(0));
@@ -180,41 +1169,230 @@ Ensure(init_returns_non_zero_on_swapchain_fail)
 
 Ensure(render_returns_zero_on_success)
 {
-	struct vkrenderer vkr = { 0 };
+	struct vkrenderer vkr = {
+		.nflights = 2,
+		.flights = { { .frame = 2 }, { .frame = 3 } },
+		.frame = 3,
+	};
+	expect(vkflight_wait, when(flight, is_equal_to(&vkr.flights[0])),
+	       will_return(VK_SUCCESS));
 	expect(vkswapchain_render, when(swc, is_equal_to(&vkr.swcs[0])),
-	       when(rdr, is_equal_to(&vkr)), will_return(VK_SUCCESS));
+	       when(rdr, is_equal_to(&vkr)),
+	       when(flight, is_equal_to(&vkr.flights[0])),
+	       will_return(VK_SUCCESS));
+	int error = vkrenderer_render(&vkr);
+	assert_that(error, is_equal_to(0));
+	assert_that(vkr.flight_index, is_equal_to(1));
+	assert_that(vkr.completed, is_equal_to(2));
+	assert_that(collected_frame, is_equal_to(2));
+}
+
+Ensure(render_collects_pending_uploads)
+{
+	struct vkrenderer vkr = {
+		.nflights = 2,
+		.flights = { { .frame = 2 }, { .frame = 3 } },
+		.frame = 3,
+		.uploads = { .count = 1 },
+	};
+	expect(vktransfer_collect, when(xfer, is_equal_to(&vkr.uploads)),
+	       will_return(VK_SUCCESS));
+	expect(vkflight_wait, will_return(VK_SUCCESS));
+	expect(vkswapchain_render, will_return(VK_SUCCESS));
+	int error = vkrenderer_render(&vkr);
+	assert_that(error, is_equal_to(0));
+}
+
+Ensure(render_returns_non_zero_on_uploads_fail)
+{
+	struct vkrenderer vkr = {
+		.nflights = 2,
+		.frame = 3,
+		.uploads = { .count = 1 },
+	};
+	expect(vktransfer_collect, will_return(VK_ERROR_DEVICE_LOST));
+	never_expect(vkswapchain_render);
+	int error = vkrenderer_render(&vkr);
+	assert_that(error, is_not_equal_to(0));
+}
+
+Ensure(render_flushes_staged_uploads)
+{
+	struct vkrenderer vkr = {
+		.nflights = 2,
+		.flights = { { .frame = 2 }, { .frame = 3 } },
+		.frame = 3,
+	};
+	flushed_staging = NULL;
+	expect(vkflight_wait, will_return(VK_SUCCESS));
+	expect(vkswapchain_render, will_return(VK_SUCCESS));
+	int error = vkrenderer_render(&vkr);
+	assert_that(error, is_equal_to(0));
+	assert_that(flushed_staging, is_equal_to(&vkr.staging));
+}
+
+Ensure(render_steps_defragmenter_before_recording)
+{
+	struct vkrenderer vkr = {
+		.nflights = 2,
+		.flights = { { .frame = 2 }, { .frame = 3 } },
+		.frame = 3,
+	};
+	defrag_frame = 0;
+	defrag_completed = 0;
+	expect(vkflight_wait, will_return(VK_SUCCESS));
+	expect(vkswapchain_render, will_return(VK_SUCCESS));
+	vkrenderer_render(&vkr);
+	assert_that(defrag_frame, is_equal_to(3));
+	assert_that(defrag_completed, is_equal_to(2));
+}
+
+Ensure(render_returns_non_zero_on_staging_fail)
+{
+	struct vkrenderer vkr = {
+		.nflights = 2,
+		.frame = 3,
+	};
+	flush_result = VK_ERROR_DEVICE_LOST;
+	never_expect(vkswapchain_render);
+	int error = vkrenderer_render(&vkr);
+	flush_result = VK_SUCCESS;
+	assert_that(error, is_not_equal_to(0));
+}
+
+Ensure(render_trims_memory_budget_periodically)
+{
+	struct vkrenderer vkr = {
+		.nflights = 2,
+		.flights = { { .frame = VKRENDERER_BUDGET_PERIOD - 1 },
+			     { .frame = VKRENDERER_BUDGET_PERIOD } },
+		.frame = VKRENDERER_BUDGET_PERIOD,
+	};
+	trimmed_frame = 0;
+	expect(vkflight_wait, will_return(VK_SUCCESS));
+	expect(vkswapchain_render, will_return(VK_SUCCESS));
+	vkrenderer_render(&vkr);
+	assert_that(trimmed_frame, is_equal_to(VKRENDERER_BUDGET_PERIOD - 1));
+	vkr.frame++;
+	trimmed_frame = 0;
+	expect(vkflight_wait, will_return(VK_SUCCESS));
+	expect(vkswapchain_render, will_return(VK_SUCCESS));
+	vkrenderer_render(&vkr);
+	assert_that(trimmed_frame, is_equal_to(0));
+}
+
+Ensure(render_skips_wait_for_unused_flight)
+{
+	struct vkrenderer vkr = {
+		.nflights = 2,
+	};
+	never_expect(vkflight_wait);
+	expect(vkswapchain_render, will_return(VK_SUCCESS));
+	int error = vkrenderer_render(&vkr);
+	assert_that(error, is_equal_to(0));
+}
+
+Ensure(render_waits_for_timeline_semaphore_when_supported)
+{
+	struct vkrenderer vkr = {
+		.vkd = mocked_dispatch,
+		.caps = VKRENDERER_CAP_TIMELINE_SEMAPHORE,
+		.nflights = 2,
+		.flights = { { .frame = 2 }, { .frame = 3 } },
+		.frame = 3,
+	};
+	never_expect(vkflight_wait);
+	expect(vkWaitSemaphores, when(timeout, is_equal_to(UINT64_MAX)),
+	       will_return(VK_SUCCESS));
+	expect(vkswapchain_render, will_return(VK_SUCCESS));
+	int error = vkrenderer_render(&vkr);
+	assert_that(error, is_equal_to(0));
+	assert_that(vkr.completed, is_equal_to(2));
+}
+
+Ensure(render_returns_non_zero_on_timeline_wait_fail)
+{
+	struct vkrenderer vkr = {
+		.vkd = mocked_dispatch,
+		.caps = VKRENDERER_CAP_TIMELINE_SEMAPHORE,
+		.nflights = 2,
+		.flights = { { .frame = 2 }, { .frame = 3 } },
+		.frame = 3,
+	};
+	expect(vkWaitSemaphores, will_return(VK_ERROR_DEVICE_LOST));
+	never_expect(vkswapchain_render);
+	int error = vkrenderer_render(&vkr);
+	assert_that(error, is_not_equal_to(0));
+}
+
+Ensure(render_cycles_frames_in_flight)
+{
+	struct vkrenderer vkr = {
+		.nflights = 2,
+		.flight_index = 1,
+		.flights = { { .frame = 2 }, { .frame = 1 } },
+		.frame = 2,
+	};
+	expect(vkflight_wait, when(flight, is_equal_to(&vkr.flights[1])),
+	       will_return(VK_SUCCESS));
+	expect(vkswapchain_render, when(flight, is_equal_to(&vkr.flights[1])),
+	       will_return(VK_SUCCESS));
 	int error = vkrenderer_render(&vkr);
 	assert_that(error, is_equal_to(0));
+	assert_that(vkr.flight_index, is_equal_to(0));
+}
+
+Ensure(render_returns_non_zero_on_flight_wait_fail)
+{
+	struct vkrenderer vkr = {
+		.nflights = 2,
+		.flights = { { .frame = 1 } },
+		.frame = 1,
+	};
+	expect(vkflight_wait, will_return(VK_ERROR_DEVICE_LOST));
+	never_expect(vkswapchain_render);
+	int error = vkrenderer_render(&vkr);
+	assert_that(error, is_not_equal_to(0));
 }
 
 Ensure(render_recreates_swapchain)
 {
-	struct vkrenderer vkr = { 0 };
+	struct vkrenderer vkr = {
+		.srf_caps.currentExtent = { .width = 640, .height = 480 },
+		.nflights = 2,
+		.frame = 1,
+	};
 	expect(vkswapchain_render, when(swc, is_equal_to(&vkr.swcs[0])),
 	       when(rdr, is_equal_to(&vkr)),
 	       will_return(VK_ERROR_OUT_OF_DATE_KHR));
-	expect(vkDeviceWaitIdle, when(device, is_equal_to(vkr.device)));
+	never_expect(vkflight_wait);
+	never_expect(vkDeviceWaitIdle);
 	expect(vkrenderer_configure_swapchain, will_return(0),
 	       when(rdr, is_equal_to(&vkr)));
 	expect(vkswapchain_init, will_return(0),
 	       when(swc, is_equal_to(&vkr.swcs[1])));
-	expect(vkswapchain_terminate, when(swc, is_equal_to(&vkr.swcs[0])));
+	never_expect(vkswapchain_terminate);
 	expect(vkswapchain_render, when(swc, is_equal_to(&vkr.swcs[1])),
 	       when(rdr, is_equal_to(&vkr)), will_return(VK_SUCCESS));
 	int error = vkrenderer_render(&vkr);
 	assert_that(error, is_equal_to(0));
 	assert_that(vkr.swc_index, is_equal_to(1));
+	assert_that(vkr.nretired, is_equal_to(1));
+	assert_that(vkr.swcs[0].retired_frame, is_equal_to(1));
 }
 
 Ensure(render_returns_non_zero_on_swapchain_config_fail)
 {
-	struct vkrenderer vkr = { 0 };
+	struct vkrenderer vkr = {
+		.srf_caps.currentExtent = { .width = 640, .height = 480 },
+		.nflights = 2,
+	};
 	expect(vkswapchain_render, when(swc, is_equal_to(&vkr.swcs[0])),
 	       when(rdr, is_equal_to(&vkr)),
 	       will_return(VK_ERROR_OUT_OF_DATE_KHR));
-	expect(vkDeviceWaitIdle, when(device, is_equal_to(vkr.device)));
 	expect(vkrenderer_configure_swapchain, will_return(1),
 	       when(rdr, is_equal_to(&vkr)));
+	never_expect(vkswapchain_init);
 	int error = vkrenderer_render(&vkr);
 	assert_that(error, is_not_equal_to(0));
 	assert_that(vkr.swc_index, is_equal_to(0));
@@ -222,11 +1400,13 @@ Ensure(render_returns_non_zero_on_swapchain_config_fail)
 
 Ensure(render_returns_non_zero_on_swapchain_init_fail)
 {
-	struct vkrenderer vkr = { 0 };
+	struct vkrenderer vkr = {
+		.srf_caps.currentExtent = { .width = 640, .height = 480 },
+		.nflights = 2,
+	};
 	expect(vkswapchain_render, when(swc, is_equal_to(&vkr.swcs[0])),
 	       when(rdr, is_equal_to(&vkr)),
 	       will_return(VK_ERROR_OUT_OF_DATE_KHR));
-	expect(vkDeviceWaitIdle, when(device, is_equal_to(vkr.device)));
 	expect(vkrenderer_configure_swapchain, will_return(0),
 	       when(rdr, is_equal_to(&vkr)));
 	expect(vkswapchain_init, will_return(1),
@@ -234,20 +1414,403 @@ Ensure(render_returns_non_zero_on_swapchain_init_fail)
 	int error = vkrenderer_render(&vkr);
 	assert_that(error, is_not_equal_to(0));
 	assert_that(vkr.swc_index, is_equal_to(0));
+	assert_that(vkr.nretired, is_equal_to(0));
 }
 
-Ensure(terminate_destroys_all_resources)
+Ensure(render_skips_frame_when_surface_has_zero_size)
+{
+	struct vkrenderer vkr = {
+		.srf_caps.currentExtent = { .width = 0, .height = 0 },
+		.nflights = 2,
+		.swc_outdated = 1,
+	};
+	expect(vkrenderer_configure_swapchain, will_return(0));
+	never_expect(vkswapchain_init);
+	never_expect(vkswapchain_render);
+	int error = vkrenderer_render(&vkr);
+	assert_that(error, is_equal_to(0));
+	assert_that(vkr.swc_outdated, is_not_equal_to(0));
+	assert_that(vkr.flight_index, is_equal_to(0));
+}
+
+Ensure(render_marks_suboptimal_swapchain_outdated)
+{
+	struct vkrenderer vkr = {
+		.nflights = 2,
+	};
+	expect(vkswapchain_render, will_return(VK_SUBOPTIMAL_KHR));
+	never_expect(vkrenderer_configure_swapchain);
+	int error = vkrenderer_render(&vkr);
+	assert_that(error, is_equal_to(0));
+	assert_that(vkr.swc_outdated, is_not_equal_to(0));
+}
+
+Ensure(render_does_not_retry_frame_presented_out_of_date)
+{
+	struct vkrenderer vkr = {
+		.srf_caps.currentExtent = { .width = 640, .height = 480 },
+		.nflights = 2,
+	};
+	/* Out of date present of submitted frame is reported as suboptimal */
+	expect(vkswapchain_render, when(flight, is_equal_to(&vkr.flights[0])),
+	       will_return(VK_SUBOPTIMAL_KHR));
+	never_expect(vkrenderer_configure_swapchain);
+	never_expect(vkswapchain_init);
+	int error = vkrenderer_render(&vkr);
+	assert_that(error, is_equal_to(0));
+	assert_that(vkr.swc_outdated, is_not_equal_to(0));
+	assert_that(vkr.flight_index, is_equal_to(1));
+}
+
+Ensure(render_destroys_completed_retired_swapchain)
+{
+	struct vkrenderer vkr = {
+		.nflights = 2,
+		.swcs = { { .retired_frame = 2 } },
+		.swc_index = 1,
+		.nretired = 1,
+		.frame = 3,
+		.completed = 2,
+	};
+	expect(vkswapchain_terminate, when(swc, is_equal_to(&vkr.swcs[0])));
+	expect(vkswapchain_render, when(swc, is_equal_to(&vkr.swcs[1])),
+	       will_return(VK_SUCCESS));
+	int error = vkrenderer_render(&vkr);
+	assert_that(error, is_equal_to(0));
+	assert_that(vkr.nretired, is_equal_to(0));
+}
+
+Ensure(render_keeps_retired_swapchain_while_its_frames_pending)
+{
+	struct vkrenderer vkr = {
+		.nflights = 2,
+		.swcs = { { .retired_frame = 3 } },
+		.swc_index = 1,
+		.nretired = 1,
+		.frame = 3,
+		.completed = 2,
+	};
+	never_expect(vkswapchain_terminate);
+	expect(vkswapchain_render, will_return(VK_SUCCESS));
+	int error = vkrenderer_render(&vkr);
+	assert_that(error, is_equal_to(0));
+	assert_that(vkr.nretired, is_equal_to(1));
+}
+
+Ensure(render_waits_for_oldest_retired_swapchain)
+{
+	struct vkrenderer vkr = {
+		.srf_caps.currentExtent = { .width = 640, .height = 480 },
+		.nflights = 2,
+		.flights = { { .frame = 1 }, { .frame = 3 } },
+		.swcs = {
+			{ .retired_frame = 1 },
+			{ .retired_frame = 2 },
+			{ .retired_frame = 3 },
+		},
+		.swc_index = VKRENDERER_MAX_SWAPCHAINS - 1,
+		.nretired = VKRENDERER_MAX_SWAPCHAINS - 1,
+		.swc_outdated = 1,
+		.frame = 3,
+	};
+	expect(vkrenderer_configure_swapchain, will_return(0));
+	expect(vkflight_wait, when(flight, is_equal_to(&vkr.flights[0])),
+	       will_return(VK_SUCCESS));
+	expect(vkswapchain_terminate, when(swc, is_equal_to(&vkr.swcs[0])));
+	expect(vkswapchain_init, will_return(0),
+	       when(swc, is_equal_to(&vkr.swcs[0])));
+	expect(vkswapchain_render, when(swc, is_equal_to(&vkr.swcs[0])),
+	       will_return(VK_SUCCESS));
+	int error = vkrenderer_render(&vkr);
+	assert_that(error, is_equal_to(0));
+	assert_that(vkr.swc_index, is_equal_to(0));
+	assert_that(vkr.nretired, is_equal_to(VKRENDERER_MAX_SWAPCHAINS - 1));
+}
+
+Ensure(resize_outdates_swapchain)
 {
 	struct vkrenderer vkr = { 0 };
+	vkrenderer_resize(&vkr);
+	vkrenderer_resize(&vkr);
+	assert_that(vkr.swc_outdated, is_not_equal_to(0));
+}
+
+Ensure(terminate_destroys_retired_swapchains)
+{
+	struct vkrenderer vkr = {
+		.swc_index = 0,
+		.nretired = 2,
+	};
+	expect(vkDeviceWaitIdle);
+	expect(vkswapchain_terminate, when(swc, is_equal_to(&vkr.swcs[2])));
+	expect(vkswapchain_terminate, when(swc, is_equal_to(&vkr.swcs[3])));
+	expect(vkswapchain_terminate, when(swc, is_equal_to(&vkr.swcs[0])));
+	expect(vkDestroySemaphore);
+	expect(vkrpcache_destroy);
+	expect(vkpipereg_destroy);
+	expect(vkcompiler_destroy);
+	expect(vkpipecache_destroy);
+	expect(vkstaging_destroy);
+	expect(vktransfer_destroy);
+	expect(vkcompute_destroy);
+	expect(vkcmdpool_destroy);
+	expect(vkuniform_destroy);
+	expect(vkmemory_destroy);
+	expect(vkDestroyDevice);
+	expect(vkhost_destroy);
+	vkrenderer_terminate(&vkr);
+}
+
+Ensure(terminate_destroys_all_resources)
+{
+	struct vkrenderer vkr = {
+		.nflights = 2,
+	};
+	expect(vkDeviceWaitIdle);
+	expect(vkrpcache_destroy);
+	expect(vkpipereg_destroy);
+	expect(vkcompiler_destroy);
+	expect(vkpipecache_destroy);
+	expect(vkswapchain_terminate);
+	expect(vkflight_destroy, when(flight, is_equal_to(&vkr.flights[0])));
+	expect(vkflight_destroy, when(flight, is_equal_to(&vkr.flights[1])));
+	expect(vkDestroySemaphore);
+	expect(vkstaging_destroy);
+	expect(vktransfer_destroy);
+	expect(vkcompute_destroy);
+	expect(vkcmdpool_destroy);
+	expect(vkuniform_destroy);
+	expect(vkmemory_destroy);
+	expect(vkDestroyDevice,
+	       when(pAllocator, is_equal_to(&vkr.host.callbacks)));
+	expect(vkhost_destroy, when(host, is_equal_to(&vkr.host)));
+	never_expect(vkrecorder_destroy);
+	never_expect(vkcompiler_caches);
+	never_expect(vkpipecache_merge);
+	never_expect(vkpipecache_save);
+
+	vkrenderer_terminate(&vkr);
+}
+
+Ensure(terminate_stops_recorder_when_recording_in_parallel)
+{
+	struct vkrenderer vkr = {
+		.record_mode = VKRENDERER_RECORD_PARALLEL,
+	};
 	expect(vkDeviceWaitIdle);
-	expect(vkDestroyRenderPass);
 	expect(vkswapchain_terminate);
-	expect(vkDestroyCommandPool);
+	expect(vkrecorder_destroy, when(rec, is_equal_to(&vkr.recorder)));
+	expect(vkDestroySemaphore);
+	expect(vkrpcache_destroy);
+	expect(vkpipereg_destroy);
+	expect(vkcompiler_destroy);
+	expect(vkpipecache_destroy);
+	expect(vkstaging_destroy);
+	expect(vktransfer_destroy);
+	expect(vkcompute_destroy);
+	expect(vkcmdpool_destroy);
+	expect(vkuniform_destroy);
+	expect(vkmemory_destroy);
 	expect(vkDestroyDevice);
+	expect(vkhost_destroy);
+	vkrenderer_terminate(&vkr);
+}
 
+Ensure(terminate_saves_pipeline_cache_to_file)
+{
+	struct vkrenderer vkr = { .pipeline_cache_path = "pipelines" };
+	expect(vkDeviceWaitIdle);
+	expect(vkswapchain_terminate);
+	expect(vkDestroySemaphore);
+	expect(vkrpcache_destroy);
+	expect(vkpipereg_destroy, when(reg, is_equal_to(&vkr.pipelines)));
+	expect(vkcompiler_caches, when(comp, is_equal_to(&vkr.compiler)),
+	       will_return(2));
+	expect(vkpipecache_merge,
+	       when(cache, is_equal_to(&vkr.pipeline_cache)),
+	       when(count, is_equal_to(2)), will_return(VK_SUCCESS));
+	expect(vkpipecache_save, when(cache, is_equal_to(&vkr.pipeline_cache)),
+	       when(path, is_equal_to_string("pipelines")), will_return(0));
+	expect(vkcompiler_destroy, when(comp, is_equal_to(&vkr.compiler)));
+	expect(vkpipecache_destroy,
+	       when(cache, is_equal_to(&vkr.pipeline_cache)));
+	expect(vkstaging_destroy);
+	expect(vktransfer_destroy);
+	expect(vkcompute_destroy);
+	expect(vkcmdpool_destroy);
+	expect(vkuniform_destroy);
+	expect(vkmemory_destroy);
+	expect(vkDestroyDevice);
+	expect(vkhost_destroy);
 	vkrenderer_terminate(&vkr);
 }
 
+Ensure(render_recreates_outdated_swapchain_before_rendering)
+{
+	struct vkrenderer vkr = {
+		.srf_caps.currentExtent = { .width = 640, .height = 480 },
+		.nflights = 2,
+		.swc_outdated = 1,
+	};
+	expect(vkrenderer_configure_swapchain, will_return(0));
+	expect(vkswapchain_init, will_return(0),
+	       when(swc, is_equal_to(&vkr.swcs[1])));
+	never_expect(vkswapchain_terminate);
+	expect(vkswapchain_render, when(swc, is_equal_to(&vkr.swcs[1])),
+	       will_return(VK_SUCCESS));
+	int error = vkrenderer_render(&vkr);
+	assert_that(error, is_equal_to(0));
+	assert_that(vkr.swc_index, is_equal_to(1));
+	assert_that(vkr.swc_outdated, is_equal_to(0));
+}
+
+Ensure(begin_compute_begins_job_when_slot_is_free)
+{
+	VkCommandBuffer cmds;
+	struct vkrenderer vkr = { .frame = 3, .completed = 2 };
+	expect(vkcompute_collect, when(completed, is_equal_to(2)));
+	expect(vkcompute_begin, when(cmp, is_equal_to(&vkr.compute_jobs)),
+	       will_return(VK_SUCCESS));
+	VkResult result = vkrenderer_begin_compute(&vkr, &cmds);
+	assert_that(result, is_equal_to(VK_SUCCESS));
+}
+
+Ensure(begin_compute_waits_for_frame_waiting_for_oldest_job)
+{
+	VkCommandBuffer cmds;
+	struct vkrenderer vkr = {
+		.vkd = mocked_dispatch,
+		.nflights = 2,
+		.flights = { { .frame = 3 }, { .frame = 2 } },
+		.frame = 3,
+		.completed = 1,
+		.compute_jobs = { .count = VKCOMPUTE_MAX_JOBS },
+	};
+	vkr.compute_jobs.jobs[0].frame = 2;
+	expect(vkGetFenceStatus, will_return(VK_NOT_READY));
+	expect(vkGetFenceStatus, will_return(VK_NOT_READY));
+	expect(vkcompute_collect, when(completed, is_equal_to(1)));
+	expect(vkflight_wait, when(flight, is_equal_to(&vkr.flights[1])),
+	       will_return(VK_SUCCESS));
+	expect(vkcompute_collect, when(completed, is_equal_to(2)));
+	expect(vkcompute_begin, will_return(VK_SUCCESS));
+	VkResult result = vkrenderer_begin_compute(&vkr, &cmds);
+	assert_that(result, is_equal_to(VK_SUCCESS));
+}
+
+Ensure(begin_compute_returns_not_ready_when_jobs_are_not_waited)
+{
+	VkCommandBuffer cmds;
+	struct vkrenderer vkr = {
+		.compute_jobs = { .count = VKCOMPUTE_MAX_JOBS },
+	};
+	expect(vkcompute_collect);
+	never_expect(vkcompute_begin);
+	VkResult result = vkrenderer_begin_compute(&vkr, &cmds);
+	assert_that(result, is_equal_to(VK_NOT_READY));
+}
+
+Ensure(submit_compute_submits_job_for_next_frame)
+{
+	struct vkrenderer vkr = { 0 };
+	expect(vkcompute_submit, when(cmp, is_equal_to(&vkr.compute_jobs)),
+	       when(stage, is_equal_to(VK_PIPELINE_STAGE_VERTEX_INPUT_BIT)),
+	       will_return(VK_SUCCESS));
+	VkResult result = vkrenderer_submit_compute(
+		&vkr, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+	assert_that(result, is_equal_to(VK_SUCCESS));
+}
+
+Ensure(set_present_policy_outdates_swapchain)
+{
+	struct vkrenderer vkr = {
+		.present_policy = VKRENDERER_PRESENT_POWER,
+	};
+	vkrenderer_set_present_policy(&vkr, VKRENDERER_PRESENT_LATENCY);
+	assert_that(vkr.present_policy,
+		    is_equal_to(VKRENDERER_PRESENT_LATENCY));
+	assert_that(vkr.swc_outdated, is_not_equal_to(0));
+}
+
+Ensure(set_same_present_policy_keeps_swapchain)
+{
+	struct vkrenderer vkr = {
+		.present_policy = VKRENDERER_PRESENT_LATENCY,
+	};
+	vkrenderer_set_present_policy(&vkr, VKRENDERER_PRESENT_LATENCY);
+	assert_that(vkr.swc_outdated, is_equal_to(0));
+}
+
+Ensure(wait_frame_returns_non_zero_for_unsubmitted_frame)
+{
+	struct vkrenderer vkr = {
+		.nflights = 2,
+		.frame = 3,
+	};
+	never_expect(vkflight_wait);
+	int error = vkrenderer_wait_frame(&vkr, 4);
+	assert_that(error, is_not_equal_to(0));
+}
+
+Ensure(wait_frame_waits_for_all_older_flights)
+{
+	struct vkrenderer vkr = {
+		.nflights = 3,
+		.flights = { { .frame = 4 }, { .frame = 5 }, { .frame = 3 } },
+		.frame = 5,
+		.completed = 2,
+	};
+	expect(vkflight_wait, when(flight, is_equal_to(&vkr.flights[0])),
+	       will_return(VK_SUCCESS));
+	expect(vkflight_wait, when(flight, is_equal_to(&vkr.flights[2])),
+	       will_return(VK_SUCCESS));
+	int error = vkrenderer_wait_frame(&vkr, 4);
+	assert_that(error, is_equal_to(0));
+	assert_that(vkr.completed, is_equal_to(4));
+}
+
+Ensure(completed_frame_reads_timeline_semaphore_when_supported)
+{
+	uint64_t value = 5;
+	struct vkrenderer vkr = {
+		.vkd = mocked_dispatch,
+		.caps = VKRENDERER_CAP_TIMELINE_SEMAPHORE,
+		.frame = 6,
+		.completed = 3,
+	};
+	expect(vkGetSemaphoreCounterValue, will_return(VK_SUCCESS),
+	       will_set_contents_of_parameter(pValue, &value, sizeof(value)));
+	uint64_t completed = vkrenderer_completed_frame(&vkr);
+	assert_that(completed, is_equal_to(5));
+	assert_that(vkr.completed, is_equal_to(5));
+}
+
+Ensure(completed_frame_stops_at_first_pending_fence)
+{
+	struct vkrenderer vkr = {
+		.vkd = mocked_dispatch,
+		.nflights = 3,
+		.flights = {
+			{ .fence = (VkFence)1, .frame = 4 },
+			{ .fence = (VkFence)2, .frame = 5 },
+			{ .fence = (VkFence)3, .frame = 3 },
+		},
+		.frame = 5,
+		.completed = 2,
+	};
+	expect(vkGetFenceStatus,
+	       when(fence, is_equal_to(vkr.flights[0].fence)),
+	       will_return(VK_NOT_READY));
+	expect(vkGetFenceStatus,
+	       when(fence, is_equal_to(vkr.flights[1].fence)),
+	       will_return(VK_SUCCESS));
+	expect(vkGetFenceStatus,
+	       when(fence, is_equal_to(vkr.flights[2].fence)),
+	       will_return(VK_SUCCESS));
+	uint64_t completed = vkrenderer_completed_frame(&vkr);
+	assert_that(completed, is_equal_to(3));
+}
+
 int main(int argc, char **argv)
 {
 	(void)(argc);
@@ -255,15 +1818,70 @@ int main(int argc, char **argv)
 	TestSuite *vkr = create_named_test_suite("VKRenderer");
 	add_test(vkr, init_returns_zero_on_success);
 	add_test(vkr, init_returns_non_zero_when_no_configs);
+	add_test(vkr, init_creates_device_with_host_allocator);
+	add_test(vkr, init_returns_non_zero_on_host_allocator_fail);
 	add_test(vkr, init_returns_non_zero_on_device_fail);
 	add_test(vkr, init_returns_non_zero_on_command_pool_fail);
+	add_test(vkr, init_leases_extra_graphics_queues);
+	add_test(vkr, init_creates_memory_allocator_for_device);
+	add_test(vkr, init_tracks_memory_budget_reported_by_device);
+	add_test(vkr, init_returns_non_zero_on_compute_fail);
+	add_test(vkr, init_returns_non_zero_on_uploads_fail);
+	add_test(vkr, init_returns_non_zero_on_uniforms_fail);
+	add_test(vkr, init_returns_non_zero_on_staging_fail);
+	add_test(vkr, init_passes_requested_upload_budget);
+	add_test(vkr, init_returns_non_zero_on_defrag_fail);
+	add_test(vkr, init_returns_non_zero_on_pipeline_cache_fail);
+	add_test(vkr, init_returns_non_zero_on_compiler_fail);
+	add_test(vkr, init_returns_non_zero_on_pipeline_registry_fail);
 	add_test(vkr, init_returns_non_zero_on_renderpass_fail);
 	add_test(vkr, init_returns_non_zero_on_swapchain_fail);
+	add_test(vkr, init_limits_number_of_frames_in_flight);
+	add_test(vkr, init_creates_flight_commands_when_recording_per_frame);
+	add_test(vkr, init_returns_non_zero_on_flight_commands_fail);
+	add_test(vkr, init_starts_recorder_when_recording_in_parallel);
+	add_test(vkr, init_returns_non_zero_on_recorder_fail);
+	add_test(vkr, init_returns_non_zero_on_flight_fail);
+	add_test(vkr, init_skips_render_pass_with_dynamic_rendering);
+	add_test(vkr, init_creates_timeline_semaphore_when_supported);
+	add_test(vkr, init_returns_non_zero_on_timeline_semaphore_fail);
 	add_test(vkr, render_returns_zero_on_success);
+	add_test(vkr, render_collects_pending_uploads);
+	add_test(vkr, render_returns_non_zero_on_uploads_fail);
+	add_test(vkr, render_flushes_staged_uploads);
+	add_test(vkr, render_steps_defragmenter_before_recording);
+	add_test(vkr, render_returns_non_zero_on_staging_fail);
+	add_test(vkr, render_trims_memory_budget_periodically);
+	add_test(vkr, render_skips_wait_for_unused_flight);
+	add_test(vkr, render_waits_for_timeline_semaphore_when_supported);
+	add_test(vkr, render_returns_non_zero_on_timeline_wait_fail);
+	add_test(vkr, render_cycles_frames_in_flight);
+	add_test(vkr, render_returns_non_zero_on_flight_wait_fail);
 	add_test(vkr, render_recreates_swapchain);
 	add_test(vkr, render_returns_non_zero_on_swapchain_config_fail);
 	add_test(vkr, render_returns_non_zero_on_swapchain_init_fail);
+	add_test(vkr, render_recreates_outdated_swapchain_before_rendering);
+	add_test(vkr, render_skips_frame_when_surface_has_zero_size);
+	add_test(vkr, render_marks_suboptimal_swapchain_outdated);
+	add_test(vkr, render_does_not_retry_frame_presented_out_of_date);
+	add_test(vkr, render_destroys_completed_retired_swapchain);
+	add_test(vkr, render_keeps_retired_swapchain_while_its_frames_pending);
+	add_test(vkr, render_waits_for_oldest_retired_swapchain);
+	add_test(vkr, resize_outdates_swapchain);
+	add_test(vkr, begin_compute_begins_job_when_slot_is_free);
+	add_test(vkr, begin_compute_waits_for_frame_waiting_for_oldest_job);
+	add_test(vkr, begin_compute_returns_not_ready_when_jobs_are_not_waited);
+	add_test(vkr, submit_compute_submits_job_for_next_frame);
+	add_test(vkr, set_present_policy_outdates_swapchain);
+	add_test(vkr, set_same_present_policy_keeps_swapchain);
+	add_test(vkr, wait_frame_returns_non_zero_for_unsubmitted_frame);
+	add_test(vkr, wait_frame_waits_for_all_older_flights);
+	add_test(vkr, completed_frame_reads_timeline_semaphore_when_supported);
+	add_test(vkr, completed_frame_stops_at_first_pending_fence);
 	add_test(vkr, terminate_destroys_all_resources);
+	add_test(vkr, terminate_stops_recorder_when_recording_in_parallel);
+	add_test(vkr, terminate_destroys_retired_swapchains);
+	add_test(vkr, terminate_saves_pipeline_cache_to_file);
 	TestReporter *reporter = create_text_reporter();
 	int exit_code = run_test_suite(vkr, reporter);
 	destroy_reporter(reporter);
@@ -0,0 +1,299 @@
+/**
+ * @file
+ * Vulkan render pass cache implementation
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "vkrpcache.h"
+#include <vulkan/vulkan_core.h>
+
+/** Number of slots allocated by the first insertion */
+#define VKRPCACHE_MIN_CAPACITY 16
+
+/**
+ * Mixes 32-bit value into FNV-1a hash
+ * @param hash Specifies hash to mix value into
+ * @param value Specifies value to mix
+ * @returns updated hash
+ */
+static uint64_t vkrpcache_mix(uint64_t hash, uint32_t value)
+{
+	for (size_t i = 0; i < sizeof(value); ++i) {
+		hash ^= (value >> (i * 8)) & 0xFF;
+		hash *= 0x100000001B3ULL;
+	}
+	return hash;
+}
+
+/**
+ * Mixes attachment configuration into hash
+ * @param hash Specifies hash to mix attachment into
+ * @param att Specifies attachment to mix
+ * @returns updated hash
+ */
+static uint64_t vkrpcache_mix_attachment(uint64_t hash,
+					 const struct vkrpcache_attachment *att)
+{
+	hash = vkrpcache_mix(hash, (uint32_t)att->format);
+	hash = vkrpcache_mix(hash, (uint32_t)att->samples);
+	hash = vkrpcache_mix(hash, (uint32_t)att->load);
+	hash = vkrpcache_mix(hash, (uint32_t)att->store);
+	hash = vkrpcache_mix(hash, (uint32_t)att->initial);
+	return vkrpcache_mix(hash, (uint32_t)att->final);
+}
+
+/**
+ * Hashes used attachments of render pass configuration
+ * @param key Specifies configuration to hash
+ * @returns hash of configuration
+ */
+static uint64_t vkrpcache_hash(const struct vkrpcache_key *key)
+{
+	uint64_t hash = vkrpcache_mix(0xCBF29CE484222325ULL, key->ncolors);
+	for (uint32_t i = 0; i < key->ncolors; ++i) {
+		hash = vkrpcache_mix_attachment(hash, &key->colors[i]);
+	}
+	if (key->depth.format != VK_FORMAT_UNDEFINED)
+		hash = vkrpcache_mix_attachment(hash, &key->depth);
+	return hash;
+}
+
+/**
+ * Checks if two attachment configurations are the same
+ * @param a Specifies the first attachment
+ * @param b Specifies the second attachment
+ * @returns non-zero if attachments are the same, or zero otherwise
+ */
+static int vkrpcache_attachment_equal(const struct vkrpcache_attachment *a,
+				      const struct vkrpcache_attachment *b)
+{
+	return a->format == b->format && a->samples == b->samples &&
+	       a->load == b->load && a->store == b->store &&
+	       a->initial == b->initial && a->final == b->final;
+}
+
+/**
+ * Checks if two render pass configurations are the same
+ * @param a Specifies the first configuration
+ * @param b Specifies the second configuration
+ * @returns non-zero if configurations are the same, or zero otherwise
+ */
+static int vkrpcache_key_equal(const struct vkrpcache_key *a,
+			       const struct vkrpcache_key *b)
+{
+	if (a->ncolors != b->ncolors)
+		return 0;
+	for (uint32_t i = 0; i < a->ncolors; ++i) {
+		if (!vkrpcache_attachment_equal(&a->colors[i], &b->colors[i]))
+			return 0;
+	}
+	if (a->depth.format == VK_FORMAT_UNDEFINED)
+		return b->depth.format == VK_FORMAT_UNDEFINED;
+	return vkrpcache_attachment_equal(&a->depth, &b->depth);
+}
+
+/**
+ * Finds slot holding configuration, or empty slot it must be inserted to
+ * @param entries Specifies hash table to search
+ * @param capacity Specifies number of slots, a power of two
+ * @param key Specifies configuration to find
+ * @param hash Specifies hash of @a key
+ * @returns pointer to found slot
+ */
+static struct vkrpcache_entry *
+vkrpcache_find(struct vkrpcache_entry *entries, size_t capacity,
+	       const struct vkrpcache_key *key, uint64_t hash)
+{
+	size_t index = (size_t)hash & (capacity - 1);
+	for (;;) {
+		struct vkrpcache_entry *entry = &entries[index];
+		if (entry->rpass == VK_NULL_HANDLE)
+			return entry;
+		if (entry->hash == hash &&
+		    vkrpcache_key_equal(&entry->key, key))
+			return entry;
+		index = (index + 1) & (capacity - 1);
+	}
+}
+
+/**
+ * Doubles number of slots, keeping load factor at most one half
+ * @param cache Specifies cache to grow
+ * @returns zero on success, or non-zero otherwise
+ */
+static int vkrpcache_grow(struct vkrpcache *cache)
+{
+	const size_t capacity = cache->capacity ? cache->capacity * 2 :
+						  VKRPCACHE_MIN_CAPACITY;
+	struct vkrpcache_entry *entries =
+		calloc(capacity, sizeof(struct vkrpcache_entry));
+	if (entries == NULL)
+		return -1;
+	for (size_t i = 0; i < cache->capacity; ++i) {
+		const struct vkrpcache_entry *entry = &cache->entries[i];
+		if (entry->rpass == VK_NULL_HANDLE)
+			continue;
+		*vkrpcache_find(entries, capacity, &entry->key, entry->hash) =
+			*entry;
+	}
+	free(cache->entries);
+	cache->entries = entries;
+	cache->capacity = capacity;
+	return 0;
+}
+
+/**
+ * Fills attachment description from its configuration
+ * @param desc Specifies description to fill
+ * @param att Specifies attachment configuration
+ */
+static void vkrpcache_describe(VkAttachmentDescription *desc,
+			       const struct vkrpcache_attachment *att)
+{
+	desc->flags = 0;
+	desc->format = att->format;
+	desc->samples = att->samples;
+	desc->loadOp = att->load;
+	desc->storeOp = att->store;
+	/* Stencil follows depth, color formats ignore these */
+	desc->stencilLoadOp = att->load;
+	desc->stencilStoreOp = att->store;
+	desc->initialLayout = att->initial;
+	desc->finalLayout = att->final;
+}
+
+/**
+ * Creates single subpass render pass for attachment configuration
+ * @param dev Specifies device to create render pass on
+ * @param host Specifies host memory allocator of driver, or NULL
+ * @param key Specifies attachment configuration
+ * @param rpass Specifies pointer to memory where render pass must be stored
+ * @returns VK_SUCCESS on success, or VkResult error otherwise
+ */
+static VkResult vkrpcache_create(VkDevice dev,
+				 const VkAllocationCallbacks *host,
+				 const struct vkrpcache_key *key,
+				 VkRenderPass *rpass)
+{
+	VkAttachmentDescription attachments[VKRPCACHE_MAX_COLORS + 1];
+	VkAttachmentReference colors[VKRPCACHE_MAX_COLORS];
+	const uint32_t ncolors = key->ncolors;
+	for (uint32_t i = 0; i < ncolors; ++i) {
+		vkrpcache_describe(&attachments[i], &key->colors[i]);
+		colors[i].attachment = i;
+		colors[i].layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	}
+	const int has_depth = key->depth.format != VK_FORMAT_UNDEFINED;
+	const VkAttachmentReference depth = {
+		.attachment = ncolors,
+		.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+	};
+	if (has_depth)
+		vkrpcache_describe(&attachments[ncolors], &key->depth);
+	const VkSubpassDescription subpass = {
+		.flags = 0,
+		.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+		.inputAttachmentCount = 0,
+		.pInputAttachments = NULL,
+		.colorAttachmentCount = ncolors,
+		.pColorAttachments = colors,
+		.pResolveAttachments = NULL,
+		.pDepthStencilAttachment = has_depth ? &depth : NULL,
+		.preserveAttachmentCount = 0,
+		.pPreserveAttachments = NULL,
+	};
+	const VkPipelineStageFlags depth_stages =
+		VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+		VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	const VkPipelineStageFlags stages =
+		VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+		(has_depth ? depth_stages : 0);
+	const VkAccessFlags depth_access =
+		VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+		VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	const VkSubpassDependency dependency = {
+		.srcSubpass = VK_SUBPASS_EXTERNAL,
+		.dstSubpass = 0,
+		.srcStageMask = stages,
+		.dstStageMask = stages,
+		.srcAccessMask = 0,
+		.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT |
+				 VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+				 (has_depth ? depth_access : 0),
+		.dependencyFlags = 0,
+	};
+	const VkRenderPassCreateInfo info = {
+		.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+		.pNext = NULL,
+		.flags = 0,
+		.attachmentCount = ncolors + (has_depth ? 1 : 0),
+		.pAttachments = attachments,
+		.subpassCount = 1,
+		.pSubpasses = &subpass,
+		.dependencyCount = 1,
+		.pDependencies = &dependency,
+	};
+	return vkCreateRenderPass(dev, &info, host, rpass);
+}
+
+void vkrpcache_init(struct vkrpcache *cache,
+		    const VkAllocationCallbacks *host)
+{
+	cache->entries = NULL;
+	cache->capacity = 0;
+	cache->count = 0;
+	cache->nhits = 0;
+	cache->nmisses = 0;
+	cache->host = host;
+}
+
+VkResult vkrpcache_get(struct vkrpcache *cache, VkDevice dev,
+		       const struct vkrpcache_key *key, VkRenderPass *rpass)
+{
+	const uint64_t hash = vkrpcache_hash(key);
+	struct vkrpcache_entry *entry = NULL;
+	if (cache->capacity > 0) {
+		entry = vkrpcache_find(cache->entries, cache->capacity, key,
+				       hash);
+		if (entry->rpass != VK_NULL_HANDLE) {
+			cache->nhits++;
+			*rpass = entry->rpass;
+			return VK_SUCCESS;
+		}
+	}
+	cache->nmisses++;
+	if ((cache->count + 1) * 2 > cache->capacity) {
+		if (vkrpcache_grow(cache))
+			return VK_ERROR_OUT_OF_HOST_MEMORY;
+		entry = vkrpcache_find(cache->entries, cache->capacity, key,
+				       hash);
+	}
+	VkResult result = vkrpcache_create(dev, cache->host, key,
+					   &entry->rpass);
+	if (result != VK_SUCCESS) {
+		entry->rpass = VK_NULL_HANDLE;
+		return result;
+	}
+	entry->key = *key;
+	entry->hash = hash;
+	cache->count++;
+	*rpass = entry->rpass;
+	return VK_SUCCESS;
+}
+
+void vkrpcache_destroy(struct vkrpcache *cache, VkDevice dev)
+{
+	for (size_t i = 0; i < cache->capacity; ++i) {
+		if (cache->entries[i].rpass != VK_NULL_HANDLE)
+			vkDestroyRenderPass(dev, cache->entries[i].rpass,
+					    cache->host);
+	}
+	free(cache->entries);
+	vkrpcache_init(cache, cache->host);
+}
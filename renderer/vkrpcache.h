@@ -0,0 +1,103 @@
+#ifndef RENDERER_VKRPCACHE_H
+#define RENDERER_VKRPCACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vulkan/vulkan_core.h>
+
+/** Maximum number of color attachments of cached render pass */
+#define VKRPCACHE_MAX_COLORS 4
+
+/** Attachment configuration render pass is compatible with */
+struct vkrpcache_attachment {
+	/** Format of attachment, VK_FORMAT_UNDEFINED if not used */
+	VkFormat format;
+	/** Number of samples of attachment */
+	VkSampleCountFlagBits samples;
+	/** How attachment contents are treated when render pass begins */
+	VkAttachmentLoadOp load;
+	/** How attachment contents are treated when render pass ends */
+	VkAttachmentStoreOp store;
+	/** Layout of attachment image when render pass begins */
+	VkImageLayout initial;
+	/** Layout attachment image is transitioned to when render pass ends */
+	VkImageLayout final;
+};
+
+/** Single subpass render pass configuration used as cache key */
+struct vkrpcache_key {
+	/** Number of color attachments, at most VKRPCACHE_MAX_COLORS */
+	uint32_t ncolors;
+	/** Color attachments, only the first @a ncolors ones are used */
+	struct vkrpcache_attachment colors[VKRPCACHE_MAX_COLORS];
+	/** Depth/stencil attachment, its format is undefined if not used */
+	struct vkrpcache_attachment depth;
+};
+
+/** Slot of render pass hash table */
+struct vkrpcache_entry {
+	/** Configuration of render pass */
+	struct vkrpcache_key key;
+	/** Hash of @a key */
+	uint64_t hash;
+	/** Cached render pass, VK_NULL_HANDLE if slot is empty */
+	VkRenderPass rpass;
+};
+
+/** Render passes hashed by their attachment configuration */
+struct vkrpcache {
+	/** Open addressing hash table, capacity is a power of two */
+	struct vkrpcache_entry *entries;
+	/** Number of slots in @a entries */
+	size_t capacity;
+	/** Number of cached render passes */
+	size_t count;
+	/** Number of lookups that found cached render pass */
+	uint64_t nhits;
+	/** Number of lookups that created new render pass */
+	uint64_t nmisses;
+	/** Host memory allocator of driver, or NULL */
+	const VkAllocationCallbacks *host;
+};
+
+#ifdef __cplusplus
+/* *INDENT-OFF* */
+extern "C" {
+/* *INDENT-ON* */
+#endif
+
+/**
+ * Initializes empty render pass cache
+ * @param cache Specifies cache to initialize
+ * @param host Specifies host memory allocator of driver, or NULL
+ */
+void vkrpcache_init(struct vkrpcache *cache,
+		    const VkAllocationCallbacks *host);
+
+/**
+ * Returns render pass for attachment configuration, creating it on miss
+ *
+ * Render passes are owned by cache and live until it is destroyed.
+ * @param cache Specifies cache to look render pass up in
+ * @param dev Specifies device to create render pass on
+ * @param key Specifies attachment configuration of render pass
+ * @param rpass Specifies pointer to memory where render pass must be stored
+ * @returns VK_SUCCESS on success, or VkResult error otherwise
+ */
+VkResult vkrpcache_get(struct vkrpcache *cache, VkDevice dev,
+		       const struct vkrpcache_key *key, VkRenderPass *rpass);
+
+/**
+ * Destroys all cached render passes
+ * @param cache Specifies cache to destroy
+ * @param dev Specifies device render passes are created on
+ */
+void vkrpcache_destroy(struct vkrpcache *cache, VkDevice dev);
+
+#ifdef __cplusplus
+/* *INDENT-OFF* */
+}
+/* *INDENT-ON* */
+#endif
+#endif
@@ -0,0 +1,170 @@
+/**
+ * @file
+ * Test suite for vkrpcache
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <cgreen/cgreen.h>
+#include <cgreen/mocks.h>
+
+#include <vulkan/vulkan_core.h>
+#include "vkrpcache.h"
+
+/** Handle of the last render pass created by vkCreateRenderPass */
+static uintptr_t last_rpass;
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkCreateRenderPass(VkDevice device, const VkRenderPassCreateInfo *pCreateInfo,
+		   const VkAllocationCallbacks *pAllocator,
+		   VkRenderPass *pRenderPass)
+{
+	*pRenderPass = (VkRenderPass)++last_rpass;
+	return (VkResult)mock(device, pCreateInfo, pAllocator, pRenderPass);
+}
+
+VKAPI_ATTR void VKAPI_CALL
+vkDestroyRenderPass(VkDevice device, VkRenderPass renderPass,
+		    const VkAllocationCallbacks *pAllocator)
+{
+	mock(device, renderPass, pAllocator);
+}
+
+/**
+ * Returns configuration with single cleared color attachment
+ * @param format Specifies format of the attachment
+ * @returns render pass configuration
+ */
+static struct vkrpcache_key color_key(VkFormat format)
+{
+	struct vkrpcache_key key = {
+		.ncolors = 1,
+		.colors = { {
+			.format = format,
+			.samples = VK_SAMPLE_COUNT_1_BIT,
+			.load = VK_ATTACHMENT_LOAD_OP_CLEAR,
+			.store = VK_ATTACHMENT_STORE_OP_STORE,
+			.initial = VK_IMAGE_LAYOUT_UNDEFINED,
+			.final = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+		} },
+	};
+	return key;
+}
+
+Ensure(get_creates_render_pass_on_miss)
+{
+	struct vkrpcache cache;
+	struct vkrpcache_key key = color_key(VK_FORMAT_B8G8R8A8_UNORM);
+	VkRenderPass rpass = VK_NULL_HANDLE;
+	const VkAllocationCallbacks host = { 0 };
+	vkrpcache_init(&cache, &host);
+	expect(vkCreateRenderPass, will_return(VK_SUCCESS),
+	       when(pAllocator, is_equal_to(&host)));
+	VkResult result = vkrpcache_get(&cache, VK_NULL_HANDLE, &key, &rpass);
+	assert_that(result, is_equal_to(VK_SUCCESS));
+	assert_that(rpass, is_not_equal_to(VK_NULL_HANDLE));
+	assert_that(cache.nmisses, is_equal_to(1));
+	assert_that(cache.nhits, is_equal_to(0));
+	expect(vkDestroyRenderPass, when(renderPass, is_equal_to(rpass)),
+	       when(pAllocator, is_equal_to(&host)));
+	vkrpcache_destroy(&cache, VK_NULL_HANDLE);
+}
+
+Ensure(get_returns_cached_render_pass_on_hit)
+{
+	struct vkrpcache cache;
+	struct vkrpcache_key key = color_key(VK_FORMAT_B8G8R8A8_UNORM);
+	VkRenderPass created, cached;
+	vkrpcache_init(&cache, NULL);
+	expect(vkCreateRenderPass, will_return(VK_SUCCESS));
+	vkrpcache_get(&cache, VK_NULL_HANDLE, &key, &created);
+	/* Unused color attachments are not part of configuration */
+	key.colors[1].format = VK_FORMAT_R8_UNORM;
+	VkResult result = vkrpcache_get(&cache, VK_NULL_HANDLE, &key, &cached);
+	assert_that(result, is_equal_to(VK_SUCCESS));
+	assert_that(cached, is_equal_to(created));
+	assert_that(cache.nhits, is_equal_to(1));
+	assert_that(cache.count, is_equal_to(1));
+	always_expect(vkDestroyRenderPass);
+	vkrpcache_destroy(&cache, VK_NULL_HANDLE);
+}
+
+Ensure(get_creates_render_pass_per_configuration)
+{
+	struct vkrpcache cache;
+	struct vkrpcache_key color = color_key(VK_FORMAT_B8G8R8A8_UNORM);
+	struct vkrpcache_key depth = color;
+	depth.depth = color.colors[0];
+	depth.depth.format = VK_FORMAT_D32_SFLOAT;
+	depth.depth.final = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+	VkRenderPass a, b;
+	vkrpcache_init(&cache, NULL);
+	expect(vkCreateRenderPass, will_return(VK_SUCCESS));
+	expect(vkCreateRenderPass, will_return(VK_SUCCESS));
+	vkrpcache_get(&cache, VK_NULL_HANDLE, &color, &a);
+	vkrpcache_get(&cache, VK_NULL_HANDLE, &depth, &b);
+	assert_that(a, is_not_equal_to(b));
+	assert_that(cache.nmisses, is_equal_to(2));
+	always_expect(vkDestroyRenderPass);
+	vkrpcache_destroy(&cache, VK_NULL_HANDLE);
+}
+
+Ensure(get_keeps_render_passes_when_table_grows)
+{
+	struct vkrpcache cache;
+	VkRenderPass rpasses[40];
+	vkrpcache_init(&cache, NULL);
+	for (int i = 0; i < 40; ++i) {
+		struct vkrpcache_key key = color_key((VkFormat)(i + 1));
+		expect(vkCreateRenderPass, will_return(VK_SUCCESS));
+		vkrpcache_get(&cache, VK_NULL_HANDLE, &key, &rpasses[i]);
+	}
+	for (int i = 0; i < 40; ++i) {
+		struct vkrpcache_key key = color_key((VkFormat)(i + 1));
+		VkRenderPass rpass;
+		vkrpcache_get(&cache, VK_NULL_HANDLE, &key, &rpass);
+		assert_that(rpass, is_equal_to(rpasses[i]));
+	}
+	assert_that(cache.count, is_equal_to(40));
+	assert_that(cache.nhits, is_equal_to(40));
+	assert_that(cache.capacity, is_greater_than(80));
+	for (int i = 0; i < 40; ++i) {
+		expect(vkDestroyRenderPass);
+	}
+	vkrpcache_destroy(&cache, VK_NULL_HANDLE);
+}
+
+Ensure(get_returns_error_on_render_pass_fail)
+{
+	struct vkrpcache cache;
+	struct vkrpcache_key key = color_key(VK_FORMAT_B8G8R8A8_UNORM);
+	VkRenderPass rpass;
+	vkrpcache_init(&cache, NULL);
+	expect(vkCreateRenderPass, will_return(VK_ERROR_OUT_OF_HOST_MEMORY));
+	VkResult result = vkrpcache_get(&cache, VK_NULL_HANDLE, &key, &rpass);
+	assert_that(result, is_equal_to(VK_ERROR_OUT_OF_HOST_MEMORY));
+	assert_that(cache.count, is_equal_to(0));
+	never_expect(vkDestroyRenderPass);
+	vkrpcache_destroy(&cache, VK_NULL_HANDLE);
+}
+
+int main(int argc, char **argv)
+{
+	(void)(argc);
+	(void)(argv);
+	TestSuite *suite = create_named_test_suite("VKRPCache");
+	add_test(suite, get_creates_render_pass_on_miss);
+	add_test(suite, get_returns_cached_render_pass_on_hit);
+	add_test(suite, get_creates_render_pass_per_configuration);
+	add_test(suite, get_keeps_render_passes_when_table_grows);
+	add_test(suite, get_returns_error_on_render_pass_fail);
+	TestReporter *reporter = create_text_reporter();
+	int exit_code = run_test_suite(suite, reporter);
+	destroy_reporter(reporter);
+	destroy_test_suite(suite);
+	return exit_code;
+}
@@ -0,0 +1,249 @@
+/**
+ * @file
+ * Uploads going through staging ring implementation
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdint.h>
+#include <string.h>
+
+#include "vkmemory.h"
+#include "vkstaging.h"
+#include "vktransfer.h"
+#include <vulkan/vulkan_core.h>
+
+/**
+ * Creates host visible staging buffer
+ * @param stage Specifies staging to create buffer of
+ * @param mem Specifies allocator of buffer memory
+ * @returns VK_SUCCESS on success, or VkResult error otherwise
+ */
+static VkResult vkstaging_create_buffer(struct vkstaging *stage,
+					struct vkmemory *mem)
+{
+	const VkBufferCreateInfo info = {
+		.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+		.pNext = NULL,
+		.flags = 0,
+		.size = stage->size,
+		.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+		.queueFamilyIndexCount = 0,
+		.pQueueFamilyIndices = NULL,
+	};
+	VkResult result = vkCreateBuffer(mem->dev, &info, mem->host,
+					 &stage->buffer);
+	if (result != VK_SUCCESS)
+		return result;
+	/* Ring is only written sequentially, so cached memory gains nothing */
+	result = vkmemory_alloc_buffer(mem, stage->buffer,
+				       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+				       VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				       0, &stage->alloc);
+	if (result != VK_SUCCESS) {
+		vkDestroyBuffer(mem->dev, stage->buffer, mem->host);
+		stage->buffer = VK_NULL_HANDLE;
+		return result;
+	}
+	stage->data = stage->alloc.mapped;
+	return VK_SUCCESS;
+}
+
+VkResult vkstaging_init(struct vkstaging *stage, struct vktransfer *xfer,
+			struct vkmemory *mem, VkDeviceSize size,
+			VkDeviceSize budget)
+{
+	stage->xfer = xfer;
+	stage->buffer = VK_NULL_HANDLE;
+	stage->data = NULL;
+	stage->size = size;
+	stage->budget = (budget == 0 || budget > size) ? size : budget;
+	stage->head = 0;
+	stage->tail = 0;
+	stage->used = 0;
+	stage->first = 0;
+	stage->count = 0;
+	stage->region = 0;
+	stage->nregions = 0;
+	stage->queued = 0;
+	stage->staged = 0;
+	stage->nbytes = 0;
+	stage->nstalls = 0;
+	stage->nbatches = 0;
+	return vkstaging_create_buffer(stage, mem);
+}
+
+VkResult vkstaging_upload(struct vkstaging *stage, VkBuffer dst,
+			  VkDeviceSize offset, const void *src,
+			  VkDeviceSize size, uint64_t *id)
+{
+	if (stage->count == VKSTAGING_MAX_UPLOADS)
+		return VK_NOT_READY;
+	const uint32_t last =
+		(stage->first + stage->count) % VKSTAGING_MAX_UPLOADS;
+	struct vkstaging_upload *upload = &stage->uploads[last];
+	upload->dst = dst;
+	upload->offset = offset;
+	upload->src = src;
+	upload->size = size;
+	upload->staged = 0;
+	stage->count++;
+	*id = ++stage->queued;
+	return VK_SUCCESS;
+}
+
+/**
+ * Removes the oldest upload from queue once it is staged
+ * @param stage Specifies staging to remove upload of
+ */
+static void vkstaging_pop(struct vkstaging *stage)
+{
+	stage->first = (stage->first + 1) % VKSTAGING_MAX_UPLOADS;
+	stage->count--;
+	stage->staged++;
+}
+
+/**
+ * Reserves contiguous range of ring
+ * @param stage Specifies staging to reserve range of
+ * @param size Specifies the desired size of range
+ * @param taken Specifies number of bytes taken by flush, including padding
+ * @param offset Specifies pointer where offset of range must be stored
+ * @returns size of range, at most @a size, or zero if ring is full
+ */
+static VkDeviceSize vkstaging_reserve(struct vkstaging *stage,
+				      VkDeviceSize size, VkDeviceSize *taken,
+				      VkDeviceSize *offset)
+{
+	if (stage->used == 0) {
+		stage->head = 0;
+		stage->tail = 0;
+	}
+	VkDeviceSize start = (stage->head + VKSTAGING_ALIGNMENT - 1) /
+			     VKSTAGING_ALIGNMENT * VKSTAGING_ALIGNMENT;
+	VkDeviceSize padding = start - stage->head;
+	VkDeviceSize avail;
+	if (stage->head > stage->tail || stage->used == 0) {
+		if (start >= stage->size) {
+			/* Wrap to the beginning, the end is left unused */
+			if (stage->tail == 0)
+				return 0;
+			padding = stage->size - stage->head;
+			start = 0;
+			avail = stage->tail;
+		} else {
+			avail = stage->size - start;
+		}
+	} else {
+		if (start >= stage->tail)
+			return 0;
+		avail = stage->tail - start;
+	}
+	const VkDeviceSize n = (size < avail) ? size : avail;
+	stage->head = start + n;
+	stage->used += padding + n;
+	*taken += padding + n;
+	*offset = start;
+	return n;
+}
+
+/**
+ * Reclaims ring data read by retired transfer batches
+ * @param stage Specifies staging to reclaim data of
+ */
+static void vkstaging_collect(struct vkstaging *stage)
+{
+	while (stage->nregions > 0) {
+		const struct vkstaging_region *region =
+			&stage->regions[stage->region];
+		if (region->ticket > stage->xfer->retired)
+			break;
+		stage->tail = region->end;
+		stage->used -= region->nbytes;
+		stage->region = (stage->region + 1) % VKSTAGING_MAX_REGIONS;
+		stage->nregions--;
+	}
+}
+
+/**
+ * Assigns ring data taken by flush to transfer batch
+ * @param stage Specifies staging the data is taken from
+ * @param ticket Specifies ticket of transfer batch
+ * @param taken Specifies number of bytes taken, including padding
+ */
+static void vkstaging_retain(struct vkstaging *stage, uint64_t ticket,
+			     VkDeviceSize taken)
+{
+	struct vkstaging_region *region;
+	if (stage->nregions < VKSTAGING_MAX_REGIONS) {
+		const uint32_t last = (stage->region + stage->nregions) %
+				      VKSTAGING_MAX_REGIONS;
+		region = &stage->regions[last];
+		region->nbytes = 0;
+		stage->nregions++;
+	} else {
+		/* Later batch retires after earlier ones, so they merge */
+		const uint32_t last = (stage->region + stage->nregions - 1) %
+				      VKSTAGING_MAX_REGIONS;
+		region = &stage->regions[last];
+	}
+	region->ticket = ticket;
+	region->end = stage->head;
+	region->nbytes += taken;
+}
+
+VkResult vkstaging_flush(struct vkstaging *stage, uint64_t *ticket)
+{
+	vkstaging_collect(stage);
+	*ticket = stage->xfer->submitted;
+	VkDeviceSize remaining = stage->budget;
+	VkDeviceSize taken = 0;
+	VkResult result = VK_SUCCESS;
+	while (stage->count > 0 && remaining > 0) {
+		struct vkstaging_upload *upload = &stage->uploads[stage->first];
+		VkDeviceSize size = upload->size - upload->staged;
+		if (size == 0) {
+			vkstaging_pop(stage);
+			continue;
+		}
+		if (size > remaining)
+			size = remaining;
+		VkDeviceSize offset;
+		size = vkstaging_reserve(stage, size, &taken, &offset);
+		if (size == 0) {
+			stage->nstalls++;
+			break;
+		}
+		memcpy(stage->data + offset, upload->src + upload->staged,
+		       (size_t)size);
+		const VkBufferCopy region = {
+			.srcOffset = offset,
+			.dstOffset = upload->offset + upload->staged,
+			.size = size,
+		};
+		result = vktransfer_copy_buffer(stage->xfer, stage->buffer,
+						upload->dst, &region);
+		if (result != VK_SUCCESS)
+			break;
+		upload->staged += size;
+		remaining -= size;
+		stage->nbytes += size;
+		if (upload->staged == upload->size)
+			vkstaging_pop(stage);
+	}
+	if (taken == 0)
+		return result;
+	/* Copies recorded before failure still read ring */
+	VkResult submitted = vktransfer_submit(stage->xfer, ticket);
+	vkstaging_retain(stage, *ticket, taken);
+	stage->nbatches++;
+	return (result != VK_SUCCESS) ? result : submitted;
+}
+
+void vkstaging_destroy(struct vkstaging *stage, struct vkmemory *mem)
+{
+	vkDestroyBuffer(mem->dev, stage->buffer, mem->host);
+	vkmemory_free(mem, &stage->alloc);
+}
@@ -0,0 +1,156 @@
+#ifndef RENDERER_VKSTAGING_H
+#define RENDERER_VKSTAGING_H
+
+#include <stdint.h>
+
+#include <renderer/vkmemory.h>
+#include <renderer/vktransfer.h>
+#include <vulkan/vulkan_core.h>
+
+/** Maximum number of uploads waiting for staging at once */
+#define VKSTAGING_MAX_UPLOADS 64
+
+/** Maximum number of flushes having data in ring at once */
+#define VKSTAGING_MAX_REGIONS 8
+
+/** Alignment of data written into ring */
+#define VKSTAGING_ALIGNMENT 16
+
+/** Upload waiting to be staged */
+struct vkstaging_upload {
+	/** Destination buffer */
+	VkBuffer dst;
+	/** Offset of data in @a dst */
+	VkDeviceSize offset;
+	/** Source data, kept by caller until upload is staged */
+	const char *src;
+	/** Size of data */
+	VkDeviceSize size;
+	/** Number of bytes already staged */
+	VkDeviceSize staged;
+};
+
+/** Ring data copied by one flush */
+struct vkstaging_region {
+	/** Ticket of transfer batch reading data */
+	uint64_t ticket;
+	/** Offset following the last byte of data */
+	VkDeviceSize end;
+	/** Number of bytes of ring taken, including padding */
+	VkDeviceSize nbytes;
+};
+
+/**
+ * Uploads going through staging ring
+ *
+ * Ring is host visible and persistently mapped. Every frame up to @a budget
+ * bytes of queued uploads are written into ring and copied by one transfer
+ * batch, so large uploads are spread over several frames. Ring data is
+ * reclaimed once transfer batch copying it retires. Staging is not
+ * thread-safe.
+ */
+struct vkstaging {
+	/** Uploads the copies are recorded to */
+	struct vktransfer *xfer;
+	/** Staging buffer */
+	VkBuffer buffer;
+	/** Memory of @a buffer */
+	struct vkmemory_alloc alloc;
+	/** Host address of @a buffer */
+	char *data;
+	/** Size of ring */
+	VkDeviceSize size;
+	/** Maximum number of bytes staged per flush */
+	VkDeviceSize budget;
+	/** Offset the next data is written at */
+	VkDeviceSize head;
+	/** Offset of the oldest data in use */
+	VkDeviceSize tail;
+	/** Number of bytes of ring in use, including padding */
+	VkDeviceSize used;
+	/** Uploads waiting for staging, oldest first */
+	struct vkstaging_upload uploads[VKSTAGING_MAX_UPLOADS];
+	/** Index of the oldest upload */
+	uint32_t first;
+	/** Number of uploads */
+	uint32_t count;
+	/** Data of flushes being copied, oldest first */
+	struct vkstaging_region regions[VKSTAGING_MAX_REGIONS];
+	/** Index of the oldest region */
+	uint32_t region;
+	/** Number of regions */
+	uint32_t nregions;
+	/** Number of uploads queued so far */
+	uint64_t queued;
+	/** Number of uploads completely staged so far */
+	uint64_t staged;
+	/** Total number of bytes uploaded */
+	uint64_t nbytes;
+	/** Number of flushes stopped because ring was full */
+	uint64_t nstalls;
+	/** Number of transfer batches submitted */
+	uint64_t nbatches;
+};
+
+#ifdef __cplusplus
+/* *INDENT-OFF* */
+extern "C" {
+/* *INDENT-ON* */
+#endif
+
+/**
+ * Initializes staging
+ * @param stage Specifies staging to initialize
+ * @param xfer Specifies uploads to record copies to
+ * @param mem Specifies allocator of ring memory
+ * @param size Specifies size of ring
+ * @param budget Specifies maximum number of bytes staged per flush, zero
+ *        or value larger than @a size selects @a size
+ * @returns VK_SUCCESS on success, or VkResult error otherwise
+ */
+VkResult vkstaging_init(struct vkstaging *stage, struct vktransfer *xfer,
+			struct vkmemory *mem, VkDeviceSize size,
+			VkDeviceSize budget);
+
+/**
+ * Queues upload of data into buffer
+ *
+ * Data is read while staged, so it must be kept until @a staged of staging
+ * reaches the returned number.
+ * @param stage Specifies staging to queue upload to
+ * @param dst Specifies destination buffer
+ * @param offset Specifies offset of data in @a dst
+ * @param src Specifies source data
+ * @param size Specifies size of data
+ * @param id Specifies pointer where number of upload must be stored
+ * @returns VK_SUCCESS on success, VK_NOT_READY if too many uploads are
+ *          queued, or VkResult error otherwise
+ */
+VkResult vkstaging_upload(struct vkstaging *stage, VkBuffer dst,
+			  VkDeviceSize offset, const void *src,
+			  VkDeviceSize size, uint64_t *id);
+
+/**
+ * Reclaims retired ring data and stages queued uploads within budget
+ *
+ * Destinations are visible to graphics submissions once @a completed of
+ * uploads reaches the returned ticket.
+ * @param stage Specifies staging to flush
+ * @param ticket Specifies pointer where ticket of copies must be stored
+ * @returns VK_SUCCESS on success, or VkResult error otherwise
+ */
+VkResult vkstaging_flush(struct vkstaging *stage, uint64_t *ticket);
+
+/**
+ * Destroys staging, its copies must be retired
+ * @param stage Specifies staging to destroy
+ * @param mem Specifies allocator of ring memory
+ */
+void vkstaging_destroy(struct vkstaging *stage, struct vkmemory *mem);
+
+#ifdef __cplusplus
+/* *INDENT-OFF* */
+}
+/* *INDENT-ON* */
+#endif
+#endif
@@ -0,0 +1,393 @@
+/**
+ * @file
+ * Test suite for vkstaging
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdint.h>
+#include <string.h>
+
+#include <cgreen/cgreen.h>
+#include <cgreen/mocks.h>
+
+#include <vulkan/vulkan_core.h>
+#include "vkmemory.h"
+#include "vkstaging.h"
+#include "vktransfer.h"
+
+/** Destination buffer of uploads */
+#define DST_BUFFER ((VkBuffer)(uintptr_t)0x42)
+
+/** Maximum number of copies recorded by fake uploads */
+#define MAX_COPIES 32
+
+/** Host memory the staging buffer is mapped to */
+static char mapped_memory[4096];
+
+/** Usage of the last created buffer */
+static VkBufferUsageFlags buffer_usage;
+
+/** Copies recorded since staging was initialized */
+static VkBufferCopy copies[MAX_COPIES];
+
+/** Number of copies recorded */
+static uint32_t ncopies;
+
+/** Number of batches submitted */
+static uint32_t nsubmits;
+
+/** Number of copies recorded before fake copy fails */
+static uint32_t failing_copy;
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateBuffer(
+	VkDevice device, const VkBufferCreateInfo *pCreateInfo,
+	const VkAllocationCallbacks *pAllocator, VkBuffer *pBuffer)
+{
+	buffer_usage = pCreateInfo->usage;
+	return (VkResult)mock(device, pCreateInfo, pAllocator, pBuffer);
+}
+
+VKAPI_ATTR void VKAPI_CALL
+vkDestroyBuffer(VkDevice device, VkBuffer buffer,
+		const VkAllocationCallbacks *pAllocator)
+{
+	mock(device, buffer, pAllocator);
+}
+
+VkResult vkmemory_alloc_buffer(struct vkmemory *mem, VkBuffer buffer,
+			       VkMemoryPropertyFlags required,
+			       VkMemoryPropertyFlags preferred,
+			       struct vkmemory_alloc *alloc)
+{
+	alloc->mapped = mapped_memory;
+	return (VkResult)mock(mem, buffer, required, preferred, alloc);
+}
+
+void vkmemory_free(struct vkmemory *mem, const struct vkmemory_alloc *alloc)
+{
+	mock(mem, alloc);
+}
+
+VkResult vktransfer_copy_buffer(struct vktransfer *xfer, VkBuffer src,
+				VkBuffer dst, const VkBufferCopy *region)
+{
+	(void)(xfer);
+	(void)(src);
+	(void)(dst);
+	if (ncopies == failing_copy)
+		return VK_ERROR_DEVICE_LOST;
+	copies[ncopies++] = *region;
+	return VK_SUCCESS;
+}
+
+VkResult vktransfer_submit(struct vktransfer *xfer, uint64_t *ticket)
+{
+	nsubmits++;
+	*ticket = ++xfer->submitted;
+	return VK_SUCCESS;
+}
+
+/**
+ * Initializes staging expecting buffer to be created
+ * @param stage Specifies staging to initialize
+ * @param xfer Specifies uploads to record copies to
+ * @param size Specifies size of ring
+ * @param budget Specifies maximum number of bytes staged per flush
+ */
+static void init_staging(struct vkstaging *stage, struct vktransfer *xfer,
+			 VkDeviceSize size, VkDeviceSize budget)
+{
+	struct vkmemory mem = { .dev = VK_NULL_HANDLE };
+	xfer->submitted = 0;
+	xfer->completed = 0;
+	xfer->retired = 0;
+	ncopies = 0;
+	nsubmits = 0;
+	failing_copy = MAX_COPIES;
+	expect(vkCreateBuffer, will_return(VK_SUCCESS));
+	expect(vkmemory_alloc_buffer, will_return(VK_SUCCESS));
+	vkstaging_init(stage, xfer, &mem, size, budget);
+}
+
+/**
+ * Queues upload into destination buffer
+ * @param stage Specifies staging to queue upload to
+ * @param src Specifies source data
+ * @param size Specifies size of data
+ * @returns number of upload
+ */
+static uint64_t upload(struct vkstaging *stage, const void *src,
+		       VkDeviceSize size)
+{
+	uint64_t id = 0;
+	vkstaging_upload(stage, DST_BUFFER, 0, src, size, &id);
+	return id;
+}
+
+Ensure(init_maps_coherent_transfer_source)
+{
+	struct vkstaging stage;
+	struct vktransfer xfer;
+	struct vkmemory mem = { .dev = VK_NULL_HANDLE };
+	const VkMemoryPropertyFlags required =
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+		VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	expect(vkCreateBuffer, will_return(VK_SUCCESS));
+	expect(vkmemory_alloc_buffer, when(required, is_equal_to(required)),
+	       will_return(VK_SUCCESS));
+	VkResult result = vkstaging_init(&stage, &xfer, &mem, 4096, 1024);
+	assert_that(result, is_equal_to(VK_SUCCESS));
+	assert_that(buffer_usage,
+		    is_equal_to(VK_BUFFER_USAGE_TRANSFER_SRC_BIT));
+	assert_that(stage.data, is_equal_to(mapped_memory));
+	assert_that(stage.budget, is_equal_to(1024));
+}
+
+Ensure(init_limits_budget_to_ring_size)
+{
+	struct vkstaging stage;
+	struct vktransfer xfer;
+	init_staging(&stage, &xfer, 4096, 0);
+	assert_that(stage.budget, is_equal_to(4096));
+	init_staging(&stage, &xfer, 4096, 8192);
+	assert_that(stage.budget, is_equal_to(4096));
+}
+
+Ensure(init_destroys_buffer_if_memory_fails)
+{
+	struct vkstaging stage;
+	struct vktransfer xfer;
+	struct vkmemory mem = { .dev = VK_NULL_HANDLE };
+	expect(vkCreateBuffer, will_return(VK_SUCCESS));
+	expect(vkmemory_alloc_buffer,
+	       will_return(VK_ERROR_OUT_OF_DEVICE_MEMORY));
+	expect(vkDestroyBuffer);
+	VkResult result = vkstaging_init(&stage, &xfer, &mem, 4096, 1024);
+	assert_that(result, is_equal_to(VK_ERROR_OUT_OF_DEVICE_MEMORY));
+}
+
+Ensure(upload_fails_if_queue_is_full)
+{
+	struct vkstaging stage;
+	struct vktransfer xfer;
+	uint64_t id;
+	init_staging(&stage, &xfer, 4096, 1024);
+	for (int i = 0; i < VKSTAGING_MAX_UPLOADS; ++i)
+		upload(&stage, mapped_memory, 16);
+	VkResult result = vkstaging_upload(&stage, DST_BUFFER, 0,
+					   mapped_memory, 16, &id);
+	assert_that(result, is_equal_to(VK_NOT_READY));
+}
+
+Ensure(flush_copies_uploads_in_one_batch)
+{
+	struct vkstaging stage;
+	struct vktransfer xfer;
+	static const char first[] = "first";
+	static const char second[] = "second";
+	uint64_t ticket;
+	init_staging(&stage, &xfer, 4096, 1024);
+	upload(&stage, first, sizeof(first));
+	const uint64_t id = upload(&stage, second, sizeof(second));
+	VkResult result = vkstaging_flush(&stage, &ticket);
+	assert_that(result, is_equal_to(VK_SUCCESS));
+	assert_that(ncopies, is_equal_to(2));
+	assert_that(nsubmits, is_equal_to(1));
+	assert_that(ticket, is_equal_to(1));
+	assert_that(stage.staged, is_equal_to(id));
+	assert_that(copies[1].srcOffset, is_equal_to(VKSTAGING_ALIGNMENT));
+	assert_that(mapped_memory + copies[1].srcOffset,
+		    is_equal_to_string(second));
+	assert_that(stage.nbytes, is_equal_to(sizeof(first) + sizeof(second)));
+	assert_that(stage.nbatches, is_equal_to(1));
+}
+
+Ensure(flush_without_uploads_submits_nothing)
+{
+	struct vkstaging stage;
+	struct vktransfer xfer;
+	uint64_t ticket;
+	init_staging(&stage, &xfer, 4096, 1024);
+	VkResult result = vkstaging_flush(&stage, &ticket);
+	assert_that(result, is_equal_to(VK_SUCCESS));
+	assert_that(nsubmits, is_equal_to(0));
+	assert_that(stage.nbatches, is_equal_to(0));
+}
+
+Ensure(flush_spreads_upload_over_budget)
+{
+	struct vkstaging stage;
+	struct vktransfer xfer;
+	uint64_t ticket;
+	init_staging(&stage, &xfer, 4096, 1024);
+	const uint64_t id = upload(&stage, mapped_memory, 2500);
+	vkstaging_flush(&stage, &ticket);
+	assert_that(copies[0].size, is_equal_to(1024));
+	assert_that(stage.staged, is_equal_to(0));
+	vkstaging_flush(&stage, &ticket);
+	assert_that(copies[1].size, is_equal_to(1024));
+	assert_that(copies[1].dstOffset, is_equal_to(1024));
+	vkstaging_flush(&stage, &ticket);
+	assert_that(copies[2].size, is_equal_to(452));
+	assert_that(copies[2].dstOffset, is_equal_to(2048));
+	assert_that(stage.staged, is_equal_to(id));
+	assert_that(nsubmits, is_equal_to(3));
+}
+
+Ensure(flush_stalls_if_ring_is_full)
+{
+	struct vkstaging stage;
+	struct vktransfer xfer;
+	uint64_t ticket;
+	init_staging(&stage, &xfer, 1024, 1024);
+	upload(&stage, mapped_memory, 1024);
+	upload(&stage, mapped_memory, 16);
+	vkstaging_flush(&stage, &ticket);
+	vkstaging_flush(&stage, &ticket);
+	assert_that(stage.nstalls, is_equal_to(1));
+	assert_that(ncopies, is_equal_to(1));
+	assert_that(nsubmits, is_equal_to(1));
+}
+
+Ensure(flush_reuses_data_of_retired_batches)
+{
+	struct vkstaging stage;
+	struct vktransfer xfer;
+	uint64_t ticket;
+	init_staging(&stage, &xfer, 1024, 1024);
+	upload(&stage, mapped_memory, 1024);
+	vkstaging_flush(&stage, &ticket);
+	xfer.retired = ticket;
+	upload(&stage, mapped_memory, 16);
+	vkstaging_flush(&stage, &ticket);
+	assert_that(stage.nstalls, is_equal_to(0));
+	assert_that(copies[1].srcOffset, is_equal_to(0));
+	assert_that(stage.used, is_equal_to(16));
+}
+
+Ensure(flush_keeps_data_until_copies_retire)
+{
+	struct vkstaging stage;
+	struct vktransfer xfer;
+	uint64_t ticket;
+	init_staging(&stage, &xfer, 1024, 1024);
+	upload(&stage, mapped_memory, 1024);
+	vkstaging_flush(&stage, &ticket);
+	/* Destination visible to graphics does not release the source */
+	xfer.completed = ticket;
+	upload(&stage, mapped_memory, 16);
+	vkstaging_flush(&stage, &ticket);
+	assert_that(stage.nstalls, is_equal_to(1));
+	assert_that(stage.nregions, is_equal_to(1));
+}
+
+Ensure(flush_splits_upload_at_end_of_ring)
+{
+	struct vkstaging stage;
+	struct vktransfer xfer;
+	uint64_t ticket;
+	init_staging(&stage, &xfer, 1024, 1024);
+	upload(&stage, mapped_memory, 256);
+	vkstaging_flush(&stage, &ticket);
+	upload(&stage, mapped_memory, 512);
+	vkstaging_flush(&stage, &ticket);
+	xfer.retired = 1;
+	upload(&stage, mapped_memory, 384);
+	vkstaging_flush(&stage, &ticket);
+	assert_that(ncopies, is_equal_to(4));
+	assert_that(copies[2].srcOffset, is_equal_to(768));
+	assert_that(copies[2].size, is_equal_to(256));
+	assert_that(copies[3].srcOffset, is_equal_to(0));
+	assert_that(copies[3].size, is_equal_to(128));
+	assert_that(copies[3].dstOffset, is_equal_to(256));
+}
+
+Ensure(flush_submits_copies_recorded_before_failure)
+{
+	struct vkstaging stage;
+	struct vktransfer xfer;
+	uint64_t ticket;
+	init_staging(&stage, &xfer, 4096, 1024);
+	upload(&stage, mapped_memory, 16);
+	upload(&stage, mapped_memory, 16);
+	failing_copy = 1;
+	VkResult result = vkstaging_flush(&stage, &ticket);
+	assert_that(result, is_equal_to(VK_ERROR_DEVICE_LOST));
+	assert_that(nsubmits, is_equal_to(1));
+	assert_that(stage.nregions, is_equal_to(1));
+	assert_that(stage.staged, is_equal_to(1));
+}
+
+Ensure(flush_releases_empty_uploads)
+{
+	struct vkstaging stage;
+	struct vktransfer xfer;
+	uint64_t ticket;
+	init_staging(&stage, &xfer, 4096, 1024);
+	upload(&stage, mapped_memory, 16);
+	const uint64_t id = upload(&stage, mapped_memory, 0);
+	vkstaging_flush(&stage, &ticket);
+	assert_that(stage.staged, is_equal_to(id));
+	assert_that(stage.count, is_equal_to(0));
+	assert_that(ncopies, is_equal_to(1));
+}
+
+Ensure(flush_merges_regions_if_exhausted)
+{
+	struct vkstaging stage;
+	struct vktransfer xfer;
+	uint64_t ticket;
+	init_staging(&stage, &xfer, 4096, 1024);
+	for (int i = 0; i <= VKSTAGING_MAX_REGIONS; ++i) {
+		upload(&stage, mapped_memory, 16);
+		vkstaging_flush(&stage, &ticket);
+	}
+	assert_that(stage.nregions, is_equal_to(VKSTAGING_MAX_REGIONS));
+	xfer.retired = VKSTAGING_MAX_REGIONS;
+	vkstaging_flush(&stage, &ticket);
+	assert_that(stage.nregions, is_equal_to(1));
+	xfer.retired = VKSTAGING_MAX_REGIONS + 1;
+	vkstaging_flush(&stage, &ticket);
+	assert_that(stage.nregions, is_equal_to(0));
+	assert_that(stage.used, is_equal_to(0));
+}
+
+Ensure(destroy_releases_buffer)
+{
+	struct vkstaging stage;
+	struct vktransfer xfer;
+	struct vkmemory mem = { .dev = VK_NULL_HANDLE };
+	init_staging(&stage, &xfer, 4096, 1024);
+	expect(vkDestroyBuffer);
+	expect(vkmemory_free, when(alloc, is_equal_to(&stage.alloc)));
+	vkstaging_destroy(&stage, &mem);
+}
+
+int main(int argc, char **argv)
+{
+	(void)(argc);
+	(void)(argv);
+	TestSuite *suite = create_named_test_suite("VKStaging");
+	add_test(suite, init_maps_coherent_transfer_source);
+	add_test(suite, init_limits_budget_to_ring_size);
+	add_test(suite, init_destroys_buffer_if_memory_fails);
+	add_test(suite, upload_fails_if_queue_is_full);
+	add_test(suite, flush_copies_uploads_in_one_batch);
+	add_test(suite, flush_without_uploads_submits_nothing);
+	add_test(suite, flush_spreads_upload_over_budget);
+	add_test(suite, flush_stalls_if_ring_is_full);
+	add_test(suite, flush_reuses_data_of_retired_batches);
+	add_test(suite, flush_keeps_data_until_copies_retire);
+	add_test(suite, flush_splits_upload_at_end_of_ring);
+	add_test(suite, flush_submits_copies_recorded_before_failure);
+	add_test(suite, flush_releases_empty_uploads);
+	add_test(suite, flush_merges_regions_if_exhausted);
+	add_test(suite, destroy_releases_buffer);
+	TestReporter *reporter = create_text_reporter();
+	int exit_code = run_test_suite(suite, reporter);
+	destroy_reporter(reporter);
+	destroy_test_suite(suite);
+	return exit_code;
+}
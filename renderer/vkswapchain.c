@@ -8,32 +8,17 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <stdlib.h>
 
+#include "vkclock.h"
+#include "vkcompute.h"
+#include "vkflight.h"
+#include "vkrecorder.h"
 #include "vkrenderer.h"
 #include "vkswapchain.h"
+#include "vkuniform.h"
 #include <vulkan/vulkan_core.h>
 
-/**
- * Create synchronization objects used during rendering
- * @param swc Specifies swapchain to create sync objects for
- * @param dev Specifies device to create sync objects on
- * @returns VK_SUCCESS on success, or VkResult error otherwise
- */
-static VkResult vkswapchain_create_sync_objects(struct vkswapchain *swc,
-						VkDevice dev)
-{
-	VkResult result;
-	VkSemaphoreCreateInfo info = {
-		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
-		.pNext = NULL,
-		.flags = 0,
-	};
-	result = vkCreateSemaphore(dev, &info, NULL, &swc->acquire_sem);
-	if (result != VK_SUCCESS)
-		return result;
-	return vkCreateSemaphore(dev, &info, NULL, &swc->render_sem);
-}
-
 /**
  * Create Vulkan swapchain for renderer
  * @param swapchain Specifies pointer to destination variable of swapchain
@@ -50,7 +35,7 @@ static VkResult vkswapchain_create(VkSwapchainKHR *swapchain,
 	VkSharingMode sharing_mode = (rdr->graphic == rdr->present) ?
 					     VK_SHARING_MODE_EXCLUSIVE :
 					     VK_SHARING_MODE_CONCURRENT;
-	uint32_t image_count = rdr->srf_caps.minImageCount;
+	uint32_t image_count = rdr->srf_image_count;
 	VkSwapchainCreateInfoKHR info = {
 		.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
 		.pNext = NULL,
@@ -71,7 +56,51 @@ static VkResult vkswapchain_create(VkSwapchainKHR *swapchain,
 		.clipped = VK_TRUE,
 		.oldSwapchain = old_swc,
 	};
-	return vkCreateSwapchainKHR(rdr->device, &info, NULL, swapchain);
+	return vkCreateSwapchainKHR(rdr->device, &info, &rdr->host.callbacks,
+				    swapchain);
+}
+
+/**
+ * Initializes imageless framebuffer shared by all frames of swapchain
+ * @param swc Specifies swapchain to initialize framebuffer for
+ * @param rdr Specifies renderer to get attachment parameters from
+ * @returns VK_SUCCESS on success, or VkResult error otherwise
+ */
+static VkResult vkswapchain_init_framebuffer(struct vkswapchain *swc,
+					     const struct vkrenderer *rdr)
+{
+	const VkFormat format = rdr->srf_format.format;
+	const VkExtent2D size = rdr->srf_caps.currentExtent;
+	const VkFramebufferAttachmentImageInfo image_info = {
+		.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_ATTACHMENT_IMAGE_INFO,
+		.pNext = NULL,
+		.flags = 0,
+		.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+		.width = size.width,
+		.height = size.height,
+		.layerCount = 1,
+		.viewFormatCount = 1,
+		.pViewFormats = &format,
+	};
+	const VkFramebufferAttachmentsCreateInfo attachments_info = {
+		.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_ATTACHMENTS_CREATE_INFO,
+		.pNext = NULL,
+		.attachmentImageInfoCount = 1,
+		.pAttachmentImageInfos = &image_info,
+	};
+	const VkFramebufferCreateInfo info = {
+		.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+		.pNext = &attachments_info,
+		.flags = VK_FRAMEBUFFER_CREATE_IMAGELESS_BIT,
+		.renderPass = rdr->rpass,
+		.attachmentCount = 1,
+		.pAttachments = NULL,
+		.width = size.width,
+		.height = size.height,
+		.layers = 1,
+	};
+	return vkCreateFramebuffer(rdr->device, &info, &rdr->host.callbacks,
+				   &swc->framebuffer);
 }
 
 /**
@@ -81,85 +110,292 @@ static VkResult vkswapchain_create(VkSwapchainKHR *swapchain,
  * @returns zero on success, or non-zero otherwise
  */
 static int vkswapchain_init_frames(struct vkswapchain *swc,
-				   const struct vkrenderer *rdr)
+				   struct vkrenderer *rdr)
 {
-	VkImage images[ARRAY_SIZE(swc->frames)];
-	uint32_t nimages = ARRAY_SIZE(images);
+	uint32_t nimages;
 	VkResult err = vkGetSwapchainImagesKHR(rdr->device, swc->swapchain,
-					       &nimages, images);
+					       &nimages, NULL);
 	if (err != VK_SUCCESS)
 		return -1;
-
+	VkImage *images = malloc(sizeof(VkImage) * nimages);
+	swc->frames = calloc(nimages, sizeof(struct vkframe));
+	if (images == NULL || swc->frames == NULL)
+		goto fail;
+	err = vkGetSwapchainImagesKHR(rdr->device, swc->swapchain, &nimages,
+				      images);
+	if (err != VK_SUCCESS)
+		goto fail;
 	for (swc->nframes = 0; swc->nframes < nimages; ++swc->nframes) {
 		struct vkframe *frame = &swc->frames[swc->nframes];
 		VkImage image = images[swc->nframes];
-		err = vkframe_init(frame, rdr->rpass, rdr, image);
+		err = vkframe_init(frame, swc->framebuffer, rdr, image);
 		if (err != VK_SUCCESS) {
-			return -1;
+			goto fail;
 		}
 	}
+	free(images);
 	return 0;
+fail:
+	free(images);
+	return -1;
+}
+
+/**
+ * Records frame's draw list into secondary buffers of recorder's slot
+ * @param frame Specifies frame secondary buffers render to
+ * @param rdr Specifies renderer owning recorder
+ * @param slot Specifies recorder's slot to record
+ * @param cmds Specifies array of recorded buffers, one per thread
+ * @returns VK_SUCCESS on success, or VkResult error otherwise
+ */
+static VkResult vkswapchain_record_parallel(const struct vkframe *frame,
+					    struct vkrenderer *rdr,
+					    size_t slot, VkCommandBuffer *cmds)
+{
+	const VkFormat format = rdr->srf_format.format;
+	const VkStructureType rendering_type =
+		VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO;
+	const VkCommandBufferInheritanceRenderingInfo rendering = {
+		.sType = rendering_type,
+		.pNext = NULL,
+		.flags = 0,
+		.viewMask = 0,
+		.colorAttachmentCount = 1,
+		.pColorAttachmentFormats = &format,
+		.depthAttachmentFormat = VK_FORMAT_UNDEFINED,
+		.stencilAttachmentFormat = VK_FORMAT_UNDEFINED,
+		.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
+	};
+	const int dynamic = rdr->caps & VKRENDERER_CAP_DYNAMIC_RENDERING;
+	const VkCommandBufferInheritanceInfo inheritance = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+		.pNext = dynamic ? &rendering : NULL,
+		.renderPass = rdr->rpass,
+		.subpass = 0,
+		.framebuffer = frame->buffer,
+		.occlusionQueryEnable = VK_FALSE,
+		.queryFlags = 0,
+		.pipelineStatistics = 0,
+	};
+	return vkrecorder_record(&rdr->recorder, slot, &inheritance, cmds);
 }
 
-int vkswapchain_init(struct vkswapchain *swc, const struct vkrenderer *rdr,
+/**
+ * Returns command buffer rendering acquired image
+ *
+ * Commands recorded per frame go into slot's transient buffer, and in
+ * VKRENDERER_RECORD_PARALLEL mode it executes buffers recorded by threads.
+ * Buffer recorded at swapchain init is used in VKRENDERER_RECORD_ONCE mode.
+ * @param swc Specifies swapchain the image is acquired from
+ * @param rdr Specifies renderer
+ * @param flight Specifies slot the frame is submitted from
+ * @param image_index Specifies index of acquired image
+ * @param cmds Specifies pointer to returned command buffer
+ * @returns VK_SUCCESS on success, or VkResult error otherwise
+ */
+static VkResult vkswapchain_record(const struct vkswapchain *swc,
+				   struct vkrenderer *rdr,
+				   const struct vkflight *flight,
+				   uint32_t image_index, VkCommandBuffer *cmds)
+{
+	const struct vkframe *frame = &swc->frames[image_index];
+	if (rdr->record_mode == VKRENDERER_RECORD_ONCE) {
+		*cmds = frame->cmds;
+		return VK_SUCCESS;
+	}
+	/* Slot is reused only after its previous frame completes */
+	VkResult result = vkflight_reset_commands(flight, rdr->device,
+						  &rdr->vkd);
+	if (result != VK_SUCCESS)
+		return result;
+	*cmds = flight->cmds;
+	VkCommandBuffer secondaries[VKRECORDER_MAX_WORKERS];
+	uint32_t nsecondaries = 0;
+	if (rdr->record_mode == VKRENDERER_RECORD_PARALLEL) {
+		const size_t slot = (size_t)(flight - rdr->flights);
+		result = vkswapchain_record_parallel(frame, rdr, slot,
+						     secondaries);
+		if (result != VK_SUCCESS)
+			return result;
+		nsecondaries = (uint32_t)rdr->recorder.nworkers;
+	}
+	return vkframe_record(frame, rdr, flight->cmds,
+			      VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+			      secondaries, nsecondaries);
+}
+
+/**
+ * Submits batch only waiting for acquire semaphore of frame not recorded
+ *
+ * Batch unsignals semaphore and completes as the frame, so slot is reused
+ * only after the wait. Acquired image is never presented, so swapchain is
+ * recreated before next frame to release it.
+ * @param rdr Specifies renderer
+ * @param flight Specifies slot the image is acquired with
+ * @param frame Specifies number of skipped frame
+ * @returns VK_SUCCESS on success, or VkResult error otherwise
+ */
+static VkResult vkswapchain_skip(struct vkrenderer *rdr,
+				 struct vkflight *flight, uint64_t frame)
+{
+	const int timeline = rdr->caps & VKRENDERER_CAP_TIMELINE_SEMAPHORE;
+	const struct vkdispatch *vkd = &rdr->vkd;
+	rdr->swc_outdated = 1;
+	if (!timeline) {
+		VkResult result = vkd->vkResetFences(rdr->device, 1,
+						     &flight->fence);
+		if (result != VK_SUCCESS)
+			return result;
+	}
+	const VkPipelineStageFlags wait_stage =
+		VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+	VkTimelineSemaphoreSubmitInfo timeline_info = {
+		.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+		.pNext = NULL,
+		.waitSemaphoreValueCount = 0,
+		.pWaitSemaphoreValues = NULL,
+		.signalSemaphoreValueCount = 1,
+		.pSignalSemaphoreValues = &frame,
+	};
+	VkSubmitInfo submit_info = {
+		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+		.pNext = timeline ? &timeline_info : NULL,
+		.waitSemaphoreCount = 1,
+		.pWaitSemaphores = &flight->acquire_sem,
+		.pWaitDstStageMask = &wait_stage,
+		.commandBufferCount = 0,
+		.pCommandBuffers = NULL,
+		.signalSemaphoreCount = timeline ? 1 : 0,
+		.pSignalSemaphores = &rdr->timeline,
+	};
+	VkResult result =
+		vkd->vkQueueSubmit(rdr->graphics_queue, 1, &submit_info,
+				   timeline ? VK_NULL_HANDLE : flight->fence);
+	if (result != VK_SUCCESS)
+		return result;
+	rdr->frame = frame;
+	flight->frame = frame;
+	return VK_SUCCESS;
+}
+
+int vkswapchain_init(struct vkswapchain *swc, struct vkrenderer *rdr,
 		     const VkSwapchainKHR old_swc)
 {
+	swc->frames = NULL;
+	swc->nframes = 0;
+	swc->retired_frame = 0;
+	swc->framebuffer = VK_NULL_HANDLE;
 	if (vkswapchain_create(&swc->swapchain, rdr, old_swc) != VK_SUCCESS) {
 		return -1;
 	}
-	const VkDevice dev = rdr->device;
-	if (vkswapchain_create_sync_objects(swc, dev) != VK_SUCCESS) {
+	if ((rdr->caps & VKRENDERER_CAP_IMAGELESS_FRAMEBUFFER) &&
+	    vkswapchain_init_framebuffer(swc, rdr) != VK_SUCCESS) {
 		return -1;
 	}
 	return vkswapchain_init_frames(swc, rdr) != VK_SUCCESS;
 }
 
 VkResult vkswapchain_render(const struct vkswapchain *swc,
-			    const struct vkrenderer *rdr)
+			    struct vkrenderer *rdr, struct vkflight *flight)
 {
+	const int timeline = rdr->caps & VKRENDERER_CAP_TIMELINE_SEMAPHORE;
+	const uint64_t frame = rdr->frame + 1;
 	uint32_t image_index;
-	VkResult result = vkAcquireNextImageKHR(rdr->device, swc->swapchain,
-						UINT64_MAX, swc->acquire_sem,
-						VK_NULL_HANDLE, &image_index);
-	if (result != VK_SUCCESS)
+	const uint64_t acquire_start = vkclock_ns();
+	const struct vkdispatch *vkd = &rdr->vkd;
+	VkResult result = vkd->vkAcquireNextImageKHR(
+		rdr->device, swc->swapchain, UINT64_MAX, flight->acquire_sem,
+		VK_NULL_HANDLE, &image_index);
+	if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
 		return result;
-	const VkPipelineStageFlags wait_stages[] = {
+	const VkResult acquired = result;
+	const uint64_t submit_start = vkclock_ns();
+	const uint64_t stall = submit_start - acquire_start;
+	rdr->stats.nacquires++;
+	rdr->stats.acquire_stall_ns += stall;
+	if (stall > rdr->stats.max_acquire_stall_ns)
+		rdr->stats.max_acquire_stall_ns = stall;
+	VkCommandBuffer cmds;
+	result = vkswapchain_record(swc, rdr, flight, image_index, &cmds);
+	if (result != VK_SUCCESS) {
+		/* Acquire semaphore must be unsignaled before slot is reused */
+		vkswapchain_skip(rdr, flight, frame);
+		return result;
+	}
+	/* Fence is reset after acquire, so failed acquire keeps it signaled */
+	if (!timeline) {
+		result = vkd->vkResetFences(rdr->device, 1, &flight->fence);
+		if (result != VK_SUCCESS)
+			return result;
+	}
+	/* Frame waits for image and compute jobs submitted since last one */
+	VkSemaphore wait_sems[1 + VKCOMPUTE_MAX_JOBS] = { flight->acquire_sem };
+	VkPipelineStageFlags wait_stages[ARRAY_SIZE(wait_sems)] = {
 		VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
 	};
+	const uint32_t nwaits = 1 + vkcompute_waits(&rdr->compute_jobs,
+						    &wait_sems[1],
+						    &wait_stages[1]);
+	const VkSemaphore signal_sems[] = {
+		flight->render_sem,
+		rdr->timeline,
+	};
+	/* Binary semaphore ignores its value */
+	const uint64_t signal_values[] = { 0, frame };
+	VkTimelineSemaphoreSubmitInfo timeline_info = {
+		.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+		.pNext = NULL,
+		.waitSemaphoreValueCount = 0,
+		.pWaitSemaphoreValues = NULL,
+		.signalSemaphoreValueCount = ARRAY_SIZE(signal_values),
+		.pSignalSemaphoreValues = signal_values,
+	};
 	VkSubmitInfo submit_info = {
 		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-		.pNext = NULL,
-		.waitSemaphoreCount = 1,
-		.pWaitSemaphores = &swc->acquire_sem,
+		.pNext = timeline ? &timeline_info : NULL,
+		.waitSemaphoreCount = nwaits,
+		.pWaitSemaphores = wait_sems,
 		.pWaitDstStageMask = wait_stages,
 		.commandBufferCount = 1,
-		.pCommandBuffers = &swc->frames[image_index].cmds,
-		.signalSemaphoreCount = 1,
-		.pSignalSemaphores = &swc->render_sem,
+		.pCommandBuffers = &cmds,
+		.signalSemaphoreCount = timeline ? ARRAY_SIZE(signal_sems) : 1,
+		.pSignalSemaphores = signal_sems,
 	};
-	result = vkQueueSubmit(rdr->graphics_queue, 1, &submit_info,
-			       VK_NULL_HANDLE);
+	result = vkd->vkQueueSubmit(rdr->graphics_queue, 1, &submit_info,
+				    timeline ? VK_NULL_HANDLE : flight->fence);
 	if (result != VK_SUCCESS)
 		return result;
+	vkcompute_consume(&rdr->compute_jobs, frame);
+	vkuniform_submit(&rdr->uniforms, frame);
+	rdr->stats.nsubmits++;
+	rdr->stats.submit_ns += vkclock_ns() - submit_start;
+	rdr->frame = frame;
+	flight->frame = frame;
 	VkPresentInfoKHR present_info = {
 		.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
 		.pNext = NULL,
 		.waitSemaphoreCount = 1,
-		.pWaitSemaphores = &swc->render_sem,
+		.pWaitSemaphores = &flight->render_sem,
 		.swapchainCount = 1,
 		.pSwapchains = &swc->swapchain,
 		.pImageIndices = &image_index,
 		.pResults = NULL,
 	};
-	return vkQueuePresentKHR(rdr->present_queue, &present_info);
+	result = vkd->vkQueuePresentKHR(rdr->present_queue, &present_info);
+	/* Frame is submitted, so only next one goes to recreated swapchain */
+	if (result == VK_ERROR_OUT_OF_DATE_KHR)
+		return VK_SUBOPTIMAL_KHR;
+	return (result == VK_SUCCESS) ? acquired : result;
 }
 
-void vkswapchain_terminate(const struct vkswapchain *swc, VkDevice dev)
+void vkswapchain_terminate(const struct vkswapchain *swc,
+			   struct vkrenderer *rdr)
 {
 	for (size_t i = 0; i < swc->nframes; ++i) {
-		vkframe_destroy(&swc->frames[i], dev);
+		vkframe_destroy(&swc->frames[i], rdr);
 	}
-	vkDestroySemaphore(dev, swc->render_sem, NULL);
-	vkDestroySemaphore(dev, swc->acquire_sem, NULL);
-	vkDestroySwapchainKHR(dev, swc->swapchain, NULL);
+	free(swc->frames);
+	const VkAllocationCallbacks *host = &rdr->host.callbacks;
+	vkDestroyFramebuffer(rdr->device, swc->framebuffer, host);
+	vkDestroySwapchainKHR(rdr->device, swc->swapchain, host);
 }
@@ -1,23 +1,27 @@
 #ifndef RENDERER_VKSWAPCHAIN_H
 #define RENDERER_VKSWAPCHAIN_H
 
+#include <stddef.h>
+#include <stdint.h>
+
 #include <vulkan/vulkan_core.h>
 #include <renderer/vkframe.h>
 
 struct vkrenderer;
+struct vkflight;
 
 /** Vulkan Swapchain */
 struct vkswapchain {
 	/** Swapchain */
 	VkSwapchainKHR swapchain;
-	/** Rendered frames */
-	struct vkframe frames[16];
+	/** Rendered frames, one per swapchain image */
+	struct vkframe *frames;
 	/** Number of frames in swapchain */
 	size_t nframes;
-	/** Semaphore signaled when image is acquired from swapchain */
-	VkSemaphore acquire_sem;
-	/** Semaphore signaled when image is rendered */
-	VkSemaphore render_sem;
+	/** Imageless framebuffer shared by frames, or VK_NULL_HANDLE */
+	VkFramebuffer framebuffer;
+	/** Number of the last frame submitted before swapchain was retired */
+	uint64_t retired_frame;
 };
 
 #ifdef __cplusplus
@@ -33,23 +37,32 @@ extern "C" {
  * @param old Specifies handle of old swapchain, or VK_NULL_HANDLE
  * @returns zero on sucess, or non-zero otherwise
  */
-int vkswapchain_init(struct vkswapchain *swc, const struct vkrenderer *rdr,
+int vkswapchain_init(struct vkswapchain *swc, struct vkrenderer *rdr,
 		     const VkSwapchainKHR old_swc);
 
 /**
  * Render to surface associated with renderer
+ *
+ * Successful submission advances frame counter of renderer and records
+ * the new frame number in the frame in flight slot. Suboptimal swapchain is
+ * still rendered to and reported with VK_SUBOPTIMAL_KHR, as is swapchain
+ * found out of date by presentation of already submitted frame.
+ * VK_ERROR_OUT_OF_DATE_KHR means image is not acquired and nothing is
+ * submitted, so frame can be retried on recreated swapchain.
  * @param swc Specifies pointer to swapchain used as target
  * @param rdr Specifies pointer to renderer
- * @returns VK_SUCCESS on success, or VkError error otherwise
+ * @param flight Specifies frame in flight slot to synchronize with
+ * @returns VK_SUCCESS or VK_SUBOPTIMAL_KHR on success, or VkError otherwise
  */
 VkResult vkswapchain_render(const struct vkswapchain *swc,
-			    const struct vkrenderer *rdr);
+			    struct vkrenderer *rdr, struct vkflight *flight);
 /**
  * Terminate swapchain
  * @param swc Specifies pointer to vkswapchain to terminate
- * @param dev Spwcifies Vulkan device to remove swapchain from
+ * @param rdr Specifies renderer the swapchain belongs to
  */
-void vkswapchain_terminate(const struct vkswapchain *swc, VkDevice dev);
+void vkswapchain_terminate(const struct vkswapchain *swc,
+			   struct vkrenderer *rdr);
 
 #ifdef __cplusplus
 /* *INDENT-OFF* */
@@ -7,10 +7,12 @@
 #endif
 
 #include <stdint.h>
+#include <stdlib.h>
 
 #include <cgreen/cgreen.h>
 #include <cgreen/mocks.h>
 
+#include "vkflight.h"
 #include "vkswapchain.h"
 #include "vkrenderer.h"
 
@@ -38,29 +40,85 @@ VKAPI_ATTR VkResult VKAPI_CALL vkGetSwapchainImagesKHR(
 			      pSwapchainImages);
 }
 
-VkResult vkframe_init(struct vkframe *frame, const VkRenderPass rpass,
-		      const struct vkrenderer *rdr, const VkImage image)
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateFramebuffer(
+	VkDevice device, const VkFramebufferCreateInfo *pCreateInfo,
+	const VkAllocationCallbacks *pAllocator, VkFramebuffer *pFramebuffer)
 {
-	return (VkResult)mock(frame, rpass, rdr, image);
+	return (VkResult)mock(device, pCreateInfo, pAllocator, pFramebuffer);
 }
 
-void vkframe_destroy(const struct vkframe *frame, const VkDevice device)
+VKAPI_ATTR void VKAPI_CALL
+vkDestroyFramebuffer(VkDevice device, VkFramebuffer framebuffer,
+		     const VkAllocationCallbacks *pAllocator)
 {
-	mock(frame, device);
+	mock(device, framebuffer, pAllocator);
 }
 
-VKAPI_ATTR VkResult VKAPI_CALL vkCreateSemaphore(
-	VkDevice device, const VkSemaphoreCreateInfo *pCreateInfo,
-	const VkAllocationCallbacks *pAllocator, VkSemaphore *pSemaphore)
+VkResult vkframe_init(struct vkframe *frame, const VkFramebuffer shared,
+		      struct vkrenderer *rdr, const VkImage image)
 {
-	return (VkResult)mock(device, pCreateInfo, pAllocator, pSemaphore);
+	return (VkResult)mock(frame, shared, rdr, image);
 }
 
-VKAPI_ATTR void VKAPI_CALL
-vkDestroySemaphore(VkDevice device, VkSemaphore semaphore,
-		   const VkAllocationCallbacks *pAllocator)
+void vkframe_destroy(const struct vkframe *frame, struct vkrenderer *rdr)
+{
+	mock(frame, rdr);
+}
+
+VkResult vkframe_record(const struct vkframe *frame,
+			const struct vkrenderer *rdr, VkCommandBuffer cmds,
+			VkCommandBufferUsageFlags usage,
+			const VkCommandBuffer *secondaries,
+			uint32_t nsecondaries)
 {
-	mock(device, semaphore, pAllocator);
+	return (VkResult)mock(frame, rdr, cmds, usage, secondaries,
+			      nsecondaries);
+}
+
+/** Framebuffer inherited by buffers passed to vkrecorder_record */
+static VkFramebuffer inherited_framebuffer;
+
+/** Dynamic rendering inherited by buffers passed to vkrecorder_record */
+static int inherited_rendering;
+
+VkResult vkrecorder_record(struct vkrecorder *rec, size_t slot,
+			   const VkCommandBufferInheritanceInfo *inheritance,
+			   VkCommandBuffer *cmds)
+{
+	inherited_framebuffer = inheritance->framebuffer;
+	inherited_rendering = inheritance->pNext != NULL;
+	return (VkResult)mock(rec, slot, inheritance, cmds);
+}
+
+VkResult vkflight_reset_commands(const struct vkflight *flight, VkDevice dev,
+				 const struct vkdispatch *vkd)
+{
+	return (VkResult)mock(flight, dev, vkd);
+}
+
+uint32_t vkcompute_waits(const struct vkcompute *cmp, VkSemaphore *sems,
+			 VkPipelineStageFlags *stages)
+{
+	for (size_t i = 0; i < cmp->nwaiting; ++i) {
+		sems[i] = cmp->jobs[i].done;
+		stages[i] = cmp->jobs[i].stage;
+	}
+	return (uint32_t)cmp->nwaiting;
+}
+
+void vkcompute_consume(struct vkcompute *cmp, uint64_t frame)
+{
+	for (size_t i = 0; i < cmp->nwaiting; ++i) {
+		cmp->jobs[i].frame = frame;
+	}
+	cmp->nwaiting = 0;
+}
+
+void vkuniform_submit(struct vkuniform *ring, uint64_t frame)
+{
+	if (ring->frame_bytes > 0)
+		ring->segments[ring->count++].frame = frame;
+	ring->frame_bytes = 0;
 }
 
 VKAPI_ATTR VkResult VKAPI_CALL vkAcquireNextImageKHR(
@@ -71,11 +129,50 @@ VKAPI_ATTR VkResult VKAPI_CALL vkAcquireNextImageKHR(
 			      pImageIndex);
 }
 
+VKAPI_ATTR VkResult VKAPI_CALL vkResetFences(VkDevice device,
+					     uint32_t fenceCount,
+					     const VkFence *pFences)
+{
+	return (VkResult)mock(device, fenceCount, pFences);
+}
+
+/** Last semaphore signaled by submission passed to vkQueueSubmit */
+static VkSemaphore signaled_sem;
+
+/** Value of last semaphore signaled by submission, if any */
+static uint64_t signaled_value;
+
+/** Number of semaphores waited by last submission */
+static uint32_t nwaited_sems;
+
+/** Last semaphore waited by submission passed to vkQueueSubmit */
+static VkSemaphore waited_sem;
+
+/** Command buffer of last submission passed to vkQueueSubmit */
+static VkCommandBuffer submitted_cmds;
+
+/** Frame of image acquired in render tests */
+static struct vkframe acquired_frame = {
+	.cmds = (VkCommandBuffer)0xF00D,
+};
+
 VKAPI_ATTR VkResult VKAPI_CALL vkQueueSubmit(VkQueue queue,
 					     uint32_t submitCount,
 					     const VkSubmitInfo *pSubmits,
 					     VkFence fence)
 {
+	const uint32_t nsignals = pSubmits->signalSemaphoreCount;
+	const VkTimelineSemaphoreSubmitInfo *values = pSubmits->pNext;
+	signaled_sem = nsignals ? pSubmits->pSignalSemaphores[nsignals - 1] :
+				  VK_NULL_HANDLE;
+	signaled_value = (values && nsignals) ?
+				 values->pSignalSemaphoreValues[nsignals - 1] :
+				 0;
+	submitted_cmds = pSubmits->commandBufferCount ?
+				 pSubmits->pCommandBuffers[0] :
+				 VK_NULL_HANDLE;
+	nwaited_sems = pSubmits->waitSemaphoreCount;
+	waited_sem = pSubmits->pWaitSemaphores[nwaited_sems - 1];
 	return (VkResult)mock(queue, submitCount, pSubmits, fence);
 }
 
@@ -85,6 +182,14 @@ vkQueuePresentKHR(VkQueue queue, const VkPresentInfoKHR *pPresentInfo)
 	return (VkResult)mock(queue, pPresentInfo);
 }
 
+/** Dispatch table calling mocked functions */
+static const struct vkdispatch mocked_dispatch = {
+	.vkAcquireNextImageKHR = vkAcquireNextImageKHR,
+	.vkResetFences = vkResetFences,
+	.vkQueueSubmit = vkQueueSubmit,
+	.vkQueuePresentKHR = vkQueuePresentKHR,
+};
+
 Ensure(init_returns_zero_on_success)
 {
 	struct vkrenderer vkr = { 0 };
@@ -95,11 +200,32 @@ Ensure(init_returns_zero_on_success)
 	       will_set_contents_of_parameter(pSwapchainImageCount, &nimgs,
 					      sizeof(nimgs)),
 	       will_return(VK_SUCCESS));
-	expect(vkCreateSemaphore, will_return(VK_SUCCESS));
-	expect(vkCreateSemaphore, will_return(VK_SUCCESS));
+	expect(vkGetSwapchainImagesKHR, will_return(VK_SUCCESS));
 	expect(vkframe_init, will_return(VK_SUCCESS));
 	int error = vkswapchain_init(&swc, &vkr, VK_NULL_HANDLE);
 	assert_that(error, is_equal_to(0));
+	assert_that(swc.nframes, is_equal_to(1));
+	free(swc.frames);
+}
+
+Ensure(init_creates_frame_for_each_image)
+{
+	struct vkrenderer vkr = { 0 };
+	struct vkswapchain swc = { 0 };
+	expect(vkCreateSwapchainKHR, will_return(VK_SUCCESS));
+	uint32_t nimgs = 20;
+	expect(vkGetSwapchainImagesKHR,
+	       will_set_contents_of_parameter(pSwapchainImageCount, &nimgs,
+					      sizeof(nimgs)),
+	       will_return(VK_SUCCESS));
+	expect(vkGetSwapchainImagesKHR, will_return(VK_SUCCESS));
+	for (uint32_t i = 0; i < nimgs; ++i) {
+		expect(vkframe_init, will_return(VK_SUCCESS));
+	}
+	int error = vkswapchain_init(&swc, &vkr, VK_NULL_HANDLE);
+	assert_that(error, is_equal_to(0));
+	assert_that(swc.nframes, is_equal_to(nimgs));
+	free(swc.frames);
 }
 
 Ensure(init_returns_non_zero_on_swapchain_fail)
@@ -111,26 +237,32 @@ Ensure(init_returns_non_zero_on_swapchain_fail)
 	assert_that(error, is_not_equal_to(0));
 }
 
-Ensure(init_returns_non_zero_on_sync_objects_fail)
+Ensure(init_returns_non_zero_on_getting_images_fail)
 {
 	struct vkrenderer vkr = { 0 };
 	struct vkswapchain swc = { 0 };
 	expect(vkCreateSwapchainKHR, will_return(VK_SUCCESS));
-	expect(vkCreateSemaphore, will_return(VK_NOT_READY));
+	expect(vkGetSwapchainImagesKHR,
+	       will_return(VK_ERROR_OUT_OF_HOST_MEMORY));
 	int error = vkswapchain_init(&swc, &vkr, VK_NULL_HANDLE);
 	assert_that(error, is_not_equal_to(0));
 }
 
-Ensure(init_returns_non_zero_on_getting_images_fail)
+Ensure(init_returns_non_zero_when_images_changed)
 {
 	struct vkrenderer vkr = { 0 };
 	struct vkswapchain swc = { 0 };
 	expect(vkCreateSwapchainKHR, will_return(VK_SUCCESS));
-	expect(vkCreateSemaphore, will_return(VK_SUCCESS));
-	expect(vkCreateSemaphore, will_return(VK_SUCCESS));
+	uint32_t nimgs = 2;
+	expect(vkGetSwapchainImagesKHR,
+	       will_set_contents_of_parameter(pSwapchainImageCount, &nimgs,
+					      sizeof(nimgs)),
+	       will_return(VK_SUCCESS));
 	expect(vkGetSwapchainImagesKHR, will_return(VK_INCOMPLETE));
+	never_expect(vkframe_init);
 	int error = vkswapchain_init(&swc, &vkr, VK_NULL_HANDLE);
 	assert_that(error, is_not_equal_to(0));
+	free(swc.frames);
 }
 
 Ensure(init_returns_non_zero_on_frame_init_fail)
@@ -138,79 +270,518 @@ Ensure(init_returns_non_zero_on_frame_init_fail)
 	struct vkrenderer vkr = { 0 };
 	struct vkswapchain swc = { 0 };
 	expect(vkCreateSwapchainKHR, will_return(VK_SUCCESS));
-	expect(vkCreateSemaphore, will_return(VK_SUCCESS));
-	expect(vkCreateSemaphore, will_return(VK_SUCCESS));
 	uint32_t nimgs = 1;
 	expect(vkGetSwapchainImagesKHR,
 	       will_set_contents_of_parameter(pSwapchainImageCount, &nimgs,
 					      sizeof(nimgs)),
 	       will_return(VK_SUCCESS));
+	expect(vkGetSwapchainImagesKHR, will_return(VK_SUCCESS));
 	expect(vkframe_init, will_return(VK_ERROR_INITIALIZATION_FAILED));
 	int error = vkswapchain_init(&swc, &vkr, VK_NULL_HANDLE);
 	assert_that(error, is_not_equal_to(0));
+	free(swc.frames);
+}
+
+Ensure(init_shares_imageless_framebuffer_between_frames)
+{
+	struct vkrenderer vkr = {
+		.caps = VKRENDERER_CAP_IMAGELESS_FRAMEBUFFER,
+	};
+	struct vkswapchain swc = { 0 };
+	const VkFramebuffer shared = (VkFramebuffer)0xFB;
+	expect(vkCreateSwapchainKHR, will_return(VK_SUCCESS));
+	expect(vkCreateFramebuffer,
+	       will_set_contents_of_parameter(pFramebuffer, &shared,
+					      sizeof(shared)),
+	       will_return(VK_SUCCESS));
+	uint32_t nimgs = 2;
+	expect(vkGetSwapchainImagesKHR,
+	       will_set_contents_of_parameter(pSwapchainImageCount, &nimgs,
+					      sizeof(nimgs)),
+	       will_return(VK_SUCCESS));
+	expect(vkGetSwapchainImagesKHR, will_return(VK_SUCCESS));
+	for (uint32_t i = 0; i < nimgs; ++i) {
+		expect(vkframe_init, will_return(VK_SUCCESS),
+		       when(shared, is_equal_to(shared)));
+	}
+	int error = vkswapchain_init(&swc, &vkr, VK_NULL_HANDLE);
+	assert_that(error, is_equal_to(0));
+	assert_that(swc.framebuffer, is_equal_to(shared));
+	free(swc.frames);
+}
+
+Ensure(init_returns_non_zero_on_imageless_framebuffer_fail)
+{
+	struct vkrenderer vkr = {
+		.caps = VKRENDERER_CAP_IMAGELESS_FRAMEBUFFER,
+	};
+	struct vkswapchain swc = { 0 };
+	expect(vkCreateSwapchainKHR, will_return(VK_SUCCESS));
+	expect(vkCreateFramebuffer, will_return(VK_ERROR_OUT_OF_HOST_MEMORY));
+	never_expect(vkframe_init);
+	int error = vkswapchain_init(&swc, &vkr, VK_NULL_HANDLE);
+	assert_that(error, is_not_equal_to(0));
 }
 
 Ensure(terminate_destroys_all_resources)
 {
-	VkDevice dev = VK_NULL_HANDLE;
+	struct vkrenderer vkr = { 0 };
 	struct vkswapchain swc = {
+		.frames = calloc(1, sizeof(struct vkframe)),
 		.nframes = 1,
 	};
-	expect(vkframe_destroy);
-	expect(vkDestroySemaphore);
-	expect(vkDestroySemaphore);
+	expect(vkframe_destroy, when(frame, is_equal_to(swc.frames)));
+	expect(vkDestroyFramebuffer);
 	expect(vkDestroySwapchainKHR);
-	vkswapchain_terminate(&swc, dev);
+	vkswapchain_terminate(&swc, &vkr);
 }
 
 Ensure(render_returns_error_on_image_acquire_fail)
 {
 	struct vkrenderer vkr = { 0 };
+	vkr.vkd = mocked_dispatch;
 	expect(vkAcquireNextImageKHR, will_return(VK_NOT_READY));
-	VkResult error = vkswapchain_render(&vkr.swcs[0], &vkr);
+	never_expect(vkResetFences);
+	struct vkflight *flight = &vkr.flights[0];
+	VkResult error = vkswapchain_render(&vkr.swcs[0], &vkr, flight);
 	assert_that(error, is_equal_to(VK_NOT_READY));
 }
 
+Ensure(render_returns_error_on_fence_reset_fail)
+{
+	struct vkrenderer vkr = { 0 };
+	vkr.vkd = mocked_dispatch;
+	uint32_t image_index = 0;
+	vkr.swcs[0].frames = &acquired_frame;
+	expect(vkAcquireNextImageKHR,
+	       will_set_contents_of_parameter(pImageIndex, &image_index,
+					      sizeof(image_index)),
+	       will_return(VK_SUCCESS));
+	expect(vkResetFences, will_return(VK_ERROR_DEVICE_LOST));
+	struct vkflight *flight = &vkr.flights[0];
+	VkResult error = vkswapchain_render(&vkr.swcs[0], &vkr, flight);
+	assert_that(error, is_equal_to(VK_ERROR_DEVICE_LOST));
+}
+
 Ensure(render_returns_error_on_submit_fail)
 {
 	struct vkrenderer vkr = { 0 };
+	vkr.vkd = mocked_dispatch;
 	uint32_t image_index = 0;
+	vkr.swcs[0].frames = &acquired_frame;
 	expect(vkAcquireNextImageKHR,
 	       will_set_contents_of_parameter(pImageIndex, &image_index,
 					      sizeof(image_index)),
 	       will_return(VK_SUCCESS));
-	expect(vkQueueSubmit, will_return(VK_NOT_READY));
-	VkResult error = vkswapchain_render(&vkr.swcs[0], &vkr);
+	expect(vkResetFences, will_return(VK_SUCCESS));
+	expect(vkQueueSubmit, will_return(VK_NOT_READY),
+	       when(fence, is_equal_to(vkr.flights[0].fence)));
+	struct vkflight *flight = &vkr.flights[0];
+	VkResult error = vkswapchain_render(&vkr.swcs[0], &vkr, flight);
 	assert_that(error, is_equal_to(VK_NOT_READY));
+	assert_that(vkr.frame, is_equal_to(0));
+	assert_that(flight->frame, is_equal_to(0));
 }
 
 Ensure(render_returns_error_on_present_fail)
 {
 	struct vkrenderer vkr = { 0 };
+	vkr.vkd = mocked_dispatch;
 	uint32_t image_index = 0;
+	vkr.swcs[0].frames = &acquired_frame;
 	expect(vkAcquireNextImageKHR,
 	       will_set_contents_of_parameter(pImageIndex, &image_index,
 					      sizeof(image_index)),
 	       will_return(VK_SUCCESS));
+	expect(vkResetFences, will_return(VK_SUCCESS));
 	expect(vkQueueSubmit, will_return(VK_SUCCESS));
 	expect(vkQueuePresentKHR, will_return(VK_NOT_READY));
-	VkResult error = vkswapchain_render(&vkr.swcs[0], &vkr);
+	struct vkflight *flight = &vkr.flights[0];
+	VkResult error = vkswapchain_render(&vkr.swcs[0], &vkr, flight);
 	assert_that(error, is_equal_to(VK_NOT_READY));
 }
 
+Ensure(render_advances_frame_counter_on_submit)
+{
+	struct vkrenderer vkr = { 0 };
+	vkr.vkd = mocked_dispatch;
+	uint32_t image_index = 0;
+	vkr.swcs[0].frames = &acquired_frame;
+	vkr.frame = 41;
+	expect(vkAcquireNextImageKHR,
+	       will_set_contents_of_parameter(pImageIndex, &image_index,
+					      sizeof(image_index)),
+	       will_return(VK_SUCCESS));
+	expect(vkResetFences, will_return(VK_SUCCESS));
+	expect(vkQueueSubmit, will_return(VK_SUCCESS));
+	expect(vkQueuePresentKHR, will_return(VK_SUCCESS));
+	struct vkflight *flight = &vkr.flights[1];
+	VkResult error = vkswapchain_render(&vkr.swcs[0], &vkr, flight);
+	assert_that(error, is_equal_to(VK_SUCCESS));
+	assert_that(vkr.frame, is_equal_to(42));
+	assert_that(flight->frame, is_equal_to(42));
+}
+
+Ensure(render_presents_to_suboptimal_swapchain)
+{
+	struct vkrenderer vkr = { 0 };
+	vkr.vkd = mocked_dispatch;
+	uint32_t image_index = 0;
+	vkr.swcs[0].frames = &acquired_frame;
+	expect(vkAcquireNextImageKHR,
+	       will_set_contents_of_parameter(pImageIndex, &image_index,
+					      sizeof(image_index)),
+	       will_return(VK_SUBOPTIMAL_KHR));
+	expect(vkResetFences, will_return(VK_SUCCESS));
+	expect(vkQueueSubmit, will_return(VK_SUCCESS));
+	expect(vkQueuePresentKHR, will_return(VK_SUCCESS));
+	struct vkflight *flight = &vkr.flights[0];
+	VkResult result = vkswapchain_render(&vkr.swcs[0], &vkr, flight);
+	assert_that(result, is_equal_to(VK_SUBOPTIMAL_KHR));
+}
+
+Ensure(render_returns_suboptimal_reported_by_present)
+{
+	struct vkrenderer vkr = { 0 };
+	vkr.vkd = mocked_dispatch;
+	uint32_t image_index = 0;
+	vkr.swcs[0].frames = &acquired_frame;
+	expect(vkAcquireNextImageKHR,
+	       will_set_contents_of_parameter(pImageIndex, &image_index,
+					      sizeof(image_index)),
+	       will_return(VK_SUCCESS));
+	expect(vkResetFences, will_return(VK_SUCCESS));
+	expect(vkQueueSubmit, will_return(VK_SUCCESS));
+	expect(vkQueuePresentKHR, will_return(VK_SUBOPTIMAL_KHR));
+	struct vkflight *flight = &vkr.flights[0];
+	VkResult result = vkswapchain_render(&vkr.swcs[0], &vkr, flight);
+	assert_that(result, is_equal_to(VK_SUBOPTIMAL_KHR));
+}
+
+Ensure(render_reports_out_of_date_present_as_suboptimal)
+{
+	struct vkrenderer vkr = { 0 };
+	vkr.vkd = mocked_dispatch;
+	uint32_t image_index = 0;
+	vkr.swcs[0].frames = &acquired_frame;
+	expect(vkAcquireNextImageKHR,
+	       will_set_contents_of_parameter(pImageIndex, &image_index,
+					      sizeof(image_index)),
+	       will_return(VK_SUCCESS));
+	expect(vkResetFences, will_return(VK_SUCCESS));
+	expect(vkQueueSubmit, will_return(VK_SUCCESS));
+	expect(vkQueuePresentKHR, will_return(VK_ERROR_OUT_OF_DATE_KHR));
+	struct vkflight *flight = &vkr.flights[0];
+	VkResult result = vkswapchain_render(&vkr.swcs[0], &vkr, flight);
+	assert_that(result, is_equal_to(VK_SUBOPTIMAL_KHR));
+	assert_that(vkr.frame, is_equal_to(1));
+	assert_that(flight->frame, is_equal_to(1));
+}
+
+Ensure(render_accounts_image_acquire_stall)
+{
+	struct vkrenderer vkr = { 0 };
+	vkr.vkd = mocked_dispatch;
+	uint32_t image_index = 0;
+	vkr.swcs[0].frames = &acquired_frame;
+	vkr.stats.nacquires = 3;
+	expect(vkAcquireNextImageKHR,
+	       will_set_contents_of_parameter(pImageIndex, &image_index,
+					      sizeof(image_index)),
+	       will_return(VK_SUCCESS));
+	expect(vkResetFences, will_return(VK_SUCCESS));
+	expect(vkQueueSubmit, will_return(VK_SUCCESS));
+	expect(vkQueuePresentKHR, will_return(VK_SUCCESS));
+	struct vkflight *flight = &vkr.flights[0];
+	vkswapchain_render(&vkr.swcs[0], &vkr, flight);
+	assert_that(vkr.stats.nacquires, is_equal_to(4));
+	assert_that(vkr.stats.acquire_stall_ns,
+		    is_equal_to(vkr.stats.max_acquire_stall_ns));
+}
+
+Ensure(render_signals_timeline_semaphore_when_supported)
+{
+	struct vkrenderer vkr = { 0 };
+	vkr.vkd = mocked_dispatch;
+	uint32_t image_index = 0;
+	vkr.swcs[0].frames = &acquired_frame;
+	vkr.caps = VKRENDERER_CAP_TIMELINE_SEMAPHORE;
+	vkr.timeline = (VkSemaphore)0xCAFE;
+	vkr.frame = 7;
+	expect(vkAcquireNextImageKHR,
+	       will_set_contents_of_parameter(pImageIndex, &image_index,
+					      sizeof(image_index)),
+	       will_return(VK_SUCCESS));
+	never_expect(vkResetFences);
+	expect(vkQueueSubmit, will_return(VK_SUCCESS),
+	       when(fence, is_equal_to(VK_NULL_HANDLE)));
+	expect(vkQueuePresentKHR, will_return(VK_SUCCESS));
+	struct vkflight *flight = &vkr.flights[0];
+	VkResult error = vkswapchain_render(&vkr.swcs[0], &vkr, flight);
+	assert_that(error, is_equal_to(VK_SUCCESS));
+	assert_that(signaled_sem, is_equal_to(vkr.timeline));
+	assert_that(signaled_value, is_equal_to(8));
+	assert_that(vkr.frame, is_equal_to(8));
+	assert_that(flight->frame, is_equal_to(8));
+}
+
+Ensure(render_waits_for_submitted_compute_jobs)
+{
+	struct vkrenderer vkr = { 0 };
+	vkr.vkd = mocked_dispatch;
+	uint32_t image_index = 0;
+	vkr.swcs[0].frames = &acquired_frame;
+	vkr.compute_jobs.count = 1;
+	vkr.compute_jobs.nwaiting = 1;
+	vkr.compute_jobs.jobs[0].done = (VkSemaphore)0xC0DE;
+	vkr.compute_jobs.jobs[0].stage = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+	vkr.frame = 4;
+	expect(vkAcquireNextImageKHR,
+	       will_set_contents_of_parameter(pImageIndex, &image_index,
+					      sizeof(image_index)),
+	       will_return(VK_SUCCESS));
+	expect(vkResetFences, will_return(VK_SUCCESS));
+	expect(vkQueueSubmit, will_return(VK_SUCCESS));
+	expect(vkQueuePresentKHR, will_return(VK_SUCCESS));
+	struct vkflight *flight = &vkr.flights[0];
+	VkResult error = vkswapchain_render(&vkr.swcs[0], &vkr, flight);
+	assert_that(error, is_equal_to(VK_SUCCESS));
+	assert_that(nwaited_sems, is_equal_to(2));
+	assert_that(waited_sem, is_equal_to((VkSemaphore)0xC0DE));
+	assert_that(vkr.compute_jobs.jobs[0].frame, is_equal_to(5));
+}
+
+Ensure(render_assigns_uniform_data_to_submitted_frame)
+{
+	struct vkrenderer vkr = { 0 };
+	vkr.vkd = mocked_dispatch;
+	uint32_t image_index = 0;
+	vkr.swcs[0].frames = &acquired_frame;
+	vkr.uniforms.frame_bytes = 256;
+	vkr.frame = 6;
+	expect(vkAcquireNextImageKHR,
+	       will_set_contents_of_parameter(pImageIndex, &image_index,
+					      sizeof(image_index)),
+	       will_return(VK_SUCCESS));
+	expect(vkResetFences, will_return(VK_SUCCESS));
+	expect(vkQueueSubmit, will_return(VK_SUCCESS));
+	expect(vkQueuePresentKHR, will_return(VK_SUCCESS));
+	struct vkflight *flight = &vkr.flights[0];
+	VkResult error = vkswapchain_render(&vkr.swcs[0], &vkr, flight);
+	assert_that(error, is_equal_to(VK_SUCCESS));
+	assert_that(vkr.uniforms.count, is_equal_to(1));
+	assert_that(vkr.uniforms.segments[0].frame, is_equal_to(7));
+}
+
+Ensure(render_submits_commands_recorded_once)
+{
+	struct vkrenderer vkr = { 0 };
+	vkr.vkd = mocked_dispatch;
+	uint32_t image_index = 0;
+	vkr.swcs[0].frames = &acquired_frame;
+	expect(vkAcquireNextImageKHR,
+	       will_set_contents_of_parameter(pImageIndex, &image_index,
+					      sizeof(image_index)),
+	       will_return(VK_SUCCESS));
+	never_expect(vkframe_record);
+	expect(vkResetFences, will_return(VK_SUCCESS));
+	expect(vkQueueSubmit, will_return(VK_SUCCESS));
+	expect(vkQueuePresentKHR, will_return(VK_SUCCESS));
+	struct vkflight *flight = &vkr.flights[0];
+	vkswapchain_render(&vkr.swcs[0], &vkr, flight);
+	assert_that(submitted_cmds, is_equal_to(acquired_frame.cmds));
+}
+
+Ensure(render_records_commands_per_frame)
+{
+	struct vkrenderer vkr = { 0 };
+	vkr.vkd = mocked_dispatch;
+	uint32_t image_index = 0;
+	vkr.swcs[0].frames = &acquired_frame;
+	vkr.record_mode = VKRENDERER_RECORD_PER_FRAME;
+	vkr.flights[0].cmds = (VkCommandBuffer)0xBEEF;
+	struct vkflight *flight = &vkr.flights[0];
+	expect(vkAcquireNextImageKHR,
+	       will_set_contents_of_parameter(pImageIndex, &image_index,
+					      sizeof(image_index)),
+	       will_return(VK_SUCCESS));
+	expect(vkflight_reset_commands, will_return(VK_SUCCESS),
+	       when(flight, is_equal_to(flight)));
+	expect(vkframe_record, will_return(VK_SUCCESS),
+	       when(frame, is_equal_to(&acquired_frame)),
+	       when(cmds, is_equal_to(flight->cmds)),
+	       when(usage,
+		    is_equal_to(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT)),
+	       when(nsecondaries, is_equal_to(0)));
+	expect(vkResetFences, will_return(VK_SUCCESS));
+	expect(vkQueueSubmit, will_return(VK_SUCCESS));
+	expect(vkQueuePresentKHR, will_return(VK_SUCCESS));
+	VkResult error = vkswapchain_render(&vkr.swcs[0], &vkr, flight);
+	assert_that(error, is_equal_to(VK_SUCCESS));
+	assert_that(submitted_cmds, is_equal_to(flight->cmds));
+	assert_that(vkr.stats.nsubmits, is_equal_to(1));
+}
+
+Ensure(render_executes_commands_recorded_by_threads)
+{
+	struct vkrenderer vkr = { 0 };
+	vkr.vkd = mocked_dispatch;
+	uint32_t image_index = 0;
+	vkr.swcs[0].frames = &acquired_frame;
+	vkr.record_mode = VKRENDERER_RECORD_PARALLEL;
+	vkr.recorder.nworkers = 3;
+	struct vkflight *flight = &vkr.flights[1];
+	expect(vkAcquireNextImageKHR,
+	       will_set_contents_of_parameter(pImageIndex, &image_index,
+					      sizeof(image_index)),
+	       will_return(VK_SUCCESS));
+	expect(vkflight_reset_commands, will_return(VK_SUCCESS));
+	expect(vkrecorder_record, will_return(VK_SUCCESS),
+	       when(slot, is_equal_to(1)));
+	expect(vkframe_record, will_return(VK_SUCCESS),
+	       when(nsecondaries, is_equal_to(3)));
+	expect(vkResetFences, will_return(VK_SUCCESS));
+	expect(vkQueueSubmit, will_return(VK_SUCCESS));
+	expect(vkQueuePresentKHR, will_return(VK_SUCCESS));
+	VkResult error = vkswapchain_render(&vkr.swcs[0], &vkr, flight);
+	assert_that(error, is_equal_to(VK_SUCCESS));
+	assert_that(inherited_framebuffer, is_equal_to(acquired_frame.buffer));
+	assert_that(inherited_rendering, is_false);
+}
+
+Ensure(render_inherits_dynamic_rendering_in_threads)
+{
+	struct vkrenderer vkr = { .caps = VKRENDERER_CAP_DYNAMIC_RENDERING };
+	vkr.vkd = mocked_dispatch;
+	uint32_t image_index = 0;
+	vkr.swcs[0].frames = &acquired_frame;
+	vkr.record_mode = VKRENDERER_RECORD_PARALLEL;
+	vkr.recorder.nworkers = 1;
+	expect(vkAcquireNextImageKHR,
+	       will_set_contents_of_parameter(pImageIndex, &image_index,
+					      sizeof(image_index)),
+	       will_return(VK_SUCCESS));
+	expect(vkflight_reset_commands, will_return(VK_SUCCESS));
+	expect(vkrecorder_record, will_return(VK_SUCCESS));
+	expect(vkframe_record, will_return(VK_SUCCESS));
+	expect(vkResetFences, will_return(VK_SUCCESS));
+	expect(vkQueueSubmit, will_return(VK_SUCCESS));
+	expect(vkQueuePresentKHR, will_return(VK_SUCCESS));
+	VkResult error = vkswapchain_render(&vkr.swcs[0], &vkr, vkr.flights);
+	assert_that(error, is_equal_to(VK_SUCCESS));
+	assert_that(inherited_rendering, is_true);
+}
+
+Ensure(render_returns_error_on_parallel_record_fail)
+{
+	struct vkrenderer vkr = { 0 };
+	vkr.vkd = mocked_dispatch;
+	uint32_t image_index = 0;
+	vkr.swcs[0].frames = &acquired_frame;
+	vkr.record_mode = VKRENDERER_RECORD_PARALLEL;
+	expect(vkAcquireNextImageKHR,
+	       will_set_contents_of_parameter(pImageIndex, &image_index,
+					      sizeof(image_index)),
+	       will_return(VK_SUCCESS));
+	expect(vkflight_reset_commands, will_return(VK_SUCCESS));
+	expect(vkrecorder_record, will_return(VK_ERROR_OUT_OF_HOST_MEMORY));
+	never_expect(vkframe_record);
+	expect(vkResetFences, will_return(VK_SUCCESS));
+	expect(vkQueueSubmit, will_return(VK_SUCCESS));
+	never_expect(vkQueuePresentKHR);
+	struct vkflight *flight = &vkr.flights[0];
+	VkResult error = vkswapchain_render(&vkr.swcs[0], &vkr, flight);
+	assert_that(error, is_equal_to(VK_ERROR_OUT_OF_HOST_MEMORY));
+}
+
+Ensure(render_unsignals_acquire_semaphore_on_record_fail)
+{
+	struct vkrenderer vkr = { 0 };
+	vkr.vkd = mocked_dispatch;
+	uint32_t image_index = 0;
+	vkr.swcs[0].frames = &acquired_frame;
+	vkr.record_mode = VKRENDERER_RECORD_PER_FRAME;
+	vkr.frame = 4;
+	struct vkflight *flight = &vkr.flights[0];
+	flight->acquire_sem = (VkSemaphore)7;
+	flight->fence = (VkFence)8;
+	expect(vkAcquireNextImageKHR,
+	       will_set_contents_of_parameter(pImageIndex, &image_index,
+					      sizeof(image_index)),
+	       will_return(VK_SUCCESS));
+	expect(vkflight_reset_commands, will_return(VK_SUCCESS));
+	expect(vkframe_record, will_return(VK_ERROR_OUT_OF_HOST_MEMORY));
+	expect(vkResetFences, will_return(VK_SUCCESS));
+	expect(vkQueueSubmit, will_return(VK_SUCCESS),
+	       when(fence, is_equal_to(flight->fence)));
+	never_expect(vkQueuePresentKHR);
+	VkResult error = vkswapchain_render(&vkr.swcs[0], &vkr, flight);
+	assert_that(error, is_equal_to(VK_ERROR_OUT_OF_HOST_MEMORY));
+	assert_that(waited_sem, is_equal_to(flight->acquire_sem));
+	assert_that(submitted_cmds, is_equal_to(VK_NULL_HANDLE));
+	assert_that(flight->frame, is_equal_to(5));
+	assert_that(vkr.frame, is_equal_to(5));
+	assert_that(vkr.swc_outdated, is_not_equal_to(0));
+}
+
+Ensure(render_signals_timeline_for_frame_failed_to_record)
+{
+	struct vkrenderer vkr = { .caps = VKRENDERER_CAP_TIMELINE_SEMAPHORE };
+	vkr.vkd = mocked_dispatch;
+	uint32_t image_index = 0;
+	vkr.swcs[0].frames = &acquired_frame;
+	vkr.record_mode = VKRENDERER_RECORD_PER_FRAME;
+	vkr.timeline = (VkSemaphore)9;
+	vkr.frame = 4;
+	struct vkflight *flight = &vkr.flights[0];
+	expect(vkAcquireNextImageKHR,
+	       will_set_contents_of_parameter(pImageIndex, &image_index,
+					      sizeof(image_index)),
+	       will_return(VK_SUCCESS));
+	expect(vkflight_reset_commands, will_return(VK_SUCCESS));
+	expect(vkframe_record, will_return(VK_ERROR_OUT_OF_HOST_MEMORY));
+	never_expect(vkResetFences);
+	expect(vkQueueSubmit, will_return(VK_SUCCESS),
+	       when(fence, is_equal_to(VK_NULL_HANDLE)));
+	VkResult error = vkswapchain_render(&vkr.swcs[0], &vkr, flight);
+	assert_that(error, is_equal_to(VK_ERROR_OUT_OF_HOST_MEMORY));
+	assert_that(signaled_sem, is_equal_to(vkr.timeline));
+	assert_that(signaled_value, is_equal_to(5));
+	assert_that(flight->frame, is_equal_to(5));
+}
+
 int main(int argc, char **argv)
 {
 	(void)(argc);
 	(void)(argv);
 	TestSuite *swc = create_named_test_suite("VKSwapchain");
 	add_test(swc, init_returns_zero_on_success);
+	add_test(swc, init_creates_frame_for_each_image);
+	add_test(swc, init_returns_non_zero_when_images_changed);
 	add_test(swc, init_returns_non_zero_on_swapchain_fail);
-	add_test(swc, init_returns_non_zero_on_sync_objects_fail);
 	add_test(swc, init_returns_non_zero_on_getting_images_fail);
 	add_test(swc, init_returns_non_zero_on_frame_init_fail);
+	add_test(swc, init_shares_imageless_framebuffer_between_frames);
+	add_test(swc, init_returns_non_zero_on_imageless_framebuffer_fail);
 	add_test(swc, render_returns_error_on_image_acquire_fail);
+	add_test(swc, render_returns_error_on_fence_reset_fail);
 	add_test(swc, render_returns_error_on_submit_fail);
 	add_test(swc, render_returns_error_on_present_fail);
+	add_test(swc, render_advances_frame_counter_on_submit);
+	add_test(swc, render_presents_to_suboptimal_swapchain);
+	add_test(swc, render_returns_suboptimal_reported_by_present);
+	add_test(swc, render_reports_out_of_date_present_as_suboptimal);
+	add_test(swc, render_accounts_image_acquire_stall);
+	add_test(swc, render_signals_timeline_semaphore_when_supported);
+	add_test(swc, render_waits_for_submitted_compute_jobs);
+	add_test(swc, render_assigns_uniform_data_to_submitted_frame);
+	add_test(swc, render_submits_commands_recorded_once);
+	add_test(swc, render_records_commands_per_frame);
+	add_test(swc, render_unsignals_acquire_semaphore_on_record_fail);
+	add_test(swc, render_signals_timeline_for_frame_failed_to_record);
+	add_test(swc, render_executes_commands_recorded_by_threads);
+	add_test(swc, render_inherits_dynamic_rendering_in_threads);
+	add_test(swc, render_returns_error_on_parallel_record_fail);
 	add_test(swc, terminate_destroys_all_resources);
 	TestReporter *reporter = create_text_reporter();
 	int exit_code = run_test_suite(swc, reporter);
@@ -0,0 +1,380 @@
+/**
+ * @file
+ * Vulkan uploads on dedicated transfer queue implementation
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "vktransfer.h"
+#include <vulkan/vulkan_core.h>
+
+/**
+ * Checks if copies run on queue family other than graphics one
+ * @param xfer Specifies uploads to check
+ * @returns non-zero if ownership of destinations must be transferred
+ */
+static int vktransfer_dedicated(const struct vktransfer *xfer)
+{
+	return xfer->family != xfer->graphic;
+}
+
+/**
+ * Creates pool of command buffers recorded for every batch anew
+ * @param xfer Specifies uploads to create pool for
+ * @param family Specifies queue family command buffers are submitted to
+ * @param pool Specifies pointer where pool must be stored
+ * @returns VK_SUCCESS on success, or VkResult error otherwise
+ */
+static VkResult vktransfer_create_pool(const struct vktransfer *xfer,
+				       uint32_t family, VkCommandPool *pool)
+{
+	const VkCommandPoolCreateInfo info = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+		.pNext = NULL,
+		.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT |
+			 VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+		.queueFamilyIndex = family,
+	};
+	return vkCreateCommandPool(xfer->dev, &info, xfer->host, pool);
+}
+
+/**
+ * Allocates primary command buffer from pool
+ * @param dev Specifies device the pool belongs to
+ * @param pool Specifies pool to allocate from
+ * @param cmds Specifies pointer where command buffer must be stored
+ * @returns VK_SUCCESS on success, or VkResult error otherwise
+ */
+static VkResult vktransfer_allocate(VkDevice dev, VkCommandPool pool,
+				    VkCommandBuffer *cmds)
+{
+	const VkCommandBufferAllocateInfo info = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+		.pNext = NULL,
+		.commandPool = pool,
+		.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+		.commandBufferCount = 1,
+	};
+	return vkAllocateCommandBuffers(dev, &info, cmds);
+}
+
+/**
+ * Initializes upload batch
+ * @param xfer Specifies uploads the batch belongs to
+ * @param batch Specifies batch to initialize
+ * @returns VK_SUCCESS on success, or VkResult error otherwise
+ */
+static VkResult vktransfer_init_batch(const struct vktransfer *xfer,
+				      struct vktransfer_batch *batch)
+{
+	const VkFenceCreateInfo fence_info = {
+		.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+		.pNext = NULL,
+		.flags = 0,
+	};
+	const VkSemaphoreCreateInfo sem_info = {
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+		.pNext = NULL,
+		.flags = 0,
+	};
+	VkResult result;
+	batch->acquire = VK_NULL_HANDLE;
+	batch->copied = VK_NULL_HANDLE;
+	batch->fence = VK_NULL_HANDLE;
+	batch->state = VKTRANSFER_FREE;
+	batch->ticket = 0;
+	batch->ncopies = 0;
+	result = vktransfer_allocate(xfer->dev, xfer->pool, &batch->copy);
+	if (result != VK_SUCCESS)
+		return result;
+	result = vkCreateFence(xfer->dev, &fence_info, xfer->host,
+			       &batch->fence);
+	if (result != VK_SUCCESS || !vktransfer_dedicated(xfer))
+		return result;
+	result = vktransfer_allocate(xfer->dev, xfer->graphics_pool,
+				     &batch->acquire);
+	if (result != VK_SUCCESS)
+		return result;
+	return vkCreateSemaphore(xfer->dev, &sem_info, xfer->host,
+				 &batch->copied);
+}
+
+VkResult vktransfer_init(struct vktransfer *xfer, VkDevice dev,
+			 const struct vkdispatch *vkd, uint32_t family,
+			 VkQueue queue, uint32_t graphic,
+			 VkQueue graphics_queue,
+			 const VkAllocationCallbacks *host)
+{
+	VkResult result;
+	xfer->dev = dev;
+	xfer->vkd = vkd;
+	xfer->host = host;
+	xfer->queue = queue;
+	xfer->family = family;
+	xfer->graphics_queue = graphics_queue;
+	xfer->graphic = graphic;
+	xfer->graphics_pool = VK_NULL_HANDLE;
+	xfer->head = 0;
+	xfer->count = 0;
+	xfer->submitted = 0;
+	xfer->completed = 0;
+	xfer->retired = 0;
+	xfer->nbytes = 0;
+	result = vktransfer_create_pool(xfer, family, &xfer->pool);
+	if (result != VK_SUCCESS)
+		return result;
+	if (vktransfer_dedicated(xfer)) {
+		result = vktransfer_create_pool(xfer, graphic,
+						&xfer->graphics_pool);
+		if (result != VK_SUCCESS)
+			return result;
+	}
+	for (size_t i = 0; i < VKTRANSFER_MAX_BATCHES; ++i) {
+		result = vktransfer_init_batch(xfer, &xfer->batches[i]);
+		if (result != VK_SUCCESS)
+			return result;
+	}
+	return VK_SUCCESS;
+}
+
+/**
+ * Returns batch copies are being recorded into
+ * @param xfer Specifies uploads to get batch of
+ * @returns pointer to recording batch, or NULL if there is none
+ */
+static struct vktransfer_batch *vktransfer_recording(struct vktransfer *xfer)
+{
+	if (xfer->count == 0)
+		return NULL;
+	const size_t index = (xfer->head + xfer->count - 1) %
+			     VKTRANSFER_MAX_BATCHES;
+	struct vktransfer_batch *batch = &xfer->batches[index];
+	return batch->state == VKTRANSFER_RECORDING ? batch : NULL;
+}
+
+/**
+ * Starts recording new batch, waiting for the oldest one if all are used
+ * @param xfer Specifies uploads to start batch of
+ * @param batch Specifies pointer where started batch must be stored
+ * @returns VK_SUCCESS on success, or VkResult error otherwise
+ */
+static VkResult vktransfer_begin(struct vktransfer *xfer,
+				 struct vktransfer_batch **batch)
+{
+	const VkCommandBufferBeginInfo info = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.pNext = NULL,
+		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+		.pInheritanceInfo = NULL,
+	};
+	VkResult result;
+	while (xfer->count == VKTRANSFER_MAX_BATCHES) {
+		const struct vktransfer_batch *oldest =
+			&xfer->batches[xfer->head];
+		result = xfer->vkd->vkWaitForFences(xfer->dev, 1,
+						    &oldest->fence, VK_TRUE,
+						    UINT64_MAX);
+		if (result != VK_SUCCESS)
+			return result;
+		result = vktransfer_collect(xfer);
+		if (result != VK_SUCCESS)
+			return result;
+	}
+	const size_t index = (xfer->head + xfer->count) %
+			     VKTRANSFER_MAX_BATCHES;
+	struct vktransfer_batch *next = &xfer->batches[index];
+	result = xfer->vkd->vkBeginCommandBuffer(next->copy, &info);
+	if (result != VK_SUCCESS)
+		return result;
+	next->state = VKTRANSFER_RECORDING;
+	next->ncopies = 0;
+	xfer->count++;
+	*batch = next;
+	return VK_SUCCESS;
+}
+
+VkResult vktransfer_copy_buffer(struct vktransfer *xfer, VkBuffer src,
+				VkBuffer dst, const VkBufferCopy *region)
+{
+	VkResult result;
+	struct vktransfer_batch *batch = vktransfer_recording(xfer);
+	if (batch != NULL && batch->ncopies == VKTRANSFER_MAX_COPIES) {
+		uint64_t ticket;
+		result = vktransfer_submit(xfer, &ticket);
+		if (result != VK_SUCCESS)
+			return result;
+		batch = NULL;
+	}
+	if (batch == NULL) {
+		result = vktransfer_begin(xfer, &batch);
+		if (result != VK_SUCCESS)
+			return result;
+	}
+	xfer->vkd->vkCmdCopyBuffer(batch->copy, src, dst, 1, region);
+	/* The same barrier releases and then acquires destination */
+	VkBufferMemoryBarrier *barrier = &batch->barriers[batch->ncopies++];
+	barrier->sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier->pNext = NULL;
+	barrier->srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier->dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+	barrier->srcQueueFamilyIndex = xfer->family;
+	barrier->dstQueueFamilyIndex = xfer->graphic;
+	barrier->buffer = dst;
+	barrier->offset = region->dstOffset;
+	barrier->size = region->size;
+	xfer->nbytes += region->size;
+	return VK_SUCCESS;
+}
+
+VkResult vktransfer_submit(struct vktransfer *xfer, uint64_t *ticket)
+{
+	struct vktransfer_batch *batch = vktransfer_recording(xfer);
+	*ticket = xfer->submitted;
+	if (batch == NULL)
+		return VK_SUCCESS;
+	const int dedicated = vktransfer_dedicated(xfer);
+	const struct vkdispatch *vkd = xfer->vkd;
+	/* Shared queue makes copies visible to everything submitted later */
+	const VkPipelineStageFlags dst_stage =
+		dedicated ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT :
+			    VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+	vkd->vkCmdPipelineBarrier(batch->copy, VK_PIPELINE_STAGE_TRANSFER_BIT,
+				  dst_stage, 0, 0, NULL, batch->ncopies,
+				  batch->barriers, 0, NULL);
+	VkResult result = vkd->vkEndCommandBuffer(batch->copy);
+	if (result != VK_SUCCESS)
+		return result;
+	result = vkd->vkResetFences(xfer->dev, 1, &batch->fence);
+	if (result != VK_SUCCESS)
+		return result;
+	const VkSubmitInfo info = {
+		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+		.pNext = NULL,
+		.waitSemaphoreCount = 0,
+		.pWaitSemaphores = NULL,
+		.pWaitDstStageMask = NULL,
+		.commandBufferCount = 1,
+		.pCommandBuffers = &batch->copy,
+		.signalSemaphoreCount = dedicated ? 1 : 0,
+		.pSignalSemaphores = &batch->copied,
+	};
+	result = vkd->vkQueueSubmit(xfer->queue, 1, &info, batch->fence);
+	if (result != VK_SUCCESS)
+		return result;
+	batch->state = VKTRANSFER_COPYING;
+	batch->ticket = ++xfer->submitted;
+	if (!dedicated)
+		xfer->completed = batch->ticket;
+	*ticket = batch->ticket;
+	return VK_SUCCESS;
+}
+
+/**
+ * Acquires ownership of copied destinations on graphics queue
+ *
+ * Acquisition is submitted once copies are complete, so graphics queue
+ * never waits for transfer queue.
+ * @param xfer Specifies uploads the batch belongs to
+ * @param batch Specifies batch with completed copies
+ * @returns VK_SUCCESS on success, or VkResult error otherwise
+ */
+static VkResult vktransfer_acquire(struct vktransfer *xfer,
+				   struct vktransfer_batch *batch)
+{
+	const VkCommandBufferBeginInfo begin_info = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.pNext = NULL,
+		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+		.pInheritanceInfo = NULL,
+	};
+	const struct vkdispatch *vkd = xfer->vkd;
+	VkResult result = vkd->vkBeginCommandBuffer(batch->acquire,
+						    &begin_info);
+	if (result != VK_SUCCESS)
+		return result;
+	vkd->vkCmdPipelineBarrier(batch->acquire,
+				  VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+				  VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0,
+				  NULL, batch->ncopies, batch->barriers, 0,
+				  NULL);
+	result = vkd->vkEndCommandBuffer(batch->acquire);
+	if (result != VK_SUCCESS)
+		return result;
+	result = vkd->vkResetFences(xfer->dev, 1, &batch->fence);
+	if (result != VK_SUCCESS)
+		return result;
+	const VkPipelineStageFlags wait_stage =
+		VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+	const VkSubmitInfo info = {
+		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+		.pNext = NULL,
+		.waitSemaphoreCount = 1,
+		.pWaitSemaphores = &batch->copied,
+		.pWaitDstStageMask = &wait_stage,
+		.commandBufferCount = 1,
+		.pCommandBuffers = &batch->acquire,
+		.signalSemaphoreCount = 0,
+		.pSignalSemaphores = NULL,
+	};
+	result = vkd->vkQueueSubmit(xfer->graphics_queue, 1, &info,
+				    batch->fence);
+	if (result != VK_SUCCESS)
+		return result;
+	batch->state = VKTRANSFER_ACQUIRING;
+	xfer->completed = batch->ticket;
+	return VK_SUCCESS;
+}
+
+VkResult vktransfer_collect(struct vktransfer *xfer)
+{
+	for (size_t i = 0; i < xfer->count; ++i) {
+		const size_t index = (xfer->head + i) % VKTRANSFER_MAX_BATCHES;
+		struct vktransfer_batch *batch = &xfer->batches[index];
+		if (batch->state == VKTRANSFER_RECORDING)
+			break;
+		if (batch->state == VKTRANSFER_FREE)
+			continue;
+		const VkResult status =
+			xfer->vkd->vkGetFenceStatus(xfer->dev, batch->fence);
+		/* Copies are acquired in order of submission */
+		if (status == VK_NOT_READY &&
+		    batch->state == VKTRANSFER_ACQUIRING)
+			continue;
+		if (status == VK_NOT_READY)
+			break;
+		if (status != VK_SUCCESS)
+			return status;
+		/* Copying batches complete in order of submission */
+		if (batch->state == VKTRANSFER_COPYING)
+			xfer->retired = batch->ticket;
+		if (batch->state == VKTRANSFER_COPYING &&
+		    vktransfer_dedicated(xfer)) {
+			const VkResult result = vktransfer_acquire(xfer, batch);
+			if (result != VK_SUCCESS)
+				return result;
+		} else {
+			batch->state = VKTRANSFER_FREE;
+		}
+	}
+	while (xfer->count > 0 &&
+	       xfer->batches[xfer->head].state == VKTRANSFER_FREE) {
+		xfer->head = (xfer->head + 1) % VKTRANSFER_MAX_BATCHES;
+		xfer->count--;
+	}
+	return VK_SUCCESS;
+}
+
+void vktransfer_destroy(const struct vktransfer *xfer)
+{
+	for (size_t i = 0; i < VKTRANSFER_MAX_BATCHES; ++i) {
+		const struct vktransfer_batch *batch = &xfer->batches[i];
+		vkDestroySemaphore(xfer->dev, batch->copied, xfer->host);
+		vkDestroyFence(xfer->dev, batch->fence, xfer->host);
+	}
+	vkDestroyCommandPool(xfer->dev, xfer->graphics_pool, xfer->host);
+	vkDestroyCommandPool(xfer->dev, xfer->pool, xfer->host);
+}
@@ -0,0 +1,162 @@
+#ifndef RENDERER_VKTRANSFER_H
+#define RENDERER_VKTRANSFER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <renderer/vkdispatch.h>
+#include <vulkan/vulkan_core.h>
+
+/** Maximum number of upload batches submitted at once */
+#define VKTRANSFER_MAX_BATCHES 4
+
+/** Maximum number of copies recorded into one batch */
+#define VKTRANSFER_MAX_COPIES 64
+
+/** Stage of upload batch */
+enum vktransfer_state {
+	/** Batch is not used */
+	VKTRANSFER_FREE = 0,
+	/** Copies are being recorded */
+	VKTRANSFER_RECORDING,
+	/** Copies are submitted to transfer queue */
+	VKTRANSFER_COPYING,
+	/** Ownership of destinations is acquired on graphics queue */
+	VKTRANSFER_ACQUIRING,
+};
+
+/** Copies submitted to transfer queue together */
+struct vktransfer_batch {
+	/** Command buffer recording copies on transfer family */
+	VkCommandBuffer copy;
+	/** Command buffer acquiring destinations on graphics family */
+	VkCommandBuffer acquire;
+	/** Semaphore signaled when copies complete, waited by acquire */
+	VkSemaphore copied;
+	/** Fence signaled when the last submission of batch completes */
+	VkFence fence;
+	/** Stage of batch */
+	enum vktransfer_state state;
+	/** Number identifying batch, assigned on submission */
+	uint64_t ticket;
+	/** Ownership transfers of copy destinations */
+	VkBufferMemoryBarrier barriers[VKTRANSFER_MAX_COPIES];
+	/** Number of copies recorded into batch */
+	uint32_t ncopies;
+};
+
+/**
+ * Uploads running on dedicated transfer queue
+ *
+ * Destinations are released by transfer family and acquired by graphics
+ * family after copies complete, so graphics queue never waits for copies.
+ * If transfer family is graphics family, copies run on graphics queue
+ * without ownership transfers. Uploads are not thread-safe.
+ */
+struct vktransfer {
+	/** Device the uploads run on */
+	VkDevice dev;
+	/** Dispatch table of @a dev */
+	const struct vkdispatch *vkd;
+	/** Host memory allocator of driver, or NULL */
+	const VkAllocationCallbacks *host;
+	/** Queue running copies */
+	VkQueue queue;
+	/** Queue family of @a queue */
+	uint32_t family;
+	/** Queue using uploaded data */
+	VkQueue graphics_queue;
+	/** Queue family of @a graphics_queue */
+	uint32_t graphic;
+	/** Pool of copy command buffers */
+	VkCommandPool pool;
+	/** Pool of acquire command buffers, or VK_NULL_HANDLE if shared */
+	VkCommandPool graphics_pool;
+	/** Ring of batches, the oldest one is at @a head */
+	struct vktransfer_batch batches[VKTRANSFER_MAX_BATCHES];
+	/** Index of the oldest batch in use */
+	size_t head;
+	/** Number of batches in use */
+	size_t count;
+	/** Ticket of the last submitted batch */
+	uint64_t submitted;
+	/** Ticket of the last batch visible to new graphics submissions */
+	uint64_t completed;
+	/** Ticket of the last batch whose copies finished reading sources */
+	uint64_t retired;
+	/** Number of bytes uploaded */
+	uint64_t nbytes;
+};
+
+#ifdef __cplusplus
+/* *INDENT-OFF* */
+extern "C" {
+/* *INDENT-ON* */
+#endif
+
+/**
+ * Initializes uploads
+ * @param xfer Specifies uploads to initialize
+ * @param dev Specifies device to upload on
+ * @param vkd Specifies dispatch table of @a dev
+ * @param family Specifies queue family running copies
+ * @param queue Specifies queue running copies
+ * @param graphic Specifies queue family using uploaded data
+ * @param graphics_queue Specifies queue using uploaded data
+ * @param host Specifies host memory allocator of driver, or NULL
+ * @returns VK_SUCCESS on success, or VkResult error otherwise
+ */
+VkResult vktransfer_init(struct vktransfer *xfer, VkDevice dev,
+			 const struct vkdispatch *vkd, uint32_t family,
+			 VkQueue queue, uint32_t graphic,
+			 VkQueue graphics_queue,
+			 const VkAllocationCallbacks *host);
+
+/**
+ * Records copy of buffer region into current batch
+ *
+ * Full batch is submitted first. If all batches are in use, waits for the
+ * oldest one.
+ * @param xfer Specifies uploads to record copy into
+ * @param src Specifies host-visible staging buffer
+ * @param dst Specifies destination buffer
+ * @param region Specifies region to copy
+ * @returns VK_SUCCESS on success, or VkResult error otherwise
+ */
+VkResult vktransfer_copy_buffer(struct vktransfer *xfer, VkBuffer src,
+				VkBuffer dst, const VkBufferCopy *region);
+
+/**
+ * Submits copies recorded into current batch
+ *
+ * Staging buffers must be kept until @a retired reaches the ticket.
+ * @param xfer Specifies uploads to submit
+ * @param ticket Specifies pointer where ticket of batch must be stored, it
+ *               is the last submitted ticket if nothing is recorded
+ * @returns VK_SUCCESS on success, or VkResult error otherwise
+ */
+VkResult vktransfer_submit(struct vktransfer *xfer, uint64_t *ticket);
+
+/**
+ * Advances submitted batches without blocking
+ *
+ * Acquires destinations of completed copies on graphics queue, so
+ * graphics work submitted afterwards sees uploaded data. Must be called
+ * regularly, e.g. once per frame.
+ * @param xfer Specifies uploads to advance
+ * @returns VK_SUCCESS on success, or VkResult error otherwise
+ */
+VkResult vktransfer_collect(struct vktransfer *xfer);
+
+/**
+ * Destroys uploads, device must be idle
+ * @param xfer Specifies uploads to destroy
+ */
+void vktransfer_destroy(const struct vktransfer *xfer);
+
+#ifdef __cplusplus
+/* *INDENT-OFF* */
+}
+/* *INDENT-ON* */
+#endif
+#endif
@@ -0,0 +1,385 @@
+/**
+ * @file
+ * Test suite for vktransfer
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdint.h>
+
+#include <cgreen/cgreen.h>
+#include <cgreen/mocks.h>
+
+#include <vulkan/vulkan_core.h>
+#include "vktransfer.h"
+
+/** Queue family dedicated to transfers */
+#define TRANSFER_FAMILY 1
+
+/** Queue family supporting graphics */
+#define GRAPHICS_FAMILY 0
+
+/** Queue running copies */
+#define TRANSFER_QUEUE ((VkQueue)1)
+
+/** Queue using uploaded data */
+#define GRAPHICS_QUEUE ((VkQueue)2)
+
+/** The last submission made to any queue */
+static VkSubmitInfo last_submit;
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateCommandPool(
+	VkDevice device, const VkCommandPoolCreateInfo *pCreateInfo,
+	const VkAllocationCallbacks *pAllocator, VkCommandPool *pCommandPool)
+{
+	return (VkResult)mock(device, pCreateInfo, pAllocator, pCommandPool);
+}
+
+VKAPI_ATTR void VKAPI_CALL
+vkDestroyCommandPool(VkDevice device, VkCommandPool commandPool,
+		     const VkAllocationCallbacks *pAllocator)
+{
+	mock(device, commandPool, pAllocator);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkAllocateCommandBuffers(VkDevice device,
+			 const VkCommandBufferAllocateInfo *pAllocateInfo,
+			 VkCommandBuffer *pCommandBuffers)
+{
+	return (VkResult)mock(device, pAllocateInfo, pCommandBuffers);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateFence(
+	VkDevice device, const VkFenceCreateInfo *pCreateInfo,
+	const VkAllocationCallbacks *pAllocator, VkFence *pFence)
+{
+	return (VkResult)mock(device, pCreateInfo, pAllocator, pFence);
+}
+
+VKAPI_ATTR void VKAPI_CALL
+vkDestroyFence(VkDevice device, VkFence fence,
+	       const VkAllocationCallbacks *pAllocator)
+{
+	mock(device, fence, pAllocator);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateSemaphore(
+	VkDevice device, const VkSemaphoreCreateInfo *pCreateInfo,
+	const VkAllocationCallbacks *pAllocator, VkSemaphore *pSemaphore)
+{
+	return (VkResult)mock(device, pCreateInfo, pAllocator, pSemaphore);
+}
+
+VKAPI_ATTR void VKAPI_CALL
+vkDestroySemaphore(VkDevice device, VkSemaphore semaphore,
+		   const VkAllocationCallbacks *pAllocator)
+{
+	mock(device, semaphore, pAllocator);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkBeginCommandBuffer(VkCommandBuffer commandBuffer,
+		     const VkCommandBufferBeginInfo *pBeginInfo)
+{
+	return (VkResult)mock(commandBuffer, pBeginInfo);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkEndCommandBuffer(VkCommandBuffer commandBuffer)
+{
+	return (VkResult)mock(commandBuffer);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdCopyBuffer(VkCommandBuffer commandBuffer,
+					   VkBuffer srcBuffer,
+					   VkBuffer dstBuffer,
+					   uint32_t regionCount,
+					   const VkBufferCopy *pRegions)
+{
+	mock(commandBuffer, srcBuffer, dstBuffer, regionCount, pRegions);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdPipelineBarrier(
+	VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStageMask,
+	VkPipelineStageFlags dstStageMask, VkDependencyFlags dependencyFlags,
+	uint32_t memoryBarrierCount, const VkMemoryBarrier *pMemoryBarriers,
+	uint32_t bufferMemoryBarrierCount,
+	const VkBufferMemoryBarrier *pBufferMemoryBarriers,
+	uint32_t imageMemoryBarrierCount,
+	const VkImageMemoryBarrier *pImageMemoryBarriers)
+{
+	mock(commandBuffer, srcStageMask, dstStageMask, dependencyFlags,
+	     memoryBarrierCount, pMemoryBarriers, bufferMemoryBarrierCount,
+	     pBufferMemoryBarriers, imageMemoryBarrierCount,
+	     pImageMemoryBarriers);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkResetFences(VkDevice device,
+					     uint32_t fenceCount,
+					     const VkFence *pFences)
+{
+	return (VkResult)mock(device, fenceCount, pFences);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkWaitForFences(VkDevice device,
+					       uint32_t fenceCount,
+					       const VkFence *pFences,
+					       VkBool32 waitAll,
+					       uint64_t timeout)
+{
+	return (VkResult)mock(device, fenceCount, pFences, waitAll, timeout);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkGetFenceStatus(VkDevice device, VkFence fence)
+{
+	return (VkResult)mock(device, fence);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkQueueSubmit(VkQueue queue,
+					     uint32_t submitCount,
+					     const VkSubmitInfo *pSubmits,
+					     VkFence fence)
+{
+	last_submit = *pSubmits;
+	return (VkResult)mock(queue, submitCount, pSubmits, fence);
+}
+
+/** Dispatch table calling mocked functions */
+static const struct vkdispatch mocked_dispatch = {
+	.vkBeginCommandBuffer = vkBeginCommandBuffer,
+	.vkEndCommandBuffer = vkEndCommandBuffer,
+	.vkCmdCopyBuffer = vkCmdCopyBuffer,
+	.vkCmdPipelineBarrier = vkCmdPipelineBarrier,
+	.vkResetFences = vkResetFences,
+	.vkGetFenceStatus = vkGetFenceStatus,
+	.vkWaitForFences = vkWaitForFences,
+	.vkQueueSubmit = vkQueueSubmit,
+};
+
+/**
+ * Initializes uploads with all creations succeeding
+ * @param xfer Specifies uploads to initialize
+ * @param family Specifies queue family running copies
+ */
+static void init_uploads(struct vktransfer *xfer, uint32_t family)
+{
+	always_expect(vkCreateCommandPool, will_return(VK_SUCCESS));
+	always_expect(vkAllocateCommandBuffers, will_return(VK_SUCCESS));
+	always_expect(vkCreateFence, will_return(VK_SUCCESS));
+	always_expect(vkCreateSemaphore, will_return(VK_SUCCESS));
+	vktransfer_init(xfer, VK_NULL_HANDLE, &mocked_dispatch, family,
+			TRANSFER_QUEUE, GRAPHICS_FAMILY, GRAPHICS_QUEUE, NULL);
+	always_expect(vkBeginCommandBuffer, will_return(VK_SUCCESS));
+	always_expect(vkEndCommandBuffer, will_return(VK_SUCCESS));
+	always_expect(vkCmdCopyBuffer);
+	always_expect(vkCmdPipelineBarrier);
+	always_expect(vkResetFences, will_return(VK_SUCCESS));
+}
+
+/**
+ * Records single copy and submits it
+ * @param xfer Specifies uploads to submit copy to
+ * @returns ticket of submitted batch
+ */
+static uint64_t submit_copy(struct vktransfer *xfer)
+{
+	const VkBufferCopy region = { .srcOffset = 0, .dstOffset = 0,
+				      .size = 256 };
+	uint64_t ticket = 0;
+	vktransfer_copy_buffer(xfer, (VkBuffer)1, (VkBuffer)2, &region);
+	vktransfer_submit(xfer, &ticket);
+	return ticket;
+}
+
+Ensure(init_creates_semaphores_for_dedicated_family)
+{
+	struct vktransfer xfer;
+	const VkAllocationCallbacks host = { 0 };
+	expect(vkCreateCommandPool, will_return(VK_SUCCESS),
+	       when(pAllocator, is_equal_to(&host)));
+	expect(vkCreateCommandPool, will_return(VK_SUCCESS),
+	       when(pAllocator, is_equal_to(&host)));
+	always_expect(vkAllocateCommandBuffers, will_return(VK_SUCCESS));
+	always_expect(vkCreateFence, will_return(VK_SUCCESS));
+	for (int i = 0; i < VKTRANSFER_MAX_BATCHES; ++i) {
+		expect(vkCreateSemaphore, will_return(VK_SUCCESS),
+		       when(pAllocator, is_equal_to(&host)));
+	}
+	VkResult result = vktransfer_init(&xfer, VK_NULL_HANDLE,
+					  &mocked_dispatch, TRANSFER_FAMILY,
+					  TRANSFER_QUEUE,
+					  GRAPHICS_FAMILY, GRAPHICS_QUEUE,
+					  &host);
+	assert_that(result, is_equal_to(VK_SUCCESS));
+}
+
+Ensure(init_shares_graphics_family_without_semaphores)
+{
+	struct vktransfer xfer;
+	expect(vkCreateCommandPool, will_return(VK_SUCCESS));
+	always_expect(vkAllocateCommandBuffers, will_return(VK_SUCCESS));
+	always_expect(vkCreateFence, will_return(VK_SUCCESS));
+	never_expect(vkCreateSemaphore);
+	VkResult result = vktransfer_init(&xfer, VK_NULL_HANDLE,
+					  &mocked_dispatch, GRAPHICS_FAMILY,
+					  GRAPHICS_QUEUE,
+					  GRAPHICS_FAMILY, GRAPHICS_QUEUE,
+					  NULL);
+	assert_that(result, is_equal_to(VK_SUCCESS));
+	assert_that(xfer.graphics_pool, is_equal_to(VK_NULL_HANDLE));
+}
+
+Ensure(init_returns_error_on_pool_fail)
+{
+	struct vktransfer xfer;
+	expect(vkCreateCommandPool, will_return(VK_ERROR_OUT_OF_HOST_MEMORY));
+	never_expect(vkAllocateCommandBuffers);
+	VkResult result = vktransfer_init(&xfer, VK_NULL_HANDLE,
+					  &mocked_dispatch, TRANSFER_FAMILY,
+					  TRANSFER_QUEUE,
+					  GRAPHICS_FAMILY, GRAPHICS_QUEUE,
+					  NULL);
+	assert_that(result, is_equal_to(VK_ERROR_OUT_OF_HOST_MEMORY));
+}
+
+Ensure(submit_releases_ownership_on_transfer_queue)
+{
+	struct vktransfer xfer;
+	init_uploads(&xfer, TRANSFER_FAMILY);
+	expect(vkQueueSubmit, when(queue, is_equal_to(TRANSFER_QUEUE)),
+	       will_return(VK_SUCCESS));
+	const uint64_t ticket = submit_copy(&xfer);
+	assert_that(ticket, is_equal_to(1));
+	assert_that(last_submit.signalSemaphoreCount, is_equal_to(1));
+	assert_that(xfer.batches[0].barriers[0].srcQueueFamilyIndex,
+		    is_equal_to(TRANSFER_FAMILY));
+	assert_that(xfer.batches[0].barriers[0].dstQueueFamilyIndex,
+		    is_equal_to(GRAPHICS_FAMILY));
+	assert_that(xfer.completed, is_equal_to(0));
+	assert_that(xfer.nbytes, is_equal_to(256));
+}
+
+Ensure(submit_makes_copies_visible_at_once_on_shared_queue)
+{
+	struct vktransfer xfer;
+	init_uploads(&xfer, GRAPHICS_FAMILY);
+	expect(vkQueueSubmit, will_return(VK_SUCCESS));
+	const uint64_t ticket = submit_copy(&xfer);
+	assert_that(last_submit.signalSemaphoreCount, is_equal_to(0));
+	assert_that(xfer.completed, is_equal_to(ticket));
+}
+
+Ensure(submit_without_copies_returns_last_ticket)
+{
+	struct vktransfer xfer;
+	uint64_t ticket = 42;
+	init_uploads(&xfer, TRANSFER_FAMILY);
+	never_expect(vkQueueSubmit);
+	VkResult result = vktransfer_submit(&xfer, &ticket);
+	assert_that(result, is_equal_to(VK_SUCCESS));
+	assert_that(ticket, is_equal_to(0));
+}
+
+Ensure(collect_acquires_ownership_after_copies_complete)
+{
+	struct vktransfer xfer;
+	init_uploads(&xfer, TRANSFER_FAMILY);
+	expect(vkQueueSubmit, will_return(VK_SUCCESS));
+	const uint64_t ticket = submit_copy(&xfer);
+	expect(vkGetFenceStatus, will_return(VK_SUCCESS));
+	expect(vkQueueSubmit, when(queue, is_equal_to(GRAPHICS_QUEUE)),
+	       will_return(VK_SUCCESS));
+	VkResult result = vktransfer_collect(&xfer);
+	assert_that(result, is_equal_to(VK_SUCCESS));
+	assert_that(last_submit.waitSemaphoreCount, is_equal_to(1));
+	assert_that(xfer.completed, is_equal_to(ticket));
+	assert_that(xfer.retired, is_equal_to(ticket));
+	assert_that(xfer.count, is_equal_to(1));
+	expect(vkGetFenceStatus, will_return(VK_SUCCESS));
+	vktransfer_collect(&xfer);
+	assert_that(xfer.count, is_equal_to(0));
+}
+
+Ensure(collect_keeps_batch_while_copies_pending)
+{
+	struct vktransfer xfer;
+	init_uploads(&xfer, TRANSFER_FAMILY);
+	expect(vkQueueSubmit, will_return(VK_SUCCESS));
+	submit_copy(&xfer);
+	expect(vkGetFenceStatus, will_return(VK_NOT_READY));
+	VkResult result = vktransfer_collect(&xfer);
+	assert_that(result, is_equal_to(VK_SUCCESS));
+	assert_that(xfer.completed, is_equal_to(0));
+	assert_that(xfer.retired, is_equal_to(0));
+	assert_that(xfer.count, is_equal_to(1));
+}
+
+Ensure(copy_waits_for_oldest_batch_when_all_are_used)
+{
+	struct vktransfer xfer;
+	init_uploads(&xfer, GRAPHICS_FAMILY);
+	always_expect(vkQueueSubmit, will_return(VK_SUCCESS));
+	for (int i = 0; i < VKTRANSFER_MAX_BATCHES; ++i) {
+		submit_copy(&xfer);
+	}
+	expect(vkWaitForFences, will_return(VK_SUCCESS),
+	       when(pFences, is_equal_to(&xfer.batches[0].fence)));
+	expect(vkGetFenceStatus, will_return(VK_SUCCESS));
+	expect(vkGetFenceStatus, will_return(VK_NOT_READY));
+	const uint64_t ticket = submit_copy(&xfer);
+	assert_that(ticket, is_equal_to(VKTRANSFER_MAX_BATCHES + 1));
+	assert_that(xfer.head, is_equal_to(1));
+}
+
+Ensure(copy_submits_full_batch)
+{
+	struct vktransfer xfer;
+	const VkBufferCopy region = { .size = 16 };
+	init_uploads(&xfer, TRANSFER_FAMILY);
+	expect(vkQueueSubmit, will_return(VK_SUCCESS));
+	for (int i = 0; i <= VKTRANSFER_MAX_COPIES; ++i) {
+		vktransfer_copy_buffer(&xfer, (VkBuffer)1, (VkBuffer)2,
+				       &region);
+	}
+	assert_that(xfer.submitted, is_equal_to(1));
+	assert_that(xfer.count, is_equal_to(2));
+	assert_that(xfer.batches[1].ncopies, is_equal_to(1));
+}
+
+Ensure(destroy_destroys_all_resources)
+{
+	struct vktransfer xfer;
+	init_uploads(&xfer, TRANSFER_FAMILY);
+	for (int i = 0; i < VKTRANSFER_MAX_BATCHES; ++i) {
+		expect(vkDestroySemaphore);
+		expect(vkDestroyFence);
+	}
+	expect(vkDestroyCommandPool);
+	expect(vkDestroyCommandPool);
+	vktransfer_destroy(&xfer);
+}
+
+int main(int argc, char **argv)
+{
+	(void)(argc);
+	(void)(argv);
+	TestSuite *suite = create_named_test_suite("VKTransfer");
+	add_test(suite, init_creates_semaphores_for_dedicated_family);
+	add_test(suite, init_shares_graphics_family_without_semaphores);
+	add_test(suite, init_returns_error_on_pool_fail);
+	add_test(suite, submit_releases_ownership_on_transfer_queue);
+	add_test(suite, submit_makes_copies_visible_at_once_on_shared_queue);
+	add_test(suite, submit_without_copies_returns_last_ticket);
+	add_test(suite, collect_acquires_ownership_after_copies_complete);
+	add_test(suite, collect_keeps_batch_while_copies_pending);
+	add_test(suite, copy_waits_for_oldest_batch_when_all_are_used);
+	add_test(suite, copy_submits_full_batch);
+	add_test(suite, destroy_destroys_all_resources);
+	TestReporter *reporter = create_text_reporter();
+	int exit_code = run_test_suite(suite, reporter);
+	destroy_reporter(reporter);
+	destroy_test_suite(suite);
+	return exit_code;
+}
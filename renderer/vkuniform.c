@@ -0,0 +1,237 @@
+/**
+ * @file
+ * Ring of per-frame uniform data implementation
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "vkmemory.h"
+#include "vkuniform.h"
+#include <vulkan/vulkan_core.h>
+
+/**
+ * Creates host visible uniform buffer
+ * @param ring Specifies ring to create buffer of
+ * @param mem Specifies allocator of buffer memory
+ * @returns VK_SUCCESS on success, or VkResult error otherwise
+ */
+static VkResult vkuniform_create_buffer(struct vkuniform *ring,
+					struct vkmemory *mem)
+{
+	/* Data at the end of ring is bound with full range too */
+	const VkBufferCreateInfo info = {
+		.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+		.pNext = NULL,
+		.flags = 0,
+		.size = ring->size + ring->range,
+		.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+		.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+		.queueFamilyIndexCount = 0,
+		.pQueueFamilyIndices = NULL,
+	};
+	VkResult result = vkCreateBuffer(ring->dev, &info, ring->host,
+					 &ring->buffer);
+	if (result != VK_SUCCESS)
+		return result;
+	/* Coherent memory needs no flushes, device local one is read faster */
+	result = vkmemory_alloc_buffer(mem, ring->buffer,
+				       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+				       VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				       &ring->alloc);
+	if (result != VK_SUCCESS) {
+		vkDestroyBuffer(ring->dev, ring->buffer, ring->host);
+		return result;
+	}
+	ring->data = ring->alloc.mapped;
+	return VK_SUCCESS;
+}
+
+/**
+ * Creates descriptor set binding buffer of ring with dynamic offset
+ * @param ring Specifies ring to create descriptor set of
+ * @returns VK_SUCCESS on success, or VkResult error otherwise
+ */
+static VkResult vkuniform_create_set(struct vkuniform *ring)
+{
+	const VkDescriptorSetLayoutBinding binding = {
+		.binding = 0,
+		.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+		.descriptorCount = 1,
+		.stageFlags = VK_SHADER_STAGE_ALL,
+		.pImmutableSamplers = NULL,
+	};
+	const VkDescriptorSetLayoutCreateInfo layout_info = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+		.pNext = NULL,
+		.flags = 0,
+		.bindingCount = 1,
+		.pBindings = &binding,
+	};
+	VkResult result = vkCreateDescriptorSetLayout(
+		ring->dev, &layout_info, ring->host, &ring->layout);
+	if (result != VK_SUCCESS)
+		return result;
+	const VkDescriptorPoolSize pool_size = {
+		.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+		.descriptorCount = 1,
+	};
+	const VkDescriptorPoolCreateInfo pool_info = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+		.pNext = NULL,
+		.flags = 0,
+		.maxSets = 1,
+		.poolSizeCount = 1,
+		.pPoolSizes = &pool_size,
+	};
+	result = vkCreateDescriptorPool(ring->dev, &pool_info, ring->host,
+					&ring->pool);
+	if (result != VK_SUCCESS)
+		return result;
+	const VkDescriptorSetAllocateInfo set_info = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+		.pNext = NULL,
+		.descriptorPool = ring->pool,
+		.descriptorSetCount = 1,
+		.pSetLayouts = &ring->layout,
+	};
+	result = vkAllocateDescriptorSets(ring->dev, &set_info, &ring->set);
+	if (result != VK_SUCCESS)
+		return result;
+	const VkDescriptorBufferInfo buffer_info = {
+		.buffer = ring->buffer,
+		.offset = 0,
+		.range = ring->range,
+	};
+	const VkWriteDescriptorSet write = {
+		.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+		.pNext = NULL,
+		.dstSet = ring->set,
+		.dstBinding = 0,
+		.dstArrayElement = 0,
+		.descriptorCount = 1,
+		.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+		.pImageInfo = NULL,
+		.pBufferInfo = &buffer_info,
+		.pTexelBufferView = NULL,
+	};
+	vkUpdateDescriptorSets(ring->dev, 1, &write, 0, NULL);
+	return VK_SUCCESS;
+}
+
+VkResult vkuniform_init(struct vkuniform *ring, struct vkmemory *mem,
+			VkPhysicalDevice phy, VkDeviceSize size)
+{
+	VkPhysicalDeviceProperties props;
+	vkGetPhysicalDeviceProperties(phy, &props);
+	ring->dev = mem->dev;
+	ring->host = mem->host;
+	ring->buffer = VK_NULL_HANDLE;
+	ring->data = NULL;
+	ring->size = size;
+	ring->alignment = props.limits.minUniformBufferOffsetAlignment;
+	if (ring->alignment == 0)
+		ring->alignment = 1;
+	ring->range = props.limits.maxUniformBufferRange;
+	if (ring->range > VKUNIFORM_MAX_RANGE)
+		ring->range = VKUNIFORM_MAX_RANGE;
+	ring->layout = VK_NULL_HANDLE;
+	ring->pool = VK_NULL_HANDLE;
+	ring->set = VK_NULL_HANDLE;
+	ring->head = 0;
+	ring->tail = 0;
+	ring->used = 0;
+	ring->frame_bytes = 0;
+	ring->first = 0;
+	ring->count = 0;
+	ring->nbytes = 0;
+	ring->nfull = 0;
+	VkResult result = vkuniform_create_buffer(ring, mem);
+	if (result != VK_SUCCESS)
+		return result;
+	return vkuniform_create_set(ring);
+}
+
+void *vkuniform_alloc(struct vkuniform *ring, VkDeviceSize size,
+		      uint32_t *offset)
+{
+	if (size > ring->range)
+		return NULL;
+	if (ring->used == 0) {
+		ring->head = 0;
+		ring->tail = 0;
+	}
+	VkDeviceSize start = (ring->head + ring->alignment - 1) /
+			     ring->alignment * ring->alignment;
+	VkDeviceSize taken = start - ring->head;
+	if (ring->head > ring->tail || ring->used == 0) {
+		/* Data never wraps, so it is bound as one range */
+		if (start + size > ring->size) {
+			if (size > ring->tail) {
+				ring->nfull++;
+				return NULL;
+			}
+			taken = ring->size - ring->head;
+			start = 0;
+		}
+	} else if (start + size > ring->tail) {
+		ring->nfull++;
+		return NULL;
+	}
+	taken += size;
+	ring->head = start + size;
+	ring->used += taken;
+	ring->frame_bytes += taken;
+	ring->nbytes += size;
+	*offset = (uint32_t)start;
+	return ring->data + start;
+}
+
+void vkuniform_submit(struct vkuniform *ring, uint64_t frame)
+{
+	if (ring->frame_bytes == 0)
+		return;
+	struct vkuniform_segment *segment;
+	if (ring->count < VKUNIFORM_MAX_FRAMES) {
+		const uint32_t last =
+			(ring->first + ring->count) % VKUNIFORM_MAX_FRAMES;
+		segment = &ring->segments[last];
+		segment->nbytes = 0;
+		ring->count++;
+	} else {
+		/* Later frame completes after earlier ones, so they merge */
+		const uint32_t last =
+			(ring->first + ring->count - 1) % VKUNIFORM_MAX_FRAMES;
+		segment = &ring->segments[last];
+	}
+	segment->frame = frame;
+	segment->end = ring->head;
+	segment->nbytes += ring->frame_bytes;
+	ring->frame_bytes = 0;
+}
+
+void vkuniform_collect(struct vkuniform *ring, uint64_t completed)
+{
+	while (ring->count > 0) {
+		const struct vkuniform_segment *segment =
+			&ring->segments[ring->first];
+		if (segment->frame > completed)
+			break;
+		ring->tail = segment->end;
+		ring->used -= segment->nbytes;
+		ring->first = (ring->first + 1) % VKUNIFORM_MAX_FRAMES;
+		ring->count--;
+	}
+}
+
+void vkuniform_destroy(struct vkuniform *ring, struct vkmemory *mem)
+{
+	vkDestroyDescriptorPool(ring->dev, ring->pool, ring->host);
+	vkDestroyDescriptorSetLayout(ring->dev, ring->layout, ring->host);
+	vkDestroyBuffer(ring->dev, ring->buffer, ring->host);
+	vkmemory_free(mem, &ring->alloc);
+}
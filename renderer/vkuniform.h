@@ -0,0 +1,128 @@
+#ifndef RENDERER_VKUNIFORM_H
+#define RENDERER_VKUNIFORM_H
+
+#include <stdint.h>
+
+#include <renderer/vkmemory.h>
+#include <vulkan/vulkan_core.h>
+
+/** Maximum number of frames having data in ring at once */
+#define VKUNIFORM_MAX_FRAMES 8
+
+/** Maximum size of data bound at one dynamic offset */
+#define VKUNIFORM_MAX_RANGE 65536
+
+/** Data written into ring for one frame */
+struct vkuniform_segment {
+	/** Number of frame using data */
+	uint64_t frame;
+	/** Offset following the last byte of data */
+	VkDeviceSize end;
+	/** Number of bytes of ring taken, including padding */
+	VkDeviceSize nbytes;
+};
+
+/**
+ * Ring of per-frame uniform data
+ *
+ * Buffer is host visible and persistently mapped, so frames write constants
+ * directly and bind them with dynamic offsets of a single descriptor set.
+ * Data of frame is reclaimed once frame completes. Ring is not thread-safe.
+ */
+struct vkuniform {
+	/** Device the ring is created on */
+	VkDevice dev;
+	/** Host memory allocator of driver, or NULL */
+	const VkAllocationCallbacks *host;
+	/** Uniform buffer */
+	VkBuffer buffer;
+	/** Memory of @a buffer */
+	struct vkmemory_alloc alloc;
+	/** Host address of @a buffer */
+	char *data;
+	/** Size of ring, buffer is larger by @a range */
+	VkDeviceSize size;
+	/** Alignment of dynamic offsets */
+	VkDeviceSize alignment;
+	/** Size of data bound at one dynamic offset */
+	VkDeviceSize range;
+	/** Layout of @a set, one dynamic uniform buffer at binding 0 */
+	VkDescriptorSetLayout layout;
+	/** Pool @a set is allocated from */
+	VkDescriptorPool pool;
+	/** Descriptor set binding @a buffer with dynamic offset */
+	VkDescriptorSet set;
+	/** Offset the next data is written at */
+	VkDeviceSize head;
+	/** Offset of the oldest data in use */
+	VkDeviceSize tail;
+	/** Number of bytes of ring in use, including padding */
+	VkDeviceSize used;
+	/** Number of bytes written for frame not submitted yet */
+	VkDeviceSize frame_bytes;
+	/** Data of submitted frames, oldest first */
+	struct vkuniform_segment segments[VKUNIFORM_MAX_FRAMES];
+	/** Index of the oldest segment */
+	uint32_t first;
+	/** Number of segments */
+	uint32_t count;
+	/** Total number of bytes written */
+	uint64_t nbytes;
+	/** Number of allocations failed because ring was full */
+	uint64_t nfull;
+};
+
+#ifdef __cplusplus
+/* *INDENT-OFF* */
+extern "C" {
+/* *INDENT-ON* */
+#endif
+
+/**
+ * Initializes ring
+ * @param ring Specifies ring to initialize
+ * @param mem Specifies allocator of buffer memory
+ * @param phy Specifies physical device of allocator's device
+ * @param size Specifies size of ring
+ * @returns VK_SUCCESS on success, or VkResult error otherwise
+ */
+VkResult vkuniform_init(struct vkuniform *ring, struct vkmemory *mem,
+			VkPhysicalDevice phy, VkDeviceSize size);
+
+/**
+ * Allocates data for frame being recorded
+ * @param ring Specifies ring to allocate from
+ * @param size Specifies size of data, at most @a range of ring
+ * @param offset Specifies pointer where dynamic offset must be stored
+ * @returns host address to write data to, or NULL if ring is full
+ */
+void *vkuniform_alloc(struct vkuniform *ring, VkDeviceSize size,
+		      uint32_t *offset);
+
+/**
+ * Assigns data allocated since previous submission to submitted frame
+ * @param ring Specifies ring the data is allocated from
+ * @param frame Specifies number of submitted frame
+ */
+void vkuniform_submit(struct vkuniform *ring, uint64_t frame);
+
+/**
+ * Reclaims data of completed frames
+ * @param ring Specifies ring to reclaim data of
+ * @param completed Specifies number of the last completed frame
+ */
+void vkuniform_collect(struct vkuniform *ring, uint64_t completed);
+
+/**
+ * Destroys ring, frames using it must be complete
+ * @param ring Specifies ring to destroy
+ * @param mem Specifies allocator of buffer memory
+ */
+void vkuniform_destroy(struct vkuniform *ring, struct vkmemory *mem);
+
+#ifdef __cplusplus
+/* *INDENT-OFF* */
+}
+/* *INDENT-ON* */
+#endif
+#endif
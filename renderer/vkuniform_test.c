@@ -0,0 +1,357 @@
+/**
+ * @file
+ * Test suite for vkuniform
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdint.h>
+
+#include <cgreen/cgreen.h>
+#include <cgreen/mocks.h>
+
+#include <vulkan/vulkan_core.h>
+#include "vkmemory.h"
+#include "vkuniform.h"
+
+/** Alignment of dynamic offsets reported by device */
+#define ALIGNMENT 256
+
+/** Host memory the uniform buffer is mapped to */
+static char mapped_memory[4096];
+
+/** Size of the last created buffer */
+static VkDeviceSize buffer_size;
+
+/** Type of the last written descriptor */
+static VkDescriptorType descriptor_type;
+
+/** Range of the last written descriptor */
+static VkDeviceSize descriptor_range;
+
+/** Maximum range of uniform buffer reported by device */
+static uint32_t max_range = 16384;
+
+VKAPI_ATTR void VKAPI_CALL
+vkGetPhysicalDeviceProperties(VkPhysicalDevice physicalDevice,
+			      VkPhysicalDeviceProperties *pProperties)
+{
+	(void)(physicalDevice);
+	pProperties->limits.minUniformBufferOffsetAlignment = ALIGNMENT;
+	pProperties->limits.maxUniformBufferRange = max_range;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateBuffer(
+	VkDevice device, const VkBufferCreateInfo *pCreateInfo,
+	const VkAllocationCallbacks *pAllocator, VkBuffer *pBuffer)
+{
+	buffer_size = pCreateInfo->size;
+	return (VkResult)mock(device, pCreateInfo, pAllocator, pBuffer);
+}
+
+VKAPI_ATTR void VKAPI_CALL
+vkDestroyBuffer(VkDevice device, VkBuffer buffer,
+		const VkAllocationCallbacks *pAllocator)
+{
+	mock(device, buffer, pAllocator);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateDescriptorSetLayout(
+	VkDevice device, const VkDescriptorSetLayoutCreateInfo *pCreateInfo,
+	const VkAllocationCallbacks *pAllocator,
+	VkDescriptorSetLayout *pSetLayout)
+{
+	return (VkResult)mock(device, pCreateInfo, pAllocator, pSetLayout);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyDescriptorSetLayout(
+	VkDevice device, VkDescriptorSetLayout descriptorSetLayout,
+	const VkAllocationCallbacks *pAllocator)
+{
+	mock(device, descriptorSetLayout, pAllocator);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateDescriptorPool(
+	VkDevice device, const VkDescriptorPoolCreateInfo *pCreateInfo,
+	const VkAllocationCallbacks *pAllocator,
+	VkDescriptorPool *pDescriptorPool)
+{
+	return (VkResult)mock(device, pCreateInfo, pAllocator,
+			      pDescriptorPool);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyDescriptorPool(
+	VkDevice device, VkDescriptorPool descriptorPool,
+	const VkAllocationCallbacks *pAllocator)
+{
+	mock(device, descriptorPool, pAllocator);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkAllocateDescriptorSets(
+	VkDevice device, const VkDescriptorSetAllocateInfo *pAllocateInfo,
+	VkDescriptorSet *pDescriptorSets)
+{
+	return (VkResult)mock(device, pAllocateInfo, pDescriptorSets);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkUpdateDescriptorSets(
+	VkDevice device, uint32_t descriptorWriteCount,
+	const VkWriteDescriptorSet *pDescriptorWrites,
+	uint32_t descriptorCopyCount,
+	const VkCopyDescriptorSet *pDescriptorCopies)
+{
+	descriptor_type = pDescriptorWrites->descriptorType;
+	descriptor_range = pDescriptorWrites->pBufferInfo->range;
+	mock(device, descriptorWriteCount, pDescriptorWrites,
+	     descriptorCopyCount, pDescriptorCopies);
+}
+
+VkResult vkmemory_alloc_buffer(struct vkmemory *mem, VkBuffer buffer,
+			       VkMemoryPropertyFlags required,
+			       VkMemoryPropertyFlags preferred,
+			       struct vkmemory_alloc *alloc)
+{
+	alloc->mapped = mapped_memory;
+	return (VkResult)mock(mem, buffer, required, preferred, alloc);
+}
+
+void vkmemory_free(struct vkmemory *mem, const struct vkmemory_alloc *alloc)
+{
+	mock(mem, alloc);
+}
+
+/**
+ * Initializes ring expecting all resources to be created
+ * @param ring Specifies ring to initialize
+ * @param size Specifies size of ring
+ */
+static void init_ring(struct vkuniform *ring, VkDeviceSize size)
+{
+	struct vkmemory mem = { .dev = VK_NULL_HANDLE };
+	expect(vkCreateBuffer, will_return(VK_SUCCESS));
+	expect(vkmemory_alloc_buffer, will_return(VK_SUCCESS));
+	expect(vkCreateDescriptorSetLayout, will_return(VK_SUCCESS));
+	expect(vkCreateDescriptorPool, will_return(VK_SUCCESS));
+	expect(vkAllocateDescriptorSets, will_return(VK_SUCCESS));
+	expect(vkUpdateDescriptorSets);
+	vkuniform_init(ring, &mem, VK_NULL_HANDLE, size);
+}
+
+Ensure(init_creates_buffer_larger_by_range)
+{
+	struct vkuniform ring;
+	init_ring(&ring, 4096);
+	assert_that(ring.alignment, is_equal_to(ALIGNMENT));
+	assert_that(ring.range, is_equal_to(16384));
+	assert_that(buffer_size, is_equal_to(4096 + 16384));
+}
+
+Ensure(init_limits_range)
+{
+	struct vkuniform ring;
+	max_range = UINT32_MAX;
+	init_ring(&ring, 4096);
+	max_range = 16384;
+	assert_that(ring.range, is_equal_to(VKUNIFORM_MAX_RANGE));
+}
+
+Ensure(init_uses_host_allocator_of_memory)
+{
+	struct vkuniform ring;
+	const VkAllocationCallbacks host = { 0 };
+	struct vkmemory mem = { .dev = VK_NULL_HANDLE, .host = &host };
+	expect(vkCreateBuffer, will_return(VK_SUCCESS),
+	       when(pAllocator, is_equal_to(&host)));
+	expect(vkmemory_alloc_buffer, will_return(VK_SUCCESS));
+	expect(vkCreateDescriptorSetLayout, will_return(VK_SUCCESS),
+	       when(pAllocator, is_equal_to(&host)));
+	expect(vkCreateDescriptorPool, will_return(VK_SUCCESS),
+	       when(pAllocator, is_equal_to(&host)));
+	expect(vkAllocateDescriptorSets, will_return(VK_SUCCESS));
+	expect(vkUpdateDescriptorSets);
+	vkuniform_init(&ring, &mem, VK_NULL_HANDLE, 4096);
+	assert_that(ring.host, is_equal_to(&host));
+}
+
+Ensure(init_maps_coherent_memory)
+{
+	struct vkuniform ring;
+	struct vkmemory mem = { .dev = VK_NULL_HANDLE };
+	const VkMemoryPropertyFlags required =
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+		VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	expect(vkCreateBuffer, will_return(VK_SUCCESS));
+	expect(vkmemory_alloc_buffer, when(required, is_equal_to(required)),
+	       will_return(VK_SUCCESS));
+	expect(vkCreateDescriptorSetLayout, will_return(VK_SUCCESS));
+	expect(vkCreateDescriptorPool, will_return(VK_SUCCESS));
+	expect(vkAllocateDescriptorSets, will_return(VK_SUCCESS));
+	expect(vkUpdateDescriptorSets);
+	VkResult result = vkuniform_init(&ring, &mem, VK_NULL_HANDLE, 4096);
+	assert_that(result, is_equal_to(VK_SUCCESS));
+	assert_that(ring.data, is_equal_to(mapped_memory));
+}
+
+Ensure(init_binds_buffer_with_dynamic_offset)
+{
+	struct vkuniform ring;
+	init_ring(&ring, 4096);
+	assert_that(descriptor_type,
+		    is_equal_to(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC));
+	assert_that(descriptor_range, is_equal_to(ring.range));
+}
+
+Ensure(init_destroys_buffer_if_memory_fails)
+{
+	struct vkuniform ring;
+	struct vkmemory mem = { .dev = VK_NULL_HANDLE };
+	expect(vkCreateBuffer, will_return(VK_SUCCESS));
+	expect(vkmemory_alloc_buffer,
+	       will_return(VK_ERROR_FEATURE_NOT_PRESENT));
+	expect(vkDestroyBuffer);
+	VkResult result = vkuniform_init(&ring, &mem, VK_NULL_HANDLE, 4096);
+	assert_that(result, is_equal_to(VK_ERROR_FEATURE_NOT_PRESENT));
+}
+
+Ensure(alloc_aligns_offsets)
+{
+	struct vkuniform ring;
+	uint32_t first;
+	uint32_t second;
+	init_ring(&ring, 4096);
+	vkuniform_alloc(&ring, 100, &first);
+	char *data = vkuniform_alloc(&ring, 100, &second);
+	assert_that(first, is_equal_to(0));
+	assert_that(second, is_equal_to(ALIGNMENT));
+	assert_that(data, is_equal_to(mapped_memory + ALIGNMENT));
+}
+
+Ensure(alloc_fails_if_data_exceeds_range)
+{
+	struct vkuniform ring;
+	uint32_t offset;
+	init_ring(&ring, 65536);
+	void *data = vkuniform_alloc(&ring, ring.range + 1, &offset);
+	assert_that(data, is_null);
+}
+
+Ensure(alloc_fails_if_ring_is_full)
+{
+	struct vkuniform ring;
+	uint32_t offset;
+	init_ring(&ring, 1024);
+	vkuniform_alloc(&ring, 512, &offset);
+	vkuniform_alloc(&ring, 512, &offset);
+	void *data = vkuniform_alloc(&ring, 16, &offset);
+	assert_that(data, is_null);
+	assert_that(ring.nfull, is_equal_to(1));
+}
+
+Ensure(alloc_wraps_to_reclaimed_data)
+{
+	struct vkuniform ring;
+	uint32_t offset;
+	init_ring(&ring, 1024);
+	vkuniform_alloc(&ring, 512, &offset);
+	vkuniform_submit(&ring, 1);
+	vkuniform_alloc(&ring, 256, &offset);
+	vkuniform_submit(&ring, 2);
+	vkuniform_collect(&ring, 1);
+	void *data = vkuniform_alloc(&ring, 512, &offset);
+	assert_that(data, is_equal_to(mapped_memory));
+	assert_that(offset, is_equal_to(0));
+	assert_that(ring.used, is_equal_to(1024));
+}
+
+Ensure(alloc_never_overwrites_data_of_pending_frame)
+{
+	struct vkuniform ring;
+	uint32_t offset;
+	init_ring(&ring, 1024);
+	vkuniform_alloc(&ring, 512, &offset);
+	vkuniform_submit(&ring, 1);
+	vkuniform_alloc(&ring, 256, &offset);
+	vkuniform_submit(&ring, 2);
+	vkuniform_collect(&ring, 1);
+	vkuniform_alloc(&ring, 256, &offset);
+	void *data = vkuniform_alloc(&ring, 513, &offset);
+	assert_that(data, is_null);
+}
+
+Ensure(collect_keeps_data_of_pending_frames)
+{
+	struct vkuniform ring;
+	uint32_t offset;
+	init_ring(&ring, 1024);
+	vkuniform_alloc(&ring, 1024, &offset);
+	vkuniform_submit(&ring, 1);
+	vkuniform_collect(&ring, 0);
+	assert_that(vkuniform_alloc(&ring, 16, &offset), is_null);
+	vkuniform_collect(&ring, 1);
+	assert_that(vkuniform_alloc(&ring, 16, &offset), is_non_null);
+	assert_that(offset, is_equal_to(0));
+}
+
+Ensure(submit_without_data_makes_no_segment)
+{
+	struct vkuniform ring;
+	init_ring(&ring, 1024);
+	vkuniform_submit(&ring, 1);
+	assert_that(ring.count, is_equal_to(0));
+}
+
+Ensure(submit_merges_frames_if_segments_are_exhausted)
+{
+	struct vkuniform ring;
+	uint32_t offset;
+	init_ring(&ring, 4096);
+	for (uint64_t frame = 1; frame <= VKUNIFORM_MAX_FRAMES + 1; ++frame) {
+		vkuniform_alloc(&ring, 16, &offset);
+		vkuniform_submit(&ring, frame);
+	}
+	assert_that(ring.count, is_equal_to(VKUNIFORM_MAX_FRAMES));
+	vkuniform_collect(&ring, VKUNIFORM_MAX_FRAMES);
+	assert_that(ring.count, is_equal_to(1));
+	vkuniform_collect(&ring, VKUNIFORM_MAX_FRAMES + 1);
+	assert_that(ring.count, is_equal_to(0));
+	assert_that(ring.used, is_equal_to(0));
+}
+
+Ensure(destroy_releases_resources)
+{
+	struct vkuniform ring;
+	init_ring(&ring, 4096);
+	expect(vkDestroyDescriptorPool);
+	expect(vkDestroyDescriptorSetLayout);
+	expect(vkDestroyBuffer);
+	expect(vkmemory_free, when(alloc, is_equal_to(&ring.alloc)));
+	vkuniform_destroy(&ring, NULL);
+}
+
+int main(int argc, char **argv)
+{
+	(void)(argc);
+	(void)(argv);
+	TestSuite *suite = create_named_test_suite("VKUniform");
+	add_test(suite, init_creates_buffer_larger_by_range);
+	add_test(suite, init_limits_range);
+	add_test(suite, init_uses_host_allocator_of_memory);
+	add_test(suite, init_maps_coherent_memory);
+	add_test(suite, init_binds_buffer_with_dynamic_offset);
+	add_test(suite, init_destroys_buffer_if_memory_fails);
+	add_test(suite, alloc_aligns_offsets);
+	add_test(suite, alloc_fails_if_data_exceeds_range);
+	add_test(suite, alloc_fails_if_ring_is_full);
+	add_test(suite, alloc_wraps_to_reclaimed_data);
+	add_test(suite, alloc_never_overwrites_data_of_pending_frame);
+	add_test(suite, collect_keeps_data_of_pending_frames);
+	add_test(suite, submit_without_data_makes_no_segment);
+	add_test(suite, submit_merges_frames_if_segments_are_exhausted);
+	add_test(suite, destroy_releases_resources);
+	TestReporter *reporter = create_text_reporter();
+	int exit_code = run_test_suite(suite, reporter);
+	destroy_reporter(reporter);
+	destroy_test_suite(suite);
+	return exit_code;
+}
@@ -7,12 +7,16 @@
 #endif
 
 #include <argp.h>
+#include <inttypes.h>
+#include <limits.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "logger.h"
 #include "topdax.h"
+#include <renderer/vkclock.h>
 #include <renderer/vkrenderer.h>
 #include <vulkan/vulkan.h>
 #include <GLFW/glfw3.h>
@@ -26,6 +30,86 @@ static struct vkrenderer renderer;
 /** Arguments parser */
 static struct argp argp;
 
+/** Print renderer statistics on exit */
+static int show_stats;
+
+/** Number of frames to render before exit, zero renders until window close */
+static unsigned long frame_limit;
+
+/** Default path of file remembering selected device */
+static char device_cache_path[PATH_MAX];
+
+/** Default path of file keeping compiled pipelines */
+static char pipeline_cache_path[PATH_MAX];
+
+/** Command line options */
+static const struct argp_option options[] = {
+	{ "frames-in-flight", 'f', "COUNT", 0,
+	  "Number of frames prepared ahead of presentation (1-4)", 0 },
+	{ "present", 'p', "POLICY", 0,
+	  "Present mode policy: power (default), latency or throughput", 0 },
+	{ "latency", 'l', "FRAMES", 0,
+	  "Number of images queued for display in vsync modes (1-8)", 0 },
+	{ "record", 'r', "MODE", 0,
+	  "Command recording: once (default), frame or parallel", 0 },
+	{ "threads", 't', "COUNT", 0,
+	  "Number of threads recording in parallel mode (1-8)", 0 },
+	{ "queues", 'q', "COUNT", 0,
+	  "Number of graphics queues shared by submitting threads (1-16)", 0 },
+	{ "upload-budget", 'u', "KIB", 0,
+	  "Kibibytes uploaded per frame at most (default 4096)", 0 },
+	{ "defrag-budget", 'm', "USEC", 0,
+	  "Microseconds per frame spent defragmenting memory (default 250)",
+	  0 },
+	{ "compile-threads", 'j', "COUNT", 0,
+	  "Number of threads compiling pipelines (1-8, default 2)", 0 },
+	{ "host-alloc", 'a', "MODE", 0,
+	  "Host allocations of driver: arena (default) or malloc", 0 },
+	{ "frames", 'n', "COUNT", 0, "Exit after rendering COUNT frames", 0 },
+	{ "stats", 's', NULL, 0, "Print rendering statistics on exit", 0 },
+	{ "device-cache", 'd', "FILE", 0,
+	  "File remembering selected device, empty disables", 0 },
+	{ "pipeline-cache", 'c', "FILE", 0,
+	  "File keeping compiled pipelines, empty disables", 0 },
+	{ 0 },
+};
+
+/** Names of present policies accepted on command line */
+static const char *const present_policies[] = {
+	[VKRENDERER_PRESENT_POWER] = "power",
+	[VKRENDERER_PRESENT_LATENCY] = "latency",
+	[VKRENDERER_PRESENT_THROUGHPUT] = "throughput",
+};
+
+/** Names of command recording modes accepted on command line */
+static const char *const record_modes[] = {
+	[VKRENDERER_RECORD_ONCE] = "once",
+	[VKRENDERER_RECORD_PER_FRAME] = "frame",
+	[VKRENDERER_RECORD_PARALLEL] = "parallel",
+};
+
+/** Names of host allocators accepted on command line */
+static const char *const host_modes[] = {
+	[VKHOST_MODE_ARENA] = "arena",
+	[VKHOST_MODE_MALLOC] = "malloc",
+};
+
+/** Names of allocation scopes printed in statistics */
+static const char *const host_scopes[] = {
+	[VK_SYSTEM_ALLOCATION_SCOPE_COMMAND] = "command",
+	[VK_SYSTEM_ALLOCATION_SCOPE_OBJECT] = "object",
+	[VK_SYSTEM_ALLOCATION_SCOPE_CACHE] = "cache",
+	[VK_SYSTEM_ALLOCATION_SCOPE_DEVICE] = "device",
+	[VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE] = "instance",
+};
+
+/** Names of pipeline cache sources printed in statistics */
+static const char *const pipecache_sources[] = {
+	[VKPIPECACHE_COLD] = "cold",
+	[VKPIPECACHE_WARM] = "warm",
+	[VKPIPECACHE_REJECTED] = "rejected",
+};
+
 /** Vulkan compatible application version */
 #define VK_APP_VERSION \
 	VK_MAKE_VERSION(VERSION_MAJOR, VERSION_MINOR, VERSION_PATCH)
@@ -37,7 +121,7 @@ static const VkApplicationInfo topdax_app_info = {
 	.applicationVersion = VK_APP_VERSION,
 	.pEngineName = PACKAGE,
 	.engineVersion = VK_APP_VERSION,
-	.apiVersion = VK_API_VERSION_1_1
+	.apiVersion = VK_API_VERSION_1_3
 };
 
 /**
@@ -94,12 +178,320 @@ static VkResult vk_instance_create(VkInstance *instance)
 	return vkCreateInstance(&vk_info, NULL, instance);
 }
 
+/**
+ * Parses command line option
+ * @param key Specifies key of option to parse
+ * @param arg Specifies option argument, or NULL
+ * @param state Specifies arguments parser state
+ * @returns zero on success, or error code otherwise
+ */
+static error_t parse_option(int key, char *arg, struct argp_state *state)
+{
+	char *end;
+	switch (key) {
+	case 'f':
+		renderer.nflights = strtoul(arg, &end, 10);
+		if (*end != '\0' || renderer.nflights == 0 ||
+		    renderer.nflights > VKRENDERER_MAX_FLIGHTS) {
+			argp_error(state, "invalid number of frames in flight");
+		}
+		return 0;
+	case 'p':
+		for (size_t i = 0; i < ARRAY_SIZE(present_policies); ++i) {
+			if (!strcmp(arg, present_policies[i])) {
+				renderer.present_policy = i;
+				return 0;
+			}
+		}
+		argp_error(state, "unknown present policy '%s'", arg);
+		return 0;
+	case 'l':
+		renderer.latency_budget = strtoul(arg, &end, 10);
+		if (*end != '\0' || renderer.latency_budget == 0 ||
+		    renderer.latency_budget > 8) {
+			argp_error(state, "invalid latency budget");
+		}
+		return 0;
+	case 'r':
+		for (size_t i = 0; i < ARRAY_SIZE(record_modes); ++i) {
+			if (!strcmp(arg, record_modes[i])) {
+				renderer.record_mode = i;
+				return 0;
+			}
+		}
+		argp_error(state, "unknown record mode '%s'", arg);
+		return 0;
+	case 't':
+		renderer.nworkers = strtoul(arg, &end, 10);
+		if (*end != '\0' || renderer.nworkers == 0 ||
+		    renderer.nworkers > VKRECORDER_MAX_WORKERS) {
+			argp_error(state, "invalid number of threads");
+		}
+		return 0;
+	case 'j':
+		renderer.compile_workers = strtoul(arg, &end, 10);
+		if (*end != '\0' || renderer.compile_workers == 0 ||
+		    renderer.compile_workers > VKCOMPILER_MAX_WORKERS) {
+			argp_error(state, "invalid number of threads");
+		}
+		return 0;
+	case 'q':
+		renderer.max_queues = strtoul(arg, &end, 10);
+		if (*end != '\0' || renderer.max_queues == 0 ||
+		    renderer.max_queues > VKRENDERER_MAX_QUEUES) {
+			argp_error(state, "invalid number of queues");
+		}
+		return 0;
+	case 'u':
+		renderer.upload_budget = strtoull(arg, &end, 10) * 1024;
+		if (*end != '\0' || renderer.upload_budget == 0 ||
+		    renderer.upload_budget > VKRENDERER_STAGING_SIZE) {
+			argp_error(state, "invalid upload budget");
+		}
+		return 0;
+	case 'm':
+		renderer.defrag_budget_ns = strtoull(arg, &end, 10) * 1000;
+		if (*end != '\0' || renderer.defrag_budget_ns == 0 ||
+		    renderer.defrag_budget_ns > UINT64_C(1000000000)) {
+			argp_error(state, "invalid defragmentation budget");
+		}
+		return 0;
+	case 'a':
+		for (size_t i = 0; i < ARRAY_SIZE(host_modes); ++i) {
+			if (!strcmp(arg, host_modes[i])) {
+				renderer.host_mode = i;
+				return 0;
+			}
+		}
+		argp_error(state, "unknown host allocator '%s'", arg);
+		return 0;
+	case 'n':
+		frame_limit = strtoul(arg, &end, 10);
+		if (*end != '\0' || frame_limit == 0) {
+			argp_error(state, "invalid number of frames");
+		}
+		return 0;
+	case 's':
+		show_stats = 1;
+		return 0;
+	case 'd':
+		renderer.device_cache = *arg != '\0' ? arg : NULL;
+		return 0;
+	case 'c':
+		renderer.pipeline_cache_path = *arg != '\0' ? arg : NULL;
+		return 0;
+	default:
+		return ARGP_ERR_UNKNOWN;
+	}
+}
+
+/**
+ * Builds path of file in user cache directory
+ * @param path Specifies buffer to store path in, PATH_MAX bytes long
+ * @param name Specifies name of file
+ * @returns @a path on success, or NULL otherwise
+ */
+static const char *cache_file(char *path, const char *name)
+{
+	const char *dir = getenv("XDG_CACHE_HOME");
+	const char *home = getenv("HOME");
+	int len;
+	if (dir != NULL && *dir != '\0') {
+		len = snprintf(path, PATH_MAX, "%s/%s", dir, name);
+	} else if (home != NULL) {
+		len = snprintf(path, PATH_MAX, "%s/.cache/%s", home, name);
+	} else {
+		return NULL;
+	}
+	return (len > 0 && len < PATH_MAX) ? path : NULL;
+}
+
+/**
+ * Keeps selected device and compiled pipelines in user cache directory by
+ * default
+ */
+static void set_default_caches(void)
+{
+	renderer.device_cache = cache_file(device_cache_path, "topdax-device");
+	renderer.pipeline_cache_path =
+		cache_file(pipeline_cache_path, "topdax-pipelines");
+}
+
+#ifdef VKDISPATCH_ACCOUNTING
+/**
+ * Prints calls made through dispatch table entry
+ * @param name Specifies name of the entry
+ * @param calls Specifies calls made through the entry
+ * @param nframes Specifies number of frames calls are made for
+ */
+static void print_calls(const char *name,
+			const struct vkdispatch_calls *calls, uint64_t nframes)
+{
+	if (calls->count == 0)
+		return;
+	printf("  %s: %.1f calls, %" PRIu64 " ns per frame\n", name,
+	       (double)calls->count / nframes, (uint64_t)calls->ns / nframes);
+}
+
+/** Prints calls of dispatch table entry of renderer in print_stats */
+#define PRINT_CALLS(name, params, args)                                       \
+	print_calls(#name, &rdr->vkd.calls.name, nsubmits);
+#endif
+
+/**
+ * Prints statistics collected by renderer
+ * @param rdr Specifies renderer to print statistics of
+ * @param startup_ns Specifies time spent initializing renderer, in
+ *                   nanoseconds
+ * @param elapsed_ns Specifies time spent in main loop, in nanoseconds
+ */
+static void print_stats(const struct vkrenderer *rdr, uint64_t startup_ns,
+			uint64_t elapsed_ns)
+{
+	const struct vkrenderer_stats *stats = &rdr->stats;
+	const uint64_t nacquires = stats->nacquires ? stats->nacquires : 1;
+	const uint64_t nsubmits = stats->nsubmits ? stats->nsubmits : 1;
+	printf("startup: %" PRIu64 " us, pipeline cache %s, %zu bytes loaded"
+	       " in %" PRIu64 " us\n",
+	       startup_ns / 1000,
+	       pipecache_sources[rdr->pipeline_cache.source],
+	       rdr->pipeline_cache.mapped_size,
+	       rdr->pipeline_cache.load_ns / 1000);
+	printf("swapchain images: %zu (requested %" PRIu32 ")\n",
+	       rdr->swcs[rdr->swc_index].nframes, rdr->srf_image_count);
+	printf("acquire stall: %" PRIu64 " us average, %" PRIu64
+	       " us max over %" PRIu64 " frames\n",
+	       stats->acquire_stall_ns / nacquires / 1000,
+	       stats->max_acquire_stall_ns / 1000, stats->nacquires);
+	printf("record and submit: %" PRIu64 " us average, %s mode\n",
+	       stats->submit_ns / nsubmits / 1000,
+	       record_modes[rdr->record_mode]);
+	printf("frame rate: %.1f frames per second\n",
+	       elapsed_ns ? stats->nsubmits * 1e9 / elapsed_ns : 0.0);
+	printf("command buffers: %zu live, %zu free\n", rdr->cmd_pool.nlive,
+	       rdr->cmd_pool.nfree);
+	printf("render passes: %zu cached, %" PRIu64 " hits, %" PRIu64
+	       " misses\n",
+	       rdr->rp_cache.count, rdr->rp_cache.nhits, rdr->rp_cache.nmisses);
+	const struct vkcompiler *comp = &rdr->compiler;
+	const uint64_t ncompiled = comp->ncompiled ? comp->ncompiled : 1;
+	printf("pipelines: %" PRIu64 " compiled in background, %" PRIu64
+	       " us average, %" PRIu64 " found in cache, %" PRIu64
+	       " failed, %" PRIu64 " draws on fallback, %" PRIu64
+	       " draws skipped\n",
+	       comp->ncompiled, comp->compile_ns / ncompiled / 1000,
+	       comp->ncached, comp->nfailed,
+	       (uint64_t)comp->nfallbacks, (uint64_t)comp->nskipped);
+	printf("pipeline registry: %zu unique pipelines, %" PRIu64
+	       " duplicate requests\n",
+	       rdr->pipelines.count, (uint64_t)rdr->pipelines.nduplicates);
+	printf("graphics queues: %" PRIu32 " shared, %" PRIu64
+	       " leases, %" PRIu64 " misses\n",
+	       rdr->queues.count, (uint64_t)rdr->queues.nleases,
+	       (uint64_t)rdr->queues.nmisses);
+	printf("compute jobs: %" PRIu64 " on %s queue\n",
+	       rdr->compute_jobs.nsubmits,
+	       rdr->compute != rdr->graphic ? "async compute" : "graphics");
+	printf("uploads: %" PRIu64 " bytes on %s queue\n", rdr->uploads.nbytes,
+	       rdr->transfer != rdr->graphic ? "transfer" : "graphics");
+	const uint64_t nbatches =
+		rdr->staging.nbatches ? rdr->staging.nbatches : 1;
+	printf("staging: %" PRIu64 " bytes in %" PRIu64 " batches, %" PRIu64
+	       " bytes per batch, %" PRIu64 " stalls on full ring\n",
+	       rdr->staging.nbytes, rdr->staging.nbatches,
+	       rdr->staging.nbytes / nbatches, rdr->staging.nstalls);
+	printf("uniform data: %" PRIu64 " bytes per frame, %" PRIu64
+	       " allocations failed on full ring\n",
+	       rdr->uniforms.nbytes / nsubmits, rdr->uniforms.nfull);
+	for (uint32_t i = 0; i < rdr->memory.props.memoryHeapCount; ++i) {
+		struct vkbudget_stats budget;
+		vkbudget_stats(&rdr->budget, i, &budget);
+		printf("memory budget %" PRIu32 ": %" PRIu64 " of %" PRIu64
+		       " bytes used, %" PRIu64 " bytes evictable\n",
+		       i, (uint64_t)budget.usage, (uint64_t)budget.budget,
+		       (uint64_t)budget.evictable);
+		struct vkmemory_stats mem;
+		vkmemory_stats(&rdr->memory, i, &mem);
+		if (mem.allocated == 0)
+			continue;
+		printf("memory heap %" PRIu32 ": %" PRIu64 " of %" PRIu64
+		       " bytes used in %" PRIu32 " allocations, %.1f%%"
+		       " fragmented\n",
+		       i, (uint64_t)mem.used, (uint64_t)mem.allocated,
+		       mem.nblocks,
+		       mem.free ? 100.0 - 100.0 * mem.largest_free / mem.free :
+				  0.0);
+	}
+	printf("evictions: %" PRIu64 " resources, %" PRIu64 " bytes\n",
+	       rdr->budget.nevictions, rdr->budget.nevicted);
+	const uint64_t nsteps = rdr->defrag.nsteps ? rdr->defrag.nsteps : 1;
+	printf("defragmentation: %" PRIu64 " resources, %" PRIu64
+	       " bytes moved in %" PRIu64 " passes, %" PRIu64
+	       " blocks evacuated, %" PRIu64 " ns per frame\n",
+	       rdr->defrag.nmoved, rdr->defrag.nbytes, rdr->defrag.npasses,
+	       rdr->defrag.nblocks, rdr->defrag.elapsed_ns / nsteps);
+	for (size_t i = 0; i < ARRAY_SIZE(host_scopes); ++i) {
+		const struct vkhost_stats *host = &rdr->host.scopes[i];
+		if (host->nallocs == 0 && host->internal == 0)
+			continue;
+		printf("host %s scope: %" PRIu64 " allocations, %" PRIu64
+		       " reallocations, %zu bytes live, %zu bytes peak, %zu"
+		       " bytes internal, %s allocator\n",
+		       host_scopes[i], host->nallocs, host->nreallocs,
+		       host->bytes, host->peak, host->internal,
+		       host_modes[rdr->host.mode]);
+	}
+#ifdef VKDISPATCH_ACCOUNTING
+	printf("device calls:\n");
+	VKDISPATCH_RESULT_FUNCTIONS(PRINT_CALLS)
+	VKDISPATCH_VOID_FUNCTIONS(PRINT_CALLS)
+#endif
+}
+
+/**
+ * Handles keyboard input, P key switches present policy at runtime
+ * @param window Specifies window that received the event
+ * @param key Specifies keyboard key that was pressed or released
+ * @param scancode Specifies system-specific scancode of the key
+ * @param action Specifies key action
+ * @param mods Specifies bit field describing modifier keys held down
+ */
+static void handle_key(GLFWwindow *window, int key, int scancode, int action,
+		       int mods)
+{
+	(void)(window);
+	(void)(scancode);
+	(void)(mods);
+	if (key == GLFW_KEY_P && action == GLFW_PRESS) {
+		const unsigned int next = renderer.present_policy + 1;
+		vkrenderer_set_present_policy(
+			&renderer, next % VKRENDERER_PRESENT_POLICIES);
+	}
+}
+
+/**
+ * Handles window framebuffer resize
+ * @param window Specifies window that was resized
+ * @param width Specifies new width of framebuffer, in pixels
+ * @param height Specifies new height of framebuffer, in pixels
+ */
+static void handle_resize(GLFWwindow *window, int width, int height)
+{
+	(void)(window);
+	(void)(width);
+	(void)(height);
+	vkrenderer_resize(&renderer);
+}
+
 int application_main(int argc, char **argv)
 {
 	int exit_code = EXIT_SUCCESS;
 	argp_program_version = PACKAGE_STRING;
 	argp_program_bug_address = PACKAGE_BUGREPORT;
 	argp.doc = "The program that renders triangle using Vulkan API";
+	argp.options = options;
+	argp.parser = parse_option;
+	set_default_caches();
 	if (argp_parse(&argp, argc, argv, 0, NULL, NULL)) {
 		exit_code = EXIT_FAILURE;
 		goto exit;
@@ -126,14 +518,23 @@ int application_main(int argc, char **argv)
 		exit_code = EXIT_FAILURE;
 		goto destroy_window;
 	}
+	const uint64_t init_start = vkclock_ns();
 	if (vkrenderer_init(&renderer, vkn, srf)) {
 		exit_code = EXIT_FAILURE;
 		goto destroy_surface;
 	}
-	while (!glfwWindowShouldClose(win)) {
+	const uint64_t startup_ns = vkclock_ns() - init_start;
+	glfwSetKeyCallback(win, handle_key);
+	glfwSetFramebufferSizeCallback(win, handle_resize);
+	const uint64_t start = vkclock_ns();
+	while (!glfwWindowShouldClose(win) &&
+	       (frame_limit == 0 || renderer.frame < frame_limit)) {
 		glfwPollEvents();
 		vkrenderer_render(&renderer);
 	}
+	if (show_stats) {
+		print_stats(&renderer, startup_ns, vkclock_ns() - start);
+	}
 	vkrenderer_terminate(&renderer);
 destroy_surface:
 	vkDestroySurfaceKHR(vkn, srf, NULL);
@@ -16,8 +16,7 @@
 #include <vulkan/vulkan_core.h>
 #include <GLFW/glfw3.h>
 #include "topdax.h"
-
-struct vkrenderer;
+#include <renderer/vkrenderer.h>
 
 GLFWAPI int glfwInit(void)
 {
@@ -107,7 +106,7 @@ int vkrenderer_init(struct vkrenderer *rdr, VkInstance instance,
 	return (int)mock(rdr, instance, surface);
 }
 
-void vkrenderer_terminate(const struct vkrenderer *rdr)
+void vkrenderer_terminate(struct vkrenderer *rdr)
 {
 	mock(rdr);
 }
@@ -127,6 +126,41 @@ int vkrenderer_render(struct vkrenderer *rdr)
 	return (int)mock(rdr);
 }
 
+void vkrenderer_set_present_policy(struct vkrenderer *rdr,
+				   enum vkrenderer_present_policy policy)
+{
+	mock(rdr, policy);
+}
+
+void vkrenderer_resize(struct vkrenderer *rdr)
+{
+	mock(rdr);
+}
+
+void vkmemory_stats(const struct vkmemory *mem, uint32_t heap,
+		    struct vkmemory_stats *stats)
+{
+	mock(mem, heap, stats);
+}
+
+void vkbudget_stats(const struct vkbudget *bdg, uint32_t heap,
+		    struct vkbudget_stats *stats)
+{
+	mock(bdg, heap, stats);
+}
+
+GLFWAPI GLFWframebuffersizefun
+glfwSetFramebufferSizeCallback(GLFWwindow *window,
+			       GLFWframebuffersizefun callback)
+{
+	return (GLFWframebuffersizefun)mock(window, callback);
+}
+
+GLFWAPI GLFWkeyfun glfwSetKeyCallback(GLFWwindow *window, GLFWkeyfun callback)
+{
+	return (GLFWkeyfun)mock(window, callback);
+}
+
 Ensure(main_returns_zero_on_success)
 {
 	const char *wsi_exts[] = { "VK_KHR_surface" };
@@ -148,6 +182,9 @@ Ensure(main_returns_zero_on_success)
 	       when(title, is_equal_to_string("Topdax")));
 	expect(glfwCreateWindowSurface, will_return(VK_SUCCESS));
 	expect(vkrenderer_init);
+	expect(glfwSetKeyCallback, when(window, is_equal_to((GLFWwindow *)1)));
+	expect(glfwSetFramebufferSizeCallback,
+	       when(window, is_equal_to((GLFWwindow *)1)));
 	expect(glfwWindowShouldClose, will_return(0));
 	expect(glfwPollEvents);
 	expect(vkrenderer_render);